@@ -634,6 +634,9 @@ void CloudStream2::OnFrameRequirementsChanged(CloudStream2DLL::EncoderRequiremen
 			m_BackToInitialCameraConfig = false;
 		}
 
+		if (requirements.Color != m_FrameRequirements.Color)
+			m_FrameRequirements.Color = requirements.Color;
+
 		if (requirements.UseDynamicResolution != m_FrameRequirements.UseDynamicResolution)
 			m_FrameRequirements.UseDynamicResolution = requirements.UseDynamicResolution;
 
@@ -644,6 +647,18 @@ void CloudStream2::OnFrameRequirementsChanged(CloudStream2DLL::EncoderRequiremen
 	}
 }
 
+FIntPoint CloudStream2::GetEncoderResolution()
+{
+	FScopeLock ScopeLock(&m_InterruptionMutex);
+	return FIntPoint(static_cast<int32>(m_FrameRequirements.Width), static_cast<int32>(m_FrameRequirements.Height));
+}
+
+uint32 CloudStream2::GetEncoderColorSpace()
+{
+	FScopeLock ScopeLock(&m_InterruptionMutex);
+	return m_FrameRequirements.Color;
+}
+
 int CloudStream2::MouseLatencyValue()
 {
 	return m_LatencyValue;
@@ -115,6 +115,13 @@ void UZLCloudPluginSettings::SaveToCustomIni()
 	WRITE_CONFIG("bMouseAlwaysAttached", bMouseAlwaysAttached ? TEXT("True") : TEXT("False"));
 	WRITE_CONFIG("filteredKeyList", *filteredKeyList);
 	WRITE_CONFIG("FramesPerSecond", *FString::FromInt(FramesPerSecond));
+	WRITE_CONFIG("FramePacingPolicy", *StaticEnum<EZLFramePacingPolicy>()->GetNameStringByValue(static_cast<int64>(FramePacingPolicy)));
+	WRITE_CONFIG("MaxCatchUpFrames", *FString::FromInt(MaxCatchUpFrames));
+	WRITE_CONFIG("SimulcastLayerScales", *SimulcastLayerScales);
+	WRITE_CONFIG("MaxInFlightFrames", *FString::FromInt(MaxInFlightFrames));
+	WRITE_CONFIG("FrameBudgetPolicy", *StaticEnum<EZLFrameBudgetPolicy>()->GetNameStringByValue(static_cast<int64>(FrameBudgetPolicy)));
+	WRITE_CONFIG("FrameBudgetBlockTimeoutMs", *FString::FromInt(FrameBudgetBlockTimeoutMs));
+	WRITE_CONFIG("bCPUYUVConversion", bCPUYUVConversion ? TEXT("True") : TEXT("False"));
 	WRITE_CONFIG("DelayAppReadyToStream", DelayAppReadyToStream ? TEXT("True") : TEXT("False"));
 	WRITE_CONFIG("bRebootAppOnDisconnect", bRebootAppOnDisconnect ? TEXT("True") : TEXT("False"));
 	WRITE_CONFIG("bDisableTextureStreamingOnLaunch", bDisableTextureStreamingOnLaunch ? TEXT("True") : TEXT("False"));
@@ -0,0 +1,203 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#include "FrameBudgetQueue.h"
+
+#if UNREAL_5_1_OR_NEWER
+
+#include "ZLCloudPluginPrivate.h"
+#include "Misc/ScopeLock.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Frame Queue Dropped Frames"), STAT_ZLFrameQueueDroppedFrames, STATGROUP_ZLCloudPlugin);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Frame Queue Age (ms)"), STAT_ZLFrameQueueAgeMs, STATGROUP_ZLCloudPlugin);
+
+namespace ZLCloudPlugin
+{
+	const double FFrameQueueStats::AgeBucketBoundsMs[FFrameQueueStats::NumAgeBuckets - 1] = { 1.0, 2.0, 4.0, 8.0, 16.0, 33.0, 66.0 };
+
+	void FFrameQueueStats::AddAge(double AgeMs)
+	{
+		int32 Bucket = 0;
+		while (Bucket < NumAgeBuckets - 1 && AgeMs >= AgeBucketBoundsMs[Bucket])
+		{
+			++Bucket;
+		}
+
+		++AgeHistogram[Bucket];
+		++NumConsumed;
+		TotalAgeMs += AgeMs;
+		MaxAgeMs = FMath::Max(MaxAgeMs, AgeMs);
+	}
+
+	void FFrameQueueStats::Reset()
+	{
+		*this = FFrameQueueStats();
+	}
+
+	FString FFrameQueueStats::ToString() const
+	{
+		const double MeanAgeMs = NumConsumed > 0 ? TotalAgeMs / NumConsumed : 0.0;
+
+		FString Result = FString::Printf(TEXT("produced=%llu consumed=%llu dropped(oldest=%llu newest=%llu) blocked=%llu timeouts=%llu age(mean=%.2fms max=%.2fms) |"),
+			NumProduced, NumConsumed, NumDroppedOldest, NumDroppedNewest, NumBlocked, NumBlockTimeouts, MeanAgeMs, MaxAgeMs);
+
+		for (int32 Bucket = 0; Bucket < NumAgeBuckets; ++Bucket)
+		{
+			if (Bucket < NumAgeBuckets - 1)
+			{
+				Result += FString::Printf(TEXT(" <%.0fms:%llu"), AgeBucketBoundsMs[Bucket], AgeHistogram[Bucket]);
+			}
+			else
+			{
+				Result += FString::Printf(TEXT(" >=%.0fms:%llu"), AgeBucketBoundsMs[Bucket - 1], AgeHistogram[Bucket]);
+			}
+		}
+
+		return Result;
+	}
+
+	FFrameBudgetQueue::FFrameBudgetQueue(TSharedRef<IFramePacerClock> InClock)
+		: Clock(InClock)
+	{
+	}
+
+	void FFrameBudgetQueue::SetBudget(int32 InMaxInFlightFrames, EFrameBudgetPolicy InPolicy, double InBlockTimeoutSeconds)
+	{
+		FScopeLock Lock(&CriticalSection);
+		MaxInFlightFrames = FMath::Max(InMaxInFlightFrames, 1);
+		Policy = InPolicy;
+		BlockTimeoutSeconds = FMath::Max(InBlockTimeoutSeconds, 0.0);
+
+		while (Frames.Num() > MaxInFlightFrames)
+		{
+			Frames.RemoveAt(0);
+			++Stats.NumDroppedOldest;
+		}
+
+		if (HeldFrame.Frame && Policy != EFrameBudgetPolicy::BlockWithTimeout)
+		{
+			HeldFrame = FQueuedFrame();
+			++Stats.NumDroppedNewest;
+		}
+	}
+
+	bool FFrameBudgetQueue::Push(TFunctionRef<TSharedPtr<IPixelCaptureOutputFrame>()> MakeFrame)
+	{
+		FScopeLock Lock(&CriticalSection);
+		const double NowSeconds = Clock->GetSeconds();
+
+		ExpireHeldFrame(NowSeconds);
+
+		// Push runs where the capture completes, so rather than wait there a BlockWithTimeout frame is held until Pop frees a slot
+		const bool bFull = Frames.Num() >= MaxInFlightFrames;
+		const bool bHold = bFull && Policy == EFrameBudgetPolicy::BlockWithTimeout && !HeldFrame.Frame && BlockTimeoutSeconds > 0.0;
+		if (bFull && Policy != EFrameBudgetPolicy::DropOldest && !bHold)
+		{
+			// DropNewest, or a frame is already held and this one would have to wait behind it
+			++Stats.NumProduced;
+			++Stats.NumDroppedNewest;
+			INC_DWORD_STAT(STAT_ZLFrameQueueDroppedFrames);
+			return false;
+		}
+
+		TSharedPtr<IPixelCaptureOutputFrame> Frame = MakeFrame();
+		if (!Frame)
+		{
+			return false;
+		}
+		++Stats.NumProduced;
+
+		if (bHold)
+		{
+			HeldFrame = { MoveTemp(Frame), NowSeconds };
+			HeldDeadlineSeconds = NowSeconds + BlockTimeoutSeconds;
+			++Stats.NumBlocked;
+			return true;
+		}
+
+		if (bFull)
+		{
+			Frames.RemoveAt(0);
+			++Stats.NumDroppedOldest;
+			INC_DWORD_STAT(STAT_ZLFrameQueueDroppedFrames);
+		}
+
+		Frames.Add({ MoveTemp(Frame), NowSeconds });
+		return true;
+	}
+
+	TSharedPtr<IPixelCaptureOutputFrame> FFrameBudgetQueue::Pop()
+	{
+		FScopeLock Lock(&CriticalSection);
+		const double NowSeconds = Clock->GetSeconds();
+
+		ExpireHeldFrame(NowSeconds);
+
+		if (Frames.Num() == 0)
+		{
+			return nullptr;
+		}
+
+		// DropOldest is there to keep latency down, so the encoder always gets the newest frame
+		if (Policy == EFrameBudgetPolicy::DropOldest && Frames.Num() > 1)
+		{
+			const int32 NumOvertaken = Frames.Num() - 1;
+			Frames.RemoveAt(0, NumOvertaken);
+			Stats.NumDroppedOldest += NumOvertaken;
+			INC_DWORD_STAT_BY(STAT_ZLFrameQueueDroppedFrames, NumOvertaken);
+		}
+
+		FQueuedFrame QueuedFrame = MoveTemp(Frames[0]);
+		Frames.RemoveAt(0);
+
+		// The held frame keeps its push time, so its age includes the wait for this slot
+		if (HeldFrame.Frame)
+		{
+			Frames.Add(MoveTemp(HeldFrame));
+			HeldFrame = FQueuedFrame();
+		}
+
+		const double AgeMs = (NowSeconds - QueuedFrame.EnqueueSeconds) * 1000.0;
+		Stats.AddAge(AgeMs);
+		SET_FLOAT_STAT(STAT_ZLFrameQueueAgeMs, AgeMs);
+
+		return MoveTemp(QueuedFrame.Frame);
+	}
+
+	void FFrameBudgetQueue::Empty()
+	{
+		FScopeLock Lock(&CriticalSection);
+		Frames.Empty();
+		HeldFrame = FQueuedFrame();
+	}
+
+	void FFrameBudgetQueue::ExpireHeldFrame(double NowSeconds)
+	{
+		if (HeldFrame.Frame && NowSeconds >= HeldDeadlineSeconds)
+		{
+			HeldFrame = FQueuedFrame();
+			++Stats.NumDroppedNewest;
+			++Stats.NumBlockTimeouts;
+			INC_DWORD_STAT(STAT_ZLFrameQueueDroppedFrames);
+		}
+	}
+
+	int32 FFrameBudgetQueue::Num() const
+	{
+		FScopeLock Lock(&CriticalSection);
+		return Frames.Num();
+	}
+
+	FFrameQueueStats FFrameBudgetQueue::GetStats() const
+	{
+		FScopeLock Lock(&CriticalSection);
+		return Stats;
+	}
+
+	void FFrameBudgetQueue::ResetStats()
+	{
+		FScopeLock Lock(&CriticalSection);
+		Stats.Reset();
+	}
+} // namespace ZLCloudPlugin
+
+#endif
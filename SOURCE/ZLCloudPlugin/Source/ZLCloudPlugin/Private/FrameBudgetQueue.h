@@ -0,0 +1,107 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#pragma once
+
+#include "ZLCloudPluginVersion.h"
+#if UNREAL_5_1_OR_NEWER
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "IPixelCaptureOutputFrame.h"
+#include "FramePacer.h"
+
+namespace ZLCloudPlugin
+{
+	enum class EFrameBudgetPolicy : uint8
+	{
+		// Make room by dropping the frame that has been waiting longest.
+		DropOldest,
+		// Drop the incoming frame and keep the ones already waiting.
+		DropNewest,
+		// Hold the incoming frame until the consumer makes room, dropping it if the timeout expires first.
+		// The producer never waits, the held frame is queued by the Pop that frees a slot.
+		BlockWithTimeout
+	};
+
+	/*
+	* Produced/consumed/dropped counts for a frame budget queue, plus a histogram of how long frames waited before being consumed.
+	*/
+	struct FFrameQueueStats
+	{
+		static constexpr int32 NumAgeBuckets = 8;
+
+		// Upper bound (exclusive) of each queue age bucket in milliseconds, the last bucket catches everything above.
+		static const double AgeBucketBoundsMs[NumAgeBuckets - 1];
+
+		uint64 AgeHistogram[NumAgeBuckets] = {};
+		uint64 NumProduced = 0;
+		uint64 NumConsumed = 0;
+		uint64 NumDroppedOldest = 0;
+		uint64 NumDroppedNewest = 0;
+		uint64 NumBlocked = 0;
+		uint64 NumBlockTimeouts = 0;
+		double TotalAgeMs = 0.0;
+		double MaxAgeMs = 0.0;
+
+		void AddAge(double AgeMs);
+		void Reset();
+		FString ToString() const;
+	};
+
+	/*
+	* Bounded queue of captured frames waiting for a video source to hand them to the encoder.
+	* Push is called from the capture side and Pop from the frame thread, either may run on any thread and neither waits for a slot.
+	* Pop can wait on the lock while Push records an admitted frame's copy.
+	*/
+	class FFrameBudgetQueue
+	{
+	public:
+		FFrameBudgetQueue(TSharedRef<IFramePacerClock> InClock = MakeShared<FPlatformFramePacerClock>());
+
+		void SetBudget(int32 InMaxInFlightFrames, EFrameBudgetPolicy InPolicy, double InBlockTimeoutSeconds);
+
+		// Queues the frame MakeFrame returns, returns false if the budget policy dropped it. A frame held for BlockWithTimeout counts as queued.
+		// MakeFrame is only called once the policy has admitted a frame, so a capture that would be dropped is never copied.
+		bool Push(TFunctionRef<TSharedPtr<IPixelCaptureOutputFrame>()> MakeFrame);
+		bool Push(TSharedPtr<IPixelCaptureOutputFrame> Frame) { return Push([&Frame]() { return MoveTemp(Frame); }); }
+
+		// Takes the next frame for the encoder, or nullptr if nothing is waiting. DropOldest hands over the newest frame and drops
+		// the ones it overtook, the other policies hand frames over in the order they were captured.
+		TSharedPtr<IPixelCaptureOutputFrame> Pop();
+
+		// Drops every waiting frame without counting them as consumed or dropped.
+		void Empty();
+
+		int32 Num() const;
+
+		FFrameQueueStats GetStats() const;
+		void ResetStats();
+
+	private:
+		struct FQueuedFrame
+		{
+			TSharedPtr<IPixelCaptureOutputFrame> Frame;
+			double EnqueueSeconds = 0.0;
+		};
+
+		TSharedRef<IFramePacerClock> Clock;
+
+		int32 MaxInFlightFrames = 2;
+		EFrameBudgetPolicy Policy = EFrameBudgetPolicy::DropOldest;
+		double BlockTimeoutSeconds = 0.005;
+
+		// Oldest first, never longer than MaxInFlightFrames so a plain array is cheap enough
+		TArray<FQueuedFrame> Frames;
+		FFrameQueueStats Stats;
+		mutable FCriticalSection CriticalSection;
+
+		// BlockWithTimeout frame waiting for a free slot, and when it stops waiting
+		FQueuedFrame HeldFrame;
+		double HeldDeadlineSeconds = 0.0;
+
+		// Drops the held frame if its timeout has passed, with CriticalSection locked
+		void ExpireHeldFrame(double NowSeconds);
+	};
+} // namespace ZLCloudPlugin
+
+#endif
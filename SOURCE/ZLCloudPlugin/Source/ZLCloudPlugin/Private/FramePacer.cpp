@@ -0,0 +1,183 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#include "FramePacer.h"
+#include "ZLCloudPluginPrivate.h"
+#include "Misc/ScopeLock.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Frame Pacing Late Ticks"), STAT_ZLFramePacingLateTicks, STATGROUP_ZLCloudPlugin);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Frame Pacing Skipped Frames"), STAT_ZLFramePacingSkippedFrames, STATGROUP_ZLCloudPlugin);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Frame Pacing Jitter (ms)"), STAT_ZLFramePacingJitterMs, STATGROUP_ZLCloudPlugin);
+
+namespace ZLCloudPlugin
+{
+	const double FFramePacingStats::JitterBucketBoundsMs[FFramePacingStats::NumJitterBuckets - 1] = { 0.5, 1.0, 2.0, 4.0, 8.0, 16.0, 33.0 };
+
+	void FFramePacingStats::AddInterval(double IntervalMs, double TargetIntervalMs)
+	{
+		const double JitterMs = FMath::Abs(IntervalMs - TargetIntervalMs);
+
+		int32 Bucket = 0;
+		while (Bucket < NumJitterBuckets - 1 && JitterMs >= JitterBucketBoundsMs[Bucket])
+		{
+			++Bucket;
+		}
+
+		++JitterHistogram[Bucket];
+		++NumIntervals;
+		TotalIntervalMs += IntervalMs;
+		TotalJitterMs += JitterMs;
+		MaxJitterMs = FMath::Max(MaxJitterMs, JitterMs);
+	}
+
+	void FFramePacingStats::Reset()
+	{
+		*this = FFramePacingStats();
+	}
+
+	FString FFramePacingStats::ToString() const
+	{
+		const double MeanIntervalMs = NumIntervals > 0 ? TotalIntervalMs / NumIntervals : 0.0;
+		const double MeanJitterMs = NumIntervals > 0 ? TotalJitterMs / NumIntervals : 0.0;
+
+		FString Result = FString::Printf(TEXT("intervals=%llu mean=%.2fms jitter(mean=%.2fms max=%.2fms) late=%llu skipped=%llu |"),
+			NumIntervals, MeanIntervalMs, MeanJitterMs, MaxJitterMs, NumLateTicks, NumSkippedFrames);
+
+		for (int32 Bucket = 0; Bucket < NumJitterBuckets; ++Bucket)
+		{
+			if (Bucket < NumJitterBuckets - 1)
+			{
+				Result += FString::Printf(TEXT(" <%.1fms:%llu"), JitterBucketBoundsMs[Bucket], JitterHistogram[Bucket]);
+			}
+			else
+			{
+				Result += FString::Printf(TEXT(" >=%.1fms:%llu"), JitterBucketBoundsMs[Bucket - 1], JitterHistogram[Bucket]);
+			}
+		}
+
+		return Result;
+	}
+
+	void FFramePushTracker::OnFramePushed(double NowSeconds, double TargetIntervalMs)
+	{
+		if (LastPushSeconds >= 0.0)
+		{
+			const double IntervalMs = (NowSeconds - LastPushSeconds) * 1000.0;
+			Stats.AddInterval(IntervalMs, TargetIntervalMs);
+			Stats.NumLateTicks += IntervalMs > TargetIntervalMs * 1.1 ? 1 : 0;
+		}
+		LastPushSeconds = NowSeconds;
+	}
+
+	void FFramePushTracker::OnFrameMissed()
+	{
+		++Stats.NumSkippedFrames;
+	}
+
+	void FFramePushTracker::OnPaused()
+	{
+		LastPushSeconds = -1.0;
+	}
+
+	void FFramePushTracker::Reset()
+	{
+		Stats.Reset();
+		LastPushSeconds = -1.0;
+	}
+
+	FFramePacer::FFramePacer(TSharedRef<IFramePacerClock> InClock)
+		: Clock(InClock)
+	{
+	}
+
+	void FFramePacer::SetTargetFPS(int32 InFramesPerSecond)
+	{
+		const double NewPeriodSeconds = 1.0 / FMath::Max(InFramesPerSecond, 1);
+		if (NewPeriodSeconds != FramePeriodSeconds)
+		{
+			FramePeriodSeconds = NewPeriodSeconds;
+
+			// Re-anchor on the last frame so the new rate takes effect from the next deadline
+			NextDeadlineSeconds = LastSubmitSeconds + FramePeriodSeconds;
+		}
+	}
+
+	void FFramePacer::SetPolicy(EFramePacingPolicy InPolicy, int32 InMaxCatchUpFrames)
+	{
+		Policy = InPolicy;
+		MaxCatchUpFrames = FMath::Max(InMaxCatchUpFrames, 0);
+	}
+
+	void FFramePacer::Restart()
+	{
+		bScheduleStarted = false;
+	}
+
+	double FFramePacer::GetTimeUntilDeadline() const
+	{
+		if (!bScheduleStarted)
+		{
+			return 0.0;
+		}
+
+		return NextDeadlineSeconds - Clock->GetSeconds();
+	}
+
+	void FFramePacer::OnFrameSubmitted()
+	{
+		const double NowSeconds = Clock->GetSeconds();
+
+		if (!bScheduleStarted)
+		{
+			bScheduleStarted = true;
+			LastSubmitSeconds = NowSeconds;
+			NextDeadlineSeconds = NowSeconds + FramePeriodSeconds;
+			return;
+		}
+
+		// Submitting within a tenth of a frame of the deadline is on time
+		const bool bLate = NowSeconds - NextDeadlineSeconds > FramePeriodSeconds * 0.1;
+		const double IntervalMs = (NowSeconds - LastSubmitSeconds) * 1000.0;
+		LastSubmitSeconds = NowSeconds;
+
+		// Advance from the deadline rather than from now so lateness does not accumulate
+		NextDeadlineSeconds += FramePeriodSeconds;
+
+		uint64 NumSkipped = 0;
+		if (NowSeconds >= NextDeadlineSeconds)
+		{
+			// One or more whole frame periods were missed
+			const uint64 NumMissed = static_cast<uint64>(FMath::FloorToDouble((NowSeconds - NextDeadlineSeconds) / FramePeriodSeconds)) + 1;
+			if (Policy == EFramePacingPolicy::Skip || NumMissed > static_cast<uint64>(MaxCatchUpFrames))
+			{
+				NumSkipped = NumMissed;
+				NextDeadlineSeconds += NumMissed * FramePeriodSeconds;
+			}
+		}
+
+		{
+			FScopeLock Lock(&StatsCriticalSection);
+			Stats.AddInterval(IntervalMs, FramePeriodSeconds * 1000.0);
+			Stats.NumLateTicks += bLate ? 1 : 0;
+			Stats.NumSkippedFrames += NumSkipped;
+		}
+
+		if (bLate)
+		{
+			INC_DWORD_STAT(STAT_ZLFramePacingLateTicks);
+		}
+		INC_DWORD_STAT_BY(STAT_ZLFramePacingSkippedFrames, NumSkipped);
+		SET_FLOAT_STAT(STAT_ZLFramePacingJitterMs, FMath::Abs(IntervalMs - FramePeriodSeconds * 1000.0));
+	}
+
+	FFramePacingStats FFramePacer::GetStats() const
+	{
+		FScopeLock Lock(&StatsCriticalSection);
+		return Stats;
+	}
+
+	void FFramePacer::ResetStats()
+	{
+		FScopeLock Lock(&StatsCriticalSection);
+		Stats.Reset();
+	}
+} // namespace ZLCloudPlugin
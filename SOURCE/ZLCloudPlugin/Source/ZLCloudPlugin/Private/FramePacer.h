@@ -0,0 +1,121 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "HAL/PlatformTime.h"
+
+namespace ZLCloudPlugin
+{
+	/*
+	* Monotonic time source used by the frame pacer. Swapped for a fake clock when testing pacing behaviour.
+	*/
+	class IFramePacerClock
+	{
+	public:
+		virtual ~IFramePacerClock() = default;
+		virtual double GetSeconds() const = 0;
+	};
+
+	class FPlatformFramePacerClock : public IFramePacerClock
+	{
+	public:
+		virtual double GetSeconds() const override { return FPlatformTime::Seconds(); }
+	};
+
+	/*
+	* Histogram of how far actual frame intervals landed from the target interval, plus late and skipped frame counts.
+	*/
+	struct FFramePacingStats
+	{
+		static constexpr int32 NumJitterBuckets = 8;
+
+		// Upper bound (exclusive) of each jitter bucket in milliseconds, the last bucket catches everything above.
+		static const double JitterBucketBoundsMs[NumJitterBuckets - 1];
+
+		uint64 JitterHistogram[NumJitterBuckets] = {};
+		uint64 NumIntervals = 0;
+		uint64 NumLateTicks = 0;
+		uint64 NumSkippedFrames = 0;
+		double TotalIntervalMs = 0.0;
+		double TotalJitterMs = 0.0;
+		double MaxJitterMs = 0.0;
+
+		void AddInterval(double IntervalMs, double TargetIntervalMs);
+		void Reset();
+		FString ToString() const;
+	};
+
+	/*
+	* Interval stats of the frames one video source pushes. Only ticks where a frame was due and the source had nothing
+	* to push count as skipped, ticks where it was paused or not ready yet aren't frames it owed and leave the stats alone.
+	*/
+	class FFramePushTracker
+	{
+	public:
+		void OnFramePushed(double NowSeconds, double TargetIntervalMs);
+
+		// A frame was due and the source couldn't push one.
+		void OnFrameMissed();
+
+		// The source isn't producing frames, the time until it resumes isn't counted as an interval.
+		void OnPaused();
+
+		const FFramePacingStats& GetStats() const { return Stats; }
+		void Reset();
+
+	private:
+		FFramePacingStats Stats;
+		double LastPushSeconds = -1.0;
+	};
+
+	enum class EFramePacingPolicy : uint8
+	{
+		// Frames due for deadlines that were missed are submitted back to back until the schedule is met again.
+		CatchUp,
+		// Missed deadlines are dropped and the schedule continues from the next one in the future.
+		Skip
+	};
+
+	/*
+	* Absolute-deadline frame scheduler. Deadlines advance by exactly one frame period per submitted frame,
+	* so a late tick does not push every following frame back the way sleeping for a fixed interval does.
+	*/
+	class FFramePacer
+	{
+	public:
+		FFramePacer(TSharedRef<IFramePacerClock> InClock = MakeShared<FPlatformFramePacerClock>());
+
+		void SetTargetFPS(int32 InFramesPerSecond);
+		void SetPolicy(EFramePacingPolicy InPolicy, int32 InMaxCatchUpFrames);
+
+		// Forgets the current schedule, the next submitted frame starts a new one.
+		void Restart();
+
+		// Seconds until the next frame is due, zero or negative when it is already due.
+		double GetTimeUntilDeadline() const;
+
+		// Records a submitted frame and advances the deadline according to the pacing policy.
+		void OnFrameSubmitted();
+
+		FFramePacingStats GetStats() const;
+		void ResetStats();
+
+		double GetFramePeriodSeconds() const { return FramePeriodSeconds; }
+		const IFramePacerClock& GetClock() const { return *Clock; }
+
+	private:
+		TSharedRef<IFramePacerClock> Clock;
+		EFramePacingPolicy Policy = EFramePacingPolicy::Skip;
+		int32 MaxCatchUpFrames = 2;
+
+		double FramePeriodSeconds = 1.0 / 30.0;
+		double NextDeadlineSeconds = 0.0;
+		double LastSubmitSeconds = 0.0;
+		bool bScheduleStarted = false;
+
+		FFramePacingStats Stats;
+		mutable FCriticalSection StatsCriticalSection;
+	};
+} // namespace ZLCloudPlugin
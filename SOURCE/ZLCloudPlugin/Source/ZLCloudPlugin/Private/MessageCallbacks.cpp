@@ -37,6 +37,8 @@ void MessageCallbacks::RegisterCallbacks(LauncherComms* launcherComms)
 	m_LauncherComms->RegisterMessageCallback(TEXT("SETINITIALSTATE"), &SetConnectState);
 	m_LauncherComms->RegisterMessageCallback(TEXT("SET2DODMODE"), &SetOnDemandProcessingState);
 	m_LauncherComms->RegisterMessageCallback(TEXT("OMNISTREAM_SETTINGS"), &SetOmnistreamSettings);
+	m_LauncherComms->RegisterMessageCallback(TEXT("GETSTATEFINGERPRINT"), &GetStateFingerprint);
+	m_LauncherComms->RegisterMessageCallback(TEXT("GETSTATEKEYMETRICS"), &GetStateKeyMetrics);
 
 	//Cert effects
 	m_LauncherComms->RegisterMessageCallback(TEXT("GET_ALL_UI_DETAILS_FOR_ZLCERTIFIED_EFFECTS"), &GetAllUiDetailsForZlCertifiedEffects);
@@ -228,6 +230,33 @@ void MessageCallbacks::SetOmnistreamSettings(MessageWithData* msg)
 
 }
 
+void MessageCallbacks::GetStateFingerprint(MessageWithData* msg)
+{
+	//16 hex digit fingerprint of the current state, excluding schema keys ignored in data hashes
+	msg->SetReply("RETURN_STATE_FINGERPRINT", UZLCloudPluginStateManager::GetZLCloudPluginStateManager()->GetStateFingerprintString());
+}
+
+void MessageCallbacks::GetStateKeyMetrics(MessageWithData* msg)
+{
+	//Optional {"max_keys": n, "reset": true}, worst keys first, reset starts a fresh window once this one is reported
+	int32 maxKeys = 0;
+	bool reset = false;
+
+	TSharedPtr<FJsonObject> JsonParsed;
+	TSharedRef<TJsonReader<TCHAR>> JsonReader = TJsonReaderFactory<TCHAR>::Create(msg->m_messageData);
+	if (!msg->m_messageData.IsEmpty() && FJsonSerializer::Deserialize(JsonReader, JsonParsed) && JsonParsed != nullptr)
+	{
+		JsonParsed->TryGetNumberField(FString("max_keys"), maxKeys);
+		JsonParsed->TryGetBoolField(FString("reset"), reset);
+	}
+
+	UZLCloudPluginStateManager* stateManager = UZLCloudPluginStateManager::GetZLCloudPluginStateManager();
+	msg->SetReply("RETURN_STATE_KEY_METRICS", stateManager->GetStateKeyMetricsString(maxKeys));
+
+	if (reset)
+		stateManager->ResetStateKeyMetrics();
+}
+
 void MessageCallbacks::CloudStreamConnected(MessageWithData* msg)
 {
 	//This function is for when the IM connects to the server, not when the browser connects to the plugin
@@ -347,37 +376,23 @@ void MessageCallbacks::SetConnectState(MessageWithData* msg)
 
 	bool defaultStateOnly = msg->m_messageData.IsEmpty();
 
-	if (defaultStateOnly) //process default state if set
+	if (defaultStateOnly && !stateManager->HasDefaultInitialState()) //Nothing specified and no default set, return ready as its unspecified
 	{
-		if (stateManager->HasDefaultInitialState())
-		{
-			//just set messagedata and execute rest of function
-			msg->m_messageData = stateManager->GetDefaultInitialState();
-		}
-		else //Nothing specified and no default set, return ready as its unspecified
-		{
-			msg->SetReply("STATE_READY");
-			return;
-		}
-	}
-	else if (stateManager->HasDefaultInitialState())
-	{
-		msg->m_messageData = stateManager->MergeDefaultInitialState(msg->m_messageData);
+		msg->SetReply("STATE_READY");
+		return;
 	}
 
-	auto ansiString = StringCast<ANSICHAR>(*msg->m_messageData);
-	const char* stateJson = ansiString.Get();
-
-	UE_LOG(LogZLCloudPlugin, Display, TEXT("SetConnectState::Attempting to parse initial state request %s"), UTF8_TO_TCHAR(stateJson));
+	UE_LOG(LogZLCloudPlugin, Display, TEXT("SetConnectState::Attempting to parse initial state request %s"), defaultStateOnly ? *stateManager->GetDefaultInitialState() : *msg->m_messageData);
 
+	//Default state with the request merged over it, streamed straight in so the request is never parsed on its own
 	TSharedPtr<FJsonObject> JsonParsed;
-	TSharedRef<TJsonReader<TCHAR>> JsonReader = TJsonReaderFactory<TCHAR>::Create(stateJson);
-	if (FJsonSerializer::Deserialize(JsonReader, JsonParsed))
+	FString parseError;
+	if (stateManager->MergeDefaultInitialState(msg->m_messageData, JsonParsed, &parseError))
 	{
 		// wait till state is matching the request to complete the adoption
 		if (JsonParsed != nullptr)
 		{
-			if (stateManager->CurrentStateCompareDiffs_Keys(JsonParsed).Num() == 0) //Already matches the state requested
+			if (stateManager->CurrentStateMatches(JsonParsed)) //Already matches the state requested
 			{
 				msg->SetReply("STATE_READY");
 			}
@@ -385,22 +400,10 @@ void MessageCallbacks::SetConnectState(MessageWithData* msg)
 			{
 				stateManager->SetNotifyServerState(JsonParsed); //Notify server when onConnect state is matched
 
-				FString stateDataStr;
-
-				TSharedRef<TJsonWriter<>> writer = TJsonWriterFactory<>::Create(&stateDataStr);
-
-				TSharedRef<FJsonObject> stateData = JsonParsed.ToSharedRef();
-
-				if (!FJsonSerializer::Serialize(stateData, writer))
-				{
-					UE_LOG(LogZLCloudPlugin, Display, TEXT("Error broadcasting OnRecieveData for state request"));
-				}
-
-				if (UZLCloudPluginDelegates* Delegates = UZLCloudPluginDelegates::GetZLCloudPluginDelegates())
-				{
-					UE_LOG(LogZLCloudPlugin, Display, TEXT("OnRecieveData OnConnect Request"));
-					Delegates->OnRecieveData.Broadcast(stateDataStr);
-				}
+				//Broadcast through OnRecieveData as before once it starts, the app's ProcessState call on it succeeds without parsing it
+				//again and it pulls the values as usual. OnStateRequestStarted is broadcast alongside it
+				UE_LOG(LogZLCloudPlugin, Display, TEXT("OnRecieveData OnConnect Request"));
+				stateManager->StartStateRequest(JsonParsed, true);
 
 				msg->SetReply("STATE_REQUESTED");
 			}
@@ -408,7 +411,7 @@ void MessageCallbacks::SetConnectState(MessageWithData* msg)
 	}
 	else
 	{
-		UE_LOG(LogZLCloudPlugin, Display, TEXT("Connect state data could not be parsed"));
+		UE_LOG(LogZLCloudPlugin, Display, TEXT("Connect state data could not be parsed: %s"), *parseError);
 		if(defaultStateOnly)
 			msg->SetReply("STATE_READY");
 		else
@@ -22,6 +22,8 @@ class MessageCallbacks
 		static void SetConnectState(MessageWithData* msg);
 		static void SetOnDemandProcessingState(MessageWithData* msg);
 		static void SetOmnistreamSettings(MessageWithData* msg);
+		static void GetStateFingerprint(MessageWithData* msg);
+		static void GetStateKeyMetrics(MessageWithData* msg);
 
 		//Cert effects
 		static void GetAllUiDetailsForZlCertifiedEffects(MessageWithData* msg);
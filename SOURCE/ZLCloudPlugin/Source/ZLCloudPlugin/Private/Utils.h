@@ -17,15 +17,15 @@ namespace ZLCloudPluginUtils
 #if UNREAL_5_1_OR_NEWER
 
 #if UNREAL_5_5_OR_NEWER
-	inline FTextureRHIRef CreateTexture(uint32 Width, uint32 Height)
+	inline FTextureRHIRef CreateTexture(uint32 Width, uint32 Height, EPixelFormat Format = EPixelFormat::PF_R8G8B8A8)
 #else
-	inline FTexture2DRHIRef CreateTexture(uint32 Width, uint32 Height)
+	inline FTexture2DRHIRef CreateTexture(uint32 Width, uint32 Height, EPixelFormat Format = EPixelFormat::PF_R8G8B8A8)
 #endif
 	{
 
 		// Create empty texture
 		FRHITextureCreateDesc TextureDesc =
-			FRHITextureCreateDesc::Create2D(TEXT("ZLCloudPluginBlankTexture"), Width, Height, EPixelFormat::PF_R8G8B8A8)
+			FRHITextureCreateDesc::Create2D(TEXT("ZLCloudPluginBlankTexture"), Width, Height, Format)
 			.SetClearValue(FClearValueBinding::None)
 			.SetFlags(ETextureCreateFlags::RenderTargetable)
 			.SetInitialState(ERHIAccess::Present)
@@ -54,8 +54,9 @@ namespace ZLCloudPluginUtils
  * Copy from one texture to another.
  * Assumes SourceTexture is in ERHIAccess::CopySrc and DestTexture is in ERHIAccess::CopyDest
  * Fence can be nullptr if no fence is to be used.
+ * A resizing copy is point sampled unless bBilinear is set, DownscaleTexture sets it for its passes.
  */
-	inline void CopyTexture(FRHICommandList& RHICmdList, FTextureRHIRef SourceTexture, FTextureRHIRef DestTexture, FRHIGPUFence* Fence)
+	inline void CopyTexture(FRHICommandList& RHICmdList, FTextureRHIRef SourceTexture, FTextureRHIRef DestTexture, FRHIGPUFence* Fence, bool bBilinear = false)
 	{
 		if (SourceTexture->GetDesc().Format == DestTexture->GetDesc().Format
 			&& SourceTexture->GetDesc().Extent.X == DestTexture->GetDesc().Extent.X
@@ -96,10 +97,11 @@ namespace ZLCloudPluginUtils
 				GraphicsPSOInit.PrimitiveType = PT_TriangleList;
 				SetGraphicsPipelineState(RHICmdList, GraphicsPSOInit, 0);
 
+				FRHISamplerState* SamplerState = bBilinear ? TStaticSamplerState<SF_Bilinear>::GetRHI() : TStaticSamplerState<SF_Point>::GetRHI();
 #if UNREAL_5_5_OR_NEWER
-				SetShaderParametersLegacyPS(RHICmdList, PixelShader, TStaticSamplerState<SF_Point>::GetRHI(), SourceTexture);
+				SetShaderParametersLegacyPS(RHICmdList, PixelShader, SamplerState, SourceTexture);
 #else
-				PixelShader->SetParameters(RHICmdList, TStaticSamplerState<SF_Point>::GetRHI(), SourceTexture);
+				PixelShader->SetParameters(RHICmdList, SamplerState, SourceTexture);
 #endif
 
 
@@ -125,6 +127,47 @@ namespace ZLCloudPluginUtils
 			RHICmdList.WriteGPUFence(Fence);
 		}
 	}
+
+	/*
+	 * Sizes to downscale From through to reach To, the last entry being To. Each pass at most halves the size, so every
+	 * bilinear sample lands between the source texels it covers (at exactly half it is a 2x2 box filter) and none are skipped.
+	 */
+	inline void GetDownscalePasses(FIntPoint From, FIntPoint To, TArray<FIntPoint>& OutPasses)
+	{
+		OutPasses.Reset();
+		while (From.X > To.X * 2 || From.Y > To.Y * 2)
+		{
+			From = FIntPoint(FMath::Max(To.X, FMath::DivideAndRoundUp(From.X, 2)), FMath::Max(To.Y, FMath::DivideAndRoundUp(From.Y, 2)));
+			OutPasses.Add(From);
+		}
+		OutPasses.Add(To);
+	}
+
+	/*
+	 * Downscales SourceTexture into DestTexture through the passes GetDownscalePasses gives, sampled bilinearly so it doesn't alias.
+	 * ScratchTextures holds the intermediate sizes between calls and is reallocated when they change.
+	 */
+	inline void DownscaleTexture(FRHICommandList& RHICmdList, FTextureRHIRef SourceTexture, FTextureRHIRef DestTexture, TArray<FTextureRHIRef>& ScratchTextures)
+	{
+		TArray<FIntPoint> Passes;
+		GetDownscalePasses(SourceTexture->GetDesc().Extent, DestTexture->GetDesc().Extent, Passes);
+
+		ScratchTextures.SetNum(Passes.Num() - 1);
+		for (int32 Pass = 0; Pass < Passes.Num() - 1; ++Pass)
+		{
+			if (!ScratchTextures[Pass] || ScratchTextures[Pass]->GetDesc().Extent != Passes[Pass])
+			{
+				ScratchTextures[Pass] = CreateTexture(Passes[Pass].X, Passes[Pass].Y);
+			}
+		}
+
+		for (int32 Pass = 0; Pass < Passes.Num(); ++Pass)
+		{
+			FTextureRHIRef PassDest = Pass < Passes.Num() - 1 ? ScratchTextures[Pass] : DestTexture;
+			CopyTexture(RHICmdList, SourceTexture, PassDest, nullptr, true);
+			SourceTexture = PassDest;
+		}
+	}
 	
 #else
 	
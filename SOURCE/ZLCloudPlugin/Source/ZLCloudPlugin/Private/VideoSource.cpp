@@ -5,6 +5,8 @@
 #if UNREAL_5_1_OR_NEWER
 
 #include "CloudStream2.h"
+#include "EditorZLCloudPluginSettings.h"
+#include "Utils.h"
 
 #include "PixelCaptureBufferFormat.h"
 #include "PixelCaptureOutputFrameRHI.h"
@@ -12,28 +14,135 @@
 
 namespace ZLCloudPlugin
 {
-	FVideoSource::FVideoSource(TSharedPtr<FZLCloudPluginVideoInput> InVideoInput, const TFunction<bool()>& InShouldGenerateFramesCheck)
+	FVideoSource::FVideoSource(TSharedPtr<FZLCloudPluginVideoInput> InVideoInput, const TFunction<bool()>& InShouldGenerateFramesCheck, TSharedRef<IFramePacerClock> InClock)
 		: VideoInput(InVideoInput)
 		, ShouldGenerateFramesCheck(InShouldGenerateFramesCheck)
+		, FrameQueue(InClock)
 	{
+		const UZLCloudPluginSettings* Settings = GetDefault<UZLCloudPluginSettings>();
+		check(Settings);
+
+		EFrameBudgetPolicy BudgetPolicy = EFrameBudgetPolicy::DropOldest;
+		switch (Settings->FrameBudgetPolicy)
+		{
+		case EZLFrameBudgetPolicy::DropNewest:
+			BudgetPolicy = EFrameBudgetPolicy::DropNewest;
+			break;
+		case EZLFrameBudgetPolicy::BlockWithTimeout:
+			BudgetPolicy = EFrameBudgetPolicy::BlockWithTimeout;
+			break;
+		default:
+			break;
+		}
+		FrameQueue.SetBudget(Settings->MaxInFlightFrames, BudgetPolicy, Settings->FrameBudgetBlockTimeoutMs / 1000.0);
+	}
+
+	void FVideoSource::OnFrameCaptured()
+	{
+		if (!VideoInput->IsReady() || !ShouldGenerateFramesCheck())
+		{
+			return;
+		}
+
+		// Runs in the capture complete callback, on the RHI thread for GPU captures. The copy is recorded on the immediate
+		// command list from there, as CloudStream2::OnFrame does from the frame thread, and only for a frame the budget admits.
+		FrameQueue.Push([this]() { return CopyFrameForQueue(RequestFrame()); });
 	}
 
-	void FVideoSource::MaybePushFrame()
+	void FVideoSource::MaybePushFrame(double NowSeconds, double TargetIntervalMs)
 	{
-		if (VideoInput->IsReady() && ShouldGenerateFramesCheck())
+		if (!VideoInput->IsReady() || !ShouldGenerateFramesCheck())
+		{
+			// Paused or not started, no frame was owed this tick
+			PacingTracker.OnPaused();
+			return;
+		}
+
+		if (PushFrame())
 		{
-			PushFrame();
+			PacingTracker.OnFramePushed(NowSeconds, TargetIntervalMs);
+		}
+		else
+		{
+			PacingTracker.OnFrameMissed();
 		}
 	}
 
-	void FVideoSource::PushFrame()
+	bool FVideoSource::PushFrame()
 	{
-		TSharedPtr<IPixelCaptureOutputFrame> OutputFrame = VideoInput->RequestFormat(PixelCaptureBufferFormat::FORMAT_RHI);
+		TSharedPtr<IPixelCaptureOutputFrame> OutputFrame = FrameQueue.Pop();
+		if (!OutputFrame)
+		{
+			// Nothing new was captured since the last push, resend the latest frame to hold the stream framerate
+			OutputFrame = RequestFrame();
+		}
+
 		if (OutputFrame)
 		{
 			FPixelCaptureOutputFrameRHI* RHISourceFrame = StaticCast<FPixelCaptureOutputFrameRHI*>(OutputFrame.Get());
 			CloudStream2::OnFrame(RHISourceFrame->GetFrameTexture());
+			return true;
+		}
+		return false;
+	}
+
+	TSharedPtr<IPixelCaptureOutputFrame> FVideoSource::CopyFrameForQueue(const TSharedPtr<IPixelCaptureOutputFrame>& Frame)
+	{
+		if (!Frame)
+		{
+			return nullptr;
+		}
+
+		FTextureRHIRef SourceTexture = StaticCast<FPixelCaptureOutputFrameRHI*>(Frame.Get())->GetFrameTexture();
+		if (!SourceTexture)
+		{
+			return nullptr;
+		}
+
+		const FRHITextureDesc& SourceDesc = SourceTexture->GetDesc();
+
+		// Only QueuedTextures references a free texture, queued frames and the frame being handed to the encoder hold the rest.
+		// The encoder's copy out of a texture is queued on the GPU before any later copy into it, so reusing it here is safe.
+		FTextureRHIRef QueuedTexture;
+		for (int32 Index = 0; Index < QueuedTextures.Num(); ++Index)
+		{
+			if (QueuedTextures[Index]->GetRefCount() == 1)
+			{
+				if (QueuedTextures[Index]->GetDesc().Extent != SourceDesc.Extent || QueuedTextures[Index]->GetDesc().Format != SourceDesc.Format)
+				{
+					QueuedTextures[Index] = ZLCloudPluginUtils::CreateTexture(SourceDesc.Extent.X, SourceDesc.Extent.Y, SourceDesc.Format);
+				}
+				QueuedTexture = QueuedTextures[Index];
+				break;
+			}
+		}
+
+		if (!QueuedTexture)
+		{
+			// At most MaxInFlightFrames queued, one held by BlockWithTimeout or being copied over the oldest, and one with the encoder
+			QueuedTexture = ZLCloudPluginUtils::CreateTexture(SourceDesc.Extent.X, SourceDesc.Extent.Y, SourceDesc.Format);
+			QueuedTextures.Add(QueuedTexture);
+		}
+
+		FRHICommandListImmediate& RHICmdList = FRHICommandListExecutor::GetImmediateCommandList();
+		ZLCloudPluginUtils::CopyTexture(RHICmdList, SourceTexture, QueuedTexture, nullptr);
+
+		return MakeShared<FPixelCaptureOutputFrameRHI>(QueuedTexture);
+	}
+
+	TSharedPtr<IPixelCaptureOutputFrame> FVideoSource::RequestFrame()
+	{
+		// With simulcast layers configured, stream the smallest one that still covers what the encoder asked for so the
+		// copy into the encoder's texture has little or no scaling left to do. Requesting it every frame keeps it produced.
+		const int32 LayerIndex = VideoInput->FindLayerForResolution(CloudStream2::GetEncoderResolution());
+		if (LayerIndex > 0)
+		{
+			if (TSharedPtr<IPixelCaptureOutputFrame> LayerFrame = VideoInput->RequestLayerFormat(PixelCaptureBufferFormat::FORMAT_RHI, LayerIndex))
+			{
+				return LayerFrame;
+			}
 		}
+		return VideoInput->RequestFormat(PixelCaptureBufferFormat::FORMAT_RHI);
 	}
 } // namespace ZLCloudPlugin
 
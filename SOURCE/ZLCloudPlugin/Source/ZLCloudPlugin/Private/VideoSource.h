@@ -6,22 +6,49 @@
 #if UNREAL_5_1_OR_NEWER
 
 #include "ZLCloudPluginVideoInput.h"
+#include "FramePacer.h"
+#include "FrameBudgetQueue.h"
 
 namespace ZLCloudPlugin
 {
 	class FVideoSource
 	{
 	public:
-		FVideoSource(TSharedPtr<FZLCloudPluginVideoInput> InVideoInput, const TFunction<bool()>& InShouldGenerateFramesCheck);
+		FVideoSource(TSharedPtr<FZLCloudPluginVideoInput> InVideoInput, const TFunction<bool()>& InShouldGenerateFramesCheck, TSharedRef<IFramePacerClock> InClock = MakeShared<FPlatformFramePacerClock>());
 		virtual ~FVideoSource() = default;
 
-		void MaybePushFrame();
+		// Producer side, queues the newly captured frame within this source's in-flight frame budget.
+		void OnFrameCaptured();
+
+		void MaybePushFrame(double NowSeconds, double TargetIntervalMs);
+
+		// Interval stats between frames this source actually pushed. Skipped counts ticks where a frame was due and it had none.
+		const FFramePacingStats& GetPacingStats() const { return PacingTracker.GetStats(); }
+		void ResetPacingStats() { PacingTracker.Reset(); }
+
+		FFrameQueueStats GetQueueStats() const { return FrameQueue.GetStats(); }
+		void ResetQueueStats() { FrameQueue.ResetStats(); }
 
 	private:
 		TSharedPtr<FZLCloudPluginVideoInput> VideoInput;
 		TFunction<bool()> ShouldGenerateFramesCheck;
 
-		void PushFrame();
+		FFramePushTracker PacingTracker;
+
+		// Frames captured but not yet handed to the encoder
+		FFrameBudgetQueue FrameQueue;
+
+		// Textures the queued frames are copied into. The capturer recycles its own output frames, so queueing those would let
+		// a later capture overwrite a frame still waiting. A texture only referenced from here is free for the next copy.
+		TArray<FTextureRHIRef> QueuedTextures;
+
+		bool PushFrame();
+
+		// Copies Frame into a free texture of QueuedTextures, nullptr if it isn't an RHI frame
+		TSharedPtr<IPixelCaptureOutputFrame> CopyFrameForQueue(const TSharedPtr<IPixelCaptureOutputFrame>& Frame);
+
+		// Latest frame of the layer that best fits the encoder, falling back to the full capture while that layer wakes up
+		TSharedPtr<IPixelCaptureOutputFrame> RequestFrame();
 	};
 } // namespace ZLCloudPlugin
 
@@ -10,6 +10,51 @@
 
 namespace ZLCloudPlugin
 {
+	namespace
+	{
+		// Live groups, so the console commands can reach their pacing stats
+		FCriticalSection GVideoSourceGroupsCriticalSection;
+		TArray<FVideoSourceGroup*> GVideoSourceGroups;
+
+		FAutoConsoleCommandWithOutputDevice GDumpFramePacingCommand(
+			TEXT("ZLCloudPlugin.FramePacing.Dump"),
+			TEXT("Logs frame interval jitter histograms, late ticks and skipped frames for the stream frame thread and each video source"),
+			FConsoleCommandWithOutputDeviceDelegate::CreateLambda([](FOutputDevice& Ar) {
+				FScopeLock Lock(&GVideoSourceGroupsCriticalSection);
+				for (int32 GroupIndex = 0; GroupIndex < GVideoSourceGroups.Num(); ++GroupIndex)
+				{
+					Ar.Logf(TEXT("Video source group %d (%d fps)"), GroupIndex, GVideoSourceGroups[GroupIndex]->GetFPS());
+					GVideoSourceGroups[GroupIndex]->DumpPacingStats(Ar);
+				}
+			}));
+
+		FAutoConsoleCommandWithOutputDevice GDumpSimulcastCommand(
+			TEXT("ZLCloudPlugin.Simulcast.Dump"),
+			TEXT("Logs resolution, produced/skipped frame counts and capture cost of each simulcast layer"),
+			FConsoleCommandWithOutputDeviceDelegate::CreateLambda([](FOutputDevice& Ar) {
+				FScopeLock Lock(&GVideoSourceGroupsCriticalSection);
+				for (int32 GroupIndex = 0; GroupIndex < GVideoSourceGroups.Num(); ++GroupIndex)
+				{
+					if (TSharedPtr<FZLCloudPluginVideoInput> GroupVideoInput = GVideoSourceGroups[GroupIndex]->GetVideoInput())
+					{
+						Ar.Logf(TEXT("Video source group %d"), GroupIndex);
+						GroupVideoInput->DumpSimulcastStats(Ar);
+					}
+				}
+			}));
+
+		FAutoConsoleCommand GResetFramePacingCommand(
+			TEXT("ZLCloudPlugin.FramePacing.Reset"),
+			TEXT("Clears the frame pacing stats of every video source group"),
+			FConsoleCommandDelegate::CreateLambda([]() {
+				FScopeLock Lock(&GVideoSourceGroupsCriticalSection);
+				for (FVideoSourceGroup* VideoSourceGroup : GVideoSourceGroups)
+				{
+					VideoSourceGroup->ResetPacingStats();
+				}
+			}));
+	}
+
 	TSharedPtr<FVideoSourceGroup> FVideoSourceGroup::Create()
 	{
 		return TSharedPtr<FVideoSourceGroup>(new FVideoSourceGroup());
@@ -22,10 +67,18 @@ namespace ZLCloudPlugin
 		const UZLCloudPluginSettings* Settings = GetDefault<UZLCloudPluginSettings>();
 		check(Settings);
 		FramesPerSecond = Settings->FramesPerSecond;
+
+		FScopeLock Lock(&GVideoSourceGroupsCriticalSection);
+		GVideoSourceGroups.Add(this);
 	}
 
 	FVideoSourceGroup::~FVideoSourceGroup()
 	{
+		{
+			FScopeLock Lock(&GVideoSourceGroupsCriticalSection);
+			GVideoSourceGroups.Remove(this);
+		}
+
 		Stop();
 	}
 
@@ -62,7 +115,7 @@ namespace ZLCloudPlugin
 
 	FVideoSource* FVideoSourceGroup::CreateVideoSource(const TFunction<bool()>& InShouldGenerateFramesCheck)
 	{
-		FVideoSource* NewVideoSource = new FVideoSource(VideoInput, InShouldGenerateFramesCheck);
+		FVideoSource* NewVideoSource = new FVideoSource(VideoInput, InShouldGenerateFramesCheck, Clock);
 		{
 			FScopeLock Lock(&CriticalSection);
 			VideoSources.Add(NewVideoSource);
@@ -116,19 +169,73 @@ namespace ZLCloudPlugin
 
 	void FVideoSourceGroup::Tick()
 	{
+		const double NowSeconds = Clock->GetSeconds();
+		const double TargetIntervalMs = 1000.0 / FMath::Max(FramesPerSecond, 1);
+
 		FScopeLock Lock(&CriticalSection);
 		// for each player session, push a frame
 		for (auto& VideoSource : VideoSources)
 		{
 			if (VideoSource)
 			{
-				VideoSource->MaybePushFrame();
+				VideoSource->MaybePushFrame(NowSeconds, TargetIntervalMs);
+			}
+		}
+	}
+
+	void FVideoSourceGroup::DumpPacingStats(FOutputDevice& Ar) const
+	{
+		if (FrameRunnable)
+		{
+			Ar.Logf(TEXT("  Frame thread: %s"), *FrameRunnable->Pacer.GetStats().ToString());
+		}
+
+		FScopeLock Lock(&CriticalSection);
+		for (int32 SourceIndex = 0; SourceIndex < VideoSources.Num(); ++SourceIndex)
+		{
+			if (VideoSources[SourceIndex])
+			{
+				Ar.Logf(TEXT("  Source %d: %s"), SourceIndex, *VideoSources[SourceIndex]->GetPacingStats().ToString());
+				Ar.Logf(TEXT("  Source %d queue: %s"), SourceIndex, *VideoSources[SourceIndex]->GetQueueStats().ToString());
+			}
+		}
+	}
+
+	void FVideoSourceGroup::ResetPacingStats()
+	{
+		if (FrameRunnable)
+		{
+			FrameRunnable->Pacer.ResetStats();
+		}
+
+		FScopeLock Lock(&CriticalSection);
+		for (FVideoSource* VideoSource : VideoSources)
+		{
+			if (VideoSource)
+			{
+				VideoSource->ResetPacingStats();
+				VideoSource->ResetQueueStats();
 			}
 		}
 	}
 
 	void FVideoSourceGroup::OnFrameCaptured()
 	{
+		// Copied so a source blocking on its frame budget doesn't hold the lock Tick needs to drain it
+		TArray<FVideoSource*> SourcesToFeed;
+		{
+			FScopeLock Lock(&CriticalSection);
+			SourcesToFeed = VideoSources;
+		}
+
+		for (FVideoSource* VideoSource : SourcesToFeed)
+		{
+			if (VideoSource)
+			{
+				VideoSource->OnFrameCaptured();
+			}
+		}
+
 		if (bCoupleFramerate)
 		{
 			Tick();
@@ -149,11 +256,16 @@ namespace ZLCloudPlugin
 	{
 		if (!bCoupleFramerate && !bThreadRunning)
 		{
+			const UZLCloudPluginSettings* Settings = GetDefault<UZLCloudPluginSettings>();
+			const EFramePacingPolicy PacingPolicy = Settings->FramePacingPolicy == EZLFramePacingPolicy::CatchUp ? EFramePacingPolicy::CatchUp : EFramePacingPolicy::Skip;
+
 #if UNREAL_5_7_OR_NEWER
-			FrameRunnable = MakeUnique<FFrameThread>(AsWeak());
+			FrameRunnable = MakeUnique<FFrameThread>(AsWeak(), Clock);
+			FrameRunnable->Pacer.SetPolicy(PacingPolicy, Settings->MaxCatchUpFrames);
 			FrameThread = FRunnableThread::Create(FrameRunnable.Get(), TEXT("FVideoSourceGroup Thread"), 0, TPri_TimeCritical);
 #else
-			FrameRunnable = MakeUnique<FFrameThread>(this);
+			FrameRunnable = MakeUnique<FFrameThread>(this, Clock);
+			FrameRunnable->Pacer.SetPolicy(PacingPolicy, Settings->MaxCatchUpFrames);
 			FrameThread = FRunnableThread::Create(FrameRunnable.Get(), TEXT("FVideoSourceGroup Thread"));	
 #endif
 			bThreadRunning = true;
@@ -200,53 +312,37 @@ namespace ZLCloudPlugin
 #if UNREAL_5_7_OR_NEWER
 			if(TSharedPtr<FVideoSourceGroup> VideoSourceGroup = OuterVideoSourceGroup.Pin())
 			{
-				const double TimeSinceLastSubmitMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - LastSubmitCycles);
+				Pacer.SetTargetFPS(VideoSourceGroup->FramesPerSecond);
 
 				// Decrease this value to make expected frame delivery more precise, however may result in more old frames being sent
 				const double PrecisionFactor = 0.1;
-				// ZL: Using a default wait factor since we don't have the PixelStreaming CVar
-				const double WaitFactor = 1.0;
-
-				// In "auto" mode vary this value based on historical average
-				const double TargetSubmitMs = 1000.0 / VideoSourceGroup->FramesPerSecond;
-				const double TargetSubmitMsWithPadding = TargetSubmitMs * WaitFactor;
-				const double CloseEnoughMs = TargetSubmitMs * PrecisionFactor;
-				const bool bFrameOverdue = TimeSinceLastSubmitMs >= TargetSubmitMsWithPadding;
+				const double CloseEnoughSeconds = Pacer.GetFramePeriodSeconds() * PrecisionFactor;
 
-				// Check frame arrived in time
-				if(!bFrameOverdue)
+				// Sleep until the next absolute deadline. A captured frame wakes us early, but we only submit once the deadline is close enough.
+				double WaitSeconds = Pacer.GetTimeUntilDeadline();
+				while (bIsRunning && WaitSeconds > CloseEnoughSeconds)
 				{
-					// Frame arrived in a timely fashion, but is it too soon to maintain our target rate? If so, sleep.
-					double WaitTimeRemainingMs = TargetSubmitMsWithPadding - TimeSinceLastSubmitMs;
-					if(WaitTimeRemainingMs > CloseEnoughMs)
+					bool bGotNewFrame = FrameEvent.Get()->Wait(FTimespan::FromSeconds(WaitSeconds));
+					if(!bGotNewFrame)
 					{
-						bool bGotNewFrame = FrameEvent.Get()->Wait(WaitTimeRemainingMs);
-						if(!bGotNewFrame)
-						{
-							UE_LOG(LogZLCloudPlugin, VeryVerbose, TEXT("Old frame submitted"));
-						}
+						UE_LOG(LogZLCloudPlugin, VeryVerbose, TEXT("Old frame submitted"));
 					}
+					WaitSeconds = Pacer.GetTimeUntilDeadline();
 				}
 
-				// Push frame immediately
 				PushFrame(VideoSourceGroup);
-
 			}
 #else
-			uint64 PreTickCycles = FPlatformTime::Cycles64();
+			Pacer.SetTargetFPS(TickGroup->FramesPerSecond);
 
-			PushFrame();
-
-			const double DeltaMs = FPlatformTime::ToMilliseconds64(LastTickCycles - PreTickCycles);
-			const double FrameDeltaMs = 1000.0 / TickGroup->FramesPerSecond;
-			const double SleepMs = FrameDeltaMs - DeltaMs;
-			PreTickCycles = LastTickCycles;
-
-			// Sleep as long as we need for a constant FPS
-			if (SleepMs > 0)
+			// Sleep until the next absolute deadline, lateness in this tick is absorbed by the next one rather than carried forward
+			const double WaitSeconds = Pacer.GetTimeUntilDeadline();
+			if (WaitSeconds > 0.0)
 			{
-				FPlatformProcess::Sleep(static_cast<float>(SleepMs / 1000.0));
+				FPlatformProcess::Sleep(static_cast<float>(WaitSeconds));
 			}
+
+			PushFrame();
 #endif
 		}
 		
@@ -273,10 +369,8 @@ namespace ZLCloudPlugin
 	{
 		if(TSharedPtr<FVideoSourceGroup> VideoSourceGroup = OuterVideoSourceGroup.Pin())
 		{
-			const uint64 NowCycles = FPlatformTime::Cycles64();
-			const double DeltaMs = FPlatformTime::ToMilliseconds64(NowCycles - LastSubmitCycles);
-			const double TargetSubmitMs = 1000.0 / VideoSourceGroup->FramesPerSecond;
-			if (DeltaMs >= TargetSubmitMs)
+			Pacer.SetTargetFPS(VideoSourceGroup->FramesPerSecond);
+			if (Pacer.GetTimeUntilDeadline() <= 0.0)
 			{
 				PushFrame(VideoSourceGroup);
 			}
@@ -286,25 +380,15 @@ namespace ZLCloudPlugin
 	void FVideoSourceGroup::FFrameThread::PushFrame(TSharedPtr<FVideoSourceGroup> VideoSourceGroup)
 	{
 		VideoSourceGroup->Tick();
-		LastSubmitCycles = FPlatformTime::Cycles64();
-	}
-
-	double FVideoSourceGroup::FFrameThread::CalculateSleepOffsetMs(double TargetSubmitMs, uint64 LastCaptureCycles, uint64 CyclesBetweenCaptures, bool& bResetOffset) const
-	{
-		// This method is defined for API compatibility but not currently used in the Run() method
-		// It could be used for more advanced timing adjustments in the future
-		bResetOffset = false;
-		return 0.0;
+		Pacer.OnFrameSubmitted();
 	}
 	
 #else
 
 	void FVideoSourceGroup::FFrameThread::Tick()
 	{
-		const uint64 NowCycles = FPlatformTime::Cycles64();
-		const double DeltaMs = FPlatformTime::ToMilliseconds64(NowCycles - LastTickCycles);
-		const double FrameDeltaMs = 1000.0 / TickGroup->FramesPerSecond;
-		if (DeltaMs >= FrameDeltaMs)
+		Pacer.SetTargetFPS(TickGroup->FramesPerSecond);
+		if (Pacer.GetTimeUntilDeadline() <= 0.0)
 		{
 			PushFrame();
 		}
@@ -313,7 +397,7 @@ namespace ZLCloudPlugin
 	void FVideoSourceGroup::FFrameThread::PushFrame()
 	{
 		TickGroup->Tick();
-		LastTickCycles = FPlatformTime::Cycles64();
+		Pacer.OnFrameSubmitted();
 	}
 		
 #endif
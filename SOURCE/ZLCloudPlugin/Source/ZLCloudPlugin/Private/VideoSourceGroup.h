@@ -10,6 +10,7 @@
 #include "Misc/SingleThreadRunnable.h"
 #include "Templates/SharedPointer.h"
 #include "VideoSource.h"
+#include "FramePacer.h"
 #include "ZLCloudpluginVideoInput.h"
 
 #if UNREAL_5_7_OR_NEWER
@@ -31,6 +32,12 @@ namespace ZLCloudPlugin
 
 		void SetCoupleFramerate(bool Couple);
 
+		// Time source used for frame pacing and interval stats, only expected to be replaced before Start.
+		void SetClock(TSharedRef<IFramePacerClock> InClock) { Clock = InClock; }
+
+		void DumpPacingStats(FOutputDevice& Ar) const;
+		void ResetPacingStats();
+
 		FVideoSource* CreateVideoSource(const TFunction<bool()>& InShouldGenerateFramesCheck);
 		void RemoveVideoSource(const FVideoSource* ToRemove);
 		void RemoveAllVideoSources();
@@ -52,13 +59,15 @@ namespace ZLCloudPlugin
 		{
 		public:
 #if UNREAL_5_7_OR_NEWER
-			FFrameThread(TWeakPtr<FVideoSourceGroup> InVideoSourceGroup)
+			FFrameThread(TWeakPtr<FVideoSourceGroup> InVideoSourceGroup, TSharedRef<IFramePacerClock> InClock)
 				: OuterVideoSourceGroup(InVideoSourceGroup)
+				, Pacer(InClock)
 			{
 			}
 #else
-			FFrameThread(FVideoSourceGroup* InTickGroup)
+			FFrameThread(FVideoSourceGroup* InTickGroup, TSharedRef<IFramePacerClock> InClock)
 			: TickGroup(InTickGroup)
+			, Pacer(InClock)
 			{
 			}		
 #endif
@@ -79,11 +88,9 @@ namespace ZLCloudPlugin
 			
 #if UNREAL_5_7_OR_NEWER
 			void PushFrame(TSharedPtr<FVideoSourceGroup> VideoSourceGroup);
-			double CalculateSleepOffsetMs(double TargetSubmitMs, uint64 LastCaptureCycles, uint64 CyclesBetweenCaptures, bool& bResetOffset) const;
 
 			bool bIsRunning = false;
 			TWeakPtr<FVideoSourceGroup> OuterVideoSourceGroup = nullptr;
-			uint64 LastSubmitCycles = 0;
 
 			/* Use this event to signal when we should wake and also how long we should sleep for between transmitting a frame. */
 			FEventRef FrameEvent;
@@ -93,8 +100,10 @@ namespace ZLCloudPlugin
 
 			bool bIsRunning = false;
 			FVideoSourceGroup* TickGroup = nullptr;
-			uint64 LastTickCycles = 0;
 #endif
+
+			/* Absolute deadline schedule for frame submission, deadlines don't drift when a submit runs late. */
+			FFramePacer Pacer;
 		};
 
 		bool bRunning = false;
@@ -105,6 +114,7 @@ namespace ZLCloudPlugin
 		TUniquePtr<FFrameThread> FrameRunnable;
 		FRunnableThread* FrameThread = nullptr; // constant FPS tick thread
 		TArray<FVideoSource*> VideoSources;
+		TSharedRef<IFramePacerClock> Clock = MakeShared<FPlatformFramePacerClock>();
 
 		FDelegateHandle FrameDelegateHandle;
 
@@ -0,0 +1,330 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#include "ZLAudioFormatConverter.h"
+#include "Math/UnrealMathUtility.h"
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS_NEON
+#include <arm_neon.h>
+#elif PLATFORM_ENABLE_VECTORINTRINSICS && PLATFORM_CPU_X86_FAMILY
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	int32 GreatestCommonDivisor(int32 A, int32 B)
+	{
+		while (B != 0)
+		{
+			const int32 Remainder = A % B;
+			A = B;
+			B = Remainder;
+		}
+		return A;
+	}
+}
+
+/*
+* ---------------- FZLAudioResampler -------------------------
+*/
+
+FZLAudioResampler::FZLAudioResampler()
+{
+}
+
+void FZLAudioResampler::Init(int32 InInputSampleRate, int32 InOutputSampleRate, int32 InNumChannels)
+{
+	InputSampleRate = InInputSampleRate;
+	OutputSampleRate = InOutputSampleRate;
+	NumChannels = InNumChannels;
+
+	if (InputSampleRate > 0 && OutputSampleRate > 0 && InputSampleRate != OutputSampleRate)
+	{
+		const int32 Divisor = GreatestCommonDivisor(InputSampleRate, OutputSampleRate);
+		UpFactor = OutputSampleRate / Divisor;
+		DownFactor = InputSampleRate / Divisor;
+		TapsPerPhase = FMath::Min(BaseTapsPerPhase * FMath::DivideAndRoundUp(DownFactor, UpFactor), MaxTapsPerPhase);
+		BuildFilter();
+	}
+	else
+	{
+		UpFactor = 1;
+		DownFactor = 1;
+		NumPhases = 1;
+		TapsPerPhase = BaseTapsPerPhase;
+		Coefficients.Empty();
+	}
+
+	Reset();
+}
+
+void FZLAudioResampler::Reset()
+{
+	Phase = 0;
+	InputIndex = TapsPerPhase - 1;
+
+	// Start with silence as history so the first output sample has a full set of taps to read
+	History.Reset();
+	History.AddZeroed((TapsPerPhase - 1) * NumChannels);
+}
+
+void FZLAudioResampler::BuildFilter()
+{
+	// Very large interpolation factors (e.g. co-prime rates) would need a huge table, so quantise to the nearest of MaxPhases instead
+	NumPhases = FMath::Min(UpFactor, MaxPhases);
+
+	const int32 FilterLength = NumPhases * TapsPerPhase;
+	const double Centre = 0.5 * (FilterLength - 1);
+
+	// Cutoff relative to the interpolated rate, kept a little under the lower of the two Nyquist frequencies to leave room for the transition band
+	const double Cutoff = 0.45 * FMath::Min(1.0, static_cast<double>(UpFactor) / DownFactor) / NumPhases;
+
+	Coefficients.SetNumUninitialized(FilterLength);
+
+	for (int32 Row = 0; Row < NumPhases; ++Row)
+	{
+		double RowSum = 0.0;
+		for (int32 Tap = 0; Tap < TapsPerPhase; ++Tap)
+		{
+			const int32 N = Row + Tap * NumPhases;
+			const double X = 2.0 * PI * Cutoff * (N - Centre);
+			const double Sinc = FMath::IsNearlyZero(X) ? 1.0 : FMath::Sin(X) / X;
+
+			// Blackman window
+			const double WindowPos = static_cast<double>(N) / (FilterLength - 1);
+			const double Window = 0.42 - 0.5 * FMath::Cos(2.0 * PI * WindowPos) + 0.08 * FMath::Cos(4.0 * PI * WindowPos);
+
+			const double Coefficient = Sinc * Window;
+			Coefficients[Row * TapsPerPhase + Tap] = static_cast<float>(Coefficient);
+			RowSum += Coefficient;
+		}
+
+		// Normalise every phase to unity gain so there is no amplitude ripple between phases
+		if (!FMath::IsNearlyZero(RowSum))
+		{
+			const float RowScale = static_cast<float>(1.0 / RowSum);
+			for (int32 Tap = 0; Tap < TapsPerPhase; ++Tap)
+			{
+				Coefficients[Row * TapsPerPhase + Tap] *= RowScale;
+			}
+		}
+	}
+}
+
+void FZLAudioResampler::Process(const float* InAudio, int32 NumFrames, TArray<float>& OutAudio)
+{
+	if (NumFrames <= 0 || NumChannels <= 0)
+	{
+		return;
+	}
+
+	if (IsPassthrough())
+	{
+		OutAudio.Append(InAudio, NumFrames * NumChannels);
+		return;
+	}
+
+	History.Append(InAudio, NumFrames * NumChannels);
+	const int32 NumHistoryFrames = History.Num() / NumChannels;
+
+	const int64 ExpectedFrames = (static_cast<int64>(NumHistoryFrames - InputIndex) * UpFactor) / DownFactor + 1;
+	OutAudio.Reserve(OutAudio.Num() + static_cast<int32>(ExpectedFrames) * NumChannels);
+
+	const float* Samples = History.GetData();
+	while (InputIndex < NumHistoryFrames)
+	{
+		const int32 PhaseRow = (NumPhases == UpFactor) ? Phase : static_cast<int32>((static_cast<int64>(Phase) * NumPhases) / UpFactor);
+		const float* Taps = &Coefficients[PhaseRow * TapsPerPhase];
+
+		const int32 OutStart = OutAudio.AddZeroed(NumChannels);
+		float* Out = OutAudio.GetData() + OutStart;
+
+		for (int32 Tap = 0; Tap < TapsPerPhase; ++Tap)
+		{
+			const float* Frame = Samples + (InputIndex - Tap) * NumChannels;
+			const float Coefficient = Taps[Tap];
+			for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+			{
+				Out[Channel] += Coefficient * Frame[Channel];
+			}
+		}
+
+		Phase += DownFactor;
+		InputIndex += Phase / UpFactor;
+		Phase %= UpFactor;
+	}
+
+	// Only keep the frames the filter can still reach
+	const int32 FramesToDrop = FMath::Min(InputIndex - (TapsPerPhase - 1), NumHistoryFrames);
+	if (FramesToDrop > 0)
+	{
+		History.RemoveAt(0, FramesToDrop * NumChannels, false);
+		InputIndex -= FramesToDrop;
+	}
+}
+
+/*
+* ---------------- FZLAudioFormatConverter -------------------------
+*/
+
+void FZLAudioFormatConverter::SetOutputFormat(int32 InSampleRate, int32 InNumChannels)
+{
+	if (InSampleRate != OutputSampleRate || InNumChannels != OutputNumChannels)
+	{
+		OutputSampleRate = InSampleRate;
+		OutputNumChannels = InNumChannels;
+
+		// Forces the resampler to be rebuilt on the next Convert
+		Resampler.Init(0, 0, 0);
+	}
+}
+
+void FZLAudioFormatConverter::Reset()
+{
+	Resampler.Reset();
+}
+
+void FZLAudioFormatConverter::Convert(const int16_t* AudioData, int32 InSampleRate, int32 InNumChannels, int32 NumFrames, TArray<float>& OutAudio)
+{
+	if (NumFrames <= 0 || InNumChannels <= 0 || InSampleRate <= 0)
+	{
+		return;
+	}
+
+	const int32 OutNumChannels = OutputNumChannels > 0 ? OutputNumChannels : InNumChannels;
+	const int32 OutSampleRate = OutputSampleRate > 0 ? OutputSampleRate : InSampleRate;
+
+	// Resample at the smaller channel count, so down mix before resampling and up mix afterwards
+	const int32 ResampleNumChannels = FMath::Min(InNumChannels, OutNumChannels);
+
+	if (Resampler.GetInputSampleRate() != InSampleRate || Resampler.GetOutputSampleRate() != OutSampleRate || Resampler.GetNumChannels() != ResampleNumChannels)
+	{
+		Resampler.Init(InSampleRate, OutSampleRate, ResampleNumChannels);
+	}
+
+	for (int32 FrameOffset = 0; FrameOffset < NumFrames; FrameOffset += BlockFrames)
+	{
+		const int32 NumBlockFrames = FMath::Min(BlockFrames, NumFrames - FrameOffset);
+
+		ConvertScratch.Reset(NumBlockFrames * InNumChannels);
+		ConvertScratch.AddUninitialized(NumBlockFrames * InNumChannels);
+		ConvertInt16ToFloat(AudioData + FrameOffset * InNumChannels, ConvertScratch.GetData(), NumBlockFrames * InNumChannels);
+
+		const float* ResampleInput = ConvertScratch.GetData();
+		if (OutNumChannels < InNumChannels)
+		{
+			MixScratch.Reset(NumBlockFrames * OutNumChannels);
+			MixScratch.AddUninitialized(NumBlockFrames * OutNumChannels);
+			MixChannels(ConvertScratch.GetData(), InNumChannels, MixScratch.GetData(), OutNumChannels, NumBlockFrames);
+			ResampleInput = MixScratch.GetData();
+		}
+
+		if (OutNumChannels > InNumChannels)
+		{
+			ResampleScratch.Reset();
+			Resampler.Process(ResampleInput, NumBlockFrames, ResampleScratch);
+
+			const int32 NumResampledFrames = ResampleScratch.Num() / InNumChannels;
+			const int32 OutStart = OutAudio.AddUninitialized(NumResampledFrames * OutNumChannels);
+			MixChannels(ResampleScratch.GetData(), InNumChannels, OutAudio.GetData() + OutStart, OutNumChannels, NumResampledFrames);
+		}
+		else
+		{
+			Resampler.Process(ResampleInput, NumBlockFrames, OutAudio);
+		}
+	}
+}
+
+void FZLAudioFormatConverter::ConvertInt16ToFloat(const int16_t* InAudio, float* OutAudio, int32 NumSamples)
+{
+	const float Scale = 1.0f / 32767.0f;
+	int32 Index = 0;
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS_NEON
+	const float32x4_t ScaleVec = vdupq_n_f32(Scale);
+	for (; Index + 8 <= NumSamples; Index += 8)
+	{
+		const int16x8_t Samples = vld1q_s16(InAudio + Index);
+		vst1q_f32(OutAudio + Index, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(Samples))), ScaleVec));
+		vst1q_f32(OutAudio + Index + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(Samples))), ScaleVec));
+	}
+#elif PLATFORM_ENABLE_VECTORINTRINSICS && PLATFORM_CPU_X86_FAMILY
+	const __m128 ScaleVec = _mm_set1_ps(Scale);
+	for (; Index + 8 <= NumSamples; Index += 8)
+	{
+		const __m128i Samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(InAudio + Index));
+
+		// Sign extend to 32 bits by placing each sample in the top half of a lane and shifting it back down
+		const __m128i Low = _mm_srai_epi32(_mm_unpacklo_epi16(Samples, Samples), 16);
+		const __m128i High = _mm_srai_epi32(_mm_unpackhi_epi16(Samples, Samples), 16);
+
+		_mm_storeu_ps(OutAudio + Index, _mm_mul_ps(_mm_cvtepi32_ps(Low), ScaleVec));
+		_mm_storeu_ps(OutAudio + Index + 4, _mm_mul_ps(_mm_cvtepi32_ps(High), ScaleVec));
+	}
+#endif
+
+	for (; Index < NumSamples; ++Index)
+	{
+		OutAudio[Index] = static_cast<float>(InAudio[Index]) * Scale;
+	}
+}
+
+void FZLAudioFormatConverter::MixChannels(const float* InAudio, int32 InNumChannels, float* OutAudio, int32 OutNumChannels, int32 NumFrames)
+{
+	if (InNumChannels == OutNumChannels)
+	{
+		FMemory::Memcpy(OutAudio, InAudio, NumFrames * InNumChannels * sizeof(float));
+		return;
+	}
+
+	if (InNumChannels == 1)
+	{
+		for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+		{
+			for (int32 Channel = 0; Channel < OutNumChannels; ++Channel)
+			{
+				OutAudio[Frame * OutNumChannels + Channel] = InAudio[Frame];
+			}
+		}
+	}
+	else if (OutNumChannels > InNumChannels)
+	{
+		// Extra output channels repeat the input layout
+		for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+		{
+			for (int32 Channel = 0; Channel < OutNumChannels; ++Channel)
+			{
+				OutAudio[Frame * OutNumChannels + Channel] = InAudio[Frame * InNumChannels + (Channel % InNumChannels)];
+			}
+		}
+	}
+	else
+	{
+		// Fold input channels onto the output channels and average them
+		TArray<float, TInlineAllocator<8>> ChannelGains;
+		ChannelGains.SetNumUninitialized(OutNumChannels);
+		for (int32 Channel = 0; Channel < OutNumChannels; ++Channel)
+		{
+			const int32 NumFolded = (InNumChannels - Channel + OutNumChannels - 1) / OutNumChannels;
+			ChannelGains[Channel] = 1.0f / NumFolded;
+		}
+
+		for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+		{
+			float* Out = OutAudio + Frame * OutNumChannels;
+			const float* In = InAudio + Frame * InNumChannels;
+
+			for (int32 Channel = 0; Channel < OutNumChannels; ++Channel)
+			{
+				Out[Channel] = 0.0f;
+			}
+			for (int32 Channel = 0; Channel < InNumChannels; ++Channel)
+			{
+				Out[Channel % OutNumChannels] += In[Channel];
+			}
+			for (int32 Channel = 0; Channel < OutNumChannels; ++Channel)
+			{
+				Out[Channel] *= ChannelGains[Channel];
+			}
+		}
+	}
+}
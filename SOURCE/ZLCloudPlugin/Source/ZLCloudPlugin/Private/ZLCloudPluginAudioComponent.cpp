@@ -107,20 +107,8 @@ bool UZLCloudPluginAudioComponent::WillListenToAnyPlayer()
 
 void UZLCloudPluginAudioComponent::ConsumeRawPCM(const int16_t* AudioData, int InSampleRate, size_t NChannels, size_t NFrames)
 {
-	if (SoundGenerator->GetSampleRate() != InSampleRate || SoundGenerator->GetNumChannels() != NChannels)
-	{
-		SoundGenerator->UpdateChannelsAndSampleRate(NChannels, InSampleRate);
-
-		//this is the smallest buffer size we can set without triggering internal checks to fire
-		PreferredBufferLength = FGenericPlatformMath::Max(512.0f, InSampleRate * NChannels / 100.0f);
-
-		NumChannels = NChannels;
-		Initialize(InSampleRate);
-	}
-	else
-	{
-		SoundGenerator->AddAudio(AudioData, InSampleRate, NChannels, NFrames);
-	}
+	// The sound generator resamples and remixes to its own format, so a mismatch no longer requires re-initialising the component
+	SoundGenerator->AddAudio(AudioData, InSampleRate, NChannels, NFrames);
 }
 
 void UZLCloudPluginAudioComponent::OnConsumerAdded()
@@ -170,10 +158,19 @@ void ZLWebRTCSoundGenerator::SetParameters(const FSoundGeneratorInitParams& Init
 {
 	Params = InitParams;
 	UpdateChannelsAndSampleRate(Params.NumChannels, Params.SampleRate);
+
+	// Params were overwritten above so the update may not have seen a change, make sure incoming audio targets the new format
+	FScopeLock Lock(&ConverterCriticalSection);
+	Converter.SetOutputFormat(Params.SampleRate, Params.NumChannels);
 }
 
 void ZLWebRTCSoundGenerator::EmptyBuffers()
 {
+	{
+		FScopeLock Lock(&ConverterCriticalSection);
+		Converter.Reset();
+	}
+
 	FScopeLock Lock(&CriticalSection);
 	Buffer.Empty();
 }
@@ -184,6 +181,11 @@ bool ZLWebRTCSoundGenerator::UpdateChannelsAndSampleRate(int InNumChannels, int
 	if (InNumChannels != Params.NumChannels || InSampleRate != Params.SampleRate)
 	{
 
+		{
+			FScopeLock Lock(&ConverterCriticalSection);
+			Converter.SetOutputFormat(InSampleRate, InNumChannels);
+		}
+
 		// Critical Section - empty buffer because sample rate/num channels changed
 		FScopeLock Lock(&CriticalSection);
 		Buffer.Empty();
@@ -204,22 +206,16 @@ void ZLWebRTCSoundGenerator::AddAudio(const int16_t* AudioData, int InSampleRate
 		return;
 	}
 
-	// Trigger a latent update for channels and sample rate, if required
-	bool bSampleRateOrChannelMismatch = UpdateChannelsAndSampleRate(NChannels, InSampleRate);
+	// Critical Section - convert to our output format, resampling and remixing if the incoming audio doesn't match it
+	FScopeLock ConverterLock(&ConverterCriticalSection);
 
-	// If there was a mismatch then skip this incoming audio until this the samplerate/channels update is completed on the gamethread
-	if (bSampleRateOrChannelMismatch)
-	{
-		return;
-	}
-
-	// Copy into our local TArray<int16_t> Buffer;
-	int NSamples = NFrames * NChannels;
+	ConvertedAudio.Reset();
+	Converter.Convert(AudioData, InSampleRate, NChannels, NFrames, ConvertedAudio);
 
 	// Critical Section
 	{
 		FScopeLock Lock(&CriticalSection);
-		Buffer.Append(AudioData, NSamples);
+		Buffer.Append(ConvertedAudio);
 		// checkf((uint32)Buffer.Num() < SampleRate,
 		// 	TEXT("ZLCloudStream Audio Component internal buffer is getting too big, for some reason OnGenerateAudio is not consuming samples quickly enough."))
 	}
@@ -240,13 +236,8 @@ int32 ZLWebRTCSoundGenerator::OnGenerateAudio(float* OutAudio, int32 NumSamples)
 
 		int32 NumSamplesToCopy = FGenericPlatformMath::Min(NumSamples, Buffer.Num());
 
-		// Copy from local buffer into OutAudio if we have enough samples
-		for (int SampleIndex = 0; SampleIndex < NumSamplesToCopy; SampleIndex++)
-		{
-			// Convert from int16 to float audio
-			*OutAudio = ((float)Buffer[SampleIndex]) / 32767.0f;
-			OutAudio++;
-		}
+		// Samples were already converted to float in AddAudio
+		FMemory::Memcpy(OutAudio, Buffer.GetData(), NumSamplesToCopy * sizeof(float));
 
 		// Remove front NumSamples from the local buffer
 		Buffer.RemoveAt(0, NumSamplesToCopy, false);
@@ -228,6 +228,8 @@ void ZLCloudPlugin::FZLCloudPluginModule::OnEndPIE(bool bIsSimulating)
 		stateManager->ResetCurrentAppState("");
 		stateManager->DestroyDebugUI();
 		stateManager->request_recieved_id = 0;
+		stateManager->request_coalesced_count = 0;
+		stateManager->request_superseded_count = 0;
 	}
 }
 
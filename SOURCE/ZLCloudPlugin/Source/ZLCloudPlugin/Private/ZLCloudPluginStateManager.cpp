@@ -1,6 +1,7 @@
 // Copyright ZeroLight ltd. All Rights Reserved.
 
 #include "ZLCloudPluginStateManager.h"
+#include "ZLStateJsonStream.h"
 #include "ZLScreenshot.h"
 #include "Interfaces/IPluginManager.h"
 #include <Runtime/Core/Public/Misc/FileHelper.h>
@@ -74,6 +75,19 @@ UZLCloudPluginStateManager* UZLCloudPluginStateManager::CreateInstance()
 	return Singleton;
 }
 
+UZLCloudPluginStateManager* UZLCloudPluginStateManager::CreateDetachedInstance(const UStateKeyInfoAsset* schema)
+{
+	UZLCloudPluginStateManager* manager = NewObject<UZLCloudPluginStateManager>();
+	manager->ActiveSchema = NewObject<UStateKeyInfoAsset>(manager);
+	manager->m_detached = true;
+	if (schema)
+	{
+		manager->ActiveSchema->KeyInfos = schema->KeyInfos;
+	}
+	manager->OnActiveSchemaKeysChanged();
+	return manager;
+}
+
 void UZLCloudPluginStateManager::ClearProcessingState()
 {
 	JsonObject_out_requestedState.Reset();
@@ -82,13 +96,22 @@ void UZLCloudPluginStateManager::ClearProcessingState()
 	JsonObject_in_requestedState = MakeShareable(new FJsonObject);
 	JsonObject_processingState.Reset();
 	JsonObject_processingState = MakeShareable(new FJsonObject);
-	JsonObject_requestedStateLeafCount = 0;
-	JsonObject_processingStateLeafCount = 0;
-	JsonObject_processingStateFinishedLeaves = 0;
+
+	for (const TUniquePtr<FZLInFlightStateRequest>& request : m_inFlightRequests)
+	{
+		m_stateTimers.Cancel(request->WarningTimer);
+		m_stateTimers.Cancel(request->TimeoutTimer);
+	}
+	m_inFlightRequests.Reset();
+	m_requestKeyOwners.Reset();
 }
 
 void UZLCloudPluginStateManager::RebuildDebugUI(UStateKeyInfoAsset* schemaAsset)
 {
+	//Detached managers run alongside the singleton, the debug UI belongs to it
+	if (m_detached)
+		return;
+
 	if (GEngine)
 	{
 		UWorld* World = GEngine->GetCurrentPlayWorld();
@@ -249,15 +272,38 @@ void UZLCloudPluginStateManager::ResetCurrentAppState(FString jsonString)
 		JsonObject_currentState = MakeShareable(new FJsonObject);
 		UE_LOG(LogZLCloudPlugin, Verbose, TEXT("Reset current state to empty"));
 	}
+	ResetCurrentStateTree();
 }
 
 void UZLCloudPluginStateManager::ResetCurrentAppState(TSharedPtr<FJsonObject> jsonObj)
 {
 	JsonObject_currentState.Reset();
 	JsonObject_currentState = jsonObj;
+	CurrentStateKeyCache.Invalidate();
+	ResetCurrentStateTree();
 	UE_LOG(LogZLCloudPlugin, Verbose, TEXT("Set current state"));
 }
 
+void UZLCloudPluginStateManager::MarkCurrentStateChanged(const FZLStateKeyPath& path)
+{
+	CurrentStateTree.MarkChanged(path);
+	if (StateJournal)
+		StateJournal->RecordChange(path);
+	if (StateRecorder)
+		StateRecorder->RecordChange(path);
+	StateObservers.MarkChanged(EZLStateObserverSource::Current, path);
+}
+
+void UZLCloudPluginStateManager::ResetCurrentStateTree()
+{
+	CurrentStateTree.Reset(JsonObject_currentState);
+	if (StateJournal)
+		StateJournal->RecordReset();
+	if (StateRecorder)
+		StateRecorder->RecordReset();
+	StateObservers.MarkAllChanged(EZLStateObserverSource::Current);
+}
+
 void UZLCloudPluginStateManager::SetStreamConnected(bool connected)
 {
 	m_StreamConnected = connected;
@@ -331,79 +377,383 @@ bool CompareJsonValuesCaseSensitive(const TSharedPtr<FJsonValue>& OldJsonObject,
 	}
 }
 
-TSharedPtr<FJsonObject> CreateDiffJsonObject(const TSharedPtr<FJsonObject>& OldJsonObject, const TSharedPtr<FJsonObject>& NewJsonObject)
+namespace
 {
-	TSharedPtr<FJsonObject> DiffObject = MakeShareable(new FJsonObject);
-
-	for (const auto& Pair : NewJsonObject->Values)
+	int32 CountLeavesInJsonValue(const TSharedPtr<FJsonValue>& Value)
 	{
-		const FString& Key = Pair.Key;
-		const TSharedPtr<FJsonValue>& NewValue = Pair.Value;
+		if (!Value.IsValid())
+		{
+			return 0;
+		}
 
-		if (OldJsonObject->HasField(Key))
+		switch (Value->Type)
 		{
-			const TSharedPtr<FJsonValue>& OldValue = OldJsonObject->TryGetField(Key);
+		case EJson::String:
+		case EJson::Number:
+		case EJson::Boolean:
+		case EJson::Array:
+			return 1;
 
-			if (!OldValue.IsValid() || !NewValue.IsValid() || !CompareJsonValuesCaseSensitive(OldValue, NewValue))
+		case EJson::Object:
+		{
+			int32 LeafCount = 0;
+			if (const TSharedPtr<FJsonObject>& Object = Value->AsObject())
 			{
-				// If both values are objects, recursively compare
-				if (NewValue->Type == EJson::Object && OldValue->Type == EJson::Object)
+				for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : Object->Values)
 				{
-					TSharedPtr<FJsonObject> NestedDiff = CreateDiffJsonObject(OldValue->AsObject(), NewValue->AsObject());
-					if (NestedDiff->Values.Num() > 0)
-					{
-						DiffObject->SetObjectField(Key, NestedDiff);
-					}
+					LeafCount += CountLeavesInJsonValue(Pair.Value);
 				}
-				else
+			}
+			return LeafCount;
+		}
+
+		default:
+			return 0;
+		}
+	}
+
+	// Single pass over NewObject against any number of old objects, a value is dropped if it matches any of them.
+	// Writes the diff into OutDiff when given, counts its leaves and streams each differing value to Callback, returns false if the callback stopped the walk
+	bool DiffJsonObjectRecursive(TArrayView<const FJsonObject* const> OldObjects, const FJsonObject& NewObject, FJsonObject* OutDiff, int32& OutLeafCount, TArray<const FString*, TInlineAllocator<8>>& Keys, const FJsonDiffCallback* Callback)
+	{
+		for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : NewObject.Values)
+		{
+			const TSharedPtr<FJsonValue>& NewValue = Pair.Value;
+			if (!NewValue.IsValid())
+			{
+				continue;
+			}
+
+			const uint32 KeyHash = GetTypeHash(Pair.Key);
+			const bool bNewIsObject = NewValue->Type == EJson::Object && NewValue->AsObject().IsValid();
+
+			bool bMatched = false;
+			TArray<const FJsonObject*, TInlineAllocator<2>> OldChildObjects;
+			for (const FJsonObject* OldObject : OldObjects)
+			{
+				const TSharedPtr<FJsonValue>* OldValue = OldObject->Values.FindByHash(KeyHash, Pair.Key);
+				if (!OldValue || !OldValue->IsValid())
+				{
+					continue;
+				}
+
+				if (CompareJsonValuesCaseSensitive(*OldValue, NewValue))
+				{
+					bMatched = true;
+					break;
+				}
+
+				if (bNewIsObject && (*OldValue)->Type == EJson::Object && (*OldValue)->AsObject().IsValid())
+				{
+					OldChildObjects.Add((*OldValue)->AsObject().Get());
+				}
+			}
+
+			if (bMatched)
+			{
+				continue;
+			}
+
+			Keys.Push(&Pair.Key);
+
+			bool bContinue = true;
+			if (OldChildObjects.Num() > 0)
+			{
+				// If both values are objects only what differs below this key is part of the diff
+				TSharedPtr<FJsonObject> NestedDiff = OutDiff ? MakeShared<FJsonObject>() : nullptr;
+				bContinue = DiffJsonObjectRecursive(OldChildObjects, *NewValue->AsObject(), NestedDiff.Get(), OutLeafCount, Keys, Callback);
+				if (NestedDiff.IsValid() && NestedDiff->Values.Num() > 0)
+				{
+					OutDiff->SetObjectField(Pair.Key, NestedDiff);
+				}
+			}
+			else
+			{
+				OutLeafCount += CountLeavesInJsonValue(NewValue);
+				if (OutDiff)
 				{
-					DiffObject->SetField(Key, NewValue);
+					OutDiff->SetField(Pair.Key, NewValue);
 				}
+				bContinue = !Callback || (*Callback)(Keys, NewValue);
+			}
+
+			Keys.Pop();
+
+			if (!bContinue)
+			{
+				return false;
 			}
 		}
-		else
+
+		return true;
+	}
+
+	bool DiffJsonObjects(TArrayView<const TSharedPtr<FJsonObject>> OldJsonObjects, const TSharedPtr<FJsonObject>& NewJsonObject, FJsonObject* OutDiff, int32& OutLeafCount, const FJsonDiffCallback* Callback)
+	{
+		if (!NewJsonObject.IsValid())
+		{
+			return true;
+		}
+
+		TArray<const FJsonObject*, TInlineAllocator<2>> OldObjects;
+		for (const TSharedPtr<FJsonObject>& OldJsonObject : OldJsonObjects)
+		{
+			if (OldJsonObject.IsValid())
+			{
+				OldObjects.Add(OldJsonObject.Get());
+			}
+		}
+
+		TArray<const FString*, TInlineAllocator<8>> Keys;
+		return DiffJsonObjectRecursive(OldObjects, *NewJsonObject, OutDiff, OutLeafCount, Keys, Callback);
+	}
+
+	// Lays a newer state request over a pending one in place: objects merge key by key, anything else in Newer replaces what Pending had.
+	// Returns how many of Pending's leaves are left, 0 means Newer overrides all of it
+	int32 OverlayStateRequest(FJsonObject& Pending, const FJsonObject& Newer)
+	{
+		int32 SurvivingLeaves = 0;
+		for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : Pending.Values)
+		{
+			if (!Newer.Values.Contains(Pair.Key))
+			{
+				SurvivingLeaves += CountLeavesInJsonValue(Pair.Value);
+			}
+		}
+
+		for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : Newer.Values)
 		{
-			DiffObject->SetField(Key, NewValue);
+			TSharedPtr<FJsonValue>* Existing = Pending.Values.Find(Pair.Key);
+			if (Existing && Existing->IsValid() && (*Existing)->Type == EJson::Object && Pair.Value.IsValid() && Pair.Value->Type == EJson::Object)
+			{
+				SurvivingLeaves += OverlayStateRequest(*(*Existing)->AsObject(), *Pair.Value->AsObject());
+			}
+			else
+			{
+				Pending.SetField(Pair.Key, Pair.Value);
+			}
 		}
+
+		return SurvivingLeaves;
+	}
+}
+
+TSharedPtr<FJsonObject> CreateDiffJsonObject(const TSharedPtr<FJsonObject>& OldJsonObject, const TSharedPtr<FJsonObject>& NewJsonObject)
+{
+	return CreateDiffJsonObject(MakeArrayView(&OldJsonObject, 1), NewJsonObject);
+}
+
+TSharedPtr<FJsonObject> CreateDiffJsonObject(TArrayView<const TSharedPtr<FJsonObject>> OldJsonObjects, const TSharedPtr<FJsonObject>& NewJsonObject, int32* OutLeafCount)
+{
+	TSharedPtr<FJsonObject> DiffObject = MakeShareable(new FJsonObject);
+
+	int32 LeafCount = 0;
+	DiffJsonObjects(OldJsonObjects, NewJsonObject, DiffObject.Get(), LeafCount, nullptr);
+
+	if (OutLeafCount)
+	{
+		*OutLeafCount = LeafCount;
 	}
 
 	return DiffObject;
 }
 
-TSharedPtr<FJsonObject> MergeJsonObjectsRecursive(const TSharedPtr<FJsonObject>& JsonObject1, const TSharedPtr<FJsonObject>& JsonObject2)
+bool VisitJsonDiff(const TSharedPtr<FJsonObject>& OldJsonObject, const TSharedPtr<FJsonObject>& NewJsonObject, FJsonDiffCallback Callback)
 {
-	if (!JsonObject1.IsValid() || !JsonObject2.IsValid())
+	int32 LeafCount = 0;
+	return DiffJsonObjects(MakeArrayView(&OldJsonObject, 1), NewJsonObject, nullptr, LeafCount, &Callback);
+}
+
+bool HasJsonDiff(const TSharedPtr<FJsonObject>& OldJsonObject, const TSharedPtr<FJsonObject>& NewJsonObject)
+{
+	// Stops at the first difference
+	return !VisitJsonDiff(OldJsonObject, NewJsonObject, [](TArrayView<const FString* const>, const TSharedPtr<FJsonValue>&) { return false; });
+}
+
+int32 CountJsonDiffLeaves(const TSharedPtr<FJsonObject>& OldJsonObject, const TSharedPtr<FJsonObject>& NewJsonObject)
+{
+	int32 LeafCount = 0;
+	DiffJsonObjects(MakeArrayView(&OldJsonObject, 1), NewJsonObject, nullptr, LeafCount, nullptr);
+	return LeafCount;
+}
+
+uint32 GetJsonValueStructuralHash(const TSharedPtr<FJsonValue>& Value)
+{
+	if (!Value.IsValid())
 	{
-		return nullptr;
+		return 0;
 	}
 
-	TSharedPtr<FJsonObject> MergedJsonObject = MakeShared<FJsonObject>(*JsonObject1);
+	const uint32 TypeHash = GetTypeHash((uint8)Value->Type);
 
-	auto AreJsonValuesEqual = [](const TSharedPtr<FJsonValue>& ValueA, const TSharedPtr<FJsonValue>& ValueB) -> bool
+	switch (Value->Type)
 	{
-		if (ValueA->Type != ValueB->Type) return false;
+	case EJson::String:
+		//Case insensitive like FString comparison
+		return HashCombine(TypeHash, GetTypeHash(Value->AsString()));
+
+	case EJson::Number:
+	{
+		//+0 and -0 compare equal so must hash the same
+		const double Number = Value->AsNumber();
+		return HashCombine(TypeHash, GetTypeHash(Number == 0.0 ? 0.0 : Number));
+	}
+
+	case EJson::Boolean:
+		return HashCombine(TypeHash, GetTypeHash(Value->AsBool()));
 
-		switch (ValueA->Type)
+	case EJson::Array:
+	{
+		uint32 Hash = TypeHash;
+		for (const TSharedPtr<FJsonValue>& Item : Value->AsArray())
 		{
-		case EJson::String:
-			return ValueA->AsString() == ValueB->AsString();
-		case EJson::Number:
-			return FMath::IsNearlyEqual(ValueA->AsNumber(), ValueB->AsNumber());
-		case EJson::Boolean:
-			return ValueA->AsBool() == ValueB->AsBool();
-		case EJson::Null:
-			return true;
-		default:
-			FString StringA, StringB;
-			TSharedRef<TJsonWriter<>> WriterA = TJsonWriterFactory<>::Create(&StringA);
-			TSharedRef<TJsonWriter<>> WriterB = TJsonWriterFactory<>::Create(&StringB);
-			FJsonSerializer::Serialize(ValueA.ToSharedRef(), "", WriterA);
-			FJsonSerializer::Serialize(ValueB.ToSharedRef(), "", WriterB);
-			WriterA->Close();
-			WriterB->Close();
-			return StringA == StringB;
+			Hash = HashCombine(Hash, GetJsonValueStructuralHash(Item));
 		}
-	};
+		return Hash;
+	}
+
+	case EJson::Object:
+	{
+		const TSharedPtr<FJsonObject>& Object = Value->AsObject();
+		if (!Object.IsValid())
+		{
+			return TypeHash;
+		}
+
+		//Summed so field order doesn't matter, each field is mixed first so swapped values under different keys don't cancel out
+		uint32 FieldsHash = 0;
+		for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : Object->Values)
+		{
+			FieldsHash += HashCombine(GetTypeHash(Pair.Key), GetJsonValueStructuralHash(Pair.Value));
+		}
+		return HashCombine(TypeHash, HashCombine(FieldsHash, GetTypeHash(Object->Values.Num())));
+	}
+
+	default:
+		return TypeHash;
+	}
+}
+
+bool AreJsonValuesStructurallyEqual(const TSharedPtr<FJsonValue>& ValueA, const TSharedPtr<FJsonValue>& ValueB)
+{
+	if (!ValueA.IsValid() || !ValueB.IsValid())
+	{
+		return ValueA.IsValid() == ValueB.IsValid();
+	}
+
+	if (ValueA->Type != ValueB->Type)
+	{
+		return false;
+	}
+
+	switch (ValueA->Type)
+	{
+	case EJson::String:
+		return ValueA->AsString() == ValueB->AsString();
+
+	case EJson::Number:
+		return ValueA->AsNumber() == ValueB->AsNumber();
+
+	case EJson::Boolean:
+		return ValueA->AsBool() == ValueB->AsBool();
+
+	case EJson::Array:
+	{
+		const TArray<TSharedPtr<FJsonValue>>& ArrayA = ValueA->AsArray();
+		const TArray<TSharedPtr<FJsonValue>>& ArrayB = ValueB->AsArray();
+
+		if (ArrayA.Num() != ArrayB.Num())
+		{
+			return false;
+		}
+
+		for (int32 i = 0; i < ArrayA.Num(); i++)
+		{
+			if (!AreJsonValuesStructurallyEqual(ArrayA[i], ArrayB[i]))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	case EJson::Object:
+	{
+		const TSharedPtr<FJsonObject>& ObjA = ValueA->AsObject();
+		const TSharedPtr<FJsonObject>& ObjB = ValueB->AsObject();
+
+		if (!ObjA.IsValid() || !ObjB.IsValid())
+		{
+			return ObjA.IsValid() == ObjB.IsValid();
+		}
+
+		if (ObjA->Values.Num() != ObjB->Values.Num())
+		{
+			return false;
+		}
+
+		for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : ObjA->Values)
+		{
+			const TSharedPtr<FJsonValue>* FoundValue = ObjB->Values.Find(Pair.Key);
+			if (!FoundValue || !AreJsonValuesStructurallyEqual(Pair.Value, *FoundValue))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	case EJson::Null:
+	default:
+		return true;
+	}
+}
+
+int32 AppendUniqueJsonArrayItems(TArray<TSharedPtr<FJsonValue>>& MergedArray, const TArray<TSharedPtr<FJsonValue>>& NewItems)
+{
+	const int32 NumExisting = MergedArray.Num();
+
+	//Hash every item once, only items with the same hash get a full comparison
+	TMultiMap<uint32, int32> MergedItemsByHash;
+	MergedItemsByHash.Reserve(MergedArray.Num() + NewItems.Num());
+	for (int32 i = 0; i < MergedArray.Num(); ++i)
+	{
+		MergedItemsByHash.Add(GetJsonValueStructuralHash(MergedArray[i]), i);
+	}
+
+	for (const TSharedPtr<FJsonValue>& Item2 : NewItems)
+	{
+		const uint32 ItemHash = GetJsonValueStructuralHash(Item2);
+		bool bIsDuplicate = false;
+
+		for (TMultiMap<uint32, int32>::TConstKeyIterator It = MergedItemsByHash.CreateConstKeyIterator(ItemHash); It; ++It)
+		{
+			if (AreJsonValuesStructurallyEqual(MergedArray[It.Value()], Item2))
+			{
+				bIsDuplicate = true;
+				break;
+			}
+		}
+
+		if (!bIsDuplicate)
+		{
+			MergedItemsByHash.Add(ItemHash, MergedArray.Add(Item2));
+		}
+	}
+
+	return MergedArray.Num() - NumExisting;
+}
+
+TSharedPtr<FJsonObject> MergeJsonObjectsRecursive(const TSharedPtr<FJsonObject>& JsonObject1, const TSharedPtr<FJsonObject>& JsonObject2)
+{
+	if (!JsonObject1.IsValid() || !JsonObject2.IsValid())
+	{
+		return nullptr;
+	}
+
+	TSharedPtr<FJsonObject> MergedJsonObject = MakeShared<FJsonObject>(*JsonObject1);
 
 	for (const auto& Pair : JsonObject2->Values)
 	{
@@ -434,24 +784,7 @@ TSharedPtr<FJsonObject> MergeJsonObjectsRecursive(const TSharedPtr<FJsonObject>&
 				MergedArray = *Array1Ptr;
 			}
 
-			for (const TSharedPtr<FJsonValue>& Item2 : Array2)
-			{
-				bool bIsDuplicate = false;
-
-				for (const TSharedPtr<FJsonValue>& Item1 : MergedArray)
-				{
-					if (AreJsonValuesEqual(Item1, Item2))
-					{
-						bIsDuplicate = true;
-						break;
-					}
-				}
-
-				if (!bIsDuplicate)
-				{
-					MergedArray.Add(Item2);
-				}
-			}
+			AppendUniqueJsonArrayItems(MergedArray, Array2);
 
 			MergedJsonObject->SetArrayField(Key, MergedArray);
 
@@ -478,62 +811,104 @@ void UZLCloudPluginStateManager::OnMoviePipelineFinishedNotifyZLScreenshot(FMovi
 }
 
 
-FString UZLCloudPluginStateManager::MergeDefaultInitialState(FString overrideInitialStateJSONString)
+const TSharedPtr<FJsonObject>& UZLCloudPluginStateManager::GetDefaultInitialStateObject()
 {
-	FString mergedInitialState = overrideInitialStateJSONString;
-	TSharedPtr<FJsonObject> JsonObject_defaultInitialState;
-	TSharedRef<TJsonReader<>> JsonReader = TJsonReaderFactory<>::Create(GetDefaultInitialState());
-	if (FJsonSerializer::Deserialize(JsonReader, JsonObject_defaultInitialState))
+	if (!m_defaultInitialStateParsed)
 	{
-		TSharedPtr<FJsonObject> JsonObject_overrideInitialState;
-		TSharedRef<TJsonReader<>> JsonReader2 = TJsonReaderFactory<>::Create(overrideInitialStateJSONString);
-		if (FJsonSerializer::Deserialize(JsonReader2, JsonObject_overrideInitialState))
-		{
-			TSharedPtr<FJsonObject> mergedOverrideInitialState = MergeJsonObjectsRecursive(JsonObject_defaultInitialState, JsonObject_overrideInitialState);
+		m_defaultInitialStateParsed = true;
+		JsonObject_DefaultInitialState.Reset();
 
-			FString JsonString_mergedInitialState;
-			TSharedRef<TJsonWriter<TCHAR>> JsonWriter = TJsonWriterFactory<TCHAR>::Create(&JsonString_mergedInitialState, 1);
-			FJsonSerializer::Serialize(mergedOverrideInitialState.ToSharedRef(), JsonWriter);
-			JsonWriter->Close();
-
-			mergedInitialState = JsonString_mergedInitialState;
-		}
+		if (HasDefaultInitialState())
+		{
+			TSharedRef<TJsonReader<>> JsonReader = TJsonReaderFactory<>::Create(GetDefaultInitialState());
+			if (!FJsonSerializer::Deserialize(JsonReader, JsonObject_DefaultInitialState))
+			{
+				UE_LOG(LogZLCloudPlugin, Warning, TEXT("Default initial state could not be parsed"));
+				JsonObject_DefaultInitialState.Reset();
+			}
+		}
 	}
 
-	return mergedInitialState;
+	return JsonObject_DefaultInitialState;
 }
 
-bool GetJsonValueFromNestedKey(FString NestedKey, TSharedPtr<FJsonObject> JsonObject,const TSharedPtr<FJsonValue>* &Value)
+bool UZLCloudPluginStateManager::MergeDefaultInitialState(FStringView overrideInitialStateJSON, TSharedPtr<FJsonObject>& outInitialState, FString* outError)
 {
-	TArray<FString> Keys;
-	NestedKey.ParseIntoArray(Keys, TEXT("."), true);
-
-	const FString FinalKey = Keys[Keys.Num() - 1];
+	const TSharedPtr<FJsonObject>& defaultInitialState = GetDefaultInitialStateObject();
 
-	TSharedPtr<FJsonObject> CurrentObject = JsonObject;
-	for (const FString& Key : Keys)
+	if (overrideInitialStateJSON.IsEmpty() && !defaultInitialState.IsValid())
 	{
-		if (!CurrentObject.IsValid() || !CurrentObject->HasField(Key))
+		if (outError)
 		{
-			// Handle error here, key not found or object is invalid
-			return false;
+			*outError = TEXT("No default initial state");
 		}
+		return false;
+	}
 
-		TSharedPtr<FJsonValue> JsonValue = CurrentObject->TryGetField(Key);
-		if (JsonValue->Type == EJson::Object)
-		{
-			CurrentObject = JsonValue->AsObject();
-		}
-		else if(Key.Equals(FinalKey, ESearchCase::CaseSensitive))
-		{
-			// The last key should have a value type different from an object
-			// Handle error or return the value as needed
-			Value = &JsonValue;
-			return true;
-		}
+	//Only the object levels are copied, the override is merged into those in place and the cached default keeps its own
+	outInitialState = defaultInitialState.IsValid() ? CopyJsonObjectStructure(defaultInitialState) : MakeShared<FJsonObject>();
+
+	if (overrideInitialStateJSON.IsEmpty())
+	{
+		return true;
 	}
 
-	return false;
+	int32 changedKeys = 0;
+	if (!MergeJsonIntoObject(overrideInitialStateJSON, outInitialState, [&changedKeys](const FString&) { changedKeys++; }, outError))
+	{
+		outInitialState.Reset();
+		return false;
+	}
+
+	UE_LOG(LogZLCloudPlugin, Verbose, TEXT("Initial state override changed %d keys of the default"), changedKeys);
+	return true;
+}
+
+FString UZLCloudPluginStateManager::MergeDefaultInitialState(FString overrideInitialStateJSONString)
+{
+	TSharedPtr<FJsonObject> mergedOverrideInitialState;
+	if (!GetDefaultInitialStateObject().IsValid() || !MergeDefaultInitialState(overrideInitialStateJSONString, mergedOverrideInitialState))
+	{
+		return overrideInitialStateJSONString;
+	}
+
+	FString JsonString_mergedInitialState;
+	TSharedRef<TJsonWriter<TCHAR>> JsonWriter = TJsonWriterFactory<TCHAR>::Create(&JsonString_mergedInitialState, 1);
+	FJsonSerializer::Serialize(mergedOverrideInitialState.ToSharedRef(), JsonWriter);
+	JsonWriter->Close();
+
+	return JsonString_mergedInitialState;
+}
+
+bool GetJsonValueFromNestedKey(const FZLStateKeyPath& NestedKey, const TSharedPtr<FJsonObject>& JsonObject, const TSharedPtr<FJsonValue>*& Value, FZLStateKeyPathCache* Cache = nullptr)
+{
+	if (!NestedKey.IsValid())
+	{
+		return false;
+	}
+
+	TSharedPtr<FJsonObject> ParentObject = Cache ? Cache->ResolveParent(JsonObject, NestedKey) : FZLStateKeyPathCache::WalkToParent(JsonObject, NestedKey);
+	if (!ParentObject.IsValid())
+	{
+		return false;
+	}
+
+	// Points into the parent's map, which the tree keeps alive until the key is next modified
+	const TSharedPtr<FJsonValue>* LeafValue = FZLStateKeyPathCache::FindSegment(*ParentObject, NestedKey.GetLeaf());
+
+	// The last key should have a value type different from an object
+	if (!LeafValue || !LeafValue->IsValid() || (*LeafValue)->Type == EJson::Object)
+	{
+		return false;
+	}
+
+	Value = LeafValue;
+	return true;
+}
+
+bool GetJsonValueFromNestedKey(FString NestedKey, TSharedPtr<FJsonObject> JsonObject,const TSharedPtr<FJsonValue>* &Value)
+{
+	return GetJsonValueFromNestedKey(FZLStateKeyPath::Intern(NestedKey), JsonObject, Value);
 }
 
 static void DuplicateJsonArray(const TArray<TSharedPtr<FJsonValue>>& Source, TArray<TSharedPtr<FJsonValue>>& Dest)
@@ -630,159 +1005,200 @@ static void DuplicateJsonArray(const TArray<TSharedPtr<FJsonValue>>& Source, TAr
 //	return false;
 //}
 
-bool SetJsonValueFromNestedKey(FString NestedKey, TSharedPtr<FJsonObject>& JsonObject, FJsonValue* value)
+bool SetJsonValueFromNestedKey(const FZLStateKeyPath& NestedKey, TSharedPtr<FJsonObject>& JsonObject, FJsonValue* value, FZLStateKeyPathCache* Cache = nullptr)
 {
 	if (value->IsNull())
 	{
-		UE_LOG(LogZLCloudPlugin, Display, TEXT("Tried to set an invalid FJsonValue object to key %s"), *NestedKey);
+		UE_LOG(LogZLCloudPlugin, Display, TEXT("Tried to set an invalid FJsonValue object to key %s"), *NestedKey.ToString());
 		return false;
 	}
 
-	TArray<FString> Keys;
-	NestedKey.ParseIntoArray(Keys, TEXT("."), true);
-
-	const FString FinalKey = Keys[Keys.Num() - 1];
+	if (!JsonObject.IsValid() || !NestedKey.IsValid())
+	{
+		return false;
+	}
 
-	TSharedPtr<FJsonObject> CurrentObject = JsonObject;
-	for (const FString& Key : Keys)
+	TSharedPtr<FJsonObject> CurrentObject = Cache ? Cache->ResolveParent(JsonObject, NestedKey) : nullptr;
+	if (!CurrentObject.IsValid())
 	{
-		if (!CurrentObject.IsValid())
+		const TArray<FZLStateKeyPath::FSegment>& Segments = NestedKey.GetSegments();
+		bool bCreatedLevel = false;
+
+		CurrentObject = JsonObject;
+		for (int32 i = 0; i < Segments.Num() - 1; ++i)
 		{
-			return false;
+			const TSharedPtr<FJsonValue>* JsonValue = FZLStateKeyPathCache::FindSegment(*CurrentObject, Segments[i]);
+			if (!JsonValue || !JsonValue->IsValid())
+			{
+				//Need to create a new FJsonObject level
+				TSharedPtr<FJsonObject> NewObject = MakeShared<FJsonObject>();
+				CurrentObject->SetObjectField(Segments[i].Name, NewObject);
+				CurrentObject = NewObject;
+				bCreatedLevel = true;
+			}
+			else if ((*JsonValue)->Type == EJson::Object)
+			{
+				CurrentObject = (*JsonValue)->AsObject();
+			}
+			else
+			{
+				return false;
+			}
 		}
-		else if (!CurrentObject->HasField(Key))
+
+		if (bCreatedLevel && Cache)
 		{
-			//Need to create a new FJsonObject level
-			if (Key != FinalKey)
-				CurrentObject->SetObjectField(Key, MakeShared<FJsonObject>());
+			Cache->Invalidate();
 		}
+	}
+
+	// The last key should have a value type different from an object
+	const FString& Key = NestedKey.GetLeaf().Name;
+	const TSharedPtr<FJsonValue>* ExistingValue = FZLStateKeyPathCache::FindSegment(*CurrentObject, NestedKey.GetLeaf());
+	if (ExistingValue && ExistingValue->IsValid() && (*ExistingValue)->Type == EJson::Object)
+	{
+		return false;
+	}
 
-		TSharedPtr<FJsonValue> JsonValue = CurrentObject->TryGetField(Key);
-		if (JsonValue.IsValid() && JsonValue->Type == EJson::Object)
+	switch (value->Type)
+	{
+		case EJson::Boolean:
 		{
-			CurrentObject = JsonValue->AsObject();
+			bool BoolValue;
+			if (value->TryGetBool(BoolValue))
+			{
+				CurrentObject->SetBoolField(Key, BoolValue);
+			}
+			break;
 		}
-		else if (Key.Equals(FinalKey, ESearchCase::CaseSensitive))
+		case EJson::Number:
 		{
-			// The last key should have a value type different from an object
-			// Handle error or return the value as needed
-			switch (value->Type)
+			double NumberValue;
+			if (value->TryGetNumber(NumberValue))
 			{
-				case EJson::Boolean:
-				{
-					bool BoolValue;
-					if (value->TryGetBool(BoolValue))
-					{
-						CurrentObject->SetBoolField(Key, BoolValue);
-					}
-					break;
-				}
-				case EJson::Number:
-				{
-					double NumberValue;
-					if (value->TryGetNumber(NumberValue))
-					{
-						CurrentObject->SetNumberField(Key, NumberValue);
-					}
-					break;
-				}
-				case EJson::String:
-				{
-					FString StringValue;
-					if (value->TryGetString(StringValue))
-					{
-						CurrentObject->SetStringField(Key, StringValue);
-					}
-					break;
-				}
-				case EJson::Array:
-				{
-					const TArray<TSharedPtr<FJsonValue>>* ArrayValue;
-					if (value->TryGetArray(ArrayValue))
-					{
-						TArray<TSharedPtr<FJsonValue>> NewArray;
-						DuplicateJsonArray(*ArrayValue, NewArray);
-
-						CurrentObject->SetArrayField(Key, TArray<TSharedPtr<FJsonValue>>(NewArray));
-					}
-					break;
-				}
+				CurrentObject->SetNumberField(Key, NumberValue);
+			}
+			break;
+		}
+		case EJson::String:
+		{
+			FString StringValue;
+			if (value->TryGetString(StringValue))
+			{
+				CurrentObject->SetStringField(Key, StringValue);
 			}
+			break;
+		}
+		case EJson::Array:
+		{
+			const TArray<TSharedPtr<FJsonValue>>* ArrayValue;
+			if (value->TryGetArray(ArrayValue))
+			{
+				TArray<TSharedPtr<FJsonValue>> NewArray;
+				DuplicateJsonArray(*ArrayValue, NewArray);
 
-			return true;
+				CurrentObject->SetArrayField(Key, TArray<TSharedPtr<FJsonValue>>(NewArray));
+			}
+			break;
 		}
 	}
 
-	return false;
+	return true;
 }
 
-bool RemoveNestedKey(FString NestedKey, TSharedPtr<FJsonObject>& JsonObject)
+bool SetJsonValueFromNestedKey(FString NestedKey, TSharedPtr<FJsonObject>& JsonObject, FJsonValue* value)
 {
-	TArray<FString> Keys;
-	NestedKey.ParseIntoArray(Keys, TEXT("."), true);
+	return SetJsonValueFromNestedKey(FZLStateKeyPath::Intern(NestedKey), JsonObject, value);
+}
 
-	const FString FinalKey = Keys[Keys.Num() - 1];
+bool RemoveNestedKey(const FZLStateKeyPath& NestedKey, TSharedPtr<FJsonObject>& JsonObject, FZLStateKeyPathCache* Cache = nullptr)
+{
+	if (!JsonObject.IsValid() || !NestedKey.IsValid())
+	{
+		return false;
+	}
+
+	const TArray<FZLStateKeyPath::FSegment>& Segments = NestedKey.GetSegments();
 
-	TSharedPtr<FJsonObject> CurrentObject = JsonObject;
+	// Every object from the root down to the leaf's parent, so empty levels can be removed on the way back up
+	TArray<FJsonObject*, TInlineAllocator<8>> ObjectChain;
+	ObjectChain.Add(JsonObject.Get());
 
-	for (const FString& Key : Keys)
+	for (int32 i = 0; i < Segments.Num() - 1; ++i)
 	{
-		if (!CurrentObject.IsValid() || !CurrentObject->HasField(Key))
+		const TSharedPtr<FJsonValue>* JsonValue = FZLStateKeyPathCache::FindSegment(*ObjectChain.Last(), Segments[i]);
+		if (!JsonValue || !JsonValue->IsValid() || (*JsonValue)->Type != EJson::Object || !(*JsonValue)->AsObject().IsValid())
 		{
 			// Handle error here, key not found or object is invalid
 			return false;
 		}
 
-		TSharedPtr<FJsonValue> JsonValue = CurrentObject->TryGetField(Key);
-		if (JsonValue->Type == EJson::Object && Key != FinalKey)
-		{
-			CurrentObject = JsonValue->AsObject();
-		}
-		else if (Key.Equals(FinalKey, ESearchCase::CaseSensitive))
-		{
-			CurrentObject->RemoveField(Key);
+		ObjectChain.Add((*JsonValue)->AsObject().Get());
+	}
 
-			// If the parent object is empty after removing the final key,
-			// remove the parent key from the parent JSON object
-			if (CurrentObject->Values.Num() == 0)
-			{
-				FString currentNestedKey = "";
-				for (int i = 0; i < Keys.Num() - 1; i++)
-				{
-					currentNestedKey += (i == 0) ? Keys[i] : "." + Keys[i];
-				}
-				RemoveNestedKey(currentNestedKey, JsonObject); //Remove empty structs up the FJsonObject chain
-			}
+	const TSharedPtr<FJsonValue>* LeafValue = FZLStateKeyPathCache::FindSegment(*ObjectChain.Last(), NestedKey.GetLeaf());
+	if (!LeafValue)
+	{
+		return false;
+	}
 
-			return true;
-		}
+	bool bRemovedObject = LeafValue->IsValid() && (*LeafValue)->Type == EJson::Object;
+	ObjectChain.Last()->RemoveField(NestedKey.GetLeaf().Name);
 
+	//Remove empty structs up the FJsonObject chain, the root itself is always kept
+	for (int32 i = ObjectChain.Num() - 1; i > 0 && ObjectChain[i]->Values.Num() == 0; --i)
+	{
+		ObjectChain[i - 1]->RemoveField(Segments[i - 1].Name);
+		bRemovedObject = true;
 	}
 
-	return false;
+	if (bRemovedObject && Cache)
+	{
+		Cache->Invalidate();
+	}
+
+	return true;
+}
+
+bool RemoveNestedKey(FString NestedKey, TSharedPtr<FJsonObject>& JsonObject)
+{
+	return RemoveNestedKey(FZLStateKeyPath::Intern(NestedKey), JsonObject);
 }
 
 TArray<FString> UZLCloudPluginStateManager::CurrentStateCompareDiffs_Keys(TSharedPtr<FJsonObject> ComparisonJsonObject)
 {
 	TArray<FString> diffKeys;
+	const FString* lastKey = nullptr;
 
-	TSharedPtr<FJsonObject> DiffJsonObject = CreateDiffJsonObject(JsonObject_currentState, ComparisonJsonObject);
-
-	// Iterate over Json Values
-	for (auto currJsonValue = ComparisonJsonObject->Values.CreateConstIterator(); currJsonValue; ++currJsonValue)
+	VisitJsonDiff(JsonObject_currentState, ComparisonJsonObject, [&diffKeys, &lastKey](TArrayView<const FString* const> Keys, const TSharedPtr<FJsonValue>&)
 	{
-		// Get the key name
-		const FString Name = (*currJsonValue).Key;
-
-		if (DiffJsonObject->TryGetField(Name))
+		//Differences below the same top level key arrive together, only report the key once
+		if (Keys[0] != lastKey)
 		{
-			diffKeys.Add(Name);
+			diffKeys.Add(*Keys[0]);
+			lastKey = Keys[0];
 		}
-	}
+		return true;
+	});
 
 	return diffKeys;
 }
 
+bool UZLCloudPluginStateManager::CurrentStateMatches(TSharedPtr<FJsonObject> ComparisonJsonObject)
+{
+	return !HasJsonDiff(JsonObject_currentState, ComparisonJsonObject);
+}
+
+bool UZLCloudPluginStateManager::GetStateHash(const FZLStateKeyPath& KeyPath, uint64& OutHash) const
+{
+	return CurrentStateTree.GetHash(KeyPath, OutHash);
+}
+
+bool UZLCloudPluginStateManager::GetStateHash(FString KeyPath, uint64& OutHash) const
+{
+	return GetStateHash(FZLStateKeyPath::Intern(KeyPath), OutHash);
+}
+
 TSharedPtr<FJsonObject> UZLCloudPluginStateManager::CurrentStateCompareDiffs(TSharedPtr<FJsonObject> ComparisonJsonObject)
 {
 	return CreateDiffJsonObject(JsonObject_currentState, ComparisonJsonObject);
@@ -791,9 +1207,10 @@ TSharedPtr<FJsonObject> UZLCloudPluginStateManager::CurrentStateCompareDiffs(TSh
 void UZLCloudPluginStateManager::SetNotifyServerState(TSharedPtr<FJsonObject> ComparisonStateRequest)
 {
 	m_needServerNotify = true;
-	m_serverStateNotifyStart = FApp::GetCurrentTime();
+	m_serverStateNotifyStart = GetStateTime();
 	JsonObject_serverNotifyState = ComparisonStateRequest;
-	m_lastStateWarningPrintTime = m_serverStateNotifyStart;
+	ServerNotifyMatch.SetTarget(ComparisonStateRequest);
+	ScheduleServerNotifyDeadlines();
 }
 
 int32 UZLCloudPluginStateManager::CountLeavesInJsonObject(TSharedPtr<FJsonObject> JsonObject)
@@ -872,11 +1289,56 @@ void SanitizeJsonObject(TSharedPtr<FJsonObject> JsonObject)
 static FString s_LogSchemaData = "ZEROLIGHT_GET_SCHEMA_DATA";
 static FString s_LogJsonCompliantSchemaData = "GET_JSON_SCHEMA";
 static FString s_GetVersion = "ZEROLIGHT_GET_VERSION";
+static FString s_EnableStateDeltas = "ZEROLIGHT_ENABLE_STATE_DELTAS";
+static FString s_StateAck = "ZEROLIGHT_STATE_ACK";
 
 void UZLCloudPluginStateManager::ProcessState(FString jsonString, bool doCurrentStateCompare, bool& Success)
 {
 	UE_LOG(LogZLCloudPlugin, Display, TEXT("Received State request to process: %s"), *jsonString);
 
+	//A request that has already started, announced through OnRecieveData to handlers that pass it on here before pulling its values
+	if (m_announcingStateRequest)
+	{
+		Success = true;
+		return;
+	}
+
+	if (StateRecorder)
+		StateRecorder->RecordRequest(jsonString, doCurrentStateCompare, GetStateTime());
+
+	//{"ZEROLIGHT_STATE_ACK": <state_seq>} - the page has applied that push, later patches can be based on it
+	if (jsonString.Contains(s_StateAck))
+	{
+		TSharedPtr<FJsonObject> JsonAck;
+		int32 ackedSequence = INDEX_NONE;
+		if (ParseJsonObject(jsonString, JsonAck) && JsonAck->TryGetNumberField(s_StateAck, ackedSequence))
+		{
+			WebStateSync.Acknowledge(ackedSequence);
+		}
+		else
+		{
+			UE_LOG(LogZLCloudPlugin, Warning, TEXT("Invalid state acknowledgement: %s"), *jsonString);
+		}
+		return;
+	}
+
+	//{"ZEROLIGHT_ENABLE_STATE_DELTAS": true} - the page understands state_seq/current_state_patch, the next push is a full snapshot to use as the first base
+	if (jsonString.Contains(s_EnableStateDeltas))
+	{
+		TSharedPtr<FJsonObject> JsonEnable;
+		bool enableDeltas = true;
+		if (ParseJsonObject(jsonString, JsonEnable))
+		{
+			JsonEnable->TryGetBoolField(s_EnableStateDeltas, enableDeltas);
+		}
+
+		UE_LOG(LogZLCloudPlugin, Display, TEXT("State deltas %s by web"), enableDeltas ? TEXT("enabled") : TEXT("disabled"));
+		WebStateSync.SetDeltasEnabled(enableDeltas);
+		if (!IsProcessingStateRequest()) //Otherwise the request's own result carries the snapshot
+			SetStateDirty(EStateDirtyReason::state_notify_web);
+		return;
+	}
+
 	if ((jsonString.Contains(s_LogJsonCompliantSchemaData) || jsonString.Contains(s_LogSchemaData)) && ActiveSchema)
 	{
 		TSharedPtr<FJsonObject> JsonSchemaData;
@@ -923,349 +1385,868 @@ void UZLCloudPluginStateManager::ProcessState(FString jsonString, bool doCurrent
 		return;
 	}
 
-	//If currently processing an existing state request
-	//add this request to the queue, when the previous one finishes/times out
-	//broadcast the OnRecieveData from Update to pop from queue into processing
-	if (IsProcessingStateRequest())
+	TSharedPtr<FJsonObject> JsonObject_requestedState;
+	FString parseError;
+	if (!ParseJsonObject(jsonString, JsonObject_requestedState, &parseError))
 	{
-		FString inFlightRequestId = JsonObject_processingState->GetStringField(s_requestIdStr);
-		UE_LOG(LogZLCloudPlugin, Display, TEXT("ProcessState queueing request while waiting for RequestId %s to finish..."), *inFlightRequestId);
+		UE_LOG(LogZLCloudPlugin, Warning, TEXT("ProcessState request could not be parsed: %s"), *parseError);
+		Success = false;
+		return;
+	}
 
-		TSharedPtr<FJsonObject> JsonObject_requestedState;
-		TSharedRef<TJsonReader<>> JsonReader = TJsonReaderFactory<>::Create(jsonString);
-		if (FJsonSerializer::Deserialize(JsonReader, JsonObject_requestedState))
-		{
-			SanitizeJsonObject(JsonObject_requestedState);
-			JsonString_in_requestQueue.Enqueue(jsonString);
-			s_requestQueueLength++;
+	ProcessRequestedState(JsonObject_requestedState, doCurrentStateCompare, Success);
+}
 
-			//Send to Web
-			IZLCloudPluginModule* Module = ZLCloudPlugin::FZLCloudPluginModule::GetModule();
-			if (Module)
-			{
-				TSharedPtr<FJsonObject> jsonForWebObject = MakeShareable(new FJsonObject);
-				jsonForWebObject->SetObjectField("state_queued", JsonObject_requestedState);
+void UZLCloudPluginStateManager::StartStateRequest(const TSharedPtr<FJsonObject>& requestedState, bool doCurrentStateCompare)
+{
+	if (!requestedState.IsValid())
+	{
+		return;
+	}
+
+	if (StateRecorder)
+	{
+		FString jsonString;
+		TSharedRef<TJsonWriter<TCHAR>> JsonWriter = TJsonWriterFactory<TCHAR>::Create(&jsonString);
+		FJsonSerializer::Serialize(requestedState.ToSharedRef(), JsonWriter);
+		JsonWriter->Close();
+		StateRecorder->RecordRequest(jsonString, doCurrentStateCompare, GetStateTime());
+	}
+
+	//The request is sanitized and gets its RequestId in place, the caller's object levels stay as they were
+	TSharedPtr<FJsonObject> request = CopyJsonObjectStructure(requestedState);
+	bool started = false;
+	ProcessRequestedState(request, doCurrentStateCompare, started);
 
-				//For some reason TQueue doesnt have a length member func, use a counter for queue length
-				jsonForWebObject->SetNumberField("queue_length", s_requestQueueLength);
+	//Nobody called ProcessState for this one, so handlers hear about it like a queued request starting
+	if (started)
+	{
+		NotifyStateRequestStarted(request);
+	}
+}
+
+void UZLCloudPluginStateManager::NotifyStateRequestStarted(const TSharedPtr<FJsonObject>& requestedState)
+{
+	if (m_stateRequestHandler)
+	{
+		m_stateRequestHandler(requestedState);
+		return;
+	}
 
-				SendFJsonObjectToWeb(jsonForWebObject);
+	UZLCloudPluginDelegates* Delegates = UZLCloudPluginDelegates::GetZLCloudPluginDelegates();
+	if (!Delegates)
+	{
+		return;
+	}
+
+	Delegates->OnStateRequestStartedNative.Broadcast(requestedState);
+	Delegates->OnStateRequestStarted.Broadcast();
+
+	//Still broadcast as before for handlers that process every request from OnRecieveData, their ProcessState call just succeeds
+	if (Delegates->OnRecieveData.IsBound())
+	{
+		FString stateDataStr;
+		TSharedRef<TJsonWriter<TCHAR>> JsonWriter = TJsonWriterFactory<TCHAR>::Create(&stateDataStr);
+		FJsonSerializer::Serialize(requestedState.ToSharedRef(), JsonWriter);
+		JsonWriter->Close();
+
+		TGuardValue<bool> announcing(m_announcingStateRequest, true);
+		Delegates->OnRecieveData.Broadcast(stateDataStr);
+	}
+}
+
+void UZLCloudPluginStateManager::ProcessRequestedState(const TSharedPtr<FJsonObject>& JsonObject_requestedState, bool doCurrentStateCompare, bool& Success)
+{
+	SanitizeJsonObject(JsonObject_requestedState);
+
+	//Start straight away unless an in-flight or earlier queued request touches the same top level keys,
+	//otherwise queue it and StartQueuedStateRequests picks it up once those keys are released
+	FZLQueuedStateRequest request;
+	request.State = JsonObject_requestedState;
+	request.bCompareCurrentState = doCurrentStateCompare;
+	request.ArrivalTime = GetStateTime();
+
+	if (!SchemaValidator.IsEmpty())
+	{
+		TArray<FZLStateViolation> violations;
+		if (SchemaValidator.Validate(JsonObject_requestedState, violations) > 0)
+		{
+			const int32 maxLogged = 10;
+			FString details;
+			for (int32 i = 0; i < FMath::Min(violations.Num(), maxLogged); i++)
+			{
+				details += TEXT("\n\t") + violations[i].ToString();
+			}
+			if (violations.Num() > maxLogged)
+			{
+				details += FString::Printf(TEXT("\n\t...and %d more"), violations.Num() - maxLogged);
 			}
+			UE_LOG(LogZLCloudPlugin, Warning, TEXT("ProcessState request doesn't match the active schema (%d violations):%s"), violations.Num(), *details);
 		}
+	}
+
+	if (OverlapsQueuedStateRequests(JsonObject_requestedState, m_stateRequestQueue.Num()) || !TryStartStateRequest(request, Success))
+	{
+		UE_LOG(LogZLCloudPlugin, Display, TEXT("ProcessState queueing request while waiting for %d in-flight requests on the same keys to finish..."), m_inFlightRequests.Num());
 
+		QueueStateRequest(JsonObject_requestedState, doCurrentStateCompare);
 		Success = false;
 	}
+}
+
+void UZLCloudPluginStateManager::QueueStateRequest(TSharedPtr<FJsonObject> requestedState, bool doCurrentStateCompare)
+{
+	//Sent back to the web as it was requested, before anything is merged into it
+	TSharedPtr<FJsonObject> jsonForWebObject = MakeShareable(new FJsonObject);
+	jsonForWebObject->SetObjectField("state_queued", requestedState);
+
+	//A request on the same keys as the last queued one has to wait behind it anyway and the app only ever sees the final merged state,
+	//so fold it in. Not while a render job is waiting on its own state request, which has to reach the app exactly as it was sent
+	bool coalesced = false;
+	TSharedPtr<ZLCloudPlugin::ZLScreenshot> screenshotManager = ZLCloudPlugin::ZLScreenshot::Get();
+	const bool renderPending = screenshotManager && screenshotManager->HasCurrentRender();
+	const int32 lastIndex = m_stateRequestQueue.Num() - 1;
+	if (!renderPending && lastIndex >= 0 && m_stateRequestQueue[lastIndex].bCompareCurrentState == doCurrentStateCompare
+		&& !OverlapsQueuedStateRequests(requestedState, lastIndex) && OverlapsQueuedStateRequests(requestedState, lastIndex + 1))
+	{
+		FZLQueuedStateRequest& pending = m_stateRequestQueue[lastIndex];
+		const int32 survivingLeaves = OverlayStateRequest(*pending.State, *requestedState);
+
+		//Nothing left of anything queued before means every earlier request was superseded. Otherwise they are only
+		//counted as coalesced, even if the leaves left over all came from one of the others
+		if (survivingLeaves == 0)
+		{
+			for (bool& superseded : pending.MergedRequestsSuperseded)
+			{
+				superseded = true;
+			}
+		}
+		pending.MergedRequestsSuperseded.Add(survivingLeaves == 0);
+		pending.MergedArrivalTimes.Add(pending.ArrivalTime);
+		pending.ArrivalTime = GetStateTime();
+		coalesced = true;
+
+		UE_LOG(LogZLCloudPlugin, Verbose, TEXT("Coalesced queued state request, %d requests now merged, %d earlier leaves left"), pending.MergedRequestsSuperseded.Num() + 1, survivingLeaves);
+	}
 	else
 	{
-		//Clear JsonObject_in_requestedState
-		JsonObject_in_requestedState.Reset();
-		JsonObject_in_requestedState = MakeShareable(new FJsonObject);
+		FZLQueuedStateRequest& request = m_stateRequestQueue.AddDefaulted_GetRef();
+		request.State = requestedState;
+		request.bCompareCurrentState = doCurrentStateCompare;
+		request.ArrivalTime = GetStateTime();
+	}
 
-		TSharedRef<TJsonReader<>> JsonReader = TJsonReaderFactory<>::Create(jsonString);
-		if (FJsonSerializer::Deserialize(JsonReader, JsonObject_in_requestedState))
+	//Send to Web
+	IZLCloudPluginModule* Module = ZLCloudPlugin::FZLCloudPluginModule::GetModule();
+	if (Module)
+	{
+		jsonForWebObject->SetNumberField("queue_length", m_stateRequestQueue.Num());
+		if (coalesced)
 		{
-			SanitizeJsonObject(JsonObject_in_requestedState);
-			//Debug Value
-			FString requestId = FString::FromInt(request_recieved_id++);
-			JsonObject_in_requestedState->SetStringField(s_requestIdStr, requestId);
+			jsonForWebObject->SetBoolField("coalesced", true);
+		}
 
-			//Reset counters for new request state
-			JsonObject_processingStateStartTime = FApp::GetCurrentTime();
-			JsonObject_processingStateLeafCount = 0;
-			JsonObject_processingStateFinishedLeaves = 0;
-			m_lastStateWarningPrintTime = JsonObject_processingStateStartTime;
+		SendFJsonObjectToWeb(jsonForWebObject);
+	}
+}
 
-			if (doCurrentStateCompare)
-			{
-				//Compare to current state
-				JsonObject_out_requestedState = CreateDiffJsonObject(JsonObject_currentState, JsonObject_in_requestedState);
-			}
-			else
+bool UZLCloudPluginStateManager::OverlapsQueuedStateRequests(const TSharedPtr<FJsonObject>& requestedState, int32 queueEnd) const
+{
+	//Checked against everything a queued request asks for, not just what will differ once it starts, so queued requests on a key keep their order
+	for (int32 i = 0; i < queueEnd && i < m_stateRequestQueue.Num(); ++i)
+	{
+		for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : requestedState->Values)
+		{
+			if (Pair.Key != s_requestIdStr && m_stateRequestQueue[i].State->Values.Contains(Pair.Key))
 			{
-				JsonObject_out_requestedState = JsonObject_in_requestedState;
+				return true;
 			}
+		}
+	}
+	return false;
+}
+
+bool UZLCloudPluginStateManager::TryStartStateRequest(const FZLQueuedStateRequest& request, bool& Success)
+{
+	const bool doCurrentStateCompare = request.bCompareCurrentState;
+
+	//A render job's state request has to be the only thing changing the state while it is captured
+	TSharedPtr<ZLCloudPlugin::ZLScreenshot> screenshotManager = ZLCloudPlugin::ZLScreenshot::Get();
+	const bool stateRequestedContentJob = screenshotManager && screenshotManager->HasCurrentRender();
+	if (stateRequestedContentJob && m_inFlightRequests.Num() > 0)
+	{
+		return false;
+	}
+
+	//Compare to current state if requested, counting what is left in the same pass
+	TArray<TSharedPtr<FJsonObject>, TInlineAllocator<1>> comparisonStates;
+	if (doCurrentStateCompare)
+	{
+		comparisonStates.Add(JsonObject_currentState);
+	}
+
+	int32 requestedLeafCount = 0;
+	TSharedPtr<FJsonObject> requestedDiff = CreateDiffJsonObject(comparisonStates, request.State, &requestedLeafCount);
+	if (requestedDiff->HasField(s_requestIdStr)) //Ignore any RequestId sent by the web, it gets its own below
+	{
+		requestedDiff->RemoveField(s_requestIdStr);
+		requestedLeafCount--;
+	}
+
+	//Values that already match don't need the key, anything left must not be owned by another in-flight request
+	for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : requestedDiff->Values)
+	{
+		if (m_requestKeyOwners.Contains(Pair.Key))
+		{
+			return false;
+		}
+	}
+
+	JsonObject_in_requestedState = request.State;
+
+	TUniquePtr<FZLInFlightStateRequest> inFlight = MakeUnique<FZLInFlightStateRequest>();
+
+	//Every request merged into this one gets its own id in arrival order, and completes along with it
+	for (bool superseded : request.MergedRequestsSuperseded)
+	{
+		FString mergedRequestId = FString::FromInt(request_recieved_id++);
+		if (superseded)
+		{
+			inFlight->SupersededRequestIds.Add(mergedRequestId);
+			request_superseded_count++;
+		}
+		else
+		{
+			inFlight->CoalescedRequestIds.Add(mergedRequestId);
+			request_coalesced_count++;
+		}
+	}
+
+	//Debug Value
+	FString requestId = FString::FromInt(request_recieved_id++);
+	JsonObject_in_requestedState->SetStringField(s_requestIdStr, requestId);
+
+	if (request.MergedRequestsSuperseded.Num() > 0)
+	{
+		UE_LOG(LogZLCloudPlugin, Display, TEXT("RequestId %s carries %d coalesced and %d superseded queued requests"), *requestId, inFlight->CoalescedRequestIds.Num(), inFlight->SupersededRequestIds.Num());
+	}
 
-			//Remove any that are still being processed
-			JsonObject_out_requestedState = CreateDiffJsonObject(JsonObject_processingState, JsonObject_out_requestedState);
+	inFlight->RequestId = requestId;
+	inFlight->StartTime = GetStateTime();
+	inFlight->ArrivalTime = request.ArrivalTime;
+	inFlight->MergedArrivalTimes = request.MergedArrivalTimes;
+	inFlight->RequestedLeafCount = requestedLeafCount;
+
+	if (doCurrentStateCompare)
+	{
+		UE_LOG(LogZLCloudPlugin, Display, TEXT("Leaf count difference between request and current state: %d"), inFlight->RequestedLeafCount);
+	}
+	else
+	{
+		UE_LOG(LogZLCloudPlugin, Display, TEXT("Leaf count in request: %d"), inFlight->RequestedLeafCount);
+	}
 
-			JsonObject_requestedStateLeafCount = CountLeavesInJsonObject(JsonObject_out_requestedState) - 1; //Ignore RequestId
+	Success = requestedDiff.IsValid();
 
-			if (doCurrentStateCompare)
+	//Send to Web
+	IZLCloudPluginModule* Module = ZLCloudPlugin::FZLCloudPluginModule::GetModule();
+	if (inFlight->RequestedLeafCount == 0)
+	{
+		//Nothing to wait for, the request never goes in flight
+		if (Module)
+		{
+			SendStateRequestEndedToWeb(inFlight.Get(), "complete");
+
+			if (stateRequestedContentJob)
 			{
-				UE_LOG(LogZLCloudPlugin, Display, TEXT("Leaf count difference between request and current state: %d"), JsonObject_requestedStateLeafCount);
+				screenshotManager->SetCurrentRenderStateData(JsonObject_currentState);
+				screenshotManager->UpdateCurrentRenderStateRequestProgress(true, true);
 			}
-			else
+		}
+
+		if (m_inFlightRequests.Num() == 0)
+		{
+			ClearProcessingState();
+		}
+
+		WakeTrackedStateBlueprints();
+		return true;
+	}
+
+	//The shared requested tree is what blueprints pull values from, the owned keys route each pull/confirm back to this request
+	for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : requestedDiff->Values)
+	{
+		inFlight->Keys.Add(Pair.Key);
+		m_requestKeyOwners.Add(Pair.Key, inFlight.Get());
+		JsonObject_out_requestedState->SetField(Pair.Key, Pair.Value);
+	}
+	JsonObject_out_requestedState->SetStringField(s_requestIdStr, requestId);
+	InvalidateKeyPathCaches();
+
+	//Only the leaves that differ go to the observers, and only when there are some
+	if (StateObservers.HasObservers(EZLStateObserverSource::Requested))
+	{
+		TFunction<void(const FJsonObject&, const FString&)> markLeaves = [this, &markLeaves](const FJsonObject& object, const FString& prefix)
+		{
+			for (const TPair<FString, TSharedPtr<FJsonValue>>& pair : object.Values)
 			{
-				UE_LOG(LogZLCloudPlugin, Display, TEXT("Leaf count in request: %d"), JsonObject_requestedStateLeafCount);
+				const FString key = prefix.IsEmpty() ? pair.Key : prefix + TEXT(".") + pair.Key;
+				if (pair.Value.IsValid() && pair.Value->Type == EJson::Object && pair.Value->AsObject().IsValid() && pair.Value->AsObject()->Values.Num() > 0)
+					markLeaves(*pair.Value->AsObject(), key);
+				else
+					StateObservers.MarkChanged(EZLStateObserverSource::Requested, FZLStateKeyPath::Intern(key));
 			}
+		};
+		markLeaves(*requestedDiff, FString());
+	}
 
+	//Deadlines only flag the request, Update handles them after advancing the wheel
+	FZLInFlightStateRequest* inFlightPtr = inFlight.Get();
+	ScheduleStateRequestDeadlines(*inFlight);
 
-			//Send to Web
-			IZLCloudPluginModule* Module = ZLCloudPlugin::FZLCloudPluginModule::GetModule();
-			if (Module)
-			{
-				if (JsonObject_requestedStateLeafCount == 0)
-				{
-					bool stateRequestedContentJob = false;
-					TSharedPtr<ZLCloudPlugin::ZLScreenshot> screenshotManager = ZLCloudPlugin::ZLScreenshot::Get();
-					if (screenshotManager)
-					{
-						stateRequestedContentJob = screenshotManager->HasCurrentRender();
-					}
+	m_inFlightRequests.Add(MoveTemp(inFlight));
 
-					//Return current state to the web
-					TSharedPtr<FJsonObject> currentJson = MakeShareable(new FJsonObject);
-					currentJson->SetStringField("status", "complete");
-					currentJson->SetObjectField("current_state", JsonObject_currentState);
+	if (Module)
+	{
+		TSharedPtr<FJsonObject> jsonForWebObject = MakeShareable(new FJsonObject);
+		TSharedPtr<FJsonObject> requestedJsonObject = MakeShareable(new FJsonObject);
+		FJsonObject::Duplicate(requestedDiff, requestedJsonObject);
 
-					TSharedPtr<FJsonObject> jsonForWebObject = MakeShareable(new FJsonObject);
-					jsonForWebObject->SetObjectField("state_processing_ended", currentJson);
-					jsonForWebObject->SetStringField(s_requestIdStr, requestId); //add in request Id	
+		jsonForWebObject->SetStringField(s_requestIdStr, requestId);
+		jsonForWebObject->SetObjectField("state_processing", requestedJsonObject);
+		AddMergedRequestIds(*inFlightPtr, jsonForWebObject);
 
-					SendFJsonObjectToWeb(jsonForWebObject);
+		//jsonForWebObject->SetNumberField("total_leaves", inFlightPtr->RequestedLeafCount);
 
-					if (stateRequestedContentJob)
-					{
-						screenshotManager->SetCurrentRenderStateData(JsonObject_currentState);
-						screenshotManager->UpdateCurrentRenderStateRequestProgress(true, true);
-					}
+		SendFJsonObjectToWeb(jsonForWebObject);
+	}
 
-					ClearProcessingState();
+	WakeTrackedStateBlueprints();
+	return true;
+}
 
-					PopStateRequestQueue(); //Process next request if any queued
-				}
-				else
-				{
-					TSharedPtr<FJsonObject> jsonForWebObject = MakeShareable(new FJsonObject);
-					TSharedPtr<FJsonObject> requestedJsonObject = MakeShareable(new FJsonObject);
-					FJsonObject::Duplicate(JsonObject_out_requestedState, requestedJsonObject);
-					requestedJsonObject->RemoveField(s_requestIdStr);
+void UZLCloudPluginStateManager::WakeTrackedStateBlueprints()
+{
+	//Once tracked state blueprints have made themselves known only requests changing their keys wake them, from Update.
+	//Until then every request that starts wakes them all as before
+	if (m_trackedStateObservers.Num() == 0)
+	{
+		BroadcastTrackedStateUpdate();
+	}
+}
 
-					jsonForWebObject->SetStringField(s_requestIdStr, requestId);
-					jsonForWebObject->SetObjectField("state_processing", requestedJsonObject);
+void UZLCloudPluginStateManager::BroadcastTrackedStateUpdate()
+{
+	//Tracked state blueprints pull from the main state manager, a detached one has nothing for them
+	if (m_detached)
+		return;
+
+	//Trigger tracked states to see if any pull out state data
+	if (UZLTrackedStateBlueprint* stateTrackInstance = UZLTrackedStateBlueprint::GetZLTrackedStateInstance())
+	{
+		stateTrackInstance->OnTrackedStateUpdate.Broadcast();
+	}
+}
 
-					//jsonForWebObject->SetNumberField("total_leaves", JsonObject_requestedStateLeafCount);
+void UZLCloudPluginStateManager::TrackStateBlueprint(const FString& bluePrintName)
+{
+	if (bluePrintName.IsEmpty() || m_trackedStateObservers.Contains(bluePrintName))
+		return;
 
-					SendFJsonObjectToWeb(jsonForWebObject);
-				}
-			}
+	m_trackedStateObservers.Add(bluePrintName, StateObservers.Subscribe(EZLStateObserverSource::Requested, FZLStateKeyPath::Intern(bluePrintName),
+		FZLOnStatePathsChanged::CreateUObject(this, &UZLCloudPluginStateManager::OnTrackedStateRequested)));
+}
 
-			Success = JsonObject_out_requestedState.IsValid();
+void UZLCloudPluginStateManager::OnTrackedStateRequested(const TArray<FZLStateKeyPath>& paths)
+{
+	m_trackedStateRequested = true;
+}
 
-			//Trigger tracked states to see if any pull out state data
-			if (UZLTrackedStateBlueprint* stateTrackInstance = UZLTrackedStateBlueprint::GetZLTrackedStateInstance())
+void UZLCloudPluginStateManager::AddMergedRequestIds(const FZLInFlightStateRequest& request, TSharedPtr<FJsonObject> jsonForWebObject)
+{
+	//Queued requests folded into the one being reported, they share its status
+	auto addIds = [&jsonForWebObject](const TCHAR* fieldName, const TArray<FString>& requestIds)
+	{
+		if (requestIds.Num() > 0)
+		{
+			TArray<TSharedPtr<FJsonValue>> idValues;
+			for (const FString& id : requestIds)
 			{
-				stateTrackInstance->OnTrackedStateUpdate.Broadcast();
+				idValues.Add(MakeShared<FJsonValueString>(id));
 			}
+			jsonForWebObject->SetArrayField(fieldName, idValues);
 		}
-		else
+	};
+
+	addIds(TEXT("coalesced_request_ids"), request.CoalescedRequestIds);
+	addIds(TEXT("superseded_request_ids"), request.SupersededRequestIds);
+}
+
+bool UZLCloudPluginStateManager::IsProcessingStateRequest()
+{
+	return m_inFlightRequests.Num() > 0;
+}
+
+FZLInFlightStateRequest* UZLCloudPluginStateManager::FindStateRequestForKey(const FString& FieldName)
+{
+	int32 dotIndex = INDEX_NONE;
+	FZLInFlightStateRequest* const* owner = FieldName.FindChar(TCHAR('.'), dotIndex) ? m_requestKeyOwners.Find(FieldName.Left(dotIndex)) : m_requestKeyOwners.Find(FieldName);
+	return owner ? *owner : nullptr;
+}
+
+bool UZLCloudPluginStateManager::HasKeysInProcessing(const FZLInFlightStateRequest& request) const
+{
+	for (const FString& key : request.Keys)
+	{
+		if (JsonObject_processingState->Values.Contains(key))
 		{
-			Success = false;
+			return true;
 		}
 	}
+	return false;
 }
 
-bool UZLCloudPluginStateManager::IsProcessingStateRequest()
+TSharedPtr<FJsonObject> UZLCloudPluginStateManager::ExtractStateRequestKeys(const TSharedPtr<FJsonObject>& JsonObject, const FZLInFlightStateRequest& request) const
 {
-	//If processing object is valid and has a requestid then there is an in-flight state request
-	return JsonObject_processingState.IsValid() && JsonObject_processingState->HasField(s_requestIdStr);
+	TSharedPtr<FJsonObject> requestKeys = MakeShareable(new FJsonObject);
+	for (const FString& key : request.Keys)
+	{
+		if (const TSharedPtr<FJsonValue>* value = JsonObject->Values.Find(key))
+		{
+			requestKeys->SetField(key, *value);
+		}
+	}
+	return requestKeys;
 }
 
 void UZLCloudPluginStateManager::PopStateRequestQueue()
 {
-	FString stateDataStr;
-	if (JsonString_in_requestQueue.Dequeue(stateDataStr))
+	StartQueuedStateRequests();
+}
+
+void UZLCloudPluginStateManager::StartQueuedStateRequests()
+{
+	//A request can only go ahead of earlier queued ones if none of them touch its keys
+	for (int32 i = 0; i < m_stateRequestQueue.Num();)
 	{
-		s_requestQueueLength--;
-		if (UZLCloudPluginDelegates* Delegates = UZLCloudPluginDelegates::GetZLCloudPluginDelegates())
+		if (OverlapsQueuedStateRequests(m_stateRequestQueue[i].State, i) || !CanStartQueuedStateRequest(m_stateRequestQueue[i]))
+		{
+			++i;
+			continue;
+		}
+
+		//Started as parsed, CanStartQueuedStateRequest already checked every key it could need is free
+		bool started = false;
+		if (!TryStartStateRequest(m_stateRequestQueue[i], started))
 		{
-			Delegates->OnRecieveData.Broadcast(stateDataStr);
+			++i;
+			continue;
 		}
+
+		const TSharedPtr<FJsonObject> requestedState = m_stateRequestQueue[i].State;
+		m_stateRequestQueue.RemoveAt(i);
+
+		//Its values are already requested, whatever handles requests only needs to know to pull them
+		NotifyStateRequestStarted(requestedState);
+	}
+}
+
+bool UZLCloudPluginStateManager::CanStartQueuedStateRequest(const FZLQueuedStateRequest& request) const
+{
+	TSharedPtr<ZLCloudPlugin::ZLScreenshot> screenshotManager = ZLCloudPlugin::ZLScreenshot::Get();
+	if (screenshotManager && screenshotManager->HasCurrentRender() && m_inFlightRequests.Num() > 0)
+	{
+		return false;
+	}
+
+	//Checked against every requested key rather than what will differ, so TryStartStateRequest can't turn the request away
+	for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : request.State->Values)
+	{
+		if (m_requestKeyOwners.Contains(Pair.Key))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void UZLCloudPluginStateManager::SetStateClock(TFunction<double()> clock)
+{
+	m_stateClock = MoveTemp(clock);
+
+	//Deadlines already scheduled were on the old clock, restart them from now on the new one
+	const double now = GetStateTime();
+	m_stateTimers.Reset(now);
+
+	for (const TUniquePtr<FZLInFlightStateRequest>& request : m_inFlightRequests)
+	{
+		request->StartTime = now;
+		ScheduleStateRequestDeadlines(*request);
+	}
+
+	if (m_needServerNotify)
+	{
+		m_serverStateNotifyStart = now;
+		ScheduleServerNotifyDeadlines();
 	}
 }
 
+void UZLCloudPluginStateManager::ScheduleStateRequestDeadlines(FZLInFlightStateRequest& request)
+{
+	FZLInFlightStateRequest* requestPtr = &request;
+	request.bWarningDue = false;
+	request.bTimedOut = false;
+	request.WarningTimer = m_stateTimers.Schedule(request.StartTime + m_stateRequestWarningTime, [requestPtr]() { requestPtr->bWarningDue = true; });
+	request.TimeoutTimer = m_stateTimers.Schedule(request.StartTime + m_stateRequestTimeout, [requestPtr]() { requestPtr->bTimedOut = true; });
+}
+
+void UZLCloudPluginStateManager::ScheduleServerNotifyDeadlines()
+{
+	m_stateTimers.Cancel(m_serverNotifyWarningTimer);
+	m_stateTimers.Cancel(m_serverNotifyTimeoutTimer);
+	m_serverNotifyWarningDue = false;
+	m_serverNotifyTimedOut = false;
+	m_serverNotifyWarningTimer = m_stateTimers.Schedule(m_serverStateNotifyStart + m_stateRequestWarningTime, [this]() { m_serverNotifyWarningDue = true; });
+	m_serverNotifyTimeoutTimer = m_stateTimers.Schedule(m_serverStateNotifyStart + m_stateRequestTimeout, [this]() { m_serverNotifyTimedOut = true; });
+}
+
 void UZLCloudPluginStateManager::Update(LauncherComms* launcherComms)
 {
-	FString requestId = "";
-	bool clearProcessing = false;
-	bool popStateRequestList = false;
+	//Deadlines only raise flags on the requests, so this is all the tick costs until one of them expires
+	m_stateTimers.Advance(GetStateTime());
 
-	bool stateRequestedContentJob = false;
-	TSharedPtr<ZLCloudPlugin::ZLScreenshot> screenshotManager = ZLCloudPlugin::ZLScreenshot::Get();
-	if (screenshotManager)
+	//Observers see everything marked since the last tick, requests they confirm straight away complete below
+	StateObservers.Dispatch();
+
+	//One wake up for every tracked state blueprint key requested since the last tick, they pull their values straight away too
+	if (m_trackedStateRequested)
 	{
-		stateRequestedContentJob = screenshotManager->HasCurrentRender();
+		m_trackedStateRequested = false;
+		BroadcastTrackedStateUpdate();
 	}
 
-	if (IsProcessingStateRequest())
+	bool requestsFinished = false;
+	for (int32 i = 0; i < m_inFlightRequests.Num();)
 	{
-		requestId = JsonObject_processingState->GetStringField(s_requestIdStr);
+		bool finished = false;
+		UpdateStateRequest(*m_inFlightRequests[i], finished);
 
-		//All requested states processed, send completion message
-		if (JsonObject_requestedStateLeafCount == JsonObject_processingStateFinishedLeaves)
+		if (finished)
 		{
-			SetStateDirty(EStateDirtyReason::state_processing_ended);
+			FinishStateRequest(*m_inFlightRequests[i]);
+			requestsFinished = true;
+		}
+		else
+		{
+			++i;
+		}
+	}
 
-			if (stateRequestedContentJob)
+	if (requestsFinished)
+		StartQueuedStateRequests(); //Start anything queued on the keys just released
+
+	//Internal changes while requests are in flight go out with the next state_processing_ended
+	if (m_stateDirty && m_inFlightRequests.Num() == 0)
+		PushStateEventsToWeb();
+
+	if (m_needServerNotify && JsonObject_serverNotifyState.IsValid())
+	{
+		if (ServerNotifyMatch.Update(CurrentStateTree)) //State matches current render state data, only rechecks keys changed since last tick
+		{
+			//Send server notify and clear
+			m_needServerNotify = false;
+			ServerNotifyMatch.Reset();
+			m_stateTimers.Cancel(m_serverNotifyWarningTimer);
+			m_stateTimers.Cancel(m_serverNotifyTimeoutTimer);
+			launcherComms->SendLauncherMessage("APPINITIALSTATESET"); //onConnect is ready, allow adoption
+		}
+		else if (m_serverNotifyTimedOut)
+		{
+			JsonObject_serverNotifyUnmatchedState = CreateDiffJsonObject(JsonObject_currentState, JsonObject_serverNotifyState);
+
+			m_needServerNotify = false;
+			ServerNotifyMatch.Reset();
+			m_stateTimers.Cancel(m_serverNotifyWarningTimer);
+
+			launcherComms->SendLauncherMessage("APPINITIALSTATESET"); //onConnect is ready, allow adoption
+		}
+		else if (m_serverNotifyWarningDue)
+		{
+			m_serverNotifyWarningDue = false;
+
+			const double currTime = GetStateTime();
+			const double elapsedTime = currTime - m_serverStateNotifyStart;
+
+			TArray<FString> diffKeys = ServerNotifyMatch.GetUnmatchedKeys();
+			UE_LOG(LogZLCloudPlugin, Display, TEXT("Connection waiting on %d state objects to match..."), diffKeys.Num());
+			for (FString key : diffKeys)
 			{
-				screenshotManager->SetCurrentRenderStateData(JsonObject_currentState);
-				screenshotManager->UpdateCurrentRenderStateRequestProgress(true, true);
+				UE_LOG(LogZLCloudPlugin, Display, TEXT("Connection waiting for %f on %s state"), round(elapsedTime), *key);
 			}
 
-			clearProcessing = true;
-			popStateRequestList = true;
+			//Only print every 1 sec until the timeout
+			if (currTime + 1.0 < m_serverStateNotifyStart + m_stateRequestTimeout)
+			{
+				m_serverNotifyWarningTimer = m_stateTimers.Schedule(currTime + 1.0, [this]() { m_serverNotifyWarningDue = true; });
+			}
 		}
-		else 
+	}
+
+	//This tick's state changes go to the journal as one record, the writer thread does the file IO
+	if (StateJournal)
+		StateJournal->Flush(JsonObject_currentState, GetUnconfirmedState());
+	if (StateRecorder)
+		StateRecorder->Flush(JsonObject_currentState, GetStateTime());
+
+#if STATS
+	//Walking every tree isn't free, only while someone is looking and at most once a second
+	const double now = FPlatformTime::Seconds();
+	if (FThreadStats::IsCollectingData() && now - m_lastMemoryStatsTime >= 1.0)
+	{
+		m_lastMemoryStatsTime = now;
+		FZLStateMemoryReport memoryReport;
+		GetStateMemoryReport(memoryReport);
+		memoryReport.PublishStats();
+	}
+#endif
+}
+
+void UZLCloudPluginStateManager::GetStateMemoryReport(FZLStateMemoryReport& outReport) const
+{
+	outReport = FZLStateMemoryReport();
+	FZLJsonMemoryCounter counter;
+	auto countTree = [&outReport, &counter](EZLStateMemoryTree tree, const TSharedPtr<FJsonObject>& jsonObject)
+	{
+		outReport.Trees[(int32)tree] += counter.Count(jsonObject);
+	};
+
+	//Current first, the web copies share most of it
+	countTree(EZLStateMemoryTree::Current, JsonObject_currentState);
+	countTree(EZLStateMemoryTree::WebCurrent, JsonObject_web_currentState);
+
+	TArray<TSharedPtr<FJsonObject>> webSyncStates;
+	WebStateSync.GetKeptStates(webSyncStates);
+	for (const TSharedPtr<FJsonObject>& webSyncState : webSyncStates)
+	{
+		countTree(EZLStateMemoryTree::WebSyncStates, webSyncState);
+	}
+
+	countTree(EZLStateMemoryTree::Processing, JsonObject_processingState);
+	countTree(EZLStateMemoryTree::InRequested, JsonObject_in_requestedState);
+	countTree(EZLStateMemoryTree::OutRequested, JsonObject_out_requestedState);
+	countTree(EZLStateMemoryTree::ServerNotify, JsonObject_serverNotifyState);
+	countTree(EZLStateMemoryTree::ServerNotifyUnmatched, JsonObject_serverNotifyUnmatchedState);
+	countTree(EZLStateMemoryTree::DefaultInitial, JsonObject_DefaultInitialState);
+
+	outReport.DuplicateKeyBytes = counter.GetDuplicateKeyBytes();
+}
+
+void UZLCloudPluginStateManager::UpdateStateRequest(FZLInFlightStateRequest& request, bool& finished)
+{
+	finished = false;
+
+	bool stateRequestedContentJob = false;
+	TSharedPtr<ZLCloudPlugin::ZLScreenshot> screenshotManager = ZLCloudPlugin::ZLScreenshot::Get();
+	if (screenshotManager)
+	{
+		stateRequestedContentJob = screenshotManager->HasCurrentRender();
+	}
+
+	//All requested states processed, send completion message
+	if (request.RequestedLeafCount == request.FinishedLeaves)
+	{
+		SendStateRequestEndedToWeb(&request, "complete");
+
+		if (stateRequestedContentJob)
 		{
-			if (JsonObject_processingState->Values.Num() > 1) //Still waiting on something in-processing
-			{
-				//State warning prints + timeout sent to web
-				double currTime = FApp::GetCurrentTime();
-				double elapsedTime = currTime - JsonObject_processingStateStartTime;
+			screenshotManager->SetCurrentRenderStateData(JsonObject_currentState);
+			screenshotManager->UpdateCurrentRenderStateRequestProgress(true, true);
+		}
 
-				if (elapsedTime > m_stateRequestWarningTime && elapsedTime < m_stateRequestTimeout)
-				{
-					if ((currTime - m_lastStateWarningPrintTime) > 1.0) //Only print every 1 sec
-					{
-						TArray<FString> diffKeys = CurrentStateCompareDiffs_Keys(JsonObject_processingState);
-						if (diffKeys.Contains(s_requestIdStr)) //Dont need to log this
-							diffKeys.Remove(s_requestIdStr);
+		finished = true;
+		return;
+	}
 
-						UE_LOG(LogZLCloudPlugin, Display, TEXT("State request %s still waiting for %d state objects to match..."), *requestId, diffKeys.Num());
-						for (FString key : diffKeys)
-						{
-							UE_LOG(LogZLCloudPlugin, Display, TEXT("Request waiting for %f on %s state"), round(elapsedTime), *key);
-						}
-						m_lastStateWarningPrintTime = currTime;
-					}
-				}
-				else if (elapsedTime > m_stateRequestTimeout)
-				{
-					TSharedPtr<FJsonObject> timeoutState = CurrentStateCompareDiffs(JsonObject_processingState);
-					TSharedPtr<FJsonObject> unprocessed = nullptr;
-					if (JsonObject_processingStateLeafCount < JsonObject_requestedStateLeafCount) //Some requested states were ignored
-					{
-						unprocessed = CurrentStateCompareDiffs(JsonObject_out_requestedState);
-						TArray<FString> diffKeys = CurrentStateCompareDiffs_Keys(JsonObject_processingState);
-						for (FString key : diffKeys) //Strip timed out values to report any unprocessed
-						{
-							if (unprocessed->TryGetField(key))
-							{
-								unprocessed->RemoveField(key);
-							}
-						}
-						if (unprocessed->HasField(s_requestIdStr))
-							unprocessed->RemoveField(s_requestIdStr);
-					}
+	const bool waitingOnProcessing = HasKeysInProcessing(request);
 
-					if (stateRequestedContentJob)
-					{
-						screenshotManager->SetCurrentRenderStateData(JsonObject_currentState, timeoutState, unprocessed);
-						screenshotManager->UpdateCurrentRenderStateRequestProgress(true, false);
-					}
+	if (!waitingOnProcessing && request.ProcessingLeafCount < request.RequestedLeafCount) //Some requested states were ignored
+	{
+		//Return current state + unprocessed to the web
+		TSharedPtr<FJsonObject> unprocessedJson = CurrentStateCompareDiffs(ExtractStateRequestKeys(JsonObject_out_requestedState, request));
 
-					SetStateDirty(EStateDirtyReason::state_processing_ended);
+		FString JsonString_Unprocessed;
+		TSharedRef<TJsonWriter<TCHAR>> JsonWriterUnprocessed = TJsonWriterFactory<TCHAR>::Create(&JsonString_Unprocessed, 1);
+		FJsonSerializer::Serialize(unprocessedJson.ToSharedRef(), JsonWriterUnprocessed);
+		JsonWriterUnprocessed->Close();
 
-					clearProcessing = true;
-					popStateRequestList = true;
-				}
-			}
-			else if(JsonObject_processingStateLeafCount < JsonObject_requestedStateLeafCount) //Some requested states were ignored
-			{
-				//Return current state + unprocessed to the web
-				TSharedPtr<FJsonObject> unprocessedJson = CurrentStateCompareDiffs(JsonObject_out_requestedState);
-				if (unprocessedJson->HasField(s_requestIdStr))
-					unprocessedJson->RemoveField(s_requestIdStr);
+		UE_LOG(LogZLCloudPlugin, Display, TEXT("Unprocessed State in request %s: %s"), *request.RequestId, *JsonString_Unprocessed);
 
-				FString JsonString_Unprocessed;
-				TSharedRef<TJsonWriter<TCHAR>> JsonWriterUnprocessed = TJsonWriterFactory<TCHAR>::Create(&JsonString_Unprocessed, 1);
-				FJsonSerializer::Serialize(unprocessedJson.ToSharedRef(), JsonWriterUnprocessed);
-				JsonWriterUnprocessed->Close();
+		SendStateRequestEndedToWeb(&request, "unmatched", nullptr, unprocessedJson);
 
-				UE_LOG(LogZLCloudPlugin, Display, TEXT("Unprocessed State in previous request: %s"), *JsonString_Unprocessed);
+		if (stateRequestedContentJob)
+		{
+			screenshotManager->SetCurrentRenderStateData(JsonObject_currentState, nullptr, unprocessedJson);
+			screenshotManager->UpdateCurrentRenderStateRequestProgress(true, false);
+		}
 
-				SetStateDirty(EStateDirtyReason::state_processing_ended);
+		finished = true;
+	}
+	else if (request.bTimedOut)
+	{
+		//Return current state + timed out + unprocessed to the web
+		TSharedPtr<FJsonObject> processingState = ExtractStateRequestKeys(JsonObject_processingState, request);
+		TSharedPtr<FJsonObject> timeoutState = CurrentStateCompareDiffs(processingState);
 
-				if (stateRequestedContentJob)
+		TSharedPtr<FJsonObject> unprocessed = nullptr;
+		if (request.ProcessingLeafCount < request.RequestedLeafCount) //Some requested states were ignored
+		{
+			unprocessed = CurrentStateCompareDiffs(ExtractStateRequestKeys(JsonObject_out_requestedState, request));
+			TArray<FString> diffKeys = CurrentStateCompareDiffs_Keys(processingState);
+			for (FString key : diffKeys) //Strip timed out values to report any unprocessed
+			{
+				if (unprocessed->TryGetField(key))
 				{
-					screenshotManager->SetCurrentRenderStateData(JsonObject_currentState, nullptr, unprocessedJson);
-					screenshotManager->UpdateCurrentRenderStateRequestProgress(true, false);
+					unprocessed->RemoveField(key);
 				}
-
-				clearProcessing = true;
-				popStateRequestList = true;
 			}
 		}
-	}
-	else if(JsonObject_requestedStateLeafCount != JsonObject_processingStateFinishedLeaves) //Also need to account for any requests that never entered processing due to invalid fields or instant confirms but were incomplete
-	{
-		requestId = JsonObject_out_requestedState->GetStringField(s_requestIdStr);
-
-		//Return current state + unprocessed to the web
-		TSharedPtr<FJsonObject> currentJson = MakeShareable(new FJsonObject);
-		TSharedPtr<FJsonObject> unprocessedJson = CurrentStateCompareDiffs(JsonObject_out_requestedState);
-		if (unprocessedJson->HasField(s_requestIdStr))
-			unprocessedJson->RemoveField(s_requestIdStr);
 
-		SetStateDirty(EStateDirtyReason::state_processing_ended);
+		RecordUnconfirmedKeyMetrics(timeoutState, true);
+		SendStateRequestEndedToWeb(&request, "timeout", timeoutState, unprocessed);
 
 		if (stateRequestedContentJob)
 		{
-			screenshotManager->SetCurrentRenderStateData(JsonObject_currentState, nullptr, unprocessedJson);
+			screenshotManager->SetCurrentRenderStateData(JsonObject_currentState, timeoutState, unprocessed);
 			screenshotManager->UpdateCurrentRenderStateRequestProgress(true, false);
 		}
 
-		clearProcessing = true;
-		popStateRequestList = true;
+		finished = true;
 	}
+	else if (request.bWarningDue && waitingOnProcessing)
+	{
+		request.bWarningDue = false;
 
-	if (m_stateDirty)
-		PushStateEventsToWeb();
+		const double currTime = GetStateTime();
+		const double elapsedTime = currTime - request.StartTime;
 
-	if(clearProcessing)
-		ClearProcessingState();
+		TSharedPtr<FJsonObject> waitingState = ExtractStateRequestKeys(JsonObject_processingState, request);
+		TArray<FString> diffKeys = CurrentStateCompareDiffs_Keys(waitingState);
 
-	if(popStateRequestList)
-		PopStateRequestQueue(); //Process next request if any queued
+		//Warnings repeat every second until the timeout, count each request once per key
+		if (!request.bWarningRecorded)
+		{
+			request.bWarningRecorded = true;
+			RecordUnconfirmedKeyMetrics(CurrentStateCompareDiffs(waitingState), false);
+		}
 
-	if (m_needServerNotify && JsonObject_serverNotifyState.IsValid())
-	{
-		if (CurrentStateCompareDiffs_Keys(JsonObject_serverNotifyState).Num() == 0) //State matches current render state data
+		UE_LOG(LogZLCloudPlugin, Display, TEXT("State request %s still waiting for %d state objects to match..."), *request.RequestId, diffKeys.Num());
+		for (FString key : diffKeys)
 		{
-			//Send server notify and clear
-			m_needServerNotify = false;
-			launcherComms->SendLauncherMessage("APPINITIALSTATESET"); //onConnect is ready, allow adoption
+			UE_LOG(LogZLCloudPlugin, Display, TEXT("Request waiting for %f on %s state"), round(elapsedTime), *key);
 		}
-		else
+
+		//Only print every 1 sec until the timeout
+		if (currTime + 1.0 < request.StartTime + m_stateRequestTimeout)
 		{
-			double currTime = FApp::GetCurrentTime();
-			double elapsedTime = currTime - m_serverStateNotifyStart;
+			FZLInFlightStateRequest* requestPtr = &request;
+			request.WarningTimer = m_stateTimers.Schedule(currTime + 1.0, [requestPtr]() { requestPtr->bWarningDue = true; });
+		}
+	}
+}
+
+void UZLCloudPluginStateManager::RecordUnconfirmedKeyMetrics(TSharedPtr<FJsonObject> unconfirmedState, bool timedOut)
+{
+	if (!unconfirmedState.IsValid())
+		return;
 
-			if (elapsedTime > m_stateRequestWarningTime && elapsedTime < m_stateRequestTimeout)
+	//Counted against each leaf still waiting, the level a handler usually confirms at
+	TFunction<void(const FJsonObject&, const FString&)> recordLeaves = [this, timedOut, &recordLeaves](const FJsonObject& object, const FString& prefix)
+	{
+		for (const TPair<FString, TSharedPtr<FJsonValue>>& pair : object.Values)
+		{
+			const FString key = prefix.IsEmpty() ? pair.Key : prefix + TEXT(".") + pair.Key;
+			if (pair.Value.IsValid() && pair.Value->Type == EJson::Object && pair.Value->AsObject().IsValid() && pair.Value->AsObject()->Values.Num() > 0)
 			{
-				if ((currTime - m_lastStateWarningPrintTime) > 1.0) //Only print every 1 sec
-				{
-					TArray<FString> diffKeys = CurrentStateCompareDiffs_Keys(JsonObject_serverNotifyState);
-					UE_LOG(LogZLCloudPlugin, Display, TEXT("Connection waiting on %d state objects to match..."), diffKeys.Num());
-					for (FString key : diffKeys)
-					{
-						UE_LOG(LogZLCloudPlugin, Display, TEXT("Connection waiting for %f on %s state"), round(elapsedTime), *key);
-					}
-					m_lastStateWarningPrintTime = currTime;
-				}
+				recordLeaves(*pair.Value->AsObject(), key);
+			}
+			else if (timedOut)
+			{
+				StateKeyMetrics.RecordTimeout(key);
 			}
-			else if (elapsedTime > m_stateRequestTimeout)
+			else
 			{
-				JsonObject_serverNotifyUnmatchedState = CreateDiffJsonObject(JsonObject_currentState, JsonObject_serverNotifyState);
+				StateKeyMetrics.RecordWarning(key);
+			}
+		}
+	};
+	recordLeaves(*unconfirmedState, FString());
+}
 
-				m_needServerNotify = false;
+void UZLCloudPluginStateManager::FinishStateRequest(FZLInFlightStateRequest& request)
+{
+	m_stateTimers.Cancel(request.WarningTimer);
+	m_stateTimers.Cancel(request.TimeoutTimer);
 
-				launcherComms->SendLauncherMessage("APPINITIALSTATESET"); //onConnect is ready, allow adoption
-			}
+	//Whatever is left under its keys in the shared trees belongs to this request alone
+	for (const FString& key : request.Keys)
+	{
+		m_requestKeyOwners.Remove(key);
+		JsonObject_out_requestedState->RemoveField(key);
+		JsonObject_processingState->RemoveField(key);
+	}
+	InvalidateKeyPathCaches();
 
-		}
+	const FZLInFlightStateRequest* finishedRequest = &request;
+	m_inFlightRequests.RemoveAll([finishedRequest](const TUniquePtr<FZLInFlightStateRequest>& inFlight) { return inFlight.Get() == finishedRequest; });
+
+	if (m_inFlightRequests.Num() == 0)
+	{
+		ClearProcessingState();
+	}
+}
+
+void UZLCloudPluginStateManager::SendStateRequestEndedToWeb(const FZLInFlightStateRequest* request, const FString& status, TSharedPtr<FJsonObject> timeoutState, TSharedPtr<FJsonObject> unprocessedState)
+{
+	TSharedPtr<FJsonObject> currentJson = MakeShareable(new FJsonObject);
+	TSharedPtr<FJsonObject> jsonForWebObject = MakeShareable(new FJsonObject);
+
+	currentJson->SetStringField("status", status);
+	if (timeoutState.IsValid())
+	{
+		currentJson->SetObjectField("timeout_state", timeoutState);
+	}
+	if (unprocessedState.IsValid())
+	{
+		currentJson->SetObjectField("unprocessed_state", unprocessedState);
+	}
+
+	//Full current_state, or a merge patch against the last state the page acknowledged if it opted in
+	const bool fullSnapshot = WebStateSync.WriteState(CurrentStateTree, currentJson);
+
+	jsonForWebObject->SetObjectField("state_processing_ended", currentJson);
+	if (request)
+	{
+		jsonForWebObject->SetStringField(s_requestIdStr, request->RequestId); //add in request Id
+		AddMergedRequestIds(*request, jsonForWebObject);
 	}
 
+	const int32 sentChars = SendFJsonObjectToWeb(jsonForWebObject);
+	WebStateSync.RecordSent(fullSnapshot, sentChars);
+
+	if (request && OnStateRequestEnded.IsBound())
+	{
+		FZLStateRequestTiming timing;
+		timing.RequestId = request->RequestId;
+		timing.Status = status;
+		timing.ArrivalTime = request->ArrivalTime;
+		timing.StartTime = request->StartTime;
+		timing.EndTime = GetStateTime();
+		timing.MergedArrivalTimes = request->MergedArrivalTimes;
+		OnStateRequestEnded.Broadcast(timing);
+	}
+
+	//Carries the whole current state, so any internal change waiting to be pushed is covered too
+	m_stateDirty = false;
 }
 
 
@@ -1273,23 +2254,29 @@ void UZLCloudPluginStateManager::ConfirmStateChange(FString FieldName, bool& Suc
 {
 	Success = false;
 
+	//Counted against whichever in-flight request owns the top level key
+	FZLInFlightStateRequest* owningRequest = FindStateRequestForKey(FieldName);
+
 	//Set no longer processing
 	if (JsonObject_processingState.IsValid())
 	{
 		if (FieldName.Contains("."))
 		{
 			// . delimited nesting (this is mainly because BP does not handle generic types like FJsonValue or FJsonObject)
+			const FZLStateKeyPath KeyPath = FZLStateKeyPath::Intern(FieldName);
 			const TSharedPtr<FJsonValue>* nestedValue;
-			Success = GetJsonValueFromNestedKey(FieldName, JsonObject_processingState, nestedValue);
+			Success = GetJsonValueFromNestedKey(KeyPath, JsonObject_processingState, nestedValue, &ProcessingStateKeyCache);
 
 			if (Success)
 			{
-				SetJsonValueFromNestedKey(FieldName, JsonObject_currentState, nestedValue->Get());
+				SetJsonValueFromNestedKey(KeyPath, JsonObject_currentState, nestedValue->Get(), &CurrentStateKeyCache);
+				MarkCurrentStateChanged(KeyPath);
 
-				JsonObject_processingStateFinishedLeaves++;
+				if (owningRequest)
+					owningRequest->FinishedLeaves++;
 
 				//Remove from processing
-				RemoveNestedKey(FieldName, JsonObject_processingState);
+				RemoveNestedKey(KeyPath, JsonObject_processingState, &ProcessingStateKeyCache);
 			}
 			else
 				return;
@@ -1332,18 +2319,21 @@ void UZLCloudPluginStateManager::ConfirmStateChange(FString FieldName, bool& Suc
 					{
 						JsonObject_currentState->SetObjectField(FieldName, value->AsObject());
 					}
-					JsonObject_processingStateFinishedLeaves += processedLeaves;
+					if (owningRequest)
+						owningRequest->FinishedLeaves += processedLeaves;
 					break;
 				default:
 					UE_LOG(LogZLCloudPlugin, Display, TEXT("Unhandled confirmation for EJson type %i"), value->Type);
 					break;
 			}	
+			MarkCurrentStateChanged(FZLStateKeyPath::Intern(FieldName));
 
-			if(incrementProcessedLeafCount)
-				JsonObject_processingStateFinishedLeaves++;
+			if(incrementProcessedLeafCount && owningRequest)
+				owningRequest->FinishedLeaves++;
 
 			//Remove from processing
 			JsonObject_processingState->RemoveField(FieldName);
+			InvalidateKeyPathCaches();
 		}
 		else
 		{
@@ -1353,6 +2343,13 @@ void UZLCloudPluginStateManager::ConfirmStateChange(FString FieldName, bool& Suc
 		if (Success && DebugUIWidget && DebugUIWidget->IsVisible())
 			DebugUIWidget->TriggerRefreshUI();
 
+		if (Success && StateRecorder)
+			StateRecorder->RecordConfirm(FieldName, GetStateTime());
+
+		//Time from the request reaching the app, queue wait is down to whichever request held up its keys
+		if (Success && owningRequest)
+			StateKeyMetrics.RecordConfirm(FieldName, GetStateTime() - owningRequest->StartTime);
+
 	}
 	else
 	{
@@ -1365,14 +2362,25 @@ void UZLCloudPluginStateManager::RemoveCurrentStateValue(FString FieldName)
 	if (FieldName.Contains("."))
 	{
 		// . delimited nesting (this is mainly because BP does not handle generic types like FJsonValue or FJsonObject)
-		RemoveNestedKey(FieldName, JsonObject_currentState);
+		const FZLStateKeyPath KeyPath = FZLStateKeyPath::Intern(FieldName);
+		RemoveNestedKey(KeyPath, JsonObject_currentState, &CurrentStateKeyCache);
+		MarkCurrentStateChanged(KeyPath);
 	}
 	else if (JsonObject_currentState->HasField(FieldName))
 	{
 		JsonObject_currentState->RemoveField(FieldName);
+		CurrentStateKeyCache.Invalidate();
+		MarkCurrentStateChanged(FZLStateKeyPath::Intern(FieldName));
 	}
 }
 
+void UZLCloudPluginStateManager::InvalidateKeyPathCaches()
+{
+	CurrentStateKeyCache.Invalidate();
+	ProcessingStateKeyCache.Invalidate();
+	RequestedStateKeyCache.Invalidate();
+}
+
 void UZLCloudPluginStateManager::CopyRequestId()
 {
 	//Copy request Id
@@ -1408,14 +2416,21 @@ template <typename T> void UZLCloudPluginStateManager::GetRequestedStateValue(FS
 	constexpr bool isString = (std::is_same<T, FString>::value)
 						|| (std::is_same<T, TArray<FString>>::value);
 
+	//Confirmed scalars go straight into the typed store, arrays are left for it to reload as the caller's array may not start empty
+	constexpr bool isScalar = !isArray && (isNumber || isBool || isString);
+
 	if (JsonObject_out_requestedState.IsValid())
 	{
+		//Counted against whichever in-flight request owns the top level key
+		FZLInFlightStateRequest* owningRequest = FindStateRequestForKey(FieldName);
+
 		int numLeavesInc = 0;
 		if (FieldName.Contains("."))
 		{
 			// . delimited nesting (this is mainly because BP does not handle generic types like FJsonValue or FJsonObject)
+			const FZLStateKeyPath KeyPath = FZLStateKeyPath::Intern(FieldName);
 			const TSharedPtr<FJsonValue>* nestedValue = nullptr;
-			Success = GetJsonValueFromNestedKey(FieldName, JsonObject_out_requestedState, nestedValue);
+			Success = GetJsonValueFromNestedKey(KeyPath, JsonObject_out_requestedState, nestedValue, &RequestedStateKeyCache);
 
 			TSharedPtr<FJsonValue> val;
 			if (Success)
@@ -1477,25 +2492,36 @@ template <typename T> void UZLCloudPluginStateManager::GetRequestedStateValue(FS
 			}
 
 			//Increment processing count
-			JsonObject_processingStateLeafCount += numLeavesInc;
+			if (owningRequest)
+				owningRequest->ProcessingLeafCount += numLeavesInc;
 
 			//add to processing
-			SetJsonValueFromNestedKey(FieldName, JsonObject_processingState, val.Get());
+			SetJsonValueFromNestedKey(KeyPath, JsonObject_processingState, val.Get(), &ProcessingStateKeyCache);
 
 			//remove from requested state
-			RemoveNestedKey(FieldName, JsonObject_out_requestedState);
+			RemoveNestedKey(KeyPath, JsonObject_out_requestedState, &RequestedStateKeyCache);
 
 			CopyRequestId();
 
 			if (instantConfirm)
 			{
-				JsonObject_processingStateFinishedLeaves++;
+				if (owningRequest)
+				{
+					owningRequest->FinishedLeaves++;
+					StateKeyMetrics.RecordConfirm(FieldName, GetStateTime() - owningRequest->StartTime);
+				}
 
 				//Remove from processing
-				RemoveNestedKey(FieldName, JsonObject_processingState);
+				RemoveNestedKey(KeyPath, JsonObject_processingState, &ProcessingStateKeyCache);
 
 				//Update current state
-				SetJsonValueFromNestedKey(FieldName, JsonObject_currentState, val.Get());
+				const uint64 versionBefore = CurrentStateTree.GetVersion();
+				SetJsonValueFromNestedKey(KeyPath, JsonObject_currentState, val.Get(), &CurrentStateKeyCache);
+				MarkCurrentStateChanged(KeyPath);
+				if constexpr (isScalar)
+				{
+					TypedCurrentState.Store(KeyPath, data, CurrentStateTree, versionBefore);
+				}
 			}
 		}
 		else if (JsonObject_out_requestedState->HasField(FieldName))
@@ -1562,7 +2588,8 @@ template <typename T> void UZLCloudPluginStateManager::GetRequestedStateValue(FS
 				}
 			}
 
-			JsonObject_processingStateLeafCount += numLeavesInc;
+			if (owningRequest)
+				owningRequest->ProcessingLeafCount += numLeavesInc;
 
 			//add to processing
 			if constexpr (isArray)
@@ -1592,14 +2619,25 @@ template <typename T> void UZLCloudPluginStateManager::GetRequestedStateValue(FS
 
 			CopyRequestId();
 
+			//Top level objects may have moved between trees
+			if constexpr (isJsonValue)
+			{
+				InvalidateKeyPathCaches();
+			}
+
 			if (instantConfirm)
 			{
-				JsonObject_processingStateFinishedLeaves += numLeavesInc;
+				if (owningRequest)
+				{
+					owningRequest->FinishedLeaves += numLeavesInc;
+					StateKeyMetrics.RecordConfirm(FieldName, GetStateTime() - owningRequest->StartTime);
+				}
 
 				//Remove from processing
 				JsonObject_processingState->RemoveField(FieldName);
 
 				//Update current state
+				const uint64 versionBefore = CurrentStateTree.GetVersion();
 				if constexpr (isArray)
 				{
 					JsonObject_currentState->SetArrayField(FieldName, *ArrayValue);
@@ -1620,6 +2658,12 @@ template <typename T> void UZLCloudPluginStateManager::GetRequestedStateValue(FS
 				{
 					JsonObject_currentState->SetField(FieldName, data);
 				}
+				const FZLStateKeyPath KeyPath = FZLStateKeyPath::Intern(FieldName);
+				MarkCurrentStateChanged(KeyPath);
+				if constexpr (isScalar)
+				{
+					TypedCurrentState.Store(KeyPath, data, CurrentStateTree, versionBefore);
+				}
 			}
 		}
 	}
@@ -1644,13 +2688,31 @@ template <typename T> void UZLCloudPluginStateManager::GetCurrentStateValue(FStr
 	constexpr bool isString = (std::is_same<T, FString>::value)
 		|| (std::is_same<T, TArray<FString>>::value);
 
+	//Schema keys read straight from their typed slot, anything the slot doesn't hold falls back to the JSON
+	if constexpr (!isJsonValue)
+	{
+		if (!TypedCurrentState.IsEmpty())
+		{
+			const FZLStateKeyPath KeyPath = FZLStateKeyPath::Intern(FieldName);
+			if (TypedCurrentState.HasSlot(KeyPath))
+			{
+				TypedCurrentState.Sync(CurrentStateTree);
+				if (TypedCurrentState.TryGet(KeyPath, data))
+				{
+					Success = true;
+					return;
+				}
+			}
+		}
+	}
+
 	if (JsonObject_currentState.IsValid())
 	{
 		if (FieldName.Contains("."))
 		{
 			// . delimited nesting (this is mainly because BP does not handle generic types like FJsonValue or FJsonObject)
 			const TSharedPtr<FJsonValue>* nestedValue = nullptr;
-			Success = GetJsonValueFromNestedKey(FieldName, JsonObject_currentState, nestedValue);
+			Success = GetJsonValueFromNestedKey(FZLStateKeyPath::Intern(FieldName), JsonObject_currentState, nestedValue, &CurrentStateKeyCache);
 
 			TSharedPtr<FJsonValue> val;
 			if (Success)
@@ -1775,16 +2837,15 @@ template <typename T> void UZLCloudPluginStateManager::SetCurrentStateValue(FStr
 		if (FieldName.Contains("."))
 		{
 			// . delimited nesting (this is mainly because BP does not handle generic types like FJsonValue or FJsonObject)
-			TArray<FString> Keys;
-			FieldName.ParseIntoArray(Keys, TEXT("."), true);
-
-			const FString FinalKey = Keys[Keys.Num() - 1];
+			const TArray<FZLStateKeyPath::FSegment>& Keys = FZLStateKeyPath::Intern(FieldName).GetSegments();
 
 			TSharedPtr<FJsonObject> CurrentObject = broadcastValueJson;
-			for (const FString& Key : Keys)
+			for (int32 KeyIndex = 0; KeyIndex < Keys.Num(); ++KeyIndex)
 			{
-				if (Key.Equals(FinalKey, ESearchCase::CaseSensitive))
+				const FString& Key = Keys[KeyIndex].Name;
+				if (KeyIndex == Keys.Num() - 1)
 				{
+					const FString& FinalKey = Key;
 					if constexpr (isArray)
 					{
 						TArray<TSharedPtr<FJsonValue>> ArrayValues;
@@ -1892,19 +2953,20 @@ template <typename T> void UZLCloudPluginStateManager::SetCurrentStateValue(FStr
 	}
 	else
 	{
+		const uint64 versionBefore = CurrentStateTree.GetVersion();
+
 		if (FieldName.Contains("."))
 		{
 			// . delimited nesting (this is mainly because BP does not handle generic types like FJsonValue or FJsonObject)
-			TArray<FString> Keys;
-			FieldName.ParseIntoArray(Keys, TEXT("."), true);
-
-			const FString FinalKey = Keys[Keys.Num() - 1];
+			const TArray<FZLStateKeyPath::FSegment>& Keys = FZLStateKeyPath::Intern(FieldName).GetSegments();
 
 			TSharedPtr<FJsonObject> CurrentObject = JsonObject_currentState;
-			for (const FString& Key : Keys)
+			for (int32 KeyIndex = 0; KeyIndex < Keys.Num(); ++KeyIndex)
 			{
-				if (Key.Equals(FinalKey, ESearchCase::CaseSensitive))
+				const FString& Key = Keys[KeyIndex].Name;
+				if (KeyIndex == Keys.Num() - 1)
 				{
+					const FString& FinalKey = Key;
 					if constexpr (isArray)
 					{
 						TArray<TSharedPtr<FJsonValue>> ArrayValues;
@@ -1948,77 +3010,414 @@ template <typename T> void UZLCloudPluginStateManager::SetCurrentStateValue(FStr
 				{
 					const TSharedPtr<FJsonObject>* SubObj = nullptr;
 
-					if (CurrentObject->TryGetObjectField(Key, SubObj))
-					{
-						CurrentObject = *SubObj;
-					}
-					else
-					{
-						TSharedPtr<FJsonObject> NewSubObj = MakeShared<FJsonObject>();
-						CurrentObject->SetObjectField(Key, NewSubObj);
-						CurrentObject = NewSubObj;
-					}
-				}
+					if (CurrentObject->TryGetObjectField(Key, SubObj))
+					{
+						CurrentObject = *SubObj;
+					}
+					else
+					{
+						TSharedPtr<FJsonObject> NewSubObj = MakeShared<FJsonObject>();
+						CurrentObject->SetObjectField(Key, NewSubObj);
+						CurrentObject = NewSubObj;
+						CurrentStateKeyCache.Invalidate();
+					}
+				}
+			}
+
+		}
+		else
+		{
+			if constexpr (isArray)
+			{
+				TArray<TSharedPtr<FJsonValue>> ArrayValues;
+				ArrayValues.Reserve(data.Num());
+
+				for (const auto& Value : data)
+				{
+					if constexpr (isNumber)
+					{
+						ArrayValues.Add(MakeShared<FJsonValueNumber>(Value));
+					}
+					else if constexpr (isBool)
+					{
+						ArrayValues.Add(MakeShared<FJsonValueBoolean>(Value));
+					}
+					else if constexpr (isString)
+					{
+						ArrayValues.Add(MakeShared<FJsonValueString>(Value));
+					}
+				}
+
+				JsonObject_currentState->SetArrayField(FieldName, ArrayValues);
+			}
+			else
+			{
+				if constexpr (isNumber)
+				{
+					JsonObject_currentState->SetNumberField(FieldName, data);
+				}
+				else if constexpr (isBool)
+				{
+					JsonObject_currentState->SetBoolField(FieldName, data);
+				}
+				else if constexpr (isString)
+				{
+					JsonObject_currentState->SetStringField(FieldName, data);
+				}
+			}
+		}
+		const FZLStateKeyPath KeyPath = FZLStateKeyPath::Intern(FieldName);
+		MarkCurrentStateChanged(KeyPath);
+
+		//Schema keys take the value straight into their slot rather than reloading it from the JSON on the next read
+		if constexpr (isNumber || isBool || isString)
+		{
+			TypedCurrentState.Store(KeyPath, data, CurrentStateTree, versionBefore);
+		}
+
+		SetStateDirty(EStateDirtyReason::state_notify_web);
+
+		RebuildDebugUI(ActiveSchema);
+		if (DebugUIWidget)
+			DebugUIWidget->TriggerRefreshUI();
+	}
+}
+
+namespace
+{
+	// Resolves a sorted run of key paths through one tree, keeping the objects along the last path so that keys
+	// sharing a prefix only walk the levels below it
+	class FZLSharedPrefixWalker
+	{
+	public:
+		explicit FZLSharedPrefixWalker(const TSharedPtr<FJsonObject>& Root)
+		{
+			Objects.Add(Root);
+		}
+
+		// Returns the object holding Path's leaf, or nullptr if a level is missing or isn't an object. With bCreate those
+		// levels are made instead (replacing any value in the way) and bOutCreatedLevel is set
+		TSharedPtr<FJsonObject> ResolveParent(const FZLStateKeyPath& Path, bool bCreate, bool* bOutCreatedLevel = nullptr)
+		{
+			const TArray<FZLStateKeyPath::FSegment>& Segments = Path.GetSegments();
+			const int32 NumLevels = Segments.Num() - 1;
+
+			int32 NumShared = 0;
+			while (NumShared < NumLevels && NumShared < Names.Num() && *Names[NumShared] == Segments[NumShared].Name)
+			{
+				++NumShared;
+			}
+			Objects.SetNum(NumShared + 1);
+			Names.SetNum(NumShared);
+
+			for (int32 i = NumShared; i < NumLevels; ++i)
+			{
+				const TSharedPtr<FJsonValue>* Value = FZLStateKeyPathCache::FindSegment(*Objects.Last(), Segments[i]);
+				TSharedPtr<FJsonObject> Next;
+				if (Value && Value->IsValid() && (*Value)->Type == EJson::Object && (*Value)->AsObject().IsValid())
+				{
+					Next = (*Value)->AsObject();
+				}
+				else if (bCreate)
+				{
+					Next = MakeShared<FJsonObject>();
+					Objects.Last()->SetObjectField(Segments[i].Name, Next);
+					if (bOutCreatedLevel)
+					{
+						*bOutCreatedLevel = true;
+					}
+				}
+				else
+				{
+					return nullptr;
+				}
+
+				Objects.Add(Next);
+				Names.Add(&Segments[i].Name);
+			}
+
+			return Objects.Last();
+		}
+
+		// Removes the objects left empty along the last resolved path, deepest first. The root itself is always kept
+		void RemoveEmptyLevels()
+		{
+			while (Names.Num() > 0 && Objects.Last()->Values.Num() == 0)
+			{
+				Objects[Objects.Num() - 2]->RemoveField(*Names.Last());
+				Objects.Pop();
+				Names.Pop();
+			}
+		}
+
+	private:
+		TArray<TSharedPtr<FJsonObject>, TInlineAllocator<8>> Objects;
+		TArray<const FString*, TInlineAllocator<8>> Names;
+	};
+
+	struct FZLBatchKey
+	{
+		FZLStateKeyPath Path;
+		const FString* FieldName = nullptr;
+	};
+
+	// Sorts the keys so paths sharing a prefix are adjacent, dropping duplicates and keys below an earlier key as they go along with it
+	void SortBatchKeys(TArray<FZLBatchKey>& Keys)
+	{
+		Keys.Sort([](const FZLBatchKey& A, const FZLBatchKey& B) { return A.Path.ToString() < B.Path.ToString(); });
+
+		int32 NumKept = 0;
+		for (int32 i = 0; i < Keys.Num(); ++i)
+		{
+			if (NumKept > 0)
+			{
+				const FString& Previous = Keys[NumKept - 1].Path.ToString();
+				const FString& Key = Keys[i].Path.ToString();
+				if (Key == Previous || (Key.StartsWith(Previous) && Key[Previous.Len()] == TCHAR('.')))
+				{
+					continue;
+				}
+			}
+			Keys[NumKept++] = Keys[i];
+		}
+		Keys.SetNum(NumKept);
+	}
+
+	// Objects already at the leaf take the new fields, the way ConfirmStateChange merges confirmed objects
+	void SetOrMergeField(FJsonObject& Parent, const FString& Name, const TSharedPtr<FJsonValue>& Value)
+	{
+		const TSharedPtr<FJsonValue>* Existing = Parent.Values.Find(Name);
+		if (Existing && Existing->IsValid() && (*Existing)->Type == EJson::Object && Value->Type == EJson::Object)
+		{
+			Parent.SetObjectField(Name, MergeJsonObjectsRecursive((*Existing)->AsObject(), Value->AsObject()));
+		}
+		else
+		{
+			Parent.SetField(Name, Value);
+		}
+	}
+}
+
+void UZLCloudPluginStateManager::GetRequestedStateValues(const TArray<FString>& FieldNames, bool instantConfirm, TMap<FString, TSharedPtr<FJsonValue>>& OutValues)
+{
+	if (!JsonObject_out_requestedState.IsValid() || FieldNames.Num() == 0)
+	{
+		return;
+	}
+
+	TArray<FZLBatchKey> keys;
+	keys.Reserve(FieldNames.Num());
+	for (const FString& fieldName : FieldNames)
+	{
+		const FZLStateKeyPath keyPath = FZLStateKeyPath::Intern(fieldName);
+		if (keyPath.IsValid())
+		{
+			keys.Add({ keyPath, &fieldName });
+		}
+	}
+	SortBatchKeys(keys);
+
+	//Find everything first, the requested state is only changed once all keys have been resolved
+	struct FPulledValue
+	{
+		const FZLBatchKey* Key;
+		TSharedPtr<FJsonObject> Parent;
+		TSharedPtr<FJsonValue> Value;
+	};
+	TArray<FPulledValue> pulled;
+	pulled.Reserve(keys.Num());
+
+	FZLSharedPrefixWalker requestedWalker(JsonObject_out_requestedState);
+	for (const FZLBatchKey& key : keys)
+	{
+		TSharedPtr<FJsonObject> parent = requestedWalker.ResolveParent(key.Path, false);
+		const TSharedPtr<FJsonValue>* value = parent ? FZLStateKeyPathCache::FindSegment(*parent, key.Path.GetLeaf()) : nullptr;
+		if (value && value->IsValid() && !(*value)->IsNull())
+		{
+			pulled.Add({ &key, parent, *value });
+		}
+	}
+
+	if (pulled.Num() == 0)
+	{
+		return;
+	}
+
+	const double now = GetStateTime();
+	TSharedPtr<FJsonObject>& destination = instantConfirm ? JsonObject_currentState : JsonObject_processingState;
+	FZLSharedPrefixWalker destinationWalker(destination);
+
+	for (const FPulledValue& entry : pulled)
+	{
+		const FZLStateKeyPath& keyPath = entry.Key->Path;
+		const int32 numLeaves = entry.Value->Type == EJson::Object ? CountLeavesInJsonObject(entry.Value->AsObject()) : 1;
+
+		//Counted against whichever in-flight request owns the top level key
+		FZLInFlightStateRequest* owningRequest = FindStateRequestForKey(keyPath.ToString());
+		if (owningRequest)
+		{
+			owningRequest->ProcessingLeafCount += numLeaves;
+			if (instantConfirm)
+			{
+				owningRequest->FinishedLeaves += numLeaves;
+				StateKeyMetrics.RecordConfirm(keyPath.ToString(), now - owningRequest->StartTime);
 			}
+		}
 
+		//remove from requested state
+		entry.Parent->RemoveField(keyPath.GetLeaf().Name);
+
+		//add to processing, or straight to current state
+		SetOrMergeField(*destinationWalker.ResolveParent(keyPath, true), keyPath.GetLeaf().Name, entry.Value);
+		if (instantConfirm)
+		{
+			MarkCurrentStateChanged(keyPath);
 		}
-		else
+
+		OutValues.Add(*entry.Key->FieldName, entry.Value);
+	}
+
+	//Remove the levels emptied above, deepest paths first so each parent is checked after everything below it has gone
+	for (int32 i = pulled.Num() - 1; i >= 0; --i)
+	{
+		requestedWalker.ResolveParent(pulled[i].Key->Path, false);
+		requestedWalker.RemoveEmptyLevels();
+	}
+
+	CopyRequestId();
+
+	//Objects have moved between trees
+	InvalidateKeyPathCaches();
+}
+
+int32 UZLCloudPluginStateManager::SetCurrentStateValues(const TMap<FString, TSharedPtr<FJsonValue>>& Values)
+{
+	TArray<FZLBatchKey> keys;
+	keys.Reserve(Values.Num());
+	for (const TPair<FString, TSharedPtr<FJsonValue>>& pair : Values)
+	{
+		const FZLStateKeyPath keyPath = FZLStateKeyPath::Intern(pair.Key);
+		if (keyPath.IsValid() && pair.Value.IsValid() && !pair.Value->IsNull())
 		{
-			if constexpr (isArray)
-			{
-				TArray<TSharedPtr<FJsonValue>> ArrayValues;
-				ArrayValues.Reserve(data.Num());
+			keys.Add({ keyPath, &pair.Key });
+		}
+	}
+	SortBatchKeys(keys);
 
-				for (const auto& Value : data)
-				{
-					if constexpr (isNumber)
-					{
-						ArrayValues.Add(MakeShared<FJsonValueNumber>(Value));
-					}
-					else if constexpr (isBool)
-					{
-						ArrayValues.Add(MakeShared<FJsonValueBoolean>(Value));
-					}
-					else if constexpr (isString)
-					{
-						ArrayValues.Add(MakeShared<FJsonValueString>(Value));
-					}
-				}
+	int32 numChanged = 0;
+	bool objectsReplaced = false;
+	FZLSharedPrefixWalker currentWalker(JsonObject_currentState);
+	for (const FZLBatchKey& key : keys)
+	{
+		const TSharedPtr<FJsonValue>& value = Values.FindChecked(*key.FieldName);
+		TSharedPtr<FJsonObject> parent = currentWalker.ResolveParent(key.Path, true, &objectsReplaced);
 
-				JsonObject_currentState->SetArrayField(FieldName, ArrayValues);
-			}
-			else
-			{
-				if constexpr (isNumber)
-				{
-					JsonObject_currentState->SetNumberField(FieldName, data);
-				}
-				else if constexpr (isBool)
-				{
-					JsonObject_currentState->SetBoolField(FieldName, data);
-				}
-				else if constexpr (isString)
-				{
-					JsonObject_currentState->SetStringField(FieldName, data);
-				}
-			}
+		//Unchanged values aren't written, so they don't show up as changes to the web, journal or observers
+		const TSharedPtr<FJsonValue>* existing = FZLStateKeyPathCache::FindSegment(*parent, key.Path.GetLeaf());
+		if (existing && existing->IsValid() && CompareJsonValuesCaseSensitive(*existing, value))
+		{
+			continue;
+		}
+
+		if (value->Type == EJson::Object || (existing && existing->IsValid() && (*existing)->Type == EJson::Object))
+		{
+			objectsReplaced = true;
 		}
+		parent->SetField(key.Path.GetLeaf().Name, value);
+		MarkCurrentStateChanged(key.Path);
+		++numChanged;
+	}
+
+	if (objectsReplaced)
+	{
+		CurrentStateKeyCache.Invalidate();
+	}
 
+	if (numChanged > 0)
+	{
+		//One push and refresh for the whole batch rather than one per value
 		SetStateDirty(EStateDirtyReason::state_notify_web);
 
 		RebuildDebugUI(ActiveSchema);
-		DebugUIWidget->TriggerRefreshUI();
+		if (DebugUIWidget)
+			DebugUIWidget->TriggerRefreshUI();
 	}
+
+	return numChanged;
 }
 
+void FZLStateValues::Add(const FString& Key, const TSharedPtr<FJsonValue>& Value)
+{
+	switch (Value.IsValid() ? Value->Type : EJson::None)
+	{
+	case EJson::String:
+		Strings.Add(Key, Value->AsString());
+		break;
+	case EJson::Number:
+		Numbers.Add(Key, Value->AsNumber());
+		break;
+	case EJson::Boolean:
+		Bools.Add(Key, Value->AsBool());
+		break;
+	case EJson::Array:
+	case EJson::Object:
+	{
+		FString jsonString;
+		TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> jsonWriter = TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&jsonString);
+		FJsonSerializer::Serialize(Value, FString(), jsonWriter);
+		jsonWriter->Close();
+		Json.Add(Key, jsonString);
+		break;
+	}
+	default:
+		break;
+	}
+}
 
+void FZLStateValues::ToJsonValues(TMap<FString, TSharedPtr<FJsonValue>>& OutValues) const
+{
+	OutValues.Reserve(OutValues.Num() + Strings.Num() + Numbers.Num() + Bools.Num() + Json.Num());
+	for (const TPair<FString, FString>& pair : Strings)
+	{
+		OutValues.Add(pair.Key, MakeShared<FJsonValueString>(pair.Value));
+	}
+	for (const TPair<FString, double>& pair : Numbers)
+	{
+		OutValues.Add(pair.Key, MakeShared<FJsonValueNumber>(pair.Value));
+	}
+	for (const TPair<FString, bool>& pair : Bools)
+	{
+		OutValues.Add(pair.Key, MakeShared<FJsonValueBoolean>(pair.Value));
+	}
+	for (const TPair<FString, FString>& pair : Json)
+	{
+		TSharedPtr<FJsonValue> value;
+		TSharedRef<TJsonReader<TCHAR>> jsonReader = TJsonReaderFactory<TCHAR>::Create(pair.Value);
+		if (FJsonSerializer::Deserialize(jsonReader, value) && value.IsValid())
+		{
+			OutValues.Add(pair.Key, value);
+		}
+		else
+		{
+			UE_LOG(LogZLCloudPlugin, Warning, TEXT("Skipped state value %s, it isn't valid JSON"), *pair.Key);
+		}
+	}
+}
 
 void UZLCloudPluginStateManager::SetCurrentSchema(UStateKeyInfoAsset* Asset)
 {
 	if (Asset)
 	{
 		ActiveSchema->KeyInfos = Asset->KeyInfos;
+		ActiveSchema->InvalidateKeyCaches();
 
+		//Schema keys are the literals blueprints poll with, intern them up front rather than on the first lookup
+		for (const TPair<FString, FStateKeyInfo>& Entry : Asset->KeyInfos)
+		{
+			FZLStateKeyPath::Intern(Entry.Key);
+		}
+
+		OnActiveSchemaKeysChanged();
 		RebuildDebugUI(Asset);
 	}
 }
@@ -2045,13 +3444,18 @@ void UZLCloudPluginStateManager::AppendCurrentSchema(UStateKeyInfoAsset* Asset)
 				{
 					ExistingInfo->AcceptedNumberValues.AddUnique(Val);
 				}
+				ActiveSchema->OnKeyChanged(Key);
 			}
 			else
 			{
 				ActiveSchema->KeyInfos.Add(Key, IncomingInfo);
+				ActiveSchema->OnKeyAdded(Key);
+				FZLStateKeyPath::Intern(Key);
 			}
 		}
 
+		OnActiveSchemaKeysChanged();
+
 		RebuildDebugUI(ActiveSchema);
 		DebugUIWidget->TriggerRefreshUI();
 	}
@@ -2083,9 +3487,17 @@ void UZLCloudPluginStateManager::RemoveFromCurrentSchema(UStateKeyInfoAsset* Ass
 				bool bHasRemainingArrayValues = ActiveInfo->AcceptedStringValues.Num() > 0 || ActiveInfo->AcceptedNumberValues.Num() > 0;
 
 				if (!bHasRemainingArrayValues)
+				{
 					ActiveSchema->KeyInfos.Remove(Key);
+					ActiveSchema->OnKeyRemoved(Key);
+				}
+				else
+				{
+					ActiveSchema->OnKeyChanged(Key);
+				}
 			}
 		}
+		OnActiveSchemaKeysChanged();
 		RebuildDebugUI(ActiveSchema);
 		DebugUIWidget->TriggerRefreshUI();
 	}
@@ -2102,7 +3514,164 @@ void UZLCloudPluginStateManager::ClearCurrentSchema()
 	if (ActiveSchema != nullptr)
 	{
 		ActiveSchema->KeyInfos.Empty();
+		ActiveSchema->InvalidateKeyCaches();
+	}
+	OnActiveSchemaKeysChanged();
+}
+
+void UZLCloudPluginStateManager::OnActiveSchemaKeysChanged()
+{
+	TArray<FZLStateKeyPath> ignoredKeys;
+	if (ActiveSchema != nullptr)
+	{
+		for (const TPair<FString, FStateKeyInfo>& Entry : ActiveSchema->KeyInfos)
+		{
+			if (Entry.Value.bIgnoredInDataHashes)
+			{
+				ignoredKeys.Add(FZLStateKeyPath::Intern(Entry.Key));
+			}
+		}
+	}
+	CurrentStateTree.SetFingerprintExclusions(ignoredKeys);
+
+	TypedCurrentState.Build(ActiveSchema);
+	SchemaValidator.Compile(ActiveSchema);
+
+	if (StateJournal)
+		StateJournal->SetSchemaHash(FZLStateSnapshot::HashSchema(ActiveSchema));
+}
+
+bool UZLCloudPluginStateManager::StartStateJournal(const FString& directory, bool restorePreviousSession)
+{
+	StopStateJournal();
+
+	const FString journalDirectory = directory.IsEmpty() ? FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("ZLStateJournal")) : directory;
+	const uint64 schemaHash = FZLStateSnapshot::HashSchema(ActiveSchema);
+
+	bool restored = false;
+	if (restorePreviousSession)
+	{
+		const double startTime = FPlatformTime::Seconds();
+		FZLStateSnapshot snapshot;
+		FString error;
+		int32 numRecords = 0;
+		if (FZLStateJournal::Restore(journalDirectory, schemaHash, snapshot, &error, &numRecords))
+		{
+			//Anything that was still requested goes over the state it was requested against
+			TSharedPtr<FJsonObject> restoredState = snapshot.CurrentState;
+			OverlayStateRequest(*restoredState, *snapshot.RequestedState);
+			restored = true;
+
+			UE_LOG(LogZLCloudPlugin, Display, TEXT("Restored state session from %s with %d journal records in %.2fms"), *journalDirectory, numRecords, (FPlatformTime::Seconds() - startTime) * 1000.0);
+
+			if (restoredState->Values.Num() > 0)
+			{
+				if (UZLCloudPluginDelegates* Delegates = UZLCloudPluginDelegates::GetZLCloudPluginDelegates())
+				{
+					FString stateDataStr;
+					TSharedRef<TJsonWriter<TCHAR>> JsonWriter = TJsonWriterFactory<TCHAR>::Create(&stateDataStr);
+					FJsonSerializer::Serialize(restoredState.ToSharedRef(), JsonWriter);
+					JsonWriter->Close();
+
+					Delegates->OnRecieveData.Broadcast(stateDataStr);
+				}
+			}
+		}
+		else
+		{
+			UE_LOG(LogZLCloudPlugin, Display, TEXT("No state session restored from %s: %s"), *journalDirectory, *error);
+		}
+	}
+
+	StateJournal = MakeUnique<FZLStateJournal>();
+	if (!StateJournal->Open(journalDirectory, schemaHash))
+	{
+		UE_LOG(LogZLCloudPlugin, Error, TEXT("Failed to start the state journal in %s"), *journalDirectory);
+		StateJournal.Reset();
+	}
+	return restored;
+}
+
+void UZLCloudPluginStateManager::StopStateJournal()
+{
+	if (StateJournal)
+	{
+		StateJournal->Flush(JsonObject_currentState, GetUnconfirmedState());
+		StateJournal->Close();
+		StateJournal.Reset();
+	}
+}
+
+void UZLCloudPluginStateManager::GetStateSubKeys(const FString& parentKey, bool includeParents, TArray<FString>& outKeys) const
+{
+	FZLStateKeyQuery::GetChildren(CurrentStateTree.GetRootNode(), parentKey, includeParents, outKeys);
+}
+
+void UZLCloudPluginStateManager::FindStateKeysByPrefix(const FString& prefix, TArray<FString>& outKeys, int32 maxResults) const
+{
+	FZLStateKeyQuery::FindByPrefix(CurrentStateTree.GetRootNode(), prefix, outKeys, maxResults);
+}
+
+void UZLCloudPluginStateManager::FindStateKeys(const FString& pattern, TArray<FString>& outKeys, int32 maxResults) const
+{
+	FZLStateKeyQuery::FindMatching(CurrentStateTree.GetRootNode(), pattern, outKeys, maxResults);
+}
+
+FZLStateObservers::FObserverId UZLCloudPluginStateManager::ObserveState(const FString& path, EZLStateObserverSource source, FZLOnStatePathsChanged callback)
+{
+	return StateObservers.Subscribe(source, FZLStateKeyPath::Intern(path), MoveTemp(callback));
+}
+
+FString UZLCloudPluginStateManager::GetStateKeyMetricsString(int32 maxKeys) const
+{
+	TSharedRef<FJsonObject> metricsJson = StateKeyMetrics.ToJson(maxKeys);
+	metricsJson->SetNumberField("warning_time", m_stateRequestWarningTime);
+	metricsJson->SetNumberField("timeout", m_stateRequestTimeout);
+
+	FString metricsString;
+	TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> jsonWriter = TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&metricsString);
+	FJsonSerializer::Serialize(metricsJson, jsonWriter);
+	jsonWriter->Close();
+	return metricsString;
+}
+
+bool UZLCloudPluginStateManager::StartStateRecording(const FString& fileName)
+{
+	StopStateRecording();
+
+	StateRecorder = MakeUnique<FZLStateRecorder>();
+	if (!StateRecorder->Open(fileName, JsonObject_currentState, FZLStateSnapshot::HashSchema(ActiveSchema), GetStateTime()))
+	{
+		UE_LOG(LogZLCloudPlugin, Error, TEXT("Failed to start the state recording %s"), *StateRecorder->GetFileName());
+		StateRecorder.Reset();
+		return false;
+	}
+
+	UE_LOG(LogZLCloudPlugin, Display, TEXT("Recording state requests to %s"), *StateRecorder->GetFileName());
+	return true;
+}
+
+void UZLCloudPluginStateManager::StopStateRecording()
+{
+	if (StateRecorder)
+	{
+		StateRecorder->Close(JsonObject_currentState, GetStateTime());
+		UE_LOG(LogZLCloudPlugin, Display, TEXT("Recorded %d state requests to %s"), StateRecorder->GetNumRequests(), *StateRecorder->GetFileName());
+		StateRecorder.Reset();
+	}
+}
+
+TSharedPtr<FJsonObject> UZLCloudPluginStateManager::GetUnconfirmedState() const
+{
+	const int32 numRequested = JsonObject_out_requestedState->Values.Num() - (JsonObject_out_requestedState->HasField(s_requestIdStr) ? 1 : 0);
+	if (numRequested == 0 && JsonObject_processingState->Values.Num() == 0)
+	{
+		return nullptr;
 	}
+
+	TSharedPtr<FJsonObject> unconfirmed = MergeJsonObjectsRecursive(JsonObject_processingState, JsonObject_out_requestedState);
+	unconfirmed->RemoveField(s_requestIdStr);
+	return unconfirmed;
 }
 
 void UZLCloudPluginStateManager::SetDebugUIVisibility(bool visible)
@@ -2280,6 +3849,9 @@ TSharedRef<SDockTab> UZLCloudPluginStateManager::CreateDebugUITabContent(TShared
 
 UZLCloudPluginStateManager::~UZLCloudPluginStateManager()
 {
+	StopStateJournal();
+	StopStateRecording();
+
 	// Ensure proper cleanup of asset references
 	ClearCurrentSchema();
 }
@@ -2326,16 +3898,25 @@ void UZLCloudPluginStateManager::SaveCurrentStateToFile(FString fileName)
 
 void UZLCloudPluginStateManager::MergeTrackedStateIntoCurrentState(const FString& FieldName, TSharedPtr<FJsonObject> JsonObject)
 {
+	TrackStateBlueprint(FieldName);
+
 	JsonObject_currentState->SetObjectField(FieldName, JsonObject);
+	CurrentStateKeyCache.Invalidate();
+	MarkCurrentStateChanged(FZLStateKeyPath::Intern(FieldName));
 }
 
 
 void UZLCloudPluginStateManager::SendCurrentStateToWeb(bool completeState, TSharedPtr<FJsonObject> unmatchedRequestState)
 {
+	//Nothing can differ from the last push if the state hash hasn't changed
+	const uint64 currentStateHash = CurrentStateTree.GetHash();
+	const bool unchangedSinceLastPush = m_webStateHashValid && m_webStateHash == currentStateHash;
+
+	TSharedPtr<FJsonObject> webStateChanges = JsonObject_web_currentState;
 	if (!completeState)
 	{
 		//Calculate changes since last update
-		JsonObject_web_currentState = CreateDiffJsonObject(JsonObject_web_currentState, JsonObject_currentState);
+		webStateChanges = unchangedSinceLastPush ? MakeShareable(new FJsonObject) : CreateDiffJsonObject(JsonObject_web_currentState, JsonObject_currentState);
 	}
 
 	//Send to Web
@@ -2345,7 +3926,7 @@ void UZLCloudPluginStateManager::SendCurrentStateToWeb(bool completeState, TShar
 		//Return current state to the web
 		TSharedPtr<FJsonObject> currentStateJson = MakeShareable(new FJsonObject);
 		currentStateJson->SetStringField("status", "complete");
-		currentStateJson->SetObjectField("current_state", (completeState) ? JsonObject_currentState : JsonObject_web_currentState);
+		currentStateJson->SetObjectField("current_state", (completeState) ? JsonObject_currentState : webStateChanges);
 		
 		if (unmatchedRequestState != nullptr)
 		{
@@ -2363,8 +3944,13 @@ void UZLCloudPluginStateManager::SendCurrentStateToWeb(bool completeState, TShar
 		Module->SendData(JsonString_forWeb);
 	}
 
-	//Copy all data in
-	FJsonObject::Duplicate(JsonObject_currentState, JsonObject_web_currentState);
+	//Keep what was sent, shares everything unchanged since the last push with the previous copy and the leaf values with the current state
+	if (!unchangedSinceLastPush)
+	{
+		JsonObject_web_currentState = CurrentStateTree.GetSnapshot();
+	}
+	m_webStateHash = currentStateHash;
+	m_webStateHashValid = true;
 }
 
 /// <summary>
@@ -2378,127 +3964,28 @@ void UZLCloudPluginStateManager::SetStateDirty(EStateDirtyReason reason)
 
 void UZLCloudPluginStateManager::PushStateEventsToWeb()
 {
-	FString requestId = "";
-	m_stateDirty = false;
-
-	TSharedPtr<FJsonObject> currentJson = MakeShareable(new FJsonObject);
-	TSharedPtr<FJsonObject> jsonForWebObject = MakeShareable(new FJsonObject);
-
-	if (IsProcessingStateRequest())
-	{
-		requestId = JsonObject_processingState->GetStringField(s_requestIdStr);
-
-		//All requested states processed, send completion message
-		if (JsonObject_requestedStateLeafCount == JsonObject_processingStateFinishedLeaves)
-		{
-			//Return current state to the web
-			currentJson->SetStringField("status", "complete");
-			currentJson->SetObjectField("current_state", JsonObject_currentState);
-		}
-		else
-		{
-			if (JsonObject_processingState->Values.Num() > 1) //Still waiting on something in-processing
-			{
-				double currTime = FApp::GetCurrentTime();
-				double elapsedTime = currTime - JsonObject_processingStateStartTime;
-
-				if (elapsedTime > m_stateRequestTimeout)
-				{
-					JsonObject_processingState->RemoveField(s_requestIdStr); //Remove this request
-
-					//Return current state + unprocessed to the web
-					TSharedPtr<FJsonObject> timeoutState = CurrentStateCompareDiffs(JsonObject_processingState);
-
-					currentJson->SetStringField("status", "timeout");
-					currentJson->SetObjectField("current_state", JsonObject_currentState);
-					currentJson->SetObjectField("timeout_state", timeoutState);
-
-					TSharedPtr<FJsonObject> unprocessed = nullptr;
-					if (JsonObject_processingStateLeafCount < JsonObject_requestedStateLeafCount) //Some requested states were ignored
-					{
-						unprocessed = CurrentStateCompareDiffs(JsonObject_out_requestedState);
-						TArray<FString> diffKeys = CurrentStateCompareDiffs_Keys(JsonObject_processingState);
-						for (FString key : diffKeys) //Strip timed out values to report any unprocessed
-						{
-							if (unprocessed->TryGetField(key))
-							{
-								unprocessed->RemoveField(key);
-							}
-						}
-						if (unprocessed->HasField(s_requestIdStr))
-							unprocessed->RemoveField(s_requestIdStr);
-
-						currentJson->SetObjectField("unprocessed_state", unprocessed);
-					}
-				}
-			}
-			else if (JsonObject_processingStateLeafCount < JsonObject_requestedStateLeafCount) //Some requested states were ignored
-			{
-				JsonObject_processingState->RemoveField(s_requestIdStr); //Remove this request
-
-				//Return current state + unprocessed to the web
-				TSharedPtr<FJsonObject> unprocessedJson = CurrentStateCompareDiffs(JsonObject_out_requestedState);
-				if (unprocessedJson->HasField(s_requestIdStr))
-					unprocessedJson->RemoveField(s_requestIdStr);
-
-				currentJson->SetStringField("status", "unmatched");
-				currentJson->SetObjectField("current_state", JsonObject_currentState);
-				currentJson->SetObjectField("unprocessed_state", unprocessedJson);
-
-				FString JsonString_Unprocessed;
-				TSharedRef<TJsonWriter<TCHAR>> JsonWriterUnprocessed = TJsonWriterFactory<TCHAR>::Create(&JsonString_Unprocessed, 1);
-				FJsonSerializer::Serialize(unprocessedJson.ToSharedRef(), JsonWriterUnprocessed);
-				JsonWriterUnprocessed->Close();
-
-				UE_LOG(LogZLCloudPlugin, Display, TEXT("Unprocessed State in previous request: %s"), *JsonString_Unprocessed);
-			}
-		}
-	}
-	else if (JsonObject_requestedStateLeafCount != JsonObject_processingStateFinishedLeaves) //Also need to account for any requests that never entered processing due to invalid fields or instant confirms but were incomplete
-	{
-		requestId = JsonObject_out_requestedState->GetStringField(s_requestIdStr);
-
-		//Return current state + unprocessed to the web
-		TSharedPtr<FJsonObject> unprocessedJson = CurrentStateCompareDiffs(JsonObject_out_requestedState);
-		if (unprocessedJson->HasField(s_requestIdStr))
-			unprocessedJson->RemoveField(s_requestIdStr);
-
-		currentJson->SetStringField("status", "unmatched");
-		currentJson->SetObjectField("current_state", JsonObject_currentState);
-		currentJson->SetObjectField("unprocessed_state", unprocessedJson);
-
-		FString JsonString_Unprocessed;
-		TSharedRef<TJsonWriter<TCHAR>> JsonWriterUnprocessed = TJsonWriterFactory<TCHAR>::Create(&JsonString_Unprocessed, 1);
-		FJsonSerializer::Serialize(unprocessedJson.ToSharedRef(), JsonWriterUnprocessed);
-		JsonWriterUnprocessed->Close();
-
-		UE_LOG(LogZLCloudPlugin, Display, TEXT("Unprocessed State in previous request: %s"), *JsonString_Unprocessed);
-	}
-	else //internal state update, just needs to send complete current state
-	{
-		currentJson->SetStringField("status", "complete");
-		currentJson->SetObjectField("current_state", JsonObject_currentState);
-	}
-
-	jsonForWebObject->SetObjectField("state_processing_ended", currentJson);
-	if(!requestId.IsEmpty())
-		jsonForWebObject->SetStringField(s_requestIdStr, requestId); //add in request Id	
-
-	SendFJsonObjectToWeb(jsonForWebObject);
+	//Internal state update, just needs to send complete current state. Requests report their own results when they finish
+	SendStateRequestEndedToWeb(nullptr, "complete");
 }
 
-void UZLCloudPluginStateManager::SendFJsonObjectToWeb(TSharedPtr<FJsonObject> JsonObject)
+int32 UZLCloudPluginStateManager::SendFJsonObjectToWeb(TSharedPtr<FJsonObject> JsonObject)
 {
 	IZLCloudPluginModule* Module = ZLCloudPlugin::FZLCloudPluginModule::GetModule();
-	if (Module)
+	if (Module || m_webMessageHandler)
 	{
 		FString JsonString_forWeb;
 		TSharedRef<TJsonWriter<TCHAR>> JsonWriter = TJsonWriterFactory<TCHAR>::Create(&JsonString_forWeb, 1);
 		FJsonSerializer::Serialize(JsonObject.ToSharedRef(), JsonWriter);
 		JsonWriter->Close();
 
-		Module->SendData(JsonString_forWeb);
+		if (m_webMessageHandler)
+			m_webMessageHandler(JsonString_forWeb);
+		else
+			Module->SendData(JsonString_forWeb);
+		return JsonString_forWeb.Len();
 	}
+
+	return 0;
 }
 
 
@@ -4,10 +4,39 @@
 
 #if UNREAL_5_1_OR_NEWER
 
+#include "ZLCloudPluginPrivate.h"
+#include "EditorZLCloudPluginSettings.h"
+#include "Utils.h"
+#include "PixelCaptureBufferFormat.h"
+#include "PixelCaptureInputFrameRHI.h"
+
+DECLARE_CYCLE_STAT(TEXT("Simulcast Layer Capture"), STAT_ZLSimulcastLayerCapture, STATGROUP_ZLCloudPlugin);
+
+namespace
+{
+	// A simulcast layer that hasn't been requested for this long stops being produced
+	const double SimulcastLayerIdleSeconds = 1.0;
+
+	const int32 SimulcastTexturePoolSize = 3;
+}
 
 FZLCloudPluginVideoInput::FZLCloudPluginVideoInput()
 {
 	CreateFrameCapturer();
+
+	const UZLCloudPluginSettings* Settings = GetDefault<UZLCloudPluginSettings>();
+	if (Settings && !Settings->SimulcastLayerScales.IsEmpty())
+	{
+		TArray<FString> ScaleStrings;
+		Settings->SimulcastLayerScales.ParseIntoArray(ScaleStrings, TEXT(","), true);
+
+		TArray<float> LayerScaleDowns;
+		for (const FString& ScaleString : ScaleStrings)
+		{
+			LayerScaleDowns.Add(FCString::Atof(*ScaleString));
+		}
+		SetSimulcastLayers(LayerScaleDowns);
+	}
 }
 
 void FZLCloudPluginVideoInput::AddOutputFormat(int32 Format)
@@ -32,11 +61,34 @@ void FZLCloudPluginVideoInput::OnFrame(const IPixelCaptureInputFrame& InputFrame
 	LastFrameHeight = InputFrame.GetHeight();
 
 	FrameCapturer->Capture(InputFrame);
+
+	CaptureSimulcastLayers(InputFrame);
 }
 
 #if UNREAL_5_7_OR_NEWER
 TSharedPtr<IPixelCaptureOutputFrame> FZLCloudPluginVideoInput::RequestFormat(int32 Format, TOptional<FIntPoint> Resolution)
 {
+	if (Resolution.IsSet() && *Resolution != FIntPoint(LastFrameWidth, LastFrameHeight))
+	{
+		// A simulcast layer's resolution is served by that layer
+		int32 LayerIndex = 0;
+		{
+			FScopeLock Lock(&SimulcastCriticalSection);
+			for (int32 Index = 0; Index < SimulcastLayers.Num() && LayerIndex == 0; ++Index)
+			{
+				if (GetLayerResolution({ LastFrameWidth, LastFrameHeight }, SimulcastLayers[Index]->ScaleDown) == *Resolution)
+				{
+					LayerIndex = Index + 1;
+				}
+			}
+		}
+
+		if (LayerIndex > 0)
+		{
+			return RequestLayerFormat(Format, LayerIndex);
+		}
+	}
+
 	if (FrameCapturer != nullptr)
 	{
 		if (!Resolution.IsSet())
@@ -50,6 +102,11 @@ TSharedPtr<IPixelCaptureOutputFrame> FZLCloudPluginVideoInput::RequestFormat(int
 #else
 TSharedPtr<IPixelCaptureOutputFrame> FZLCloudPluginVideoInput::RequestFormat(int32 Format, int32 LayerIndex)
 {
+	if (LayerIndex > 0)
+	{
+		return RequestLayerFormat(Format, LayerIndex);
+	}
+
 	if (FrameCapturer != nullptr)
 	{
 		return FrameCapturer->RequestFormat(Format, LayerIndex);
@@ -94,5 +151,231 @@ void FZLCloudPluginVideoInput::OnCaptureComplete()
 	OnFrameCaptured.Broadcast();
 }
 
+void FZLCloudPluginVideoInput::SetSimulcastLayers(const TArray<float>& InLayerScaleDowns)
+{
+	TArray<float> LayerScaleDowns = InLayerScaleDowns.FilterByPredicate([](float ScaleDown) { return ScaleDown > 1.0f; });
+	LayerScaleDowns.Sort();
+
+	FScopeLock Lock(&SimulcastCriticalSection);
+
+	for (const TSharedPtr<FSimulcastLayer>& Layer : SimulcastLayers)
+	{
+		if (Layer->Capturer)
+		{
+			Layer->Capturer->OnDisconnected();
+		}
+	}
+	SimulcastLayers.Empty();
+
+	for (float ScaleDown : LayerScaleDowns)
+	{
+		TSharedPtr<FSimulcastLayer> Layer = MakeShared<FSimulcastLayer>();
+		Layer->ScaleDown = ScaleDown;
+		SimulcastLayers.Add(Layer);
+	}
+}
+
+int32 FZLCloudPluginVideoInput::GetNumLayers() const
+{
+	FScopeLock Lock(&SimulcastCriticalSection);
+	return 1 + SimulcastLayers.Num();
+}
+
+TSharedPtr<IPixelCaptureOutputFrame> FZLCloudPluginVideoInput::RequestLayerFormat(int32 Format, int32 LayerIndex)
+{
+	if (LayerIndex <= 0)
+	{
+#if UNREAL_5_7_OR_NEWER
+		return RequestFormat(Format);
+#else
+		return RequestFormat(Format, -1);
+#endif
+	}
+
+	FScopeLock Lock(&SimulcastCriticalSection);
+
+	if (!SimulcastLayers.IsValidIndex(LayerIndex - 1))
+	{
+		return nullptr;
+	}
+
+	FSimulcastLayer& Layer = *SimulcastLayers[LayerIndex - 1];
+	Layer.LastRequestCycles.Set(static_cast<int64>(FPlatformTime::Cycles64()));
+
+	if (!Layer.Capturer)
+	{
+		return nullptr;
+	}
+
+#if UNREAL_5_7_OR_NEWER
+	return Layer.Capturer->RequestFormat(Format, Layer.Resolution);
+#else
+	return Layer.Capturer->RequestFormat(Format, -1);
+#endif
+}
+
+int32 FZLCloudPluginVideoInput::FindLayerForResolution(FIntPoint TargetResolution) const
+{
+	FScopeLock Lock(&SimulcastCriticalSection);
+
+	TArray<float> LayerScaleDowns;
+	for (const TSharedPtr<FSimulcastLayer>& Layer : SimulcastLayers)
+	{
+		LayerScaleDowns.Add(Layer->ScaleDown);
+	}
+	return SelectLayerForResolution({ LastFrameWidth, LastFrameHeight }, LayerScaleDowns, TargetResolution);
+}
+
+FIntPoint FZLCloudPluginVideoInput::GetLayerResolution(FIntPoint CaptureResolution, float ScaleDown)
+{
+	return FIntPoint(
+		FMath::Max(1, FMath::RoundToInt(CaptureResolution.X / ScaleDown)),
+		FMath::Max(1, FMath::RoundToInt(CaptureResolution.Y / ScaleDown)));
+}
+
+int32 FZLCloudPluginVideoInput::SelectLayerForResolution(FIntPoint CaptureResolution, const TArray<float>& LayerScaleDowns, FIntPoint TargetResolution)
+{
+	if (CaptureResolution.X <= 0 || CaptureResolution.Y <= 0 || TargetResolution.X <= 0 || TargetResolution.Y <= 0)
+	{
+		return 0;
+	}
+
+	// Layers get smaller with each index, so the last one that covers the target is the smallest
+	for (int32 Index = LayerScaleDowns.Num() - 1; Index >= 0; --Index)
+	{
+		const FIntPoint LayerResolution = GetLayerResolution(CaptureResolution, LayerScaleDowns[Index]);
+		if (LayerResolution.X >= TargetResolution.X && LayerResolution.Y >= TargetResolution.Y)
+		{
+			return Index + 1;
+		}
+	}
+	return 0;
+}
+
+bool FZLCloudPluginVideoInput::GetSimulcastLayerStats(int32 LayerIndex, FSimulcastLayerStats& OutStats) const
+{
+	FScopeLock Lock(&SimulcastCriticalSection);
+
+	if (!SimulcastLayers.IsValidIndex(LayerIndex - 1))
+	{
+		return false;
+	}
+
+	const FSimulcastLayer& Layer = *SimulcastLayers[LayerIndex - 1];
+	OutStats.Resolution = Layer.Resolution;
+	OutStats.NumProduced = Layer.NumProduced;
+	OutStats.NumSkipped = Layer.NumSkipped;
+	return true;
+}
+
+int32 FZLCloudPluginVideoInput::GetDeepestConsumedLayer() const
+{
+	const uint64 NowCycles = FPlatformTime::Cycles64();
+	for (int32 Index = SimulcastLayers.Num() - 1; Index >= 0; --Index)
+	{
+		const uint64 LastRequestCycles = static_cast<uint64>(SimulcastLayers[Index]->LastRequestCycles.GetValue());
+		if (LastRequestCycles != 0 && FPlatformTime::ToSeconds64(NowCycles - LastRequestCycles) < SimulcastLayerIdleSeconds)
+		{
+			return Index + 1;
+		}
+	}
+	return 0;
+}
+
+void FZLCloudPluginVideoInput::CaptureSimulcastLayers(const IPixelCaptureInputFrame& InputFrame)
+{
+	FScopeLock Lock(&SimulcastCriticalSection);
+
+	if (SimulcastLayers.Num() == 0)
+	{
+		return;
+	}
+
+	if (InputFrame.GetType() != PixelCaptureBufferFormat::FORMAT_RHI || !IsInRenderingThread())
+	{
+		if (!bLoggedUnsupportedSimulcastInput)
+		{
+			UE_LOG(LogZLCloudPlugin, Warning, TEXT("Simulcast layers require RHI frames captured on the render thread, only the full resolution layer will be produced."));
+			bLoggedUnsupportedSimulcastInput = true;
+		}
+		return;
+	}
+
+	// Layers above the deepest consumed one are still produced because they are the source for the layers below them
+	const int32 DeepestConsumedLayer = GetDeepestConsumedLayer();
+
+	FRHICommandListImmediate& RHICmdList = FRHICommandListExecutor::GetImmediateCommandList();
+	FTextureRHIRef SourceTexture = static_cast<const FPixelCaptureInputFrameRHI&>(InputFrame).FrameTexture;
+
+	for (int32 Index = 0; Index < SimulcastLayers.Num(); ++Index)
+	{
+		FSimulcastLayer& Layer = *SimulcastLayers[Index];
+
+		if (Index + 1 > DeepestConsumedLayer)
+		{
+			++Layer.NumSkipped;
+			continue;
+		}
+
+		SCOPE_CYCLE_COUNTER(STAT_ZLSimulcastLayerCapture);
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+
+		const FIntPoint Resolution = GetLayerResolution({ InputFrame.GetWidth(), InputFrame.GetHeight() }, Layer.ScaleDown);
+
+		if (!Layer.Capturer || Resolution != Layer.Resolution)
+		{
+			Layer.Resolution = Resolution;
+			Layer.NextTexture = 0;
+			Layer.TexturePool.Reset();
+			for (int32 TextureIndex = 0; TextureIndex < SimulcastTexturePoolSize; ++TextureIndex)
+			{
+				Layer.TexturePool.Add(ZLCloudPluginUtils::CreateTexture(Resolution.X, Resolution.Y));
+			}
+
+			if (Layer.Capturer)
+			{
+				Layer.Capturer->OnDisconnected();
+			}
+
+			// The texture is already at the layer resolution, the layer capturer only handles format conversion and buffering
+			TArray<float> LayerScaling;
+			LayerScaling.Add(1.0f);
+			Layer.Capturer = FPixelCaptureCapturerMultiFormat::Create(this, LayerScaling);
+
+			for (auto& Format : PreInitFormats)
+			{
+				Layer.Capturer->AddOutputFormat(Format);
+			}
+		}
+
+		FTextureRHIRef LayerTexture = Layer.TexturePool[Layer.NextTexture];
+		Layer.NextTexture = (Layer.NextTexture + 1) % Layer.TexturePool.Num();
+
+		// Bilinear passes of at most half each, so no source texel is skipped
+		ZLCloudPluginUtils::DownscaleTexture(RHICmdList, SourceTexture, LayerTexture, Layer.ScratchTextures);
+		Layer.Capturer->Capture(FPixelCaptureInputFrameRHI(LayerTexture));
+
+		// Chain the next layer off this one rather than the full resolution capture
+		SourceTexture = LayerTexture;
+
+		++Layer.NumProduced;
+		Layer.TotalCaptureCycles += FPlatformTime::Cycles64() - StartCycles;
+	}
+}
+
+void FZLCloudPluginVideoInput::DumpSimulcastStats(FOutputDevice& Ar) const
+{
+	FScopeLock Lock(&SimulcastCriticalSection);
+
+	Ar.Logf(TEXT("  Layer 0: %dx%d (full capture)"), LastFrameWidth, LastFrameHeight);
+	for (int32 Index = 0; Index < SimulcastLayers.Num(); ++Index)
+	{
+		const FSimulcastLayer& Layer = *SimulcastLayers[Index];
+		const double AverageCostMs = Layer.NumProduced > 0 ? FPlatformTime::ToMilliseconds64(Layer.TotalCaptureCycles) / Layer.NumProduced : 0.0;
+		Ar.Logf(TEXT("  Layer %d: 1/%.2f %dx%d produced=%llu skipped=%llu avg cpu cost=%.3fms"),
+			Index + 1, Layer.ScaleDown, Layer.Resolution.X, Layer.Resolution.Y, Layer.NumProduced, Layer.NumSkipped, AverageCostMs);
+	}
+}
+
 #endif
 
@@ -8,8 +8,19 @@
 #include "PixelCaptureBufferFormat.h"
 #include "PixelCaptureCapturerRHI.h"
 #include "PixelCaptureCapturerRHIRDG.h"
-#include "PixelCaptureCapturerRHIToI420CPU.h"
 #include "PixelCaptureCapturerRHIToI420Compute.h"
+#include "ZLPixelCaptureCapturerRHIToI420CPU.h"
+#include "EditorZLCloudPluginSettings.h"
+
+namespace
+{
+	// Compute shader conversion unless the platform can't run it or CPU conversion was asked for
+	bool UseComputeYUVConversion()
+	{
+		const UZLCloudPluginSettings* Settings = GetDefault<UZLCloudPluginSettings>();
+		return RHISupportsComputeShaders(GMaxRHIShaderPlatform) && !(Settings && Settings->bCPUYUVConversion);
+	}
+}
 
 #if UNREAL_5_7_OR_NEWER
 TSharedPtr<FPixelCaptureCapturer> FZLCloudPluginVideoInputRHI::CreateCapturer(int32 FinalFormat, FIntPoint Resolution)
@@ -32,13 +43,13 @@ TSharedPtr<FPixelCaptureCapturer> FZLCloudPluginVideoInputRHI::CreateCapturer(in
 	}
 	case PixelCaptureBufferFormat::FORMAT_I420:
 	{
-		if (true)//UE::PixelStreaming::Settings::CVarPixelStreamingVPXUseCompute.GetValueOnAnyThread()) //ZL
+		if (UseComputeYUVConversion())
 		{
 			return FPixelCaptureCapturerRHIToI420Compute::Create({ .OutputResolution = Resolution });
 		}
 		else
 		{
-			return FPixelCaptureCapturerRHIToI420CPU::Create({ .OutputResolution = Resolution });
+			return FZLPixelCaptureCapturerRHIToI420CPU::Create(Resolution);
 		}
 	}
 	default:
@@ -68,13 +79,13 @@ TSharedPtr<FPixelCaptureCapturer> FZLCloudPluginVideoInputRHI::CreateCapturer(in
 		}
 		case PixelCaptureBufferFormat::FORMAT_I420:
 		{
-			if (true)//UE::ZLCloudPlugin::Settings::CVarZLCloudPluginVPXUseCompute.GetValueOnAnyThread()) //ZL
+			if (UseComputeYUVConversion())
 			{
 				return FPixelCaptureCapturerRHIToI420Compute::Create(FinalScale);
 			}
 			else
 			{
-				return FPixelCaptureCapturerRHIToI420CPU::Create(FinalScale);
+				return FZLPixelCaptureCapturerRHIToI420CPU::Create(FinalScale);
 			}
 		}
 		default:
@@ -0,0 +1,1088 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#include "ZLAudioFormatConverter.h"
+#include "ZLYUVConverter.h"
+#include "CloudStream2dll.h"
+#include "ZLCloudPluginVersion.h"
+#include "FramePacer.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Math/RandomStream.h"
+
+#if UNREAL_5_1_OR_NEWER
+#include "ZLCloudPluginVideoInputRHI.h"
+#include "Utils.h"
+#include "PixelCaptureBufferFormat.h"
+#include "PixelCaptureInputFrameRHI.h"
+#include "PixelCaptureOutputFrameRHI.h"
+#include "RenderingThread.h"
+#include "FrameBudgetQueue.h"
+#endif
+
+namespace
+{
+#if !UE_BUILD_SHIPPING
+	using namespace ZLCloudPlugin;
+
+	// Sine of Amplitude at Frequency, quantised to int16 the way WebRTC delivers it, repeated on every channel
+	void MakeSineInt16(double Frequency, double Amplitude, int32 SampleRate, int32 NumChannels, int32 NumFrames, TArray<int16_t>& OutAudio)
+	{
+		OutAudio.SetNumUninitialized(NumFrames * NumChannels);
+		for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+		{
+			const int16_t Sample = static_cast<int16_t>(FMath::RoundToInt(Amplitude * 32767.0 * FMath::Sin(2.0 * PI * Frequency * Frame / SampleRate)));
+			for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+			{
+				OutAudio[Frame * NumChannels + Channel] = Sample;
+			}
+		}
+	}
+
+	// Least squares fit of A sin + B cos + DC at Frequency to one channel of Audio from FirstFrame on. Returns the fitted amplitude,
+	// OutSinadDb is the fitted sine against everything else left in the signal (noise, distortion, aliases and images).
+	double FitSine(const TArray<float>& Audio, int32 NumChannels, int32 Channel, int32 FirstFrame, double Frequency, int32 SampleRate, double& OutSinadDb)
+	{
+		const int32 NumFrames = Audio.Num() / NumChannels;
+
+		double Normal[3][4] = {};
+		for (int32 Frame = FirstFrame; Frame < NumFrames; ++Frame)
+		{
+			const double Angle = 2.0 * PI * Frequency * Frame / SampleRate;
+			const double Basis[3] = { FMath::Sin(Angle), FMath::Cos(Angle), 1.0 };
+			for (int32 Row = 0; Row < 3; ++Row)
+			{
+				for (int32 Column = 0; Column < 3; ++Column)
+				{
+					Normal[Row][Column] += Basis[Row] * Basis[Column];
+				}
+				Normal[Row][3] += Basis[Row] * Audio[Frame * NumChannels + Channel];
+			}
+		}
+
+		// Gauss-Jordan on the 3x3 normal equations
+		for (int32 Pivot = 0; Pivot < 3; ++Pivot)
+		{
+			for (int32 Row = 0; Row < 3; ++Row)
+			{
+				if (Row != Pivot && Normal[Pivot][Pivot] != 0.0)
+				{
+					const double Factor = Normal[Row][Pivot] / Normal[Pivot][Pivot];
+					for (int32 Column = 0; Column < 4; ++Column)
+					{
+						Normal[Row][Column] -= Factor * Normal[Pivot][Column];
+					}
+				}
+			}
+		}
+		const double A = Normal[0][0] != 0.0 ? Normal[0][3] / Normal[0][0] : 0.0;
+		const double B = Normal[1][1] != 0.0 ? Normal[1][3] / Normal[1][1] : 0.0;
+		const double DC = Normal[2][2] != 0.0 ? Normal[2][3] / Normal[2][2] : 0.0;
+
+		double SignalPower = 0.0;
+		double ResidualPower = 0.0;
+		for (int32 Frame = FirstFrame; Frame < NumFrames; ++Frame)
+		{
+			const double Angle = 2.0 * PI * Frequency * Frame / SampleRate;
+			const double Fitted = A * FMath::Sin(Angle) + B * FMath::Cos(Angle) + DC;
+			const double Residual = Audio[Frame * NumChannels + Channel] - Fitted;
+			SignalPower += Fitted * Fitted;
+			ResidualPower += Residual * Residual;
+		}
+
+		OutSinadDb = 10.0 * FMath::LogX(10.0, SignalPower / FMath::Max(ResidualPower, 1e-30));
+		return FMath::Sqrt(A * A + B * B);
+	}
+
+	// Feeds Input through a converter in 10ms packets like the WebRTC sink does, so block and packet boundaries are crossed
+	void ConvertInPackets(FZLAudioFormatConverter& Converter, const TArray<int16_t>& Input, int32 InSampleRate, int32 InNumChannels, TArray<float>& OutAudio)
+	{
+		const int32 NumFrames = Input.Num() / InNumChannels;
+		const int32 PacketFrames = InSampleRate / 100;
+		for (int32 Frame = 0; Frame < NumFrames; Frame += PacketFrames)
+		{
+			Converter.Convert(Input.GetData() + Frame * InNumChannels, InSampleRate, InNumChannels, FMath::Min(PacketFrames, NumFrames - Frame), OutAudio);
+		}
+	}
+
+	// Passband tones must come through within PassbandToleranceDb at MinSinadDb, tones above the output Nyquist must be rejected by MinStopbandDb
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GVerifyAudioResamplerCommand(
+		TEXT("ZLCloudPlugin.Audio.VerifyResampler"),
+		TEXT("Measures passband gain, SINAD and stopband rejection of the incoming audio converter against ideal sines. Usage: ZLCloudPlugin.Audio.VerifyResampler"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const double PassbandToleranceDb = 0.1;
+			const double MinSinadDb = 60.0;
+			const double MinStopbandDb = 60.0;
+			const double Amplitude = 0.5;
+
+			struct FFormatCase
+			{
+				int32 InSampleRate;
+				int32 InNumChannels;
+				int32 OutSampleRate;
+				int32 OutNumChannels;
+			};
+			const FFormatCase Cases[] = {
+				{ 48000, 1, 44100, 1 },
+				{ 44100, 1, 48000, 1 },
+				{ 16000, 1, 48000, 1 },
+				{ 48000, 1, 16000, 1 },
+				{ 22050, 1, 48000, 1 },
+				// Co-prime enough that the filter is quantised to MaxPhases
+				{ 11025, 1, 48000, 1 },
+				{ 48000, 2, 44100, 2 },
+				{ 48000, 2, 24000, 1 },
+				{ 16000, 1, 48000, 2 },
+			};
+
+			// Fractions of the lower of the two Nyquist frequencies, the rest of the band is the filter's transition
+			const double PassbandTones[] = { 0.02, 0.1, 0.25, 0.5 };
+			const double StopbandTone = 1.3;
+
+			int32 NumFailures = 0;
+			for (const FFormatCase& Case : Cases)
+			{
+				const double Nyquist = 0.5 * FMath::Min(Case.InSampleRate, Case.OutSampleRate);
+				const int32 WarmUpFrames = Case.OutSampleRate / 100;
+
+				auto Run = [&Case, Amplitude](double Frequency, TArray<float>& OutAudio)
+				{
+					TArray<int16_t> Input;
+					MakeSineInt16(Frequency, Amplitude, Case.InSampleRate, Case.InNumChannels, Case.InSampleRate / 2, Input);
+
+					FZLAudioFormatConverter Converter;
+					Converter.SetOutputFormat(Case.OutSampleRate, Case.OutNumChannels);
+					ConvertInPackets(Converter, Input, Case.InSampleRate, Case.InNumChannels, OutAudio);
+				};
+
+				FString Line = FString::Printf(TEXT("%5dHz x%d -> %5dHz x%d:"), Case.InSampleRate, Case.InNumChannels, Case.OutSampleRate, Case.OutNumChannels);
+				for (double Tone : PassbandTones)
+				{
+					const double Frequency = Tone * Nyquist;
+					TArray<float> Output;
+					Run(Frequency, Output);
+
+					for (int32 Channel = 0; Channel < Case.OutNumChannels; ++Channel)
+					{
+						double SinadDb = 0.0;
+						const double GainDb = 20.0 * FMath::LogX(10.0, FitSine(Output, Case.OutNumChannels, Channel, WarmUpFrames, Frequency, Case.OutSampleRate, SinadDb) / Amplitude);
+						if (Channel == 0)
+						{
+							Line += FString::Printf(TEXT(" %.0fHz %+.3fdB %.1fdB"), Frequency, GainDb, SinadDb);
+						}
+						if (FMath::Abs(GainDb) > PassbandToleranceDb || SinadDb < MinSinadDb)
+						{
+							Ar.Logf(ELogVerbosity::Error, TEXT("%s channel %d at %.0fHz: gain %+.3fdB, SINAD %.1fdB"), *Line, Channel, Frequency, GainDb, SinadDb);
+							++NumFailures;
+						}
+					}
+				}
+
+				// Only downsampling has a stopband the input can reach
+				const double StopFrequency = StopbandTone * 0.5 * Case.OutSampleRate;
+				if (Case.OutSampleRate < Case.InSampleRate && StopFrequency < 0.5 * Case.InSampleRate)
+				{
+					TArray<float> Output;
+					Run(StopFrequency, Output);
+
+					double Power = 0.0;
+					for (int32 Index = WarmUpFrames * Case.OutNumChannels; Index < Output.Num(); ++Index)
+					{
+						Power += FMath::Square(Output[Index]);
+					}
+					Power /= FMath::Max(1, Output.Num() - WarmUpFrames * Case.OutNumChannels);
+
+					const double RejectionDb = -10.0 * FMath::LogX(10.0, FMath::Max(Power, 1e-30) / (0.5 * Amplitude * Amplitude));
+					Line += FString::Printf(TEXT(" | %.0fHz rejected %.1fdB"), StopFrequency, RejectionDb);
+					if (RejectionDb < MinStopbandDb)
+					{
+						Ar.Logf(ELogVerbosity::Error, TEXT("%s stopband tone at %.0fHz only rejected by %.1fdB"), *Line, StopFrequency, RejectionDb);
+						++NumFailures;
+					}
+				}
+
+				Ar.Logf(TEXT("%s"), *Line);
+			}
+
+			Ar.Logf(TEXT("Audio resampler verification %s: passband within %.2fdB at %.0fdB SINAD, stopband below -%.0fdB"),
+				NumFailures == 0 ? TEXT("passed") : TEXT("FAILED"), PassbandToleranceDb, MinSinadDb, MinStopbandDb);
+		}));
+
+	// Times the vectorised int16 -> float conversion against the per-sample loop it replaced, and the whole converter per format pair
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GBenchmarkAudioConvertCommand(
+		TEXT("ZLCloudPlugin.Audio.BenchmarkConvert"),
+		TEXT("Times int16 to float conversion and resampling of incoming audio. Usage: ZLCloudPlugin.Audio.BenchmarkConvert [Seconds] [Runs]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const double AudioSeconds = FMath::Max(0.1, Args.Num() > 0 ? FCString::Atod(*Args[0]) : 10.0);
+			const int32 NumRuns = FMath::Max(1, Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 10);
+
+			{
+				const int32 NumSamples = static_cast<int32>(48000 * 2 * AudioSeconds);
+				TArray<int16_t> Input;
+				Input.SetNumUninitialized(NumSamples);
+				for (int32 Index = 0; Index < NumSamples; ++Index)
+				{
+					Input[Index] = static_cast<int16_t>((Index * 7919) & 0xFFFF);
+				}
+
+				TArray<float> Scalar;
+				Scalar.SetNumUninitialized(NumSamples);
+				double StartTime = FPlatformTime::Seconds();
+				for (int32 Run = 0; Run < NumRuns; ++Run)
+				{
+					const float Scale = 1.0f / 32767.0f;
+					for (int32 Index = 0; Index < NumSamples; ++Index)
+					{
+						Scalar[Index] = static_cast<float>(Input[Index]) * Scale;
+					}
+				}
+				const double ScalarMs = (FPlatformTime::Seconds() - StartTime) * 1000.0 / NumRuns;
+
+				TArray<float> Vector;
+				Vector.SetNumUninitialized(NumSamples);
+				StartTime = FPlatformTime::Seconds();
+				for (int32 Run = 0; Run < NumRuns; ++Run)
+				{
+					FZLAudioFormatConverter::ConvertInt16ToFloat(Input.GetData(), Vector.GetData(), NumSamples);
+				}
+				const double VectorMs = (FPlatformTime::Seconds() - StartTime) * 1000.0 / NumRuns;
+
+				const bool bIdentical = FMemory::Memcmp(Scalar.GetData(), Vector.GetData(), NumSamples * sizeof(float)) == 0;
+				Ar.Logf(TEXT("int16 -> float, %d samples: per-sample %.3fms, vectorised %.3fms (%.1fx), %s"),
+					NumSamples, ScalarMs, VectorMs, ScalarMs / FMath::Max(VectorMs, 1e-6), bIdentical ? TEXT("bit exact") : TEXT("MISMATCH"));
+				if (!bIdentical)
+				{
+					Ar.Logf(ELogVerbosity::Error, TEXT("Vectorised int16 -> float conversion differs from the per-sample loop"));
+				}
+			}
+
+			struct FFormatCase
+			{
+				int32 InSampleRate;
+				int32 InNumChannels;
+				int32 OutSampleRate;
+				int32 OutNumChannels;
+			};
+			const FFormatCase Cases[] = {
+				{ 48000, 2, 48000, 2 },
+				{ 48000, 2, 44100, 2 },
+				{ 44100, 2, 48000, 2 },
+				{ 16000, 1, 48000, 2 },
+				{ 48000, 2, 16000, 1 },
+			};
+
+			for (const FFormatCase& Case : Cases)
+			{
+				TArray<int16_t> Input;
+				MakeSineInt16(1000.0, 0.5, Case.InSampleRate, Case.InNumChannels, static_cast<int32>(Case.InSampleRate * AudioSeconds), Input);
+
+				FZLAudioFormatConverter Converter;
+				Converter.SetOutputFormat(Case.OutSampleRate, Case.OutNumChannels);
+
+				TArray<float> Output;
+				Output.Reserve(static_cast<int32>(Case.OutSampleRate * Case.OutNumChannels * AudioSeconds) + 1024);
+
+				const double StartTime = FPlatformTime::Seconds();
+				for (int32 Run = 0; Run < NumRuns; ++Run)
+				{
+					Output.Reset();
+					ConvertInPackets(Converter, Input, Case.InSampleRate, Case.InNumChannels, Output);
+				}
+				const double ConvertMs = (FPlatformTime::Seconds() - StartTime) * 1000.0 / NumRuns;
+
+				Ar.Logf(TEXT("%5dHz x%d -> %5dHz x%d: %.3fms per %.1fs of audio (%.0fx realtime)"),
+					Case.InSampleRate, Case.InNumChannels, Case.OutSampleRate, Case.OutNumChannels, ConvertMs, AudioSeconds, AudioSeconds * 1000.0 / FMath::Max(ConvertMs, 1e-6));
+			}
+		}));
+
+	// Time source the pacing tests move by hand
+	class FFakeFramePacerClock : public IFramePacerClock
+	{
+	public:
+		virtual double GetSeconds() const override { return Seconds; }
+
+		double Seconds = 0.0;
+	};
+
+	// Drives FFramePacer and FFramePushTracker off a fake clock through on-time, late, catch-up and paused schedules
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GVerifyFramePacingCommand(
+		TEXT("ZLCloudPlugin.FramePacing.Verify"),
+		TEXT("Checks frame pacing deadlines, late/skipped counts and jitter stats against a fake clock. Usage: ZLCloudPlugin.FramePacing.Verify [Frames] [Seed]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const int32 NumFrames = FMath::Max(2, Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000);
+			FRandomStream Random(Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 1);
+
+			int32 NumFailures = 0;
+			auto Check = [&Ar, &NumFailures](bool bPassed, const FString& What)
+			{
+				if (!bPassed)
+				{
+					Ar.Logf(ELogVerbosity::Error, TEXT("  %s"), *What);
+					++NumFailures;
+				}
+			};
+
+			// 25fps keeps the frame period exact in binary, the start time is arbitrary
+			const int32 FPS = 25;
+			const double Period = 1.0 / FPS;
+			const double Start = 1000.0;
+
+			// Submitting a little either side of every deadline never drifts, is never late and never skips
+			{
+				TSharedRef<FFakeFramePacerClock> Clock = MakeShared<FFakeFramePacerClock>();
+				FFramePacer Pacer(Clock);
+				Pacer.SetTargetFPS(FPS);
+
+				// The schedule is anchored on the first frame
+				double FirstSubmit = 0.0;
+				for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+				{
+					Clock->Seconds = Start + Frame * Period + Random.FRandRange(-0.04, 0.04) * Period;
+					FirstSubmit = Frame == 0 ? Clock->Seconds : FirstSubmit;
+					Pacer.OnFrameSubmitted();
+				}
+
+				const FFramePacingStats Stats = Pacer.GetStats();
+				const double ExpectedDeadline = FirstSubmit + NumFrames * Period;
+				Check(FMath::IsNearlyEqual(Clock->Seconds + Pacer.GetTimeUntilDeadline(), ExpectedDeadline, 1e-9),
+					FString::Printf(TEXT("On time: deadline drifted to %.9f, expected %.9f"), Clock->Seconds + Pacer.GetTimeUntilDeadline(), ExpectedDeadline));
+				Check(Stats.NumIntervals == static_cast<uint64>(NumFrames - 1), FString::Printf(TEXT("On time: %llu intervals, expected %d"), Stats.NumIntervals, NumFrames - 1));
+				Check(Stats.NumLateTicks == 0 && Stats.NumSkippedFrames == 0,
+					FString::Printf(TEXT("On time: %llu late, %llu skipped, expected none"), Stats.NumLateTicks, Stats.NumSkippedFrames));
+				Check(Stats.MaxJitterMs <= 0.1 * Period * 1000.0 + 1e-6, FString::Printf(TEXT("On time: max jitter %.3fms"), Stats.MaxJitterMs));
+			}
+
+			// Skip drops the deadlines a late tick missed and stays on the original grid
+			{
+				TSharedRef<FFakeFramePacerClock> Clock = MakeShared<FFakeFramePacerClock>();
+				FFramePacer Pacer(Clock);
+				Pacer.SetTargetFPS(FPS);
+				Pacer.SetPolicy(EFramePacingPolicy::Skip, 2);
+
+				Clock->Seconds = Start;
+				Pacer.OnFrameSubmitted();
+				Clock->Seconds = Start + 3.5 * Period;
+				Pacer.OnFrameSubmitted();
+
+				const FFramePacingStats Stats = Pacer.GetStats();
+				Check(Stats.NumLateTicks == 1 && Stats.NumSkippedFrames == 2,
+					FString::Printf(TEXT("Skip: %llu late, %llu skipped, expected 1 and 2"), Stats.NumLateTicks, Stats.NumSkippedFrames));
+				Check(FMath::IsNearlyEqual(Pacer.GetTimeUntilDeadline(), 0.5 * Period, 1e-9),
+					FString::Printf(TEXT("Skip: next deadline in %.6fs, expected %.6fs"), Pacer.GetTimeUntilDeadline(), 0.5 * Period));
+			}
+
+			// CatchUp submits the missed frame straight away, then returns to the grid without skipping
+			{
+				TSharedRef<FFakeFramePacerClock> Clock = MakeShared<FFakeFramePacerClock>();
+				FFramePacer Pacer(Clock);
+				Pacer.SetTargetFPS(FPS);
+				Pacer.SetPolicy(EFramePacingPolicy::CatchUp, 2);
+
+				Clock->Seconds = Start;
+				Pacer.OnFrameSubmitted();
+				Clock->Seconds = Start + 2.5 * Period;
+				Pacer.OnFrameSubmitted();
+				Check(Pacer.GetTimeUntilDeadline() <= 0.0, TEXT("CatchUp: the missed frame isn't due straight away"));
+
+				Pacer.OnFrameSubmitted();
+				const FFramePacingStats Stats = Pacer.GetStats();
+				Check(Stats.NumSkippedFrames == 0, FString::Printf(TEXT("CatchUp: %llu skipped, expected none"), Stats.NumSkippedFrames));
+				Check(FMath::IsNearlyEqual(Pacer.GetTimeUntilDeadline(), 0.5 * Period, 1e-9),
+					FString::Printf(TEXT("CatchUp: next deadline in %.6fs after catching up, expected %.6fs"), Pacer.GetTimeUntilDeadline(), 0.5 * Period));
+
+				// Falling further behind than MaxCatchUpFrames skips instead
+				Clock->Seconds += 5.7 * Period;
+				Pacer.OnFrameSubmitted();
+				Check(Pacer.GetStats().NumSkippedFrames == 5, FString::Printf(TEXT("CatchUp: %llu skipped past the catch up limit, expected 5"), Pacer.GetStats().NumSkippedFrames));
+				Check(Pacer.GetTimeUntilDeadline() > 0.0, TEXT("CatchUp: still behind after skipping past the catch up limit"));
+			}
+
+			// A rate change takes effect from the last submitted frame
+			{
+				TSharedRef<FFakeFramePacerClock> Clock = MakeShared<FFakeFramePacerClock>();
+				FFramePacer Pacer(Clock);
+				Pacer.SetTargetFPS(FPS);
+
+				Clock->Seconds = Start;
+				Pacer.OnFrameSubmitted();
+				Pacer.SetTargetFPS(FPS * 2);
+				Check(FMath::IsNearlyEqual(Pacer.GetTimeUntilDeadline(), 0.5 * Period, 1e-9),
+					FString::Printf(TEXT("Rate change: next deadline in %.6fs, expected %.6fs"), Pacer.GetTimeUntilDeadline(), 0.5 * Period));
+
+				Pacer.Restart();
+				Check(Pacer.GetTimeUntilDeadline() <= 0.0, TEXT("Restart: the first frame of the new schedule isn't due straight away"));
+			}
+
+			// Jitter lands in the bucket bounding it
+			{
+				FFramePacingStats Stats;
+				const double TargetMs = Period * 1000.0;
+				const double Jitters[] = { 0.2, 0.7, 1.5, 3.0, 6.0, 12.0, 20.0, 50.0 };
+				for (int32 Bucket = 0; Bucket < FFramePacingStats::NumJitterBuckets; ++Bucket)
+				{
+					Stats.AddInterval(TargetMs + Jitters[Bucket], TargetMs);
+				}
+				for (int32 Bucket = 0; Bucket < FFramePacingStats::NumJitterBuckets; ++Bucket)
+				{
+					Check(Stats.JitterHistogram[Bucket] == 1, FString::Printf(TEXT("Histogram: bucket %d holds %llu intervals, expected 1"), Bucket, Stats.JitterHistogram[Bucket]));
+				}
+				Check(FMath::IsNearlyEqual(Stats.MaxJitterMs, 50.0, 1e-9), FString::Printf(TEXT("Histogram: max jitter %.3fms, expected 50ms"), Stats.MaxJitterMs));
+			}
+
+			// A video source only owes frames while it is producing them
+			{
+				FFramePushTracker Tracker;
+				const double TargetMs = Period * 1000.0;
+				uint64 ExpectedMissed = 0;
+				uint64 ExpectedIntervals = 0;
+				bool bPushedSinceResume = false;
+
+				for (int32 Tick = 0; Tick < NumFrames; ++Tick)
+				{
+					const double Now = Start + Tick * Period;
+					const int32 Roll = Random.RandRange(0, 9);
+					if (Roll < 3)
+					{
+						Tracker.OnPaused();
+						bPushedSinceResume = false;
+					}
+					else if (Roll < 4)
+					{
+						Tracker.OnFrameMissed();
+						++ExpectedMissed;
+					}
+					else
+					{
+						Tracker.OnFramePushed(Now, TargetMs);
+						ExpectedIntervals += bPushedSinceResume ? 1 : 0;
+						bPushedSinceResume = true;
+					}
+				}
+
+				const FFramePacingStats& Stats = Tracker.GetStats();
+				Check(Stats.NumSkippedFrames == ExpectedMissed,
+					FString::Printf(TEXT("Source: %llu skipped, expected %llu (paused ticks must not count)"), Stats.NumSkippedFrames, ExpectedMissed));
+				Check(Stats.NumIntervals == ExpectedIntervals,
+					FString::Printf(TEXT("Source: %llu intervals, expected %llu (pauses must not be measured)"), Stats.NumIntervals, ExpectedIntervals));
+
+				// A source that stays paused reports nothing at all
+				Tracker.Reset();
+				for (int32 Tick = 0; Tick < 100; ++Tick)
+				{
+					Tracker.OnPaused();
+				}
+				Check(Tracker.GetStats().NumSkippedFrames == 0 && Tracker.GetStats().NumIntervals == 0, TEXT("Source: a paused source reported skipped frames or intervals"));
+			}
+
+			Ar.Logf(TEXT("Frame pacing verification %s over %d frames"), NumFailures == 0 ? TEXT("passed") : TEXT("FAILED"), NumFrames);
+		}));
+
+	// Random 32 bit frame with Stride bytes per row, the padding past each row is random too
+	TArray<uint8> MakeRandomFrame(FRandomStream& Random, int32 Stride, int32 Height)
+	{
+		TArray<uint8> Frame;
+		Frame.SetNumUninitialized(Stride * Height);
+		for (uint8& Byte : Frame)
+		{
+			Byte = static_cast<uint8>(Random.RandRange(0, 255));
+		}
+		return Frame;
+	}
+
+	struct FYUVPlanes
+	{
+		TArray<uint8> Y;
+		TArray<uint8> U;
+		TArray<uint8> V;
+		int32 StrideY = 0;
+		int32 StrideChroma = 0;
+
+		FYUVPlanes(int32 Width, int32 Height, bool bNV12)
+		{
+			StrideY = Width;
+			StrideChroma = bNV12 ? FMath::DivideAndRoundUp(Width, 2) * 2 : FMath::DivideAndRoundUp(Width, 2);
+			const int32 ChromaHeight = FMath::DivideAndRoundUp(Height, 2);
+			Y.SetNumZeroed(StrideY * Height);
+			U.SetNumZeroed(StrideChroma * ChromaHeight);
+			V.SetNumZeroed(bNV12 ? 0 : StrideChroma * ChromaHeight);
+		}
+
+		bool operator==(const FYUVPlanes& Other) const
+		{
+			return Y == Other.Y && U == Other.U && V == Other.V;
+		}
+	};
+
+	void ConvertYUV(const FZLYUVConverter& Converter, const TArray<uint8>& Frame, int32 Stride, int32 Width, int32 Height, bool bNV12, FYUVPlanes& Planes)
+	{
+		if (bNV12)
+		{
+			Converter.ConvertToNV12(Frame.GetData(), Stride, Width, Height, Planes.Y.GetData(), Planes.StrideY, Planes.U.GetData(), Planes.StrideChroma);
+		}
+		else
+		{
+			Converter.ConvertToI420(Frame.GetData(), Stride, Width, Height, Planes.Y.GetData(), Planes.StrideY,
+				Planes.U.GetData(), Planes.StrideChroma, Planes.V.GetData(), Planes.StrideChroma);
+		}
+	}
+
+	// The SIMD and parallel paths against the scalar reference on awkward sizes, plus known colours against the BT.601/709 equations
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GVerifyYUVCommand(
+		TEXT("ZLCloudPlugin.YUV.Verify"),
+		TEXT("Checks the vectorised RGBA/BGRA to I420/NV12 conversion is bit exact with the scalar path and known colours convert correctly. Usage: ZLCloudPlugin.YUV.Verify [Seed]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			FRandomStream Random(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1);
+
+			int32 NumFailures = 0;
+			auto Check = [&Ar, &NumFailures](bool bPassed, const FString& What)
+			{
+				if (!bPassed)
+				{
+					Ar.Logf(ELogVerbosity::Error, TEXT("  %s"), *What);
+					++NumFailures;
+				}
+			};
+
+			const FZLYUVColorSpace ColorSpaces[] = {
+				{ EZLYUVMatrix::BT601, EZLYUVRange::Limited },
+				{ EZLYUVMatrix::BT601, EZLYUVRange::Full },
+				{ EZLYUVMatrix::BT709, EZLYUVRange::Limited },
+				{ EZLYUVMatrix::BT709, EZLYUVRange::Full },
+			};
+			// Odd sizes leave partial vectors and a lone chroma column/row, 97 rows spans several parallel tiles
+			const FIntPoint Sizes[] = { { 1, 1 }, { 2, 2 }, { 3, 5 }, { 15, 7 }, { 16, 16 }, { 17, 9 }, { 33, 97 }, { 640, 360 }, { 1283, 67 } };
+
+			int32 NumCompared = 0;
+			for (const FZLYUVColorSpace& ColorSpace : ColorSpaces)
+			{
+				for (EZLRGBLayout Layout : { EZLRGBLayout::RGBA, EZLRGBLayout::BGRA })
+				{
+					FZLYUVConverter Scalar(ColorSpace, Layout);
+					Scalar.SetVectorised(false);
+					Scalar.SetParallel(false);
+					FZLYUVConverter Vectorised(ColorSpace, Layout);
+
+					for (const FIntPoint& Size : Sizes)
+					{
+						const int32 Stride = Size.X * 4 + Random.RandRange(0, 3) * 4;
+						const TArray<uint8> Frame = MakeRandomFrame(Random, Stride, Size.Y);
+
+						for (bool bNV12 : { false, true })
+						{
+							FYUVPlanes Expected(Size.X, Size.Y, bNV12);
+							FYUVPlanes Actual(Size.X, Size.Y, bNV12);
+							ConvertYUV(Scalar, Frame, Stride, Size.X, Size.Y, bNV12, Expected);
+							ConvertYUV(Vectorised, Frame, Stride, Size.X, Size.Y, bNV12, Actual);
+							Check(Expected == Actual, FString::Printf(TEXT("%s %s %s %s %dx%d differs from the scalar path"),
+								ColorSpace.Matrix == EZLYUVMatrix::BT601 ? TEXT("BT.601") : TEXT("BT.709"),
+								ColorSpace.Range == EZLYUVRange::Full ? TEXT("full") : TEXT("limited"),
+								Layout == EZLRGBLayout::RGBA ? TEXT("RGBA") : TEXT("BGRA"),
+								bNV12 ? TEXT("NV12") : TEXT("I420"), Size.X, Size.Y));
+							++NumCompared;
+						}
+					}
+				}
+			}
+
+			// Solid colours, within a code value of the floating point equations
+			struct FColourCase
+			{
+				FZLYUVColorSpace ColorSpace;
+				uint8 R, G, B;
+				uint8 Y, U, V;
+			};
+			const FColourCase Colours[] = {
+				{ { EZLYUVMatrix::BT601, EZLYUVRange::Limited }, 255, 255, 255, 235, 128, 128 },
+				{ { EZLYUVMatrix::BT601, EZLYUVRange::Limited }, 0, 0, 0, 16, 128, 128 },
+				{ { EZLYUVMatrix::BT601, EZLYUVRange::Limited }, 255, 0, 0, 81, 90, 240 },
+				{ { EZLYUVMatrix::BT601, EZLYUVRange::Full }, 128, 128, 128, 128, 128, 128 },
+				{ { EZLYUVMatrix::BT601, EZLYUVRange::Full }, 0, 0, 255, 29, 255, 107 },
+				{ { EZLYUVMatrix::BT709, EZLYUVRange::Limited }, 255, 255, 255, 235, 128, 128 },
+				{ { EZLYUVMatrix::BT709, EZLYUVRange::Limited }, 0, 255, 0, 173, 42, 26 },
+				{ { EZLYUVMatrix::BT709, EZLYUVRange::Full }, 255, 0, 0, 54, 99, 255 },
+			};
+			for (const FColourCase& Colour : Colours)
+			{
+				for (EZLRGBLayout Layout : { EZLRGBLayout::RGBA, EZLRGBLayout::BGRA })
+				{
+					const int32 Width = 20;
+					const int32 Height = 4;
+					TArray<uint8> Frame;
+					Frame.SetNumUninitialized(Width * Height * 4);
+					for (int32 Pixel = 0; Pixel < Width * Height; ++Pixel)
+					{
+						Frame[Pixel * 4 + 0] = Layout == EZLRGBLayout::RGBA ? Colour.R : Colour.B;
+						Frame[Pixel * 4 + 1] = Colour.G;
+						Frame[Pixel * 4 + 2] = Layout == EZLRGBLayout::RGBA ? Colour.B : Colour.R;
+						Frame[Pixel * 4 + 3] = 255;
+					}
+
+					FYUVPlanes Planes(Width, Height, false);
+					ConvertYUV(FZLYUVConverter(Colour.ColorSpace, Layout), Frame, Width * 4, Width, Height, false, Planes);
+					const bool bMatches = FMath::Abs(Planes.Y[0] - Colour.Y) <= 1 && FMath::Abs(Planes.U[0] - Colour.U) <= 1 && FMath::Abs(Planes.V[0] - Colour.V) <= 1;
+					Check(bMatches, FString::Printf(TEXT("RGB %d,%d,%d converted to YUV %d,%d,%d, expected %d,%d,%d"),
+						Colour.R, Colour.G, Colour.B, Planes.Y[0], Planes.U[0], Planes.V[0], Colour.Y, Colour.U, Colour.V));
+				}
+			}
+
+			// The CPU capturer builds its converter from whatever the encoder asks for
+			const uint32 CloudStreamColorSpaces[] = { CloudStream2DLL::YUVColorSpace::BT_601Full, CloudStream2DLL::YUVColorSpace::BT_601Studio, CloudStream2DLL::YUVColorSpace::BT_709Studio };
+			const FZLYUVColorSpace ExpectedColorSpaces[] = { { EZLYUVMatrix::BT601, EZLYUVRange::Full }, { EZLYUVMatrix::BT601, EZLYUVRange::Limited }, { EZLYUVMatrix::BT709, EZLYUVRange::Limited } };
+			for (int32 i = 0; i < UE_ARRAY_COUNT(CloudStreamColorSpaces); ++i)
+			{
+				const FZLYUVColorSpace ColorSpace = FZLYUVColorSpace::FromCloudStream(CloudStreamColorSpaces[i]);
+				Check(ColorSpace.Matrix == ExpectedColorSpaces[i].Matrix && ColorSpace.Range == ExpectedColorSpaces[i].Range,
+					FString::Printf(TEXT("Encoder color space %u mapped to the wrong matrix or range"), CloudStreamColorSpaces[i]));
+			}
+
+			Ar.Logf(TEXT("YUV verification %s, %d conversions compared with the scalar path"), NumFailures == 0 ? TEXT("passed") : TEXT("FAILED"), NumCompared);
+		}));
+
+	// Milliseconds per frame for the scalar path, the SIMD path on one thread and the SIMD path across the task graph
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GBenchmarkYUVCommand(
+		TEXT("ZLCloudPlugin.YUV.Benchmark"),
+		TEXT("Times RGBA to I420 and NV12 conversion at 1080p and 4K. Usage: ZLCloudPlugin.YUV.Benchmark [Runs]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const int32 NumRuns = FMath::Max(1, Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 20);
+			FRandomStream Random(1);
+
+			const FIntPoint Sizes[] = { { 1920, 1080 }, { 3840, 2160 } };
+			for (const FIntPoint& Size : Sizes)
+			{
+				const TArray<uint8> Frame = MakeRandomFrame(Random, Size.X * 4, Size.Y);
+
+				for (bool bNV12 : { false, true })
+				{
+					FYUVPlanes Planes(Size.X, Size.Y, bNV12);
+
+					auto Time = [&](bool bVectorised, bool bParallel)
+					{
+						FZLYUVConverter Converter;
+						Converter.SetVectorised(bVectorised);
+						Converter.SetParallel(bParallel);
+
+						// One untimed run so the first timed one doesn't pay for faulting the planes in
+						ConvertYUV(Converter, Frame, Size.X * 4, Size.X, Size.Y, bNV12, Planes);
+
+						const double StartTime = FPlatformTime::Seconds();
+						for (int32 Run = 0; Run < NumRuns; ++Run)
+						{
+							ConvertYUV(Converter, Frame, Size.X * 4, Size.X, Size.Y, bNV12, Planes);
+						}
+						return (FPlatformTime::Seconds() - StartTime) * 1000.0 / NumRuns;
+					};
+
+					const double ScalarMs = Time(false, false);
+					const double VectorMs = Time(true, false);
+					const double ParallelMs = Time(true, true);
+					Ar.Logf(TEXT("%dx%d -> %s: scalar %.2fms, vectorised %.2fms (%.1fx), vectorised parallel %.2fms (%.1fx)"),
+						Size.X, Size.Y, bNV12 ? TEXT("NV12") : TEXT("I420"), ScalarMs,
+						VectorMs, ScalarMs / FMath::Max(VectorMs, 1e-6), ParallelMs, ScalarMs / FMath::Max(ParallelMs, 1e-6));
+				}
+			}
+		}));
+
+#if UNREAL_5_1_OR_NEWER
+	// The queue only cares about frame identity, so the frames have no texture
+	TSharedPtr<IPixelCaptureOutputFrame> MakeFakeFrame()
+	{
+		return MakeShared<FPixelCaptureOutputFrameRHI>(FTextureRHIRef());
+	}
+
+	// Scripted pushes and pops for each budget policy against a fake clock, then a fake capture running faster than a jittery consumer
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GVerifyFrameBudgetCommand(
+		TEXT("ZLCloudPlugin.FrameBudget.Verify"),
+		TEXT("Checks the frame budget queue's drop, hold and timeout behaviour and frame accounting against a fake clock and consumer. Usage: ZLCloudPlugin.FrameBudget.Verify [Frames] [Seed]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const int32 NumFrames = FMath::Max(10, Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000);
+			FRandomStream Random(Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 1);
+
+			int32 NumFailures = 0;
+			auto Check = [&Ar, &NumFailures](bool bPassed, const FString& What)
+			{
+				if (!bPassed)
+				{
+					Ar.Logf(ELogVerbosity::Error, TEXT("  %s"), *What);
+					++NumFailures;
+				}
+			};
+
+			TArray<TSharedPtr<IPixelCaptureOutputFrame>> Frames;
+			for (int32 Index = 0; Index < 8; ++Index)
+			{
+				Frames.Add(MakeFakeFrame());
+			}
+
+			{
+				TSharedRef<FFakeFramePacerClock> Clock = MakeShared<FFakeFramePacerClock>();
+				FFrameBudgetQueue Queue(Clock);
+				Queue.SetBudget(2, EFrameBudgetPolicy::DropOldest, 0.0);
+
+				const bool bAllQueued = Queue.Push(Frames[0]) && Queue.Push(Frames[1]) && Queue.Push(Frames[2]);
+				Check(bAllQueued && Queue.Num() == 2, TEXT("DropOldest didn't queue every frame within a budget of 2"));
+				Check(Queue.Pop() == Frames[2] && Queue.Pop() == nullptr, TEXT("DropOldest didn't hand over the newest frame"));
+				Check(Queue.GetStats().NumDroppedOldest == 2 && Queue.GetStats().NumConsumed == 1, FString::Printf(TEXT("DropOldest stats are wrong: %s"), *Queue.GetStats().ToString()));
+			}
+
+			{
+				TSharedRef<FFakeFramePacerClock> Clock = MakeShared<FFakeFramePacerClock>();
+				FFrameBudgetQueue Queue(Clock);
+				Queue.SetBudget(2, EFrameBudgetPolicy::DropNewest, 0.0);
+
+				const bool bFirstQueued = Queue.Push(Frames[0]) && Queue.Push(Frames[1]);
+				Check(bFirstQueued && !Queue.Push(Frames[2]), TEXT("DropNewest didn't reject the frame over budget"));
+
+				// A frame the policy drops is never made, so the capture isn't copied
+				bool bMadeRejected = false;
+				Check(!Queue.Push([&bMadeRejected, &Frames]() { bMadeRejected = true; return Frames[3]; }) && !bMadeRejected, TEXT("DropNewest made a frame it then dropped"));
+				Check(Queue.Pop() == Frames[0] && Queue.Pop() == Frames[1] && Queue.Pop() == nullptr, TEXT("DropNewest didn't keep the waiting frames"));
+				Check(Queue.GetStats().NumDroppedNewest == 2, FString::Printf(TEXT("DropNewest stats are wrong: %s"), *Queue.GetStats().ToString()));
+			}
+
+			{
+				TSharedRef<FFakeFramePacerClock> Clock = MakeShared<FFakeFramePacerClock>();
+				FFrameBudgetQueue Queue(Clock);
+				Queue.SetBudget(2, EFrameBudgetPolicy::BlockWithTimeout, 0.005);
+
+				Queue.Push(Frames[0]);
+				Queue.Push(Frames[1]);
+				Check(Queue.Push(Frames[2]), TEXT("BlockWithTimeout didn't hold the first frame over budget"));
+				Check(!Queue.Push(Frames[3]), TEXT("BlockWithTimeout held a second frame behind the first"));
+
+				// Within the timeout the held frame takes the slot the pop frees, keeping its push time
+				Clock->Seconds += 0.002;
+				Check(Queue.Pop() == Frames[0] && Queue.Num() == 2, TEXT("BlockWithTimeout didn't queue the held frame once a slot was free"));
+				Check(Queue.Pop() == Frames[1], TEXT("BlockWithTimeout reordered the waiting frames"));
+				const double HeldAgeMsBefore = Queue.GetStats().TotalAgeMs;
+				Check(Queue.Pop() == Frames[2], TEXT("BlockWithTimeout lost the held frame"));
+				const double HeldAgeMs = Queue.GetStats().TotalAgeMs - HeldAgeMsBefore;
+				Check(FMath::IsNearlyEqual(HeldAgeMs, 2.0, 1e-6), FString::Printf(TEXT("Held frame aged %.3fms, expected 2ms from its push"), HeldAgeMs));
+
+				// Past the timeout the held frame is dropped rather than queued
+				Queue.Push(Frames[4]);
+				Queue.Push(Frames[5]);
+				Queue.Push(Frames[6]);
+				Clock->Seconds += 0.006;
+				Check(Queue.Pop() == Frames[4] && Queue.Pop() == Frames[5] && Queue.Pop() == nullptr, TEXT("BlockWithTimeout queued a frame held past its timeout"));
+
+				const FFrameQueueStats Stats = Queue.GetStats();
+				Check(Stats.NumBlocked == 2 && Stats.NumBlockTimeouts == 1 && Stats.NumDroppedNewest == 2,
+					FString::Printf(TEXT("BlockWithTimeout stats are wrong: %s"), *Stats.ToString()));
+			}
+
+			{
+				// Push runs where captures complete, so it must return straight away however long the timeout is
+				FFrameBudgetQueue Queue;
+				Queue.SetBudget(1, EFrameBudgetPolicy::BlockWithTimeout, 10.0);
+				const double StartSeconds = FPlatformTime::Seconds();
+				Queue.Push(Frames[0]);
+				Queue.Push(Frames[1]);
+				Queue.Push(Frames[2]);
+				const double PushMs = (FPlatformTime::Seconds() - StartSeconds) * 1000.0;
+				Check(PushMs < 100.0, FString::Printf(TEXT("Pushing into a full BlockWithTimeout queue took %.1fms"), PushMs));
+			}
+
+			// Capture at 60fps into a consumer at 30fps +-20%, every frame must be consumed or counted as dropped and come out in order
+			struct FPolicyCase
+			{
+				EFrameBudgetPolicy Policy;
+				const TCHAR* Name;
+			};
+			const FPolicyCase Policies[] = {
+				{ EFrameBudgetPolicy::DropOldest, TEXT("DropOldest") },
+				{ EFrameBudgetPolicy::DropNewest, TEXT("DropNewest") },
+				{ EFrameBudgetPolicy::BlockWithTimeout, TEXT("BlockWithTimeout") },
+			};
+			const int32 Budget = 2;
+			const double CapturePeriod = 1.0 / 60.0;
+			const double ConsumerPeriod = 1.0 / 30.0;
+
+			for (const FPolicyCase& Policy : Policies)
+			{
+				TSharedRef<FFakeFramePacerClock> Clock = MakeShared<FFakeFramePacerClock>();
+				FFrameBudgetQueue Queue(Clock);
+				Queue.SetBudget(Budget, Policy.Policy, 0.020);
+
+				TMap<IPixelCaptureOutputFrame*, int32> FrameNumbers;
+				int32 LastConsumed = -1;
+				bool bInOrder = true;
+
+				auto Consume = [&]()
+				{
+					if (TSharedPtr<IPixelCaptureOutputFrame> Frame = Queue.Pop())
+					{
+						const int32 FrameNumber = FrameNumbers.FindChecked(Frame.Get());
+						bInOrder &= FrameNumber > LastConsumed;
+						LastConsumed = FrameNumber;
+					}
+				};
+
+				int32 NumCaptured = 0;
+				double NextCapture = 0.0;
+				double NextConsume = ConsumerPeriod * Random.FRandRange(0.8, 1.2);
+				while (NumCaptured < NumFrames)
+				{
+					if (NextCapture <= NextConsume)
+					{
+						Clock->Seconds = NextCapture;
+						TSharedPtr<IPixelCaptureOutputFrame> Frame = MakeFakeFrame();
+						FrameNumbers.Add(Frame.Get(), NumCaptured++);
+						Queue.Push(Frame);
+						NextCapture += CapturePeriod;
+					}
+					else
+					{
+						Clock->Seconds = NextConsume;
+						Consume();
+						NextConsume += ConsumerPeriod * Random.FRandRange(0.8, 1.2);
+					}
+				}
+
+				// Drain without moving the clock, so a held frame is still inside its timeout
+				while (Queue.Num() > 0)
+				{
+					Consume();
+				}
+
+				const FFrameQueueStats Stats = Queue.GetStats();
+				const uint64 NumAccounted = Stats.NumConsumed + Stats.NumDroppedOldest + Stats.NumDroppedNewest;
+				Check(Stats.NumProduced == static_cast<uint64>(NumFrames) && NumAccounted == Stats.NumProduced,
+					FString::Printf(TEXT("%s produced %llu frames but consumed or dropped %llu"), Policy.Name, Stats.NumProduced, NumAccounted));
+				Check(bInOrder, FString::Printf(TEXT("%s handed frames to the consumer out of order"), Policy.Name));
+				Check(Stats.NumConsumed > 0 && Stats.NumConsumed < Stats.NumProduced, FString::Printf(TEXT("%s should drop frames for a consumer at half the capture rate"), Policy.Name));
+
+				if (Policy.Policy == EFrameBudgetPolicy::DropOldest)
+				{
+					// The newest frame is handed over, so none waits longer than one capture period
+					Check(Stats.MaxAgeMs <= CapturePeriod * 1000.0 + 1e-6, FString::Printf(TEXT("DropOldest handed over a frame %.2fms old"), Stats.MaxAgeMs));
+				}
+				else if (Policy.Policy == EFrameBudgetPolicy::BlockWithTimeout)
+				{
+					Check(Stats.NumBlocked >= Stats.NumBlockTimeouts && Stats.NumBlocked > 0, FString::Printf(TEXT("BlockWithTimeout never held a frame: %s"), *Stats.ToString()));
+				}
+
+				Ar.Logf(TEXT("  %s: %s"), Policy.Name, *Stats.ToString());
+			}
+
+			Ar.Logf(TEXT("Frame budget verification %s over %d frames"), NumFailures == 0 ? TEXT("passed") : TEXT("FAILED"), NumFrames);
+		}));
+
+	// Uploads Pixels to a PF_R8G8B8A8 texture, which stores red first where FColor stores blue first
+	void UploadTexture(FRHICommandListImmediate& RHICmdList, FTextureRHIRef Texture, const TArray<FColor>& Pixels)
+	{
+		const FIntPoint Size = Texture->GetDesc().Extent;
+		TArray<uint8> Bytes;
+		Bytes.Reserve(Pixels.Num() * 4);
+		for (const FColor& Pixel : Pixels)
+		{
+			Bytes.Add(Pixel.R);
+			Bytes.Add(Pixel.G);
+			Bytes.Add(Pixel.B);
+			Bytes.Add(Pixel.A);
+		}
+
+		RHICmdList.Transition(FRHITransitionInfo(Texture, ERHIAccess::Unknown, ERHIAccess::CopyDest));
+		RHICmdList.UpdateTexture2D(Texture, 0, FUpdateTextureRegion2D(0, 0, 0, 0, Size.X, Size.Y), Size.X * 4, Bytes.GetData());
+	}
+
+	// 2x2 box filter, what a bilinear sample half way between texels gives
+	void HalveReference(const TArray<FColor>& Pixels, FIntPoint Size, TArray<FColor>& OutPixels)
+	{
+		const FIntPoint HalfSize(Size.X / 2, Size.Y / 2);
+		OutPixels.SetNumUninitialized(HalfSize.X * HalfSize.Y);
+		for (int32 Y = 0; Y < HalfSize.Y; ++Y)
+		{
+			for (int32 X = 0; X < HalfSize.X; ++X)
+			{
+				const FColor& A = Pixels[(Y * 2) * Size.X + X * 2];
+				const FColor& B = Pixels[(Y * 2) * Size.X + X * 2 + 1];
+				const FColor& C = Pixels[(Y * 2 + 1) * Size.X + X * 2];
+				const FColor& D = Pixels[(Y * 2 + 1) * Size.X + X * 2 + 1];
+				auto Average = [](int32 P, int32 Q, int32 R, int32 S) { return static_cast<uint8>(FMath::RoundToInt((P + Q + R + S) / 4.0f)); };
+				OutPixels[Y * HalfSize.X + X] = FColor(Average(A.R, B.R, C.R, D.R), Average(A.G, B.G, C.G, D.G), Average(A.B, B.B, C.B, D.B), Average(A.A, B.A, C.A, D.A));
+			}
+		}
+	}
+
+	int32 MaxChannelDifference(const FColor& A, const FColor& B)
+	{
+		return FMath::Max(FMath::Max(FMath::Abs(A.R - B.R), FMath::Abs(A.G - B.G)), FMath::Max(FMath::Abs(A.B - B.B), FMath::Abs(A.A - B.A)));
+	}
+
+	// Layer selection and downscale pass planning on the CPU, then on the GPU the filtered downscale chain against a box filter
+	// reference and a video input that should only produce the layers being requested
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GVerifySimulcastCommand(
+		TEXT("ZLCloudPlugin.Simulcast.Verify"),
+		TEXT("Checks simulcast layer selection, filtered downscaling and that only requested layers are produced. Usage: ZLCloudPlugin.Simulcast.Verify [Seed]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			FRandomStream Random(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1);
+
+			int32 NumFailures = 0;
+			auto Check = [&Ar, &NumFailures](bool bPassed, const FString& What)
+			{
+				if (!bPassed)
+				{
+					Ar.Logf(ELogVerbosity::Error, TEXT("  %s"), *What);
+					++NumFailures;
+				}
+			};
+
+			{
+				const TArray<float> ScaleDowns = { 2.0f, 4.0f };
+				struct FSelectCase
+				{
+					FIntPoint Capture;
+					FIntPoint Target;
+					int32 Expected;
+				};
+				const FSelectCase Cases[] = {
+					{ { 1920, 1080 }, { 1920, 1080 }, 0 },
+					{ { 1920, 1080 }, { 1280, 720 }, 0 },
+					{ { 1920, 1080 }, { 960, 540 }, 1 },
+					{ { 1920, 1080 }, { 640, 360 }, 1 },
+					{ { 1920, 1080 }, { 480, 270 }, 2 },
+					{ { 1920, 1080 }, { 320, 180 }, 2 },
+					// Taller than the half layer, it would have to be upscaled
+					{ { 1920, 1080 }, { 960, 600 }, 0 },
+					{ { 3840, 2160 }, { 1920, 1080 }, 1 },
+					// Nothing captured yet, or no encoder resolution yet
+					{ { 0, 0 }, { 480, 270 }, 0 },
+					{ { 1920, 1080 }, { 0, 0 }, 0 },
+				};
+				for (const FSelectCase& Case : Cases)
+				{
+					const int32 Layer = FZLCloudPluginVideoInput::SelectLayerForResolution(Case.Capture, ScaleDowns, Case.Target);
+					Check(Layer == Case.Expected, FString::Printf(TEXT("Layer for %dx%d from a %dx%d capture is %d, expected %d"),
+						Case.Target.X, Case.Target.Y, Case.Capture.X, Case.Capture.Y, Layer, Case.Expected));
+				}
+			}
+
+			for (int32 Iteration = 0; Iteration < 1000; ++Iteration)
+			{
+				const FIntPoint To(Random.RandRange(1, 1000), Random.RandRange(1, 1000));
+				const FIntPoint From(To.X * Random.RandRange(1, 16) + Random.RandRange(0, 7), To.Y * Random.RandRange(1, 16) + Random.RandRange(0, 7));
+
+				TArray<FIntPoint> Passes;
+				ZLCloudPluginUtils::GetDownscalePasses(From, To, Passes);
+
+				bool bValid = Passes.Num() > 0 && Passes.Last() == To;
+				FIntPoint Previous = From;
+				for (const FIntPoint& Pass : Passes)
+				{
+					bValid &= Pass.X >= To.X && Pass.Y >= To.Y && Pass.X * 2 >= Previous.X && Pass.Y * 2 >= Previous.Y;
+					Previous = Pass;
+				}
+				if (!bValid)
+				{
+					Check(false, FString::Printf(TEXT("Downscale passes from %dx%d to %dx%d skip texels or miss the target"), From.X, From.Y, To.X, To.Y));
+					break;
+				}
+			}
+
+			if (GUsingNullRHI)
+			{
+				Ar.Logf(TEXT("Simulcast verification %s, GPU checks skipped under the null RHI"), NumFailures == 0 ? TEXT("passed") : TEXT("FAILED"));
+				return;
+			}
+
+			// One pixel checkerboard, point sampling any downscale of it gives solid black or white
+			const FIntPoint CheckerSize(256, 256);
+			const FIntPoint CheckerLayerSize(32, 32);
+			TArray<FColor> Checker;
+			Checker.SetNumUninitialized(CheckerSize.X * CheckerSize.Y);
+			for (int32 Index = 0; Index < Checker.Num(); ++Index)
+			{
+				Checker[Index] = ((Index % CheckerSize.X) + (Index / CheckerSize.X)) % 2 == 0 ? FColor::Black : FColor::White;
+			}
+
+			// Noise halved three times on the CPU
+			const FIntPoint NoiseSize(256, 144);
+			TArray<FColor> Noise;
+			Noise.SetNumUninitialized(NoiseSize.X * NoiseSize.Y);
+			for (FColor& Pixel : Noise)
+			{
+				Pixel = FColor(Random.RandRange(0, 255), Random.RandRange(0, 255), Random.RandRange(0, 255), 255);
+			}
+			TArray<FColor> NoiseReference = Noise;
+			FIntPoint NoiseLayerSize = NoiseSize;
+			for (int32 Pass = 0; Pass < 3; ++Pass)
+			{
+				TArray<FColor> Halved;
+				HalveReference(NoiseReference, NoiseLayerSize, Halved);
+				NoiseReference = MoveTemp(Halved);
+				NoiseLayerSize /= 2;
+			}
+
+			// Kept alive between runs, the pixel capture pipeline can still be finishing the last frame when this returns
+			static TSharedPtr<FZLCloudPluginVideoInputRHI> VideoInput;
+			VideoInput = MakeShared<FZLCloudPluginVideoInputRHI>();
+			VideoInput->AddOutputFormat(PixelCaptureBufferFormat::FORMAT_RHI);
+			VideoInput->SetSimulcastLayers({ 2.0f, 4.0f });
+
+			TArray<FColor> CheckerResult;
+			TArray<FColor> NoiseResult;
+			FZLCloudPluginVideoInput::FSimulcastLayerStats HalfStats;
+			FZLCloudPluginVideoInput::FSimulcastLayerStats QuarterStats;
+			FZLCloudPluginVideoInput::FSimulcastLayerStats QuarterWokenStats;
+			const int32 NumCapturedFrames = 4;
+
+			ENQUEUE_RENDER_COMMAND(ZLVerifySimulcast)([&](FRHICommandListImmediate& RHICmdList) {
+				TArray<FTextureRHIRef> ScratchTextures;
+
+				FTextureRHIRef CheckerTexture = ZLCloudPluginUtils::CreateTexture(CheckerSize.X, CheckerSize.Y);
+				FTextureRHIRef CheckerLayer = ZLCloudPluginUtils::CreateTexture(CheckerLayerSize.X, CheckerLayerSize.Y);
+				UploadTexture(RHICmdList, CheckerTexture, Checker);
+				ZLCloudPluginUtils::DownscaleTexture(RHICmdList, CheckerTexture, CheckerLayer, ScratchTextures);
+				RHICmdList.Transition(FRHITransitionInfo(CheckerLayer, ERHIAccess::Unknown, ERHIAccess::CopySrc));
+				ZLCloudPluginUtils::ReadTextureToCPU(RHICmdList, CheckerLayer, CheckerResult);
+
+				FTextureRHIRef NoiseTexture = ZLCloudPluginUtils::CreateTexture(NoiseSize.X, NoiseSize.Y);
+				FTextureRHIRef NoiseLayer = ZLCloudPluginUtils::CreateTexture(NoiseLayerSize.X, NoiseLayerSize.Y);
+				UploadTexture(RHICmdList, NoiseTexture, Noise);
+				ZLCloudPluginUtils::DownscaleTexture(RHICmdList, NoiseTexture, NoiseLayer, ScratchTextures);
+				RHICmdList.Transition(FRHITransitionInfo(NoiseLayer, ERHIAccess::Unknown, ERHIAccess::CopySrc));
+				ZLCloudPluginUtils::ReadTextureToCPU(RHICmdList, NoiseLayer, NoiseResult);
+
+				// Only the half layer is requested, the quarter layer is skipped until something asks for it
+				VideoInput->RequestLayerFormat(PixelCaptureBufferFormat::FORMAT_RHI, 1);
+				for (int32 Frame = 0; Frame < NumCapturedFrames; ++Frame)
+				{
+					VideoInput->OnFrame(FPixelCaptureInputFrameRHI(NoiseTexture));
+				}
+				VideoInput->GetSimulcastLayerStats(1, HalfStats);
+				VideoInput->GetSimulcastLayerStats(2, QuarterStats);
+
+				VideoInput->RequestLayerFormat(PixelCaptureBufferFormat::FORMAT_RHI, 2);
+				VideoInput->OnFrame(FPixelCaptureInputFrameRHI(NoiseTexture));
+				VideoInput->GetSimulcastLayerStats(2, QuarterWokenStats);
+			});
+			FlushRenderingCommands();
+
+			int32 MaxCheckerDifference = 0;
+			for (const FColor& Pixel : CheckerResult)
+			{
+				MaxCheckerDifference = FMath::Max(MaxCheckerDifference, MaxChannelDifference(FColor(Pixel.R, Pixel.G, Pixel.B, 255), FColor(128, 128, 128, 255)));
+			}
+			Check(CheckerResult.Num() == CheckerLayerSize.X * CheckerLayerSize.Y && MaxCheckerDifference <= 2,
+				FString::Printf(TEXT("Checkerboard downscaled to %dx%d is up to %d away from mid grey, the downscale is aliasing"), CheckerLayerSize.X, CheckerLayerSize.Y, MaxCheckerDifference));
+
+			int32 MaxNoiseDifference = NoiseResult.Num() == NoiseReference.Num() ? 0 : MAX_int32;
+			for (int32 Index = 0; Index < NoiseResult.Num() && Index < NoiseReference.Num(); ++Index)
+			{
+				MaxNoiseDifference = FMath::Max(MaxNoiseDifference, MaxChannelDifference(NoiseResult[Index], NoiseReference[Index]));
+			}
+			Check(MaxNoiseDifference <= 2, FString::Printf(TEXT("Noise downscaled to %dx%d is up to %d away from the box filter reference"), NoiseLayerSize.X, NoiseLayerSize.Y, MaxNoiseDifference));
+
+			Check(HalfStats.NumProduced == NumCapturedFrames && HalfStats.Resolution == NoiseSize / 2,
+				FString::Printf(TEXT("Requested half layer produced %llu of %d frames at %dx%d"), HalfStats.NumProduced, NumCapturedFrames, HalfStats.Resolution.X, HalfStats.Resolution.Y));
+			Check(QuarterStats.NumProduced == 0 && QuarterStats.NumSkipped == NumCapturedFrames,
+				FString::Printf(TEXT("Unrequested quarter layer produced %llu frames and skipped %llu"), QuarterStats.NumProduced, QuarterStats.NumSkipped));
+			Check(QuarterWokenStats.NumProduced == 1, FString::Printf(TEXT("Quarter layer produced %llu frames once requested, expected 1"), QuarterWokenStats.NumProduced));
+			Check(VideoInput->FindLayerForResolution(NoiseSize / 2) == 1 && VideoInput->FindLayerForResolution(NoiseSize / 4) == 2 && VideoInput->FindLayerForResolution(NoiseSize) == 0,
+				TEXT("FindLayerForResolution doesn't pick the layers matching the captured frame"));
+
+			Ar.Logf(TEXT("Simulcast verification %s: checkerboard within %d of grey, noise within %d of the box filter"),
+				NumFailures == 0 ? TEXT("passed") : TEXT("FAILED"), MaxCheckerDifference, MaxNoiseDifference);
+		}));
+#endif
+#endif
+}
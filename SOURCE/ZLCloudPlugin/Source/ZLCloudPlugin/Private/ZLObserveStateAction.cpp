@@ -0,0 +1,48 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+#include "ZLObserveStateAction.h"
+#include "ZLCloudPluginStateManager.h"
+
+UZLObserveStateAction* UZLObserveStateAction::ObserveStateChanges(UObject* WorldContextObject, FString KeyPath, bool bRequestedChanges)
+{
+	UZLObserveStateAction* Action = NewObject<UZLObserveStateAction>();
+	Action->KeyPath = KeyPath;
+	Action->bRequestedChanges = bRequestedChanges;
+	Action->RegisterWithGameInstance(WorldContextObject);
+	return Action;
+}
+
+void UZLObserveStateAction::Activate()
+{
+	const EZLStateObserverSource Source = bRequestedChanges ? EZLStateObserverSource::Requested : EZLStateObserverSource::Current;
+	ObserverId = UZLCloudPluginStateManager::GetZLCloudPluginStateManager()->ObserveState(KeyPath, Source,
+		FZLOnStatePathsChanged::CreateUObject(this, &UZLObserveStateAction::HandleChanged));
+}
+
+void UZLObserveStateAction::SetReadyToDestroy()
+{
+	// Cancelled, or the game instance is going away
+	if (ObserverId != FZLStateObservers::InvalidObserver)
+	{
+		UZLCloudPluginStateManager::GetZLCloudPluginStateManager()->RemoveStateObserver(ObserverId);
+		ObserverId = FZLStateObservers::InvalidObserver;
+	}
+
+	Super::SetReadyToDestroy();
+}
+
+bool UZLObserveStateAction::IsActive() const
+{
+	return ObserverId != FZLStateObservers::InvalidObserver;
+}
+
+void UZLObserveStateAction::HandleChanged(const TArray<FZLStateKeyPath>& Paths)
+{
+	TArray<FString> ChangedKeys;
+	ChangedKeys.Reserve(Paths.Num());
+	for (const FZLStateKeyPath& Path : Paths)
+	{
+		ChangedKeys.Add(Path.IsValid() ? Path.ToString() : FString());
+	}
+
+	OnChanged.Broadcast(ChangedKeys);
+}
@@ -0,0 +1,160 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#include "ZLPixelCaptureCapturerRHIToI420CPU.h"
+
+#if UNREAL_5_1_OR_NEWER
+
+#include "PixelCaptureBufferFormat.h"
+#include "PixelCaptureInputFrameRHI.h"
+#include "PixelCaptureOutputFrameI420.h"
+#include "PixelCaptureBufferI420.h"
+#include "Utils.h"
+#include "CloudStream2.h"
+
+#if UNREAL_5_7_OR_NEWER
+TSharedPtr<FZLPixelCaptureCapturerRHIToI420CPU> FZLPixelCaptureCapturerRHIToI420CPU::Create(FIntPoint InOutputResolution)
+{
+	TSharedPtr<FZLPixelCaptureCapturerRHIToI420CPU> Capturer = TSharedPtr<FZLPixelCaptureCapturerRHIToI420CPU>(new FZLPixelCaptureCapturerRHIToI420CPU());
+	Capturer->OutputResolution = InOutputResolution;
+	return Capturer;
+}
+#else
+TSharedPtr<FZLPixelCaptureCapturerRHIToI420CPU> FZLPixelCaptureCapturerRHIToI420CPU::Create(float InScale)
+{
+	TSharedPtr<FZLPixelCaptureCapturerRHIToI420CPU> Capturer = TSharedPtr<FZLPixelCaptureCapturerRHIToI420CPU>(new FZLPixelCaptureCapturerRHIToI420CPU());
+	Capturer->Scale = InScale;
+	return Capturer;
+}
+#endif
+
+FZLPixelCaptureCapturerRHIToI420CPU::~FZLPixelCaptureCapturerRHIToI420CPU()
+{
+	CleanUp();
+}
+
+FIntPoint FZLPixelCaptureCapturerRHIToI420CPU::GetOutputSize(int32 InputWidth, int32 InputHeight) const
+{
+#if UNREAL_5_7_OR_NEWER
+	if (OutputResolution.X > 0 && OutputResolution.Y > 0)
+	{
+		return OutputResolution;
+	}
+	return FIntPoint(InputWidth, InputHeight);
+#else
+	return FIntPoint(static_cast<int32>(InputWidth * Scale), static_cast<int32>(InputHeight * Scale));
+#endif
+}
+
+void FZLPixelCaptureCapturerRHIToI420CPU::Initialize(int32 InputWidth, int32 InputHeight)
+{
+	const FIntPoint OutputSize = GetOutputSize(InputWidth, InputHeight);
+
+	FRHITextureCreateDesc TextureDesc =
+		FRHITextureCreateDesc::Create2D(TEXT("ZLPixelCaptureCapturerRHIToI420CPU StagingTexture"), OutputSize.X, OutputSize.Y, EPixelFormat::PF_B8G8R8A8)
+		.SetClearValue(FClearValueBinding::None)
+		.SetFlags(ETextureCreateFlags::RenderTargetable)
+		.SetInitialState(ERHIAccess::CopySrc)
+		.DetermineInititialState();
+
+#if UNREAL_5_7_OR_NEWER
+	StagingTexture = RHICreateTexture(TextureDesc);
+#elif UNREAL_5_4_OR_NEWER
+	StagingTexture = GDynamicRHI->RHICreateTexture(FRHICommandListExecutor::GetImmediateCommandList(), TextureDesc);
+#else
+	StagingTexture = GDynamicRHI->RHICreateTexture(TextureDesc);
+#endif
+
+	TextureDesc
+		.SetDebugName(TEXT("ZLPixelCaptureCapturerRHIToI420CPU ReadbackTexture"))
+		.SetFlags(ETextureCreateFlags::CPUReadback)
+		.SetInitialState(ERHIAccess::CopyDest)
+		.DetermineInititialState();
+
+#if UNREAL_5_7_OR_NEWER
+	ReadbackTexture = RHICreateTexture(TextureDesc);
+#elif UNREAL_5_4_OR_NEWER
+	ReadbackTexture = GDynamicRHI->RHICreateTexture(FRHICommandListExecutor::GetImmediateCommandList(), TextureDesc);
+#else
+	ReadbackTexture = GDynamicRHI->RHICreateTexture(TextureDesc);
+#endif
+
+	// Stays mapped for the capturer's lifetime, the readback copy has landed by the time OnRHIStageComplete runs
+	int32 BufferWidth = 0;
+	int32 BufferHeight = 0;
+	GDynamicRHI->RHIMapStagingSurface(ReadbackTexture, nullptr, ResultsBuffer, BufferWidth, BufferHeight);
+	MappedStride = BufferWidth;
+
+	FPixelCaptureCapturer::Initialize(InputWidth, InputHeight);
+}
+
+IPixelCaptureOutputFrame* FZLPixelCaptureCapturerRHIToI420CPU::CreateOutputBuffer(int32 InputWidth, int32 InputHeight)
+{
+	const FIntPoint OutputSize = GetOutputSize(InputWidth, InputHeight);
+	return new FPixelCaptureOutputFrameI420(MakeShared<FPixelCaptureBufferI420>(OutputSize.X, OutputSize.Y));
+}
+
+void FZLPixelCaptureCapturerRHIToI420CPU::BeginProcess(const IPixelCaptureInputFrame& InputFrame, IPixelCaptureOutputFrame* OutputBuffer)
+{
+	checkf(InputFrame.GetType() == PixelCaptureBufferFormat::FORMAT_RHI, TEXT("Incorrect source frame coming into frame capture process."));
+
+	MarkCPUWorkStart();
+
+	FRHICommandListImmediate& RHICmdList = FRHICommandListExecutor::GetImmediateCommandList();
+	RHICmdList.EnqueueLambda([this](FRHICommandListImmediate&) { MarkGPUWorkStart(); });
+
+	const FPixelCaptureInputFrameRHI& SourceFrame = StaticCast<const FPixelCaptureInputFrameRHI&>(InputFrame);
+	ZLCloudPluginUtils::CopyTexture(RHICmdList, SourceFrame.FrameTexture, StagingTexture, nullptr);
+
+	RHICmdList.Transition(FRHITransitionInfo(StagingTexture, ERHIAccess::Unknown, ERHIAccess::CopySrc));
+	RHICmdList.Transition(FRHITransitionInfo(ReadbackTexture, ERHIAccess::Unknown, ERHIAccess::CopyDest));
+	RHICmdList.CopyTexture(StagingTexture, ReadbackTexture, {});
+
+	MarkCPUWorkEnd();
+
+	// The shared ref keeps the capturer alive until the RHI thread has run the lambda
+	RHICmdList.EnqueueLambda([this, OutputBuffer, RefHolder = AsShared()](FRHICommandListImmediate&) { OnRHIStageComplete(OutputBuffer); });
+}
+
+void FZLPixelCaptureCapturerRHIToI420CPU::OnRHIStageComplete(IPixelCaptureOutputFrame* OutputBuffer)
+{
+	MarkGPUWorkEnd();
+
+	FPixelCaptureOutputFrameI420* OutputI420Buffer = StaticCast<FPixelCaptureOutputFrameI420*>(OutputBuffer);
+	TSharedPtr<FPixelCaptureBufferI420> I420Buffer = OutputI420Buffer->GetI420Buffer();
+
+	MarkCPUWorkStart();
+
+	UpdateConverter();
+	Converter.ConvertToI420(static_cast<const uint8*>(ResultsBuffer), MappedStride * 4, I420Buffer->GetWidth(), I420Buffer->GetHeight(),
+		I420Buffer->GetMutableDataY(), I420Buffer->GetStrideY(),
+		I420Buffer->GetMutableDataU(), I420Buffer->GetStrideUV(),
+		I420Buffer->GetMutableDataV(), I420Buffer->GetStrideUV());
+
+	MarkCPUWorkEnd();
+
+	EndProcess();
+}
+
+void FZLPixelCaptureCapturerRHIToI420CPU::UpdateConverter()
+{
+	const uint32 ColorSpace = ZLCloudPlugin::CloudStream2::GetEncoderColorSpace();
+	if (ColorSpace != ConverterColorSpace)
+	{
+		// The readback texture is BGRA
+		Converter = FZLYUVConverter(FZLYUVColorSpace::FromCloudStream(ColorSpace), EZLRGBLayout::BGRA);
+		ConverterColorSpace = ColorSpace;
+	}
+}
+
+void FZLPixelCaptureCapturerRHIToI420CPU::CleanUp()
+{
+	if (ReadbackTexture && ResultsBuffer)
+	{
+		GDynamicRHI->RHIUnmapStagingSurface(ReadbackTexture);
+	}
+	ResultsBuffer = nullptr;
+	ReadbackTexture.SafeRelease();
+	StagingTexture.SafeRelease();
+}
+
+#endif
@@ -0,0 +1,57 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#pragma once
+
+#include "ZLCloudPluginVersion.h"
+#if UNREAL_5_1_OR_NEWER
+
+#include "PixelCaptureCapturer.h"
+#include "RHI.h"
+#include "ZLYUVConverter.h"
+
+/*
+ * Reads RHI frames back to the CPU and converts them to I420 with FZLYUVConverter.
+ * Stands in for the engine's CPU capturer, converting with SIMD across the task graph rather than on the RHI thread in one pass.
+ * Used when the compute shader conversion isn't available or the CPU conversion setting is on.
+ */
+class FZLPixelCaptureCapturerRHIToI420CPU : public FPixelCaptureCapturer, public TSharedFromThis<FZLPixelCaptureCapturerRHIToI420CPU>
+{
+public:
+#if UNREAL_5_7_OR_NEWER
+	static TSharedPtr<FZLPixelCaptureCapturerRHIToI420CPU> Create(FIntPoint InOutputResolution);
+#else
+	static TSharedPtr<FZLPixelCaptureCapturerRHIToI420CPU> Create(float InScale);
+#endif
+	virtual ~FZLPixelCaptureCapturerRHIToI420CPU();
+
+protected:
+	virtual FString GetCapturerName() const override { return "ZLRHIToI420CPU"; }
+	virtual void Initialize(int32 InputWidth, int32 InputHeight) override;
+	virtual IPixelCaptureOutputFrame* CreateOutputBuffer(int32 InputWidth, int32 InputHeight) override;
+	virtual void BeginProcess(const IPixelCaptureInputFrame& InputFrame, IPixelCaptureOutputFrame* OutputBuffer) override;
+
+private:
+	FZLPixelCaptureCapturerRHIToI420CPU() = default;
+
+	FIntPoint GetOutputSize(int32 InputWidth, int32 InputHeight) const;
+	void OnRHIStageComplete(IPixelCaptureOutputFrame* OutputBuffer);
+	void UpdateConverter();
+	void CleanUp();
+
+#if UNREAL_5_7_OR_NEWER
+	FIntPoint OutputResolution = FIntPoint::ZeroValue;
+#else
+	float Scale = 1.0f;
+#endif
+
+	FTextureRHIRef StagingTexture;
+	FTextureRHIRef ReadbackTexture;
+	void* ResultsBuffer = nullptr;
+	int32 MappedStride = 0;
+
+	// Built for the color space the encoder asks for, and rebuilt when that changes. Only touched on the RHI thread.
+	FZLYUVConverter Converter;
+	uint32 ConverterColorSpace = MAX_uint32;
+};
+
+#endif
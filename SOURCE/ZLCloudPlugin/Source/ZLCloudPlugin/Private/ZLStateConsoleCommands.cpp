@@ -0,0 +1,3352 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#include "ZLCloudPluginStateManager.h"
+#include "ZLStateJournal.h"
+#include "ZLStateJsonStream.h"
+#include "ZLStateKeyTrie.h"
+#include "ZLStateMemory.h"
+#include "ZLStateObservers.h"
+#include "ZLStateRecording.h"
+#include "ZLStateSchemaValidator.h"
+#include "ZLStateTree.h"
+#include "ZLStateWebSync.h"
+#include "ZLTimerWheel.h"
+#include "ZLTypedStateStore.h"
+#include "Algo/AllOf.h"
+#include "Containers/Ticker.h"
+#include "HAL/FileManager.h"
+#include "Math/RandomStream.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+#if !UE_BUILD_SHIPPING
+	// Random state trees over a small key space, so mutations regularly hit, replace and remove the same keys
+	TSharedPtr<FJsonValue> MakeRandomStateValue(FRandomStream& Random)
+	{
+		switch (Random.RandRange(0, 3))
+		{
+		case 0:
+			return MakeShared<FJsonValueString>(FString::Printf(TEXT("v%d"), Random.RandRange(0, 2)));
+		case 1:
+			return MakeShared<FJsonValueNumber>(Random.RandRange(0, 2));
+		case 2:
+			return MakeShared<FJsonValueBoolean>(Random.RandBool());
+		default:
+		{
+			TArray<TSharedPtr<FJsonValue>> Array;
+			for (int32 i = Random.RandRange(0, 2); i > 0; --i)
+			{
+				Array.Add(MakeShared<FJsonValueNumber>(Random.RandRange(0, 1)));
+			}
+			return MakeShared<FJsonValueArray>(Array);
+		}
+		}
+	}
+
+	FString MakeRandomStateKey(FRandomStream& Random)
+	{
+		FString Key;
+		for (int32 Depth = Random.RandRange(1, 3); Depth > 0; --Depth)
+		{
+			Key += FString::Printf(Key.IsEmpty() ? TEXT("k%d") : TEXT(".k%d"), Random.RandRange(0, 2));
+		}
+		return Key;
+	}
+
+	// Sets Key in Root, replacing any leaf that is in the way of the path with an object
+	void SetRandomStateKey(const TSharedPtr<FJsonObject>& Root, const FZLStateKeyPath& Key, const TSharedPtr<FJsonValue>& Value)
+	{
+		TSharedPtr<FJsonObject> Object = Root;
+		const TArray<FZLStateKeyPath::FSegment>& Segments = Key.GetSegments();
+		for (int32 i = 0; i < Segments.Num() - 1; ++i)
+		{
+			const TSharedPtr<FJsonObject>* Child = nullptr;
+			if (!Object->TryGetObjectField(Segments[i].Name, Child))
+			{
+				TSharedPtr<FJsonObject> NewChild = MakeShared<FJsonObject>();
+				Object->SetObjectField(Segments[i].Name, NewChild);
+				Object = NewChild;
+			}
+			else
+			{
+				Object = *Child;
+			}
+		}
+		Object->SetField(Key.GetLeaf().Name, Value);
+	}
+
+	void CollectDiffLeafPaths(const TSharedPtr<FJsonObject>& Diff, const FString& Prefix, TSet<FString>& OutPaths)
+	{
+		for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : Diff->Values)
+		{
+			const FString Path = Prefix.IsEmpty() ? Pair.Key : Prefix + TEXT(".") + Pair.Key;
+			if (Pair.Value->Type == EJson::Object && Pair.Value->AsObject()->Values.Num() > 0)
+			{
+				CollectDiffLeafPaths(Pair.Value->AsObject(), Path, OutPaths);
+			}
+			else
+			{
+				OutPaths.Add(Path);
+			}
+		}
+	}
+
+	// Checks the incremental tree bookkeeping against a full CreateDiffJsonObject/CountLeavesInJsonObject/deep comparison after every random mutation
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GVerifyStateTreeCommand(
+		TEXT("ZLCloudPlugin.State.VerifyTree"),
+		TEXT("Fuzzes the versioned state tree, match tracker and cached hashes against the full state diff. Usage: ZLCloudPlugin.State.VerifyTree [Iterations] [Seed]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const int32 Iterations = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000;
+			FRandomStream Random(Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 1);
+			UZLCloudPluginStateManager* StateManager = UZLCloudPluginStateManager::GetZLCloudPluginStateManager();
+
+			int32 NumFailures = 0;
+			for (int32 Iteration = 0; Iteration < Iterations && NumFailures < 10; ++Iteration)
+			{
+				TSharedPtr<FJsonObject> Current = MakeShared<FJsonObject>();
+				TSharedPtr<FJsonObject> Target = MakeShared<FJsonObject>();
+				for (int32 i = Random.RandRange(0, 6); i > 0; --i)
+				{
+					SetRandomStateKey(Current, FZLStateKeyPath::Intern(MakeRandomStateKey(Random)), MakeRandomStateValue(Random));
+				}
+				for (int32 i = Random.RandRange(1, 4); i > 0; --i)
+				{
+					SetRandomStateKey(Target, FZLStateKeyPath::Intern(MakeRandomStateKey(Random)), MakeRandomStateValue(Random));
+				}
+
+				FZLStateTree Tree;
+				Tree.Reset(Current);
+				FZLStateMatchTracker Tracker;
+				Tracker.SetTarget(Target);
+
+				for (int32 Step = 0; Step < 16; ++Step)
+				{
+					const FZLStateKeyPath Key = FZLStateKeyPath::Intern(MakeRandomStateKey(Random));
+					if (Random.RandBool())
+					{
+						SetRandomStateKey(Current, Key, MakeRandomStateValue(Random));
+					}
+					else
+					{
+						TSharedPtr<FJsonObject> Parent = FZLStateKeyPathCache::WalkToParent(Current, Key);
+						if (Parent.IsValid())
+						{
+							Parent->RemoveField(Key.GetLeaf().Name);
+						}
+					}
+					Tree.MarkChanged(Key);
+
+					TSet<FString> ExpectedUnmatched;
+					CollectDiffLeafPaths(CreateDiffJsonObject(Current, Target), FString(), ExpectedUnmatched);
+
+					const bool bMatched = Tracker.Update(Tree);
+					const TSet<FString> Unmatched(Tracker.GetUnmatchedKeys());
+					const int32 ExpectedLeafCount = StateManager->CountLeavesInJsonObject(Current);
+
+					// Cached hashes must match a fresh hash, and agree with a deep comparison for the whole tree and the changed key
+					const TSharedPtr<FJsonValue> CurrentValue = MakeShared<FJsonValueObject>(Current);
+					const TSharedPtr<FJsonValue> TargetValue = MakeShared<FJsonValueObject>(Target);
+					bool bHashesAgree = Tree.GetHash() == GetJsonValueHash64(CurrentValue)
+						&& (Tree.GetHash() == GetJsonValueHash64(TargetValue)) == CompareJsonValuesCaseSensitive(CurrentValue, TargetValue);
+
+					uint64 KeyHash = 0;
+					if (Tree.GetHash(Key, KeyHash))
+					{
+						const TSharedPtr<FJsonObject> CurrentParent = FZLStateKeyPathCache::WalkToParent(Current, Key);
+						const TSharedPtr<FJsonObject> TargetParent = FZLStateKeyPathCache::WalkToParent(Target, Key);
+						const TSharedPtr<FJsonValue>* CurrentKeyValue = CurrentParent.IsValid() ? FZLStateKeyPathCache::FindSegment(*CurrentParent, Key.GetLeaf()) : nullptr;
+						const TSharedPtr<FJsonValue>* TargetKeyValue = TargetParent.IsValid() ? FZLStateKeyPathCache::FindSegment(*TargetParent, Key.GetLeaf()) : nullptr;
+
+						bHashesAgree &= CurrentKeyValue && KeyHash == GetJsonValueHash64(*CurrentKeyValue);
+						if (CurrentKeyValue && TargetKeyValue)
+						{
+							bHashesAgree &= (KeyHash == GetJsonValueHash64(*TargetKeyValue)) == CompareJsonValuesCaseSensitive(*CurrentKeyValue, *TargetKeyValue);
+						}
+					}
+
+					if (bMatched != (ExpectedUnmatched.Num() == 0) || Unmatched.Num() != ExpectedUnmatched.Num() || Unmatched.Difference(ExpectedUnmatched).Num() > 0 || Tree.GetLeafCount() != ExpectedLeafCount || !bHashesAgree)
+					{
+						Ar.Logf(ELogVerbosity::Error, TEXT("State tree mismatch at iteration %d step %d after %s: unmatched %d (expected %d), leaves %d (expected %d), hashes %s"),
+							Iteration, Step, *Key.ToString(), Unmatched.Num(), ExpectedUnmatched.Num(), Tree.GetLeafCount(), ExpectedLeafCount, bHashesAgree ? TEXT("agree") : TEXT("disagree"));
+						++NumFailures;
+						break;
+					}
+				}
+			}
+
+			Ar.Logf(TEXT("State tree verification %s (%d iterations)"), NumFailures == 0 ? TEXT("passed") : TEXT("FAILED"), Iterations);
+		}));
+
+	// Builds the same keys in two different orders, incrementally and from scratch, and checks every fingerprint agrees and ignores the excluded keys
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GVerifyStateFingerprintCommand(
+		TEXT("ZLCloudPlugin.State.VerifyFingerprint"),
+		TEXT("Checks the state fingerprint is stable across key insertion orders and ignores excluded keys. Usage: ZLCloudPlugin.State.VerifyFingerprint [Iterations] [Seed]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const int32 Iterations = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000;
+			FRandomStream Random(Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 1);
+
+			int32 NumFailures = 0;
+			for (int32 Iteration = 0; Iteration < Iterations && NumFailures < 10; ++Iteration)
+			{
+				// Fixed depth keys so no key is a parent of another and the final state doesn't depend on order
+				TArray<FZLStateKeyPath> Keys;
+				TArray<TSharedPtr<FJsonValue>> Values;
+				for (int32 i = Random.RandRange(1, 12); i > 0; --i)
+				{
+					const FZLStateKeyPath Key = FZLStateKeyPath::Intern(FString::Printf(TEXT("g%d.k%d"), Random.RandRange(0, 3), Random.RandRange(0, 3)));
+					if (!Keys.Contains(Key))
+					{
+						Keys.Add(Key);
+						Values.Add(MakeRandomStateValue(Random));
+					}
+				}
+
+				TArray<FZLStateKeyPath> Exclusions;
+				for (const FZLStateKeyPath& Key : Keys)
+				{
+					if (Random.RandRange(0, 3) == 0)
+					{
+						Exclusions.Add(Key);
+					}
+				}
+				if (Random.RandBool())
+				{
+					Exclusions.Add(FZLStateKeyPath::Intern(FString::Printf(TEXT("g%d"), Random.RandRange(0, 3))));
+				}
+
+				TArray<int32> Order;
+				for (int32 i = 0; i < Keys.Num(); ++i)
+				{
+					Order.Add(i);
+				}
+				for (int32 i = Order.Num() - 1; i > 0; --i)
+				{
+					Order.Swap(i, Random.RandRange(0, i));
+				}
+
+				TSharedPtr<FJsonObject> StateA = MakeShared<FJsonObject>();
+				TSharedPtr<FJsonObject> StateB = MakeShared<FJsonObject>();
+				FZLStateTree TreeA, TreeB, TreeFresh, TreeUnfiltered;
+				TreeA.Reset(StateA);
+				TreeB.Reset(StateB);
+				TreeA.SetFingerprintExclusions(Exclusions);
+				TreeB.SetFingerprintExclusions(Exclusions);
+				TreeFresh.SetFingerprintExclusions(Exclusions);
+
+				for (int32 i = 0; i < Keys.Num(); ++i)
+				{
+					SetRandomStateKey(StateA, Keys[i], Values[i]);
+					TreeA.MarkChanged(Keys[i]);
+					// Read the fingerprint mid build so the cached parts are exercised
+					TreeA.GetFingerprint();
+
+					SetRandomStateKey(StateB, Keys[Order[i]], Values[Order[i]]);
+					TreeB.MarkChanged(Keys[Order[i]]);
+				}
+
+				TreeFresh.Reset(StateB);
+				TreeUnfiltered.Reset(StateA);
+
+				const uint64 Fingerprint = TreeA.GetFingerprint();
+				bool bPassed = Fingerprint == TreeB.GetFingerprint() && Fingerprint == TreeFresh.GetFingerprint() && TreeUnfiltered.GetFingerprint() == TreeUnfiltered.GetHash();
+
+				// Changing an excluded key must not move the fingerprint, changing any other key must
+				const int32 ChangedIndex = Random.RandRange(0, Keys.Num() - 1);
+				const TSharedPtr<FJsonValue> ChangedValue = MakeShared<FJsonValueString>(TEXT("Changed"));
+				SetRandomStateKey(StateA, Keys[ChangedIndex], ChangedValue);
+				TreeA.MarkChanged(Keys[ChangedIndex]);
+
+				bool bExcluded = false;
+				for (const FZLStateKeyPath& Exclusion : Exclusions)
+				{
+					bExcluded |= Exclusion == Keys[ChangedIndex] || Keys[ChangedIndex].ToString().StartsWith(Exclusion.ToString() + TEXT("."));
+				}
+				const bool bValueChanged = !CompareJsonValuesCaseSensitive(Values[ChangedIndex], ChangedValue);
+				bPassed &= (TreeA.GetFingerprint() == Fingerprint) == (bExcluded || !bValueChanged);
+
+				if (!bPassed)
+				{
+					Ar.Logf(ELogVerbosity::Error, TEXT("State fingerprint mismatch at iteration %d (%d keys, %d exclusions, changed %s)"), Iteration, Keys.Num(), Exclusions.Num(), *Keys[ChangedIndex].ToString());
+					++NumFailures;
+				}
+			}
+
+			Ar.Logf(TEXT("State fingerprint verification %s (%d iterations)"), NumFailures == 0 ? TEXT("passed") : TEXT("FAILED"), Iterations);
+		}));
+
+	// Configurator sized state, Groups x Options leaves split over two levels
+	TSharedPtr<FJsonObject> MakeBenchmarkState(int32 NumLeaves)
+	{
+		TSharedPtr<FJsonObject> State = MakeShared<FJsonObject>();
+		const int32 NumGroups = FMath::Max(1, (int32)FMath::Sqrt((float)NumLeaves));
+		for (int32 Leaf = 0; Leaf < NumLeaves; ++Leaf)
+		{
+			const FString GroupName = FString::Printf(TEXT("Group%d"), Leaf % NumGroups);
+			const TSharedPtr<FJsonObject>* Group = nullptr;
+			if (!State->TryGetObjectField(GroupName, Group))
+			{
+				State->SetObjectField(GroupName, MakeShared<FJsonObject>());
+				State->TryGetObjectField(GroupName, Group);
+			}
+			(*Group)->SetStringField(FString::Printf(TEXT("Option%d"), Leaf / NumGroups), FString::Printf(TEXT("Value%d"), Leaf));
+		}
+		return State;
+	}
+
+	// Times the materialized diff + CountLeavesInJsonObject path ProcessState used to take against the fused single pass
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GBenchmarkStateDiffCommand(
+		TEXT("ZLCloudPlugin.State.BenchmarkDiff"),
+		TEXT("Times state diffing on a synthetic state. Usage: ZLCloudPlugin.State.BenchmarkDiff [Leaves] [ChangedLeaves] [Runs]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const int32 NumLeaves = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 10000;
+			const int32 NumChanged = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 10;
+			const int32 NumRuns = FMath::Max(1, Args.Num() > 2 ? FCString::Atoi(*Args[2]) : 20);
+			UZLCloudPluginStateManager* StateManager = UZLCloudPluginStateManager::GetZLCloudPluginStateManager();
+
+			TSharedPtr<FJsonObject> Current = MakeBenchmarkState(NumLeaves);
+			TSharedPtr<FJsonObject> Processing = MakeShared<FJsonObject>();
+			TSharedPtr<FJsonObject> Request = MakeBenchmarkState(NumLeaves);
+			int32 NumToChange = NumChanged;
+			for (const TPair<FString, TSharedPtr<FJsonValue>>& Group : Request->Values)
+			{
+				if (NumToChange-- <= 0)
+				{
+					break;
+				}
+				Group.Value->AsObject()->SetStringField(TEXT("Option0"), TEXT("Changed"));
+			}
+
+			const TSharedPtr<FJsonObject> Comparisons[] = { Current, Processing };
+
+			int32 OldLeafCount = 0;
+			double StartTime = FPlatformTime::Seconds();
+			for (int32 Run = 0; Run < NumRuns; ++Run)
+			{
+				TSharedPtr<FJsonObject> Diff = CreateDiffJsonObject(Processing, CreateDiffJsonObject(Current, Request));
+				OldLeafCount = StateManager->CountLeavesInJsonObject(Diff);
+			}
+			const double OldDiffMs = (FPlatformTime::Seconds() - StartTime) * 1000.0 / NumRuns;
+
+			int32 FusedLeafCount = 0;
+			StartTime = FPlatformTime::Seconds();
+			for (int32 Run = 0; Run < NumRuns; ++Run)
+			{
+				CreateDiffJsonObject(Comparisons, Request, &FusedLeafCount);
+			}
+			const double FusedDiffMs = (FPlatformTime::Seconds() - StartTime) * 1000.0 / NumRuns;
+
+			bool bOldMatches = false;
+			StartTime = FPlatformTime::Seconds();
+			for (int32 Run = 0; Run < NumRuns; ++Run)
+			{
+				bOldMatches = CreateDiffJsonObject(Current, Request)->Values.Num() == 0;
+			}
+			const double OldEqualMs = (FPlatformTime::Seconds() - StartTime) * 1000.0 / NumRuns;
+
+			bool bMatches = false;
+			StartTime = FPlatformTime::Seconds();
+			for (int32 Run = 0; Run < NumRuns; ++Run)
+			{
+				bMatches = !HasJsonDiff(Current, Request);
+			}
+			const double EqualMs = (FPlatformTime::Seconds() - StartTime) * 1000.0 / NumRuns;
+
+			Ar.Logf(TEXT("State diff benchmark, %d leaves, %d runs"), StateManager->CountLeavesInJsonObject(Current), NumRuns);
+			Ar.Logf(TEXT("  Diff + count: %.3fms (%d leaves), fused: %.3fms (%d leaves)"), OldDiffMs, OldLeafCount, FusedDiffMs, FusedLeafCount);
+			Ar.Logf(TEXT("  Equality via diff: %.3fms, short circuit: %.3fms"), OldEqualMs, EqualMs);
+			if (OldLeafCount != FusedLeafCount || bOldMatches != bMatches)
+			{
+				Ar.Logf(ELogVerbosity::Error, TEXT("  Fused diff disagrees with the materialized diff"));
+			}
+		}));
+
+	// The nested loop, serialize-to-compare array merge MergeJsonObjectsRecursive used before hashing, kept as the reference result
+	TArray<TSharedPtr<FJsonValue>> MergeArraysBySerializing(const TArray<TSharedPtr<FJsonValue>>& Array1, const TArray<TSharedPtr<FJsonValue>>& Array2)
+	{
+		auto Serialize = [](const TSharedPtr<FJsonValue>& Value)
+		{
+			FString String;
+			TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&String);
+			FJsonSerializer::Serialize(Value.ToSharedRef(), "", Writer);
+			Writer->Close();
+			return String;
+		};
+
+		TArray<TSharedPtr<FJsonValue>> MergedArray = Array1;
+		for (const TSharedPtr<FJsonValue>& Item2 : Array2)
+		{
+			bool bIsDuplicate = false;
+			for (const TSharedPtr<FJsonValue>& Item1 : MergedArray)
+			{
+				if (Item1->Type == Item2->Type && Serialize(Item1) == Serialize(Item2))
+				{
+					bIsDuplicate = true;
+					break;
+				}
+			}
+
+			if (!bIsDuplicate)
+			{
+				MergedArray.Add(Item2);
+			}
+		}
+		return MergedArray;
+	}
+
+	// Option list style array with roughly one duplicate per two items, mixing strings, numbers and small objects
+	TArray<TSharedPtr<FJsonValue>> MakeBenchmarkOptionList(FRandomStream& Random, int32 NumItems)
+	{
+		TArray<TSharedPtr<FJsonValue>> Items;
+		for (int32 i = 0; i < NumItems; ++i)
+		{
+			const int32 Option = Random.RandRange(0, NumItems / 2);
+			switch (Option % 3)
+			{
+			case 0:
+				Items.Add(MakeShared<FJsonValueString>(FString::Printf(TEXT("Option%d"), Option)));
+				break;
+			case 1:
+				Items.Add(MakeShared<FJsonValueNumber>(Option));
+				break;
+			default:
+			{
+				TSharedPtr<FJsonObject> Object = MakeShared<FJsonObject>();
+				Object->SetNumberField(TEXT("Id"), Option);
+				Object->SetStringField(TEXT("Name"), FString::Printf(TEXT("Option%d"), Option));
+				Items.Add(MakeShared<FJsonValueObject>(Object));
+				break;
+			}
+			}
+		}
+		return Items;
+	}
+
+	// Checks MergeJsonObjectsRecursive keeps the same items in the same order as the serializing merge, and times both
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GBenchmarkStateMergeCommand(
+		TEXT("ZLCloudPlugin.State.BenchmarkMerge"),
+		TEXT("Verifies and times array merging in MergeJsonObjectsRecursive. Usage: ZLCloudPlugin.State.BenchmarkMerge [Items] [Runs] [Seed]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const int32 NumItems = FMath::Max(1, Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 500);
+			const int32 NumRuns = FMath::Max(1, Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 10);
+			FRandomStream Random(Args.Num() > 2 ? FCString::Atoi(*Args[2]) : 1);
+
+			double SerializingSeconds = 0.0;
+			double HashedSeconds = 0.0;
+			int32 NumMismatches = 0;
+
+			for (int32 Run = 0; Run < NumRuns; ++Run)
+			{
+				TSharedPtr<FJsonObject> Object1 = MakeShared<FJsonObject>();
+				TSharedPtr<FJsonObject> Object2 = MakeShared<FJsonObject>();
+				Object1->SetArrayField(TEXT("Options"), MakeBenchmarkOptionList(Random, NumItems));
+				Object2->SetArrayField(TEXT("Options"), MakeBenchmarkOptionList(Random, NumItems));
+
+				double StartTime = FPlatformTime::Seconds();
+				const TArray<TSharedPtr<FJsonValue>> Expected = MergeArraysBySerializing(Object1->GetArrayField(TEXT("Options")), Object2->GetArrayField(TEXT("Options")));
+				SerializingSeconds += FPlatformTime::Seconds() - StartTime;
+
+				StartTime = FPlatformTime::Seconds();
+				const TSharedPtr<FJsonObject> Merged = MergeJsonObjectsRecursive(Object1, Object2);
+				HashedSeconds += FPlatformTime::Seconds() - StartTime;
+
+				const TArray<TSharedPtr<FJsonValue>>& Actual = Merged->GetArrayField(TEXT("Options"));
+				bool bMatches = Actual.Num() == Expected.Num();
+				for (int32 i = 0; bMatches && i < Actual.Num(); ++i)
+				{
+					bMatches = AreJsonValuesStructurallyEqual(Actual[i], Expected[i]);
+				}
+
+				if (!bMatches)
+				{
+					Ar.Logf(ELogVerbosity::Error, TEXT("Merged array differs from the reference merge in run %d (%d items, expected %d)"), Run, Actual.Num(), Expected.Num());
+					++NumMismatches;
+				}
+			}
+
+			Ar.Logf(TEXT("Array merge benchmark, 2 x %d items, %d runs: serializing %.3fms, hashed %.3fms, %s"), NumItems, NumRuns,
+				SerializingSeconds * 1000.0 / NumRuns, HashedSeconds * 1000.0 / NumRuns, NumMismatches == 0 ? TEXT("order preserved") : TEXT("FAILED"));
+		}));
+
+	// Initial state of roughly TargetBytes once serialized, sections of groups holding every leaf type an app state uses
+	TSharedPtr<FJsonObject> MakeBenchmarkInitialState(int32 Seed, int32 TargetBytes, TArray<FString>& OutLeafPaths)
+	{
+		FRandomStream Random(Seed);
+		TSharedPtr<FJsonObject> State = MakeShared<FJsonObject>();
+		const int32 NumLeaves = FMath::Max(1, TargetBytes / 40);
+		const int32 NumGroups = FMath::Max(1, (int32)FMath::Sqrt((float)NumLeaves) / 2);
+
+		for (int32 Leaf = 0; Leaf < NumLeaves; ++Leaf)
+		{
+			const int32 GroupIndex = Leaf % NumGroups;
+			const FString SectionName = FString::Printf(TEXT("Section%d"), GroupIndex % 16);
+			const FString GroupName = FString::Printf(TEXT("Group%d"), GroupIndex);
+			const FString LeafName = FString::Printf(TEXT("Option%d"), Leaf / NumGroups);
+
+			TSharedPtr<FJsonObject> Object = State;
+			for (const FString& Name : { SectionName, GroupName })
+			{
+				const TSharedPtr<FJsonObject>* Child = nullptr;
+				if (!Object->TryGetObjectField(Name, Child))
+				{
+					TSharedPtr<FJsonObject> NewChild = MakeShared<FJsonObject>();
+					Object->SetObjectField(Name, NewChild);
+					Object = NewChild;
+				}
+				else
+				{
+					Object = *Child;
+				}
+			}
+
+			switch (Leaf % 5)
+			{
+			case 0:
+				Object->SetStringField(LeafName, FString::Printf(TEXT("Value%d"), Random.RandRange(0, 1000)));
+				break;
+			case 1:
+				// Escapes and non-ASCII text, which take the slow string path
+				Object->SetStringField(LeafName, FString::Printf(TEXT("\"Trim\" %d\tM\u00e9tal \u8272"), Random.RandRange(0, 1000)));
+				break;
+			case 2:
+				Object->SetNumberField(LeafName, Random.FRandRange(-1000.0f, 1000.0f));
+				break;
+			case 3:
+				Object->SetBoolField(LeafName, Random.RandBool());
+				break;
+			default:
+				Object->SetArrayField(LeafName, MakeBenchmarkOptionList(Random, 4));
+				break;
+			}
+			OutLeafPaths.Add(SectionName + TEXT(".") + GroupName + TEXT(".") + LeafName);
+		}
+		return State;
+	}
+
+	// Times the connect state merge as it was (payload DOM + MergeJsonObjectsRecursive) against streaming the payload into a
+	// copy of the default, and checks both give the same state and the reported keys cover everything that changed
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GBenchmarkStreamMergeCommand(
+		TEXT("ZLCloudPlugin.State.BenchmarkStreamMerge"),
+		TEXT("Verifies and times streaming an initial state payload into the default state. Usage: ZLCloudPlugin.State.BenchmarkStreamMerge [SizeMB] [Runs] [Seed]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const float SizeMB = FMath::Max(0.01f, Args.Num() > 0 ? FCString::Atof(*Args[0]) : 4.0f);
+			const int32 NumRuns = FMath::Max(1, Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 5);
+			const int32 Seed = Args.Num() > 2 ? FCString::Atoi(*Args[2]) : 1;
+			const int32 TargetBytes = (int32)(SizeMB * 1024.0f * 1024.0f);
+
+			// The payload is the whole state again, as a page reconnecting sends it, with some leaves changed and some added
+			TArray<FString> LeafPaths;
+			const TSharedPtr<FJsonObject> Default = MakeBenchmarkInitialState(Seed, TargetBytes, LeafPaths);
+			TArray<FString> UnusedPaths;
+			const TSharedPtr<FJsonObject> Override = MakeBenchmarkInitialState(Seed, TargetBytes, UnusedPaths);
+
+			FRandomStream Random(Seed);
+			for (int32 i = FMath::Max(1, LeafPaths.Num() / 100); i > 0; --i)
+			{
+				SetRandomStateKey(Override, FZLStateKeyPath::Intern(LeafPaths[Random.RandRange(0, LeafPaths.Num() - 1)]), MakeShared<FJsonValueString>(FString::Printf(TEXT("Changed%d"), i)));
+				SetRandomStateKey(Override, FZLStateKeyPath::Intern(FString::Printf(TEXT("Added%d.Group%d.Option"), i % 7, i)), MakeShared<FJsonValueNumber>(i));
+			}
+
+			FString OverrideJson;
+			TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> JsonWriter = TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&OverrideJson);
+			FJsonSerializer::Serialize(Override.ToSharedRef(), JsonWriter);
+			JsonWriter->Close();
+			const FTCHARToUTF8 OverrideUtf8(*OverrideJson, OverrideJson.Len());
+			const FUtf8StringView OverrideUtf8View((const UTF8CHAR*)OverrideUtf8.Get(), OverrideUtf8.Length());
+
+			TSharedPtr<FJsonObject> DomMerged;
+			double StartTime = FPlatformTime::Seconds();
+			for (int32 Run = 0; Run < NumRuns; ++Run)
+			{
+				TSharedPtr<FJsonObject> Parsed;
+				TSharedRef<TJsonReader<>> JsonReader = TJsonReaderFactory<>::Create(OverrideJson);
+				FJsonSerializer::Deserialize(JsonReader, Parsed);
+				DomMerged = MergeJsonObjectsRecursive(Default, Parsed);
+			}
+			const double DomMs = (FPlatformTime::Seconds() - StartTime) * 1000.0 / NumRuns;
+
+			TSharedPtr<FJsonObject> Utf8Merged;
+			TArray<FString> ReportedKeys;
+			bool bStreamParsed = true;
+			StartTime = FPlatformTime::Seconds();
+			for (int32 Run = 0; Run < NumRuns; ++Run)
+			{
+				ReportedKeys.Reset();
+				Utf8Merged = CopyJsonObjectStructure(Default);
+				bStreamParsed &= MergeJsonIntoObject(OverrideUtf8View, Utf8Merged, [&ReportedKeys](const FString& KeyPath) { ReportedKeys.Add(KeyPath); });
+			}
+			const double Utf8Ms = (FPlatformTime::Seconds() - StartTime) * 1000.0 / NumRuns;
+
+			TSharedPtr<FJsonObject> StringMerged;
+			StartTime = FPlatformTime::Seconds();
+			for (int32 Run = 0; Run < NumRuns; ++Run)
+			{
+				StringMerged = CopyJsonObjectStructure(Default);
+				bStreamParsed &= MergeJsonIntoObject(OverrideJson, StringMerged);
+			}
+			const double StringMs = (FPlatformTime::Seconds() - StartTime) * 1000.0 / NumRuns;
+
+			// State requests are parsed on their own rather than merged, times that read against the DOM parse it replaced
+			TSharedPtr<FJsonObject> DomParsed;
+			StartTime = FPlatformTime::Seconds();
+			for (int32 Run = 0; Run < NumRuns; ++Run)
+			{
+				TSharedRef<TJsonReader<>> JsonReader = TJsonReaderFactory<>::Create(OverrideJson);
+				FJsonSerializer::Deserialize(JsonReader, DomParsed);
+			}
+			const double DomParseMs = (FPlatformTime::Seconds() - StartTime) * 1000.0 / NumRuns;
+
+			TSharedPtr<FJsonObject> StreamParsed;
+			StartTime = FPlatformTime::Seconds();
+			for (int32 Run = 0; Run < NumRuns; ++Run)
+			{
+				bStreamParsed &= ParseJsonObject(OverrideJson, StreamParsed);
+			}
+			const double StreamParseMs = (FPlatformTime::Seconds() - StartTime) * 1000.0 / NumRuns;
+
+			int32 NumFailures = 0;
+			if (!StreamParsed.IsValid() || GetJsonValueHash64(MakeShared<FJsonValueObject>(StreamParsed)) != GetJsonValueHash64(MakeShared<FJsonValueObject>(DomParsed)))
+			{
+				Ar.Logf(ELogVerbosity::Error, TEXT("Streamed parse differs from the DOM parse"));
+				++NumFailures;
+			}
+
+			// A parse keeps repeated array items and the last of a repeated key, where a merge would fold them
+			TSharedPtr<FJsonObject> Repeated;
+			const TArray<TSharedPtr<FJsonValue>>* RepeatedItems = nullptr;
+			if (!ParseJsonObject(TEXT("{\"List\":[1,1,2],\"Key\":1,\"Key\":2}"), Repeated) || !Repeated->TryGetArrayField(TEXT("List"), RepeatedItems)
+				|| RepeatedItems->Num() != 3 || Repeated->GetNumberField(TEXT("Key")) != 2.0)
+			{
+				Ar.Logf(ELogVerbosity::Error, TEXT("Streamed parse of repeated items doesn't match FJsonSerializer"));
+				++NumFailures;
+			}
+			const uint64 ExpectedHash = GetJsonValueHash64(MakeShared<FJsonValueObject>(DomMerged));
+			if (!bStreamParsed || GetJsonValueHash64(MakeShared<FJsonValueObject>(Utf8Merged)) != ExpectedHash || GetJsonValueHash64(MakeShared<FJsonValueObject>(StringMerged)) != ExpectedHash)
+			{
+				Ar.Logf(ELogVerbosity::Error, TEXT("Streamed merge differs from the DOM merge"));
+				++NumFailures;
+			}
+
+			// Every reported key must lead to a change, and every change must sit at or under a reported key
+			TSet<FString> DiffLeaves;
+			CollectDiffLeafPaths(CreateDiffJsonObject(Default, DomMerged), FString(), DiffLeaves);
+			TSet<FString> DiffPrefixes;
+			for (const FString& Leaf : DiffLeaves)
+			{
+				DiffPrefixes.Add(Leaf);
+				for (int32 Index = Leaf.Find(TEXT(".")); Index != INDEX_NONE; Index = Leaf.Find(TEXT("."), ESearchCase::CaseSensitive, ESearchDir::FromStart, Index + 1))
+				{
+					DiffPrefixes.Add(Leaf.Left(Index));
+				}
+			}
+
+			const TSet<FString> Reported(ReportedKeys);
+			for (const FString& Key : Reported)
+			{
+				if (!DiffPrefixes.Contains(Key))
+				{
+					Ar.Logf(ELogVerbosity::Error, TEXT("Reported %s, which didn't change"), *Key);
+					++NumFailures;
+				}
+			}
+			for (const FString& Leaf : DiffLeaves)
+			{
+				bool bCovered = Reported.Contains(Leaf);
+				for (int32 Index = Leaf.Find(TEXT(".")); !bCovered && Index != INDEX_NONE; Index = Leaf.Find(TEXT("."), ESearchCase::CaseSensitive, ESearchDir::FromStart, Index + 1))
+				{
+					bCovered = Reported.Contains(Leaf.Left(Index));
+				}
+				if (!bCovered)
+				{
+					Ar.Logf(ELogVerbosity::Error, TEXT("Change to %s wasn't reported"), *Leaf);
+					++NumFailures;
+				}
+			}
+
+			Ar.Logf(TEXT("Stream merge benchmark, %.2fMB payload, %d leaves, %d runs"), OverrideUtf8.Length() / (1024.0 * 1024.0), LeafPaths.Num(), NumRuns);
+			Ar.Logf(TEXT("  DOM + merge: %.3fms, streamed UTF-8: %.3fms, streamed FString: %.3fms"), DomMs, Utf8Ms, StringMs);
+			Ar.Logf(TEXT("  DOM parse: %.3fms, streamed parse: %.3fms"), DomParseMs, StreamParseMs);
+			Ar.Logf(TEXT("  %d keys reported for %d changed leaves, %s"), Reported.Num(), DiffLeaves.Num(), NumFailures == 0 ? TEXT("passed") : TEXT("FAILED"));
+		}));
+
+	// Times typed reads of schema keys against the JSON lookups they replace, and checks the store keeps up with writes made to the JSON
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GBenchmarkTypedStoreCommand(
+		TEXT("ZLCloudPlugin.State.BenchmarkTypedStore"),
+		TEXT("Verifies and times the schema typed state store. Usage: ZLCloudPlugin.State.BenchmarkTypedStore [Keys] [Reads] [Seed]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const int32 NumKeys = FMath::Max(5, Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000);
+			const int32 NumReads = FMath::Max(1, Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 100000);
+			FRandomStream Random(Args.Num() > 2 ? FCString::Atoi(*Args[2]) : 1);
+
+			// Number, bool, free string, limited string and number array keys in turn, two levels deep
+			static const TCHAR* const DataTypes[] = { TEXT("Number"), TEXT("Bool"), TEXT("String"), TEXT("String"), TEXT("NumberArray") };
+			UStateKeyInfoAsset* Schema = NewObject<UStateKeyInfoAsset>();
+			TArray<FString> KeyNames;
+			TArray<FZLStateKeyPath> Keys;
+			for (int32 i = 0; i < NumKeys; ++i)
+			{
+				const FString& Key = KeyNames.Add_GetRef(FString::Printf(TEXT("Group%d.Key%d"), i % 32, i));
+				FStateKeyInfo& Info = Schema->KeyInfos.Add(Key);
+				Info.DataType = DataTypes[i % 5];
+				if (i % 5 == 3)
+				{
+					Info.bLimitValues = true;
+					Info.AcceptedStringValues = { TEXT("Red"), TEXT("Green"), TEXT("Blue") };
+				}
+				Keys.Add(FZLStateKeyPath::Intern(Key));
+			}
+
+			auto MakeValue = [&Random](int32 Kind) -> TSharedPtr<FJsonValue>
+			{
+				// Purple is outside the limited key's accepted values, so it stays in the JSON
+				static const TCHAR* const Colours[] = { TEXT("Red"), TEXT("Green"), TEXT("Blue"), TEXT("Purple") };
+				switch (Kind)
+				{
+				case 0:
+					return MakeShared<FJsonValueNumber>(Random.RandRange(0, 100));
+				case 1:
+					return MakeShared<FJsonValueBoolean>(Random.RandBool());
+				case 2:
+					return MakeShared<FJsonValueString>(FString::Printf(TEXT("Value%d"), Random.RandRange(0, 100)));
+				case 3:
+					return MakeShared<FJsonValueString>(Colours[Random.RandRange(0, 3)]);
+				default:
+				{
+					TArray<TSharedPtr<FJsonValue>> Items;
+					for (int32 i = Random.RandRange(0, 3); i > 0; --i)
+					{
+						Items.Add(MakeShared<FJsonValueNumber>(Random.RandRange(0, 100)));
+					}
+					return MakeShared<FJsonValueArray>(Items);
+				}
+				}
+			};
+
+			TSharedPtr<FJsonObject> State = MakeShared<FJsonObject>();
+			for (int32 i = 0; i < NumKeys; ++i)
+			{
+				SetRandomStateKey(State, Keys[i], MakeValue(i % 5));
+			}
+			FZLStateTree Tree;
+			Tree.Reset(State);
+
+			FZLTypedStateStore Store;
+			Store.Build(Schema);
+			FZLStateKeyPathCache Cache;
+
+			// The same reads GetCurrentStateValue makes through the JSON
+			double JsonNumber = 0.0;
+			bool bJsonBool = false;
+			FString JsonString;
+			TArray<double> JsonArray;
+			auto ReadJson = [&](int32 i)
+			{
+				const TSharedPtr<FJsonValue>* Value = Cache.Find(State, Keys[i]);
+				switch (i % 5)
+				{
+				case 0:
+					JsonNumber = (*Value)->AsNumber();
+					break;
+				case 1:
+					bJsonBool = (*Value)->AsBool();
+					break;
+				case 2:
+				case 3:
+					JsonString = (*Value)->AsString();
+					break;
+				default:
+					JsonArray.Reset();
+					for (const TSharedPtr<FJsonValue>& Item : (*Value)->AsArray())
+					{
+						JsonArray.Add(Item->AsNumber());
+					}
+					break;
+				}
+			};
+
+			double TypedNumber = 0.0;
+			bool bTypedBool = false;
+			FString TypedString;
+			TArray<double> TypedArray;
+			auto ReadTyped = [&](int32 i)
+			{
+				Store.Sync(Tree);
+				switch (i % 5)
+				{
+				case 0:
+					return Store.TryGet(Keys[i], TypedNumber);
+				case 1:
+					return Store.TryGet(Keys[i], bTypedBool);
+				case 2:
+				case 3:
+					return Store.TryGet(Keys[i], TypedString);
+				default:
+					TypedArray.Reset();
+					return Store.TryGet(Keys[i], TypedArray);
+				}
+			};
+
+			auto Verify = [&](int32 i)
+			{
+				const bool bHeld = ReadTyped(i);
+				ReadJson(i);
+				switch (i % 5)
+				{
+				case 0:
+					return bHeld && TypedNumber == JsonNumber;
+				case 1:
+					return bHeld && bTypedBool == bJsonBool;
+				case 2:
+					return bHeld && TypedString.Equals(JsonString, ESearchCase::CaseSensitive);
+				case 3:
+					return bHeld ? TypedString.Equals(JsonString, ESearchCase::CaseSensitive) : JsonString == TEXT("Purple");
+				default:
+					return bHeld && TypedArray == JsonArray;
+				}
+			};
+
+			// Changes made to the JSON alone must be picked up by Sync, and direct stores must agree with the JSON
+			int32 NumFailures = 0;
+			for (int32 Round = 0; Round < 20 && NumFailures == 0; ++Round)
+			{
+				for (int32 i = 0; i < NumKeys; ++i)
+				{
+					if (!Verify(i))
+					{
+						Ar.Logf(ELogVerbosity::Error, TEXT("Typed value of %s doesn't match the JSON in round %d"), *KeyNames[i], Round);
+						++NumFailures;
+					}
+				}
+
+				for (int32 Change = FMath::Max(1, NumKeys / 20); Change > 0; --Change)
+				{
+					const int32 i = Random.RandRange(0, NumKeys - 1);
+					if (i % 5 == 0 && Random.RandBool())
+					{
+						const double Value = Random.RandRange(0, 100);
+						const uint64 VersionBefore = Tree.GetVersion();
+						SetRandomStateKey(State, Keys[i], MakeShared<FJsonValueNumber>(Value));
+						Tree.MarkChanged(Keys[i]);
+						Store.Store(Keys[i], Value, Tree, VersionBefore);
+					}
+					else
+					{
+						SetRandomStateKey(State, Keys[i], MakeValue(i % 5));
+						Tree.MarkChanged(Keys[i]);
+					}
+				}
+			}
+
+			TArray<int32> ReadOrder;
+			for (int32 Read = 0; Read < NumReads; ++Read)
+			{
+				ReadOrder.Add(Random.RandRange(0, NumKeys - 1));
+			}
+
+			// Both sides intern the key string, as every blueprint read does
+			double StartTime = FPlatformTime::Seconds();
+			for (int32 i : ReadOrder)
+			{
+				FZLStateKeyPath::Intern(KeyNames[i]);
+				ReadJson(i);
+			}
+			const double JsonReadMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+			StartTime = FPlatformTime::Seconds();
+			for (int32 i : ReadOrder)
+			{
+				FZLStateKeyPath::Intern(KeyNames[i]);
+				ReadTyped(i);
+			}
+			const double TypedReadMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+			// Write then read back the same number key, with and without the direct store
+			const int32 NumberKey = 0;
+			StartTime = FPlatformTime::Seconds();
+			for (int32 Read = 0; Read < NumReads; ++Read)
+			{
+				SetRandomStateKey(State, Keys[NumberKey], MakeShared<FJsonValueNumber>(Read));
+				Tree.MarkChanged(Keys[NumberKey]);
+				ReadJson(NumberKey);
+			}
+			const double JsonCycleMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+			Store.Sync(Tree);
+			const uint64 ReloadsBefore = Store.GetNumReloads();
+			StartTime = FPlatformTime::Seconds();
+			for (int32 Read = 0; Read < NumReads; ++Read)
+			{
+				const uint64 VersionBefore = Tree.GetVersion();
+				SetRandomStateKey(State, Keys[NumberKey], MakeShared<FJsonValueNumber>(Read));
+				Tree.MarkChanged(Keys[NumberKey]);
+				Store.Store(Keys[NumberKey], (double)Read, Tree, VersionBefore);
+				ReadTyped(NumberKey);
+			}
+			const double TypedCycleMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+			if (Store.GetNumReloads() != ReloadsBefore || !Verify(NumberKey))
+			{
+				Ar.Logf(ELogVerbosity::Error, TEXT("Direct stores left the typed store out of sync (%llu reloads)"), Store.GetNumReloads() - ReloadsBefore);
+				++NumFailures;
+			}
+
+			Ar.Logf(TEXT("Typed state store benchmark, %d keys, %d reads"), NumKeys, NumReads);
+			Ar.Logf(TEXT("  Reads: JSON %.3fms, typed %.3fms"), JsonReadMs, TypedReadMs);
+			Ar.Logf(TEXT("  Write + read back: JSON %.3fms, typed %.3fms"), JsonCycleMs, TypedCycleMs);
+			Ar.Logf(TEXT("  Verification %s"), NumFailures == 0 ? TEXT("passed") : TEXT("FAILED"));
+		}));
+
+	// Checks a request straight against the schema asset, as validation would without compiling it: a key lookup per
+	// value, DataType string comparisons and linear searches of the accepted values
+	void ValidateAgainstKeyInfos(const UStateKeyInfoAsset* Schema, const TSharedPtr<FJsonObject>& Object, const FString& Prefix, TArray<FString>& OutViolations)
+	{
+		auto AddViolation = [&OutViolations](const FString& Key, EZLStateViolation Reason)
+		{
+			FZLStateViolation Violation;
+			Violation.Key = Key;
+			Violation.Reason = Reason;
+			OutViolations.Add(Violation.ToString());
+		};
+
+		auto IsAccepted = [](const FStateKeyInfo& Info, const FJsonValue& Value)
+		{
+			if (!Info.bLimitValues)
+			{
+				return true;
+			}
+			if (Value.Type == EJson::String && Info.AcceptedStringValues.Num() > 0 && (Info.DataType == TEXT("String") || Info.DataType == TEXT("StringArray")))
+			{
+				const FString String = Value.AsString();
+				return Info.AcceptedStringValues.ContainsByPredicate([&String](const FString& Accepted) { return Accepted.Equals(String, ESearchCase::CaseSensitive); });
+			}
+			if (Value.Type == EJson::Number && Info.AcceptedNumberValues.Num() > 0 && (Info.DataType == TEXT("Number") || Info.DataType == TEXT("NumberArray")))
+			{
+				return Info.AcceptedNumberValues.Contains(Value.AsNumber());
+			}
+			return true;
+		};
+
+		for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : Object->Values)
+		{
+			const FString Path = Prefix.IsEmpty() ? Pair.Key : Prefix + TEXT(".") + Pair.Key;
+			const FStateKeyInfo* Info = Schema->KeyInfos.Find(Path);
+			if (Info && Info->GetDataTypeEnum() == EStateKeyDataType::Invalid)
+			{
+				Info = nullptr;
+			}
+
+			bool bHasKeysBelow = false;
+			if (!Info || Pair.Value->Type == EJson::Object)
+			{
+				const FString PathPrefix = Path + TEXT(".");
+				for (const TPair<FString, FStateKeyInfo>& Entry : Schema->KeyInfos)
+				{
+					if (Entry.Key.StartsWith(PathPrefix) && Entry.Value.GetDataTypeEnum() != EStateKeyDataType::Invalid)
+					{
+						bHasKeysBelow = true;
+						break;
+					}
+				}
+			}
+
+			if (Pair.Value->Type == EJson::Object && bHasKeysBelow)
+			{
+				ValidateAgainstKeyInfos(Schema, Pair.Value->AsObject(), Path, OutViolations);
+			}
+			else if (Info)
+			{
+				const bool bArray = Info->DataType == TEXT("StringArray") || Info->DataType == TEXT("NumberArray") || Info->DataType == TEXT("BoolArray");
+				const EJson ItemType = Info->DataType.StartsWith(TEXT("String")) ? EJson::String : Info->DataType.StartsWith(TEXT("Number")) ? EJson::Number : EJson::Boolean;
+				if (!bArray)
+				{
+					if (Pair.Value->Type != ItemType)
+					{
+						AddViolation(Path, EZLStateViolation::WrongType);
+					}
+					else if (!IsAccepted(*Info, *Pair.Value))
+					{
+						AddViolation(Path, EZLStateViolation::NotAccepted);
+					}
+				}
+				else if (Pair.Value->Type != EJson::Array)
+				{
+					AddViolation(Path, EZLStateViolation::WrongType);
+				}
+				else
+				{
+					const TArray<TSharedPtr<FJsonValue>>& Items = Pair.Value->AsArray();
+					for (int32 Index = 0; Index < Items.Num(); ++Index)
+					{
+						if (Items[Index]->Type != ItemType)
+						{
+							AddViolation(FString::Printf(TEXT("%s[%d]"), *Path, Index), EZLStateViolation::WrongType);
+						}
+						else if (!IsAccepted(*Info, *Items[Index]))
+						{
+							AddViolation(FString::Printf(TEXT("%s[%d]"), *Path, Index), EZLStateViolation::NotAccepted);
+						}
+					}
+				}
+			}
+			else if (bHasKeysBelow)
+			{
+				AddViolation(Path, EZLStateViolation::NotAnObject);
+			}
+		}
+	}
+
+	// Checks the compiled validator on hand written requests, then against ValidateAgainstKeyInfos on random schemas and requests
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GVerifySchemaValidationCommand(
+		TEXT("ZLCloudPlugin.State.VerifySchemaValidation"),
+		TEXT("Verifies the compiled state schema validator. Usage: ZLCloudPlugin.State.VerifySchemaValidation [Iterations] [Seed]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const int32 Iterations = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000;
+			FRandomStream Random(Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 1);
+			int32 NumFailures = 0;
+
+			auto Check = [&Ar, &NumFailures](const FZLStateSchemaValidator& Validator, const TSharedPtr<FJsonObject>& Request, TArray<FString> Expected, const FString& Name)
+			{
+				TArray<FZLStateViolation> Violations;
+				const int32 NumFound = Validator.Validate(Request, Violations);
+				TArray<FString> Found;
+				for (const FZLStateViolation& Violation : Violations)
+				{
+					Found.Add(Violation.ToString());
+				}
+				Found.Sort();
+				Expected.Sort();
+				if (NumFound != Violations.Num() || Found != Expected || Validator.IsValid(Request) != (Expected.Num() == 0))
+				{
+					Ar.Logf(ELogVerbosity::Error, TEXT("%s: expected [%s], found [%s]"), *Name, *FString::Join(Expected, TEXT(", ")), *FString::Join(Found, TEXT(", ")));
+					++NumFailures;
+				}
+			};
+
+			UStateKeyInfoAsset* Schema = NewObject<UStateKeyInfoAsset>();
+			auto AddKey = [Schema](const TCHAR* Key, const TCHAR* DataType) -> FStateKeyInfo&
+			{
+				FStateKeyInfo& Info = Schema->KeyInfos.Add(Key);
+				Info.DataType = DataType;
+				return Info;
+			};
+			FStateKeyInfo& Colour = AddKey(TEXT("Car.Colour"), TEXT("String"));
+			Colour.bLimitValues = true;
+			Colour.AcceptedStringValues = { TEXT("Red"), TEXT("Green") };
+			FStateKeyInfo& Doors = AddKey(TEXT("Car.Doors"), TEXT("Number"));
+			Doors.bLimitValues = true;
+			Doors.AcceptedNumberValues = { 4, 2, 4 };
+			AddKey(TEXT("Car.Trim"), TEXT("String")).bLimitValues = true;
+			AddKey(TEXT("Lights"), TEXT("Bool"));
+			FStateKeyInfo& Options = AddKey(TEXT("Options"), TEXT("StringArray"));
+			Options.bLimitValues = true;
+			Options.AcceptedStringValues = { TEXT("Roof"), TEXT("Tow") };
+			AddKey(TEXT("Wheels.Sizes"), TEXT("NumberArray"));
+			AddKey(TEXT("Broken"), TEXT("Text"));
+
+			FZLStateSchemaValidator Validator;
+			Validator.Compile(Schema);
+			if (Validator.Num() != 6)
+			{
+				Ar.Logf(ELogVerbosity::Error, TEXT("Compiled %d keys, expected 6"), Validator.Num());
+				++NumFailures;
+			}
+
+			struct FCase
+			{
+				const TCHAR* Name;
+				const TCHAR* Request;
+				TArray<FString> Expected;
+			};
+			const FCase Cases[] = {
+				{ TEXT("Valid request"), TEXT("{\"Car\":{\"Colour\":\"Red\",\"Doors\":4,\"Trim\":\"Sport\"},\"Lights\":true,\"Options\":[\"Roof\"],\"Wheels\":{\"Sizes\":[18,19]},\"Broken\":1}"), {} },
+				{ TEXT("Wrong type"), TEXT("{\"Car\":{\"Colour\":5},\"Lights\":\"on\",\"Wheels\":{\"Sizes\":\"18\"}}"),
+					{ TEXT("Car.Colour has the wrong type"), TEXT("Lights has the wrong type"), TEXT("Wheels.Sizes has the wrong type") } },
+				{ TEXT("String not accepted"), TEXT("{\"Car\":{\"Colour\":\"Blue\"}}"), { TEXT("Car.Colour is not an accepted value") } },
+				{ TEXT("Accepted strings are case sensitive"), TEXT("{\"Car\":{\"Colour\":\"red\"}}"), { TEXT("Car.Colour is not an accepted value") } },
+				{ TEXT("Number not accepted"), TEXT("{\"Car\":{\"Doors\":3}}"), { TEXT("Car.Doors is not an accepted value") } },
+				{ TEXT("Array items"), TEXT("{\"Options\":[\"Roof\",1,\"Sunroof\"],\"Wheels\":{\"Sizes\":[18,true]}}"),
+					{ TEXT("Options[1] has the wrong type"), TEXT("Options[2] is not an accepted value"), TEXT("Wheels.Sizes[1] has the wrong type") } },
+				{ TEXT("Not an object"), TEXT("{\"Car\":\"Red\",\"Wheels\":[18]}"), { TEXT("Car is not an object"), TEXT("Wheels is not an object") } },
+				{ TEXT("Unknown keys"), TEXT("{\"Unknown\":{\"Colour\":1},\"Car\":{\"Unknown\":false},\"Lights\":{\"On\":1}}"), { TEXT("Lights has the wrong type") } },
+			};
+
+			for (const FCase& Case : Cases)
+			{
+				TSharedPtr<FJsonObject> Request;
+				TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Case.Request);
+				if (!FJsonSerializer::Deserialize(Reader, Request))
+				{
+					Ar.Logf(ELogVerbosity::Error, TEXT("%s: request didn't parse"), Case.Name);
+					++NumFailures;
+					continue;
+				}
+				Check(Validator, Request, Case.Expected, Case.Name);
+			}
+
+			// Random schemas over the same small key space as the requests, so keys, prefixes and types collide often
+			static const TCHAR* const DataTypes[] = { TEXT("String"), TEXT("StringArray"), TEXT("Number"), TEXT("NumberArray"), TEXT("Bool"), TEXT("BoolArray"), TEXT("Text") };
+			auto MakeValue = [&Random]() -> TSharedPtr<FJsonValue>
+			{
+				if (Random.RandRange(0, 4) > 0)
+				{
+					return MakeRandomStateValue(Random);
+				}
+				TArray<TSharedPtr<FJsonValue>> Items;
+				for (int32 i = Random.RandRange(1, 3); i > 0; --i)
+				{
+					Items.Add(Random.RandBool() ? MakeShared<FJsonValueString>(FString::Printf(TEXT("v%d"), Random.RandRange(0, 2))) : MakeRandomStateValue(Random));
+				}
+				return MakeShared<FJsonValueArray>(Items);
+			};
+
+			for (int32 Iteration = 0; Iteration < Iterations && NumFailures == 0; ++Iteration)
+			{
+				Schema->KeyInfos.Reset();
+				for (int32 i = Random.RandRange(1, 8); i > 0; --i)
+				{
+					FStateKeyInfo& Info = Schema->KeyInfos.Add(MakeRandomStateKey(Random));
+					Info.DataType = DataTypes[Random.RandRange(0, 6)];
+					Info.bLimitValues = Random.RandBool();
+					for (int32 j = Random.RandRange(0, 2); j > 0; --j)
+					{
+						Info.AcceptedStringValues.Add(FString::Printf(Random.RandBool() ? TEXT("v%d") : TEXT("V%d"), Random.RandRange(0, 2)));
+						Info.AcceptedNumberValues.Add(Random.RandRange(0, 2));
+					}
+				}
+				Validator.Compile(Schema);
+
+				TSharedPtr<FJsonObject> Request = MakeShared<FJsonObject>();
+				for (int32 i = Random.RandRange(1, 8); i > 0; --i)
+				{
+					SetRandomStateKey(Request, FZLStateKeyPath::Intern(MakeRandomStateKey(Random)), MakeValue());
+				}
+
+				TArray<FString> Expected;
+				ValidateAgainstKeyInfos(Schema, Request, FString(), Expected);
+				Check(Validator, Request, Expected, FString::Printf(TEXT("Iteration %d"), Iteration));
+			}
+
+			Ar.Logf(TEXT("Schema validation verification %s"), NumFailures == 0 ? TEXT("passed") : TEXT("FAILED"));
+		}));
+
+	// Times validating a request with the compiled validator against checking it straight against the schema asset
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GBenchmarkSchemaValidationCommand(
+		TEXT("ZLCloudPlugin.State.BenchmarkSchemaValidation"),
+		TEXT("Times the compiled state schema validator. Usage: ZLCloudPlugin.State.BenchmarkSchemaValidation [Keys] [AcceptedValues] [Runs]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const int32 NumKeys = FMath::Max(2, Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000);
+			const int32 NumAccepted = FMath::Max(1, Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 100);
+			const int32 NumRuns = FMath::Max(1, Args.Num() > 2 ? FCString::Atoi(*Args[2]) : 1000);
+
+			// Alternating limited string and number keys, the request holds the last accepted value of each
+			UStateKeyInfoAsset* Schema = NewObject<UStateKeyInfoAsset>();
+			TSharedPtr<FJsonObject> Request = MakeShared<FJsonObject>();
+			for (int32 i = 0; i < NumKeys; ++i)
+			{
+				const FString Key = FString::Printf(TEXT("Group%d.Key%d"), i % 32, i);
+				FStateKeyInfo& Info = Schema->KeyInfos.Add(Key);
+				Info.bLimitValues = true;
+				for (int32 j = 0; j < NumAccepted; ++j)
+				{
+					if (i % 2 == 0)
+					{
+						Info.AcceptedStringValues.Add(FString::Printf(TEXT("Value%d"), j));
+					}
+					else
+					{
+						Info.AcceptedNumberValues.Add(j);
+					}
+				}
+				Info.DataType = i % 2 == 0 ? TEXT("String") : TEXT("Number");
+				SetRandomStateKey(Request, FZLStateKeyPath::Intern(Key), i % 2 == 0
+					? StaticCastSharedRef<FJsonValue>(MakeShared<FJsonValueString>(FString::Printf(TEXT("Value%d"), NumAccepted - 1)))
+					: StaticCastSharedRef<FJsonValue>(MakeShared<FJsonValueNumber>(NumAccepted - 1)));
+			}
+
+			double StartTime = FPlatformTime::Seconds();
+			FZLStateSchemaValidator Validator;
+			Validator.Compile(Schema);
+			const double CompileMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+			TArray<FString> Expected;
+			StartTime = FPlatformTime::Seconds();
+			for (int32 Run = 0; Run < NumRuns; ++Run)
+			{
+				Expected.Reset();
+				ValidateAgainstKeyInfos(Schema, Request, FString(), Expected);
+			}
+			const double SchemaMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+			TArray<FZLStateViolation> Violations;
+			StartTime = FPlatformTime::Seconds();
+			for (int32 Run = 0; Run < NumRuns; ++Run)
+			{
+				Violations.Reset();
+				Validator.Validate(Request, Violations);
+			}
+			const double CompiledMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+			Ar.Logf(TEXT("Schema validation benchmark, %d keys, %d accepted values each, %d runs"), NumKeys, NumAccepted, NumRuns);
+			Ar.Logf(TEXT("  Compile %.3fms"), CompileMs);
+			Ar.Logf(TEXT("  Validate: schema asset %.3fms (%.1f requests/s), compiled %.3fms (%.1f requests/s)"),
+				SchemaMs, NumRuns / FMath::Max(SchemaMs / 1000.0, 1e-9), CompiledMs, NumRuns / FMath::Max(CompiledMs / 1000.0, 1e-9));
+			if (Expected.Num() != 0 || Violations.Num() != 0)
+			{
+				Ar.Logf(ELogVerbosity::Error, TEXT("Valid request reported %d and %d violations"), Expected.Num(), Violations.Num());
+			}
+		}));
+
+	// Deep copy through JSON text, independent of the binary format under test
+	TSharedPtr<FJsonObject> CopyJsonObjectAsText(const TSharedPtr<FJsonObject>& Object)
+	{
+		FString Json;
+		TSharedRef<TJsonWriter<TCHAR>> JsonWriter = TJsonWriterFactory<TCHAR>::Create(&Json);
+		FJsonSerializer::Serialize(Object.ToSharedRef(), JsonWriter);
+		JsonWriter->Close();
+
+		TSharedPtr<FJsonObject> Copy;
+		TSharedRef<TJsonReader<>> JsonReader = TJsonReaderFactory<>::Create(Json);
+		FJsonSerializer::Deserialize(JsonReader, Copy);
+		return Copy;
+	}
+
+	bool JsonObjectsMatch(const TSharedPtr<FJsonObject>& A, const TSharedPtr<FJsonObject>& B)
+	{
+		const bool bAEmpty = !A.IsValid() || A->Values.Num() == 0;
+		const bool bBEmpty = !B.IsValid() || B->Values.Num() == 0;
+		if (bAEmpty || bBEmpty)
+		{
+			return bAEmpty == bBEmpty;
+		}
+		return CompareJsonValuesCaseSensitive(MakeShared<FJsonValueObject>(A), MakeShared<FJsonValueObject>(B));
+	}
+
+	// Round trips the binary format, then journals random changes and checks restores match the live state, including after a torn write
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GVerifyStateJournalCommand(
+		TEXT("ZLCloudPlugin.State.VerifyJournal"),
+		TEXT("Verifies the binary state snapshot and journal round trip. Usage: ZLCloudPlugin.State.VerifyJournal [Iterations] [Seed]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const int32 Iterations = FMath::Max(2, Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 500);
+			FRandomStream Random(Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 1);
+			int32 NumFailures = 0;
+
+			// Values the compact encodings have to get exactly right
+			TSharedPtr<FJsonObject> Edge = MakeShared<FJsonObject>();
+			Edge->SetNumberField(TEXT("Zero"), 0.0);
+			Edge->SetNumberField(TEXT("NegativeZero"), -0.0);
+			Edge->SetNumberField(TEXT("Fraction"), 0.1);
+			Edge->SetNumberField(TEXT("Negative"), -123456789.0);
+			Edge->SetNumberField(TEXT("Huge"), 1e300);
+			Edge->SetNumberField(TEXT("BeyondInt53"), 9007199254740994.0);
+			Edge->SetStringField(TEXT("Empty"), FString());
+			Edge->SetStringField(TEXT("Unicode"), TEXT("M\u00e9tal \u8272 \"quoted\"\n"));
+			Edge->SetStringField(TEXT("unicode"), TEXT("case differs from the key above"));
+			Edge->SetArrayField(TEXT("EmptyArray"), TArray<TSharedPtr<FJsonValue>>());
+			Edge->SetObjectField(TEXT("EmptyObject"), MakeShared<FJsonObject>());
+			{
+				TArray<TSharedPtr<FJsonValue>> Mixed;
+				Mixed.Add(MakeShared<FJsonValueNumber>(-1.0));
+				Mixed.Add(MakeShared<FJsonValueBoolean>(true));
+				Mixed.Add(MakeShared<FJsonValueString>(TEXT("Zero")));
+				Mixed.Add(MakeShared<FJsonValueArray>(TArray<TSharedPtr<FJsonValue>>()));
+				Mixed.Add(MakeShared<FJsonValueObject>(Edge->GetObjectField(TEXT("EmptyObject"))));
+				Edge->SetArrayField(TEXT("Mixed"), Mixed);
+			}
+
+			TArray<uint8> Bytes;
+			FZLStateBinaryWriter Writer(Bytes);
+			Writer.WriteObject(*Edge);
+			const int32 EncodedSize = Bytes.Num();
+			TSharedPtr<FJsonObject> Decoded;
+			FZLStateBinaryReader Reader(Bytes.GetData(), Bytes.Num());
+			double NegativeZero = 0.0;
+			if (!Reader.ReadObject(Decoded) || !Reader.IsAtEnd() || !JsonObjectsMatch(Edge, Decoded)
+				|| !Decoded->TryGetNumberField(TEXT("NegativeZero"), NegativeZero) || 1.0 / NegativeZero > 0.0)
+			{
+				Ar.Logf(ELogVerbosity::Error, TEXT("Edge case values didn't survive the binary round trip"));
+				++NumFailures;
+			}
+
+			// Every truncation of valid data has to fail cleanly
+			for (int32 Length = 0; Length < EncodedSize; ++Length)
+			{
+				FZLStateBinaryReader Truncated(Bytes.GetData(), Length);
+				TSharedPtr<FJsonObject> Partial;
+				if (Truncated.ReadObject(Partial) && Truncated.IsAtEnd())
+				{
+					Ar.Logf(ELogVerbosity::Error, TEXT("Binary state truncated to %d of %d bytes still read as complete"), Length, EncodedSize);
+					++NumFailures;
+					break;
+				}
+			}
+
+			FZLStateSnapshot Snapshot;
+			Snapshot.CurrentState = Edge;
+			Snapshot.RequestedState = MakeShared<FJsonObject>();
+			Snapshot.SchemaHash = 42;
+			Snapshot.Generation = 7;
+			Bytes.Reset();
+			Snapshot.Serialize(Bytes);
+			FZLStateSnapshot Loaded;
+			if (!Loaded.Deserialize(Bytes) || Loaded.SchemaHash != 42 || Loaded.Generation != 7 || !JsonObjectsMatch(Loaded.CurrentState, Edge))
+			{
+				Ar.Logf(ELogVerbosity::Error, TEXT("Snapshot didn't survive the round trip"));
+				++NumFailures;
+			}
+			Bytes[Bytes.Num() / 2] ^= 0x10;
+			if (Loaded.Deserialize(Bytes))
+			{
+				Ar.Logf(ELogVerbosity::Error, TEXT("Corrupt snapshot passed its checksum"));
+				++NumFailures;
+			}
+
+			// Journal random changes, checking a restore against the live state every few ticks
+			const FString Directory = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("ZLStateJournalVerify"));
+			IFileManager::Get().DeleteDirectory(*Directory, false, true);
+
+			TSharedPtr<FJsonObject> State = MakeShared<FJsonObject>();
+			TSharedPtr<FJsonObject> Requested;
+			TSharedPtr<FJsonObject> PreviousExpected = MakeShared<FJsonObject>();
+			TSharedPtr<FJsonObject> Expected = MakeShared<FJsonObject>();
+			TSharedPtr<FJsonObject> ExpectedRequested;
+			bool bLastFlushWroteRecord = false;
+
+			FZLStateJournal Journal;
+			if (!Journal.Open(Directory, 1))
+			{
+				Ar.Logf(ELogVerbosity::Error, TEXT("Couldn't open a journal in %s"), *Directory);
+				return;
+			}
+
+			auto CheckRestore = [&](const TSharedPtr<FJsonObject>& ExpectedState, const TCHAR* When)
+			{
+				Journal.WaitForWrites();
+				FZLStateSnapshot Restored;
+				FString Error;
+				if (!FZLStateJournal::Restore(Directory, 1, Restored, &Error))
+				{
+					Ar.Logf(ELogVerbosity::Error, TEXT("Restore failed %s: %s"), When, *Error);
+					++NumFailures;
+				}
+				else if (!JsonObjectsMatch(Restored.CurrentState, ExpectedState) || !JsonObjectsMatch(Restored.RequestedState, ExpectedRequested))
+				{
+					Ar.Logf(ELogVerbosity::Error, TEXT("Restored state doesn't match %s"), When);
+					++NumFailures;
+				}
+			};
+
+			for (int32 Iteration = 0; Iteration < Iterations && NumFailures == 0; ++Iteration)
+			{
+				const int32 NumRecordsBefore = Journal.GetNumRecords();
+				const int32 Action = Random.RandRange(0, 99);
+				if (Action < 2)
+				{
+					State = MakeShared<FJsonObject>();
+					for (int32 i = Random.RandRange(0, 5); i > 0; --i)
+					{
+						SetRandomStateKey(State, FZLStateKeyPath::Intern(MakeRandomStateKey(Random)), MakeRandomStateValue(Random));
+					}
+					Journal.RecordReset();
+				}
+				else if (Action < 10)
+				{
+					Requested = Random.RandBool() ? MakeShared<FJsonObject>() : nullptr;
+					if (Requested.IsValid())
+					{
+						SetRandomStateKey(Requested, FZLStateKeyPath::Intern(MakeRandomStateKey(Random)), MakeRandomStateValue(Random));
+					}
+				}
+
+				for (int32 Change = Random.RandRange(0, 4); Change > 0; --Change)
+				{
+					const FZLStateKeyPath Path = FZLStateKeyPath::Intern(MakeRandomStateKey(Random));
+					if (Random.RandRange(0, 3) == 0)
+					{
+						// Leaves parents in place even when emptied, the journal has to carry those too
+						TSharedPtr<FJsonObject> Parent = FZLStateKeyPathCache::WalkToParent(State, Path);
+						if (Parent.IsValid())
+						{
+							Parent->RemoveField(Path.GetLeaf().Name);
+						}
+					}
+					else
+					{
+						SetRandomStateKey(State, Path, MakeRandomStateValue(Random));
+					}
+					Journal.RecordChange(Path);
+				}
+
+				Journal.Flush(State, Requested);
+				bLastFlushWroteRecord = Journal.GetNumRecords() != NumRecordsBefore;
+				PreviousExpected = Expected;
+				Expected = CopyJsonObjectAsText(State);
+				ExpectedRequested = Requested.IsValid() ? CopyJsonObjectAsText(Requested) : nullptr;
+
+				if (Iteration % 25 == 0)
+				{
+					CheckRestore(Expected, *FString::Printf(TEXT("at iteration %d"), Iteration));
+				}
+			}
+
+			Journal.Close();
+			if (NumFailures == 0)
+			{
+				CheckRestore(Expected, TEXT("after closing"));
+			}
+
+			FZLStateSnapshot Mismatched;
+			if (FZLStateJournal::Restore(Directory, 2, Mismatched))
+			{
+				Ar.Logf(ELogVerbosity::Error, TEXT("Snapshot restored against a different schema hash"));
+				++NumFailures;
+			}
+
+			// A write torn part way through the last record loses just that record
+			TArray<uint8> JournalBytes;
+			if (NumFailures == 0 && bLastFlushWroteRecord && FFileHelper::LoadFileToArray(JournalBytes, *FZLStateJournal::GetJournalPath(Directory)))
+			{
+				JournalBytes.SetNum(JournalBytes.Num() - 1);
+				FFileHelper::SaveArrayToFile(JournalBytes, *FZLStateJournal::GetJournalPath(Directory));
+				FZLStateSnapshot Restored;
+				if (!FZLStateJournal::Restore(Directory, 1, Restored) || !JsonObjectsMatch(Restored.CurrentState, PreviousExpected))
+				{
+					Ar.Logf(ELogVerbosity::Error, TEXT("Restore with a torn last record doesn't match the state before it"));
+					++NumFailures;
+				}
+			}
+
+			IFileManager::Get().DeleteDirectory(*Directory, false, true);
+
+			Ar.Logf(TEXT("State journal verification, %d iterations, %d snapshots, %d records: %s"), Iterations, Journal.GetNumSnapshots(), Journal.GetNumRecords(), NumFailures == 0 ? TEXT("passed") : TEXT("FAILED"));
+		}));
+
+	// Times restoring a large state from the binary snapshot and journal against parsing the same state as JSON
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GBenchmarkStateRestoreCommand(
+		TEXT("ZLCloudPlugin.State.BenchmarkRestore"),
+		TEXT("Times state restore from the binary snapshot and journal against JSON. Usage: ZLCloudPlugin.State.BenchmarkRestore [KB] [Changes] [Seed]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const int32 TargetBytes = FMath::Max(1, Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1024) * 1024;
+			const int32 NumChanges = FMath::Max(0, Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 10000);
+			const int32 Seed = Args.Num() > 2 ? FCString::Atoi(*Args[2]) : 1;
+
+			TArray<FString> LeafPaths;
+			TSharedPtr<FJsonObject> State = MakeBenchmarkInitialState(Seed, TargetBytes, LeafPaths);
+
+			FString Json;
+			{
+				TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> JsonWriter = TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&Json);
+				FJsonSerializer::Serialize(State.ToSharedRef(), JsonWriter);
+				JsonWriter->Close();
+			}
+			FTCHARToUTF8 JsonUtf8(*Json, Json.Len());
+
+			double StartTime = FPlatformTime::Seconds();
+			TSharedPtr<FJsonObject> Parsed;
+			TSharedRef<TJsonReader<>> JsonReader = TJsonReaderFactory<>::Create(Json);
+			FJsonSerializer::Deserialize(JsonReader, Parsed);
+			const double JsonMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+			FZLStateSnapshot Snapshot;
+			Snapshot.CurrentState = State;
+			TArray<uint8> SnapshotBytes;
+			StartTime = FPlatformTime::Seconds();
+			Snapshot.Serialize(SnapshotBytes);
+			const double EncodeMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+			FZLStateSnapshot Loaded;
+			StartTime = FPlatformTime::Seconds();
+			Loaded.Deserialize(SnapshotBytes);
+			const double DecodeMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+			// Journal leaf changes ten per tick, as a busy session would, then restore from disk
+			const FString Directory = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("ZLStateJournalBenchmark"));
+			IFileManager::Get().DeleteDirectory(*Directory, false, true);
+			FZLStateJournal Journal;
+			if (!Journal.Open(Directory, 0))
+			{
+				Ar.Logf(ELogVerbosity::Error, TEXT("Couldn't open a journal in %s"), *Directory);
+				return;
+			}
+			Journal.Flush(State, nullptr);
+
+			FRandomStream Random(Seed);
+			double FlushSeconds = 0.0;
+			int32 NumFlushes = 0;
+			for (int32 Change = 0; Change < NumChanges; ++Change)
+			{
+				const FZLStateKeyPath Path = FZLStateKeyPath::Intern(LeafPaths[Random.RandRange(0, LeafPaths.Num() - 1)]);
+				SetRandomStateKey(State, Path, MakeShared<FJsonValueString>(FString::Printf(TEXT("Value%d"), Change)));
+				Journal.RecordChange(Path);
+				if (Change % 10 == 9 || Change == NumChanges - 1)
+				{
+					StartTime = FPlatformTime::Seconds();
+					Journal.Flush(State, nullptr);
+					FlushSeconds += FPlatformTime::Seconds() - StartTime;
+					++NumFlushes;
+				}
+			}
+			Journal.Close();
+
+			FZLStateSnapshot Restored;
+			int32 NumRecords = 0;
+			StartTime = FPlatformTime::Seconds();
+			const bool bRestored = FZLStateJournal::Restore(Directory, 0, Restored, nullptr, &NumRecords);
+			const double RestoreMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+			const int64 JournalFileSize = IFileManager::Get().FileSize(*FZLStateJournal::GetJournalPath(Directory));
+			IFileManager::Get().DeleteDirectory(*Directory, false, true);
+
+			Ar.Logf(TEXT("State restore benchmark, %d leaves, %d changes"), LeafPaths.Num(), NumChanges);
+			Ar.Logf(TEXT("  JSON: %d bytes, parse %.3fms"), JsonUtf8.Length(), JsonMs);
+			Ar.Logf(TEXT("  Snapshot: %d bytes, encode %.3fms, decode %.3fms"), SnapshotBytes.Num(), EncodeMs, DecodeMs);
+			Ar.Logf(TEXT("  Journal: %lld bytes in %d records after %d snapshots, %.1fus per flush"), JournalFileSize, NumRecords, Journal.GetNumSnapshots(), NumFlushes > 0 ? FlushSeconds * 1000000.0 / NumFlushes : 0.0);
+			Ar.Logf(TEXT("  Restore (snapshot + journal from disk): %.3fms"), RestoreMs);
+
+			if (!JsonObjectsMatch(Loaded.CurrentState, Parsed) || !bRestored || !JsonObjectsMatch(Restored.CurrentState, State))
+			{
+				Ar.Logf(ELogVerbosity::Error, TEXT("Restored state doesn't match the state it was saved from"));
+			}
+		}));
+
+	TUniquePtr<FZLStateReplayer> GActiveStateReplay;
+	FTSTicker::FDelegateHandle GActiveStateReplayTicker;
+
+	void LogStateReplayReport(const FZLStateReplayReport& Report, FOutputDevice& Ar)
+	{
+		for (const FString& Line : Report.ToLines())
+		{
+			Ar.Log(Line);
+		}
+	}
+
+	// Starts or stops recording the live state manager's requests for ZLCloudPlugin.State.Replay
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GStateRecordCommand(
+		TEXT("ZLCloudPlugin.State.Record"),
+		TEXT("Records state requests and the state changes they cause. Usage: ZLCloudPlugin.State.Record Start [File] | Stop"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			UZLCloudPluginStateManager* StateManager = UZLCloudPluginStateManager::GetZLCloudPluginStateManager();
+			if (Args.Num() > 0 && Args[0].Equals(TEXT("Stop"), ESearchCase::IgnoreCase))
+			{
+				StateManager->StopStateRecording();
+			}
+			else if (!StateManager->StartStateRecording(Args.Num() > 1 ? Args[1] : FString()))
+			{
+				Ar.Logf(ELogVerbosity::Error, TEXT("Couldn't start the state recording"));
+			}
+		}));
+
+	// Plays a recording back against a detached state manager and a stub app that confirms what it is asked for
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GStateReplayCommand(
+		TEXT("ZLCloudPlugin.State.Replay"),
+		TEXT("Replays a state recording and reports request latency and state manager cost. Speed 0 runs as fast as possible, a negative confirm delay confirms when the recorded app did. Usage: ZLCloudPlugin.State.Replay File [Speed] [ConfirmDelay] [ConfirmJitter] [Seed]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			if (Args.Num() == 0)
+			{
+				Ar.Logf(ELogVerbosity::Error, TEXT("Usage: ZLCloudPlugin.State.Replay File [Speed] [ConfirmDelay] [ConfirmJitter] [Seed]"));
+				return;
+			}
+
+			FZLStateRecording Recording;
+			FString Error;
+			const FString FileName = FZLStateRecorder::ResolveFileName(Args[0]);
+			if (!Recording.Load(FileName, &Error))
+			{
+				Ar.Logf(ELogVerbosity::Error, TEXT("Couldn't load %s: %s"), *FileName, *Error);
+				return;
+			}
+
+			UStateKeyInfoAsset* Schema = UZLCloudPluginStateManager::GetZLCloudPluginStateManager()->GetCurrentSchemaAsset();
+			if (Recording.SchemaHash != FZLStateSnapshot::HashSchema(Schema))
+			{
+				Ar.Logf(ELogVerbosity::Warning, TEXT("%s was recorded against a different schema, replaying against the active one"), *FileName);
+			}
+
+			FZLStateReplaySettings Settings;
+			Settings.Speed = Args.Num() > 1 ? FCString::Atod(*Args[1]) : 0.0;
+			Settings.ConfirmDelay = Args.Num() > 2 ? FCString::Atod(*Args[2]) : -1.0;
+			Settings.ConfirmJitter = Args.Num() > 3 ? FCString::Atod(*Args[3]) : 0.0;
+			Settings.Seed = Args.Num() > 4 ? FCString::Atoi(*Args[4]) : 0;
+
+			if (GActiveStateReplayTicker.IsValid())
+			{
+				FTSTicker::GetCoreTicker().RemoveTicker(GActiveStateReplayTicker);
+				GActiveStateReplayTicker.Reset();
+			}
+			GActiveStateReplay.Reset();
+
+			Ar.Logf(TEXT("Replaying %d requests over %.1fs from %s"), Recording.NumRequests, Recording.Duration, *FileName);
+
+			if (Settings.Speed <= 0.0)
+			{
+				FZLStateReplayer Replayer(Recording, Settings, Schema);
+				Replayer.RunToCompletion();
+				LogStateReplayReport(Replayer.GetReport(), Ar);
+				return;
+			}
+
+			// In real time the report goes to the log, whoever ran the command may be long gone
+			GActiveStateReplay = MakeUnique<FZLStateReplayer>(Recording, Settings, Schema);
+			GActiveStateReplayTicker = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([](float DeltaTime) {
+				if (GActiveStateReplay->Tick(DeltaTime))
+				{
+					return true;
+				}
+
+				LogStateReplayReport(GActiveStateReplay->GetReport(), *GLog);
+				GActiveStateReplay.Reset();
+				GActiveStateReplayTicker.Reset();
+				return false;
+			}));
+		}));
+
+	// Records a replay of a generated session, replays the recording and checks both runs agree
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GVerifyStateReplayCommand(
+		TEXT("ZLCloudPlugin.State.VerifyReplay"),
+		TEXT("Checks a state recording replays to the same requests, latencies and final state. Usage: ZLCloudPlugin.State.VerifyReplay [Requests] [Seed]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const int32 NumRequests = FMath::Max(1, Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 200);
+			FRandomStream Random(Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 1);
+			int32 NumFailures = 0;
+
+			// Requests on a handful of overlapping keys so some queue and coalesce
+			FZLStateRecording Generated;
+			Generated.InitialState = MakeShared<FJsonObject>();
+			double Time = 0.0;
+			for (int32 i = 0; i < NumRequests; ++i)
+			{
+				Time += Random.FRandRange(0.0f, 0.25f);
+
+				TSharedPtr<FJsonObject> Request = MakeShared<FJsonObject>();
+				for (int32 Key = Random.RandRange(1, 3); Key > 0; --Key)
+				{
+					SetRandomStateKey(Request, FZLStateKeyPath::Intern(MakeRandomStateKey(Random)), MakeRandomStateValue(Random));
+				}
+
+				FZLStateRecordedEvent& Event = Generated.Events.AddDefaulted_GetRef();
+				Event.Type = EZLStateRecordedEvent::Request;
+				Event.Time = Time;
+				Event.bCompareCurrentState = true;
+				TSharedRef<TJsonWriter<TCHAR>> JsonWriter = TJsonWriterFactory<TCHAR>::Create(&Event.Text);
+				FJsonSerializer::Serialize(Request.ToSharedRef(), JsonWriter);
+				JsonWriter->Close();
+			}
+			Generated.NumRequests = NumRequests;
+			Generated.Duration = Time;
+
+			// The original confirms after random delays and occasionally not at all so some requests time out, the
+			// replay confirms when the original did
+			FZLStateReplaySettings OriginalSettings;
+			OriginalSettings.ConfirmDelay = 0.0;
+			OriginalSettings.ConfirmJitter = 0.5;
+			OriginalSettings.DropConfirmChance = 0.03;
+			OriginalSettings.Seed = Random.RandHelper(MAX_int32);
+			FZLStateReplaySettings Settings;
+			const FString FileName = FZLStateRecorder::ResolveFileName(TEXT("VerifyReplay"));
+
+			FZLStateReplayer Original(Generated, OriginalSettings, nullptr);
+			Original.GetManager()->StartStateRecording(FileName);
+			Original.RunToCompletion();
+			Original.GetManager()->StopStateRecording();
+
+			FZLStateRecording Recorded;
+			FString Error;
+			if (!Recorded.Load(FileName, &Error))
+			{
+				Ar.Logf(ELogVerbosity::Error, TEXT("Couldn't load the recording: %s"), *Error);
+				return;
+			}
+			IFileManager::Get().Delete(*FileName);
+
+			FZLStateReplayer Replayed(Recorded, Settings, nullptr);
+			Replayed.RunToCompletion();
+
+			const FZLStateReplayReport& A = Original.GetReport();
+			const FZLStateReplayReport& B = Replayed.GetReport();
+			if (Recorded.NumRequests != NumRequests || B.NumRequests != NumRequests)
+			{
+				Ar.Logf(ELogVerbosity::Error, TEXT("Recorded %d and replayed %d of %d requests"), Recorded.NumRequests, B.NumRequests, NumRequests);
+				++NumFailures;
+			}
+			if (A.NumComplete != B.NumComplete || A.NumUnmatched != B.NumUnmatched || A.NumTimedOut != B.NumTimedOut || A.NumConfirms != B.NumConfirms)
+			{
+				Ar.Logf(ELogVerbosity::Error, TEXT("Outcomes differ: %d/%d/%d/%d recorded, %d/%d/%d/%d replayed (complete/unmatched/timeout/confirms)"),
+					A.NumComplete, A.NumUnmatched, A.NumTimedOut, A.NumConfirms, B.NumComplete, B.NumUnmatched, B.NumTimedOut, B.NumConfirms);
+				++NumFailures;
+			}
+			if (A.Latencies.Num() != B.Latencies.Num())
+			{
+				Ar.Logf(ELogVerbosity::Error, TEXT("%d request latencies recorded, %d replayed"), A.Latencies.Num(), B.Latencies.Num());
+				++NumFailures;
+			}
+			else
+			{
+				// Confirm times survive the round trip to within a tick
+				for (int32 i = 0; i < A.Latencies.Num(); ++i)
+				{
+					if (FMath::Abs(A.Latencies[i] - B.Latencies[i]) > Settings.TickInterval * 1.5)
+					{
+						Ar.Logf(ELogVerbosity::Error, TEXT("Latency %d differs, %.3fs recorded and %.3fs replayed"), i, A.Latencies[i], B.Latencies[i]);
+						++NumFailures;
+						break;
+					}
+				}
+			}
+			if (!B.bFinalStateMatches)
+			{
+				Ar.Logf(ELogVerbosity::Error, TEXT("Replayed final state doesn't match the recording"));
+				++NumFailures;
+			}
+
+			LogStateReplayReport(B, Ar);
+			Ar.Logf(TEXT("State replay verification, %d requests: %s"), NumRequests, NumFailures == 0 ? TEXT("passed") : TEXT("FAILED"));
+		}));
+
+	// Checks trie routing against a brute force prefix match of every observer against every changed path
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GVerifyStateObserversCommand(
+		TEXT("ZLCloudPlugin.State.VerifyObservers"),
+		TEXT("Fuzzes state key path observers against brute force matching. Usage: ZLCloudPlugin.State.VerifyObservers [Frames] [Seed]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const int32 NumFrames = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 2000;
+			FRandomStream Random(Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 1);
+
+			struct FExpectedObserver
+			{
+				EZLStateObserverSource Source;
+				FZLStateKeyPath Path;
+			};
+
+			FZLStateObservers Observers;
+			TMap<FZLStateObservers::FObserverId, FExpectedObserver> Expected;
+			TMap<FZLStateObservers::FObserverId, TArray<FZLStateKeyPath>> Received;
+			int32 NumFailures = 0;
+			int32 NumCalls = 0;
+
+			// One observes or contains the other
+			auto IsRelated = [](const FZLStateKeyPath& A, const FZLStateKeyPath& B)
+			{
+				const int32 NumShared = FMath::Min(A.Num(), B.Num());
+				for (int32 i = 0; i < NumShared; ++i)
+				{
+					if (!A.GetSegments()[i].Name.Equals(B.GetSegments()[i].Name, ESearchCase::IgnoreCase))
+					{
+						return false;
+					}
+				}
+				return true;
+			};
+
+			for (int32 Frame = 0; Frame < NumFrames && NumFailures < 10; ++Frame)
+			{
+				for (int32 i = Random.RandRange(0, 3); i > 0; --i)
+				{
+					if (Expected.Num() > 0 && Random.RandRange(0, 2) == 0)
+					{
+						TArray<FZLStateObservers::FObserverId> Ids;
+						Expected.GetKeys(Ids);
+						const FZLStateObservers::FObserverId Victim = Ids[Random.RandRange(0, Ids.Num() - 1)];
+						Observers.Unsubscribe(Victim);
+						Expected.Remove(Victim);
+					}
+					else
+					{
+						FExpectedObserver Observer;
+						Observer.Source = Random.RandBool() ? EZLStateObserverSource::Requested : EZLStateObserverSource::Current;
+						Observer.Path = Random.RandRange(0, 19) == 0 ? FZLStateKeyPath() : FZLStateKeyPath::Intern(MakeRandomStateKey(Random));
+						TSharedPtr<FZLStateObservers::FObserverId> Id = MakeShared<FZLStateObservers::FObserverId>();
+						*Id = Observers.Subscribe(Observer.Source, Observer.Path, FZLOnStatePathsChanged::CreateLambda([&Received, &NumCalls, Id](const TArray<FZLStateKeyPath>& Paths)
+						{
+							Received.FindOrAdd(*Id).Append(Paths);
+							++NumCalls;
+						}));
+						Expected.Add(*Id, Observer);
+					}
+				}
+
+				// What each observer should hear about this frame
+				TMap<FZLStateObservers::FObserverId, TSet<FZLStateKeyPath>> Wanted;
+				for (int32 i = Random.RandRange(0, 6); i > 0; --i)
+				{
+					const EZLStateObserverSource Source = Random.RandBool() ? EZLStateObserverSource::Requested : EZLStateObserverSource::Current;
+					if (Random.RandRange(0, 49) == 0)
+					{
+						Observers.MarkAllChanged(Source);
+						for (const TPair<FZLStateObservers::FObserverId, FExpectedObserver>& Pair : Expected)
+						{
+							if (Pair.Value.Source == Source)
+							{
+								Wanted.FindOrAdd(Pair.Key).Add(Pair.Value.Path);
+							}
+						}
+						continue;
+					}
+
+					const FZLStateKeyPath Changed = FZLStateKeyPath::Intern(MakeRandomStateKey(Random));
+					Observers.MarkChanged(Source, Changed);
+					for (const TPair<FZLStateObservers::FObserverId, FExpectedObserver>& Pair : Expected)
+					{
+						if (Pair.Value.Source == Source && IsRelated(Pair.Value.Path, Changed))
+						{
+							Wanted.FindOrAdd(Pair.Key).Add(Changed);
+						}
+					}
+				}
+
+				Received.Reset();
+				const int32 NumDispatched = Observers.Dispatch();
+				if (NumDispatched != Wanted.Num() || Received.Num() != Wanted.Num())
+				{
+					Ar.Logf(ELogVerbosity::Error, TEXT("Frame %d: %d observers called, %d expected"), Frame, NumDispatched, Wanted.Num());
+					++NumFailures;
+					continue;
+				}
+
+				for (const TPair<FZLStateObservers::FObserverId, TSet<FZLStateKeyPath>>& Pair : Wanted)
+				{
+					const TArray<FZLStateKeyPath>* Paths = Received.Find(Pair.Key);
+					const bool bMatches = Paths && Paths->Num() == Pair.Value.Num() && Algo::AllOf(*Paths, [&Pair](const FZLStateKeyPath& Path) { return Pair.Value.Contains(Path); });
+					if (!bMatches)
+					{
+						const FExpectedObserver& Observer = Expected[Pair.Key];
+						Ar.Logf(ELogVerbosity::Error, TEXT("Frame %d: observer of '%s' got %d paths, expected %d"),
+							Frame, Observer.Path.IsValid() ? *Observer.Path.ToString() : TEXT(""), Paths ? Paths->Num() : 0, Pair.Value.Num());
+						++NumFailures;
+					}
+				}
+			}
+
+			Ar.Logf(TEXT("State observer verification %s: %d frames, %d callbacks, %d observers left"),
+				NumFailures == 0 ? TEXT("passed") : TEXT("FAILED"), NumFrames, NumCalls, Observers.Num());
+		}));
+
+	// Many handlers each owning one key: waking all of them per request to look their key up, against routing the request's
+	// changed paths to the handlers that own them
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GBenchmarkStateObserversCommand(
+		TEXT("ZLCloudPlugin.State.BenchmarkObservers"),
+		TEXT("Times per request handler wake ups broadcast to everyone against key path observers. Usage: ZLCloudPlugin.State.BenchmarkObservers [Listeners] [Requests] [KeysPerRequest]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const int32 NumListeners = FMath::Max(1, Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000);
+			const int32 NumRequests = FMath::Max(1, Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 1000);
+			const int32 KeysPerRequest = FMath::Max(1, Args.Num() > 2 ? FCString::Atoi(*Args[2]) : 3);
+			FRandomStream Random(1);
+
+			TArray<FZLStateKeyPath> Keys;
+			for (int32 i = 0; i < NumListeners; ++i)
+			{
+				Keys.Add(FZLStateKeyPath::Intern(FString::Printf(TEXT("Group%d.Key%d"), i % 32, i)));
+			}
+
+			TArray<TSharedPtr<FJsonObject>> Requests;
+			TArray<TArray<FZLStateKeyPath>> RequestPaths;
+			for (int32 i = 0; i < NumRequests; ++i)
+			{
+				TSharedPtr<FJsonObject> Request = MakeShared<FJsonObject>();
+				TArray<FZLStateKeyPath>& Paths = RequestPaths.AddDefaulted_GetRef();
+				for (int32 k = 0; k < KeysPerRequest; ++k)
+				{
+					const FZLStateKeyPath& Key = Keys[Random.RandRange(0, NumListeners - 1)];
+					SetRandomStateKey(Request, Key, MakeShared<FJsonValueNumber>(k));
+					Paths.Add(Key);
+				}
+				Requests.Add(Request);
+			}
+
+			// Every listener wakes for every request and looks its key up in it
+			int64 NumBroadcastHits = 0;
+			const double BroadcastStart = FPlatformTime::Seconds();
+			for (const TSharedPtr<FJsonObject>& Request : Requests)
+			{
+				for (const FZLStateKeyPath& Key : Keys)
+				{
+					TSharedPtr<FJsonObject> Parent = FZLStateKeyPathCache::WalkToParent(Request, Key);
+					if (Parent.IsValid() && FZLStateKeyPathCache::FindSegment(*Parent, Key.GetLeaf()))
+					{
+						++NumBroadcastHits;
+					}
+				}
+			}
+			const double BroadcastSeconds = FPlatformTime::Seconds() - BroadcastStart;
+
+			// Only the listeners whose keys changed are called, once per request as a frame
+			FZLStateObservers Observers;
+			int64 NumObserverHits = 0;
+			for (const FZLStateKeyPath& Key : Keys)
+			{
+				Observers.Subscribe(EZLStateObserverSource::Requested, Key, FZLOnStatePathsChanged::CreateLambda([&NumObserverHits](const TArray<FZLStateKeyPath>& Paths)
+				{
+					NumObserverHits += Paths.Num();
+				}));
+			}
+			const double ObserverStart = FPlatformTime::Seconds();
+			for (const TArray<FZLStateKeyPath>& Paths : RequestPaths)
+			{
+				for (const FZLStateKeyPath& Path : Paths)
+				{
+					Observers.MarkChanged(EZLStateObserverSource::Requested, Path);
+				}
+				Observers.Dispatch();
+			}
+			const double ObserverSeconds = FPlatformTime::Seconds() - ObserverStart;
+
+			Ar.Logf(TEXT("%d listeners, %d requests of %d keys"), NumListeners, NumRequests, KeysPerRequest);
+			Ar.Logf(TEXT("  Broadcast and look up: %.2fms, %lld hits"), BroadcastSeconds * 1000.0, NumBroadcastHits);
+			Ar.Logf(TEXT("  Key path observers:    %.2fms, %lld hits (%.1fx)"), ObserverSeconds * 1000.0, NumObserverHits, ObserverSeconds > 0.0 ? BroadcastSeconds / ObserverSeconds : 0.0);
+		}));
+
+	// The same requests pulled and the same app changes set a key at a time against the batch calls, which share parent lookups and the web push
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GBenchmarkBatchStateCommand(
+		TEXT("ZLCloudPlugin.State.BenchmarkBatchState"),
+		TEXT("Times looped single key requested state gets and current state sets against the batch versions. Usage: ZLCloudPlugin.State.BenchmarkBatchState [Keys] [Iterations]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const int32 NumKeys = FMath::Max(1, Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 256);
+			const int32 NumIterations = FMath::Max(1, Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 100);
+
+			TArray<FString> Keys;
+			for (int32 i = 0; i < NumKeys; ++i)
+			{
+				Keys.Add(FString::Printf(TEXT("Group%d.Sub%d.Key%d"), i % 8, (i / 8) % 4, i));
+			}
+
+			UZLCloudPluginStateManager* Looped = UZLCloudPluginStateManager::CreateDetachedInstance(nullptr);
+			UZLCloudPluginStateManager* Batched = UZLCloudPluginStateManager::CreateDetachedInstance(nullptr);
+			for (UZLCloudPluginStateManager* Manager : { Looped, Batched })
+			{
+				Manager->AddToRoot();
+				Manager->SetWebMessageHandler([](const FString&) {});
+				Manager->SetStateRequestHandler([](const TSharedPtr<FJsonObject>&) {});
+			}
+
+			double LoopedGetSeconds = 0.0;
+			double BatchedGetSeconds = 0.0;
+			double LoopedSetSeconds = 0.0;
+			double BatchedSetSeconds = 0.0;
+			int32 NumMismatches = 0;
+			TMap<FString, TSharedPtr<FJsonValue>> Values;
+
+			for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+			{
+				// Every key requested with a new value
+				TSharedPtr<FJsonObject> Request = MakeShared<FJsonObject>();
+				for (int32 i = 0; i < NumKeys; ++i)
+				{
+					SetRandomStateKey(Request, FZLStateKeyPath::Intern(Keys[i]), MakeShared<FJsonValueNumber>(Iteration * NumKeys + i));
+				}
+				FString RequestJson;
+				TSharedRef<TJsonWriter<TCHAR>> JsonWriter = TJsonWriterFactory<TCHAR>::Create(&RequestJson);
+				FJsonSerializer::Serialize(Request.ToSharedRef(), JsonWriter);
+				JsonWriter->Close();
+
+				bool bStarted = false;
+				Looped->ProcessState(RequestJson, false, bStarted);
+				Batched->ProcessState(RequestJson, false, bStarted);
+
+				double StartTime = FPlatformTime::Seconds();
+				for (const FString& Key : Keys)
+				{
+					double Value = 0.0;
+					bool bSuccess = false;
+					Looped->GetRequestedStateValue<double>(Key, true, Value, bSuccess);
+				}
+				LoopedGetSeconds += FPlatformTime::Seconds() - StartTime;
+
+				Values.Reset();
+				StartTime = FPlatformTime::Seconds();
+				Batched->GetRequestedStateValues(Keys, true, Values);
+				BatchedGetSeconds += FPlatformTime::Seconds() - StartTime;
+
+				Looped->Update(nullptr);
+				Batched->Update(nullptr);
+
+				// The app then changes every key itself
+				Values.Reset();
+				for (int32 i = 0; i < NumKeys; ++i)
+				{
+					Values.Add(Keys[i], MakeShared<FJsonValueNumber>(-(Iteration * NumKeys + i)));
+				}
+
+				StartTime = FPlatformTime::Seconds();
+				for (int32 i = 0; i < NumKeys; ++i)
+				{
+					Looped->SetCurrentStateValue<double>(Keys[i], -(Iteration * NumKeys + i), false);
+				}
+				LoopedSetSeconds += FPlatformTime::Seconds() - StartTime;
+
+				StartTime = FPlatformTime::Seconds();
+				Batched->SetCurrentStateValues(Values);
+				BatchedSetSeconds += FPlatformTime::Seconds() - StartTime;
+
+				Looped->Update(nullptr);
+				Batched->Update(nullptr);
+
+				if (!JsonObjectsMatch(Looped->GetCurrentAppState(), Batched->GetCurrentAppState()) || Looped->IsProcessingStateRequest() || Batched->IsProcessingStateRequest())
+				{
+					++NumMismatches;
+				}
+			}
+
+			for (UZLCloudPluginStateManager* Manager : { Looped, Batched })
+			{
+				Manager->SetWebMessageHandler(nullptr);
+				Manager->SetStateRequestHandler(nullptr);
+				Manager->RemoveFromRoot();
+			}
+
+			Ar.Logf(TEXT("%d keys, %d iterations"), NumKeys, NumIterations);
+			Ar.Logf(TEXT("  Get looped:  %.2fms"), LoopedGetSeconds * 1000.0);
+			Ar.Logf(TEXT("  Get batched: %.2fms (%.1fx)"), BatchedGetSeconds * 1000.0, BatchedGetSeconds > 0.0 ? LoopedGetSeconds / BatchedGetSeconds : 0.0);
+			Ar.Logf(TEXT("  Set looped:  %.2fms"), LoopedSetSeconds * 1000.0);
+			Ar.Logf(TEXT("  Set batched: %.2fms (%.1fx)"), BatchedSetSeconds * 1000.0, BatchedSetSeconds > 0.0 ? LoopedSetSeconds / BatchedSetSeconds : 0.0);
+			Ar.Logf(TEXT("Batched state matches looped: %s"), NumMismatches == 0 ? TEXT("passed") : TEXT("FAILED"));
+		}));
+
+	// Brute force FZLStateKeyQuery::FindMatching for one key, split into segments like the pattern
+	bool KeyMatchesPattern(const TArray<FString>& Key, int32 KeyIndex, const TArray<FString>& Pattern, int32 PatternIndex)
+	{
+		if (PatternIndex == Pattern.Num())
+		{
+			return KeyIndex == Key.Num();
+		}
+		if (Pattern[PatternIndex] == TEXT("**"))
+		{
+			for (int32 i = KeyIndex; i <= Key.Num(); ++i)
+			{
+				if (KeyMatchesPattern(Key, i, Pattern, PatternIndex + 1))
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+		return KeyIndex < Key.Num() && Key[KeyIndex].MatchesWildcard(Pattern[PatternIndex], ESearchCase::IgnoreCase)
+			&& KeyMatchesPattern(Key, KeyIndex + 1, Pattern, PatternIndex + 1);
+	}
+
+	// Brute force FZLStateKeyQuery::FindByPrefix for one key
+	bool KeyMatchesPrefix(const TArray<FString>& Key, const FString& Prefix)
+	{
+		TArray<FString> Segments;
+		FZLStateKeyQuery::Split(Prefix, Segments);
+		FString Partial;
+		if (Segments.Num() > 0 && !Prefix.EndsWith(TEXT(".")))
+		{
+			Partial = Segments.Pop();
+		}
+		if (Key.Num() < Segments.Num() + (Partial.IsEmpty() ? 0 : 1))
+		{
+			return false;
+		}
+		for (int32 i = 0; i < Segments.Num(); ++i)
+		{
+			if (!Key[i].Equals(Segments[i], ESearchCase::IgnoreCase))
+			{
+				return false;
+			}
+		}
+		return Partial.IsEmpty() || Key[Segments.Num()].StartsWith(Partial, ESearchCase::IgnoreCase);
+	}
+
+	// Brute force FZLStateKeyQuery::GetChildren, the first Parent.Num() + 1 segments of every key below Parent
+	void AddKeyAsChild(const TArray<FString>& Key, const TArray<FString>& Parent, bool bIncludeParents, TSet<FString>& OutChildren)
+	{
+		if (Key.Num() <= Parent.Num() || (!bIncludeParents && Key.Num() != Parent.Num() + 1))
+		{
+			return;
+		}
+		for (int32 i = 0; i < Parent.Num(); ++i)
+		{
+			if (!Key[i].Equals(Parent[i], ESearchCase::IgnoreCase))
+			{
+				return;
+			}
+		}
+		OutChildren.Add(FString::Join(TArrayView<const FString>(Key.GetData(), Parent.Num() + 1), TEXT(".")).ToLower());
+	}
+
+	// Non object, non null values of a state tree, the keys the current state queries report
+	void CollectStateKeys(const TSharedPtr<FJsonObject>& Object, const FString& Prefix, TArray<FString>& OutKeys)
+	{
+		for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : Object->Values)
+		{
+			const FString Path = Prefix.IsEmpty() ? Pair.Key : Prefix + TEXT(".") + Pair.Key;
+			if (Pair.Value->Type == EJson::Object)
+			{
+				CollectStateKeys(Pair.Value->AsObject(), Path, OutKeys);
+			}
+			else if (Pair.Value->Type != EJson::Null)
+			{
+				OutKeys.Add(Path);
+			}
+		}
+	}
+
+	TSet<FString> LowerCaseSet(const TArray<FString>& Keys)
+	{
+		TSet<FString> Set;
+		for (const FString& Key : Keys)
+		{
+			Set.Add(Key.ToLower());
+		}
+		return Set;
+	}
+
+	bool SameKeys(const TSet<FString>& A, const TSet<FString>& B)
+	{
+		return A.Num() == B.Num() && A.Includes(B);
+	}
+
+	// Checks child, prefix and wildcard lookups on the schema key trie and the current state tree against brute force matching of every key
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GVerifyStateKeyTrieCommand(
+		TEXT("ZLCloudPlugin.State.VerifyKeyTrie"),
+		TEXT("Fuzzes state key trie lookups against brute force matching. Usage: ZLCloudPlugin.State.VerifyKeyTrie [Steps] [Seed]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const int32 NumSteps = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 2000;
+			FRandomStream Random(Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 1);
+
+			FZLStateKeyTrie Trie;
+			TSet<FString> SchemaKeys;
+
+			UZLCloudPluginStateManager* Manager = UZLCloudPluginStateManager::CreateDetachedInstance(nullptr);
+			Manager->AddToRoot();
+			Manager->SetWebMessageHandler([](const FString&) {});
+
+			const TCHAR* PatternSegments[] = { TEXT("k0"), TEXT("K1"), TEXT("k2"), TEXT("*"), TEXT("k?"), TEXT("**"), TEXT("x*") };
+			int32 NumFailures = 0;
+
+			for (int32 Step = 0; Step < NumSteps && NumFailures < 10; ++Step)
+			{
+				// Keys come and go from both the schema trie and the current state
+				const FString Key = MakeRandomStateKey(Random);
+				if (Random.RandRange(0, 2) > 0)
+				{
+					const bool bAdded = Trie.Add(Key);
+					bool bAlreadyInSet = false;
+					SchemaKeys.Add(Key, &bAlreadyInSet);
+					if (bAdded == bAlreadyInSet)
+					{
+						Ar.Logf(ELogVerbosity::Error, TEXT("Step %d: Add(%s) returned %d"), Step, *Key, bAdded);
+						++NumFailures;
+					}
+
+					TMap<FString, TSharedPtr<FJsonValue>> Values;
+					Values.Add(Key, Random.RandRange(0, 9) == 0 ? MakeShared<FJsonValueObject>(MakeShared<FJsonObject>()) : MakeRandomStateValue(Random));
+					Manager->SetCurrentStateValues(Values);
+				}
+				else
+				{
+					const bool bRemoved = Trie.Remove(Key);
+					if (bRemoved != (SchemaKeys.Remove(Key) > 0))
+					{
+						Ar.Logf(ELogVerbosity::Error, TEXT("Step %d: Remove(%s) returned %d"), Step, *Key, bRemoved);
+						++NumFailures;
+					}
+					Manager->RemoveCurrentStateValue(Key);
+				}
+
+				TArray<FString> StateKeys;
+				CollectStateKeys(Manager->GetCurrentAppState(), FString(), StateKeys);
+
+				if (Trie.Num() != SchemaKeys.Num())
+				{
+					Ar.Logf(ELogVerbosity::Error, TEXT("Step %d: trie has %d keys, expected %d"), Step, Trie.Num(), SchemaKeys.Num());
+					++NumFailures;
+				}
+
+				// One query of each kind against both sets of keys
+				TArray<FString> Pattern;
+				for (int32 i = Random.RandRange(1, 4); i > 0; --i)
+				{
+					Pattern.Add(PatternSegments[Random.RandRange(0, UE_ARRAY_COUNT(PatternSegments) - 1)]);
+				}
+				const FString PatternString = FString::Join(Pattern, TEXT("."));
+
+				FString Prefix = MakeRandomStateKey(Random).ToUpper();
+				Prefix.LeftChopInline(Random.RandRange(0, 2));
+				TArray<FString> Parent;
+				FZLStateKeyQuery::Split(Random.RandRange(0, 4) == 0 ? FString() : MakeRandomStateKey(Random), Parent);
+				const FString ParentString = FString::Join(Parent, TEXT("."));
+				const bool bIncludeParents = Random.RandBool();
+
+				for (int32 Source = 0; Source < 2; ++Source)
+				{
+					TArray<FString> KeyList = Source == 0 ? SchemaKeys.Array() : StateKeys;
+					TSet<FString> ExpectedMatches;
+					TSet<FString> ExpectedPrefixed;
+					TSet<FString> ExpectedChildren;
+					for (const FString& Candidate : KeyList)
+					{
+						TArray<FString> Segments;
+						FZLStateKeyQuery::Split(Candidate, Segments);
+						if (KeyMatchesPattern(Segments, 0, Pattern, 0))
+						{
+							ExpectedMatches.Add(Candidate.ToLower());
+						}
+						if (KeyMatchesPrefix(Segments, Prefix))
+						{
+							ExpectedPrefixed.Add(Candidate.ToLower());
+						}
+						AddKeyAsChild(Segments, Parent, bIncludeParents, ExpectedChildren);
+					}
+
+					TArray<FString> Matches;
+					TArray<FString> Prefixed;
+					TArray<FString> Children;
+					if (Source == 0)
+					{
+						Trie.FindMatching(PatternString, Matches);
+						Trie.FindByPrefix(Prefix, Prefixed);
+						Trie.GetChildren(ParentString, bIncludeParents, Children);
+					}
+					else
+					{
+						Manager->FindStateKeys(PatternString, Matches);
+						Manager->FindStateKeysByPrefix(Prefix, Prefixed);
+						Manager->GetStateSubKeys(ParentString, bIncludeParents, Children);
+					}
+
+					const TCHAR* SourceName = Source == 0 ? TEXT("schema trie") : TEXT("current state");
+					if (Matches.Num() != ExpectedMatches.Num() || !SameKeys(LowerCaseSet(Matches), ExpectedMatches))
+					{
+						Ar.Logf(ELogVerbosity::Error, TEXT("Step %d: %s matched %d keys for %s, expected %d"), Step, SourceName, Matches.Num(), *PatternString, ExpectedMatches.Num());
+						++NumFailures;
+					}
+					if (Prefixed.Num() != ExpectedPrefixed.Num() || !SameKeys(LowerCaseSet(Prefixed), ExpectedPrefixed))
+					{
+						Ar.Logf(ELogVerbosity::Error, TEXT("Step %d: %s found %d keys for prefix %s, expected %d"), Step, SourceName, Prefixed.Num(), *Prefix, ExpectedPrefixed.Num());
+						++NumFailures;
+					}
+					if (Children.Num() != ExpectedChildren.Num() || !SameKeys(LowerCaseSet(Children), ExpectedChildren))
+					{
+						Ar.Logf(ELogVerbosity::Error, TEXT("Step %d: %s found %d children of '%s', expected %d"), Step, SourceName, Children.Num(), *ParentString, ExpectedChildren.Num());
+						++NumFailures;
+					}
+				}
+			}
+
+			Manager->SetWebMessageHandler(nullptr);
+			Manager->RemoveFromRoot();
+
+			Ar.Logf(TEXT("State key trie verification, %d steps: %s"), NumSteps, NumFailures == 0 ? TEXT("passed") : TEXT("FAILED"));
+		}));
+
+	// The schema sub key node and key picker scans over every key against the trie lookups that replaced them
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GBenchmarkStateKeyTrieCommand(
+		TEXT("ZLCloudPlugin.State.BenchmarkKeyTrie"),
+		TEXT("Times schema sub key enumeration and wildcard search by scanning every key against the key trie. Usage: ZLCloudPlugin.State.BenchmarkKeyTrie [Keys] [Lookups]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const int32 NumKeys = FMath::Max(1, Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 20000);
+			const int32 NumLookups = FMath::Max(1, Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 1000);
+			const int32 NumGroups = FMath::Max(1, NumKeys / 256);
+			FRandomStream Random(1);
+
+			UStateKeyInfoAsset* Asset = NewObject<UStateKeyInfoAsset>();
+			for (int32 i = 0; i < NumKeys; ++i)
+			{
+				Asset->KeyInfos.Add(FString::Printf(TEXT("Group%d.Sub%d.Key%d"), i % NumGroups, (i / NumGroups) % 16, i));
+			}
+
+			TArray<FString> Parents;
+			TArray<FString> Patterns;
+			for (int32 i = 0; i < NumLookups; ++i)
+			{
+				const int32 Group = Random.RandRange(0, NumGroups - 1);
+				Parents.Add(FString::Printf(TEXT("Group%d.Sub%d"), Group, Random.RandRange(0, 15)));
+				Patterns.Add(FString::Printf(TEXT("Group%d.*.Key%d*"), Group, Random.RandRange(0, 9)));
+			}
+
+			const double BuildStart = FPlatformTime::Seconds();
+			Asset->GetKeyTrie();
+			const double BuildSeconds = FPlatformTime::Seconds() - BuildStart;
+
+			// How GetRequestedSchemaValueSubKeys found children before the trie
+			int64 NumScanChildren = 0;
+			double StartTime = FPlatformTime::Seconds();
+			for (const FString& ParentKey : Parents)
+			{
+				for (const TPair<FString, FStateKeyInfo>& Pair : Asset->KeyInfos)
+				{
+					if (Pair.Key.StartsWith(ParentKey + "."))
+					{
+						FString SubPath = Pair.Key.RightChop(ParentKey.Len() + 1);
+						if (!SubPath.Contains("."))
+						{
+							++NumScanChildren;
+						}
+					}
+				}
+			}
+			const double ScanChildrenSeconds = FPlatformTime::Seconds() - StartTime;
+
+			int64 NumTrieChildren = 0;
+			StartTime = FPlatformTime::Seconds();
+			for (const FString& ParentKey : Parents)
+			{
+				TArray<FString> Children;
+				Asset->GetKeyTrie().GetChildren(ParentKey, false, Children);
+				NumTrieChildren += Children.Num();
+			}
+			const double TrieChildrenSeconds = FPlatformTime::Seconds() - StartTime;
+
+			int64 NumScanMatches = 0;
+			StartTime = FPlatformTime::Seconds();
+			for (const FString& PatternString : Patterns)
+			{
+				TArray<FString> Pattern;
+				FZLStateKeyQuery::Split(PatternString, Pattern);
+				for (const TPair<FString, FStateKeyInfo>& Pair : Asset->KeyInfos)
+				{
+					TArray<FString> Segments;
+					FZLStateKeyQuery::Split(Pair.Key, Segments);
+					NumScanMatches += KeyMatchesPattern(Segments, 0, Pattern, 0) ? 1 : 0;
+				}
+			}
+			const double ScanMatchSeconds = FPlatformTime::Seconds() - StartTime;
+
+			int64 NumTrieMatches = 0;
+			StartTime = FPlatformTime::Seconds();
+			for (const FString& PatternString : Patterns)
+			{
+				TArray<FString> Matches;
+				Asset->GetKeyTrie().FindMatching(PatternString, Matches);
+				NumTrieMatches += Matches.Num();
+			}
+			const double TrieMatchSeconds = FPlatformTime::Seconds() - StartTime;
+
+			Ar.Logf(TEXT("%d schema keys, %d lookups, trie built in %.2fms"), NumKeys, NumLookups, BuildSeconds * 1000.0);
+			Ar.Logf(TEXT("  Children by scan:  %.2fms, %lld keys"), ScanChildrenSeconds * 1000.0, NumScanChildren);
+			Ar.Logf(TEXT("  Children by trie:  %.2fms, %lld keys (%.1fx)"), TrieChildrenSeconds * 1000.0, NumTrieChildren, TrieChildrenSeconds > 0.0 ? ScanChildrenSeconds / TrieChildrenSeconds : 0.0);
+			Ar.Logf(TEXT("  Wildcard by scan:  %.2fms, %lld keys"), ScanMatchSeconds * 1000.0, NumScanMatches);
+			Ar.Logf(TEXT("  Wildcard by trie:  %.2fms, %lld keys (%.1fx)"), TrieMatchSeconds * 1000.0, NumTrieMatches, TrieMatchSeconds > 0.0 ? ScanMatchSeconds / TrieMatchSeconds : 0.0);
+		}));
+
+	// Takes a snapshot after every few random changes to a large state, checks each one matches the state it was taken from and that
+	// none of the snapshots still held is ever modified, then compares what they hold against full structure copies
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GVerifyStateSnapshotsCommand(
+		TEXT("ZLCloudPlugin.State.VerifySnapshots"),
+		TEXT("Fuzzes FZLStateTree snapshots and measures their memory and time against structure copies. Usage: ZLCloudPlugin.State.VerifySnapshots [Keys] [Steps] [Held] [Seed]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const int32 NumKeys = FMath::Max(1, Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 10000);
+			const int32 NumSteps = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 1000;
+			const int32 NumHeld = FMath::Max(1, Args.Num() > 2 ? FCString::Atoi(*Args[2]) : 16);
+			FRandomStream Random(Args.Num() > 3 ? FCString::Atoi(*Args[3]) : 1);
+
+			// Three levels with a fan out of 8 at the top two, like a schema of grouped options
+			auto MakeKey = [](int32 Index)
+			{
+				return FZLStateKeyPath::Intern(FString::Printf(TEXT("Group%d.Section%d.Option%d"), Index % 8, (Index / 8) % 8, Index / 64));
+			};
+
+			TSharedPtr<FJsonObject> Current = MakeShared<FJsonObject>();
+			for (int32 i = 0; i < NumKeys; ++i)
+			{
+				SetRandomStateKey(Current, MakeKey(i), MakeRandomStateValue(Random));
+			}
+
+			FZLStateTree Tree;
+			Tree.Reset(Current);
+
+			struct FHeldSnapshot
+			{
+				TSharedPtr<FJsonObject> State;
+				uint64 Hash = 0;
+			};
+			TArray<FHeldSnapshot> Held;
+			int32 NumFailures = 0;
+			int32 NumReused = 0;
+			double SnapshotSeconds = 0.0;
+
+			for (int32 Step = 0; Step < NumSteps && NumFailures < 10; ++Step)
+			{
+				// Some steps change nothing, those must hand back the same snapshot
+				for (int32 i = Random.RandRange(-1, 3); i > 0; --i)
+				{
+					const FZLStateKeyPath Key = MakeKey(Random.RandRange(0, NumKeys - 1));
+					if (Random.RandRange(0, 9) == 0)
+					{
+						TSharedPtr<FJsonObject> Parent = FZLStateKeyPathCache::WalkToParent(Current, Key);
+						if (Parent.IsValid())
+						{
+							Parent->RemoveField(Key.GetLeaf().Name);
+						}
+					}
+					else
+					{
+						SetRandomStateKey(Current, Key, MakeRandomStateValue(Random));
+					}
+					Tree.MarkChanged(Key);
+				}
+
+				const TSharedPtr<FJsonObject> Previous = Held.Num() > 0 ? Held.Last().State : nullptr;
+				const double StartTime = FPlatformTime::Seconds();
+				FHeldSnapshot Snapshot;
+				Snapshot.State = Tree.GetSnapshot();
+				SnapshotSeconds += FPlatformTime::Seconds() - StartTime;
+				Snapshot.Hash = Tree.GetHash();
+				NumReused += Snapshot.State == Previous ? 1 : 0;
+
+				if (GetJsonValueHash64(MakeShared<FJsonValueObject>(Snapshot.State)) != Snapshot.Hash)
+				{
+					Ar.Logf(ELogVerbosity::Error, TEXT("Snapshot differs from the state it was taken from at step %d"), Step);
+					++NumFailures;
+				}
+
+				Held.Add(Snapshot);
+				if (Held.Num() > NumHeld)
+				{
+					Held.RemoveAt(0);
+				}
+
+				for (const FHeldSnapshot& Earlier : Held)
+				{
+					if (GetJsonValueHash64(MakeShared<FJsonValueObject>(Earlier.State)) != Earlier.Hash)
+					{
+						Ar.Logf(ELogVerbosity::Error, TEXT("A held snapshot was modified by the changes at step %d"), Step);
+						++NumFailures;
+						break;
+					}
+				}
+			}
+
+			// The same states as full structure copies, what the web copies held before
+			TArray<TSharedPtr<FJsonObject>> Copies;
+			const double CopyStartTime = FPlatformTime::Seconds();
+			for (const FHeldSnapshot& Snapshot : Held)
+			{
+				Copies.Add(CopyJsonObjectStructure(Snapshot.State));
+			}
+			const double CopySeconds = (FPlatformTime::Seconds() - CopyStartTime) / FMath::Max(1, Held.Num());
+
+			FZLJsonMemoryCounter SnapshotCounter;
+			FZLJsonMemoryUsage SnapshotUsage = SnapshotCounter.Count(Current);
+			const int64 CurrentBytes = SnapshotUsage.Bytes;
+			for (const FHeldSnapshot& Snapshot : Held)
+			{
+				SnapshotUsage += SnapshotCounter.Count(Snapshot.State);
+			}
+
+			FZLJsonMemoryCounter CopyCounter;
+			FZLJsonMemoryUsage CopyUsage = CopyCounter.Count(Current);
+			for (const TSharedPtr<FJsonObject>& Copy : Copies)
+			{
+				CopyUsage += CopyCounter.Count(Copy);
+			}
+
+			Ar.Logf(TEXT("State snapshot verification %s: %d keys, %d steps, %d snapshots reused unchanged"),
+				NumFailures == 0 ? TEXT("passed") : TEXT("FAILED"), NumKeys, NumSteps, NumReused);
+			Ar.Logf(TEXT("  Snapshot: %.3fms each, %d held take %.1fKB over the %.1fKB state"),
+				SnapshotSeconds * 1000.0 / FMath::Max(1, NumSteps), Held.Num(), (SnapshotUsage.Bytes - CurrentBytes) / 1024.0, CurrentBytes / 1024.0);
+			Ar.Logf(TEXT("  Structure copy: %.3fms each, %d held take %.1fKB (%.1fx), %.1fKB of it duplicate keys"),
+				CopySeconds * 1000.0, Copies.Num(), (CopyUsage.Bytes - CurrentBytes) / 1024.0,
+				SnapshotUsage.Bytes > CurrentBytes ? double(CopyUsage.Bytes - CurrentBytes) / double(SnapshotUsage.Bytes - CurrentBytes) : 0.0, CopyCounter.GetDuplicateKeyBytes() / 1024.0);
+		}));
+
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GStateMemoryCommand(
+		TEXT("ZLCloudPlugin.State.Memory"),
+		TEXT("Prints the estimated memory held by each of the state manager's JSON trees. Usage: ZLCloudPlugin.State.Memory"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			FZLStateMemoryReport Report;
+			UZLCloudPluginStateManager::GetZLCloudPluginStateManager()->GetStateMemoryReport(Report);
+			for (const FString& Line : Report.ToLines())
+			{
+				Ar.Log(Line);
+			}
+		}));
+
+	// The schema serialization as it was before caching: every key converted and linked in KeyInfos order on every call
+	TSharedRef<FJsonObject> SerializeSchemaDataReference(const UStateKeyInfoAsset* Schema)
+	{
+		TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
+		TSharedRef<FJsonObject> SchemaData = MakeShared<FJsonObject>();
+
+		for (const TPair<FString, FStateKeyInfo>& Pair : Schema->KeyInfos)
+		{
+			TSharedPtr<FJsonObject> EntryObject = ConvertInfoToSchemaDataEntry(Pair.Value);
+			if (!EntryObject.IsValid())
+			{
+				continue;
+			}
+
+			TArray<FString> KeyParts;
+			Pair.Key.ParseIntoArray(KeyParts, TEXT("."), true);
+
+			TSharedRef<FJsonObject> CurrentLevel = SchemaData;
+			for (int32 i = 0; i < KeyParts.Num(); ++i)
+			{
+				if (i == KeyParts.Num() - 1)
+				{
+					CurrentLevel->SetObjectField(KeyParts[i], EntryObject);
+				}
+				else
+				{
+					TSharedPtr<FJsonObject> Child = CurrentLevel->Values.Contains(KeyParts[i]) ? CurrentLevel->GetObjectField(KeyParts[i]) : MakeShared<FJsonObject>();
+					CurrentLevel->SetObjectField(KeyParts[i], Child);
+					CurrentLevel = Child.ToSharedRef();
+				}
+			}
+		}
+
+		Root->SetObjectField("ZEROLIGHT_SCHEMA_DATA", SchemaData);
+		return Root;
+	}
+
+	TSharedRef<FJsonObject> SerializeJsonSchemaReference(const UStateKeyInfoAsset* Schema)
+	{
+		TSharedRef<FJsonObject> RootSchema = MakeShared<FJsonObject>();
+		RootSchema->SetStringField("$schema", "https://json-schema.org/draft/2020-12/schema");
+		RootSchema->SetStringField("type", "object");
+		RootSchema->SetStringField("title", Schema->GetName());
+
+		TSharedPtr<FJsonObject> RootProperties = MakeShared<FJsonObject>();
+		RootSchema->SetObjectField("properties", RootProperties);
+
+		for (const TPair<FString, FStateKeyInfo>& Entry : Schema->KeyInfos)
+		{
+			TArray<FString> KeyParts;
+			Entry.Key.ParseIntoArray(KeyParts, TEXT("."), true);
+
+			TSharedPtr<FJsonObject> CurrentContext = RootProperties;
+			for (int32 i = 0; i < KeyParts.Num(); i++)
+			{
+				if (i == KeyParts.Num() - 1)
+				{
+					CurrentContext->SetObjectField(KeyParts[i], ConvertInfoToSchemaNode(Entry.Value));
+				}
+				else if (CurrentContext->HasField(KeyParts[i]))
+				{
+					TSharedPtr<FJsonObject> ExistingObj = CurrentContext->GetObjectField(KeyParts[i]);
+					if (!ExistingObj->HasField("properties"))
+					{
+						ExistingObj->SetObjectField("properties", MakeShared<FJsonObject>());
+					}
+					CurrentContext = ExistingObj->GetObjectField("properties");
+				}
+				else
+				{
+					TSharedPtr<FJsonObject> NewContainer = MakeShared<FJsonObject>();
+					NewContainer->SetStringField("type", "object");
+					TSharedPtr<FJsonObject> NewProperties = MakeShared<FJsonObject>();
+					NewContainer->SetObjectField("properties", NewProperties);
+					CurrentContext->SetObjectField(KeyParts[i], NewContainer);
+					CurrentContext = NewProperties;
+				}
+			}
+		}
+
+		return RootSchema;
+	}
+
+	FString SerializeCondensed(const TSharedRef<FJsonObject>& Object)
+	{
+		FString Out;
+		TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> JsonWriter = TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&Out);
+		FJsonSerializer::Serialize(Object, JsonWriter);
+		JsonWriter->Close();
+		return Out;
+	}
+
+	// Any data type including an invalid one, with limits, defaults and -0 now and then
+	FStateKeyInfo MakeRandomKeyInfo(FRandomStream& Random)
+	{
+		static const TCHAR* const DataTypes[] = { TEXT("String"), TEXT("StringArray"), TEXT("Number"), TEXT("NumberArray"), TEXT("Bool"), TEXT("BoolArray"), TEXT("Colour") };
+		auto RandomNumber = [&Random]() { return Random.RandRange(0, 9) == 0 ? -0.0 : Random.RandRange(-4, 4) * 0.5; };
+
+		FStateKeyInfo Info;
+		Info.DataType = DataTypes[Random.RandRange(0, UE_ARRAY_COUNT(DataTypes) - 1)];
+		Info.bLimitValues = Random.RandBool();
+		Info.bIgnoredInDataHashes = Random.RandRange(0, 3) == 0;
+		Info.DefaultStringValue = Random.RandBool() ? FString() : FString::Printf(TEXT("s%d"), Random.RandRange(0, 3));
+		Info.DefaultNumberValue = RandomNumber();
+		Info.DefaultBoolValue = Random.RandBool();
+		for (int32 i = Random.RandRange(0, 3); i > 0; --i)
+		{
+			Info.DefaultStringArray.Add(FString::Printf(TEXT("s%d"), Random.RandRange(0, 3)));
+			Info.DefaultNumberArray.Add(RandomNumber());
+			Info.DefaultBoolArray.Add(Random.RandBool());
+			Info.AcceptedStringValues.Add(FString::Printf(TEXT("S%d"), Random.RandRange(0, 3)));
+			Info.AcceptedNumberValues.Add(RandomNumber());
+		}
+		return Info;
+	}
+
+	// Keys that are also parents of other keys, and keys sharing parents, so the order the tree is linked in matters
+	FString MakeRandomSchemaKey(FRandomStream& Random, int32 NumGroups)
+	{
+		const int32 Group = Random.RandRange(0, NumGroups - 1);
+		switch (Random.RandRange(0, 9))
+		{
+		case 0:
+			return FString::Printf(TEXT("Group%d"), Group);
+		case 1:
+			return FString::Printf(TEXT("Group%d.Key%d.Sub%d"), Group, Random.RandRange(0, 15), Random.RandRange(0, 1));
+		default:
+			return FString::Printf(TEXT("Group%d.Key%d"), Group, Random.RandRange(0, 15));
+		}
+	}
+
+	// Checks the cached schema serialization is byte for byte the full rebuild's, on a hand checked schema, then across random key
+	// edits made with and without the per key notifications, and times both
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GVerifySchemaSerializationCommand(
+		TEXT("ZLCloudPlugin.State.VerifySchemaSerialization"),
+		TEXT("Checks cached schema serialization against the full rebuild and times both. Usage: ZLCloudPlugin.State.VerifySchemaSerialization [Keys] [Edits] [Seed]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const int32 NumKeys = FMath::Max(1, Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 2000);
+			const int32 NumEdits = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 500;
+			FRandomStream Random(Args.Num() > 2 ? FCString::Atoi(*Args[2]) : 1);
+			int32 NumFailures = 0;
+
+			// Golden output, $schema is left out of the comparison so it doesn't depend on how the writer escapes its URL
+			{
+				UStateKeyInfoAsset* Golden = NewObject<UStateKeyInfoAsset>();
+				FStateKeyInfo& Colour = Golden->KeyInfos.Add(TEXT("Car.Colour"));
+				Colour.bLimitValues = true;
+				Colour.DefaultStringValue = TEXT("Red");
+				Colour.AcceptedStringValues = { TEXT("Red"), TEXT("Green") };
+				FStateKeyInfo& Lights = Golden->KeyInfos.Add(TEXT("Car.Lights"));
+				Lights.DataType = TEXT("Bool");
+				Lights.DefaultBoolValue = true;
+				FStateKeyInfo& Options = Golden->KeyInfos.Add(TEXT("Options"));
+				Options.DataType = TEXT("StringArray");
+				Options.DefaultStringArray = { TEXT("Roof") };
+
+				const FString ExpectedSchemaData = TEXT("{\"ZEROLIGHT_SCHEMA_DATA\":{\"Car\":{")
+					TEXT("\"Colour\":{\"DataType\":\"String\",\"bLimitValues\":true,\"bIgnoredInDataHashes\":false,\"DefaultValue\":\"Red\",\"AcceptedValues\":[\"Red\",\"Green\"]},")
+					TEXT("\"Lights\":{\"DataType\":\"Bool\",\"bLimitValues\":false,\"bIgnoredInDataHashes\":false,\"DefaultValue\":true}},")
+					TEXT("\"Options\":{\"DataType\":\"StringArray\",\"bLimitValues\":false,\"bIgnoredInDataHashes\":false,\"DefaultValue\":[\"Roof\"]}}}");
+				const FString ExpectedJsonSchema = FString::Printf(TEXT("{\"type\":\"object\",\"title\":\"%s\",\"properties\":{\"Car\":{\"type\":\"object\",\"properties\":{")
+					TEXT("\"Colour\":{\"type\":\"string\",\"enum\":[\"Red\",\"Green\"],\"default\":\"Red\"},")
+					TEXT("\"Lights\":{\"type\":\"boolean\",\"default\":true}}},")
+					TEXT("\"Options\":{\"type\":\"array\",\"items\":{\"type\":\"string\"},\"default\":[\"Roof\"]}}}"), *Golden->GetName());
+
+				// Twice, the second from the cache
+				for (int32 Pass = 0; Pass < 2; ++Pass)
+				{
+					TSharedRef<FJsonObject> JsonSchema = Golden->SerializeStateKeyAsset_JsonSchemaCompliant();
+					JsonSchema->RemoveField("$schema");
+					if (SerializeCondensed(Golden->SerializeStateKeyAssetToJson()) != ExpectedSchemaData || SerializeCondensed(JsonSchema) != ExpectedJsonSchema)
+					{
+						Ar.Logf(ELogVerbosity::Error, TEXT("Golden schema serialization differs on pass %d"), Pass);
+						++NumFailures;
+					}
+				}
+			}
+
+			const int32 NumGroups = FMath::Max(1, NumKeys / 16);
+			UStateKeyInfoAsset* Schema = NewObject<UStateKeyInfoAsset>();
+			while (Schema->KeyInfos.Num() < NumKeys)
+			{
+				Schema->KeyInfos.Add(MakeRandomSchemaKey(Random, NumGroups), MakeRandomKeyInfo(Random));
+			}
+
+			auto CheckMatches = [&](const TCHAR* When)
+			{
+				if (SerializeCondensed(Schema->SerializeStateKeyAssetToJson()) != SerializeCondensed(SerializeSchemaDataReference(Schema))
+					|| SerializeCondensed(Schema->SerializeStateKeyAsset_JsonSchemaCompliant()) != SerializeCondensed(SerializeJsonSchemaReference(Schema)))
+				{
+					Ar.Logf(ELogVerbosity::Error, TEXT("Cached schema serialization differs from the full rebuild %s"), When);
+					++NumFailures;
+				}
+			};
+			CheckMatches(TEXT("when first built"));
+
+			for (int32 Edit = 0; Edit < NumEdits && NumFailures < 10; ++Edit)
+			{
+				const FString Key = MakeRandomSchemaKey(Random, NumGroups);
+				switch (Random.RandRange(0, 3))
+				{
+				case 0:
+					if (Schema->KeyInfos.Remove(Key) > 0)
+					{
+						Schema->OnKeyRemoved(Key);
+					}
+					break;
+				case 1:
+					if (!Schema->KeyInfos.Contains(Key))
+					{
+						Schema->KeyInfos.Add(Key, MakeRandomKeyInfo(Random));
+						Schema->OnKeyAdded(Key);
+					}
+					break;
+				case 2:
+					if (FStateKeyInfo* Info = Schema->KeyInfos.Find(Key))
+					{
+						*Info = MakeRandomKeyInfo(Random);
+						Schema->OnKeyChanged(Key);
+					}
+					break;
+				default:
+					// As the details panel does, edited in place and only told something changed
+					if (FStateKeyInfo* Info = Schema->KeyInfos.Find(Key))
+					{
+						Info->AcceptedStringValues.Add(TEXT("Added"));
+						Info->DefaultNumberValue += 1.0;
+						Schema->InvalidateKeyCaches();
+					}
+					break;
+				}
+
+				CheckMatches(*FString::Printf(TEXT("after edit %d to %s"), Edit, *Key));
+			}
+
+			// Times a schema request with nothing changed, and with one key edited since the last one
+			const int32 NumRuns = 20;
+			double StartTime = FPlatformTime::Seconds();
+			for (int32 Run = 0; Run < NumRuns; ++Run)
+			{
+				SerializeSchemaDataReference(Schema);
+				SerializeJsonSchemaReference(Schema);
+			}
+			const double ReferenceMs = (FPlatformTime::Seconds() - StartTime) * 1000.0 / NumRuns;
+
+			StartTime = FPlatformTime::Seconds();
+			for (int32 Run = 0; Run < NumRuns; ++Run)
+			{
+				Schema->SerializeStateKeyAssetToJson();
+				Schema->SerializeStateKeyAsset_JsonSchemaCompliant();
+			}
+			const double CachedMs = (FPlatformTime::Seconds() - StartTime) * 1000.0 / NumRuns;
+
+			TArray<FString> Keys;
+			Schema->KeyInfos.GenerateKeyArray(Keys);
+			StartTime = FPlatformTime::Seconds();
+			for (int32 Run = 0; Run < NumRuns; ++Run)
+			{
+				const FString& Key = Keys[Random.RandRange(0, Keys.Num() - 1)];
+				Schema->KeyInfos[Key].DefaultNumberValue += 1.0;
+				Schema->OnKeyChanged(Key);
+				Schema->SerializeStateKeyAssetToJson();
+				Schema->SerializeStateKeyAsset_JsonSchemaCompliant();
+			}
+			const double EditedMs = (FPlatformTime::Seconds() - StartTime) * 1000.0 / NumRuns;
+
+			Ar.Logf(TEXT("Schema serialization verification %s: %d keys, %d edits"), NumFailures == 0 ? TEXT("passed") : TEXT("FAILED"), Schema->KeyInfos.Num(), NumEdits);
+			Ar.Logf(TEXT("  Full rebuild: %.3fms, cached: %.3fms, one key edited: %.3fms (both forms)"), ReferenceMs, CachedMs, EditedMs);
+		}));
+
+	// How nested keys were looked up before interning, splitting the key and hashing each segment on every call
+	const TSharedPtr<FJsonValue>* FindNestedKeyBySplitting(const TSharedPtr<FJsonObject>& Root, const FString& Key)
+	{
+		TArray<FString> Segments;
+		Key.ParseIntoArray(Segments, TEXT("."), true);
+		if (Segments.Num() == 0)
+		{
+			return nullptr;
+		}
+
+		TSharedPtr<FJsonObject> CurrentObject = Root;
+		for (int32 i = 0; i < Segments.Num() - 1; ++i)
+		{
+			const TSharedPtr<FJsonValue>* Value = CurrentObject->Values.Find(Segments[i]);
+			if (!Value || !Value->IsValid() || (*Value)->Type != EJson::Object)
+			{
+				return nullptr;
+			}
+			CurrentObject = (*Value)->AsObject();
+		}
+		return CurrentObject->Values.Find(Segments.Last());
+	}
+
+	// Checks the key path cache's hits, misses and invalidation, then times repeated nested lookups split every call,
+	// interned but walked every call, and through the cache
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GBenchmarkStateKeyPathsCommand(
+		TEXT("ZLCloudPlugin.State.BenchmarkKeyPaths"),
+		TEXT("Checks key path cache hit/miss accounting and invalidation, then times nested key lookups with and without interning and the cache. Usage: ZLCloudPlugin.State.BenchmarkKeyPaths [Lookups] [Keys] [Runs]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const int32 NumLookups = FMath::Max(1, Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 10000);
+			const int32 NumKeys = FMath::Max(1, Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 2000);
+			const int32 NumRuns = FMath::Max(1, Args.Num() > 2 ? FCString::Atoi(*Args[2]) : 10);
+			FRandomStream Random(1);
+
+			int32 NumFailures = 0;
+			auto Check = [&Ar, &NumFailures](bool bPassed, const FString& What)
+			{
+				if (!bPassed)
+				{
+					Ar.Logf(ELogVerbosity::Error, TEXT("  %s"), *What);
+					++NumFailures;
+				}
+			};
+
+			// Hit/miss accounting on a small tree
+			{
+				TSharedPtr<FJsonObject> State = MakeShared<FJsonObject>();
+				SetRandomStateKey(State, FZLStateKeyPath::Intern(TEXT("Trim.Paint.Colour")), MakeShared<FJsonValueString>(TEXT("Red")));
+				SetRandomStateKey(State, FZLStateKeyPath::Intern(TEXT("Trim.Wheels")), MakeShared<FJsonValueNumber>(19));
+
+				const FZLStateKeyPath Colour = FZLStateKeyPath::Intern(TEXT("Trim.Paint.Colour"));
+				const FZLStateKeyPath Wheels = FZLStateKeyPath::Intern(TEXT("Trim.Wheels"));
+				const FZLStateKeyPath Missing = FZLStateKeyPath::Intern(TEXT("Trim.Seats.Colour"));
+				const FZLStateKeyPath TopLevel = FZLStateKeyPath::Intern(TEXT("Trim"));
+
+				FZLStateKeyPathCache Cache;
+				auto CheckCounts = [&](uint64 Hits, uint64 Misses, const TCHAR* When)
+				{
+					Check(Cache.GetNumHits() == Hits && Cache.GetNumMisses() == Misses, FString::Printf(TEXT("%s: %llu hits and %llu misses, expected %llu and %llu"),
+						When, Cache.GetNumHits(), Cache.GetNumMisses(), Hits, Misses));
+				};
+
+				const TSharedPtr<FJsonValue>* Value = Cache.Find(State, Colour);
+				Check(Value && (*Value)->AsString() == TEXT("Red"), TEXT("Cached lookup of Trim.Paint.Colour is wrong"));
+				CheckCounts(0, 1, TEXT("First lookup"));
+
+				Cache.Find(State, Colour);
+				Cache.Find(State, Colour);
+				CheckCounts(2, 1, TEXT("Repeated lookups"));
+
+				Cache.Find(State, Wheels);
+				Check(Cache.Find(State, Missing) == nullptr, TEXT("Missing key found"));
+				Check(Cache.Find(State, Missing) == nullptr, TEXT("Cached missing key found"));
+				CheckCounts(3, 3, TEXT("Other and missing keys"));
+
+				// Top level keys never need the cache
+				Cache.Find(State, TopLevel);
+				CheckCounts(3, 3, TEXT("Top level key"));
+
+				// Adding the missing level only shows up once the owner invalidates
+				SetRandomStateKey(State, FZLStateKeyPath::Intern(TEXT("Trim.Seats.Colour")), MakeShared<FJsonValueString>(TEXT("Black")));
+				Cache.Invalidate();
+				Value = Cache.Find(State, Missing);
+				Check(Value && (*Value)->AsString() == TEXT("Black"), TEXT("Key added after invalidating wasn't found"));
+				CheckCounts(3, 4, TEXT("After invalidating"));
+
+				// Value changes at existing leaves don't need invalidating
+				SetRandomStateKey(State, FZLStateKeyPath::Intern(TEXT("Trim.Paint.Colour")), MakeShared<FJsonValueString>(TEXT("Blue")));
+				Value = Cache.Find(State, Colour);
+				Check(Value && (*Value)->AsString() == TEXT("Blue"), TEXT("Changed leaf value wasn't seen through the cache"));
+
+				// A different root drops every entry
+				TSharedPtr<FJsonObject> OtherState = MakeShared<FJsonObject>();
+				SetRandomStateKey(OtherState, FZLStateKeyPath::Intern(TEXT("Trim.Paint.Colour")), MakeShared<FJsonValueString>(TEXT("Green")));
+				const uint64 MissesBefore = Cache.GetNumMisses();
+				Value = Cache.Find(OtherState, Colour);
+				Check(Value && (*Value)->AsString() == TEXT("Green") && Cache.GetNumMisses() == MissesBefore + 1, TEXT("Replacing the root didn't invalidate the cache"));
+			}
+
+			// A wide state tree and lookups skewed towards a hot set of keys, as blueprints polling the same few keys every tick would be
+			TSharedPtr<FJsonObject> State = MakeShared<FJsonObject>();
+			TArray<FString> Keys;
+			for (int32 i = 0; i < NumKeys; ++i)
+			{
+				Keys.Add(FString::Printf(TEXT("Group%d.Sub%d.Item%d.Key%d"), i % 32, (i / 32) % 8, (i / 256) % 4, i));
+				SetRandomStateKey(State, FZLStateKeyPath::Intern(Keys.Last()), MakeShared<FJsonValueNumber>(i));
+			}
+
+			TArray<FString> LookupKeys;
+			for (int32 i = 0; i < NumLookups; ++i)
+			{
+				const int32 Roll = Random.RandRange(0, 99);
+				if (Roll < 5)
+				{
+					LookupKeys.Add(FString::Printf(TEXT("Group%d.Missing.Key%d"), Random.RandRange(0, 31), i % 16));
+				}
+				else
+				{
+					LookupKeys.Add(Keys[Roll < 80 ? Random.RandRange(0, FMath::Min(NumKeys, 64) - 1) : Random.RandRange(0, NumKeys - 1)]);
+				}
+			}
+
+			TArray<FZLStateKeyPath> LookupPaths;
+			for (const FString& Key : LookupKeys)
+			{
+				LookupPaths.Add(FZLStateKeyPath::Intern(Key));
+			}
+
+			// Every method must agree with splitting before any of them is timed
+			{
+				FZLStateKeyPathCache Cache;
+				int32 NumMismatches = 0;
+				for (int32 i = 0; i < NumLookups; ++i)
+				{
+					const TSharedPtr<FJsonValue>* Expected = FindNestedKeyBySplitting(State, LookupKeys[i]);
+					const TSharedPtr<FJsonObject> Parent = FZLStateKeyPathCache::WalkToParent(State, LookupPaths[i]);
+					const TSharedPtr<FJsonValue>* Walked = Parent.IsValid() ? FZLStateKeyPathCache::FindSegment(*Parent, LookupPaths[i].GetLeaf()) : nullptr;
+					const TSharedPtr<FJsonValue>* Cached = Cache.Find(State, LookupPaths[i]);
+					NumMismatches += (Expected != Walked || Expected != Cached) ? 1 : 0;
+				}
+				Check(NumMismatches == 0, FString::Printf(TEXT("%d of %d lookups disagree with splitting the key"), NumMismatches, NumLookups));
+			}
+
+			double Sum = 0.0;
+			auto Accumulate = [&Sum](const TSharedPtr<FJsonValue>* Value)
+			{
+				Sum += Value ? (*Value)->AsNumber() : 0.0;
+			};
+
+			double StartTime = FPlatformTime::Seconds();
+			for (int32 Run = 0; Run < NumRuns; ++Run)
+			{
+				for (const FString& Key : LookupKeys)
+				{
+					Accumulate(FindNestedKeyBySplitting(State, Key));
+				}
+			}
+			const double SplitSeconds = (FPlatformTime::Seconds() - StartTime) / NumRuns;
+
+			StartTime = FPlatformTime::Seconds();
+			for (int32 Run = 0; Run < NumRuns; ++Run)
+			{
+				for (const FZLStateKeyPath& Path : LookupPaths)
+				{
+					const TSharedPtr<FJsonObject> Parent = FZLStateKeyPathCache::WalkToParent(State, Path);
+					Accumulate(Parent.IsValid() ? FZLStateKeyPathCache::FindSegment(*Parent, Path.GetLeaf()) : nullptr);
+				}
+			}
+			const double WalkSeconds = (FPlatformTime::Seconds() - StartTime) / NumRuns;
+
+			// What the FString overloads cost, interning is a table lookup once the key has been seen
+			FZLStateKeyPathCache StringCache;
+			StartTime = FPlatformTime::Seconds();
+			for (int32 Run = 0; Run < NumRuns; ++Run)
+			{
+				for (const FString& Key : LookupKeys)
+				{
+					Accumulate(StringCache.Find(State, FZLStateKeyPath::Intern(Key)));
+				}
+			}
+			const double StringCachedSeconds = (FPlatformTime::Seconds() - StartTime) / NumRuns;
+
+			FZLStateKeyPathCache Cache;
+			StartTime = FPlatformTime::Seconds();
+			for (int32 Run = 0; Run < NumRuns; ++Run)
+			{
+				for (const FZLStateKeyPath& Path : LookupPaths)
+				{
+					Accumulate(Cache.Find(State, Path));
+				}
+			}
+			const double CachedSeconds = (FPlatformTime::Seconds() - StartTime) / NumRuns;
+
+			TSet<int32> DistinctPaths;
+			for (const FZLStateKeyPath& Path : LookupPaths)
+			{
+				DistinctPaths.Add(Path.GetId());
+			}
+			Check(Cache.GetNumMisses() == static_cast<uint64>(DistinctPaths.Num()) && Cache.GetNumHits() + Cache.GetNumMisses() == static_cast<uint64>(NumLookups) * NumRuns,
+				FString::Printf(TEXT("Benchmark cache had %llu hits and %llu misses for %d distinct keys over %d lookups"),
+					Cache.GetNumHits(), Cache.GetNumMisses(), DistinctPaths.Num(), NumLookups * NumRuns));
+
+			const double HitRate = 100.0 * Cache.GetNumHits() / FMath::Max<uint64>(Cache.GetNumHits() + Cache.GetNumMisses(), 1);
+			Ar.Logf(TEXT("%d nested keys, %d lookups of %d distinct keys, %d runs (checksum %.0f)"), NumKeys, NumLookups, DistinctPaths.Num(), NumRuns, Sum);
+			Ar.Logf(TEXT("  Split every call:    %.3fms"), SplitSeconds * 1000.0);
+			Ar.Logf(TEXT("  Interned, walked:    %.3fms (%.1fx)"), WalkSeconds * 1000.0, WalkSeconds > 0.0 ? SplitSeconds / WalkSeconds : 0.0);
+			Ar.Logf(TEXT("  Cached from FString: %.3fms (%.1fx)"), StringCachedSeconds * 1000.0, StringCachedSeconds > 0.0 ? SplitSeconds / StringCachedSeconds : 0.0);
+			Ar.Logf(TEXT("  Cached from handle:  %.3fms (%.1fx), %llu hits %llu misses (%.1f%% hit rate)"), CachedSeconds * 1000.0,
+				CachedSeconds > 0.0 ? SplitSeconds / CachedSeconds : 0.0, Cache.GetNumHits(), Cache.GetNumMisses(), HitRate);
+			Ar.Logf(TEXT("Key path cache verification %s"), NumFailures == 0 ? TEXT("passed") : TEXT("FAILED"));
+		}));
+
+	// Plays the page's side of the delta protocol against random state changes and checks every push rebuilds the exact state
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GVerifyStateWebSyncCommand(
+		TEXT("ZLCloudPlugin.State.VerifyWebSync"),
+		TEXT("Fuzzes merge patch pushes, acknowledgements and resyncs against a simulated page. Usage: ZLCloudPlugin.State.VerifyWebSync [Pushes] [Seed]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const int32 NumPushes = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000;
+			FRandomStream Random(Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 1);
+
+			TSharedPtr<FJsonObject> Current = MakeShared<FJsonObject>();
+			FZLStateTree Tree;
+			Tree.Reset(Current);
+
+			FZLStateWebSync Sync;
+			Sync.FullResyncInterval = 50;
+			Sync.SetDeltasEnabled(true);
+
+			// Every state the page has rebuilt, by sequence number
+			TMap<int32, TSharedPtr<FJsonObject>> PageStates;
+			int32 NumFailures = 0;
+
+			for (int32 Push = 0; Push < NumPushes && NumFailures < 10; ++Push)
+			{
+				for (int32 i = Random.RandRange(0, 3); i > 0; --i)
+				{
+					const FZLStateKeyPath Key = FZLStateKeyPath::Intern(MakeRandomStateKey(Random));
+					const int32 Action = Random.RandRange(0, 15);
+					if (Action < 10)
+					{
+						SetRandomStateKey(Current, Key, MakeRandomStateValue(Random));
+					}
+					else if (Action < 15)
+					{
+						TSharedPtr<FJsonObject> Parent = FZLStateKeyPathCache::WalkToParent(Current, Key);
+						if (Parent.IsValid())
+						{
+							Parent->RemoveField(Key.GetLeaf().Name);
+						}
+					}
+					else
+					{
+						// Nulls can't go in a merge patch and must force a full snapshot
+						SetRandomStateKey(Current, Key, MakeShared<FJsonValueNull>());
+					}
+					Tree.MarkChanged(Key);
+				}
+
+				TSharedPtr<FJsonObject> Payload = MakeShared<FJsonObject>();
+				const bool bFullSnapshot = Sync.WriteState(Tree, Payload);
+
+				FString Serialized;
+				TSharedRef<TJsonWriter<TCHAR>> JsonWriter = TJsonWriterFactory<TCHAR>::Create(&Serialized, 1);
+				FJsonSerializer::Serialize(Payload.ToSharedRef(), JsonWriter);
+				JsonWriter->Close();
+				Sync.RecordSent(bFullSnapshot, Serialized.Len());
+
+				const int32 Sequence = (int32)Payload->GetNumberField(TEXT("state_seq"));
+				TSharedPtr<FJsonObject> PageState;
+				const TSharedPtr<FJsonObject>* FullState = nullptr;
+				const TSharedPtr<FJsonObject>* Patch = nullptr;
+				if (Payload->TryGetObjectField(TEXT("current_state"), FullState))
+				{
+					PageState = CopyJsonObjectStructure(*FullState);
+				}
+				else if (Payload->TryGetObjectField(TEXT("current_state_patch"), Patch))
+				{
+					const TSharedPtr<FJsonObject>* Base = PageStates.Find((int32)Payload->GetNumberField(TEXT("state_base_seq")));
+					if (Base)
+					{
+						PageState = CopyJsonObjectStructure(*Base);
+						ApplyJsonMergePatch(PageState, *Patch);
+					}
+				}
+
+				// Hashes rather than CompareJsonValuesCaseSensitive, which never treats two nulls as equal
+				if (!PageState.IsValid() || GetJsonValueHash64(MakeShared<FJsonValueObject>(PageState)) != Tree.GetHash())
+				{
+					Ar.Logf(ELogVerbosity::Error, TEXT("Page state differs from the current state after push %d (state_seq %d, %s)"), Push, Sequence, bFullSnapshot ? TEXT("full") : TEXT("patch"));
+					++NumFailures;
+					PageState = CopyJsonObjectStructure(Current);
+				}
+				PageStates.Add(Sequence, PageState);
+
+				// Acknowledge late, out of order or not at all
+				if (Random.RandRange(0, 2) != 0)
+				{
+					Sync.Acknowledge(FMath::Max(1, Sequence - Random.RandRange(0, 3)));
+				}
+			}
+
+			const FZLStateWebSyncStats& Stats = Sync.GetStats();
+			Ar.Logf(TEXT("State web sync verification %s: %d pushes, %llu full, %llu patches, %llu chars sent, %lld saved"),
+				NumFailures == 0 ? TEXT("passed") : TEXT("FAILED"), NumPushes, Stats.NumFullSnapshots, Stats.NumPatches, Stats.SentChars, Stats.GetSavedChars());
+		}));
+
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GStateWebSyncStatsCommand(
+		TEXT("ZLCloudPlugin.State.WebSyncStats"),
+		TEXT("Prints how much state_processing_ended traffic merge patches have saved since the last reset. Usage: ZLCloudPlugin.State.WebSyncStats [reset]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			UZLCloudPluginStateManager* StateManager = UZLCloudPluginStateManager::GetZLCloudPluginStateManager();
+			FZLStateWebSync& Sync = StateManager->GetWebStateSync();
+			const FZLStateWebSyncStats& Stats = Sync.GetStats();
+
+			const double SavedPercent = Stats.FullEquivalentChars > 0 ? 100.0 * Stats.GetSavedChars() / Stats.FullEquivalentChars : 0.0;
+			Ar.Logf(TEXT("State deltas %s, acknowledged state_seq %d, %d unacknowledged"),
+				Sync.AreDeltasEnabled() ? TEXT("enabled") : TEXT("disabled"), Sync.GetAcknowledgedSequence(), Sync.GetNumUnacknowledged());
+			Ar.Logf(TEXT("%llu full snapshots, %llu patches, %llu acks, %llu chars sent, ~%llu as full snapshots, %lld saved (%.1f%%)"),
+				Stats.NumFullSnapshots, Stats.NumPatches, Stats.NumAcks, Stats.SentChars, Stats.FullEquivalentChars, Stats.GetSavedChars(), SavedPercent);
+
+			if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+			{
+				Sync.ResetStats();
+			}
+		}));
+
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GStateKeyMetricsCommand(
+		TEXT("ZLCloudPlugin.State.KeyMetrics"),
+		TEXT("Prints per key time to confirm, warnings and timeouts since the last reset, worst first. Usage: ZLCloudPlugin.State.KeyMetrics [MaxKeys] [reset]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			UZLCloudPluginStateManager* StateManager = UZLCloudPluginStateManager::GetZLCloudPluginStateManager();
+			const FZLStateKeyMetrics& Metrics = StateManager->GetStateKeyMetrics();
+			const int32 MaxKeys = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 20;
+
+			Ar.Logf(TEXT("State key metrics for %d keys, warning at %ds, timeout at %ds"),
+				Metrics.GetKeys().Num(), StateManager->m_stateRequestWarningTime, StateManager->m_stateRequestTimeout);
+			for (const FString& Line : Metrics.ToLines(MaxKeys))
+			{
+				Ar.Log(Line);
+			}
+
+			if (Args.Contains(TEXT("reset")))
+			{
+				StateManager->ResetStateKeyMetrics();
+			}
+		}));
+
+	// Drives the wheel with a fake clock against a plain list of deadlines, including timers scheduled and cancelled from callbacks
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GVerifyTimerWheelCommand(
+		TEXT("ZLCloudPlugin.State.VerifyTimerWheel"),
+		TEXT("Fuzzes the state request timer wheel on a fake clock against brute force deadlines. Usage: ZLCloudPlugin.State.VerifyTimerWheel [Timers] [Seed]"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			const int32 NumTimers = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 10000;
+			FRandomStream Random(Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 1);
+
+			const double TickSeconds = 0.05;
+			const double Origin = 1000.0;
+			double Now = Origin;
+
+			FZLTimerWheel Wheel(TickSeconds);
+			Wheel.Reset(Now);
+
+			// Same rounding as the wheel: a deadline is due once the clock reaches the tick it rounds up to
+			auto DueTick = [&](double Deadline) { return FMath::Max(0.0, FMath::CeilToDouble((Deadline - Origin) / TickSeconds)); };
+			auto NowTick = [&]() { return FMath::Max(0.0, FMath::FloorToDouble((Now - Origin) / TickSeconds)); };
+
+			TMap<FZLTimerWheel::FTimerId, double> Pending;
+			// Scheduled from callbacks, anything already due only fires on the next Advance
+			TSet<FZLTimerWheel::FTimerId> ScheduledInAdvance;
+			bool bInAdvance = false;
+			TArray<double> FiredTicks;
+			int32 NumScheduled = 0;
+			int32 NumFired = 0;
+			int32 NumCancelled = 0;
+			int32 NumFailures = 0;
+
+			TFunction<void(double)> ScheduleTimer;
+			ScheduleTimer = [&](double Deadline)
+			{
+				const int32 Action = Random.RandRange(0, 9);
+				const FZLTimerWheel::FTimerId Id = Wheel.Schedule(Deadline, [&, Deadline, Action]()
+				{
+					FiredTicks.Add(DueTick(Deadline));
+					++NumFired;
+					if (Deadline > Now)
+					{
+						Ar.Logf(ELogVerbosity::Error, TEXT("Timer due at %.3f fired early at %.3f"), Deadline - Origin, Now - Origin);
+						++NumFailures;
+					}
+
+					// Some callbacks schedule a follow up or cancel another timer, like a request warning rescheduling itself
+					if (Action == 0 && NumScheduled < NumTimers)
+					{
+						++NumScheduled;
+						ScheduleTimer(Now + Random.FRandRange(-1.0, 5.0));
+					}
+					else if (Action == 1 && Pending.Num() > 0)
+					{
+						const FZLTimerWheel::FTimerId Victim = Pending.CreateConstIterator().Key();
+						if (Wheel.Cancel(Victim))
+						{
+							Pending.Remove(Victim);
+							++NumCancelled;
+						}
+					}
+				});
+				Pending.Add(Id, Deadline);
+				if (bInAdvance)
+				{
+					ScheduledInAdvance.Add(Id);
+				}
+			};
+
+			while ((NumScheduled < NumTimers || Pending.Num() > 0) && NumFailures < 10)
+			{
+				// Mostly near deadlines like the request warnings/timeouts, some far enough out to overflow the top level
+				for (int32 i = Random.RandRange(0, 4); i > 0 && NumScheduled < NumTimers; --i)
+				{
+					++NumScheduled;
+					const int32 Range = Random.RandRange(0, 19);
+					const double Delay = Range < 15 ? Random.FRandRange(-0.1, 40.0) : Range < 19 ? Random.FRandRange(40.0, 100000.0) : Random.FRandRange(1.0e6, 4.0e6);
+					ScheduleTimer(Now + Delay);
+				}
+
+				if (Pending.Num() > 0 && Random.RandRange(0, 9) == 0)
+				{
+					TArray<FZLTimerWheel::FTimerId> Ids;
+					Pending.GetKeys(Ids);
+					const FZLTimerWheel::FTimerId Victim = Ids[Random.RandRange(0, Ids.Num() - 1)];
+					if (!Wheel.Cancel(Victim))
+					{
+						Ar.Logf(ELogVerbosity::Error, TEXT("Pending timer %llu could not be cancelled"), Victim);
+						++NumFailures;
+					}
+					Pending.Remove(Victim);
+					++NumCancelled;
+				}
+
+				// Small steps within and across ticks, occasionally a long stall
+				const int32 Step = Random.RandRange(0, 19);
+				Now += Step < 10 ? Random.FRandRange(0.0, TickSeconds) : Step < 19 ? Random.FRandRange(0.0, 2.0) : Random.FRandRange(10.0, 200000.0);
+
+				FiredTicks.Reset();
+				ScheduledInAdvance.Reset();
+				bInAdvance = true;
+				Wheel.Advance(Now);
+				bInAdvance = false;
+
+				for (int32 i = 1; i < FiredTicks.Num(); ++i)
+				{
+					if (FiredTicks[i] < FiredTicks[i - 1])
+					{
+						Ar.Logf(ELogVerbosity::Error, TEXT("Timers fired out of deadline order at %.3f"), Now - Origin);
+						++NumFailures;
+						break;
+					}
+				}
+
+				// Anything due by now must have fired, anything that fired is gone from the wheel
+				for (TMap<FZLTimerWheel::FTimerId, double>::TIterator It = Pending.CreateIterator(); It; ++It)
+				{
+					if (!Wheel.IsScheduled(It->Key))
+					{
+						It.RemoveCurrent();
+					}
+					else if (DueTick(It->Value) <= NowTick() && !ScheduledInAdvance.Contains(It->Key))
+					{
+						Ar.Logf(ELogVerbosity::Error, TEXT("Timer due at %.3f still pending at %.3f"), It->Value - Origin, Now - Origin);
+						++NumFailures;
+						It.RemoveCurrent();
+					}
+				}
+
+				if (Wheel.Num() != Pending.Num())
+				{
+					Ar.Logf(ELogVerbosity::Error, TEXT("Wheel holds %d timers, expected %d"), Wheel.Num(), Pending.Num());
+					++NumFailures;
+					break;
+				}
+			}
+
+			Ar.Logf(TEXT("Timer wheel verification %s: %d scheduled, %d fired, %d cancelled"),
+				NumFailures == 0 ? TEXT("passed") : TEXT("FAILED"), NumScheduled, NumFired, NumCancelled);
+		}));
+
+	// Walks a detached manager on a fake clock through requests running side by side, queueing on shared keys, releasing them and timing out
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice GVerifyStateRequestLifecycleCommand(
+		TEXT("ZLCloudPlugin.State.VerifyRequestLifecycle"),
+		TEXT("Checks concurrent, queued, released and timed out state requests on a detached state manager with a fake clock"),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar) {
+			double Now = 1000.0;
+			TArray<FString> Started; // "Key=Value" of each request as the manager starts it
+			TArray<FZLStateRequestTiming> Ended;
+			int32 NumFailures = 0;
+
+			auto Check = [&](bool bCondition, const FString& What)
+			{
+				if (!bCondition)
+				{
+					Ar.Logf(ELogVerbosity::Error, TEXT("%s"), *What);
+					++NumFailures;
+				}
+			};
+
+			UZLCloudPluginStateManager* Manager = UZLCloudPluginStateManager::CreateDetachedInstance(nullptr);
+			Manager->AddToRoot();
+			Manager->m_stateRequestWarningTime = 2;
+			Manager->m_stateRequestTimeout = 5;
+			Manager->SetStateClock([&Now]() { return Now; });
+			Manager->SetWebMessageHandler([](const FString&) {});
+			Manager->SetStateRequestHandler([&Started](const TSharedPtr<FJsonObject>& Request)
+			{
+				FString Description;
+				for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : Request->Values)
+				{
+					if (Pair.Key != TEXT("RequestId"))
+					{
+						Description += FString::Printf(TEXT("%s%s=%g"), Description.IsEmpty() ? TEXT("") : TEXT(","), *Pair.Key, Pair.Value->AsNumber());
+					}
+				}
+				Started.Add(Description);
+			});
+			const FDelegateHandle EndedHandle = Manager->OnStateRequestEnded.AddLambda([&Ended](const FZLStateRequestTiming& Timing) { Ended.Add(Timing); });
+
+			auto Request = [&](const TCHAR* Json)
+			{
+				TSharedPtr<FJsonObject> State;
+				Check(ParseJsonObject(Json, State), FString::Printf(TEXT("Couldn't parse %s"), Json));
+				if (State.IsValid())
+				{
+					Manager->StartStateRequest(State, true);
+				}
+			};
+
+			// Pulls and confirms a key like a handler would, Update then finishes whatever that completes
+			auto Confirm = [&](const TCHAR* Key, double Expected)
+			{
+				double Value = 0.0;
+				bool bSuccess = false;
+				Manager->GetRequestedStateValue<double>(Key, true, Value, bSuccess);
+				Check(bSuccess && Value == Expected, FString::Printf(TEXT("Pulled %s=%g (%s), expected %g"), Key, Value, bSuccess ? TEXT("found") : TEXT("missing"), Expected));
+			};
+
+			auto ExpectStarted = [&](const TCHAR* Step, const TArray<FString>& Expected)
+			{
+				Check(Started == Expected, FString::Printf(TEXT("%s: started [%s], expected [%s]"), Step, *FString::Join(Started, TEXT(" ")), *FString::Join(Expected, TEXT(" "))));
+			};
+
+			// Disjoint keys run side by side
+			Request(TEXT("{\"A\":1}"));
+			Request(TEXT("{\"B\":1}"));
+			Check(Manager->GetNumInFlightStateRequests() == 2, FString::Printf(TEXT("Disjoint requests: %d in flight, expected 2"), Manager->GetNumInFlightStateRequests()));
+			ExpectStarted(TEXT("Disjoint requests"), { TEXT("A=1"), TEXT("B=1") });
+
+			// Requests on keys in flight queue, the one on both keys behind both earlier ones
+			Request(TEXT("{\"A\":2}"));
+			Request(TEXT("{\"B\":2}"));
+			Request(TEXT("{\"A\":3,\"B\":3}"));
+			Check(Manager->GetNumInFlightStateRequests() == 2, FString::Printf(TEXT("Overlapping requests: %d in flight, expected 2"), Manager->GetNumInFlightStateRequests()));
+			ExpectStarted(TEXT("Overlapping requests"), { TEXT("A=1"), TEXT("B=1") });
+
+			// B finishing first lets the queued B request past the earlier one still waiting on A
+			Confirm(TEXT("B"), 1);
+			Manager->Update(nullptr);
+			ExpectStarted(TEXT("B=1 confirmed"), { TEXT("A=1"), TEXT("B=1"), TEXT("B=2") });
+
+			Confirm(TEXT("A"), 1);
+			Manager->Update(nullptr);
+			ExpectStarted(TEXT("A=1 confirmed"), { TEXT("A=1"), TEXT("B=1"), TEXT("B=2"), TEXT("A=2") });
+
+			Confirm(TEXT("A"), 2);
+			Manager->Update(nullptr);
+			ExpectStarted(TEXT("A=2 confirmed"), { TEXT("A=1"), TEXT("B=1"), TEXT("B=2"), TEXT("A=2") });
+
+			Confirm(TEXT("B"), 2);
+			Manager->Update(nullptr);
+			ExpectStarted(TEXT("B=2 confirmed"), { TEXT("A=1"), TEXT("B=1"), TEXT("B=2"), TEXT("A=2"), TEXT("A=3,B=3") });
+
+			Confirm(TEXT("A"), 3);
+			Confirm(TEXT("B"), 3);
+			Manager->Update(nullptr);
+			Check(Manager->GetNumInFlightStateRequests() == 0, FString::Printf(TEXT("All confirmed: %d still in flight"), Manager->GetNumInFlightStateRequests()));
+			Check(Ended.Num() == 5 && Algo::AllOf(Ended, [](const FZLStateRequestTiming& Timing) { return Timing.Status == TEXT("complete"); }),
+				FString::Printf(TEXT("All confirmed: %d requests ended, expected 5 complete"), Ended.Num()));
+
+			// Every key owner was released, so requests on the same keys start straight away
+			Request(TEXT("{\"A\":4,\"B\":4}"));
+			Check(Manager->GetNumInFlightStateRequests() == 1 && Started.Num() == 6, TEXT("Request on released keys didn't start straight away"));
+			Confirm(TEXT("A"), 4);
+			Confirm(TEXT("B"), 4);
+			Manager->Update(nullptr);
+
+			// A key pulled but never confirmed warns, then times out, on the fake clock alone
+			Ended.Reset();
+			Request(TEXT("{\"D\":1}"));
+			double Value = 0.0;
+			bool bSuccess = false;
+			Manager->GetRequestedStateValue<double>(TEXT("D"), false, Value, bSuccess);
+			Check(bSuccess, TEXT("D wasn't requested"));
+
+			auto NumWarnings = [&]() { const FZLStateKeyTiming* Timing = Manager->GetStateKeyMetrics().GetKeys().Find(TEXT("D")); return Timing ? Timing->NumWarnings : 0; };
+			auto NumTimeouts = [&]() { const FZLStateKeyTiming* Timing = Manager->GetStateKeyMetrics().GetKeys().Find(TEXT("D")); return Timing ? Timing->NumTimeouts : 0; };
+
+			Now += 1.5;
+			Manager->Update(nullptr);
+			Check(NumWarnings() == 0 && Ended.Num() == 0, TEXT("Warned or ended before the warning time"));
+
+			Now += 1.0;
+			Manager->Update(nullptr);
+			Check(NumWarnings() == 1 && Ended.Num() == 0, FString::Printf(TEXT("%d warnings and %d ends after the warning time, expected 1 and 0"), NumWarnings(), Ended.Num()));
+
+			Now += 3.0;
+			Manager->Update(nullptr);
+			Check(Ended.Num() == 1 && Ended[0].Status == TEXT("timeout") && NumTimeouts() == 1,
+				FString::Printf(TEXT("After the timeout: %d ends (%s), %d timeouts, expected one timeout"), Ended.Num(), Ended.Num() > 0 ? *Ended[0].Status : TEXT(""), NumTimeouts()));
+			Check(Ended.Num() == 1 && Ended[0].EndTime - Ended[0].StartTime >= Manager->m_stateRequestTimeout,
+				TEXT("Timed out before its timeout"));
+			Check(Manager->GetNumInFlightStateRequests() == 0, TEXT("Timed out request still in flight"));
+
+			Manager->OnStateRequestEnded.Remove(EndedHandle);
+			Manager->SetStateClock(nullptr);
+			Manager->SetWebMessageHandler(nullptr);
+			Manager->SetStateRequestHandler(nullptr);
+			Manager->RemoveFromRoot();
+
+			Ar.Logf(TEXT("State request lifecycle verification %s"), NumFailures == 0 ? TEXT("passed") : TEXT("FAILED"));
+		}));
+#endif
+}
@@ -0,0 +1,951 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#include "ZLStateJournal.h"
+#include "ZLCloudPluginPrivate.h"
+#include "ZLStateTree.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "HAL/RunnableThread.h"
+#include "Hash/CityHash.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	enum class EValueTag : uint8
+	{
+		Null,
+		False,
+		True,
+		Integer,
+		Double,
+		String,
+		Array,
+		Object
+	};
+
+	enum class EJournalOp : uint8
+	{
+		SetCurrent,
+		RemoveCurrent,
+		SetRequested
+	};
+
+	const uint32 SnapshotMagic = 0x53534C5A; // "ZLSS"
+	const uint32 JournalMagic = 0x4A534C5A; // "ZLSJ"
+	const uint32 FormatVersion = 1;
+
+	// Corrupt data can't nest deeper than this and blow the stack
+	const int32 MaxDepth = 256;
+
+	// The journal is compacted into a new snapshot once it is bigger than the last snapshot and at least this size
+	const int64 MinCompactionSize = 256 * 1024;
+
+	// Record framing: payload size and CRC ahead of each payload
+	const int32 RecordHeaderSize = 8;
+
+	// Integral doubles go through the varint path, -0.0 and anything beyond exact int64 range keep their bits
+	bool IsCompactInteger(double Number)
+	{
+		return FMath::Abs(Number) < 9007199254740992.0 && (double)(int64)Number == Number && !(Number == 0.0 && 1.0 / Number < 0.0);
+	}
+
+	uint64 HashRequestedState(const TSharedPtr<FJsonObject>& RequestedState)
+	{
+		return RequestedState.IsValid() && RequestedState->Values.Num() > 0 ? GetJsonValueHash64(MakeShared<FJsonValueObject>(RequestedState)) : 0;
+	}
+
+	void WritePath(FZLStateBinaryWriter& Writer, const TArray<FZLStateKeyPath::FSegment>& Segments, int32 NumSegments)
+	{
+		Writer.WriteCount(NumSegments);
+		for (int32 i = 0; i < NumSegments; ++i)
+		{
+			Writer.WriteKey(Segments[i].Name);
+		}
+	}
+
+	bool ReadPath(FZLStateBinaryReader& Reader, TArray<FString>& OutSegments)
+	{
+		uint64 NumSegments = 0;
+		if (!Reader.ReadCount(NumSegments) || NumSegments == 0 || NumSegments > MaxDepth)
+		{
+			return false;
+		}
+
+		OutSegments.SetNum((int32)NumSegments);
+		for (FString& Segment : OutSegments)
+		{
+			if (!Reader.ReadKey(Segment))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Sets the value at Segments, replacing anything that isn't an object on the way down
+	void SetAtPath(FJsonObject& Root, const TArray<FString>& Segments, const TSharedPtr<FJsonValue>& Value)
+	{
+		FJsonObject* Object = &Root;
+		for (int32 i = 0; i < Segments.Num() - 1; ++i)
+		{
+			const TSharedPtr<FJsonValue>* Child = Object->Values.Find(Segments[i]);
+			if (!Child || !Child->IsValid() || (*Child)->Type != EJson::Object || !(*Child)->AsObject().IsValid())
+			{
+				TSharedPtr<FJsonObject> NewObject = MakeShared<FJsonObject>();
+				Object->SetObjectField(Segments[i], NewObject);
+				Object = NewObject.Get();
+			}
+			else
+			{
+				Object = (*Child)->AsObject().Get();
+			}
+		}
+		Object->SetField(Segments.Last(), Value);
+	}
+
+	// Removes the value at Segments. Parents left empty are kept, the journal records their removal separately if it happened
+	void RemoveAtPath(FJsonObject& Root, const TArray<FString>& Segments)
+	{
+		FJsonObject* Object = &Root;
+		for (int32 i = 0; i < Segments.Num() - 1; ++i)
+		{
+			const TSharedPtr<FJsonValue>* Child = Object->Values.Find(Segments[i]);
+			if (!Child || !Child->IsValid() || (*Child)->Type != EJson::Object || !(*Child)->AsObject().IsValid())
+			{
+				return;
+			}
+			Object = (*Child)->AsObject().Get();
+		}
+		Object->RemoveField(Segments.Last());
+	}
+
+	bool ApplyRecord(const uint8* Payload, int64 Size, FZLStateSnapshot& Snapshot)
+	{
+		FZLStateBinaryReader Reader(Payload, Size);
+		TArray<FString> Segments;
+		while (!Reader.IsAtEnd())
+		{
+			uint8 Op = 0;
+			if (!Reader.ReadByte(Op))
+			{
+				return false;
+			}
+
+			switch ((EJournalOp)Op)
+			{
+			case EJournalOp::SetCurrent:
+			{
+				TSharedPtr<FJsonValue> Value;
+				if (!ReadPath(Reader, Segments) || !Reader.ReadValue(Value))
+				{
+					return false;
+				}
+				SetAtPath(*Snapshot.CurrentState, Segments, Value);
+				break;
+			}
+			case EJournalOp::RemoveCurrent:
+				if (!ReadPath(Reader, Segments))
+				{
+					return false;
+				}
+				RemoveAtPath(*Snapshot.CurrentState, Segments);
+				break;
+			case EJournalOp::SetRequested:
+				if (!Reader.ReadObject(Snapshot.RequestedState))
+				{
+					return false;
+				}
+				break;
+			default:
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+void FZLStateBinaryWriter::WriteObject(const FJsonObject& Object)
+{
+	WriteCount(Object.Values.Num());
+	for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : Object.Values)
+	{
+		WriteKey(Pair.Key);
+		if (Pair.Value.IsValid())
+		{
+			WriteValue(*Pair.Value);
+		}
+		else
+		{
+			WriteByte((uint8)EValueTag::Null);
+		}
+	}
+}
+
+void FZLStateBinaryWriter::WriteValue(const FJsonValue& Value)
+{
+	switch (Value.Type)
+	{
+	case EJson::Boolean:
+		WriteByte((uint8)(Value.AsBool() ? EValueTag::True : EValueTag::False));
+		break;
+	case EJson::Number:
+	{
+		const double Number = Value.AsNumber();
+		if (IsCompactInteger(Number))
+		{
+			// Zigzag so small negative numbers stay short too
+			const int64 Integer = (int64)Number;
+			WriteByte((uint8)EValueTag::Integer);
+			WriteCount(((uint64)Integer << 1) ^ (uint64)(Integer >> 63));
+		}
+		else
+		{
+			uint64 Bits;
+			FMemory::Memcpy(&Bits, &Number, sizeof(Bits));
+			WriteByte((uint8)EValueTag::Double);
+			WriteUInt64(Bits);
+		}
+		break;
+	}
+	case EJson::String:
+		WriteByte((uint8)EValueTag::String);
+		WriteString(Value.AsString());
+		break;
+	case EJson::Array:
+	{
+		const TArray<TSharedPtr<FJsonValue>>& Items = Value.AsArray();
+		WriteByte((uint8)EValueTag::Array);
+		WriteCount(Items.Num());
+		for (const TSharedPtr<FJsonValue>& Item : Items)
+		{
+			if (Item.IsValid())
+			{
+				WriteValue(*Item);
+			}
+			else
+			{
+				WriteByte((uint8)EValueTag::Null);
+			}
+		}
+		break;
+	}
+	case EJson::Object:
+	{
+		const TSharedPtr<FJsonObject>& Object = Value.AsObject();
+		WriteByte((uint8)EValueTag::Object);
+		if (Object.IsValid())
+		{
+			WriteObject(*Object);
+		}
+		else
+		{
+			WriteCount(0);
+		}
+		break;
+	}
+	default:
+		WriteByte((uint8)EValueTag::Null);
+		break;
+	}
+}
+
+void FZLStateBinaryWriter::WriteKey(const FString& Key)
+{
+	// 0 spells the key out, anything else is 1 + the index of a key already written
+	if (const uint32* Index = KeyIndices.Find(Key))
+	{
+		WriteCount(*Index + 1);
+		return;
+	}
+
+	KeyIndices.Add(Key, KeyIndices.Num());
+	WriteCount(0);
+	WriteString(Key);
+}
+
+void FZLStateBinaryWriter::WriteString(const FString& String)
+{
+	FTCHARToUTF8 Utf8(*String, String.Len());
+	WriteCount(Utf8.Length());
+	Bytes.Append(reinterpret_cast<const uint8*>(Utf8.Get()), Utf8.Length());
+}
+
+void FZLStateBinaryWriter::WriteCount(uint64 Count)
+{
+	while (Count >= 0x80)
+	{
+		Bytes.Add((uint8)(Count | 0x80));
+		Count >>= 7;
+	}
+	Bytes.Add((uint8)Count);
+}
+
+void FZLStateBinaryWriter::WriteUInt32(uint32 Value)
+{
+	for (int32 i = 0; i < 4; ++i)
+	{
+		Bytes.Add((uint8)(Value >> (i * 8)));
+	}
+}
+
+void FZLStateBinaryWriter::WriteUInt64(uint64 Value)
+{
+	for (int32 i = 0; i < 8; ++i)
+	{
+		Bytes.Add((uint8)(Value >> (i * 8)));
+	}
+}
+
+bool FZLStateBinaryReader::ReadObject(TSharedPtr<FJsonObject>& OutObject)
+{
+	return ReadObject(OutObject, 0);
+}
+
+bool FZLStateBinaryReader::ReadValue(TSharedPtr<FJsonValue>& OutValue)
+{
+	return ReadValue(OutValue, 0);
+}
+
+bool FZLStateBinaryReader::ReadObject(TSharedPtr<FJsonObject>& OutObject, int32 Depth)
+{
+	uint64 Count = 0;
+	// Every field takes at least two bytes, a larger count can only be corrupt
+	if (Depth > MaxDepth || !ReadCount(Count) || Count > (uint64)(Num - Offset) / 2)
+	{
+		return false;
+	}
+
+	OutObject = MakeShared<FJsonObject>();
+	OutObject->Values.Reserve((int32)Count);
+	for (uint64 i = 0; i < Count; ++i)
+	{
+		FString Key;
+		TSharedPtr<FJsonValue> Value;
+		if (!ReadKey(Key) || !ReadValue(Value, Depth + 1))
+		{
+			return false;
+		}
+		OutObject->Values.Add(MoveTemp(Key), MoveTemp(Value));
+	}
+	return true;
+}
+
+bool FZLStateBinaryReader::ReadValue(TSharedPtr<FJsonValue>& OutValue, int32 Depth)
+{
+	uint8 Tag = 0;
+	if (Depth > MaxDepth || !ReadByte(Tag))
+	{
+		return false;
+	}
+
+	switch ((EValueTag)Tag)
+	{
+	case EValueTag::Null:
+		OutValue = MakeShared<FJsonValueNull>();
+		return true;
+	case EValueTag::False:
+	case EValueTag::True:
+		OutValue = MakeShared<FJsonValueBoolean>((EValueTag)Tag == EValueTag::True);
+		return true;
+	case EValueTag::Integer:
+	{
+		uint64 Zigzag = 0;
+		if (!ReadCount(Zigzag))
+		{
+			return false;
+		}
+		const int64 Integer = (int64)(Zigzag >> 1) ^ -(int64)(Zigzag & 1);
+		OutValue = MakeShared<FJsonValueNumber>((double)Integer);
+		return true;
+	}
+	case EValueTag::Double:
+	{
+		uint64 Bits = 0;
+		if (!ReadUInt64(Bits))
+		{
+			return false;
+		}
+		double Number;
+		FMemory::Memcpy(&Number, &Bits, sizeof(Number));
+		OutValue = MakeShared<FJsonValueNumber>(Number);
+		return true;
+	}
+	case EValueTag::String:
+	{
+		FString String;
+		if (!ReadString(String))
+		{
+			return false;
+		}
+		OutValue = MakeShared<FJsonValueString>(MoveTemp(String));
+		return true;
+	}
+	case EValueTag::Array:
+	{
+		uint64 Count = 0;
+		if (!ReadCount(Count) || Count > (uint64)(Num - Offset))
+		{
+			return false;
+		}
+
+		TArray<TSharedPtr<FJsonValue>> Items;
+		Items.Reserve((int32)Count);
+		for (uint64 i = 0; i < Count; ++i)
+		{
+			if (!ReadValue(Items.AddDefaulted_GetRef(), Depth + 1))
+			{
+				return false;
+			}
+		}
+		OutValue = MakeShared<FJsonValueArray>(Items);
+		return true;
+	}
+	case EValueTag::Object:
+	{
+		TSharedPtr<FJsonObject> Object;
+		if (!ReadObject(Object, Depth + 1))
+		{
+			return false;
+		}
+		OutValue = MakeShared<FJsonValueObject>(Object);
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+bool FZLStateBinaryReader::ReadKey(FString& OutKey)
+{
+	uint64 Index = 0;
+	if (!ReadCount(Index))
+	{
+		return false;
+	}
+
+	if (Index == 0)
+	{
+		if (!ReadString(OutKey))
+		{
+			return false;
+		}
+		Keys.Add(OutKey);
+		return true;
+	}
+
+	if (Index > (uint64)Keys.Num())
+	{
+		return false;
+	}
+	OutKey = Keys[(int32)Index - 1];
+	return true;
+}
+
+bool FZLStateBinaryReader::ReadString(FString& OutString)
+{
+	uint64 Length = 0;
+	if (!ReadCount(Length) || Length > (uint64)(Num - Offset))
+	{
+		return false;
+	}
+
+	FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(Data + Offset), (int32)Length);
+	OutString = FString(Converted.Length(), Converted.Get());
+	Offset += Length;
+	return true;
+}
+
+bool FZLStateBinaryReader::ReadCount(uint64& OutCount)
+{
+	OutCount = 0;
+	for (int32 Shift = 0; Shift < 64 && Offset < Num; Shift += 7)
+	{
+		const uint8 Byte = Data[Offset++];
+		OutCount |= (uint64)(Byte & 0x7F) << Shift;
+		if ((Byte & 0x80) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FZLStateBinaryReader::ReadByte(uint8& OutByte)
+{
+	if (Offset >= Num)
+	{
+		return false;
+	}
+	OutByte = Data[Offset++];
+	return true;
+}
+
+bool FZLStateBinaryReader::ReadUInt32(uint32& OutValue)
+{
+	if (Num - Offset < 4)
+	{
+		return false;
+	}
+
+	OutValue = 0;
+	for (int32 i = 0; i < 4; ++i)
+	{
+		OutValue |= (uint32)Data[Offset++] << (i * 8);
+	}
+	return true;
+}
+
+bool FZLStateBinaryReader::ReadUInt64(uint64& OutValue)
+{
+	if (Num - Offset < 8)
+	{
+		return false;
+	}
+
+	OutValue = 0;
+	for (int32 i = 0; i < 8; ++i)
+	{
+		OutValue |= (uint64)Data[Offset++] << (i * 8);
+	}
+	return true;
+}
+
+void FZLStateSnapshot::Serialize(TArray<uint8>& OutBytes) const
+{
+	// Header, then both trees sharing one key table, then the CRC of the trees
+	FZLStateBinaryWriter Writer(OutBytes);
+	Writer.WriteUInt32(SnapshotMagic);
+	Writer.WriteUInt32(FormatVersion);
+	Writer.WriteUInt64(SchemaHash);
+	Writer.WriteUInt32(Generation);
+
+	const int32 BodyStart = OutBytes.Num();
+	const FJsonObject Empty;
+	Writer.WriteObject(CurrentState.IsValid() ? *CurrentState : Empty);
+	Writer.WriteObject(RequestedState.IsValid() ? *RequestedState : Empty);
+	Writer.WriteUInt32(FCrc::MemCrc32(OutBytes.GetData() + BodyStart, OutBytes.Num() - BodyStart));
+}
+
+bool FZLStateSnapshot::Deserialize(const TArray<uint8>& Bytes, FString* OutError)
+{
+	auto Fail = [OutError](const TCHAR* Error)
+	{
+		if (OutError)
+		{
+			*OutError = Error;
+		}
+		return false;
+	};
+
+	FZLStateBinaryReader Header(Bytes.GetData(), Bytes.Num());
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	if (!Header.ReadUInt32(Magic) || Magic != SnapshotMagic)
+	{
+		return Fail(TEXT("not a state snapshot"));
+	}
+	if (!Header.ReadUInt32(Version) || Version != FormatVersion)
+	{
+		return Fail(TEXT("unsupported snapshot version"));
+	}
+	if (!Header.ReadUInt64(SchemaHash) || !Header.ReadUInt32(Generation) || Bytes.Num() - Header.GetOffset() < 4)
+	{
+		return Fail(TEXT("truncated snapshot"));
+	}
+
+	const int64 BodyStart = Header.GetOffset();
+	const int64 BodySize = Bytes.Num() - BodyStart - 4;
+	FZLStateBinaryReader Footer(Bytes.GetData() + BodyStart + BodySize, 4);
+	uint32 Crc = 0;
+	if (!Footer.ReadUInt32(Crc) || Crc != FCrc::MemCrc32(Bytes.GetData() + BodyStart, BodySize))
+	{
+		return Fail(TEXT("snapshot checksum mismatch"));
+	}
+
+	FZLStateBinaryReader Body(Bytes.GetData() + BodyStart, BodySize);
+	if (!Body.ReadObject(CurrentState) || !Body.ReadObject(RequestedState) || !Body.IsAtEnd())
+	{
+		return Fail(TEXT("malformed snapshot"));
+	}
+	return true;
+}
+
+uint64 FZLStateSnapshot::HashSchema(const UStateKeyInfoAsset* Schema)
+{
+	if (!Schema || Schema->KeyInfos.Num() == 0)
+	{
+		return 0;
+	}
+
+	TArray<FString> Keys;
+	Schema->KeyInfos.GetKeys(Keys);
+	Keys.Sort();
+
+	// Everything that decides which values the state can hold, not the defaults or hashing options
+	FString Description;
+	for (const FString& Key : Keys)
+	{
+		const FStateKeyInfo& Info = Schema->KeyInfos[Key];
+		Description += Key;
+		Description += TEXT("|");
+		Description += Info.DataType;
+		if (Info.bLimitValues)
+		{
+			Description += TEXT("|");
+			Description += FString::Join(Info.AcceptedStringValues, TEXT(","));
+			for (double Number : Info.AcceptedNumberValues)
+			{
+				Description += FString::Printf(TEXT(",%.17g"), Number);
+			}
+		}
+		Description += TEXT("\n");
+	}
+	return CityHash64(reinterpret_cast<const char*>(*Description), Description.Len() * sizeof(TCHAR));
+}
+
+FZLStateJournal::~FZLStateJournal()
+{
+	Close();
+}
+
+bool FZLStateJournal::Open(const FString& InDirectory, uint64 InSchemaHash)
+{
+	Close();
+
+	if (!IFileManager::Get().MakeDirectory(*InDirectory, true))
+	{
+		UE_LOG(LogZLCloudPlugin, Error, TEXT("State journal could not create directory %s"), *InDirectory);
+		return false;
+	}
+
+	SnapshotPath = GetSnapshotPath(InDirectory);
+	JournalPath = GetJournalPath(InDirectory);
+	SchemaHash = InSchemaHash;
+	// Only needs to differ from the generation of whatever snapshot is already there
+	Generation = (uint32)FPlatformTime::Cycles64();
+
+	PendingPaths.Reset();
+	PendingSet.Reset();
+	bSnapshotDue = true;
+	RequestedHash = 0;
+	JournalSize = 0;
+	SnapshotSize = 0;
+	NumSnapshots = 0;
+	NumRecords = 0;
+
+	bStopping = false;
+	bWriteFailed = false;
+	WorkEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	Thread = FRunnableThread::Create(this, TEXT("ZLStateJournalWriter"), 0, TPri_BelowNormal);
+	if (!Thread)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(WorkEvent);
+		WorkEvent = nullptr;
+		return false;
+	}
+	return true;
+}
+
+void FZLStateJournal::Close()
+{
+	if (!Thread)
+	{
+		return;
+	}
+
+	// The writer drains the queue before it exits
+	Thread->Kill(true);
+	delete Thread;
+	Thread = nullptr;
+
+	FPlatformProcess::ReturnSynchEventToPool(WorkEvent);
+	WorkEvent = nullptr;
+
+	delete JournalHandle;
+	JournalHandle = nullptr;
+}
+
+void FZLStateJournal::RecordChange(const FZLStateKeyPath& Path)
+{
+	if (IsOpen() && !bSnapshotDue && Path.IsValid())
+	{
+		bool bAlreadyPending = false;
+		PendingSet.Add(Path, &bAlreadyPending);
+		if (!bAlreadyPending)
+		{
+			PendingPaths.Add(Path);
+		}
+	}
+}
+
+void FZLStateJournal::SetSchemaHash(uint64 InSchemaHash)
+{
+	if (InSchemaHash != SchemaHash)
+	{
+		SchemaHash = InSchemaHash;
+		bSnapshotDue = true;
+	}
+}
+
+void FZLStateJournal::Flush(const TSharedPtr<FJsonObject>& CurrentState, const TSharedPtr<FJsonObject>& RequestedState)
+{
+	if (!IsOpen() || !CurrentState.IsValid())
+	{
+		return;
+	}
+
+	if (bWriteFailed)
+	{
+		bWriteFailed = false;
+		bSnapshotDue = true;
+	}
+
+	if (bSnapshotDue || JournalSize > FMath::Max(SnapshotSize, MinCompactionSize))
+	{
+		QueueSnapshot(CurrentState, RequestedState);
+		return;
+	}
+
+	const uint64 NewRequestedHash = HashRequestedState(RequestedState);
+	if (PendingPaths.Num() == 0 && NewRequestedHash == RequestedHash)
+	{
+		return;
+	}
+
+	// One record per flush, so a restore applies all of a tick's changes or none of them
+	TArray<uint8> Payload;
+	FZLStateBinaryWriter Writer(Payload);
+	for (const FZLStateKeyPath& Path : PendingPaths)
+	{
+		// Whatever exists at Path now is recorded. If the walk stops early, the deepest level that does exist says
+		// why: missing means removed, a non object means a leaf replaced the objects that were below it
+		const TArray<FZLStateKeyPath::FSegment>& Segments = Path.GetSegments();
+		const FJsonObject* Object = CurrentState.Get();
+		for (int32 i = 0; i < Segments.Num(); ++i)
+		{
+			const TSharedPtr<FJsonValue>* Value = FZLStateKeyPathCache::FindSegment(*Object, Segments[i]);
+			if (!Value || !Value->IsValid())
+			{
+				Writer.WriteByte((uint8)EJournalOp::RemoveCurrent);
+				WritePath(Writer, Segments, i + 1);
+				break;
+			}
+
+			if (i == Segments.Num() - 1 || (*Value)->Type != EJson::Object || !(*Value)->AsObject().IsValid())
+			{
+				Writer.WriteByte((uint8)EJournalOp::SetCurrent);
+				WritePath(Writer, Segments, i + 1);
+				Writer.WriteValue(**Value);
+				break;
+			}
+
+			Object = (*Value)->AsObject().Get();
+		}
+	}
+	PendingPaths.Reset();
+	PendingSet.Reset();
+
+	if (NewRequestedHash != RequestedHash)
+	{
+		const FJsonObject Empty;
+		Writer.WriteByte((uint8)EJournalOp::SetRequested);
+		Writer.WriteObject(RequestedState.IsValid() ? *RequestedState : Empty);
+		RequestedHash = NewRequestedHash;
+	}
+
+	FWriteJob Job;
+	FZLStateBinaryWriter Framing(Job.Journal);
+	Framing.WriteUInt32(Payload.Num());
+	Framing.WriteUInt32(FCrc::MemCrc32(Payload.GetData(), Payload.Num()));
+	Job.Journal.Append(Payload);
+
+	JournalSize += Job.Journal.Num();
+	++NumRecords;
+
+	NumPendingJobs.Increment();
+	Jobs.Enqueue(MoveTemp(Job));
+	WorkEvent->Trigger();
+}
+
+void FZLStateJournal::QueueSnapshot(const TSharedPtr<FJsonObject>& CurrentState, const TSharedPtr<FJsonObject>& RequestedState)
+{
+	FZLStateSnapshot Snapshot;
+	Snapshot.CurrentState = CurrentState;
+	Snapshot.RequestedState = RequestedState;
+	Snapshot.SchemaHash = SchemaHash;
+	Snapshot.Generation = ++Generation;
+
+	FWriteJob Job;
+	Snapshot.Serialize(Job.Snapshot);
+
+	FZLStateBinaryWriter Header(Job.Journal);
+	Header.WriteUInt32(JournalMagic);
+	Header.WriteUInt32(FormatVersion);
+	Header.WriteUInt32(Generation);
+
+	PendingPaths.Reset();
+	PendingSet.Reset();
+	bSnapshotDue = false;
+	RequestedHash = HashRequestedState(RequestedState);
+	SnapshotSize = Job.Snapshot.Num();
+	JournalSize = Job.Journal.Num();
+	++NumSnapshots;
+
+	NumPendingJobs.Increment();
+	Jobs.Enqueue(MoveTemp(Job));
+	WorkEvent->Trigger();
+}
+
+void FZLStateJournal::WaitForWrites()
+{
+	while (IsOpen() && NumPendingJobs.GetValue() > 0)
+	{
+		FPlatformProcess::Sleep(0.001f);
+	}
+}
+
+uint32 FZLStateJournal::Run()
+{
+	FWriteJob Job;
+	while (true)
+	{
+		if (Jobs.Dequeue(Job))
+		{
+			WriteJob(Job);
+			NumPendingJobs.Decrement();
+			continue;
+		}
+
+		if (bStopping)
+		{
+			break;
+		}
+		WorkEvent->Wait();
+	}
+	return 0;
+}
+
+void FZLStateJournal::Stop()
+{
+	bStopping = true;
+	if (WorkEvent)
+	{
+		WorkEvent->Trigger();
+	}
+}
+
+void FZLStateJournal::WriteJob(FWriteJob& Job)
+{
+	if (Job.Snapshot.Num() > 0)
+	{
+		delete JournalHandle;
+		JournalHandle = nullptr;
+
+		// Written aside and moved over the old snapshot, so a crash mid write leaves the previous session intact.
+		// The old journal can't be applied to the new snapshot, its generation no longer matches
+		const FString TempPath = SnapshotPath + TEXT(".tmp");
+		if (!FFileHelper::SaveArrayToFile(Job.Snapshot, *TempPath) || !IFileManager::Get().Move(*SnapshotPath, *TempPath, true, true))
+		{
+			UE_LOG(LogZLCloudPlugin, Error, TEXT("State journal failed to save snapshot %s"), *SnapshotPath);
+			bWriteFailed = true;
+			return;
+		}
+
+		JournalHandle = FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*JournalPath);
+		if (!JournalHandle)
+		{
+			UE_LOG(LogZLCloudPlugin, Error, TEXT("State journal failed to open %s"), *JournalPath);
+			bWriteFailed = true;
+			return;
+		}
+	}
+
+	if (JournalHandle && Job.Journal.Num() > 0)
+	{
+		if (!JournalHandle->Write(Job.Journal.GetData(), Job.Journal.Num()) || !JournalHandle->Flush())
+		{
+			UE_LOG(LogZLCloudPlugin, Error, TEXT("State journal failed to append to %s"), *JournalPath);
+			delete JournalHandle;
+			JournalHandle = nullptr;
+			bWriteFailed = true;
+		}
+	}
+}
+
+bool FZLStateJournal::Restore(const FString& Directory, uint64 SchemaHash, FZLStateSnapshot& OutSnapshot, FString* OutError, int32* OutNumRecords)
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *GetSnapshotPath(Directory), FILEREAD_Silent))
+	{
+		if (OutError)
+		{
+			*OutError = FString::Printf(TEXT("no state snapshot in %s"), *Directory);
+		}
+		return false;
+	}
+
+	if (!OutSnapshot.Deserialize(Bytes, OutError))
+	{
+		return false;
+	}
+
+	if (OutSnapshot.SchemaHash != SchemaHash)
+	{
+		if (OutError)
+		{
+			*OutError = TEXT("snapshot was saved against a different schema");
+		}
+		return false;
+	}
+
+	int32 NumApplied = 0;
+	Bytes.Reset();
+	if (FFileHelper::LoadFileToArray(Bytes, *GetJournalPath(Directory), FILEREAD_Silent))
+	{
+		FZLStateBinaryReader Header(Bytes.GetData(), Bytes.Num());
+		uint32 Magic = 0;
+		uint32 Version = 0;
+		uint32 JournalGeneration = 0;
+		if (Header.ReadUInt32(Magic) && Header.ReadUInt32(Version) && Header.ReadUInt32(JournalGeneration)
+			&& Magic == JournalMagic && Version == FormatVersion && JournalGeneration == OutSnapshot.Generation)
+		{
+			// A torn or corrupt record can only be the tail of a write that never finished, everything before it stands
+			int64 Offset = Header.GetOffset();
+			while (Bytes.Num() - Offset >= RecordHeaderSize)
+			{
+				FZLStateBinaryReader Framing(Bytes.GetData() + Offset, RecordHeaderSize);
+				uint32 Size = 0;
+				uint32 Crc = 0;
+				Framing.ReadUInt32(Size);
+				Framing.ReadUInt32(Crc);
+
+				const uint8* Payload = Bytes.GetData() + Offset + RecordHeaderSize;
+				if (Size > Bytes.Num() - Offset - RecordHeaderSize || FCrc::MemCrc32(Payload, Size) != Crc || !ApplyRecord(Payload, Size, OutSnapshot))
+				{
+					UE_LOG(LogZLCloudPlugin, Warning, TEXT("State journal stopped at a damaged record after %d records"), NumApplied);
+					break;
+				}
+
+				Offset += RecordHeaderSize + Size;
+				++NumApplied;
+			}
+		}
+	}
+
+	if (OutNumRecords)
+	{
+		*OutNumRecords = NumApplied;
+	}
+	return true;
+}
+
+FString FZLStateJournal::GetSnapshotPath(const FString& Directory)
+{
+	return FPaths::Combine(Directory, TEXT("StateSnapshot.bin"));
+}
+
+FString FZLStateJournal::GetJournalPath(const FString& Directory)
+{
+	return FPaths::Combine(Directory, TEXT("StateJournal.bin"));
+}
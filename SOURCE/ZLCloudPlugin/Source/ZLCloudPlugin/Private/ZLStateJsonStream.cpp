@@ -0,0 +1,817 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#include "ZLStateJsonStream.h"
+#include "ZLCloudPluginStateManager.h"
+
+namespace
+{
+	// Far deeper than any real state, stops malformed input recursing off the stack
+	constexpr int32 MaxJsonDepth = 256;
+
+	// Single pass reader over UTF-8 or TCHAR text that merges into an existing object instead of building a DOM
+	template <typename CharType>
+	class TJsonMergeStream
+	{
+	public:
+		TJsonMergeStream(const CharType* InData, int32 InLength, FJsonKeyChangedCallback* InOnKeyChanged)
+			: Data(InData)
+			, End(InData + InLength)
+			, Cursor(InData)
+			, OnKeyChanged(InOnKeyChanged)
+		{
+			// Key buffers are reused per depth, sized up front so references to them stay valid while recursing
+			KeyStack.SetNum(MaxJsonDepth + 2);
+		}
+
+		bool Merge(FJsonObject& Target, FString* OutError)
+		{
+			return ReadDocument([this, &Target]()
+			{
+				return Consume('{') ? MergeObject(Target, 1) : Fail(TEXT("Expected an object"));
+			}, OutError);
+		}
+
+		bool Parse(TSharedPtr<FJsonObject>& OutObject, FString* OutError)
+		{
+			TSharedPtr<FJsonValue> Value;
+			const bool bSuccess = ReadDocument([this, &Value]()
+			{
+				return Cursor < End && ToCode(*Cursor) == '{' ? ParseValue(Value, 1) : Fail(TEXT("Expected an object"));
+			}, OutError);
+
+			if (bSuccess)
+			{
+				OutObject = Value->AsObject();
+			}
+			return bSuccess;
+		}
+
+	private:
+		bool ReadDocument(TFunctionRef<bool()> ReadObject, FString* OutError)
+		{
+			// Byte order mark
+			if (sizeof(CharType) == 1 && End - Cursor >= 3 && ToCode(Cursor[0]) == 0xEF && ToCode(Cursor[1]) == 0xBB && ToCode(Cursor[2]) == 0xBF)
+			{
+				Cursor += 3;
+			}
+			else if (sizeof(CharType) > 1 && Cursor < End && ToCode(*Cursor) == 0xFEFF)
+			{
+				++Cursor;
+			}
+
+			SkipWhitespace();
+			bool bSuccess = ReadObject();
+			if (bSuccess)
+			{
+				SkipWhitespace();
+				if (Cursor != End)
+				{
+					bSuccess = Fail(TEXT("Unexpected data after the object"));
+				}
+			}
+
+			if (!bSuccess && OutError)
+			{
+				*OutError = FString::Printf(TEXT("%s at offset %d"), *Error, (int32)(Cursor - Data));
+			}
+			return bSuccess;
+		}
+
+		static uint32 ToCode(CharType Char)
+		{
+			if constexpr (sizeof(CharType) == 1)
+			{
+				return (uint8)Char;
+			}
+			else
+			{
+				return (uint32)Char;
+			}
+		}
+
+		bool Fail(const TCHAR* Message)
+		{
+			if (Error.IsEmpty())
+			{
+				Error = Message;
+			}
+			return false;
+		}
+
+		void SkipWhitespace()
+		{
+			while (Cursor < End)
+			{
+				const uint32 Code = ToCode(*Cursor);
+				if (Code != ' ' && Code != '\t' && Code != '\n' && Code != '\r')
+				{
+					break;
+				}
+				++Cursor;
+			}
+		}
+
+		bool Consume(char Expected)
+		{
+			if (Cursor < End && ToCode(*Cursor) == (uint32)Expected)
+			{
+				++Cursor;
+				return true;
+			}
+			return false;
+		}
+
+		bool ConsumeLiteral(const char* Literal)
+		{
+			for (; *Literal; ++Literal)
+			{
+				if (!Consume(*Literal))
+				{
+					return Fail(TEXT("Invalid literal"));
+				}
+			}
+			return true;
+		}
+
+		// Dotted path of the value being applied, only kept up while someone is listening
+		int32 PushKey(const FString& Key)
+		{
+			const int32 Length = Path.Len();
+			if (OnKeyChanged)
+			{
+				if (Length > 0)
+				{
+					Path.AppendChar(TEXT('.'));
+				}
+				Path.Append(Key);
+			}
+			return Length;
+		}
+
+		void PopKey(int32 Length)
+		{
+			if (OnKeyChanged)
+			{
+				Path.LeftInline(Length);
+			}
+		}
+
+		void ReportChanged()
+		{
+			if (OnKeyChanged)
+			{
+				(*OnKeyChanged)(Path);
+			}
+		}
+
+		// Cursor is just past the '{'
+		bool MergeObject(FJsonObject& Target, int32 Depth)
+		{
+			if (Depth > MaxJsonDepth)
+			{
+				return Fail(TEXT("Nested too deeply"));
+			}
+
+			SkipWhitespace();
+			if (Consume('}'))
+			{
+				return true;
+			}
+
+			FString& Key = KeyStack[Depth];
+			for (;;)
+			{
+				SkipWhitespace();
+				if (!ParseString(Key))
+				{
+					return false;
+				}
+				SkipWhitespace();
+				if (!Consume(':'))
+				{
+					return Fail(TEXT("Expected ':'"));
+				}
+				SkipWhitespace();
+
+				const int32 PathLength = PushKey(Key);
+				if (!MergeValue(Target, Key, Depth))
+				{
+					return false;
+				}
+				PopKey(PathLength);
+
+				SkipWhitespace();
+				if (Consume(','))
+				{
+					continue;
+				}
+				if (Consume('}'))
+				{
+					return true;
+				}
+				return Fail(TEXT("Expected ',' or '}'"));
+			}
+		}
+
+		bool MergeValue(FJsonObject& Target, const FString& Key, int32 Depth)
+		{
+			if (Cursor >= End)
+			{
+				return Fail(TEXT("Unexpected end of data"));
+			}
+
+			TSharedPtr<FJsonValue>* Existing = Target.Values.Find(Key);
+			const uint32 Code = ToCode(*Cursor);
+
+			if (Code == '{')
+			{
+				// Objects merge into the one already there, anything else is replaced by the new subtree as a whole
+				if (Existing && Existing->IsValid() && (*Existing)->Type == EJson::Object)
+				{
+					++Cursor;
+					return MergeObject(*(*Existing)->AsObject(), Depth + 1);
+				}
+
+				TSharedPtr<FJsonValue> Value;
+				if (!ParseValue(Value, Depth + 1))
+				{
+					return false;
+				}
+				SetValue(Target, Existing, Key, Value);
+				return true;
+			}
+
+			if (Code == '[')
+			{
+				++Cursor;
+				TArray<TSharedPtr<FJsonValue>> Items;
+				if (!ParseArrayItems(Items, Depth + 1))
+				{
+					return false;
+				}
+
+				// Leaf values can be shared with other trees, so the merged array is always a new value
+				TArray<TSharedPtr<FJsonValue>> MergedItems;
+				const bool bExistingArray = Existing && Existing->IsValid() && (*Existing)->Type == EJson::Array;
+				if (bExistingArray)
+				{
+					MergedItems = (*Existing)->AsArray();
+				}
+
+				if (AppendUniqueJsonArrayItems(MergedItems, Items) > 0 || !bExistingArray)
+				{
+					SetValue(Target, Existing, Key, MakeShared<FJsonValueArray>(MergedItems));
+				}
+				return true;
+			}
+
+			EJson Type = EJson::None;
+			double Number = 0.0;
+			bool bBool = false;
+			if (!ParseScalar(Type, Number, bBool))
+			{
+				return false;
+			}
+
+			// Values that already match are left alone without allocating anything
+			if (Existing && Existing->IsValid() && MatchesScalar(**Existing, Type, Number, bBool))
+			{
+				return true;
+			}
+
+			SetValue(Target, Existing, Key, MakeScalar(Type, Number, bBool));
+			return true;
+		}
+
+		void SetValue(FJsonObject& Target, TSharedPtr<FJsonValue>* Existing, const FString& Key, const TSharedPtr<FJsonValue>& Value)
+		{
+			if (Existing)
+			{
+				*Existing = Value;
+			}
+			else
+			{
+				Target.Values.Add(Key, Value);
+			}
+			ReportChanged();
+		}
+
+		// Plain parse for array items and subtrees the target doesn't have, the same values FJsonSerializer would build
+		bool ParseValue(TSharedPtr<FJsonValue>& OutValue, int32 Depth)
+		{
+			if (Depth > MaxJsonDepth)
+			{
+				return Fail(TEXT("Nested too deeply"));
+			}
+			if (Cursor >= End)
+			{
+				return Fail(TEXT("Unexpected end of data"));
+			}
+
+			const uint32 Code = ToCode(*Cursor);
+			if (Code == '{')
+			{
+				++Cursor;
+				TSharedPtr<FJsonObject> Object = MakeShared<FJsonObject>();
+
+				SkipWhitespace();
+				if (!Consume('}'))
+				{
+					for (;;)
+					{
+						SkipWhitespace();
+						FString Key;
+						if (!ParseString(Key))
+						{
+							return false;
+						}
+						SkipWhitespace();
+						if (!Consume(':'))
+						{
+							return Fail(TEXT("Expected ':'"));
+						}
+						SkipWhitespace();
+
+						TSharedPtr<FJsonValue> Value;
+						if (!ParseValue(Value, Depth + 1))
+						{
+							return false;
+						}
+						Object->Values.Add(MoveTemp(Key), MoveTemp(Value));
+
+						SkipWhitespace();
+						if (Consume(','))
+						{
+							continue;
+						}
+						if (Consume('}'))
+						{
+							break;
+						}
+						return Fail(TEXT("Expected ',' or '}'"));
+					}
+				}
+
+				OutValue = MakeShared<FJsonValueObject>(Object);
+				return true;
+			}
+
+			if (Code == '[')
+			{
+				++Cursor;
+				TArray<TSharedPtr<FJsonValue>> Items;
+				if (!ParseArrayItems(Items, Depth + 1))
+				{
+					return false;
+				}
+				OutValue = MakeShared<FJsonValueArray>(Items);
+				return true;
+			}
+
+			EJson Type = EJson::None;
+			double Number = 0.0;
+			bool bBool = false;
+			if (!ParseScalar(Type, Number, bBool))
+			{
+				return false;
+			}
+			OutValue = MakeScalar(Type, Number, bBool);
+			return true;
+		}
+
+		// Cursor is just past the '['
+		bool ParseArrayItems(TArray<TSharedPtr<FJsonValue>>& OutItems, int32 Depth)
+		{
+			if (Depth > MaxJsonDepth)
+			{
+				return Fail(TEXT("Nested too deeply"));
+			}
+
+			SkipWhitespace();
+			if (Consume(']'))
+			{
+				return true;
+			}
+
+			for (;;)
+			{
+				SkipWhitespace();
+				if (!ParseValue(OutItems.AddDefaulted_GetRef(), Depth))
+				{
+					return false;
+				}
+
+				SkipWhitespace();
+				if (Consume(','))
+				{
+					continue;
+				}
+				if (Consume(']'))
+				{
+					return true;
+				}
+				return Fail(TEXT("Expected ',' or ']'"));
+			}
+		}
+
+		// Strings are left in ScalarString
+		bool ParseScalar(EJson& OutType, double& OutNumber, bool& bOutBool)
+		{
+			if (Cursor >= End)
+			{
+				return Fail(TEXT("Unexpected end of data"));
+			}
+
+			const uint32 Code = ToCode(*Cursor);
+			if (Code == '"')
+			{
+				OutType = EJson::String;
+				return ParseString(ScalarString);
+			}
+			if (Code == 't')
+			{
+				OutType = EJson::Boolean;
+				bOutBool = true;
+				return ConsumeLiteral("true");
+			}
+			if (Code == 'f')
+			{
+				OutType = EJson::Boolean;
+				bOutBool = false;
+				return ConsumeLiteral("false");
+			}
+			if (Code == 'n')
+			{
+				OutType = EJson::Null;
+				return ConsumeLiteral("null");
+			}
+			if (Code == '-' || (Code >= '0' && Code <= '9'))
+			{
+				OutType = EJson::Number;
+				return ParseNumber(OutNumber);
+			}
+			return Fail(TEXT("Unexpected character"));
+		}
+
+		bool MatchesScalar(const FJsonValue& Existing, EJson Type, double Number, bool bBool)
+		{
+			if (Existing.Type != Type)
+			{
+				return false;
+			}
+
+			switch (Type)
+			{
+			case EJson::String:
+				return Existing.TryGetString(CompareString) && CompareString.Equals(ScalarString, ESearchCase::CaseSensitive);
+			case EJson::Number:
+				return Existing.AsNumber() == Number;
+			case EJson::Boolean:
+				return Existing.AsBool() == bBool;
+			default:
+				return true;
+			}
+		}
+
+		TSharedPtr<FJsonValue> MakeScalar(EJson Type, double Number, bool bBool) const
+		{
+			switch (Type)
+			{
+			case EJson::String:
+				return MakeShared<FJsonValueString>(ScalarString);
+			case EJson::Number:
+				return MakeShared<FJsonValueNumber>(Number);
+			case EJson::Boolean:
+				return MakeShared<FJsonValueBoolean>(bBool);
+			default:
+				return MakeShared<FJsonValueNull>();
+			}
+		}
+
+		bool ParseNumber(double& OutNumber)
+		{
+			const CharType* Start = Cursor;
+			auto SkipDigits = [this]()
+			{
+				const CharType* DigitsStart = Cursor;
+				while (Cursor < End && ToCode(*Cursor) >= '0' && ToCode(*Cursor) <= '9')
+				{
+					++Cursor;
+				}
+				return Cursor > DigitsStart;
+			};
+
+			Consume('-');
+			bool bValid = SkipDigits();
+			if (bValid && Consume('.'))
+			{
+				bValid = SkipDigits();
+			}
+			if (bValid && (Consume('e') || Consume('E')))
+			{
+				if (!Consume('+'))
+				{
+					Consume('-');
+				}
+				bValid = SkipDigits();
+			}
+			if (!bValid)
+			{
+				return Fail(TEXT("Invalid number"));
+			}
+
+			TCHAR Buffer[128];
+			const int32 Length = (int32)(Cursor - Start);
+			if (Length >= UE_ARRAY_COUNT(Buffer))
+			{
+				return Fail(TEXT("Number too long"));
+			}
+			for (int32 i = 0; i < Length; ++i)
+			{
+				Buffer[i] = (TCHAR)ToCode(Start[i]);
+			}
+			Buffer[Length] = 0;
+
+			OutNumber = FCString::Atod(Buffer);
+			return true;
+		}
+
+		bool ParseHex4(uint32& OutCodeUnit)
+		{
+			if (End - Cursor < 4)
+			{
+				return Fail(TEXT("Invalid unicode escape"));
+			}
+
+			OutCodeUnit = 0;
+			for (int32 i = 0; i < 4; ++i, ++Cursor)
+			{
+				const uint32 Code = ToCode(*Cursor);
+				uint32 Digit;
+				if (Code >= '0' && Code <= '9')
+				{
+					Digit = Code - '0';
+				}
+				else if (Code >= 'a' && Code <= 'f')
+				{
+					Digit = Code - 'a' + 10;
+				}
+				else if (Code >= 'A' && Code <= 'F')
+				{
+					Digit = Code - 'A' + 10;
+				}
+				else
+				{
+					return Fail(TEXT("Invalid unicode escape"));
+				}
+				OutCodeUnit = (OutCodeUnit << 4) | Digit;
+			}
+			return true;
+		}
+
+		void AppendCodePoint(uint32 CodePoint)
+		{
+			if constexpr (sizeof(CharType) == 1)
+			{
+				if (CodePoint < 0x80)
+				{
+					StringBuffer.Add((CharType)CodePoint);
+					return;
+				}
+
+				bStringAscii = false;
+				if (CodePoint < 0x800)
+				{
+					StringBuffer.Add((CharType)(0xC0 | (CodePoint >> 6)));
+				}
+				else
+				{
+					if (CodePoint < 0x10000)
+					{
+						StringBuffer.Add((CharType)(0xE0 | (CodePoint >> 12)));
+					}
+					else
+					{
+						StringBuffer.Add((CharType)(0xF0 | (CodePoint >> 18)));
+						StringBuffer.Add((CharType)(0x80 | ((CodePoint >> 12) & 0x3F)));
+					}
+					StringBuffer.Add((CharType)(0x80 | ((CodePoint >> 6) & 0x3F)));
+				}
+				StringBuffer.Add((CharType)(0x80 | (CodePoint & 0x3F)));
+			}
+			else if (sizeof(CharType) == 2 && CodePoint >= 0x10000)
+			{
+				CodePoint -= 0x10000;
+				StringBuffer.Add((CharType)(0xD800 + (CodePoint >> 10)));
+				StringBuffer.Add((CharType)(0xDC00 + (CodePoint & 0x3FF)));
+			}
+			else
+			{
+				StringBuffer.Add((CharType)CodePoint);
+			}
+		}
+
+		void AssignString(FString& OutString, const CharType* Chars, int32 Length)
+		{
+			OutString.Reset(Length);
+			if constexpr (sizeof(CharType) == 1)
+			{
+				if (bStringAscii)
+				{
+					OutString.AppendChars((const ANSICHAR*)Chars, Length);
+				}
+				else
+				{
+					FUTF8ToTCHAR Converted(Chars, Length);
+					OutString.AppendChars(Converted.Get(), Converted.Length());
+				}
+			}
+			else
+			{
+				OutString.AppendChars(Chars, Length);
+			}
+		}
+
+		// Reuses OutString's allocation, escapes are only unpacked into a buffer for strings that have them
+		bool ParseString(FString& OutString)
+		{
+			if (!Consume('"'))
+			{
+				return Fail(TEXT("Expected a string"));
+			}
+
+			bStringAscii = true;
+			const CharType* Start = Cursor;
+			while (Cursor < End)
+			{
+				const uint32 Code = ToCode(*Cursor);
+				if (Code == '"' || Code == '\\')
+				{
+					break;
+				}
+				if (Code < 0x20)
+				{
+					return Fail(TEXT("Control character in string"));
+				}
+				bStringAscii &= Code < 0x80;
+				++Cursor;
+			}
+			if (Cursor >= End)
+			{
+				return Fail(TEXT("Unterminated string"));
+			}
+
+			if (ToCode(*Cursor) == '"')
+			{
+				AssignString(OutString, Start, (int32)(Cursor - Start));
+				++Cursor;
+				return true;
+			}
+
+			StringBuffer.Reset();
+			StringBuffer.Append(Start, (int32)(Cursor - Start));
+			for (;;)
+			{
+				if (Cursor >= End)
+				{
+					return Fail(TEXT("Unterminated string"));
+				}
+
+				const uint32 Code = ToCode(*Cursor++);
+				if (Code == '"')
+				{
+					break;
+				}
+				if (Code != '\\')
+				{
+					if (Code < 0x20)
+					{
+						return Fail(TEXT("Control character in string"));
+					}
+					bStringAscii &= Code < 0x80;
+					StringBuffer.Add(Cursor[-1]);
+					continue;
+				}
+
+				if (Cursor >= End)
+				{
+					return Fail(TEXT("Unterminated string"));
+				}
+				switch (ToCode(*Cursor++))
+				{
+				case '"': AppendCodePoint('"'); break;
+				case '\\': AppendCodePoint('\\'); break;
+				case '/': AppendCodePoint('/'); break;
+				case 'b': AppendCodePoint('\b'); break;
+				case 'f': AppendCodePoint('\f'); break;
+				case 'n': AppendCodePoint('\n'); break;
+				case 'r': AppendCodePoint('\r'); break;
+				case 't': AppendCodePoint('\t'); break;
+				case 'u':
+				{
+					uint32 CodePoint;
+					if (!ParseHex4(CodePoint))
+					{
+						return false;
+					}
+
+					// Surrogate pairs are combined, a lone surrogate is kept as it is
+					if (CodePoint >= 0xD800 && CodePoint <= 0xDBFF && End - Cursor >= 6 && ToCode(Cursor[0]) == '\\' && ToCode(Cursor[1]) == 'u')
+					{
+						const CharType* PairStart = Cursor;
+						Cursor += 2;
+						uint32 LowSurrogate;
+						if (!ParseHex4(LowSurrogate))
+						{
+							return false;
+						}
+						if (LowSurrogate >= 0xDC00 && LowSurrogate <= 0xDFFF)
+						{
+							CodePoint = 0x10000 + ((CodePoint - 0xD800) << 10) + (LowSurrogate - 0xDC00);
+						}
+						else
+						{
+							Cursor = PairStart;
+						}
+					}
+					AppendCodePoint(CodePoint);
+					break;
+				}
+				default:
+					return Fail(TEXT("Invalid escape in string"));
+				}
+			}
+
+			AssignString(OutString, StringBuffer.GetData(), StringBuffer.Num());
+			return true;
+		}
+
+		const CharType* Data;
+		const CharType* End;
+		const CharType* Cursor;
+		FJsonKeyChangedCallback* OnKeyChanged;
+
+		FString Error;
+		FString Path;
+		TArray<FString> KeyStack;
+
+		// Scratch space reused across values
+		TArray<CharType> StringBuffer;
+		bool bStringAscii = true;
+		FString ScalarString;
+		FString CompareString;
+	};
+
+	template <typename CharType>
+	bool MergeJsonStream(const CharType* Data, int32 Length, const TSharedPtr<FJsonObject>& Target, FJsonKeyChangedCallback* OnKeyChanged, FString* OutError)
+	{
+		if (!Target.IsValid())
+		{
+			if (OutError)
+			{
+				*OutError = TEXT("Invalid target object");
+			}
+			return false;
+		}
+
+		TJsonMergeStream<CharType> Stream(Data, Length, OnKeyChanged);
+		return Stream.Merge(*Target, OutError);
+	}
+
+	template <typename CharType>
+	bool ParseJsonStream(const CharType* Data, int32 Length, TSharedPtr<FJsonObject>& OutObject, FString* OutError)
+	{
+		TJsonMergeStream<CharType> Stream(Data, Length, nullptr);
+		return Stream.Parse(OutObject, OutError);
+	}
+}
+
+bool MergeJsonIntoObject(FUtf8StringView Json, const TSharedPtr<FJsonObject>& Target, FJsonKeyChangedCallback OnKeyChanged, FString* OutError)
+{
+	return MergeJsonStream(Json.GetData(), Json.Len(), Target, &OnKeyChanged, OutError);
+}
+
+bool MergeJsonIntoObject(FUtf8StringView Json, const TSharedPtr<FJsonObject>& Target, FString* OutError)
+{
+	return MergeJsonStream(Json.GetData(), Json.Len(), Target, nullptr, OutError);
+}
+
+bool MergeJsonIntoObject(FStringView Json, const TSharedPtr<FJsonObject>& Target, FJsonKeyChangedCallback OnKeyChanged, FString* OutError)
+{
+	return MergeJsonStream(Json.GetData(), Json.Len(), Target, &OnKeyChanged, OutError);
+}
+
+bool MergeJsonIntoObject(FStringView Json, const TSharedPtr<FJsonObject>& Target, FString* OutError)
+{
+	return MergeJsonStream(Json.GetData(), Json.Len(), Target, nullptr, OutError);
+}
+
+bool ParseJsonObject(FUtf8StringView Json, TSharedPtr<FJsonObject>& OutObject, FString* OutError)
+{
+	return ParseJsonStream(Json.GetData(), Json.Len(), OutObject, OutError);
+}
+
+bool ParseJsonObject(FStringView Json, TSharedPtr<FJsonObject>& OutObject, FString* OutError)
+{
+	return ParseJsonStream(Json.GetData(), Json.Len(), OutObject, OutError);
+}
@@ -2,122 +2,91 @@
 
 #include "ZLStateKeyInfo.h"
 
-TSharedRef<FJsonObject> UStateKeyInfoAsset::SerializeStateKeyAssetToJson()
+// Helper to convert a single FStateKeyInfo into its ZEROLIGHT_SCHEMA_DATA entry, null for an invalid data type
+TSharedPtr<FJsonObject> ConvertInfoToSchemaDataEntry(const FStateKeyInfo& Info)
 {
-	TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
-	TSharedRef<FJsonObject> SchemaData = MakeShared<FJsonObject>();
+	TSharedRef<FJsonObject> EntryObject = MakeShared<FJsonObject>();
+	EntryObject->SetStringField(TEXT("DataType"), Info.DataType);
+	EntryObject->SetBoolField(TEXT("bLimitValues"), Info.bLimitValues);
+	EntryObject->SetBoolField(TEXT("bIgnoredInDataHashes"), Info.bIgnoredInDataHashes);
 
-	for (const TPair<FString, FStateKeyInfo>& Pair : KeyInfos)
+	switch (Info.GetDataTypeEnum())
 	{
-		const FString& DottedKey = Pair.Key;
-		const FStateKeyInfo& Info = Pair.Value;
-
-		TSharedRef<FJsonObject> EntryObject = MakeShared<FJsonObject>();
-		EntryObject->SetStringField(TEXT("DataType"), Info.DataType);
-		EntryObject->SetBoolField(TEXT("bLimitValues"), Info.bLimitValues);
-		EntryObject->SetBoolField(TEXT("bIgnoredInDataHashes"), Info.bIgnoredInDataHashes);
-
-		switch (Info.GetDataTypeEnum())
-		{
-		case EStateKeyDataType::String:
-			EntryObject->SetStringField(TEXT("DefaultValue"), Info.DefaultStringValue);
-			if (Info.bLimitValues)
-			{
-				TArray<TSharedPtr<FJsonValue>> JsonArray;
-				for (const FString& Val : Info.AcceptedStringValues)
-					JsonArray.Add(MakeShared<FJsonValueString>(Val));
-				EntryObject->SetArrayField(TEXT("AcceptedValues"), JsonArray);
-			}
-			break;
-
-		case EStateKeyDataType::Number:
-			EntryObject->SetNumberField(TEXT("DefaultValue"), Info.DefaultNumberValue);
-			if (Info.bLimitValues)
-			{
-				TArray<TSharedPtr<FJsonValue>> JsonArray;
-				for (double Val : Info.AcceptedNumberValues)
-					JsonArray.Add(MakeShared<FJsonValueNumber>(Val));
-				EntryObject->SetArrayField(TEXT("AcceptedValues"), JsonArray);
-			}
-			break;
-
-		case EStateKeyDataType::Bool:
-			EntryObject->SetBoolField(TEXT("DefaultValue"), Info.DefaultBoolValue);
-			break;
-
-		case EStateKeyDataType::StringArray:
+	case EStateKeyDataType::String:
+		EntryObject->SetStringField(TEXT("DefaultValue"), Info.DefaultStringValue);
+		if (Info.bLimitValues)
 		{
 			TArray<TSharedPtr<FJsonValue>> JsonArray;
-			for (const FString& Val : Info.DefaultStringArray)
+			for (const FString& Val : Info.AcceptedStringValues)
 				JsonArray.Add(MakeShared<FJsonValueString>(Val));
-			EntryObject->SetArrayField(TEXT("DefaultValue"), JsonArray);
-
-			if (Info.bLimitValues)
-			{
-				TArray<TSharedPtr<FJsonValue>> AcceptedArray;
-				for (const FString& Val : Info.AcceptedStringValues)
-					AcceptedArray.Add(MakeShared<FJsonValueString>(Val));
-				EntryObject->SetArrayField(TEXT("AcceptedValues"), AcceptedArray);
-			}
-			break;
+			EntryObject->SetArrayField(TEXT("AcceptedValues"), JsonArray);
 		}
+		break;
 
-		case EStateKeyDataType::NumberArray:
+	case EStateKeyDataType::Number:
+		EntryObject->SetNumberField(TEXT("DefaultValue"), Info.DefaultNumberValue);
+		if (Info.bLimitValues)
 		{
 			TArray<TSharedPtr<FJsonValue>> JsonArray;
-			for (double Val : Info.DefaultNumberArray)
+			for (double Val : Info.AcceptedNumberValues)
 				JsonArray.Add(MakeShared<FJsonValueNumber>(Val));
-			EntryObject->SetArrayField(TEXT("DefaultValue"), JsonArray);
-
-			if (Info.bLimitValues)
-			{
-				TArray<TSharedPtr<FJsonValue>> AcceptedArray;
-				for (double Val : Info.AcceptedNumberValues)
-					AcceptedArray.Add(MakeShared<FJsonValueNumber>(Val));
-				EntryObject->SetArrayField(TEXT("AcceptedValues"), AcceptedArray);
-			}
-			break;
-		}
-
-		case EStateKeyDataType::BoolArray:
-		{
-			TArray<TSharedPtr<FJsonValue>> JsonArray;
-			for (bool Val : Info.DefaultBoolArray)
-				JsonArray.Add(MakeShared<FJsonValueBoolean>(Val));
-			EntryObject->SetArrayField(TEXT("DefaultValue"), JsonArray);
-			break;
+			EntryObject->SetArrayField(TEXT("AcceptedValues"), JsonArray);
 		}
+		break;
 
-		case EStateKeyDataType::Invalid:
-		default:
-			continue;
-		}
+	case EStateKeyDataType::Bool:
+		EntryObject->SetBoolField(TEXT("DefaultValue"), Info.DefaultBoolValue);
+		break;
 
-		TArray<FString> KeyParts;
-		DottedKey.ParseIntoArray(KeyParts, TEXT("."), true);
+	case EStateKeyDataType::StringArray:
+	{
+		TArray<TSharedPtr<FJsonValue>> JsonArray;
+		for (const FString& Val : Info.DefaultStringArray)
+			JsonArray.Add(MakeShared<FJsonValueString>(Val));
+		EntryObject->SetArrayField(TEXT("DefaultValue"), JsonArray);
 
-		TSharedRef<FJsonObject> CurrentLevel = SchemaData;
-		for (int32 i = 0; i < KeyParts.Num(); ++i)
+		if (Info.bLimitValues)
 		{
-			const FString& Part = KeyParts[i];
+			TArray<TSharedPtr<FJsonValue>> AcceptedArray;
+			for (const FString& Val : Info.AcceptedStringValues)
+				AcceptedArray.Add(MakeShared<FJsonValueString>(Val));
+			EntryObject->SetArrayField(TEXT("AcceptedValues"), AcceptedArray);
+		}
+		break;
+	}
 
-			if (i == KeyParts.Num() - 1)
-			{
-				CurrentLevel->SetObjectField(Part, EntryObject);
-			}
-			else
-			{
-				TSharedPtr<FJsonObject> Child = CurrentLevel->Values.Contains(Part) ? CurrentLevel->GetObjectField(Part) : MakeShared<FJsonObject>();
+	case EStateKeyDataType::NumberArray:
+	{
+		TArray<TSharedPtr<FJsonValue>> JsonArray;
+		for (double Val : Info.DefaultNumberArray)
+			JsonArray.Add(MakeShared<FJsonValueNumber>(Val));
+		EntryObject->SetArrayField(TEXT("DefaultValue"), JsonArray);
 
-				CurrentLevel->SetObjectField(Part, Child);
-				CurrentLevel = Child.ToSharedRef();
-			}
+		if (Info.bLimitValues)
+		{
+			TArray<TSharedPtr<FJsonValue>> AcceptedArray;
+			for (double Val : Info.AcceptedNumberValues)
+				AcceptedArray.Add(MakeShared<FJsonValueNumber>(Val));
+			EntryObject->SetArrayField(TEXT("AcceptedValues"), AcceptedArray);
 		}
+		break;
+	}
+
+	case EStateKeyDataType::BoolArray:
+	{
+		TArray<TSharedPtr<FJsonValue>> JsonArray;
+		for (bool Val : Info.DefaultBoolArray)
+			JsonArray.Add(MakeShared<FJsonValueBoolean>(Val));
+		EntryObject->SetArrayField(TEXT("DefaultValue"), JsonArray);
+		break;
 	}
 
-	Root->SetObjectField("ZEROLIGHT_SCHEMA_DATA", SchemaData);
+	case EStateKeyDataType::Invalid:
+	default:
+		return nullptr;
+	}
 
-	return Root;
+	return EntryObject;
 }
 
 // Helper to convert a single FStateKeyInfo into a JSON Schema Leaf Node
@@ -259,67 +228,248 @@ TSharedPtr<FJsonObject> ConvertInfoToSchemaNode(const FStateKeyInfo& Info)
 	return Node;
 }
 
-TSharedRef<FJsonObject> UStateKeyInfoAsset::SerializeStateKeyAsset_JsonSchemaCompliant()
+namespace
 {
-	TSharedRef<FJsonObject> RootSchema = MakeShared<FJsonObject>();
+	bool AreDoublesIdentical(const double* A, const double* B, int32 Num)
+	{
+		// Bitwise, -0 and 0 serialize differently
+		return FMemory::Memcmp(A, B, Num * sizeof(double)) == 0;
+	}
 
-	RootSchema->SetStringField("$schema", "https://json-schema.org/draft/2020-12/schema");
-	RootSchema->SetStringField("type", "object");
-	RootSchema->SetStringField("title", GetName());
+	bool AreStringArraysIdentical(const TArray<FString>& A, const TArray<FString>& B)
+	{
+		if (A.Num() != B.Num())
+		{
+			return false;
+		}
+		for (int32 i = 0; i < A.Num(); ++i)
+		{
+			if (!A[i].Equals(B[i], ESearchCase::CaseSensitive))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
 
-	TSharedPtr<FJsonObject> RootProperties = MakeShared<FJsonObject>();
-	RootSchema->SetObjectField("properties", RootProperties);
+	// True if both infos serialize to the same bytes in either form
+	bool AreKeyInfosIdentical(const FStateKeyInfo& A, const FStateKeyInfo& B)
+	{
+		return A.DataType.Equals(B.DataType, ESearchCase::CaseSensitive)
+			&& A.bLimitValues == B.bLimitValues
+			&& A.bIgnoredInDataHashes == B.bIgnoredInDataHashes
+			&& A.DefaultStringValue.Equals(B.DefaultStringValue, ESearchCase::CaseSensitive)
+			&& AreDoublesIdentical(&A.DefaultNumberValue, &B.DefaultNumberValue, 1)
+			&& A.DefaultBoolValue == B.DefaultBoolValue
+			&& AreStringArraysIdentical(A.DefaultStringArray, B.DefaultStringArray)
+			&& A.DefaultNumberArray.Num() == B.DefaultNumberArray.Num() && AreDoublesIdentical(A.DefaultNumberArray.GetData(), B.DefaultNumberArray.GetData(), A.DefaultNumberArray.Num())
+			&& A.DefaultBoolArray == B.DefaultBoolArray
+			&& AreStringArraysIdentical(A.AcceptedStringValues, B.AcceptedStringValues)
+			&& A.AcceptedNumberValues.Num() == B.AcceptedNumberValues.Num() && AreDoublesIdentical(A.AcceptedNumberValues.GetData(), B.AcceptedNumberValues.GetData(), A.AcceptedNumberValues.Num());
+	}
 
-	for (const TPair<FString, FStateKeyInfo>& Entry : KeyInfos)
+	// Links a key's entry into the ZEROLIGHT_SCHEMA_DATA tree. A key that is also the parent of other keys gets those keys added
+	// inside its entry, so it needs a copy of the cached entry rather than the entry itself
+	void PlaceSchemaDataEntry(const TSharedRef<FJsonObject>& SchemaData, const TArray<FString>& KeyParts, const TSharedPtr<FJsonObject>& EntryObject)
 	{
-		FString FullKey = Entry.Key;
-		const FStateKeyInfo& Info = Entry.Value;
+		TSharedRef<FJsonObject> CurrentLevel = SchemaData;
+		for (int32 i = 0; i < KeyParts.Num(); ++i)
+		{
+			const FString& Part = KeyParts[i];
 
-		TArray<FString> KeyParts;
-		FullKey.ParseIntoArray(KeyParts, TEXT("."), true);
+			if (i == KeyParts.Num() - 1)
+			{
+				CurrentLevel->SetObjectField(Part, EntryObject);
+			}
+			else
+			{
+				TSharedPtr<FJsonObject> Child = CurrentLevel->Values.Contains(Part) ? CurrentLevel->GetObjectField(Part) : MakeShared<FJsonObject>();
+
+				CurrentLevel->SetObjectField(Part, Child);
+				CurrentLevel = Child.ToSharedRef();
+			}
+		}
+	}
 
+	// Links a key's leaf node into the JSON Schema properties, the same way round as PlaceSchemaDataEntry
+	void PlaceJsonSchemaNode(const TSharedPtr<FJsonObject>& RootProperties, const TArray<FString>& KeyParts, const TSharedPtr<FJsonObject>& LeafNode)
+	{
 		TSharedPtr<FJsonObject> CurrentContext = RootProperties;
 
 		for (int32 i = 0; i < KeyParts.Num(); i++)
 		{
-			FString PartName = KeyParts[i];
+			const FString& PartName = KeyParts[i];
 			bool bIsLeaf = (i == KeyParts.Num() - 1);
 
 			if (bIsLeaf)
 			{
-				TSharedPtr<FJsonObject> LeafNode = ConvertInfoToSchemaNode(Info);
 				CurrentContext->SetObjectField(PartName, LeafNode);
 			}
-			else
+			else if (CurrentContext->HasField(PartName))
 			{
+				TSharedPtr<FJsonObject> ExistingObj = CurrentContext->GetObjectField(PartName);
 
-				if (CurrentContext->HasField(PartName))
+				if (!ExistingObj->HasField("properties"))
 				{
-					TSharedPtr<FJsonObject> ExistingObj = CurrentContext->GetObjectField(PartName);
+					ExistingObj->SetObjectField("properties", MakeShared<FJsonObject>());
+				}
 
-					if (!ExistingObj->HasField("properties"))
-					{
-						ExistingObj->SetObjectField("properties", MakeShared<FJsonObject>());
-					}
+				CurrentContext = ExistingObj->GetObjectField("properties");
+			}
+			else
+			{
+				TSharedPtr<FJsonObject> NewContainer = MakeShared<FJsonObject>();
+				NewContainer->SetStringField("type", "object");
 
-					CurrentContext = ExistingObj->GetObjectField("properties");
-				}
-				else
-				{
-					TSharedPtr<FJsonObject> NewContainer = MakeShared<FJsonObject>();
-					NewContainer->SetStringField("type", "object");
+				TSharedPtr<FJsonObject> NewProperties = MakeShared<FJsonObject>();
+				NewContainer->SetObjectField("properties", NewProperties);
 
-					TSharedPtr<FJsonObject> NewProperties = MakeShared<FJsonObject>();
-					NewContainer->SetObjectField("properties", NewProperties);
+				CurrentContext->SetObjectField(PartName, NewContainer);
 
-					CurrentContext->SetObjectField(PartName, NewContainer);
+				CurrentContext = NewProperties;
+			}
+		}
+	}
+}
 
-					CurrentContext = NewProperties;
-				}
+void UStateKeyInfoAsset::UpdateSerializedSchema()
+{
+	if (bSerializedSchemaValid && SerializedSchemaNumKeyInfos == KeyInfos.Num())
+	{
+		return;
+	}
+
+	const FZLStateKeyTrie& Trie = GetKeyTrie();
+
+	SerializedSchemaData = MakeShared<FJsonObject>();
+	SerializedSchemaProperties = MakeShared<FJsonObject>();
+
+	// Both forms in one pass, in KeyInfos order like a full rebuild so the output is byte for byte the same
+	for (const TPair<FString, FStateKeyInfo>& Entry : KeyInfos)
+	{
+		const FStateKeyInfo& Info = Entry.Value;
+
+		FSchemaKeyFragment& Fragment = SchemaKeyFragments.FindOrAdd(Entry.Key);
+		if (!Fragment.JsonSchemaNode.IsValid() || !AreKeyInfosIdentical(Fragment.Info, Info))
+		{
+			Fragment.Info = Info;
+			Fragment.SchemaDataEntry = ConvertInfoToSchemaDataEntry(Info);
+			Fragment.JsonSchemaNode = ConvertInfoToSchemaNode(Info);
+		}
+
+		TArray<FString> KeyParts;
+		Entry.Key.ParseIntoArray(KeyParts, TEXT("."), true);
+		if (KeyParts.Num() == 0)
+		{
+			continue;
+		}
+
+		const FZLStateKeyTrie::FNode* Node = FZLStateKeyQuery::FindNode(Trie.GetRoot(), Entry.Key);
+		const bool bAlsoParent = Node && Node->HasKeysBelow();
+
+		if (Fragment.SchemaDataEntry.IsValid())
+		{
+			PlaceSchemaDataEntry(SerializedSchemaData.ToSharedRef(), KeyParts, bAlsoParent ? MakeShared<FJsonObject>(*Fragment.SchemaDataEntry) : Fragment.SchemaDataEntry);
+		}
+		PlaceJsonSchemaNode(SerializedSchemaProperties, KeyParts, bAlsoParent ? MakeShared<FJsonObject>(*Fragment.JsonSchemaNode) : Fragment.JsonSchemaNode);
+	}
+
+	// Every key has a fragment now, any others are for keys that have gone
+	if (SchemaKeyFragments.Num() > KeyInfos.Num())
+	{
+		for (TMap<FString, FSchemaKeyFragment>::TIterator It = SchemaKeyFragments.CreateIterator(); It; ++It)
+		{
+			if (!KeyInfos.Contains(It->Key))
+			{
+				It.RemoveCurrent();
 			}
 		}
 	}
 
+	bSerializedSchemaValid = true;
+	SerializedSchemaNumKeyInfos = KeyInfos.Num();
+}
+
+TSharedRef<FJsonObject> UStateKeyInfoAsset::SerializeStateKeyAssetToJson()
+{
+	UpdateSerializedSchema();
+
+	TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
+	Root->SetObjectField("ZEROLIGHT_SCHEMA_DATA", SerializedSchemaData);
+
+	return Root;
+}
+
+TSharedRef<FJsonObject> UStateKeyInfoAsset::SerializeStateKeyAsset_JsonSchemaCompliant()
+{
+	UpdateSerializedSchema();
+
+	TSharedRef<FJsonObject> RootSchema = MakeShared<FJsonObject>();
+
+	RootSchema->SetStringField("$schema", "https://json-schema.org/draft/2020-12/schema");
+	RootSchema->SetStringField("type", "object");
+	RootSchema->SetStringField("title", GetName());
+	RootSchema->SetObjectField("properties", SerializedSchemaProperties);
+
 	return RootSchema;
 }
 
+void UStateKeyInfoAsset::InvalidateKeyCaches()
+{
+	bKeyTrieValid = false;
+	// Fragments stay, each is checked against its key's info on the next rebuild
+	bSerializedSchemaValid = false;
+}
+
+const FZLStateKeyTrie& UStateKeyInfoAsset::GetKeyTrie() const
+{
+	if (!bKeyTrieValid || KeyTrieNumKeyInfos != KeyInfos.Num())
+	{
+		KeyTrie.Reset();
+		for (const TPair<FString, FStateKeyInfo>& Pair : KeyInfos)
+		{
+			KeyTrie.Add(Pair.Key);
+		}
+		bKeyTrieValid = true;
+		KeyTrieNumKeyInfos = KeyInfos.Num();
+	}
+	return KeyTrie;
+}
+
+void UStateKeyInfoAsset::OnKeyAdded(const FString& Key)
+{
+	// An unbuilt trie picks the key up when it is built
+	if (bKeyTrieValid)
+	{
+		KeyTrie.Add(Key);
+		KeyTrieNumKeyInfos = KeyInfos.Num();
+	}
+	bSerializedSchemaValid = false;
+}
+
+void UStateKeyInfoAsset::OnKeyRemoved(const FString& Key)
+{
+	if (bKeyTrieValid)
+	{
+		KeyTrie.Remove(Key);
+		KeyTrieNumKeyInfos = KeyInfos.Num();
+	}
+	SchemaKeyFragments.Remove(Key);
+	bSerializedSchemaValid = false;
+}
+
+void UStateKeyInfoAsset::OnKeyChanged(const FString& Key)
+{
+	SchemaKeyFragments.Remove(Key);
+	bSerializedSchemaValid = false;
+}
+
+#if WITH_EDITOR
+void UStateKeyInfoAsset::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	// Keys may have been renamed or edited in the details panel without changing how many there are
+	InvalidateKeyCaches();
+}
+#endif
@@ -0,0 +1,169 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#include "ZLStateKeyMetrics.h"
+
+const double FZLStateKeyTiming::BucketLimits[FZLStateKeyTiming::NumBuckets - 1] = { 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 20.0, 30.0, 60.0 };
+
+const TCHAR* FZLStateKeyMetrics::OtherKey = TEXT("(other)");
+
+double FZLStateKeyTiming::GetPercentileSeconds(double Percentile) const
+{
+	if (NumConfirms == 0)
+	{
+		return 0.0;
+	}
+
+	const double Target = FMath::Clamp(Percentile, 0.0, 1.0) * NumConfirms;
+	uint32 Count = 0;
+	for (int32 Bucket = 0; Bucket < NumBuckets - 1; ++Bucket)
+	{
+		Count += Buckets[Bucket];
+		if (Count >= Target && Count > 0)
+		{
+			return FMath::Min(BucketLimits[Bucket], MaxSeconds);
+		}
+	}
+	return MaxSeconds;
+}
+
+FZLStateKeyTiming& FZLStateKeyMetrics::FindOrAddKey(const FString& Key)
+{
+	if (FZLStateKeyTiming* Timing = Keys.Find(Key))
+	{
+		return *Timing;
+	}
+	return Keys.FindOrAdd(Keys.Num() < MaxTrackedKeys ? Key : FString(OtherKey));
+}
+
+void FZLStateKeyMetrics::RecordConfirm(const FString& Key, double Seconds)
+{
+	Seconds = FMath::Max(Seconds, 0.0);
+
+	FZLStateKeyTiming& Timing = FindOrAddKey(Key);
+	++Timing.NumConfirms;
+	Timing.TotalSeconds += Seconds;
+	Timing.MaxSeconds = FMath::Max(Timing.MaxSeconds, Seconds);
+
+	int32 Bucket = 0;
+	while (Bucket < FZLStateKeyTiming::NumBuckets - 1 && Seconds > FZLStateKeyTiming::BucketLimits[Bucket])
+	{
+		++Bucket;
+	}
+	++Timing.Buckets[Bucket];
+}
+
+void FZLStateKeyMetrics::RecordWarning(const FString& Key)
+{
+	++FindOrAddKey(Key).NumWarnings;
+}
+
+void FZLStateKeyMetrics::RecordTimeout(const FString& Key)
+{
+	++FindOrAddKey(Key).NumTimeouts;
+}
+
+void FZLStateKeyMetrics::Reset()
+{
+	Keys.Reset();
+}
+
+TArray<TPair<FString, const FZLStateKeyTiming*>> FZLStateKeyMetrics::GetSortedKeys() const
+{
+	TArray<TPair<FString, const FZLStateKeyTiming*>> Sorted;
+	Sorted.Reserve(Keys.Num());
+	for (const TPair<FString, FZLStateKeyTiming>& Pair : Keys)
+	{
+		Sorted.Emplace(Pair.Key, &Pair.Value);
+	}
+
+	Sorted.Sort([](const TPair<FString, const FZLStateKeyTiming*>& A, const TPair<FString, const FZLStateKeyTiming*>& B)
+	{
+		if (A.Value->NumTimeouts != B.Value->NumTimeouts)
+		{
+			return A.Value->NumTimeouts > B.Value->NumTimeouts;
+		}
+		if (A.Value->NumWarnings != B.Value->NumWarnings)
+		{
+			return A.Value->NumWarnings > B.Value->NumWarnings;
+		}
+		return A.Value->TotalSeconds > B.Value->TotalSeconds;
+	});
+	return Sorted;
+}
+
+TSharedRef<FJsonObject> FZLStateKeyMetrics::ToJson(int32 MaxKeys) const
+{
+	TSharedRef<FJsonObject> Json = MakeShared<FJsonObject>();
+
+	TArray<TSharedPtr<FJsonValue>> Limits;
+	for (double Limit : FZLStateKeyTiming::BucketLimits)
+	{
+		Limits.Add(MakeShared<FJsonValueNumber>(Limit));
+	}
+	Json->SetArrayField(TEXT("bucket_limits"), Limits);
+
+	TArray<TSharedPtr<FJsonValue>> KeyValues;
+	for (const TPair<FString, const FZLStateKeyTiming*>& Pair : GetSortedKeys())
+	{
+		if (MaxKeys > 0 && KeyValues.Num() >= MaxKeys)
+		{
+			break;
+		}
+
+		const FZLStateKeyTiming& Timing = *Pair.Value;
+		TSharedRef<FJsonObject> KeyJson = MakeShared<FJsonObject>();
+		KeyJson->SetStringField(TEXT("key"), Pair.Key);
+		KeyJson->SetNumberField(TEXT("confirms"), Timing.NumConfirms);
+		KeyJson->SetNumberField(TEXT("mean"), Timing.GetMeanSeconds());
+		KeyJson->SetNumberField(TEXT("p50"), Timing.GetPercentileSeconds(0.5));
+		KeyJson->SetNumberField(TEXT("p95"), Timing.GetPercentileSeconds(0.95));
+		KeyJson->SetNumberField(TEXT("max"), Timing.MaxSeconds);
+		KeyJson->SetNumberField(TEXT("warnings"), Timing.NumWarnings);
+		KeyJson->SetNumberField(TEXT("timeouts"), Timing.NumTimeouts);
+
+		TArray<TSharedPtr<FJsonValue>> Histogram;
+		for (uint32 Count : Timing.Buckets)
+		{
+			Histogram.Add(MakeShared<FJsonValueNumber>(Count));
+		}
+		KeyJson->SetArrayField(TEXT("histogram"), Histogram);
+
+		KeyValues.Add(MakeShared<FJsonValueObject>(KeyJson));
+	}
+	Json->SetArrayField(TEXT("keys"), KeyValues);
+
+	return Json;
+}
+
+TArray<FString> FZLStateKeyMetrics::ToLines(int32 MaxKeys) const
+{
+	TArray<FString> Lines;
+
+	FString Header = TEXT("  Histogram buckets (s):");
+	for (double Limit : FZLStateKeyTiming::BucketLimits)
+	{
+		Header += FString::Printf(TEXT(" <=%g"), Limit);
+	}
+	Header += TEXT(" >");
+	Lines.Add(Header);
+
+	for (const TPair<FString, const FZLStateKeyTiming*>& Pair : GetSortedKeys())
+	{
+		if (MaxKeys > 0 && Lines.Num() > MaxKeys)
+		{
+			break;
+		}
+
+		const FZLStateKeyTiming& Timing = *Pair.Value;
+		FString Histogram;
+		for (uint32 Count : Timing.Buckets)
+		{
+			Histogram += FString::Printf(TEXT(" %u"), Count);
+		}
+
+		Lines.Add(FString::Printf(TEXT("  %s: %d confirms, mean %.3fs, p50 %.3fs, p95 %.3fs, max %.3fs, %d warnings, %d timeouts, histogram%s"),
+			*Pair.Key, Timing.NumConfirms, Timing.GetMeanSeconds(), Timing.GetPercentileSeconds(0.5), Timing.GetPercentileSeconds(0.95),
+			Timing.MaxSeconds, Timing.NumWarnings, Timing.NumTimeouts, *Histogram));
+	}
+	return Lines;
+}
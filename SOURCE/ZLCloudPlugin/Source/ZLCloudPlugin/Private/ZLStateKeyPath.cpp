@@ -0,0 +1,173 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#include "ZLStateKeyPath.h"
+#include "Misc/ScopeRWLock.h"
+
+namespace
+{
+	// Interned paths are matched case sensitively, FJsonObject lookups keep their own (case insensitive) key comparison
+	template <typename ValueType>
+	struct TCaseSensitiveStringKeyFuncs : BaseKeyFuncs<TPair<FString, ValueType>, FString, false>
+	{
+		static const FString& GetSetKey(const TPair<FString, ValueType>& Element) { return Element.Key; }
+		static bool Matches(const FString& A, const FString& B) { return A.Equals(B, ESearchCase::CaseSensitive); }
+		static uint32 GetKeyHash(const FString& Key) { return FCrc::StrCrc32(*Key); }
+	};
+}
+
+struct FZLStateKeyPath::FTable
+{
+	FRWLock Lock;
+	TMap<FString, int32, FDefaultSetAllocator, TCaseSensitiveStringKeyFuncs<int32>> IdsByPath;
+	// Owned separately so handles can keep raw pointers while the array grows
+	TArray<TUniquePtr<FData>> Paths;
+};
+
+FZLStateKeyPath::FTable& FZLStateKeyPath::GetTable()
+{
+	static FTable Table;
+	return Table;
+}
+
+FZLStateKeyPath FZLStateKeyPath::Intern(const FString& InPath)
+{
+	FTable& Table = GetTable();
+
+	{
+		FReadScopeLock ReadLock(Table.Lock);
+		if (const int32* Id = Table.IdsByPath.Find(InPath))
+		{
+			return FZLStateKeyPath(Table.Paths[*Id].Get());
+		}
+	}
+
+	FWriteScopeLock WriteLock(Table.Lock);
+
+	// Another thread may have interned it between the two locks
+	if (const int32* Id = Table.IdsByPath.Find(InPath))
+	{
+		return FZLStateKeyPath(Table.Paths[*Id].Get());
+	}
+
+	TUniquePtr<FData> NewData = MakeUnique<FData>();
+	NewData->Id = Table.Paths.Num();
+	NewData->Path = InPath;
+
+	TArray<FString> Parts;
+	InPath.ParseIntoArray(Parts, TEXT("."), true);
+	NewData->Segments.Reserve(Parts.Num());
+	for (FString& Part : Parts)
+	{
+		const uint32 Hash = GetTypeHash(Part);
+		NewData->Segments.Add({ MoveTemp(Part), Hash });
+	}
+
+	const FData* Result = NewData.Get();
+	Table.IdsByPath.Add(InPath, NewData->Id);
+	Table.Paths.Add(MoveTemp(NewData));
+
+	return FZLStateKeyPath(Result);
+}
+
+int32 FZLStateKeyPath::GetNumInterned()
+{
+	FTable& Table = GetTable();
+	FReadScopeLock ReadLock(Table.Lock);
+	return Table.Paths.Num();
+}
+
+const FString& FZLStateKeyPath::ToString() const
+{
+	static const FString EmptyPath;
+	return Data ? Data->Path : EmptyPath;
+}
+
+const TArray<FZLStateKeyPath::FSegment>& FZLStateKeyPath::GetSegments() const
+{
+	static const TArray<FSegment> EmptySegments;
+	return Data ? Data->Segments : EmptySegments;
+}
+
+TSharedPtr<FJsonObject> FZLStateKeyPathCache::WalkToParent(const TSharedPtr<FJsonObject>& Root, const FZLStateKeyPath& Path)
+{
+	if (!Root.IsValid() || !Path.IsValid())
+	{
+		return nullptr;
+	}
+
+	const TArray<FZLStateKeyPath::FSegment>& Segments = Path.GetSegments();
+
+	TSharedPtr<FJsonObject> CurrentObject = Root;
+	for (int32 i = 0; i < Segments.Num() - 1; ++i)
+	{
+		const TSharedPtr<FJsonValue>* Value = FindSegment(*CurrentObject, Segments[i]);
+		if (!Value || !Value->IsValid() || (*Value)->Type != EJson::Object)
+		{
+			return nullptr;
+		}
+
+		CurrentObject = (*Value)->AsObject();
+		if (!CurrentObject.IsValid())
+		{
+			return nullptr;
+		}
+	}
+
+	return CurrentObject;
+}
+
+TSharedPtr<FJsonObject> FZLStateKeyPathCache::ResolveParent(const TSharedPtr<FJsonObject>& Root, const FZLStateKeyPath& Path)
+{
+	if (!Root.IsValid() || !Path.IsValid())
+	{
+		return nullptr;
+	}
+
+	if (!Path.IsNested())
+	{
+		return Root;
+	}
+
+	if (CachedRoot.Pin() != Root)
+	{
+		Invalidate();
+		CachedRoot = Root;
+	}
+
+	if (const FEntry* Entry = Entries.Find(Path.GetId()))
+	{
+		if (!Entry->bResolved)
+		{
+			++NumHits;
+			return nullptr;
+		}
+
+		if (TSharedPtr<FJsonObject> Parent = Entry->Parent.Pin())
+		{
+			++NumHits;
+			return Parent;
+		}
+	}
+
+	++NumMisses;
+	TSharedPtr<FJsonObject> Parent = WalkToParent(Root, Path);
+	Entries.Add(Path.GetId(), { Parent, Parent.IsValid() });
+	return Parent;
+}
+
+const TSharedPtr<FJsonValue>* FZLStateKeyPathCache::Find(const TSharedPtr<FJsonObject>& Root, const FZLStateKeyPath& Path)
+{
+	TSharedPtr<FJsonObject> Parent = ResolveParent(Root, Path);
+	if (!Parent.IsValid())
+	{
+		return nullptr;
+	}
+
+	// The parent is kept alive by the tree, so the pointer into its map outlives this local
+	return FindSegment(*Parent, Path.GetLeaf());
+}
+
+void FZLStateKeyPathCache::Invalidate()
+{
+	Entries.Reset();
+}
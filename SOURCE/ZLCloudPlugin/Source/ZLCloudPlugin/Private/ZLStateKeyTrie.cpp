@@ -0,0 +1,68 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#include "ZLStateKeyTrie.h"
+
+bool FZLStateKeyTrie::Add(const FString& Key)
+{
+	TArray<FString> Segments;
+	FZLStateKeyQuery::Split(Key, Segments);
+	if (Segments.Num() == 0 || Contains(Key))
+	{
+		return false;
+	}
+
+	FNode* Node = &Root;
+	++Node->NumKeysInSubtree;
+	for (const FString& Segment : Segments)
+	{
+		TUniquePtr<FNode>& Child = Node->Children.FindOrAdd(Segment);
+		if (!Child)
+		{
+			Child = MakeUnique<FNode>();
+		}
+		Node = Child.Get();
+		++Node->NumKeysInSubtree;
+	}
+	Node->bIsKey = true;
+	return true;
+}
+
+bool FZLStateKeyTrie::Remove(const FString& Key)
+{
+	if (!Contains(Key))
+	{
+		return false;
+	}
+
+	TArray<FString> Segments;
+	FZLStateKeyQuery::Split(Key, Segments);
+
+	FNode* Node = &Root;
+	--Node->NumKeysInSubtree;
+	for (const FString& Segment : Segments)
+	{
+		TUniquePtr<FNode>* Child = Node->Children.Find(Segment);
+		check(Child && Child->IsValid());
+		if (--(*Child)->NumKeysInSubtree == 0)
+		{
+			// Nothing left below, the whole branch goes
+			Node->Children.Remove(Segment);
+			return true;
+		}
+		Node = Child->Get();
+	}
+	Node->bIsKey = false;
+	return true;
+}
+
+void FZLStateKeyTrie::Reset()
+{
+	Root.Children.Reset();
+	Root.NumKeysInSubtree = 0;
+}
+
+bool FZLStateKeyTrie::Contains(const FString& Key) const
+{
+	const FNode* Node = FZLStateKeyQuery::FindNode(Root, Key);
+	return Node && Node != &Root && Node->bIsKey;
+}
@@ -0,0 +1,218 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#include "ZLStateMemory.h"
+#include "ZLCloudPluginPrivate.h"
+#include "Dom/JsonValue.h"
+
+DECLARE_MEMORY_STAT(TEXT("State Current"), STAT_ZLStateMemoryCurrent, STATGROUP_ZLCloudPlugin);
+DECLARE_MEMORY_STAT(TEXT("State Web Current"), STAT_ZLStateMemoryWebCurrent, STATGROUP_ZLCloudPlugin);
+DECLARE_MEMORY_STAT(TEXT("State Web Sync States"), STAT_ZLStateMemoryWebSyncStates, STATGROUP_ZLCloudPlugin);
+DECLARE_MEMORY_STAT(TEXT("State Processing"), STAT_ZLStateMemoryProcessing, STATGROUP_ZLCloudPlugin);
+DECLARE_MEMORY_STAT(TEXT("State In Requested"), STAT_ZLStateMemoryInRequested, STATGROUP_ZLCloudPlugin);
+DECLARE_MEMORY_STAT(TEXT("State Out Requested"), STAT_ZLStateMemoryOutRequested, STATGROUP_ZLCloudPlugin);
+DECLARE_MEMORY_STAT(TEXT("State Server Notify"), STAT_ZLStateMemoryServerNotify, STATGROUP_ZLCloudPlugin);
+DECLARE_MEMORY_STAT(TEXT("State Server Notify Unmatched"), STAT_ZLStateMemoryServerNotifyUnmatched, STATGROUP_ZLCloudPlugin);
+DECLARE_MEMORY_STAT(TEXT("State Default Initial"), STAT_ZLStateMemoryDefaultInitial, STATGROUP_ZLCloudPlugin);
+DECLARE_MEMORY_STAT(TEXT("State Shared Between Trees"), STAT_ZLStateMemoryShared, STATGROUP_ZLCloudPlugin);
+DECLARE_MEMORY_STAT(TEXT("State Duplicate Keys"), STAT_ZLStateMemoryDuplicateKeys, STATGROUP_ZLCloudPlugin);
+
+namespace
+{
+	// Reference counts and deleter of a shared pointer, allocated alongside or apart from the object depending on how it was made
+	constexpr int64 SharedReferenceBytes = 16;
+
+	int64 SizeOfJsonValue(const FJsonValue& Value)
+	{
+		switch (Value.Type)
+		{
+		case EJson::String:
+			return sizeof(FJsonValueString);
+		case EJson::Number:
+			return sizeof(FJsonValueNumber);
+		case EJson::Boolean:
+			return sizeof(FJsonValueBoolean);
+		case EJson::Array:
+			return sizeof(FJsonValueArray);
+		case EJson::Object:
+			return sizeof(FJsonValueObject);
+		default:
+			return sizeof(FJsonValueNull);
+		}
+	}
+
+	FString FormatBytes(int64 Bytes)
+	{
+		return Bytes >= 1024 * 1024 ? FString::Printf(TEXT("%.2fMB"), Bytes / (1024.0 * 1024.0)) : FString::Printf(TEXT("%.1fKB"), Bytes / 1024.0);
+	}
+}
+
+FZLJsonMemoryUsage FZLJsonMemoryCounter::Count(const TSharedPtr<FJsonObject>& Root)
+{
+	FZLJsonMemoryUsage Usage;
+	if (Root.IsValid())
+	{
+		CountObject(Root, Usage);
+	}
+	return Usage;
+}
+
+void FZLJsonMemoryCounter::Reset()
+{
+	Counted.Reset();
+	SeenKeys.Reset();
+	DuplicateKeyBytes = 0;
+}
+
+int64 FZLJsonMemoryCounter::CountObject(const TSharedPtr<FJsonObject>& Object, FZLJsonMemoryUsage& Usage)
+{
+	if (const int64* Size = Counted.Find(Object.Get()))
+	{
+		Usage.SharedBytes += *Size;
+		return *Size;
+	}
+
+	const int64 OwnBytes = sizeof(FJsonObject) + SharedReferenceBytes + Object->Values.GetAllocatedSize();
+	int64 Size = OwnBytes;
+	Usage.Bytes += OwnBytes;
+	Usage.NumObjects++;
+
+	for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : Object->Values)
+	{
+		const int64 KeyBytes = Pair.Key.GetAllocatedSize();
+		Size += KeyBytes;
+		Usage.Bytes += KeyBytes;
+		Usage.KeyBytes += KeyBytes;
+
+		bool bAlreadySeen = false;
+		SeenKeys.Add(Pair.Key, &bAlreadySeen);
+		if (bAlreadySeen)
+		{
+			DuplicateKeyBytes += KeyBytes;
+		}
+
+		if (Pair.Value.IsValid())
+		{
+			Size += CountValue(Pair.Value, Usage);
+		}
+	}
+
+	Counted.Add(Object.Get(), Size);
+	return Size;
+}
+
+int64 FZLJsonMemoryCounter::CountValue(const TSharedPtr<FJsonValue>& Value, FZLJsonMemoryUsage& Usage)
+{
+	if (const int64* Size = Counted.Find(Value.Get()))
+	{
+		Usage.SharedBytes += *Size;
+		return *Size;
+	}
+
+	const int64 OwnBytes = SizeOfJsonValue(*Value) + SharedReferenceBytes;
+	int64 Size = OwnBytes;
+	Usage.Bytes += OwnBytes;
+	Usage.NumValues++;
+
+	switch (Value->Type)
+	{
+	case EJson::String:
+	{
+		// AsString copies, the copy's allocation is the same size as the original's
+		const int64 StringBytes = Value->AsString().GetAllocatedSize();
+		Size += StringBytes;
+		Usage.Bytes += StringBytes;
+		break;
+	}
+
+	case EJson::Array:
+	{
+		const TArray<TSharedPtr<FJsonValue>>& Array = Value->AsArray();
+		const int64 ArrayBytes = Array.GetAllocatedSize();
+		Size += ArrayBytes;
+		Usage.Bytes += ArrayBytes;
+		for (const TSharedPtr<FJsonValue>& Item : Array)
+		{
+			if (Item.IsValid())
+			{
+				Size += CountValue(Item, Usage);
+			}
+		}
+		break;
+	}
+
+	case EJson::Object:
+		if (const TSharedPtr<FJsonObject>& Object = Value->AsObject())
+		{
+			Size += CountObject(Object, Usage);
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	Counted.Add(Value.Get(), Size);
+	return Size;
+}
+
+FZLJsonMemoryUsage FZLStateMemoryReport::GetTotal() const
+{
+	FZLJsonMemoryUsage Total;
+	for (const FZLJsonMemoryUsage& Tree : Trees)
+	{
+		Total += Tree;
+	}
+	return Total;
+}
+
+TArray<FString> FZLStateMemoryReport::ToLines() const
+{
+	TArray<FString> Lines;
+
+	const FZLJsonMemoryUsage Total = GetTotal();
+	Lines.Add(FString::Printf(TEXT("State JSON trees hold %s, %s of keys (%s spelled out more than once), %s more is shared between trees"),
+		*FormatBytes(Total.Bytes), *FormatBytes(Total.KeyBytes), *FormatBytes(DuplicateKeyBytes), *FormatBytes(Total.SharedBytes)));
+
+	for (int32 i = 0; i < (int32)EZLStateMemoryTree::Num; ++i)
+	{
+		const FZLJsonMemoryUsage& Tree = Trees[i];
+		Lines.Add(FString::Printf(TEXT("  %-24s %10s own, %10s shared, %6d objects, %7d values, %10s keys"),
+			GetTreeName((EZLStateMemoryTree)i), *FormatBytes(Tree.Bytes), *FormatBytes(Tree.SharedBytes), Tree.NumObjects, Tree.NumValues, *FormatBytes(Tree.KeyBytes)));
+	}
+
+	return Lines;
+}
+
+void FZLStateMemoryReport::PublishStats() const
+{
+#if STATS
+	SET_MEMORY_STAT(STAT_ZLStateMemoryCurrent, Trees[(int32)EZLStateMemoryTree::Current].Bytes);
+	SET_MEMORY_STAT(STAT_ZLStateMemoryWebCurrent, Trees[(int32)EZLStateMemoryTree::WebCurrent].Bytes);
+	SET_MEMORY_STAT(STAT_ZLStateMemoryWebSyncStates, Trees[(int32)EZLStateMemoryTree::WebSyncStates].Bytes);
+	SET_MEMORY_STAT(STAT_ZLStateMemoryProcessing, Trees[(int32)EZLStateMemoryTree::Processing].Bytes);
+	SET_MEMORY_STAT(STAT_ZLStateMemoryInRequested, Trees[(int32)EZLStateMemoryTree::InRequested].Bytes);
+	SET_MEMORY_STAT(STAT_ZLStateMemoryOutRequested, Trees[(int32)EZLStateMemoryTree::OutRequested].Bytes);
+	SET_MEMORY_STAT(STAT_ZLStateMemoryServerNotify, Trees[(int32)EZLStateMemoryTree::ServerNotify].Bytes);
+	SET_MEMORY_STAT(STAT_ZLStateMemoryServerNotifyUnmatched, Trees[(int32)EZLStateMemoryTree::ServerNotifyUnmatched].Bytes);
+	SET_MEMORY_STAT(STAT_ZLStateMemoryDefaultInitial, Trees[(int32)EZLStateMemoryTree::DefaultInitial].Bytes);
+	SET_MEMORY_STAT(STAT_ZLStateMemoryShared, GetTotal().SharedBytes);
+	SET_MEMORY_STAT(STAT_ZLStateMemoryDuplicateKeys, DuplicateKeyBytes);
+#endif
+}
+
+const TCHAR* FZLStateMemoryReport::GetTreeName(EZLStateMemoryTree Tree)
+{
+	switch (Tree)
+	{
+	case EZLStateMemoryTree::Current: return TEXT("Current");
+	case EZLStateMemoryTree::WebCurrent: return TEXT("Web current");
+	case EZLStateMemoryTree::WebSyncStates: return TEXT("Web sync states");
+	case EZLStateMemoryTree::Processing: return TEXT("Processing");
+	case EZLStateMemoryTree::InRequested: return TEXT("In requested");
+	case EZLStateMemoryTree::OutRequested: return TEXT("Out requested");
+	case EZLStateMemoryTree::ServerNotify: return TEXT("Server notify");
+	case EZLStateMemoryTree::ServerNotifyUnmatched: return TEXT("Server notify unmatched");
+	case EZLStateMemoryTree::DefaultInitial: return TEXT("Default initial");
+	default: return TEXT("Unknown");
+	}
+}
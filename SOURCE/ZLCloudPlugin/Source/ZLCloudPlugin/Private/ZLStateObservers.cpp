@@ -0,0 +1,162 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#include "ZLStateObservers.h"
+
+FZLStateObservers::FObserverId FZLStateObservers::Subscribe(EZLStateObserverSource Source, const FZLStateKeyPath& Path, FZLOnStatePathsChanged Callback)
+{
+	const FObserverId Id = NextId++;
+
+	FNode* Node = &Roots[(int32)Source];
+	++Node->NumInSubtree;
+	if (Path.IsValid())
+	{
+		for (const FZLStateKeyPath::FSegment& Segment : Path.GetSegments())
+		{
+			TUniquePtr<FNode>& Child = Node->Children.FindOrAdd(Segment.Name);
+			if (!Child)
+			{
+				Child = MakeUnique<FNode>();
+			}
+			Node = Child.Get();
+			++Node->NumInSubtree;
+		}
+	}
+	Node->Observers.Add(Id);
+
+	FObserver& Observer = Observers.Add(Id);
+	Observer.Source = Source;
+	Observer.Path = Path;
+	Observer.Callback = MoveTemp(Callback);
+	return Id;
+}
+
+bool FZLStateObservers::Unsubscribe(FObserverId Id)
+{
+	FObserver Observer;
+	if (!Observers.RemoveAndCopyValue(Id, Observer))
+	{
+		return false;
+	}
+	Batch.Remove(Id);
+
+	FNode* Node = &Roots[(int32)Observer.Source];
+	--Node->NumInSubtree;
+	if (Observer.Path.IsValid())
+	{
+		for (const FZLStateKeyPath::FSegment& Segment : Observer.Path.GetSegments())
+		{
+			TUniquePtr<FNode>* Child = Node->Children.Find(Segment.Name);
+			check(Child && Child->IsValid());
+			if (--(*Child)->NumInSubtree == 0)
+			{
+				// Nothing left below, the whole branch goes
+				Node->Children.Remove(Segment.Name);
+				return true;
+			}
+			Node = Child->Get();
+		}
+	}
+	Node->Observers.Remove(Id);
+	return true;
+}
+
+void FZLStateObservers::AddToBatch(const FNode& Node, const FZLStateKeyPath& Path, bool bSubtree)
+{
+	for (FObserverId Id : Node.Observers)
+	{
+		Batch.FindOrAdd(Id).Add(Path);
+	}
+
+	if (bSubtree)
+	{
+		for (const TPair<FString, TUniquePtr<FNode>>& Child : Node.Children)
+		{
+			AddToBatch(*Child.Value, Path, true);
+		}
+	}
+}
+
+void FZLStateObservers::MarkChanged(EZLStateObserverSource Source, const FZLStateKeyPath& Path)
+{
+	const FNode* Node = &Roots[(int32)Source];
+	if (Node->NumInSubtree == 0)
+	{
+		return;
+	}
+	if (!Path.IsValid())
+	{
+		MarkAllChanged(Source);
+		return;
+	}
+
+	bool bAlreadyRouted = false;
+	RoutedPaths[(int32)Source].Add(Path, &bAlreadyRouted);
+	if (bAlreadyRouted)
+	{
+		return;
+	}
+
+	// Observers of the path and everything above it
+	AddToBatch(*Node, Path, false);
+	for (const FZLStateKeyPath::FSegment& Segment : Path.GetSegments())
+	{
+		const TUniquePtr<FNode>* Child = Node->Children.Find(Segment.Name);
+		if (!Child)
+		{
+			return;
+		}
+		Node = Child->Get();
+		AddToBatch(*Node, Path, false);
+	}
+
+	// And everything below it, replaced along with it
+	for (const TPair<FString, TUniquePtr<FNode>>& Child : Node->Children)
+	{
+		AddToBatch(*Child.Value, Path, true);
+	}
+}
+
+void FZLStateObservers::MarkAllChanged(EZLStateObserverSource Source)
+{
+	for (const TPair<FObserverId, FObserver>& Pair : Observers)
+	{
+		if (Pair.Value.Source == Source)
+		{
+			TArray<FZLStateKeyPath>& Paths = Batch.FindOrAdd(Pair.Key);
+			if (!Paths.Contains(Pair.Value.Path))
+			{
+				Paths.Add(Pair.Value.Path);
+			}
+		}
+	}
+}
+
+int32 FZLStateObservers::Dispatch()
+{
+	for (TSet<FZLStateKeyPath>& Routed : RoutedPaths)
+	{
+		Routed.Reset();
+	}
+	if (Batch.Num() == 0)
+	{
+		return 0;
+	}
+
+	// Callbacks may mark, subscribe or unsubscribe, so work from this frame's batch and start the next one
+	TMap<FObserverId, TArray<FZLStateKeyPath>> Dispatching = MoveTemp(Batch);
+	Batch.Reset();
+
+	int32 NumCalled = 0;
+	for (const TPair<FObserverId, TArray<FZLStateKeyPath>>& Pair : Dispatching)
+	{
+		// Skips observers an earlier callback removed
+		if (const FObserver* Observer = Observers.Find(Pair.Key))
+		{
+			// Copied, the callback may remove it
+			FZLOnStatePathsChanged Callback = Observer->Callback;
+			Callback.ExecuteIfBound(Pair.Value);
+			++NumCalled;
+		}
+	}
+	return NumCalled;
+}
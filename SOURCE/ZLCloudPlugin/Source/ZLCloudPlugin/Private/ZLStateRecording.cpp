@@ -0,0 +1,603 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#include "ZLStateRecording.h"
+#include "ZLCloudPluginPrivate.h"
+#include "ZLCloudPluginStateManager.h"
+#include "Algo/BinarySearch.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformMemory.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonSerializer.h"
+
+namespace
+{
+	const int32 RecordingVersion = 1;
+
+	// Recorded times go through JSON text, allow for them coming back a hair off the tick they were recorded on
+	const double RecordedTimeTolerance = 1e-6;
+
+	FString JoinSegments(const TArray<FZLStateKeyPath::FSegment>& Segments, int32 NumSegments)
+	{
+		FString Path;
+		for (int32 i = 0; i < NumSegments; ++i)
+		{
+			if (i > 0)
+			{
+				Path.AppendChar(TEXT('.'));
+			}
+			Path.Append(Segments[i].Name);
+		}
+		return Path;
+	}
+
+	TSharedPtr<FJsonObject> CopyJsonObject(const TSharedPtr<FJsonObject>& Source)
+	{
+		TSharedPtr<FJsonObject> Copy = MakeShared<FJsonObject>();
+		if (Source.IsValid())
+		{
+			FJsonObject::Duplicate(Source, Copy);
+		}
+		return Copy;
+	}
+}
+
+FZLStateRecorder::~FZLStateRecorder()
+{
+	delete Writer;
+}
+
+FString FZLStateRecorder::ResolveFileName(const FString& InFileName)
+{
+	FString Resolved = InFileName.IsEmpty() ? FDateTime::Now().ToString(TEXT("StateRecording_%Y%m%d_%H%M%S")) : InFileName;
+	if (FPaths::IsRelative(Resolved))
+	{
+		Resolved = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("ZLStateRecordings"), Resolved);
+	}
+	if (FPaths::GetExtension(Resolved).IsEmpty())
+	{
+		Resolved += TEXT(".json");
+	}
+	return Resolved;
+}
+
+bool FZLStateRecorder::Open(const FString& InFileName, const TSharedPtr<FJsonObject>& InitialState, uint64 SchemaHash, double Time)
+{
+	FileName = ResolveFileName(InFileName);
+	Writer = IFileManager::Get().CreateFileWriter(*FileName);
+	if (!Writer)
+	{
+		return false;
+	}
+
+	StartTime = Time;
+
+	TSharedRef<FJsonObject> Header = MakeShared<FJsonObject>();
+	Header->SetNumberField(TEXT("version"), RecordingVersion);
+	Header->SetStringField(TEXT("schema_hash"), FString::Printf(TEXT("%016llx"), SchemaHash));
+	Header->SetObjectField(TEXT("initial_state"), InitialState.IsValid() ? InitialState : MakeShared<FJsonObject>());
+	WriteLine(Header);
+	return true;
+}
+
+void FZLStateRecorder::Close(const TSharedPtr<FJsonObject>& FinalState, double Time)
+{
+	if (!Writer)
+	{
+		return;
+	}
+
+	Flush(FinalState, Time);
+
+	TSharedRef<FJsonObject> Footer = MakeShared<FJsonObject>();
+	Footer->SetNumberField(TEXT("t"), Time - StartTime);
+	Footer->SetObjectField(TEXT("final_state"), FinalState.IsValid() ? FinalState : MakeShared<FJsonObject>());
+	WriteLine(Footer);
+
+	Writer->Close();
+	delete Writer;
+	Writer = nullptr;
+}
+
+void FZLStateRecorder::RecordRequest(const FString& Json, bool bCompareCurrentState, double Time)
+{
+	if (!Writer)
+	{
+		return;
+	}
+
+	TSharedRef<FJsonObject> Line = MakeShared<FJsonObject>();
+	Line->SetNumberField(TEXT("t"), Time - StartTime);
+	Line->SetStringField(TEXT("request"), Json);
+	Line->SetBoolField(TEXT("compare"), bCompareCurrentState);
+	WriteLine(Line);
+	++NumRequests;
+}
+
+void FZLStateRecorder::RecordConfirm(const FString& Key, double Time)
+{
+	if (!Writer)
+	{
+		return;
+	}
+
+	TSharedRef<FJsonObject> Line = MakeShared<FJsonObject>();
+	Line->SetNumberField(TEXT("t"), Time - StartTime);
+	Line->SetStringField(TEXT("confirm"), Key);
+	WriteLine(Line);
+}
+
+void FZLStateRecorder::RecordChange(const FZLStateKeyPath& Path)
+{
+	if (Writer && !bResetPending && Path.IsValid())
+	{
+		bool bAlreadyPending = false;
+		PendingSet.Add(Path, &bAlreadyPending);
+		if (!bAlreadyPending)
+		{
+			PendingPaths.Add(Path);
+		}
+	}
+}
+
+void FZLStateRecorder::Flush(const TSharedPtr<FJsonObject>& CurrentState, double Time)
+{
+	if (!Writer || !CurrentState.IsValid() || (!bResetPending && PendingPaths.Num() == 0))
+	{
+		return;
+	}
+
+	TSharedRef<FJsonObject> Line = MakeShared<FJsonObject>();
+	Line->SetNumberField(TEXT("t"), Time - StartTime);
+
+	if (bResetPending)
+	{
+		Line->SetObjectField(TEXT("reset"), CurrentState);
+	}
+	else
+	{
+		TSharedPtr<FJsonObject> Changes = MakeShared<FJsonObject>();
+		TArray<TSharedPtr<FJsonValue>> Removed;
+		for (const FZLStateKeyPath& Path : PendingPaths)
+		{
+			// Same walk as the state journal, the deepest level that exists says whether it was set or removed
+			const TArray<FZLStateKeyPath::FSegment>& Segments = Path.GetSegments();
+			const FJsonObject* Object = CurrentState.Get();
+			for (int32 i = 0; i < Segments.Num(); ++i)
+			{
+				const TSharedPtr<FJsonValue>* Value = FZLStateKeyPathCache::FindSegment(*Object, Segments[i]);
+				if (!Value || !Value->IsValid())
+				{
+					Removed.Add(MakeShared<FJsonValueString>(JoinSegments(Segments, i + 1)));
+					break;
+				}
+
+				if (i == Segments.Num() - 1 || (*Value)->Type != EJson::Object || !(*Value)->AsObject().IsValid())
+				{
+					Changes->SetField(JoinSegments(Segments, i + 1), *Value);
+					break;
+				}
+
+				Object = (*Value)->AsObject().Get();
+			}
+		}
+
+		Line->SetObjectField(TEXT("changes"), Changes);
+		if (Removed.Num() > 0)
+		{
+			Line->SetArrayField(TEXT("removed"), Removed);
+		}
+	}
+
+	PendingPaths.Reset();
+	PendingSet.Reset();
+	bResetPending = false;
+
+	WriteLine(Line);
+}
+
+void FZLStateRecorder::WriteLine(const TSharedRef<FJsonObject>& Line)
+{
+	FString Json;
+	TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> JsonWriter = TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&Json);
+	FJsonSerializer::Serialize(Line, JsonWriter);
+	JsonWriter->Close();
+	Json.AppendChar(TEXT('\n'));
+
+	FTCHARToUTF8 Utf8(*Json, Json.Len());
+	Writer->Serialize(const_cast<ANSICHAR*>(Utf8.Get()), Utf8.Length());
+}
+
+bool FZLStateRecording::Load(const FString& FileName, FString* OutError)
+{
+	auto Fail = [OutError](const FString& Error)
+	{
+		if (OutError)
+		{
+			*OutError = Error;
+		}
+		return false;
+	};
+
+	FString Contents;
+	if (!FFileHelper::LoadFileToString(Contents, *FileName))
+	{
+		return Fail(FString::Printf(TEXT("Couldn't read %s"), *FileName));
+	}
+
+	TArray<FString> Lines;
+	Contents.ParseIntoArrayLines(Lines);
+	if (Lines.Num() == 0)
+	{
+		return Fail(TEXT("Recording is empty"));
+	}
+
+	TSharedPtr<FJsonObject> Header;
+	TSharedRef<TJsonReader<>> HeaderReader = TJsonReaderFactory<>::Create(Lines[0]);
+	int32 Version = 0;
+	if (!FJsonSerializer::Deserialize(HeaderReader, Header) || !Header->TryGetNumberField(TEXT("version"), Version))
+	{
+		return Fail(TEXT("Recording has no header"));
+	}
+	if (Version != RecordingVersion)
+	{
+		return Fail(FString::Printf(TEXT("Recording version %d isn't supported"), Version));
+	}
+
+	SchemaHash = FCString::Strtoui64(*Header->GetStringField(TEXT("schema_hash")), nullptr, 16);
+	const TSharedPtr<FJsonObject>* InitialStateField = nullptr;
+	InitialState = Header->TryGetObjectField(TEXT("initial_state"), InitialStateField) ? *InitialStateField : MakeShared<FJsonObject>();
+	FinalState.Reset();
+	Events.Reset();
+	Duration = 0.0;
+	NumRequests = 0;
+
+	for (int32 LineIndex = 1; LineIndex < Lines.Num(); ++LineIndex)
+	{
+		TSharedPtr<FJsonObject> Line;
+		TSharedRef<TJsonReader<>> LineReader = TJsonReaderFactory<>::Create(Lines[LineIndex]);
+		double Time = 0.0;
+		if (!FJsonSerializer::Deserialize(LineReader, Line) || !Line->TryGetNumberField(TEXT("t"), Time))
+		{
+			if (LineIndex == Lines.Num() - 1)
+			{
+				UE_LOG(LogZLCloudPlugin, Warning, TEXT("Dropped the torn last line of state recording %s"), *FileName);
+				break;
+			}
+			return Fail(FString::Printf(TEXT("Line %d of the recording is malformed"), LineIndex + 1));
+		}
+
+		Duration = FMath::Max(Duration, Time);
+
+		const TSharedPtr<FJsonObject>* ObjectField = nullptr;
+		FString Text;
+		if (Line->TryGetStringField(TEXT("request"), Text))
+		{
+			FZLStateRecordedEvent& Event = Events.AddDefaulted_GetRef();
+			Event.Type = EZLStateRecordedEvent::Request;
+			Event.Time = Time;
+			Event.Text = MoveTemp(Text);
+			Line->TryGetBoolField(TEXT("compare"), Event.bCompareCurrentState);
+			++NumRequests;
+		}
+		else if (Line->TryGetStringField(TEXT("confirm"), Text))
+		{
+			FZLStateRecordedEvent& Event = Events.AddDefaulted_GetRef();
+			Event.Type = EZLStateRecordedEvent::Confirm;
+			Event.Time = Time;
+			Event.Text = MoveTemp(Text);
+		}
+		else if (Line->TryGetObjectField(TEXT("changes"), ObjectField))
+		{
+			FZLStateRecordedEvent& Event = Events.AddDefaulted_GetRef();
+			Event.Type = EZLStateRecordedEvent::Changes;
+			Event.Time = Time;
+			Event.State = *ObjectField;
+			Line->TryGetStringArrayField(TEXT("removed"), Event.Removed);
+		}
+		else if (Line->TryGetObjectField(TEXT("reset"), ObjectField))
+		{
+			FZLStateRecordedEvent& Event = Events.AddDefaulted_GetRef();
+			Event.Type = EZLStateRecordedEvent::Reset;
+			Event.Time = Time;
+			Event.State = *ObjectField;
+		}
+		else if (Line->TryGetObjectField(TEXT("final_state"), ObjectField))
+		{
+			FinalState = *ObjectField;
+		}
+	}
+
+	return true;
+}
+
+double FZLStateReplayReport::GetLatencyPercentile(double Percentile) const
+{
+	if (Latencies.Num() == 0)
+	{
+		return 0.0;
+	}
+
+	// Nearest rank
+	const int32 Rank = FMath::CeilToInt(Percentile / 100.0 * Latencies.Num());
+	return Latencies[FMath::Clamp(Rank - 1, 0, Latencies.Num() - 1)];
+}
+
+TArray<FString> FZLStateReplayReport::ToLines() const
+{
+	TArray<FString> Lines;
+	Lines.Add(FString::Printf(TEXT("Replayed %d requests, %.1fs of state time in %.2fs (%d ticks)"), NumRequests, ReplayedSeconds, WallSeconds, NumTicks));
+	Lines.Add(FString::Printf(TEXT("  Ended: %d complete, %d unmatched, %d timed out, %d keys confirmed"), NumComplete, NumUnmatched, NumTimedOut, NumConfirms));
+	Lines.Add(FString::Printf(TEXT("  Latency over %d requests: p50 %.1fms, p90 %.1fms, p99 %.1fms, max %.1fms"), Latencies.Num(),
+		GetLatencyPercentile(50.0) * 1000.0, GetLatencyPercentile(90.0) * 1000.0, GetLatencyPercentile(99.0) * 1000.0, GetLatencyPercentile(100.0) * 1000.0));
+	Lines.Add(FString::Printf(TEXT("  ProcessState %.2fms, Update %.2fms (%.1fus per tick), app stub %.2fms"),
+		ProcessStateSeconds * 1000.0, UpdateSeconds * 1000.0, NumTicks > 0 ? UpdateSeconds * 1000000.0 / NumTicks : 0.0, AppSeconds * 1000.0));
+	Lines.Add(FString::Printf(TEXT("  Web messages: %d, %lld chars"), NumWebMessages, WebMessageChars));
+	Lines.Add(FString::Printf(TEXT("  Memory growth: %.1fKB, peak %.1fKB"), MemoryGrowth / 1024.0, PeakMemoryGrowth / 1024.0));
+	Lines.Add(FString::Printf(TEXT("  Final state matches the recording: %s"), bFinalStateMatches ? TEXT("yes") : TEXT("no")));
+	return Lines;
+}
+
+FZLStateReplayer::FZLStateReplayer(const FZLStateRecording& InRecording, const FZLStateReplaySettings& InSettings, const UStateKeyInfoAsset* Schema)
+	: Recording(InRecording)
+	, Settings(InSettings)
+	, Random(InSettings.Seed)
+{
+	Settings.TickInterval = FMath::Max(Settings.TickInterval, 0.001);
+
+	for (const FZLStateRecordedEvent& Event : Recording.Events)
+	{
+		if (Event.Type == EZLStateRecordedEvent::Confirm)
+		{
+			RecordedConfirmTimes.FindOrAdd(Event.Text).Add(Event.Time);
+		}
+	}
+
+	Manager = UZLCloudPluginStateManager::CreateDetachedInstance(Schema);
+	Manager->AddToRoot();
+	Manager->SetStateClock([this]() { return Time; });
+	Manager->SetWebMessageHandler([this](const FString& Message)
+	{
+		++Report.NumWebMessages;
+		Report.WebMessageChars += Message.Len();
+	});
+	Manager->SetStateRequestHandler([this](const TSharedPtr<FJsonObject>& Request)
+	{
+		// A request the manager starts itself (a queued one inside Update), the app only pulls what it asks for
+		const double AppStartTime = FPlatformTime::Seconds();
+		PullRequestedLeaves(*Request, FString(), true);
+		const double AppSeconds = FPlatformTime::Seconds() - AppStartTime;
+		Report.AppSeconds += AppSeconds;
+		NestedSeconds += AppSeconds;
+	});
+	RequestEndedHandle = Manager->OnStateRequestEnded.AddRaw(this, &FZLStateReplayer::OnRequestEnded);
+
+	Manager->ResetCurrentAppState(CopyJsonObject(Recording.InitialState));
+
+	StartWallTime = FPlatformTime::Seconds();
+	StartMemory = FPlatformMemory::GetStats().UsedPhysical;
+	PeakMemory = StartMemory;
+}
+
+FZLStateReplayer::~FZLStateReplayer()
+{
+	if (Manager)
+	{
+		Manager->OnStateRequestEnded.Remove(RequestEndedHandle);
+		Manager->SetStateClock(nullptr);
+		Manager->SetWebMessageHandler(nullptr);
+		Manager->SetStateRequestHandler(nullptr);
+		Manager->RemoveFromRoot();
+		Manager = nullptr;
+	}
+}
+
+bool FZLStateReplayer::Tick(double DeltaSeconds)
+{
+	TickDebt += DeltaSeconds * Settings.Speed;
+	while (!bFinished && TickDebt >= Settings.TickInterval)
+	{
+		TickDebt -= Settings.TickInterval;
+		Step();
+	}
+	return !bFinished;
+}
+
+void FZLStateReplayer::RunToCompletion()
+{
+	while (!bFinished)
+	{
+		Step();
+	}
+}
+
+void FZLStateReplayer::Step()
+{
+	Time += Settings.TickInterval;
+
+	while (NextEvent < Recording.Events.Num() && Recording.Events[NextEvent].Time <= Time + RecordedTimeTolerance)
+	{
+		FeedEvent(Recording.Events[NextEvent++]);
+	}
+
+	const double AppStartTime = FPlatformTime::Seconds();
+	while (PendingConfirms.Num() > 0 && PendingConfirms.HeapTop().Time <= Time + RecordedTimeTolerance)
+	{
+		FPendingConfirm Confirm;
+		PendingConfirms.HeapPop(Confirm);
+
+		bool bConfirmed = false;
+		Manager->ConfirmStateChange(Confirm.Key, bConfirmed);
+		if (bConfirmed)
+		{
+			++Report.NumConfirms;
+		}
+	}
+	Report.AppSeconds += FPlatformTime::Seconds() - AppStartTime;
+
+	NestedSeconds = 0.0;
+	const double UpdateStartTime = FPlatformTime::Seconds();
+	Manager->Update(nullptr);
+	Report.UpdateSeconds += FPlatformTime::Seconds() - UpdateStartTime - NestedSeconds;
+	++Report.NumTicks;
+
+	// Reading process memory isn't free on every platform, once a second of replay time is plenty
+	if (Report.NumTicks % FMath::Max(1, FMath::RoundToInt(1.0 / Settings.TickInterval)) == 0)
+	{
+		PeakMemory = FMath::Max(PeakMemory, FPlatformMemory::GetStats().UsedPhysical);
+	}
+
+	const bool bDrained = NextEvent == Recording.Events.Num() && PendingConfirms.Num() == 0 && !Manager->IsProcessingStateRequest();
+	// Requests the app never confirms end by timing out, anything still going after that is stuck
+	const bool bOverrun = Time > Recording.Duration + Manager->m_stateRequestTimeout + 1.0;
+	if (bDrained || bOverrun)
+	{
+		Finish();
+	}
+}
+
+void FZLStateReplayer::FeedEvent(const FZLStateRecordedEvent& Event)
+{
+	switch (Event.Type)
+	{
+	case EZLStateRecordedEvent::Request:
+		++Report.NumRequests;
+		ProcessRequest(Event.Text, Event.bCompareCurrentState);
+		break;
+	case EZLStateRecordedEvent::Reset:
+		Manager->ResetCurrentAppState(CopyJsonObject(Event.State));
+		break;
+	default:
+		// Confirms and their changes come from the stub app
+		break;
+	}
+}
+
+void FZLStateReplayer::ProcessRequest(const FString& Json, bool bCompareCurrentState)
+{
+	const double StartTime = FPlatformTime::Seconds();
+	bool bStarted = false;
+	Manager->ProcessState(Json, bCompareCurrentState, bStarted);
+	Report.ProcessStateSeconds += FPlatformTime::Seconds() - StartTime;
+
+	// Queued requests are pulled when the request handler hears they've started
+	if (bStarted)
+	{
+		const double AppStartTime = FPlatformTime::Seconds();
+		TSharedPtr<FJsonObject> Request;
+		TSharedRef<TJsonReader<>> JsonReader = TJsonReaderFactory<>::Create(Json);
+		if (FJsonSerializer::Deserialize(JsonReader, Request))
+		{
+			PullRequestedLeaves(*Request, FString(), false);
+		}
+		Report.AppSeconds += FPlatformTime::Seconds() - AppStartTime;
+	}
+}
+
+void FZLStateReplayer::PullRequestedLeaves(const FJsonObject& Object, const FString& Prefix, bool bFromUpdate)
+{
+	for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : Object.Values)
+	{
+		if (Prefix.IsEmpty() && Pair.Key == TEXT("RequestId"))
+		{
+			continue;
+		}
+
+		const FString Key = Prefix.IsEmpty() ? Pair.Key : Prefix + TEXT(".") + Pair.Key;
+		if (Pair.Value.IsValid() && Pair.Value->Type == EJson::Object && Pair.Value->AsObject().IsValid() && Pair.Value->AsObject()->Values.Num() > 0)
+		{
+			PullRequestedLeaves(*Pair.Value->AsObject(), Key, bFromUpdate);
+			continue;
+		}
+
+		// Values the request didn't change aren't requested, nothing to pull or confirm
+		TSharedPtr<FJsonValue> Value;
+		bool bPulled = false;
+		Manager->GetRequestedStateValue(Key, false, Value, bPulled);
+		if (bPulled)
+		{
+			const double ConfirmTime = GetConfirmTime(Key, bFromUpdate);
+			if (ConfirmTime >= 0.0)
+			{
+				PendingConfirms.HeapPush(FPendingConfirm{ ConfirmTime, Key });
+			}
+		}
+	}
+}
+
+double FZLStateReplayer::GetConfirmTime(const FString& Key, bool bFromUpdate)
+{
+	if (Settings.ConfirmDelay >= 0.0)
+	{
+		if (Random.FRand() < Settings.DropConfirmChance)
+		{
+			return -1.0;
+		}
+		return Time + Settings.ConfirmDelay + Random.FRand() * Settings.ConfirmJitter;
+	}
+
+	// Only one request owns a key at a time, so the key was next confirmed by the first recorded confirm from now on.
+	// Confirms run between feeding requests and Update, so one on this tick can't answer a request Update started.
+	// If the recorded app never confirmed the key this finds a later request's confirm, which only delays the timeout.
+	// The recorded app may also have confirmed a whole object rather than each leaf in it
+	FString ConfirmedKey = Key;
+	while (true)
+	{
+		if (const TArray<double>* ConfirmTimes = RecordedConfirmTimes.Find(ConfirmedKey))
+		{
+			const int32 Index = bFromUpdate ? Algo::UpperBound(*ConfirmTimes, Time + RecordedTimeTolerance) : Algo::LowerBound(*ConfirmTimes, Time - RecordedTimeTolerance);
+			if (ConfirmTimes->IsValidIndex(Index))
+			{
+				return (*ConfirmTimes)[Index];
+			}
+		}
+
+		int32 DotIndex = INDEX_NONE;
+		if (!ConfirmedKey.FindLastChar(TEXT('.'), DotIndex))
+		{
+			return -1.0;
+		}
+		ConfirmedKey.LeftInline(DotIndex);
+	}
+}
+
+void FZLStateReplayer::OnRequestEnded(const FZLStateRequestTiming& Timing)
+{
+	if (Timing.Status == TEXT("complete"))
+	{
+		++Report.NumComplete;
+	}
+	else if (Timing.Status == TEXT("timeout"))
+	{
+		++Report.NumTimedOut;
+	}
+	else
+	{
+		++Report.NumUnmatched;
+	}
+
+	Report.Latencies.Add(Timing.EndTime - Timing.ArrivalTime);
+	for (double MergedArrivalTime : Timing.MergedArrivalTimes)
+	{
+		Report.Latencies.Add(Timing.EndTime - MergedArrivalTime);
+	}
+}
+
+void FZLStateReplayer::Finish()
+{
+	bFinished = true;
+
+	Report.Latencies.Sort();
+	Report.ReplayedSeconds = Time;
+	Report.WallSeconds = FPlatformTime::Seconds() - StartWallTime;
+
+	const uint64 EndMemory = FPlatformMemory::GetStats().UsedPhysical;
+	PeakMemory = FMath::Max(PeakMemory, EndMemory);
+	Report.MemoryGrowth = (int64)EndMemory - (int64)StartMemory;
+	Report.PeakMemoryGrowth = (int64)PeakMemory - (int64)StartMemory;
+
+	if (Recording.FinalState.IsValid())
+	{
+		Report.bFinalStateMatches = CompareJsonValuesCaseSensitive(MakeShared<FJsonValueObject>(Manager->GetCurrentAppState()), MakeShared<FJsonValueObject>(Recording.FinalState));
+	}
+}
@@ -0,0 +1,248 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#include "ZLStateSchemaValidator.h"
+#include "Algo/BinarySearch.h"
+
+FString FZLStateViolation::ToString() const
+{
+	switch (Reason)
+	{
+	case EZLStateViolation::WrongType:
+		return FString::Printf(TEXT("%s has the wrong type"), *Key);
+	case EZLStateViolation::NotAccepted:
+		return FString::Printf(TEXT("%s is not an accepted value"), *Key);
+	default:
+		return FString::Printf(TEXT("%s is not an object"), *Key);
+	}
+}
+
+void FZLStateSchemaValidator::Compile(const UStateKeyInfoAsset* Schema)
+{
+	Root.Children.Reset();
+	Root.Validator = INDEX_NONE;
+	Validators.Reset();
+
+	if (!Schema)
+	{
+		return;
+	}
+
+	for (const TPair<FString, FStateKeyInfo>& Entry : Schema->KeyInfos)
+	{
+		const FStateKeyInfo& Info = Entry.Value;
+		const EStateKeyDataType Type = Info.GetDataTypeEnum();
+		if (Type == EStateKeyDataType::Invalid)
+		{
+			continue;
+		}
+
+		TArray<FString> Segments;
+		Entry.Key.ParseIntoArray(Segments, TEXT("."), true);
+		if (Segments.Num() == 0)
+		{
+			continue;
+		}
+
+		FNode* Node = &Root;
+		for (const FString& Segment : Segments)
+		{
+			TUniquePtr<FNode>& Child = Node->Children.FindOrAdd(Segment);
+			if (!Child.IsValid())
+			{
+				Child = MakeUnique<FNode>();
+			}
+			Node = Child.Get();
+		}
+
+		FKeyValidator& Validator = Validators.AddDefaulted_GetRef();
+		Validator.Type = Type;
+
+		if (Info.bLimitValues)
+		{
+			const bool bStringKey = Type == EStateKeyDataType::String || Type == EStateKeyDataType::StringArray;
+			const bool bNumberKey = Type == EStateKeyDataType::Number || Type == EStateKeyDataType::NumberArray;
+
+			if (bStringKey && Info.AcceptedStringValues.Num() > 0)
+			{
+				Validator.AcceptedStrings.Append(Info.AcceptedStringValues);
+				Validator.bLimitStrings = true;
+			}
+
+			if (bNumberKey && Info.AcceptedNumberValues.Num() > 0)
+			{
+				Validator.AcceptedNumbers = Info.AcceptedNumberValues;
+				Validator.AcceptedNumbers.Sort();
+				for (int32 i = Validator.AcceptedNumbers.Num() - 1; i > 0; --i)
+				{
+					if (Validator.AcceptedNumbers[i] == Validator.AcceptedNumbers[i - 1])
+					{
+						Validator.AcceptedNumbers.RemoveAt(i);
+					}
+				}
+				Validator.bLimitNumbers = true;
+			}
+		}
+
+		Node->Validator = Validators.Num() - 1;
+	}
+}
+
+int32 FZLStateSchemaValidator::Validate(const TSharedPtr<FJsonObject>& State, TArray<FZLStateViolation>& OutViolations) const
+{
+	const int32 NumBefore = OutViolations.Num();
+	if (State.IsValid() && !IsEmpty())
+	{
+		FKeyStack Keys;
+		VisitObject(Root, *State, Keys, &OutViolations);
+	}
+	return OutViolations.Num() - NumBefore;
+}
+
+bool FZLStateSchemaValidator::IsValid(const TSharedPtr<FJsonObject>& State) const
+{
+	if (!State.IsValid() || IsEmpty())
+	{
+		return true;
+	}
+
+	FKeyStack Keys;
+	return VisitObject(Root, *State, Keys, nullptr);
+}
+
+bool FZLStateSchemaValidator::VisitObject(const FNode& Node, const FJsonObject& Object, FKeyStack& Keys, TArray<FZLStateViolation>* OutViolations) const
+{
+	for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : Object.Values)
+	{
+		// Keys outside the schema aren't checked, nor is anything below them
+		const TUniquePtr<FNode>* Child = Node.Children.Find(Pair.Key);
+		if (!Child || !Pair.Value.IsValid())
+		{
+			continue;
+		}
+
+		const FNode& ChildNode = **Child;
+		Keys.Push(&Pair.Key);
+
+		bool bContinue;
+		if (Pair.Value->Type == EJson::Object && ChildNode.Children.Num() > 0)
+		{
+			bContinue = VisitObject(ChildNode, *Pair.Value->AsObject(), Keys, OutViolations);
+		}
+		else if (ChildNode.Validator != INDEX_NONE)
+		{
+			bContinue = CheckValue(Validators[ChildNode.Validator], *Pair.Value, Keys, OutViolations);
+		}
+		else
+		{
+			bContinue = AddViolation(Keys, INDEX_NONE, EZLStateViolation::NotAnObject, OutViolations);
+		}
+
+		Keys.Pop();
+
+		if (!bContinue)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FZLStateSchemaValidator::CheckValue(const FKeyValidator& Validator, const FJsonValue& Value, FKeyStack& Keys, TArray<FZLStateViolation>* OutViolations) const
+{
+	EJson ItemType;
+	switch (Validator.Type)
+	{
+	case EStateKeyDataType::String:
+	case EStateKeyDataType::Number:
+	case EStateKeyDataType::Bool:
+	{
+		const EJson ExpectedType = Validator.Type == EStateKeyDataType::String ? EJson::String : Validator.Type == EStateKeyDataType::Number ? EJson::Number : EJson::Boolean;
+		if (Value.Type != ExpectedType)
+		{
+			return AddViolation(Keys, INDEX_NONE, EZLStateViolation::WrongType, OutViolations);
+		}
+		if (!IsAccepted(Validator, Value))
+		{
+			return AddViolation(Keys, INDEX_NONE, EZLStateViolation::NotAccepted, OutViolations);
+		}
+		return true;
+	}
+	case EStateKeyDataType::StringArray:
+		ItemType = EJson::String;
+		break;
+	case EStateKeyDataType::NumberArray:
+		ItemType = EJson::Number;
+		break;
+	default:
+		ItemType = EJson::Boolean;
+		break;
+	}
+
+	if (Value.Type != EJson::Array)
+	{
+		return AddViolation(Keys, INDEX_NONE, EZLStateViolation::WrongType, OutViolations);
+	}
+
+	const TArray<TSharedPtr<FJsonValue>>& Items = Value.AsArray();
+	for (int32 Index = 0; Index < Items.Num(); ++Index)
+	{
+		const bool bContinue = Items[Index].IsValid()
+			? CheckItem(Validator, ItemType, *Items[Index], Index, Keys, OutViolations)
+			: AddViolation(Keys, Index, EZLStateViolation::WrongType, OutViolations);
+		if (!bContinue)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FZLStateSchemaValidator::CheckItem(const FKeyValidator& Validator, EJson ItemType, const FJsonValue& Item, int32 Index, FKeyStack& Keys, TArray<FZLStateViolation>* OutViolations) const
+{
+	if (Item.Type != ItemType)
+	{
+		return AddViolation(Keys, Index, EZLStateViolation::WrongType, OutViolations);
+	}
+	if (!IsAccepted(Validator, Item))
+	{
+		return AddViolation(Keys, Index, EZLStateViolation::NotAccepted, OutViolations);
+	}
+	return true;
+}
+
+bool FZLStateSchemaValidator::IsAccepted(const FKeyValidator& Validator, const FJsonValue& Value) const
+{
+	if (Validator.bLimitStrings && Value.Type == EJson::String)
+	{
+		return Validator.AcceptedStrings.Contains(Value.AsString());
+	}
+	if (Validator.bLimitNumbers && Value.Type == EJson::Number)
+	{
+		return Algo::BinarySearch(Validator.AcceptedNumbers, Value.AsNumber()) != INDEX_NONE;
+	}
+	return true;
+}
+
+bool FZLStateSchemaValidator::AddViolation(const FKeyStack& Keys, int32 ItemIndex, EZLStateViolation Reason, TArray<FZLStateViolation>* OutViolations)
+{
+	if (!OutViolations)
+	{
+		return false;
+	}
+
+	FZLStateViolation& Violation = OutViolations->AddDefaulted_GetRef();
+	for (int32 i = 0; i < Keys.Num(); ++i)
+	{
+		if (i > 0)
+		{
+			Violation.Key.AppendChar(TEXT('.'));
+		}
+		Violation.Key.Append(*Keys[i]);
+	}
+	if (ItemIndex != INDEX_NONE)
+	{
+		Violation.Key.Appendf(TEXT("[%d]"), ItemIndex);
+	}
+	Violation.Reason = Reason;
+	return true;
+}
@@ -0,0 +1,538 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#include "ZLStateTree.h"
+#include "ZLCloudPluginStateManager.h"
+#include "ZLStateWebSync.h"
+#include "Hash/CityHash.h"
+
+namespace
+{
+	// SplitMix64 finalizer, spreads every input bit over the whole result
+	uint64 MixHash64(uint64 Value)
+	{
+		Value ^= Value >> 30;
+		Value *= 0xbf58476d1ce4e5b9ULL;
+		Value ^= Value >> 27;
+		Value *= 0x94d049bb133111ebULL;
+		Value ^= Value >> 31;
+		return Value;
+	}
+
+	uint64 CombineHash64(uint64 Seed, uint64 Value)
+	{
+		return MixHash64(Seed ^ (Value + 0x9e3779b97f4a7c15ULL + (Seed << 6) + (Seed >> 2)));
+	}
+
+	uint64 HashString64(const FString& String)
+	{
+		return CityHash64(reinterpret_cast<const char*>(*String), String.Len() * sizeof(TCHAR));
+	}
+
+	// Object keys are matched case insensitively by FJsonObject, so they hash that way
+	uint64 HashKey64(const FString& Key)
+	{
+		return HashString64(Key.ToLower());
+	}
+
+	uint64 HashField64(uint64 KeyHash, uint64 ValueHash)
+	{
+		return CombineHash64(KeyHash, ValueHash);
+	}
+
+	// Fields are summed so the result doesn't depend on map order
+	uint64 FinishObjectHash64(uint64 FieldsHash, int32 NumFields)
+	{
+		return CombineHash64(CombineHash64((uint64)EJson::Object, FieldsHash), (uint64)NumFields);
+	}
+
+	// Hash for anything that isn't an object
+	uint64 HashLeaf64(const FJsonValue& Value)
+	{
+		const uint64 TypeHash = (uint64)Value.Type;
+
+		switch (Value.Type)
+		{
+		case EJson::String:
+			return CombineHash64(TypeHash, HashString64(Value.AsString()));
+
+		case EJson::Number:
+		{
+			// +0 and -0 compare equal
+			const double Number = Value.AsNumber();
+			const double Canonical = Number == 0.0 ? 0.0 : Number;
+			uint64 Bits;
+			FMemory::Memcpy(&Bits, &Canonical, sizeof(Bits));
+			return CombineHash64(TypeHash, Bits);
+		}
+
+		case EJson::Boolean:
+			return CombineHash64(TypeHash, Value.AsBool() ? 1 : 0);
+
+		case EJson::Array:
+		{
+			const TArray<TSharedPtr<FJsonValue>>& Array = Value.AsArray();
+			uint64 Hash = CombineHash64(TypeHash, (uint64)Array.Num());
+			for (const TSharedPtr<FJsonValue>& Item : Array)
+			{
+				Hash = CombineHash64(Hash, GetJsonValueHash64(Item));
+			}
+			return Hash;
+		}
+
+		default:
+			return MixHash64(TypeHash);
+		}
+	}
+}
+
+uint64 GetJsonValueHash64(const TSharedPtr<FJsonValue>& Value)
+{
+	if (!Value.IsValid())
+	{
+		return 0;
+	}
+
+	if (Value->Type != EJson::Object)
+	{
+		return HashLeaf64(*Value);
+	}
+
+	const TSharedPtr<FJsonObject>& Object = Value->AsObject();
+	if (!Object.IsValid())
+	{
+		return FinishObjectHash64(0, 0);
+	}
+
+	uint64 FieldsHash = 0;
+	for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : Object->Values)
+	{
+		FieldsHash += HashField64(HashKey64(Pair.Key), GetJsonValueHash64(Pair.Value));
+	}
+	return FinishObjectHash64(FieldsHash, Object->Values.Num());
+}
+
+FZLStateTree::FZLStateTree()
+{
+	Reset(MakeShared<FJsonObject>());
+}
+
+void FZLStateTree::Reset(const TSharedPtr<FJsonObject>& InRoot)
+{
+	Root = InRoot;
+	Snapshot.Reset();
+	RootNode = FNode();
+	BuildNode(RootNode, Root.IsValid() ? MakeShared<FJsonValueObject>(Root) : nullptr, ++CurrentVersion);
+	RootNode.bIsObject = true;
+}
+
+void FZLStateTree::BuildNode(FNode& Node, const TSharedPtr<FJsonValue>& Value, uint64 Version)
+{
+	Node.Version = Version;
+	Node.bHashValid = false;
+	Node.Children.Reset();
+	Node.LeafCount = 0;
+	Node.bIsObject = Value.IsValid() && Value->Type == EJson::Object && Value->AsObject().IsValid();
+
+	if (Node.bIsObject)
+	{
+		const TSharedPtr<FJsonObject> Object = Value->AsObject();
+		Node.Children.Reserve(Object->Values.Num());
+
+		for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : Object->Values)
+		{
+			TUniquePtr<FNode> Child = MakeUnique<FNode>();
+			Child->KeyHash = HashKey64(Pair.Key);
+			BuildNode(*Child, Pair.Value, Version);
+			Node.LeafCount += Child->LeafCount;
+			Node.Children.Add(Pair.Key, MoveTemp(Child));
+		}
+	}
+	else if (Value.IsValid())
+	{
+		// Matches CountLeavesInJsonObject, nulls aren't leaves
+		Node.LeafCount = (Value->Type == EJson::String || Value->Type == EJson::Number || Value->Type == EJson::Boolean || Value->Type == EJson::Array) ? 1 : 0;
+	}
+}
+
+void FZLStateTree::MarkChanged(const FZLStateKeyPath& Path)
+{
+	if (!Path.IsValid() || !Root.IsValid())
+	{
+		return;
+	}
+
+	const uint64 Version = ++CurrentVersion;
+	const TArray<FZLStateKeyPath::FSegment>& Segments = Path.GetSegments();
+
+	// Nodes from the root down to the parent of whatever gets rebuilt, all of them take the new version
+	TArray<FNode*, TInlineAllocator<8>> NodeChain;
+	NodeChain.Add(&RootNode);
+
+	const FJsonObject* JsonObject = Root.Get();
+	int32 LeafDelta = 0;
+
+	for (int32 i = 0; i < Segments.Num(); ++i)
+	{
+		FNode& Parent = *NodeChain.Last();
+		const FZLStateKeyPath::FSegment& Segment = Segments[i];
+
+		const TSharedPtr<FJsonValue>* JsonValue = FZLStateKeyPathCache::FindSegment(*JsonObject, Segment);
+		TUniquePtr<FNode>* Child = Parent.Children.FindByHash(Segment.Hash, Segment.Name);
+
+		if (!JsonValue || !JsonValue->IsValid())
+		{
+			// Removed, possibly as an empty parent of the key that was actually removed
+			if (Child)
+			{
+				LeafDelta = -(*Child)->LeafCount;
+				Parent.Children.Remove(Segment.Name);
+			}
+			break;
+		}
+
+		const bool bDescend = i < Segments.Num() - 1 && (*JsonValue)->Type == EJson::Object && Child && (*Child)->bIsObject;
+		if (!bDescend)
+		{
+			// Reached the key, or a level that didn't exist or changed type, rebuild everything below it
+			const int32 OldLeafCount = Child ? (*Child)->LeafCount : 0;
+			if (!Child)
+			{
+				Child = &Parent.Children.Add(Segment.Name, MakeUnique<FNode>());
+				(*Child)->KeyHash = HashKey64(Segment.Name);
+			}
+
+			BuildNode(**Child, *JsonValue, Version);
+			LeafDelta = (*Child)->LeafCount - OldLeafCount;
+			break;
+		}
+
+		NodeChain.Add(Child->Get());
+		JsonObject = (*JsonValue)->AsObject().Get();
+	}
+
+	for (FNode* Node : NodeChain)
+	{
+		Node->Version = Version;
+		Node->LeafCount += LeafDelta;
+		Node->bHashValid = false;
+	}
+}
+
+uint64 FZLStateTree::HashNode(const FNode& Node, const TSharedPtr<FJsonValue>& Value) const
+{
+	if (Node.bHashValid)
+	{
+		return Node.Hash;
+	}
+
+	if (!Node.bIsObject || !Value.IsValid() || Value->Type != EJson::Object || !Value->AsObject().IsValid())
+	{
+		Node.Hash = GetJsonValueHash64(Value);
+	}
+	else
+	{
+		// Combine the children's cached hashes, only the ones invalidated since the last call get recomputed
+		const FJsonObject& Object = *Value->AsObject();
+		uint64 FieldsHash = 0;
+		for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : Object.Values)
+		{
+			const TUniquePtr<FNode>* Child = Node.Children.Find(Pair.Key);
+			FieldsHash += Child ? HashField64((*Child)->KeyHash, HashNode(**Child, Pair.Value)) : HashField64(HashKey64(Pair.Key), GetJsonValueHash64(Pair.Value));
+		}
+		Node.Hash = FinishObjectHash64(FieldsHash, Object.Values.Num());
+	}
+
+	Node.bHashValid = true;
+	return Node.Hash;
+}
+
+uint64 FZLStateTree::GetHash() const
+{
+	if (RootNode.bHashValid)
+	{
+		return RootNode.Hash;
+	}
+
+	return HashNode(RootNode, Root.IsValid() ? MakeShared<FJsonValueObject>(Root) : nullptr);
+}
+
+bool FZLStateTree::GetHash(const FZLStateKeyPath& Path, uint64& OutHash) const
+{
+	if (!Root.IsValid())
+	{
+		return false;
+	}
+
+	if (!Path.IsValid())
+	{
+		OutHash = GetHash();
+		return true;
+	}
+
+	const FNode* Node = &RootNode;
+	const FJsonObject* JsonObject = Root.Get();
+	const TArray<FZLStateKeyPath::FSegment>& Segments = Path.GetSegments();
+
+	for (int32 i = 0; i < Segments.Num(); ++i)
+	{
+		const TSharedPtr<FJsonValue>* JsonValue = JsonObject ? FZLStateKeyPathCache::FindSegment(*JsonObject, Segments[i]) : nullptr;
+		if (!JsonValue || !JsonValue->IsValid())
+		{
+			return false;
+		}
+
+		Node = Node ? Node->FindChild(Segments[i]) : nullptr;
+
+		if (i == Segments.Num() - 1)
+		{
+			OutHash = Node ? HashNode(*Node, *JsonValue) : GetJsonValueHash64(*JsonValue);
+			return true;
+		}
+
+		JsonObject = (*JsonValue)->Type == EJson::Object ? (*JsonValue)->AsObject().Get() : nullptr;
+	}
+
+	return false;
+}
+
+uint64 FZLStateTree::GetVersion(const FZLStateKeyPath& Path) const
+{
+	const FNode* Node = &RootNode;
+	for (const FZLStateKeyPath::FSegment& Segment : Path.GetSegments())
+	{
+		const FNode* Child = Node->FindChild(Segment);
+		if (!Child)
+		{
+			break;
+		}
+		Node = Child;
+	}
+
+	return Node->Version;
+}
+
+const FZLStateTree::FNode* FZLStateTree::FindNode(const FZLStateKeyPath& Path) const
+{
+	const FNode* Node = &RootNode;
+	for (const FZLStateKeyPath::FSegment& Segment : Path.GetSegments())
+	{
+		Node = Node->FindChild(Segment);
+		if (!Node)
+		{
+			return nullptr;
+		}
+	}
+
+	return Node;
+}
+
+void FZLStateTree::SetFingerprintExclusions(const TArray<FZLStateKeyPath>& Paths)
+{
+	FingerprintExclusions = FExclusion();
+	bFingerprintValid = false;
+
+	for (const FZLStateKeyPath& Path : Paths)
+	{
+		FExclusion* Exclusion = &FingerprintExclusions;
+		for (const FZLStateKeyPath::FSegment& Segment : Path.GetSegments())
+		{
+			TUniquePtr<FExclusion>* Child = Exclusion->Children.FindByHash(Segment.Hash, Segment.Name);
+			if (!Child)
+			{
+				Child = &Exclusion->Children.Add(Segment.Name, MakeUnique<FExclusion>());
+			}
+			Exclusion = Child->Get();
+		}
+
+		if (Exclusion != &FingerprintExclusions)
+		{
+			Exclusion->bExcluded = true;
+		}
+	}
+}
+
+uint64 FZLStateTree::FingerprintObject(const FNode& Node, const FJsonObject& Object, const FExclusion& Exclusion) const
+{
+	uint64 FieldsHash = 0;
+	int32 NumFields = 0;
+
+	for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : Object.Values)
+	{
+		const uint32 KeyHash = GetTypeHash(Pair.Key);
+		const TUniquePtr<FExclusion>* ChildExclusion = Exclusion.Children.FindByHash(KeyHash, Pair.Key);
+		if (ChildExclusion && (*ChildExclusion)->bExcluded)
+		{
+			continue;
+		}
+
+		const TUniquePtr<FNode>* Child = Node.Children.FindByHash(KeyHash, Pair.Key);
+		const bool bChildIsObject = Pair.Value.IsValid() && Pair.Value->Type == EJson::Object && Pair.Value->AsObject().IsValid();
+
+		uint64 ValueHash;
+		if (ChildExclusion && bChildIsObject && Child && (*Child)->bIsObject)
+		{
+			// Something further down is excluded, only this path needs recombining
+			ValueHash = FingerprintObject(**Child, *Pair.Value->AsObject(), **ChildExclusion);
+		}
+		else
+		{
+			ValueHash = Child ? HashNode(**Child, Pair.Value) : GetJsonValueHash64(Pair.Value);
+		}
+
+		FieldsHash += HashField64(Child ? (*Child)->KeyHash : HashKey64(Pair.Key), ValueHash);
+		++NumFields;
+	}
+
+	return FinishObjectHash64(FieldsHash, NumFields);
+}
+
+uint64 FZLStateTree::GetFingerprint() const
+{
+	if (FingerprintExclusions.Children.Num() == 0)
+	{
+		return GetHash();
+	}
+
+	if (!bFingerprintValid || FingerprintVersion != RootNode.Version)
+	{
+		Fingerprint = Root.IsValid() ? FingerprintObject(RootNode, *Root, FingerprintExclusions) : 0;
+		FingerprintVersion = RootNode.Version;
+		bFingerprintValid = true;
+	}
+
+	return Fingerprint;
+}
+
+TSharedPtr<FJsonObject> FZLStateTree::GetSnapshot() const
+{
+	if (!Root.IsValid())
+	{
+		return MakeShared<FJsonObject>();
+	}
+
+	if (!Snapshot.IsValid() || SnapshotVersion != RootNode.Version)
+	{
+		Snapshot = SnapshotObject(RootNode, *Root, Snapshot.Get());
+		SnapshotVersion = RootNode.Version;
+	}
+
+	return Snapshot;
+}
+
+TSharedPtr<FJsonObject> FZLStateTree::SnapshotObject(const FNode& Node, const FJsonObject& Object, const FJsonObject* Previous) const
+{
+	TSharedPtr<FJsonObject> Copy = MakeShared<FJsonObject>();
+	Copy->Values.Reserve(Object.Values.Num());
+
+	for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : Object.Values)
+	{
+		if (!Pair.Value.IsValid() || Pair.Value->Type != EJson::Object || !Pair.Value->AsObject().IsValid())
+		{
+			Copy->Values.Add(Pair.Key, Pair.Value);
+			continue;
+		}
+
+		const TUniquePtr<FNode>* Child = Node.Children.Find(Pair.Key);
+		const TSharedPtr<FJsonValue>* PreviousValue = Previous ? Previous->Values.Find(Pair.Key) : nullptr;
+		const FJsonObject* PreviousObject = PreviousValue && PreviousValue->IsValid() && (*PreviousValue)->Type == EJson::Object ? (*PreviousValue)->AsObject().Get() : nullptr;
+
+		if (!Child || !(*Child)->bIsObject)
+		{
+			// Bookkeeping out of step with the JSON, copy it all rather than trust the versions
+			Copy->Values.Add(Pair.Key, MakeShared<FJsonValueObject>(CopyJsonObjectStructure(Pair.Value->AsObject())));
+		}
+		else if (PreviousObject && (*Child)->Version <= SnapshotVersion)
+		{
+			// Unchanged since the previous snapshot, which never changes either
+			Copy->Values.Add(Pair.Key, *PreviousValue);
+		}
+		else
+		{
+			Copy->Values.Add(Pair.Key, MakeShared<FJsonValueObject>(SnapshotObject(**Child, *Pair.Value->AsObject(), PreviousObject)));
+		}
+	}
+
+	return Copy;
+}
+
+void FZLStateMatchTracker::SetTarget(const TSharedPtr<FJsonObject>& InTarget)
+{
+	Target = InTarget;
+	Unmatched.Reset();
+	CheckedRoot.Reset();
+	CheckedVersion = 0;
+	bChecked = false;
+}
+
+void FZLStateMatchTracker::Reset()
+{
+	SetTarget(nullptr);
+}
+
+bool FZLStateMatchTracker::Update(const FZLStateTree& Tree)
+{
+	if (!Target.IsValid() || !Tree.GetRoot().IsValid())
+	{
+		return !Target.IsValid();
+	}
+
+	const bool bForce = !bChecked || CheckedRoot.Pin() != Tree.GetRoot();
+	if (!bForce && Tree.GetVersion() == CheckedVersion)
+	{
+		return Unmatched.Num() == 0;
+	}
+
+	if (bForce)
+	{
+		Unmatched.Reset();
+	}
+
+	Visit(*Target, Tree.GetRoot().Get(), &Tree.GetRootNode(), FString(), bForce);
+
+	CheckedRoot = Tree.GetRoot();
+	CheckedVersion = Tree.GetVersion();
+	bChecked = true;
+
+	return Unmatched.Num() == 0;
+}
+
+void FZLStateMatchTracker::Visit(const FJsonObject& TargetObject, const FJsonObject* CurrentObject, const FZLStateTree::FNode* Node, const FString& Prefix, bool bForce)
+{
+	for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : TargetObject.Values)
+	{
+		const FString& Key = Pair.Key;
+		const TSharedPtr<FJsonValue>& TargetValue = Pair.Value;
+		const uint32 KeyHash = GetTypeHash(Key);
+
+		const TUniquePtr<FZLStateTree::FNode>* ChildNodePtr = Node ? Node->Children.FindByHash(KeyHash, Key) : nullptr;
+		const FZLStateTree::FNode* ChildNode = ChildNodePtr ? ChildNodePtr->Get() : nullptr;
+
+		// Nothing under this key has changed since the last check, so neither has its result
+		if (!bForce && ChildNode && ChildNode->Version <= CheckedVersion)
+		{
+			continue;
+		}
+
+		const TSharedPtr<FJsonValue>* CurrentValue = CurrentObject ? CurrentObject->Values.FindByHash(KeyHash, Key) : nullptr;
+		const bool bCurrentIsObject = CurrentValue && CurrentValue->IsValid() && (*CurrentValue)->Type == EJson::Object && (*CurrentValue)->AsObject().IsValid();
+		const FString Path = Prefix.IsEmpty() ? Key : Prefix + TEXT(".") + Key;
+
+		const TSharedPtr<FJsonObject> TargetChildObject = (TargetValue.IsValid() && TargetValue->Type == EJson::Object) ? TargetValue->AsObject() : nullptr;
+		if (TargetChildObject.IsValid() && TargetChildObject->Values.Num() > 0)
+		{
+			Visit(*TargetChildObject, bCurrentIsObject ? (*CurrentValue)->AsObject().Get() : nullptr, bCurrentIsObject ? ChildNode : nullptr, Path, bForce);
+			continue;
+		}
+
+		// An empty target object only asks for an object to exist, same as CreateDiffJsonObject
+		const bool bMatches = TargetChildObject.IsValid() ? bCurrentIsObject : (CurrentValue && CompareJsonValuesCaseSensitive(*CurrentValue, TargetValue));
+		if (bMatches)
+		{
+			Unmatched.Remove(Path);
+		}
+		else
+		{
+			Unmatched.Add(Path);
+		}
+	}
+}
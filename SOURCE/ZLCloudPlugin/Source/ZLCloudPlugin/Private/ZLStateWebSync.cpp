@@ -0,0 +1,275 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#include "ZLStateWebSync.h"
+#include "ZLCloudPluginStateManager.h"
+
+namespace
+{
+	bool IsJsonNull(const TSharedPtr<FJsonValue>& Value)
+	{
+		return !Value.IsValid() || Value->Type == EJson::Null;
+	}
+
+	// Returns false if the patch can't represent To
+	bool CreateMergePatchRecursive(const FJsonObject& From, const FJsonObject& To, FJsonObject& OutPatch)
+	{
+		static const FJsonObject EmptyObject;
+
+		for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : To.Values)
+		{
+			const TSharedPtr<FJsonValue>* FromValue = From.Values.Find(Pair.Key);
+
+			// A null in a merge patch means remove, so only an unchanged null can be carried over
+			if (IsJsonNull(Pair.Value))
+			{
+				if (FromValue && IsJsonNull(*FromValue))
+				{
+					continue;
+				}
+				return false;
+			}
+
+			if (FromValue && CompareJsonValuesCaseSensitive(*FromValue, Pair.Value))
+			{
+				continue;
+			}
+
+			if (Pair.Value->Type == EJson::Object)
+			{
+				// New objects are patched against an empty one so nulls inside them are caught too
+				const bool bFromObject = FromValue && FromValue->IsValid() && (*FromValue)->Type == EJson::Object;
+				TSharedPtr<FJsonObject> ChildPatch = MakeShareable(new FJsonObject);
+				if (!CreateMergePatchRecursive(bFromObject ? *(*FromValue)->AsObject() : EmptyObject, *Pair.Value->AsObject(), *ChildPatch))
+				{
+					return false;
+				}
+
+				// Objects that only differ in nested nulls or key case produce nothing
+				if (ChildPatch->Values.Num() > 0 || !bFromObject)
+				{
+					OutPatch.SetObjectField(Pair.Key, ChildPatch);
+				}
+				continue;
+			}
+
+			OutPatch.SetField(Pair.Key, Pair.Value);
+		}
+
+		for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : From.Values)
+		{
+			if (!To.Values.Contains(Pair.Key))
+			{
+				OutPatch.SetField(Pair.Key, MakeShared<FJsonValueNull>());
+			}
+		}
+
+		return true;
+	}
+}
+
+bool CreateJsonMergePatch(const TSharedPtr<FJsonObject>& From, const TSharedPtr<FJsonObject>& To, TSharedPtr<FJsonObject>& OutPatch)
+{
+	OutPatch = MakeShareable(new FJsonObject);
+
+	if (!To.IsValid())
+	{
+		return false;
+	}
+
+	static const FJsonObject EmptyObject;
+	return CreateMergePatchRecursive(From.IsValid() ? *From : EmptyObject, *To, *OutPatch);
+}
+
+void ApplyJsonMergePatch(const TSharedPtr<FJsonObject>& Target, const TSharedPtr<FJsonObject>& Patch)
+{
+	if (!Target.IsValid() || !Patch.IsValid())
+	{
+		return;
+	}
+
+	for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : Patch->Values)
+	{
+		if (!Pair.Value.IsValid() || Pair.Value->Type == EJson::Null)
+		{
+			Target->RemoveField(Pair.Key);
+			continue;
+		}
+
+		if (Pair.Value->Type != EJson::Object)
+		{
+			Target->SetField(Pair.Key, Pair.Value);
+			continue;
+		}
+
+		// Objects merge into an existing object, anything else at that key is replaced by a fresh one
+		const TSharedPtr<FJsonValue>* Existing = Target->Values.Find(Pair.Key);
+		TSharedPtr<FJsonObject> Child;
+		if (Existing && Existing->IsValid() && (*Existing)->Type == EJson::Object)
+		{
+			Child = (*Existing)->AsObject();
+		}
+		else
+		{
+			Child = MakeShareable(new FJsonObject);
+			Target->SetObjectField(Pair.Key, Child);
+		}
+
+		ApplyJsonMergePatch(Child, Pair.Value->AsObject());
+	}
+}
+
+TSharedPtr<FJsonObject> CopyJsonObjectStructure(const TSharedPtr<FJsonObject>& Source)
+{
+	TSharedPtr<FJsonObject> Copy = MakeShareable(new FJsonObject);
+	if (!Source.IsValid())
+	{
+		return Copy;
+	}
+
+	Copy->Values.Reserve(Source->Values.Num());
+	for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : Source->Values)
+	{
+		if (Pair.Value.IsValid() && Pair.Value->Type == EJson::Object)
+		{
+			Copy->SetObjectField(Pair.Key, CopyJsonObjectStructure(Pair.Value->AsObject()));
+		}
+		else
+		{
+			Copy->SetField(Pair.Key, Pair.Value);
+		}
+	}
+
+	return Copy;
+}
+
+void FZLStateWebSync::Reset()
+{
+	bDeltasEnabled = false;
+	AcknowledgedSequence = INDEX_NONE;
+	AcknowledgedState = FSnapshot();
+	Unacknowledged.Reset();
+	PushesSinceFullSnapshot = 0;
+}
+
+void FZLStateWebSync::SetDeltasEnabled(bool bEnabled)
+{
+	if (bDeltasEnabled == bEnabled)
+	{
+		return;
+	}
+
+	// Either way the page's idea of the state starts over from the next full snapshot
+	Reset();
+	bDeltasEnabled = bEnabled;
+}
+
+bool FZLStateWebSync::WriteState(const FZLStateTree& Tree, const TSharedPtr<FJsonObject>& OutPayload)
+{
+	const TSharedPtr<FJsonObject>& CurrentState = Tree.GetRoot();
+
+	if (!bDeltasEnabled)
+	{
+		OutPayload->SetObjectField("current_state", CurrentState);
+		return true;
+	}
+
+	const uint64 StateHash = Tree.GetHash();
+	const int32 Sequence = NextSequence++;
+
+	bool bFullSnapshot = AcknowledgedSequence == INDEX_NONE
+		|| PushesSinceFullSnapshot >= FullResyncInterval
+		|| Unacknowledged.Num() >= MaxUnacknowledged;
+
+	TSharedPtr<FJsonObject> Patch;
+	if (!bFullSnapshot)
+	{
+		if (AcknowledgedState.Hash == StateHash)
+		{
+			Patch = MakeShareable(new FJsonObject);
+		}
+		else if (!CreateJsonMergePatch(AcknowledgedState.State, CurrentState, Patch))
+		{
+			bFullSnapshot = true;
+		}
+	}
+
+	if (bFullSnapshot)
+	{
+		OutPayload->SetObjectField("current_state", CurrentState);
+		OutPayload->SetBoolField("state_full", true);
+		PushesSinceFullSnapshot = 0;
+
+		// Anything in flight is still a valid base if the page acknowledges it, but once over the limit start again from this snapshot
+		if (Unacknowledged.Num() >= MaxUnacknowledged)
+		{
+			Unacknowledged.Reset();
+		}
+	}
+	else
+	{
+		OutPayload->SetObjectField("current_state_patch", Patch);
+		OutPayload->SetNumberField("state_base_seq", AcknowledgedSequence);
+		PushesSinceFullSnapshot++;
+	}
+
+	OutPayload->SetNumberField("state_seq", Sequence);
+
+	// Keep what the page will hold after this push in case it becomes the next base
+	FSnapshot& Sent = Unacknowledged.Add(Sequence);
+	Sent.State = AcknowledgedState.Hash == StateHash && AcknowledgedState.State.IsValid() ? AcknowledgedState.State : Tree.GetSnapshot();
+	Sent.Hash = StateHash;
+
+	return bFullSnapshot;
+}
+
+void FZLStateWebSync::Acknowledge(int32 Sequence)
+{
+	FSnapshot* Snapshot = Unacknowledged.Find(Sequence);
+	if (!Snapshot)
+	{
+		UE_LOG(LogZLCloudPlugin, Verbose, TEXT("Ignoring acknowledgement of unknown state_seq %d"), Sequence);
+		return;
+	}
+
+	AcknowledgedState = MoveTemp(*Snapshot);
+	AcknowledgedSequence = Sequence;
+	Stats.NumAcks++;
+
+	// The page won't base anything on older states now
+	for (TMap<int32, FSnapshot>::TIterator It = Unacknowledged.CreateIterator(); It; ++It)
+	{
+		if (It->Key <= Sequence)
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+void FZLStateWebSync::GetKeptStates(TArray<TSharedPtr<FJsonObject>>& OutStates) const
+{
+	if (AcknowledgedState.State.IsValid())
+	{
+		OutStates.Add(AcknowledgedState.State);
+	}
+	for (const TPair<int32, FSnapshot>& Sent : Unacknowledged)
+	{
+		OutStates.Add(Sent.Value.State);
+	}
+}
+
+void FZLStateWebSync::RecordSent(bool bFullSnapshot, int32 NumChars)
+{
+	Stats.SentChars += NumChars;
+
+	if (bFullSnapshot)
+	{
+		Stats.NumFullSnapshots++;
+		Stats.FullEquivalentChars += NumChars;
+		LastFullSnapshotChars = NumChars;
+	}
+	else
+	{
+		Stats.NumPatches++;
+		Stats.FullEquivalentChars += FMath::Max(LastFullSnapshotChars, NumChars);
+	}
+}
@@ -0,0 +1,159 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#include "ZLTimerWheel.h"
+
+FZLTimerWheel::FZLTimerWheel(double InTickSeconds)
+	: TickSeconds(FMath::Max(InTickSeconds, UE_KINDA_SMALL_NUMBER))
+{
+}
+
+void FZLTimerWheel::Reset(double StartTime)
+{
+	for (int32 Level = 0; Level < NumLevels; ++Level)
+	{
+		for (int32 Slot = 0; Slot < SlotsPerLevel; ++Slot)
+		{
+			Slots[Level][Slot].Reset();
+		}
+		LevelCounts[Level] = 0;
+	}
+	Due.Reset();
+	Active.Reset();
+
+	Origin = StartTime;
+	CurrentTick = 0;
+}
+
+uint64 FZLTimerWheel::ToTick(double Time) const
+{
+	const double Ticks = (Time - Origin) / TickSeconds;
+	return Ticks > 0.0 ? (uint64)Ticks : 0;
+}
+
+FZLTimerWheel::FTimerId FZLTimerWheel::Schedule(double Deadline, TFunction<void()> Callback)
+{
+	// Rounded up so the timer can't fire before its deadline
+	const double Ticks = FMath::CeilToDouble((Deadline - Origin) / TickSeconds);
+
+	FTimer Timer;
+	Timer.Id = NextId++;
+	Timer.Tick = Ticks > 0.0 ? (uint64)Ticks : 0;
+	Timer.Callback = MoveTemp(Callback);
+
+	Active.Add(Timer.Id);
+	const FTimerId Id = Timer.Id;
+	Insert(MoveTemp(Timer));
+	return Id;
+}
+
+bool FZLTimerWheel::Cancel(FTimerId Id)
+{
+	return Active.Remove(Id) > 0;
+}
+
+void FZLTimerWheel::Insert(FTimer&& Timer)
+{
+	if (Timer.Tick <= CurrentTick)
+	{
+		Due.Add(MoveTemp(Timer));
+		return;
+	}
+
+	const uint64 Delta = Timer.Tick - CurrentTick;
+	for (int32 Level = 0; Level < NumLevels; ++Level)
+	{
+		const int32 Shift = Level * BitsPerLevel;
+		if (Delta < (1ULL << (Shift + BitsPerLevel)) || Level == NumLevels - 1)
+		{
+			// Beyond the top level's span the timer waits in the furthest slot and is refiled when that comes round
+			const uint64 FiledTick = Level == NumLevels - 1 ? FMath::Min(Timer.Tick, CurrentTick + (1ULL << (Shift + BitsPerLevel)) - 1) : Timer.Tick;
+			Slots[Level][(FiledTick >> Shift) & (SlotsPerLevel - 1)].Add(MoveTemp(Timer));
+			LevelCounts[Level]++;
+			return;
+		}
+	}
+}
+
+void FZLTimerWheel::Cascade(int32 Level)
+{
+	const int32 Slot = (CurrentTick >> (Level * BitsPerLevel)) & (SlotsPerLevel - 1);
+
+	TArray<FTimer> Timers = MoveTemp(Slots[Level][Slot]);
+	Slots[Level][Slot].Reset();
+	LevelCounts[Level] -= Timers.Num();
+
+	for (FTimer& Timer : Timers)
+	{
+		if (Active.Contains(Timer.Id))
+		{
+			Insert(MoveTemp(Timer));
+		}
+	}
+}
+
+int32 FZLTimerWheel::Advance(double Now)
+{
+	const uint64 TargetTick = ToTick(Now);
+	if (TargetTick <= CurrentTick && Due.Num() == 0)
+	{
+		return 0;
+	}
+
+	TArray<FTimer> Fired = MoveTemp(Due);
+	Due.Reset();
+
+	while (CurrentTick < TargetTick)
+	{
+		// Nothing can fire before the next boundary of the lowest level holding timers, so skip straight to it
+		int32 EmptyLevels = 0;
+		while (EmptyLevels < NumLevels && LevelCounts[EmptyLevels] == 0)
+		{
+			++EmptyLevels;
+		}
+		if (EmptyLevels > 0)
+		{
+			const uint64 SkipMask = EmptyLevels < NumLevels ? (1ULL << (EmptyLevels * BitsPerLevel)) - 1 : ~0ULL;
+			CurrentTick = FMath::Min(TargetTick - 1, CurrentTick | SkipMask);
+		}
+
+		++CurrentTick;
+
+		// Each level's slot is refiled when the levels below it wrap round
+		for (int32 Level = 1; Level < NumLevels; ++Level)
+		{
+			if ((CurrentTick & ((1ULL << (Level * BitsPerLevel)) - 1)) != 0)
+			{
+				break;
+			}
+			Cascade(Level);
+		}
+
+		TArray<FTimer>& Slot = Slots[0][CurrentTick & (SlotsPerLevel - 1)];
+		if (Slot.Num() > 0)
+		{
+			LevelCounts[0] -= Slot.Num();
+			Fired.Append(MoveTemp(Slot));
+			Slot.Reset();
+		}
+
+		// Refiled timers due exactly now land in Due
+		if (Due.Num() > 0)
+		{
+			Fired.Append(MoveTemp(Due));
+			Due.Reset();
+		}
+	}
+
+	int32 NumFired = 0;
+	for (FTimer& Timer : Fired)
+	{
+		// Skip anything cancelled, including by an earlier callback in this batch
+		if (Active.Remove(Timer.Id) > 0)
+		{
+			++NumFired;
+			Timer.Callback();
+		}
+	}
+
+	return NumFired;
+}
@@ -152,6 +152,7 @@ bool UZLTrackedStateBlueprint::GetFromStateManager(const FString& bluePrintName,
     TSharedPtr<FJsonValue> jsonData;
     bool Success = false;
 
+    UZLCloudPluginStateManager::GetZLCloudPluginStateManager()->TrackStateBlueprint(bluePrintName);
     UZLCloudPluginStateManager::GetZLCloudPluginStateManager()->GetRequestedStateValue<TSharedPtr<FJsonValue>>(bluePrintName, true, jsonData, Success);
 
     if (Success && jsonData.IsValid())
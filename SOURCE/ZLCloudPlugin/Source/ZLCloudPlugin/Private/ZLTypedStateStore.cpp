@@ -0,0 +1,468 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#include "ZLTypedStateStore.h"
+
+namespace
+{
+	// Fills Out from a JSON array whose items are all of ItemType, false if any item isn't
+	template <typename ElementType>
+	bool LoadTypedArray(const TArray<TSharedPtr<FJsonValue>>& Items, EJson ItemType, TArray<ElementType>& Out)
+	{
+		Out.Reset(Items.Num());
+		for (const TSharedPtr<FJsonValue>& Item : Items)
+		{
+			if (!Item.IsValid() || Item->Type != ItemType)
+			{
+				Out.Reset();
+				return false;
+			}
+
+			if constexpr (std::is_same<ElementType, double>::value)
+			{
+				Out.Add(Item->AsNumber());
+			}
+			else if constexpr (std::is_same<ElementType, bool>::value)
+			{
+				Out.Add(Item->AsBool());
+			}
+			else
+			{
+				Out.Add(Item->AsString());
+			}
+		}
+		return true;
+	}
+
+	int32 FindEnumValue(const TArray<FString>& Table, const FString& Value)
+	{
+		// State values are case sensitive, FString's operator== isn't
+		return Table.IndexOfByPredicate([&Value](const FString& Accepted) { return Accepted.Equals(Value, ESearchCase::CaseSensitive); });
+	}
+}
+
+void FZLTypedStateStore::Build(const UStateKeyInfoAsset* Schema)
+{
+	Slots.Reset();
+	SlotsByPathId.Reset();
+	Numbers.Reset();
+	Bools.Reset();
+	Strings.Reset();
+	EnumValues.Reset();
+	NumberArrays.Reset();
+	BoolArrays.Reset();
+	StringArrays.Reset();
+	EnumTables.Reset();
+	SyncedRoot.Reset();
+	bSynced = false;
+
+	if (!Schema)
+	{
+		return;
+	}
+
+	// Every proper prefix of a schema key, to find keys that sit above or below each other
+	TSet<FString> Keys;
+	TSet<FString> Prefixes;
+	for (const TPair<FString, FStateKeyInfo>& Entry : Schema->KeyInfos)
+	{
+		const FZLStateKeyPath Path = FZLStateKeyPath::Intern(Entry.Key);
+		const EStateKeyDataType Type = Entry.Value.GetDataTypeEnum();
+		if (!Path.IsValid() || Type == EStateKeyDataType::Invalid)
+		{
+			continue;
+		}
+
+		FSlot& Slot = Slots.AddDefaulted_GetRef();
+		Slot.Path = Path;
+		Slot.Type = Type;
+
+		switch (Type)
+		{
+		case EStateKeyDataType::Number:
+			Slot.Index = Numbers.Add(0.0);
+			break;
+		case EStateKeyDataType::Bool:
+			Slot.Index = Bools.Add(false);
+			break;
+		case EStateKeyDataType::String:
+			if (Entry.Value.bLimitValues && Entry.Value.AcceptedStringValues.Num() > 0)
+			{
+				Slot.EnumTable = EnumTables.Add(Entry.Value.AcceptedStringValues);
+				Slot.Index = EnumValues.Add(INDEX_NONE);
+			}
+			else
+			{
+				Slot.Index = Strings.AddDefaulted();
+			}
+			break;
+		case EStateKeyDataType::NumberArray:
+			Slot.Index = NumberArrays.AddDefaulted();
+			break;
+		case EStateKeyDataType::BoolArray:
+			Slot.Index = BoolArrays.AddDefaulted();
+			break;
+		case EStateKeyDataType::StringArray:
+			Slot.Index = StringArrays.AddDefaulted();
+			break;
+		default:
+			break;
+		}
+
+		const int32 Id = Path.GetId();
+		if (SlotsByPathId.Num() <= Id)
+		{
+			const int32 OldNum = SlotsByPathId.Num();
+			SlotsByPathId.SetNumUninitialized(Id + 1);
+			for (int32 i = OldNum; i <= Id; ++i)
+			{
+				SlotsByPathId[i] = INDEX_NONE;
+			}
+		}
+		SlotsByPathId[Id] = Slots.Num() - 1;
+
+		const FString& PathString = Path.ToString();
+		Keys.Add(PathString);
+		for (int32 Index = PathString.Find(TEXT(".")); Index != INDEX_NONE; Index = PathString.Find(TEXT("."), ESearchCase::CaseSensitive, ESearchDir::FromStart, Index + 1))
+		{
+			Prefixes.Add(PathString.Left(Index));
+		}
+	}
+
+	for (FSlot& Slot : Slots)
+	{
+		const FString& PathString = Slot.Path.ToString();
+		Slot.bIsolated = !Prefixes.Contains(PathString);
+		for (int32 Index = PathString.Find(TEXT(".")); Slot.bIsolated && Index != INDEX_NONE; Index = PathString.Find(TEXT("."), ESearchCase::CaseSensitive, ESearchDir::FromStart, Index + 1))
+		{
+			Slot.bIsolated = !Keys.Contains(PathString.Left(Index));
+		}
+	}
+}
+
+const FZLTypedStateStore::FSlot* FZLTypedStateStore::FindSlot(const FZLStateKeyPath& Path) const
+{
+	const int32 Id = Path.GetId();
+	if (!SlotsByPathId.IsValidIndex(Id) || SlotsByPathId[Id] == INDEX_NONE)
+	{
+		return nullptr;
+	}
+	return &Slots[SlotsByPathId[Id]];
+}
+
+const FZLTypedStateStore::FSlot* FZLTypedStateStore::FindHeldSlot(const FZLStateKeyPath& Path, EStateKeyDataType Type) const
+{
+	const FSlot* Slot = FindSlot(Path);
+	return Slot && Slot->bHeld && Slot->Type == Type ? Slot : nullptr;
+}
+
+EStateKeyDataType FZLTypedStateStore::GetSlotType(const FZLStateKeyPath& Path) const
+{
+	const FSlot* Slot = FindSlot(Path);
+	return Slot ? Slot->Type : EStateKeyDataType::Invalid;
+}
+
+void FZLTypedStateStore::Sync(const FZLStateTree& Tree)
+{
+	const TSharedPtr<FJsonObject>& Root = Tree.GetRoot();
+	if (Slots.Num() == 0)
+	{
+		return;
+	}
+
+	if (!Root.IsValid())
+	{
+		for (FSlot& Slot : Slots)
+		{
+			Slot.bHeld = false;
+		}
+		bSynced = false;
+		return;
+	}
+
+	const bool bSameRoot = bSynced && SyncedRoot.HasSameObject(Root.Get());
+	if (bSameRoot && SyncedVersion == Tree.GetVersion())
+	{
+		return;
+	}
+
+	for (FSlot& Slot : Slots)
+	{
+		const uint64 Version = Tree.GetVersion(Slot.Path);
+		if (!bSameRoot || Version != Slot.Version)
+		{
+			Load(Slot, Root, Version);
+		}
+	}
+
+	SyncedRoot = Root;
+	SyncedVersion = Tree.GetVersion();
+	bSynced = true;
+}
+
+void FZLTypedStateStore::Load(FSlot& Slot, const TSharedPtr<FJsonObject>& Root, uint64 Version)
+{
+	++NumReloads;
+	Slot.Version = Version;
+	Slot.bHeld = false;
+
+	const TSharedPtr<FJsonObject> Parent = FZLStateKeyPathCache::WalkToParent(Root, Slot.Path);
+	const TSharedPtr<FJsonValue>* Value = Parent.IsValid() ? FZLStateKeyPathCache::FindSegment(*Parent, Slot.Path.GetLeaf()) : nullptr;
+	if (!Value || !Value->IsValid())
+	{
+		return;
+	}
+
+	const FJsonValue& JsonValue = **Value;
+	switch (Slot.Type)
+	{
+	case EStateKeyDataType::Number:
+		if (JsonValue.Type == EJson::Number)
+		{
+			Numbers[Slot.Index] = JsonValue.AsNumber();
+			Slot.bHeld = true;
+		}
+		break;
+	case EStateKeyDataType::Bool:
+		if (JsonValue.Type == EJson::Boolean)
+		{
+			Bools[Slot.Index] = JsonValue.AsBool();
+			Slot.bHeld = true;
+		}
+		break;
+	case EStateKeyDataType::String:
+		if (JsonValue.Type == EJson::String)
+		{
+			if (Slot.EnumTable != INDEX_NONE)
+			{
+				// Values outside the accepted list are left to the JSON
+				EnumValues[Slot.Index] = FindEnumValue(EnumTables[Slot.EnumTable], JsonValue.AsString());
+				Slot.bHeld = EnumValues[Slot.Index] != INDEX_NONE;
+			}
+			else
+			{
+				Slot.bHeld = JsonValue.TryGetString(Strings[Slot.Index]);
+			}
+		}
+		break;
+	case EStateKeyDataType::NumberArray:
+		Slot.bHeld = JsonValue.Type == EJson::Array && LoadTypedArray(JsonValue.AsArray(), EJson::Number, NumberArrays[Slot.Index]);
+		break;
+	case EStateKeyDataType::BoolArray:
+		Slot.bHeld = JsonValue.Type == EJson::Array && LoadTypedArray(JsonValue.AsArray(), EJson::Boolean, BoolArrays[Slot.Index]);
+		break;
+	case EStateKeyDataType::StringArray:
+		Slot.bHeld = JsonValue.Type == EJson::Array && LoadTypedArray(JsonValue.AsArray(), EJson::String, StringArrays[Slot.Index]);
+		break;
+	default:
+		break;
+	}
+}
+
+bool FZLTypedStateStore::TryGet(const FZLStateKeyPath& Path, double& OutValue) const
+{
+	const FSlot* Slot = FindHeldSlot(Path, EStateKeyDataType::Number);
+	if (!Slot)
+	{
+		return false;
+	}
+	OutValue = Numbers[Slot->Index];
+	return true;
+}
+
+bool FZLTypedStateStore::TryGet(const FZLStateKeyPath& Path, float& OutValue) const
+{
+	double Value;
+	if (!TryGet(Path, Value))
+	{
+		return false;
+	}
+	OutValue = static_cast<float>(Value);
+	return true;
+}
+
+bool FZLTypedStateStore::TryGet(const FZLStateKeyPath& Path, bool& OutValue) const
+{
+	const FSlot* Slot = FindHeldSlot(Path, EStateKeyDataType::Bool);
+	if (!Slot)
+	{
+		return false;
+	}
+	OutValue = Bools[Slot->Index];
+	return true;
+}
+
+bool FZLTypedStateStore::TryGet(const FZLStateKeyPath& Path, FString& OutValue) const
+{
+	const FSlot* Slot = FindHeldSlot(Path, EStateKeyDataType::String);
+	if (!Slot)
+	{
+		return false;
+	}
+	OutValue = Slot->EnumTable != INDEX_NONE ? EnumTables[Slot->EnumTable][EnumValues[Slot->Index]] : Strings[Slot->Index];
+	return true;
+}
+
+bool FZLTypedStateStore::TryGet(const FZLStateKeyPath& Path, TArray<double>& OutValue) const
+{
+	const FSlot* Slot = FindHeldSlot(Path, EStateKeyDataType::NumberArray);
+	if (!Slot)
+	{
+		return false;
+	}
+	OutValue.Append(NumberArrays[Slot->Index]);
+	return true;
+}
+
+bool FZLTypedStateStore::TryGet(const FZLStateKeyPath& Path, TArray<float>& OutValue) const
+{
+	const FSlot* Slot = FindHeldSlot(Path, EStateKeyDataType::NumberArray);
+	if (!Slot)
+	{
+		return false;
+	}
+	OutValue.Reserve(OutValue.Num() + NumberArrays[Slot->Index].Num());
+	for (double Value : NumberArrays[Slot->Index])
+	{
+		OutValue.Add(static_cast<float>(Value));
+	}
+	return true;
+}
+
+bool FZLTypedStateStore::TryGet(const FZLStateKeyPath& Path, TArray<bool>& OutValue) const
+{
+	const FSlot* Slot = FindHeldSlot(Path, EStateKeyDataType::BoolArray);
+	if (!Slot)
+	{
+		return false;
+	}
+	OutValue.Append(BoolArrays[Slot->Index]);
+	return true;
+}
+
+bool FZLTypedStateStore::TryGet(const FZLStateKeyPath& Path, TArray<FString>& OutValue) const
+{
+	const FSlot* Slot = FindHeldSlot(Path, EStateKeyDataType::StringArray);
+	if (!Slot)
+	{
+		return false;
+	}
+	OutValue.Append(StringArrays[Slot->Index]);
+	return true;
+}
+
+void FZLTypedStateStore::FinishStore(FSlot& Slot, const FZLStateTree& Tree, uint64 VersionBefore)
+{
+	Slot.bHeld = true;
+	Slot.Version = Tree.GetVersion(Slot.Path);
+
+	// Only this key changed since the store was last in sync, unless the write also replaced another schema key above or below it
+	if (Slot.bIsolated && bSynced && SyncedVersion == VersionBefore && SyncedRoot.HasSameObject(Tree.GetRoot().Get()))
+	{
+		SyncedVersion = Tree.GetVersion();
+	}
+}
+
+bool FZLTypedStateStore::Store(const FZLStateKeyPath& Path, double Value, const FZLStateTree& Tree, uint64 VersionBefore)
+{
+	FSlot* Slot = FindSlot(Path);
+	if (!Slot || Slot->Type != EStateKeyDataType::Number)
+	{
+		return false;
+	}
+	Numbers[Slot->Index] = Value;
+	FinishStore(*Slot, Tree, VersionBefore);
+	return true;
+}
+
+bool FZLTypedStateStore::Store(const FZLStateKeyPath& Path, float Value, const FZLStateTree& Tree, uint64 VersionBefore)
+{
+	return Store(Path, static_cast<double>(Value), Tree, VersionBefore);
+}
+
+bool FZLTypedStateStore::Store(const FZLStateKeyPath& Path, bool Value, const FZLStateTree& Tree, uint64 VersionBefore)
+{
+	FSlot* Slot = FindSlot(Path);
+	if (!Slot || Slot->Type != EStateKeyDataType::Bool)
+	{
+		return false;
+	}
+	Bools[Slot->Index] = Value;
+	FinishStore(*Slot, Tree, VersionBefore);
+	return true;
+}
+
+bool FZLTypedStateStore::Store(const FZLStateKeyPath& Path, const FString& Value, const FZLStateTree& Tree, uint64 VersionBefore)
+{
+	FSlot* Slot = FindSlot(Path);
+	if (!Slot || Slot->Type != EStateKeyDataType::String)
+	{
+		return false;
+	}
+
+	if (Slot->EnumTable != INDEX_NONE)
+	{
+		EnumValues[Slot->Index] = FindEnumValue(EnumTables[Slot->EnumTable], Value);
+		FinishStore(*Slot, Tree, VersionBefore);
+		Slot->bHeld = EnumValues[Slot->Index] != INDEX_NONE;
+	}
+	else
+	{
+		Strings[Slot->Index] = Value;
+		FinishStore(*Slot, Tree, VersionBefore);
+	}
+	return true;
+}
+
+bool FZLTypedStateStore::Store(const FZLStateKeyPath& Path, const TArray<double>& Value, const FZLStateTree& Tree, uint64 VersionBefore)
+{
+	FSlot* Slot = FindSlot(Path);
+	if (!Slot || Slot->Type != EStateKeyDataType::NumberArray)
+	{
+		return false;
+	}
+	NumberArrays[Slot->Index] = Value;
+	FinishStore(*Slot, Tree, VersionBefore);
+	return true;
+}
+
+bool FZLTypedStateStore::Store(const FZLStateKeyPath& Path, const TArray<float>& Value, const FZLStateTree& Tree, uint64 VersionBefore)
+{
+	FSlot* Slot = FindSlot(Path);
+	if (!Slot || Slot->Type != EStateKeyDataType::NumberArray)
+	{
+		return false;
+	}
+
+	TArray<double>& Items = NumberArrays[Slot->Index];
+	Items.Reset(Value.Num());
+	for (float Item : Value)
+	{
+		Items.Add(Item);
+	}
+	FinishStore(*Slot, Tree, VersionBefore);
+	return true;
+}
+
+bool FZLTypedStateStore::Store(const FZLStateKeyPath& Path, const TArray<bool>& Value, const FZLStateTree& Tree, uint64 VersionBefore)
+{
+	FSlot* Slot = FindSlot(Path);
+	if (!Slot || Slot->Type != EStateKeyDataType::BoolArray)
+	{
+		return false;
+	}
+	BoolArrays[Slot->Index] = Value;
+	FinishStore(*Slot, Tree, VersionBefore);
+	return true;
+}
+
+bool FZLTypedStateStore::Store(const FZLStateKeyPath& Path, const TArray<FString>& Value, const FZLStateTree& Tree, uint64 VersionBefore)
+{
+	FSlot* Slot = FindSlot(Path);
+	if (!Slot || Slot->Type != EStateKeyDataType::StringArray)
+	{
+		return false;
+	}
+	StringArrays[Slot->Index] = Value;
+	FinishStore(*Slot, Tree, VersionBefore);
+	return true;
+}
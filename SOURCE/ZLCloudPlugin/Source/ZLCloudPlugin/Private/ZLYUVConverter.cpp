@@ -0,0 +1,329 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#include "ZLYUVConverter.h"
+#include "CloudStream2dll.h"
+#include "Async/ParallelFor.h"
+#include "Math/UnrealMathUtility.h"
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS_NEON
+#include <arm_neon.h>
+#elif PLATFORM_ENABLE_VECTORINTRINSICS && PLATFORM_CPU_X86_FAMILY
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	constexpr int32 FixedPointBits = 15;
+	constexpr int32 FixedPointRound = 1 << (FixedPointBits - 1);
+	constexpr int32 ChromaOffset = 128;
+
+	int32 ToFixedPoint(double Value)
+	{
+		return FMath::RoundToInt(Value * (1 << FixedPointBits));
+	}
+
+	uint8 ApplyCoefficients(const int16 Coef[3], int32 C0, int32 C1, int32 C2, int32 Offset)
+	{
+		const int32 Value = ((Coef[0] * C0 + Coef[1] * C1 + Coef[2] * C2 + FixedPointRound) >> FixedPointBits) + Offset;
+		return static_cast<uint8>(FMath::Clamp(Value, 0, 255));
+	}
+}
+
+FZLYUVColorSpace FZLYUVColorSpace::FromCloudStream(uint32 InCloudStreamColorSpace)
+{
+	FZLYUVColorSpace ColorSpace;
+	switch (InCloudStreamColorSpace)
+	{
+	case CloudStream2DLL::YUVColorSpace::BT_601Full:
+		ColorSpace.Matrix = EZLYUVMatrix::BT601;
+		ColorSpace.Range = EZLYUVRange::Full;
+		break;
+	case CloudStream2DLL::YUVColorSpace::BT_601Studio:
+		ColorSpace.Matrix = EZLYUVMatrix::BT601;
+		ColorSpace.Range = EZLYUVRange::Limited;
+		break;
+	case CloudStream2DLL::YUVColorSpace::BT_709Studio:
+	default:
+		ColorSpace.Matrix = EZLYUVMatrix::BT709;
+		ColorSpace.Range = EZLYUVRange::Limited;
+		break;
+	}
+	return ColorSpace;
+}
+
+FZLYUVConverter::FZLYUVConverter(const FZLYUVColorSpace& InColorSpace, EZLRGBLayout InLayout)
+{
+	const double Kr = InColorSpace.Matrix == EZLYUVMatrix::BT601 ? 0.299 : 0.2126;
+	const double Kb = InColorSpace.Matrix == EZLYUVMatrix::BT601 ? 0.114 : 0.0722;
+	const double Kg = 1.0 - Kr - Kb;
+
+	const bool bFullRange = InColorSpace.Range == EZLYUVRange::Full;
+	const double YScale = bFullRange ? 1.0 : 219.0 / 255.0;
+	const double ChromaScale = bFullRange ? 1.0 : 224.0 / 255.0;
+	YOffset = bFullRange ? 0 : 16;
+
+	// The green coefficient takes up the rounding error so white maps to exactly full luma and greys to exactly neutral chroma
+	const int32 YR = ToFixedPoint(Kr * YScale);
+	const int32 YB = ToFixedPoint(Kb * YScale);
+	const int32 YG = ToFixedPoint(YScale) - YR - YB;
+
+	const int32 UR = ToFixedPoint(-0.5 * Kr / (1.0 - Kb) * ChromaScale);
+	const int32 UB = ToFixedPoint(0.5 * ChromaScale);
+	const int32 UG = -UR - UB;
+
+	const int32 VR = ToFixedPoint(0.5 * ChromaScale);
+	const int32 VB = ToFixedPoint(-0.5 * Kb / (1.0 - Kr) * ChromaScale);
+	const int32 VG = -VR - VB;
+
+	const int32 RIndex = InLayout == EZLRGBLayout::RGBA ? 0 : 2;
+	const int32 BIndex = 2 - RIndex;
+
+	YCoef[RIndex] = static_cast<int16>(YR);
+	YCoef[1] = static_cast<int16>(YG);
+	YCoef[BIndex] = static_cast<int16>(YB);
+
+	UCoef[RIndex] = static_cast<int16>(UR);
+	UCoef[1] = static_cast<int16>(UG);
+	UCoef[BIndex] = static_cast<int16>(UB);
+
+	VCoef[RIndex] = static_cast<int16>(VR);
+	VCoef[1] = static_cast<int16>(VG);
+	VCoef[BIndex] = static_cast<int16>(VB);
+}
+
+void FZLYUVConverter::ConvertToI420(const uint8* Src, int32 SrcStride, int32 Width, int32 Height,
+	uint8* DstY, int32 StrideY, uint8* DstU, int32 StrideU, uint8* DstV, int32 StrideV) const
+{
+	checkf(StrideU == StrideV, TEXT("I420 conversion expects the U and V planes to share a stride"));
+	Convert(Src, SrcStride, Width, Height, DstY, StrideY, DstU, DstV, StrideU, false);
+}
+
+void FZLYUVConverter::ConvertToNV12(const uint8* Src, int32 SrcStride, int32 Width, int32 Height,
+	uint8* DstY, int32 StrideY, uint8* DstUV, int32 StrideUV) const
+{
+	Convert(Src, SrcStride, Width, Height, DstY, StrideY, DstUV, DstUV + 1, StrideUV, true);
+}
+
+void FZLYUVConverter::Convert(const uint8* Src, int32 SrcStride, int32 Width, int32 Height,
+	uint8* DstY, int32 StrideY, uint8* DstU, uint8* DstV, int32 StrideChroma, bool bInterleavedChroma) const
+{
+	if (Width <= 0 || Height <= 0)
+	{
+		return;
+	}
+
+	const int32 NumTiles = FMath::DivideAndRoundUp(Height, RowsPerTile);
+
+	ParallelFor(NumTiles, [&](int32 TileIndex)
+	{
+		const int32 FirstRow = TileIndex * RowsPerTile;
+		const int32 LastRow = FMath::Min(FirstRow + RowsPerTile, Height);
+
+		for (int32 Row = FirstRow; Row < LastRow; Row += 2)
+		{
+			// An odd final row is paired with itself for chroma
+			const bool bHasSecondRow = Row + 1 < Height;
+			const uint8* Row0 = Src + static_cast<int64>(Row) * SrcStride;
+			const uint8* Row1 = bHasSecondRow ? Row0 + SrcStride : Row0;
+
+			ConvertLumaRow(Row0, DstY + static_cast<int64>(Row) * StrideY, Width);
+			if (bHasSecondRow)
+			{
+				ConvertLumaRow(Row1, DstY + static_cast<int64>(Row + 1) * StrideY, Width);
+			}
+
+			const int64 ChromaRowOffset = static_cast<int64>(Row / 2) * StrideChroma;
+			ConvertChromaRow(Row0, Row1, Width, DstU + ChromaRowOffset, DstV + ChromaRowOffset, bInterleavedChroma);
+		}
+	}, !bParallel || NumTiles == 1);
+}
+
+void FZLYUVConverter::ConvertLumaRow(const uint8* Src, uint8* DstY, int32 Width) const
+{
+	int32 X = 0;
+
+	if (bVectorised)
+	{
+#if PLATFORM_ENABLE_VECTORINTRINSICS_NEON
+		const int32x4_t RoundVec = vdupq_n_s32(FixedPointRound);
+		const int32x4_t OffsetVec = vdupq_n_s32(YOffset);
+		for (; X + 8 <= Width; X += 8)
+		{
+			const uint8x8x4_t Pixels = vld4_u8(Src + X * 4);
+			const int16x8_t C0 = vreinterpretq_s16_u16(vmovl_u8(Pixels.val[0]));
+			const int16x8_t C1 = vreinterpretq_s16_u16(vmovl_u8(Pixels.val[1]));
+			const int16x8_t C2 = vreinterpretq_s16_u16(vmovl_u8(Pixels.val[2]));
+
+			int32x4_t Low = vmull_n_s16(vget_low_s16(C0), YCoef[0]);
+			Low = vmlal_n_s16(Low, vget_low_s16(C1), YCoef[1]);
+			Low = vmlal_n_s16(Low, vget_low_s16(C2), YCoef[2]);
+			int32x4_t High = vmull_n_s16(vget_high_s16(C0), YCoef[0]);
+			High = vmlal_n_s16(High, vget_high_s16(C1), YCoef[1]);
+			High = vmlal_n_s16(High, vget_high_s16(C2), YCoef[2]);
+
+			Low = vaddq_s32(vshrq_n_s32(vaddq_s32(Low, RoundVec), FixedPointBits), OffsetVec);
+			High = vaddq_s32(vshrq_n_s32(vaddq_s32(High, RoundVec), FixedPointBits), OffsetVec);
+
+			vst1_u8(DstY + X, vqmovun_s16(vcombine_s16(vqmovn_s32(Low), vqmovn_s32(High))));
+		}
+#elif PLATFORM_ENABLE_VECTORINTRINSICS && PLATFORM_CPU_X86_FAMILY
+		// Masking a pixel with 0x00FF00FF leaves bytes 0 and 2 as 16 bit pairs, shifting down by 8 first leaves bytes 1 and 3.
+		// _mm_madd_epi16 then does the multiply and the pairwise add, alpha gets a zero coefficient.
+		const __m128i ByteMask = _mm_set1_epi32(0x00FF00FF);
+		const __m128i Coef02 = _mm_set1_epi32(static_cast<int32>(static_cast<uint16>(YCoef[0]) | (static_cast<uint32>(static_cast<uint16>(YCoef[2])) << 16)));
+		const __m128i Coef13 = _mm_set1_epi32(static_cast<int32>(static_cast<uint16>(YCoef[1])));
+		const __m128i RoundVec = _mm_set1_epi32(FixedPointRound);
+		const __m128i OffsetVec = _mm_set1_epi32(YOffset);
+
+		auto LumaFromPixels = [&](__m128i Pixels)
+		{
+			const __m128i Bytes02 = _mm_and_si128(Pixels, ByteMask);
+			const __m128i Bytes13 = _mm_and_si128(_mm_srli_epi32(Pixels, 8), ByteMask);
+			const __m128i Sum = _mm_add_epi32(_mm_madd_epi16(Bytes02, Coef02), _mm_madd_epi16(Bytes13, Coef13));
+			return _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(Sum, RoundVec), FixedPointBits), OffsetVec);
+		};
+
+		for (; X + 8 <= Width; X += 8)
+		{
+			const __m128i Luma0 = LumaFromPixels(_mm_loadu_si128(reinterpret_cast<const __m128i*>(Src + X * 4)));
+			const __m128i Luma1 = LumaFromPixels(_mm_loadu_si128(reinterpret_cast<const __m128i*>(Src + X * 4 + 16)));
+			const __m128i Packed = _mm_packs_epi32(Luma0, Luma1);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(DstY + X), _mm_packus_epi16(Packed, Packed));
+		}
+#endif
+	}
+
+	for (; X < Width; ++X)
+	{
+		const uint8* Pixel = Src + X * 4;
+		DstY[X] = ApplyCoefficients(YCoef, Pixel[0], Pixel[1], Pixel[2], YOffset);
+	}
+}
+
+void FZLYUVConverter::ConvertChromaRow(const uint8* Row0, const uint8* Row1, int32 Width, uint8* DstU, uint8* DstV, bool bInterleavedChroma) const
+{
+	const int32 ChromaStep = bInterleavedChroma ? 2 : 1;
+	int32 X = 0;
+
+	if (bVectorised)
+	{
+#if PLATFORM_ENABLE_VECTORINTRINSICS_NEON
+		const int32x4_t RoundVec = vdupq_n_s32(FixedPointRound);
+		const int32x4_t OffsetVec = vdupq_n_s32(ChromaOffset);
+
+		auto ApplyVec = [&](const int16x8_t C[3], const int16 Coef[3])
+		{
+			int32x4_t Low = vmull_n_s16(vget_low_s16(C[0]), Coef[0]);
+			Low = vmlal_n_s16(Low, vget_low_s16(C[1]), Coef[1]);
+			Low = vmlal_n_s16(Low, vget_low_s16(C[2]), Coef[2]);
+			int32x4_t High = vmull_n_s16(vget_high_s16(C[0]), Coef[0]);
+			High = vmlal_n_s16(High, vget_high_s16(C[1]), Coef[1]);
+			High = vmlal_n_s16(High, vget_high_s16(C[2]), Coef[2]);
+
+			Low = vaddq_s32(vshrq_n_s32(vaddq_s32(Low, RoundVec), FixedPointBits), OffsetVec);
+			High = vaddq_s32(vshrq_n_s32(vaddq_s32(High, RoundVec), FixedPointBits), OffsetVec);
+			return vqmovun_s16(vcombine_s16(vqmovn_s32(Low), vqmovn_s32(High)));
+		};
+
+		for (; X + 16 <= Width; X += 16)
+		{
+			const uint8x16x4_t Pixels0 = vld4q_u8(Row0 + X * 4);
+			const uint8x16x4_t Pixels1 = vld4q_u8(Row1 + X * 4);
+
+			// Pairwise add across each row then down the two rows, vrshrq does the rounded divide by four
+			int16x8_t Average[3];
+			for (int32 Channel = 0; Channel < 3; ++Channel)
+			{
+				const uint16x8_t Sum = vpadalq_u8(vpaddlq_u8(Pixels0.val[Channel]), Pixels1.val[Channel]);
+				Average[Channel] = vreinterpretq_s16_u16(vrshrq_n_u16(Sum, 2));
+			}
+
+			const uint8x8_t U = ApplyVec(Average, UCoef);
+			const uint8x8_t V = ApplyVec(Average, VCoef);
+
+			if (bInterleavedChroma)
+			{
+				uint8x8x2_t UV;
+				UV.val[0] = U;
+				UV.val[1] = V;
+				vst2_u8(DstU + X, UV);
+			}
+			else
+			{
+				vst1_u8(DstU + X / 2, U);
+				vst1_u8(DstV + X / 2, V);
+			}
+		}
+#elif PLATFORM_ENABLE_VECTORINTRINSICS && PLATFORM_CPU_X86_FAMILY
+		const __m128i Zero = _mm_setzero_si128();
+		const __m128i Two = _mm_set1_epi16(2);
+		const __m128i UCoefVec = _mm_set_epi16(0, UCoef[2], UCoef[1], UCoef[0], 0, UCoef[2], UCoef[1], UCoef[0]);
+		const __m128i VCoefVec = _mm_set_epi16(0, VCoef[2], VCoef[1], VCoef[0], 0, VCoef[2], VCoef[1], VCoef[0]);
+		const __m128i RoundVec = _mm_set1_epi32(FixedPointRound);
+		const __m128i OffsetVec = _mm_set1_epi32(ChromaOffset);
+
+		// Sums two horizontally adjacent 2x2 blocks, returned as 16 bit channels of block 0 then block 1
+		auto SumBlocks = [&](__m128i Top, __m128i Bottom)
+		{
+			const __m128i Left = _mm_add_epi16(_mm_unpacklo_epi8(Top, Zero), _mm_unpacklo_epi8(Bottom, Zero));
+			const __m128i Right = _mm_add_epi16(_mm_unpackhi_epi8(Top, Zero), _mm_unpackhi_epi8(Bottom, Zero));
+			return _mm_unpacklo_epi64(_mm_add_epi16(Left, _mm_srli_si128(Left, 8)), _mm_add_epi16(Right, _mm_srli_si128(Right, 8)));
+		};
+
+		// _mm_madd_epi16 leaves each block as two partial sums, the shuffles gather them so one add finishes all four blocks
+		auto ApplyVec = [&](__m128i Blocks01, __m128i Blocks23, __m128i CoefVec)
+		{
+			const __m128 Partial01 = _mm_castsi128_ps(_mm_madd_epi16(Blocks01, CoefVec));
+			const __m128 Partial23 = _mm_castsi128_ps(_mm_madd_epi16(Blocks23, CoefVec));
+			const __m128i Even = _mm_castps_si128(_mm_shuffle_ps(Partial01, Partial23, _MM_SHUFFLE(2, 0, 2, 0)));
+			const __m128i Odd = _mm_castps_si128(_mm_shuffle_ps(Partial01, Partial23, _MM_SHUFFLE(3, 1, 3, 1)));
+			const __m128i Sum = _mm_add_epi32(_mm_add_epi32(Even, Odd), RoundVec);
+			const __m128i Value = _mm_add_epi32(_mm_srai_epi32(Sum, FixedPointBits), OffsetVec);
+			const __m128i Packed = _mm_packs_epi32(Value, Value);
+			return _mm_packus_epi16(Packed, Packed);
+		};
+
+		for (; X + 8 <= Width; X += 8)
+		{
+			const __m128i Top0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Row0 + X * 4));
+			const __m128i Top1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Row0 + X * 4 + 16));
+			const __m128i Bottom0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Row1 + X * 4));
+			const __m128i Bottom1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Row1 + X * 4 + 16));
+
+			const __m128i Blocks01 = _mm_srli_epi16(_mm_add_epi16(SumBlocks(Top0, Bottom0), Two), 2);
+			const __m128i Blocks23 = _mm_srli_epi16(_mm_add_epi16(SumBlocks(Top1, Bottom1), Two), 2);
+
+			const __m128i U = ApplyVec(Blocks01, Blocks23, UCoefVec);
+			const __m128i V = ApplyVec(Blocks01, Blocks23, VCoefVec);
+
+			if (bInterleavedChroma)
+			{
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(DstU + X), _mm_unpacklo_epi8(U, V));
+			}
+			else
+			{
+				const int32 UBytes = _mm_cvtsi128_si32(U);
+				const int32 VBytes = _mm_cvtsi128_si32(V);
+				FMemory::Memcpy(DstU + X / 2, &UBytes, sizeof(int32));
+				FMemory::Memcpy(DstV + X / 2, &VBytes, sizeof(int32));
+			}
+		}
+#endif
+	}
+
+	for (; X < Width; X += 2)
+	{
+		// An odd final column is paired with itself
+		const int32 X1 = FMath::Min(X + 1, Width - 1);
+
+		int32 Average[3];
+		for (int32 Channel = 0; Channel < 3; ++Channel)
+		{
+			Average[Channel] = (Row0[X * 4 + Channel] + Row0[X1 * 4 + Channel] + Row1[X * 4 + Channel] + Row1[X1 * 4 + Channel] + 2) >> 2;
+		}
+
+		const int32 ChromaIndex = (X / 2) * ChromaStep;
+		DstU[ChromaIndex] = ApplyCoefficients(UCoef, Average[0], Average[1], Average[2], ChromaOffset);
+		DstV[ChromaIndex] = ApplyCoefficients(VCoef, Average[0], Average[1], Average[2], ChromaOffset);
+	}
+}
@@ -45,6 +45,11 @@ namespace ZLCloudPlugin
 #endif
 		static void SendCommand(const char* id, const char* data);
 
+		// Resolution the encoder has asked for, zero until it has. Captured frames are scaled to it on their way in.
+		static FIntPoint GetEncoderResolution();
+		// CloudStream2DLL::YUVColorSpace the encoder has asked for, BT.709 studio swing until it has.
+		static uint32 GetEncoderColorSpace();
+
 		static void UpdateFPS();
 		static void UpdateFilteredKeys();
 
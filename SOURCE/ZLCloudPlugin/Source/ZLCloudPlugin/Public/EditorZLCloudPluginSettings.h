@@ -25,6 +25,26 @@
 
 #include "EditorZLCloudPluginSettings.generated.h"
 
+UENUM()
+enum class EZLFramePacingPolicy : uint8
+{
+	// Frames for missed deadlines are sent back to back until the stream is back on schedule
+	CatchUp,
+	// Missed deadlines are dropped and the stream continues from the next deadline
+	Skip
+};
+
+UENUM()
+enum class EZLFrameBudgetPolicy : uint8
+{
+	// The oldest waiting frame is dropped to make room, and the encoder always takes the newest, keeps latency low
+	DropOldest,
+	// The newly captured frame is dropped, frames already waiting are sent in order
+	DropNewest,
+	// The new frame is held until the encoder takes a frame, and dropped if that takes longer than the timeout. Capture itself doesn't wait.
+	BlockWithTimeout
+};
+
 // Config loaded/saved to an .ini file.
 // It is also exposed through the plugin settings page in editor.
 UCLASS(config = ZLCloudPluginSettings, meta = (DisplayName = "Settings"))
@@ -62,6 +82,50 @@ public:
 	UPROPERTY(config, EditAnywhere, Category = Performance)
 	int FramesPerSecond = 30;
 
+	/**
+	 * How the stream frame thread recovers when it falls behind FramesPerSecond. Only used when the stream framerate is decoupled from rendering.
+	 */
+	UPROPERTY(config, EditAnywhere, Category = Performance)
+	EZLFramePacingPolicy FramePacingPolicy = EZLFramePacingPolicy::Skip;
+
+	/**
+	 * With the CatchUp pacing policy, the most missed frames that will be caught up before falling back to skipping them.
+	 */
+	UPROPERTY(config, EditAnywhere, Category = Performance, meta = (ClampMin = "0"))
+	int MaxCatchUpFrames = 2;
+
+	/**
+	 * Simulcast layers to produce alongside the full resolution capture (seperated by a comma), each value is a downscale factor e.g. "2,4" for half and quarter resolution.
+	 * Layers are downscaled from each other in turn and are only produced while something is requesting them. The stream uses the smallest
+	 * layer that still covers the resolution the encoder asks for, e.g. a 1280x720 stream from a 2560x1440 capture with "2" set.
+	 */
+	UPROPERTY(config, EditAnywhere, Category = Performance)
+	FString SimulcastLayerScales = TEXT("");
+
+	/**
+	 * The most captured frames each video source will hold waiting for the encoder before the frame budget policy kicks in.
+	 */
+	UPROPERTY(config, EditAnywhere, Category = Performance, meta = (ClampMin = "1"))
+	int MaxInFlightFrames = 2;
+
+	/**
+	 * What happens to captured frames once MaxInFlightFrames are already waiting for the encoder.
+	 */
+	UPROPERTY(config, EditAnywhere, Category = Performance)
+	EZLFrameBudgetPolicy FrameBudgetPolicy = EZLFrameBudgetPolicy::DropOldest;
+
+	/**
+	 * With the BlockWithTimeout frame budget policy, the longest a captured frame is held waiting for space before it is dropped.
+	 */
+	UPROPERTY(config, EditAnywhere, Category = Performance, meta = (ClampMin = "0"))
+	int FrameBudgetBlockTimeoutMs = 5;
+
+	/**
+	 * Convert frames requested as I420 on the CPU rather than with a compute shader. The CPU conversion is always used where compute shaders aren't supported.
+	 */
+	UPROPERTY(config, EditAnywhere, Category = Performance)
+	bool bCPUYUVConversion = false;
+
 	/**
 	 * Delay app allowing stream adoption until after the 'Set App Ready to Stream' node is triggered in Game Mode blueprint. 
 	 * 
@@ -0,0 +1,91 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+* Streaming polyphase resampler operating on interleaved float audio.
+* Keeps enough history between calls that consecutive buffers resample seamlessly.
+*/
+class ZLCLOUDPLUGIN_API FZLAudioResampler
+{
+public:
+	FZLAudioResampler();
+
+	void Init(int32 InInputSampleRate, int32 InOutputSampleRate, int32 InNumChannels);
+	void Reset();
+
+	bool IsPassthrough() const { return UpFactor == DownFactor; }
+	int32 GetInputSampleRate() const { return InputSampleRate; }
+	int32 GetOutputSampleRate() const { return OutputSampleRate; }
+	int32 GetNumChannels() const { return NumChannels; }
+
+	// Resamples NumFrames interleaved frames and appends the result to OutAudio.
+	void Process(const float* InAudio, int32 NumFrames, TArray<float>& OutAudio);
+
+private:
+	void BuildFilter();
+
+	// Filter taps applied per output sample when upsampling. Downsampling scales this by the decimation ratio so the
+	// anti-aliasing filter keeps the same transition width relative to the output rate.
+	static constexpr int32 BaseTapsPerPhase = 16;
+	static constexpr int32 MaxTapsPerPhase = 128;
+
+	// Upper bound on the coefficient table, rates with a larger interpolation factor use the nearest phase.
+	static constexpr int32 MaxPhases = 512;
+
+	int32 InputSampleRate = 0;
+	int32 OutputSampleRate = 0;
+	int32 NumChannels = 0;
+
+	// Reduced resampling ratio, OutputSampleRate / InputSampleRate == UpFactor / DownFactor.
+	int32 UpFactor = 1;
+	int32 DownFactor = 1;
+	int32 NumPhases = 1;
+	int32 TapsPerPhase = BaseTapsPerPhase;
+
+	// Current position expressed as an input frame in History plus a sub-sample phase in units of 1/UpFactor.
+	int32 InputIndex = 0;
+	int32 Phase = 0;
+
+	// Coefficients laid out as [Phase][Tap], taps stored newest-sample-first.
+	TArray<float> Coefficients;
+
+	// Interleaved input frames that are still needed, including TapsPerPhase - 1 frames of history.
+	TArray<float> History;
+};
+
+/*
+* Converts incoming int16 WebRTC audio to the float format and layout expected by a sound generator.
+* Handles sample rate and channel count mismatches instead of dropping the audio.
+*/
+class ZLCLOUDPLUGIN_API FZLAudioFormatConverter
+{
+public:
+	void SetOutputFormat(int32 InSampleRate, int32 InNumChannels);
+
+	// Converts NumFrames interleaved int16 frames and appends the result to OutAudio.
+	void Convert(const int16_t* AudioData, int32 InSampleRate, int32 InNumChannels, int32 NumFrames, TArray<float>& OutAudio);
+
+	void Reset();
+
+	// Vectorised int16 -> float conversion, output is in the [-1, 1] range.
+	static void ConvertInt16ToFloat(const int16_t* InAudio, float* OutAudio, int32 NumSamples);
+
+	// Up/down mixes interleaved frames. Mono is copied to every channel, down mixes average the folded channels.
+	static void MixChannels(const float* InAudio, int32 InNumChannels, float* OutAudio, int32 OutNumChannels, int32 NumFrames);
+
+private:
+	// Incoming audio is converted in blocks of this many frames to keep the scratch buffers small.
+	static constexpr int32 BlockFrames = 256;
+
+	int32 OutputSampleRate = 0;
+	int32 OutputNumChannels = 0;
+
+	FZLAudioResampler Resampler;
+
+	TArray<float> ConvertScratch;
+	TArray<float> MixScratch;
+	TArray<float> ResampleScratch;
+};
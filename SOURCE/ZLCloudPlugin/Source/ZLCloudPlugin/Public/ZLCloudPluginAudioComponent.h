@@ -6,6 +6,7 @@
 #include "Components/SynthComponent.h"
 #include "IZLCloudPluginAudioConsumer.h"
 #include "IZLCloudPluginAudioSink.h"
+#include "ZLAudioFormatConverter.h"
 #include "Sound/SoundGenerator.h"
 #include "ZLCloudPluginAudioComponent.generated.h"
 
@@ -33,6 +34,7 @@ public:
 	// Optional. Can be overridden to end the sound when generating is finished.
 	virtual bool IsFinished() const { return false; };
 
+	// Converts incoming audio to this generator's sample rate and channel count and queues it for playback.
 	void AddAudio(const int16_t* AudioData, int InSampleRate, size_t NChannels, size_t NFrames);
 
 	int32 GetSampleRate() { return Params.SampleRate; }
@@ -43,9 +45,14 @@ public:
 
 private:
 	FSoundGeneratorInitParams Params;
-	TArray<int16_t> Buffer;
+	TArray<float> Buffer;
 	FCriticalSection CriticalSection;
 
+	// Only touched by the thread delivering WebRTC audio and when the output format changes.
+	FZLAudioFormatConverter Converter;
+	TArray<float> ConvertedAudio;
+	FCriticalSection ConverterCriticalSection;
+
 public:
 	FThreadSafeBool bGeneratingAudio = false;
 	FThreadSafeBool bShouldGenerateAudio = false;
@@ -51,6 +51,19 @@ public:
 	FRecieveDataNative OnRecieveDataNative;
 
 
+	/**
+	 * State Request Started - a request nobody passed to ProcessState has started (one that waited in the queue, or the connect state),
+	 * its values can be pulled like any other request's. It is also broadcast through OnRecieveData, where passing it to ProcessState succeeds without starting it again
+	 */
+	// BP Delegate
+	DECLARE_DYNAMIC_MULTICAST_DELEGATE(FStateRequestStarted);
+	UPROPERTY(BlueprintAssignable, Category = "Zerolight Omnistream Delegates")
+	FStateRequestStarted OnStateRequestStarted;
+	// C++ Delegate
+	DECLARE_MULTICAST_DELEGATE_OneParam(FStateRequestStartedNative, const TSharedPtr<FJsonObject>&);
+	FStateRequestStartedNative OnStateRequestStartedNative;
+
+
 	/**
 	 * On Content Generation Start 
 	 */
@@ -4,5 +4,8 @@
 
 #include "HAL/IConsoleManager.h"
 #include "Logging/LogMacros.h"
+#include "Stats/Stats.h"
 
-DECLARE_LOG_CATEGORY_EXTERN(LogZLCloudPlugin, Log, All);
\ No newline at end of file
+DECLARE_LOG_CATEGORY_EXTERN(LogZLCloudPlugin, Log, All);
+
+DECLARE_STATS_GROUP(TEXT("ZLCloudPlugin"), STATGROUP_ZLCloudPlugin, STATCAT_Advanced);
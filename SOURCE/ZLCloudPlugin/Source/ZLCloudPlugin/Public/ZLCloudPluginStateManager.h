@@ -7,6 +7,18 @@
 #include "IZLCloudPluginModule.h"
 #include "ZLCloudPluginModule.h"
 #include "ZLStateKeyInfo.h"
+#include "ZLStateJournal.h"
+#include "ZLStateKeyPath.h"
+#include "ZLStateKeyTrie.h"
+#include "ZLStateMemory.h"
+#include "ZLStateRecording.h"
+#include "ZLStateKeyMetrics.h"
+#include "ZLStateObservers.h"
+#include "ZLStateSchemaValidator.h"
+#include "ZLStateTree.h"
+#include "ZLStateWebSync.h"
+#include "ZLTimerWheel.h"
+#include "ZLTypedStateStore.h"
 #include "Containers/UnrealString.h"
 #include "Serialization/JsonSerializer.h"
 #include "Delegates/DelegateSignatureImpl.inl"
@@ -27,6 +39,26 @@
 
 ZLCLOUDPLUGIN_API TSharedPtr<FJsonObject> MergeJsonObjectsRecursive(const TSharedPtr<FJsonObject>& JsonObject1, const TSharedPtr<FJsonObject>& JsonObject2);
 
+//Structural equality used when merging arrays, strings and keys compare case insensitively like FString and object field order is ignored
+ZLCLOUDPLUGIN_API bool AreJsonValuesStructurallyEqual(const TSharedPtr<FJsonValue>& ValueA, const TSharedPtr<FJsonValue>& ValueB);
+//Canonical hash, always equal for values AreJsonValuesStructurallyEqual considers equal
+ZLCLOUDPLUGIN_API uint32 GetJsonValueStructuralHash(const TSharedPtr<FJsonValue>& Value);
+//Appends the items MergedArray doesn't already hold (duplicates within NewItems included), the array merge MergeJsonObjectsRecursive uses. Returns the number appended
+ZLCLOUDPLUGIN_API int32 AppendUniqueJsonArrayItems(TArray<TSharedPtr<FJsonValue>>& MergedArray, const TArray<TSharedPtr<FJsonValue>>& NewItems);
+ZLCLOUDPLUGIN_API bool CompareJsonValuesCaseSensitive(const TSharedPtr<FJsonValue>& OldJsonObject, const TSharedPtr<FJsonValue>& NewJsonObject);
+ZLCLOUDPLUGIN_API TSharedPtr<FJsonObject> CreateDiffJsonObject(const TSharedPtr<FJsonObject>& OldJsonObject, const TSharedPtr<FJsonObject>& NewJsonObject);
+
+//Diff against several states in one pass, a value is left out if it matches any of them (e.g. current and processing). Optionally counts the leaves in the result as it goes
+ZLCLOUDPLUGIN_API TSharedPtr<FJsonObject> CreateDiffJsonObject(TArrayView<const TSharedPtr<FJsonObject>> OldJsonObjects, const TSharedPtr<FJsonObject>& NewJsonObject, int32* OutLeafCount = nullptr);
+
+//Receives each value CreateDiffJsonObject would put in the diff without building it, Keys runs from the top level key down. Return false to stop the walk
+typedef TFunctionRef<bool(TArrayView<const FString* const> Keys, const TSharedPtr<FJsonValue>& NewValue)> FJsonDiffCallback;
+
+//Returns false if the callback stopped the walk early
+ZLCLOUDPLUGIN_API bool VisitJsonDiff(const TSharedPtr<FJsonObject>& OldJsonObject, const TSharedPtr<FJsonObject>& NewJsonObject, FJsonDiffCallback Callback);
+ZLCLOUDPLUGIN_API bool HasJsonDiff(const TSharedPtr<FJsonObject>& OldJsonObject, const TSharedPtr<FJsonObject>& NewJsonObject);
+ZLCLOUDPLUGIN_API int32 CountJsonDiffLeaves(const TSharedPtr<FJsonObject>& OldJsonObject, const TSharedPtr<FJsonObject>& NewJsonObject);
+
 
 UENUM(BlueprintType)
 enum class EStateDirtyReason : uint8
@@ -36,6 +68,59 @@ enum class EStateDirtyReason : uint8
 	state_notify_web //Internal state change which needs to be passed on to web
 };
 
+//A state request waiting for in-flight requests on the same keys, with any requests queued straight after it merged in
+struct FZLQueuedStateRequest
+{
+	TSharedPtr<FJsonObject> State;
+	bool bCompareCurrentState = false;
+	//One entry per earlier request merged into this one, in arrival order, true if nothing it set is left
+	TArray<bool> MergedRequestsSuperseded;
+	//State clock time ProcessState first saw this request, and each merged request alongside MergedRequestsSuperseded
+	double ArrivalTime = 0.0;
+	TArray<double> MergedArrivalTimes;
+};
+
+//Bookkeeping for one in-flight state request. Its values live in the shared requested/processing trees under the top level keys it owns
+struct FZLInFlightStateRequest
+{
+	FString RequestId;
+	TArray<FString> Keys; //Top level keys, no other in-flight request touches them
+	double StartTime = 0.0;
+
+	int32 RequestedLeafCount = 0; //Leaves in requested state after diff comparison to current, used for validating unknown/timed out fields
+	int32 ProcessingLeafCount = 0; //Number of leaves actually processed from request state
+	int32 FinishedLeaves = 0; //Number of leaves that have reached finished/current state
+
+	//Ids of the queued requests merged into this one, reported alongside its RequestId
+	TArray<FString> CoalescedRequestIds;
+	TArray<FString> SupersededRequestIds;
+
+	//When it and the requests merged into it reached ProcessState, StartTime is later if it had to wait in the queue
+	double ArrivalTime = 0.0;
+	TArray<double> MergedArrivalTimes;
+
+	//Deadlines on the state manager's timer wheel, the callbacks only raise the flags for Update to act on
+	FZLTimerWheel::FTimerId WarningTimer = FZLTimerWheel::InvalidTimer;
+	FZLTimerWheel::FTimerId TimeoutTimer = FZLTimerWheel::InvalidTimer;
+	bool bWarningDue = false;
+	bool bTimedOut = false;
+	bool bWarningRecorded = false; //Its unconfirmed keys have been counted in the key metrics for the first warning
+};
+
+//Reported as each state request ends, times are on the state manager's clock
+struct FZLStateRequestTiming
+{
+	FString RequestId;
+	FString Status; //complete, unmatched or timeout
+	double ArrivalTime = 0.0;
+	double StartTime = 0.0;
+	double EndTime = 0.0;
+	//Arrival times of the queued requests merged into it, which end along with it
+	TArray<double> MergedArrivalTimes;
+};
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnStateRequestEndedNative, const FZLStateRequestTiming&);
+
 UCLASS()
 class ZLCLOUDPLUGIN_API UZLCloudPluginStateManager : public UObject
 {
@@ -49,6 +134,9 @@ public:
 	void OnMoviePipelineFinishedNotifyZLScreenshot(FMoviePipelineOutputData Results);
 
 	void ProcessState(FString jsonString, bool doCurrentStateCompare, bool& Success);
+	//Starts (or queues) a request the plugin already has parsed rather than one the app hands to ProcessState. Once it starts it is
+	//broadcast through OnRecieveData as any other state request, where ProcessState on it succeeds, and through OnStateRequestStarted
+	void StartStateRequest(const TSharedPtr<FJsonObject>& requestedState, bool doCurrentStateCompare);
 
 	//State management
 	void ConfirmStateChange(FString FieldName, bool& Success);
@@ -58,6 +146,12 @@ public:
 	template <typename T> void GetCurrentStateValue(FString FieldName, T& data, bool& Success);
 	template <typename T> void SetCurrentStateValue(FString FieldName, T data, bool SubmitToProcessState);
 
+	//Batch versions of the above for many keys at once. Keys are sorted so ones sharing a parent resolve it once, keys below another key in the batch
+	//go along with it. Found keys are pulled into processing (current state with instantConfirm) and returned by their name in FieldNames
+	void GetRequestedStateValues(const TArray<FString>& FieldNames, bool instantConfirm, TMap<FString, TSharedPtr<FJsonValue>>& OutValues);
+	//Applies the values as one current state change with a single web push and debug UI refresh, returns how many differed from the current state
+	int32 SetCurrentStateValues(const TMap<FString, TSharedPtr<FJsonValue>>& Values);
+
 	void SetCurrentSchema(UStateKeyInfoAsset* Asset);
 	void AppendCurrentSchema(UStateKeyInfoAsset* Asset);
 	void RemoveFromCurrentSchema(UStateKeyInfoAsset* Asset);
@@ -69,8 +163,20 @@ public:
 	inline TSharedPtr<FJsonObject> GetRequestedState_JsonObject() { return JsonObject_out_requestedState; };
 
 	void MergeTrackedStateIntoCurrentState(const FString& FieldName, TSharedPtr<FJsonObject> JsonObject);
+	//A tracked state blueprint is known by name once it sends (MergeTrackedStateIntoCurrentState) or pulls its state. From then on
+	//OnTrackedStateUpdate only fires, once a frame from Update, when a request changes one of the known blueprints' keys
+	void TrackStateBlueprint(const FString& bluePrintName);
 
 	TArray<FString> CurrentStateCompareDiffs_Keys(TSharedPtr<FJsonObject> ComparisonJsonObject);
+	bool CurrentStateMatches(TSharedPtr<FJsonObject> ComparisonJsonObject);
+
+	//Structural hash of a current state value (the whole state for an empty key), equal values always hash equal. Cached per subtree until it changes
+	bool GetStateHash(const FZLStateKeyPath& KeyPath, uint64& OutHash) const;
+	bool GetStateHash(FString KeyPath, uint64& OutHash) const;
+
+	//Canonical fingerprint of the current state without the schema keys flagged bIgnoredInDataHashes, independent of key order
+	uint64 GetStateFingerprint() const { return CurrentStateTree.GetFingerprint(); }
+	FString GetStateFingerprintString() const { return FString::Printf(TEXT("%016llx"), GetStateFingerprint()); }
 	TSharedPtr<FJsonObject> CurrentStateCompareDiffs(TSharedPtr<FJsonObject> ComparisonJsonObject);
 
 	void SetNotifyServerState(TSharedPtr<FJsonObject> ComparisonStateRequest);
@@ -82,14 +188,21 @@ public:
 	//State websocket tick updates
 	void SetStateDirty(EStateDirtyReason reason);
 	void PushStateEventsToWeb();
-	void SendFJsonObjectToWeb(TSharedPtr<FJsonObject> JsonObject);
+	//Returns the number of characters sent, 0 if there was no module to send through
+	int32 SendFJsonObjectToWeb(TSharedPtr<FJsonObject> JsonObject);
 
 	void ResetKnowWebState()
 	{
 		JsonObject_web_currentState.Reset();
 		JsonObject_web_currentState = MakeShareable(new FJsonObject);
+		m_webStateHashValid = false;
+		WebStateSync.Reset();
 	}
 
+	//Full snapshot/merge patch bookkeeping for state_processing_ended pushes
+	const FZLStateWebSync& GetWebStateSync() const { return WebStateSync; }
+	FZLStateWebSync& GetWebStateSync() { return WebStateSync; }
+
 	bool HasDefaultInitialState()
 	{
 		return JsonString_DefaultInitialState != "";
@@ -110,6 +223,8 @@ public:
 	void SetDefaultInitialState(FString initialStateJSONString, bool triggerStateSet)
 	{
 		JsonString_DefaultInitialState = initialStateJSONString;
+		JsonObject_DefaultInitialState.Reset();
+		m_defaultInitialStateParsed = false;
 
 		if (triggerStateSet)
 		{
@@ -127,13 +242,61 @@ public:
 	}
 
 	FString MergeDefaultInitialState(FString overrideInitialStateJSONString);
+	//Streams the override straight into a copy of the default initial state (or an empty object without one) and returns
+	//the merged object. False if the override is malformed, or empty with no usable default
+	bool MergeDefaultInitialState(FStringView overrideInitialStateJSON, TSharedPtr<FJsonObject>& outInitialState, FString* outError = nullptr);
 
 	void Update(LauncherComms* launcherComms);
 
 	void ResetCurrentAppState(FString jsonString);
 	void ResetCurrentAppState(TSharedPtr<FJsonObject> jsonObj);
+
+	//Saves the current state to a binary snapshot and change journal in directory (Saved/ZLStateJournal if empty), written off the game thread.
+	//With restorePreviousSession the session last saved there is replayed through OnRecieveData first, like SETINITIALSTATE, so the app
+	//applies it and confirms it back into the current state. Returns true if a session was restored
+	bool StartStateJournal(const FString& directory, bool restorePreviousSession);
+	void StopStateJournal();
+	bool IsStateJournalActive() const { return StateJournal.IsValid(); }
 	TSharedPtr<FJsonObject> GetCurrentAppState() { return JsonObject_currentState; };
 	bool IsProcessingStateRequest();
+	int32 GetNumInFlightStateRequests() const { return m_inFlightRequests.Num(); }
+
+	//Clock for request deadlines, FApp::GetCurrentTime unless overridden (e.g. a fake clock for deterministic tests). Pass nullptr to restore
+	void SetStateClock(TFunction<double()> clock);
+	double GetStateTime() const { return m_stateClock ? m_stateClock() : FApp::GetCurrentTime(); }
+
+	//Receives messages for the web instead of the stream, and requests the plugin starts itself instead of OnStateRequestStarted/OnRecieveData. Pass nullptr to restore
+	void SetWebMessageHandler(TFunction<void(const FString&)> handler) { m_webMessageHandler = MoveTemp(handler); }
+	void SetStateRequestHandler(TFunction<void(const TSharedPtr<FJsonObject>&)> handler) { m_stateRequestHandler = MoveTemp(handler); }
+
+	FOnStateRequestEndedNative OnStateRequestEnded;
+
+	//Calls callback once a frame with the changed paths at, above or below path (the whole state if empty), rather than waking
+	//every handler for every request. Requested changes are what state requests want applied, Current what has been confirmed
+	FZLStateObservers::FObserverId ObserveState(const FString& path, EZLStateObserverSource source, FZLOnStatePathsChanged callback);
+	void RemoveStateObserver(FZLStateObservers::FObserverId id) { StateObservers.Unsubscribe(id); }
+
+	//Current state keys (non object values) by parent, prefix or wildcard pattern, see FZLStateKeyQuery. Walks the current state tree's
+	//nodes, so only the levels the query names and the results are visited. The active schema's keys are on GetCurrentSchemaAsset()->GetKeyTrie()
+	void GetStateSubKeys(const FString& parentKey, bool includeParents, TArray<FString>& outKeys) const;
+	void FindStateKeysByPrefix(const FString& prefix, TArray<FString>& outKeys, int32 maxResults = MAX_int32) const;
+	void FindStateKeys(const FString& pattern, TArray<FString>& outKeys, int32 maxResults = MAX_int32) const;
+
+	//Per key time to confirm with warning and timeout counts, for GETSTATEKEYMETRICS and ZLCloudPlugin.State.KeyMetrics
+	const FZLStateKeyMetrics& GetStateKeyMetrics() const { return StateKeyMetrics; }
+	void ResetStateKeyMetrics() { StateKeyMetrics.Reset(); }
+	//Key metrics with the warning and timeout times they were counted against, as the GETSTATEKEYMETRICS reply
+	FString GetStateKeyMetricsString(int32 maxKeys) const;
+
+	//Estimated memory held by each state JSON tree, anything trees share is counted under the first of them in EZLStateMemoryTree order.
+	//Walks every tree, published to stat ZLCloudPlugin once a second from Update while stats are being collected
+	void GetStateMemoryReport(FZLStateMemoryReport& outReport) const;
+
+	//Records inbound state requests, confirmations and the resulting current state changes to fileName (Saved/ZLStateRecordings if relative)
+	//for ZLCloudPlugin.State.Replay. Returns false if the file couldn't be opened
+	bool StartStateRecording(const FString& fileName);
+	void StopStateRecording();
+	bool IsStateRecording() const { return StateRecorder.IsValid(); }
 	void PopStateRequestQueue();
 	void ClearProcessingState();
 
@@ -176,6 +339,12 @@ public:
 	 */
 	static UZLCloudPluginStateManager* CreateInstance();
 
+	/**
+	 * Create a manager outside the singleton with a copy of schema's keys, for headless replays.
+	 * Set its web message and state request handlers before use, otherwise it talks to the live stream and app.
+	 */
+	static UZLCloudPluginStateManager* CreateDetachedInstance(const UStateKeyInfoAsset* schema);
+
 	static UZLCloudPluginStateManager* GetZLCloudPluginStateManager()
 	{
 		if (Singleton == nullptr)
@@ -194,17 +363,20 @@ public:
 		JsonObject_web_currentState = MakeShareable(new FJsonObject);
 		JsonObject_serverNotifyState = MakeShareable(new FJsonObject);
 		JsonObject_serverNotifyUnmatchedState = MakeShareable(new FJsonObject);
+		CurrentStateTree.Reset(JsonObject_currentState);
+		m_stateTimers.Reset(GetStateTime());
 		request_recieved_id = 0;
 	}
 
 
 	int m_stateRequestWarningTime = 10;
 	int m_stateRequestTimeout = 30;
-	double m_lastStateWarningPrintTime;
 	
 
 	//Debug stats
 	int request_recieved_id;
+	int request_coalesced_count = 0; //Queued requests merged into a later one, some of their values still applied
+	int request_superseded_count = 0; //Queued requests merged into a later one that overrode all of their values
 
 	UPROPERTY()
 	UZLDebugUIWidget* DebugUIWidget = nullptr;
@@ -217,6 +389,7 @@ private:
 	UStateKeyInfoAsset* ActiveSchema = nullptr;
 
 	bool m_StreamConnected = false;
+	bool m_detached = false; //Made by CreateDetachedInstance, has no debug UI
 	bool m_needServerNotify = false;
 	bool m_stateDirty = false;
 	EStateDirtyReason m_stateDirtyReason;
@@ -229,20 +402,105 @@ private:
 	TSharedPtr<FJsonObject> JsonObject_out_requestedState;//Filtered state (won't contain stuff thats already set)
 
 	FString JsonString_DefaultInitialState = FString("");
-	TQueue<FString> JsonString_in_requestQueue;
-	int32 s_requestQueueLength = 0;
-
-
-	double JsonObject_processingStateStartTime; //Timestamp of last processing request (used for timeout + delay warnings)
-	int32 JsonObject_requestedStateLeafCount; //Leaves in requested state after diff comparison to current, used for validating unknown/timed out fields
-	int32 JsonObject_processingStateLeafCount; //Number of leaves actually processed from request state
-	int32 JsonObject_processingStateFinishedLeaves; //Number of leaves that have reached finished/current state
+	//Parsed on first use and kept until the default is next set, null while it is unparsed or malformed
+	TSharedPtr<FJsonObject> JsonObject_DefaultInitialState;
+	bool m_defaultInitialStateParsed = false;
+	const TSharedPtr<FJsonObject>& GetDefaultInitialStateObject();
+
+	TArray<FZLQueuedStateRequest> m_stateRequestQueue;
+	//Set while a request the plugin started is broadcast through OnRecieveData, so ProcessState doesn't start it a second time
+	bool m_announcingStateRequest = false;
+
+	//Requests run side by side as long as their top level keys don't overlap, anything touching an owned key waits in the queue
+	TArray<TUniquePtr<FZLInFlightStateRequest>> m_inFlightRequests;
+	TMap<FString, FZLInFlightStateRequest*> m_requestKeyOwners;
+
+	//Request (and server notify) warning/timeout deadlines, advanced once per Update
+	FZLTimerWheel m_stateTimers;
+	TFunction<double()> m_stateClock;
+	TFunction<void(const FString&)> m_webMessageHandler;
+	TFunction<void(const TSharedPtr<FJsonObject>&)> m_stateRequestHandler;
+
+	void ProcessRequestedState(const TSharedPtr<FJsonObject>& JsonObject_requestedState, bool doCurrentStateCompare, bool& Success);
+	void NotifyStateRequestStarted(const TSharedPtr<FJsonObject>& requestedState);
+	void WakeTrackedStateBlueprints();
+	void BroadcastTrackedStateUpdate();
+	void OnTrackedStateRequested(const TArray<FZLStateKeyPath>& paths);
+	void QueueStateRequest(TSharedPtr<FJsonObject> requestedState, bool doCurrentStateCompare);
+	//Returns false without touching anything if the request has to wait for keys another request owns
+	bool TryStartStateRequest(const FZLQueuedStateRequest& request, bool& Success);
+	void StartQueuedStateRequests();
+	bool CanStartQueuedStateRequest(const FZLQueuedStateRequest& request) const;
+	bool OverlapsQueuedStateRequests(const TSharedPtr<FJsonObject>& requestedState, int32 queueEnd) const;
+	FZLInFlightStateRequest* FindStateRequestForKey(const FString& FieldName);
+	bool HasKeysInProcessing(const FZLInFlightStateRequest& request) const;
+	TSharedPtr<FJsonObject> ExtractStateRequestKeys(const TSharedPtr<FJsonObject>& JsonObject, const FZLInFlightStateRequest& request) const;
+	void ScheduleStateRequestDeadlines(FZLInFlightStateRequest& request);
+	void ScheduleServerNotifyDeadlines();
+	void UpdateStateRequest(FZLInFlightStateRequest& request, bool& finished);
+	void FinishStateRequest(FZLInFlightStateRequest& request);
+	//Counts each leaf of unconfirmedState as a warning or timeout in the key metrics
+	void RecordUnconfirmedKeyMetrics(TSharedPtr<FJsonObject> unconfirmedState, bool timedOut);
+	//state_processing_ended for the request, or an internal update if null
+	void SendStateRequestEndedToWeb(const FZLInFlightStateRequest* request, const FString& status, TSharedPtr<FJsonObject> timeoutState = nullptr, TSharedPtr<FJsonObject> unprocessedState = nullptr);
+	void AddMergedRequestIds(const FZLInFlightStateRequest& request, TSharedPtr<FJsonObject> jsonForWebObject);
+
+	FZLTimerWheel::FTimerId m_serverNotifyWarningTimer = FZLTimerWheel::InvalidTimer;
+	FZLTimerWheel::FTimerId m_serverNotifyTimeoutTimer = FZLTimerWheel::InvalidTimer;
+	bool m_serverNotifyWarningDue = false;
+	bool m_serverNotifyTimedOut = false;
 
 	const FString s_requestIdStr = "RequestId";
 
 	TSharedPtr<FJsonObject> JsonObject_serverNotifyState; //A comparison object used for specific blocking server requests (onConnect, resetState)
 	TSharedPtr<FJsonObject> JsonObject_serverNotifyUnmatchedState;
 
+	//Resolved key paths for the trees blueprints poll, must be invalidated whenever objects are added/removed outside the nested key helpers
+	FZLStateKeyPathCache CurrentStateKeyCache;
+	FZLStateKeyPathCache ProcessingStateKeyCache;
+	FZLStateKeyPathCache RequestedStateKeyCache;
+	void InvalidateKeyPathCaches();
+
+	//Version/leaf bookkeeping for the current state, every write to JsonObject_currentState must be followed by MarkCurrentStateChanged (or ResetCurrentStateTree if the root is replaced)
+	FZLStateTree CurrentStateTree;
+	void MarkCurrentStateChanged(const FZLStateKeyPath& path);
+	void ResetCurrentStateTree();
+	FZLStateMatchTracker ServerNotifyMatch;
+
+	//Current state hash at the last web push, an unchanged hash means there is nothing to diff
+	uint64 m_webStateHash = 0;
+	bool m_webStateHashValid = false;
+
+	//Decides between full current_state and merge patches in state_processing_ended pushes, deltas are opt in per page
+	FZLStateWebSync WebStateSync;
+
+	//Platform time the state memory stats were last published
+	double m_lastMemoryStatsTime = 0.0;
+
+	//Typed slots for the active schema's keys in the current state, synced from CurrentStateTree on read
+	FZLTypedStateStore TypedCurrentState;
+
+	//Active schema compiled for checking incoming state requests, violations are logged rather than rejected
+	FZLStateSchemaValidator SchemaValidator;
+
+	//Snapshot and journal of the current state while StartStateJournal is active
+	TUniquePtr<FZLStateJournal> StateJournal;
+	//Inbound requests and current state changes while StartStateRecording is active
+	TUniquePtr<FZLStateRecorder> StateRecorder;
+	//Time to confirm per key, from the request reaching the app
+	FZLStateKeyMetrics StateKeyMetrics;
+	//Key path subscriptions to requested and current state changes, dispatched from Update
+	FZLStateObservers StateObservers;
+	//Requested state observers on each known tracked state blueprint's key, set m_trackedStateRequested for Update to broadcast OnTrackedStateUpdate
+	TMap<FString, FZLStateObservers::FObserverId> m_trackedStateObservers;
+	bool m_trackedStateRequested = false;
+
+	//Requested and processing values not confirmed into the current state yet, saved alongside it so a restored session requests them again
+	TSharedPtr<FJsonObject> GetUnconfirmedState() const;
+
+	//Rebuilds what is derived from ActiveSchema->KeyInfos (fingerprint exclusions, typed store, validator), must follow any change to it
+	void OnActiveSchemaKeysChanged();
+
 	bool m_debugUIVisible = false;
 	bool m_showDebugUIInEditorTab = false;
 	UStateKeyInfoAsset* m_lastSetSchema = nullptr; // Track last schema to avoid unnecessary SetTargetSchema calls
@@ -293,6 +551,28 @@ struct ZLCLOUDPLUGIN_API FSubKeyValueResult
 	EStateKeyDataType Type;
 };
 
+//State values by key for the batch get/set nodes, arrays and objects are carried as JSON text
+USTRUCT(BlueprintType)
+struct ZLCLOUDPLUGIN_API FZLStateValues
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadWrite, Category = "ZLStateValues")
+	TMap<FString, FString> Strings;
+
+	UPROPERTY(BlueprintReadWrite, Category = "ZLStateValues")
+	TMap<FString, double> Numbers;
+
+	UPROPERTY(BlueprintReadWrite, Category = "ZLStateValues")
+	TMap<FString, bool> Bools;
+
+	UPROPERTY(BlueprintReadWrite, Category = "ZLStateValues")
+	TMap<FString, FString> Json;
+
+	void Add(const FString& Key, const TSharedPtr<FJsonValue>& Value);
+	void ToJsonValues(TMap<FString, TSharedPtr<FJsonValue>>& OutValues) const;
+};
+
 UCLASS()
 class ZLCLOUDPLUGIN_API UZLCloudPluginStateManagerBlueprints : public UBlueprintFunctionLibrary
 {
@@ -483,6 +763,38 @@ public:
 		UZLCloudPluginStateManager::GetZLCloudPluginStateManager()->GetRequestedStateValue<TArray<float>>(FieldName, instantConfirm, Array, Success);
 	}
 
+	/**
+	 * Pulls many keys from the requested state at once, cheaper than a node per key as keys sharing a parent only look it up once.
+	 * @param FieldNames - . delimited keys to look for, keys missing from the requested state are left out of Values
+	 * @param instantConfirm - Update state right away, if set to false call ConfirmStateChange for each key once your processing is done
+	 * @param Values - The values found, by key
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Zerolight Omnistream State")
+	static void GetRequestedStateValues(TArray<FString> FieldNames, bool instantConfirm, FZLStateValues& Values)
+	{
+		TMap<FString, TSharedPtr<FJsonValue>> JsonValues;
+		UZLCloudPluginStateManager::GetZLCloudPluginStateManager()->GetRequestedStateValues(FieldNames, instantConfirm, JsonValues);
+
+		Values = FZLStateValues();
+		for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : JsonValues)
+		{
+			Values.Add(Pair.Key, Pair.Value);
+		}
+	}
+
+	/**
+	 * Sets many current state values as one change, sent to the web and debug UI once rather than once per key.
+	 * @param Values - The values to set by . delimited key, Json entries are parsed as JSON
+	 * @return The number of values that differed from the current state
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Zerolight Omnistream State")
+	static int32 SetCurrentStateValues(const FZLStateValues& Values)
+	{
+		TMap<FString, TSharedPtr<FJsonValue>> JsonValues;
+		Values.ToJsonValues(JsonValues);
+		return UZLCloudPluginStateManager::GetZLCloudPluginStateManager()->SetCurrentStateValues(JsonValues);
+	}
+
 
 	/**
 	 * Helper function to extract a string field from a JSON descriptor of a
@@ -497,6 +809,36 @@ public:
 		UZLCloudPluginStateManager::GetZLCloudPluginStateManager()->GetCurrentStateValue_String(FieldName, StringValue, Success);
 	}
 
+	/**
+	 * Find the keys set in the current state that match a pattern.
+	 * @param Pattern - . delimited key where a segment can use * and ?, and ** spans any number of segments, e.g. "Trim.*.Colour" or "Trim.**"
+	 * @param MaxResults - Stop after this many keys, 0 for no limit
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Zerolight Omnistream State")
+	static TArray<FString> FindCurrentStateKeys(FString Pattern, int32 MaxResults = 0)
+	{
+		TArray<FString> Keys;
+		UZLCloudPluginStateManager::GetZLCloudPluginStateManager()->FindStateKeys(Pattern, Keys, MaxResults > 0 ? MaxResults : MAX_int32);
+		return Keys;
+	}
+
+	/**
+	 * Find the keys in a schema that match a pattern.
+	 * @param Asset - The schema to search
+	 * @param Pattern - . delimited key where a segment can use * and ?, and ** spans any number of segments, e.g. "Trim.*.Colour" or "Trim.**"
+	 * @param MaxResults - Stop after this many keys, 0 for no limit
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Zerolight Omnistream State")
+	static TArray<FString> FindSchemaKeys(UStateKeyInfoAsset* Asset, FString Pattern, int32 MaxResults = 0)
+	{
+		TArray<FString> Keys;
+		if (Asset)
+		{
+			Asset->GetKeyTrie().FindMatching(Pattern, Keys, MaxResults > 0 ? MaxResults : MAX_int32);
+		}
+		return Keys;
+	}
+
 	/**
 	 * Get a json that defines the current state of the application
 	 * @param jsonString - Json string containing all data used to set the current state.
@@ -507,6 +849,30 @@ public:
 		UZLCloudPluginStateManager::GetZLCloudPluginStateManager()->GetCurrentState(jsonString);
 	}
 
+	/**
+	 * Get a hash of a value in the current state, equal values always give equal hashes so they can be compared without reading them.
+	 * Hashes are cached until the value changes.
+	 * @param KeyPath - . delimited key of the value, empty for the whole state
+	 * @param Success - True if the key exists in the current state
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Zerolight Omnistream State")
+	static int64 GetStateHash(FString KeyPath, bool& Success)
+	{
+		uint64 Hash = 0;
+		Success = UZLCloudPluginStateManager::GetZLCloudPluginStateManager()->GetStateHash(KeyPath, Hash);
+		return static_cast<int64>(Hash);
+	}
+
+	/**
+	 * Get a fingerprint of the current state as a 16 character hex string, for caching or deduplicating on state.
+	 * Keys flagged as ignored in data hashes in the schema are left out, and the order keys were set in doesn't matter.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Zerolight Omnistream State")
+	static FString GetStateFingerprint()
+	{
+		return UZLCloudPluginStateManager::GetZLCloudPluginStateManager()->GetStateFingerprintString();
+	}
+
 
 	/**
 	 * Save a json that defines the current state of the application
@@ -563,6 +929,66 @@ public:
 		return UZLCloudPluginStateManager::GetZLCloudPluginStateManager()->request_recieved_id;
 	}
 
+	/**
+	 * Get how many queued state requests were merged into a later request while waiting
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Zerolight Omnistream State")
+	static int GetCoalescedStateRequestCount()
+	{
+		return UZLCloudPluginStateManager::GetZLCloudPluginStateManager()->request_coalesced_count;
+	}
+
+	/**
+	 * Get how many queued state requests were dropped because a later request overrode everything they set
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Zerolight Omnistream State")
+	static int GetSupersededStateRequestCount()
+	{
+		return UZLCloudPluginStateManager::GetZLCloudPluginStateManager()->request_superseded_count;
+	}
+
+	/**
+	 * Start saving the current state to a binary snapshot and change journal, so a restarted instance can restore it.
+	 * Call after setting the schema, a session saved against a different schema isn't restored.
+	 * @param Directory Where the snapshot and journal are kept, Saved/ZLStateJournal if empty
+	 * @param RestorePreviousSession Replay the session last saved in Directory as a state request before journaling starts
+	 * @return True if a previous session was restored
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Zerolight Omnistream State")
+	static bool StartStateJournal(FString Directory, bool RestorePreviousSession = true)
+	{
+		return UZLCloudPluginStateManager::GetZLCloudPluginStateManager()->StartStateJournal(Directory, RestorePreviousSession);
+	}
+
+	/**
+	 * Flush and stop the state journal
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Zerolight Omnistream State")
+	static void StopStateJournal()
+	{
+		UZLCloudPluginStateManager::GetZLCloudPluginStateManager()->StopStateJournal();
+	}
+
+	/**
+	 * Start recording state requests and the state changes they cause, for replaying the session later as a load test
+	 * @param FileName Recording to write, relative paths are under Saved/ZLStateRecordings
+	 * @return True if recording started
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Zerolight Omnistream State Debug")
+	static bool StartStateRecording(FString FileName)
+	{
+		return UZLCloudPluginStateManager::GetZLCloudPluginStateManager()->StartStateRecording(FileName);
+	}
+
+	/**
+	 * Finish the state recording
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Zerolight Omnistream State Debug")
+	static void StopStateRecording()
+	{
+		UZLCloudPluginStateManager::GetZLCloudPluginStateManager()->StopStateRecording();
+	}
+
 	/**
 	 * Set App Ready to Stream
 	 */
@@ -863,54 +1289,51 @@ public:
 		}
 		UZLCloudPluginStateManager* StateManager = UZLCloudPluginStateManager::GetZLCloudPluginStateManager();
 
-		// Loop through all keys in the asset
-		for (const TPair<FString, FStateKeyInfo>& Pair : Asset->KeyInfos)
+		// Only the direct children of the parent, from the schema's key trie rather than string matching every key
+		TArray<FString> ChildKeys;
+		Asset->GetKeyTrie().GetChildren(ParentKey, false, ChildKeys);
+
+		for (const FString& FullKey : ChildKeys)
 		{
-			const FString& FullKey = Pair.Key;
+			const FStateKeyInfo* KeyInfo = Asset->KeyInfos.Find(FullKey);
+			if (!KeyInfo)
+				continue;
 
-			// Check if key starts with the desired parent path and is a direct child (one level deeper)
-			if (FullKey.StartsWith(ParentKey + "."))
-			{
-				FString SubPath = FullKey.RightChop(ParentKey.Len() + 1);
-				if (!SubPath.Contains("."))
-				{
-					FSubKeyValueResult Result;
-					Result.Key = FullKey;
-					Result.Type = Pair.Value.GetDataTypeEnum();
-					bool EntrySuccess = false;
+			FSubKeyValueResult Result;
+			Result.Key = FullKey;
+			Result.Type = KeyInfo->GetDataTypeEnum();
+			bool EntrySuccess = false;
 
-					switch (Result.Type)
-					{
-					case EStateKeyDataType::String:
-						StateManager->GetRequestedStateValue<FString>(FullKey, InstantConfirm, Result.StringValue, EntrySuccess);
-						break;
-					case EStateKeyDataType::StringArray:
-						StateManager->GetRequestedStateValue<TArray<FString>>(FullKey, InstantConfirm, Result.StringArray, EntrySuccess);
-						break;
-					case EStateKeyDataType::Number:
-						StateManager->GetRequestedStateValue<float>(FullKey, InstantConfirm, Result.NumberValue, EntrySuccess);
-						break;
-					case EStateKeyDataType::NumberArray:
-						StateManager->GetRequestedStateValue<TArray<float>>(FullKey, InstantConfirm, Result.NumberArray, EntrySuccess);
-						break;
-					case EStateKeyDataType::Bool:
-						StateManager->GetRequestedStateValue<bool>(FullKey, InstantConfirm, Result.BoolValue, EntrySuccess);
-						break;
-					case EStateKeyDataType::BoolArray:
-						StateManager->GetRequestedStateValue<TArray<bool>>(FullKey, InstantConfirm, Result.BoolArray, EntrySuccess);
-						break;
-					default:
-						UE_LOG(LogZLCloudPlugin, Warning, TEXT("Unsupported type for key %s"), *FullKey);
-						Success = false;
-						continue;
-					}
+			switch (Result.Type)
+			{
+			case EStateKeyDataType::String:
+				StateManager->GetRequestedStateValue<FString>(FullKey, InstantConfirm, Result.StringValue, EntrySuccess);
+				break;
+			case EStateKeyDataType::StringArray:
+				StateManager->GetRequestedStateValue<TArray<FString>>(FullKey, InstantConfirm, Result.StringArray, EntrySuccess);
+				break;
+			case EStateKeyDataType::Number:
+				StateManager->GetRequestedStateValue<float>(FullKey, InstantConfirm, Result.NumberValue, EntrySuccess);
+				break;
+			case EStateKeyDataType::NumberArray:
+				StateManager->GetRequestedStateValue<TArray<float>>(FullKey, InstantConfirm, Result.NumberArray, EntrySuccess);
+				break;
+			case EStateKeyDataType::Bool:
+				StateManager->GetRequestedStateValue<bool>(FullKey, InstantConfirm, Result.BoolValue, EntrySuccess);
+				break;
+			case EStateKeyDataType::BoolArray:
+				StateManager->GetRequestedStateValue<TArray<bool>>(FullKey, InstantConfirm, Result.BoolArray, EntrySuccess);
+				break;
+			default:
+				UE_LOG(LogZLCloudPlugin, Warning, TEXT("Unsupported type for key %s"), *FullKey);
+				Success = false;
+				continue;
+			}
 
-					if (EntrySuccess)
-					{
-						AnySuccess = true;
-						Results.Add(Result);
-					}
-				}
+			if (EntrySuccess)
+			{
+				AnySuccess = true;
+				Results.Add(Result);
 			}
 		}
 
@@ -9,6 +9,8 @@
 #include "IPixelCaptureCapturerSource.h"
 #include "PixelCaptureCapturerMultiFormat.h"
 #include "Delegates/IDelegateInstance.h"
+#include "HAL/ThreadSafeCounter64.h"
+#include "RHIResources.h"
 
 /**
  * The input of the ZLCloudStream system. Frames enter the system when OnFrame is called.
@@ -40,6 +42,43 @@ public:
 	TSharedPtr<IPixelCaptureOutputFrame> RequestFormat(int32 Format, int32 LayerIndex = -1);
 #endif
 
+	/**
+	 * Simulcast: extra layers downscaled from the same captured frame, each entry is the downscale factor relative to the full capture (e.g. 2 = half resolution).
+	 * Layer 0 is always the full resolution capture, simulcast layers start at index 1 in the order given after sorting.
+	 */
+	void SetSimulcastLayers(const TArray<float>& InLayerScaleDowns);
+	int32 GetNumLayers() const;
+
+	/**
+	 * Requests the latest frame of a specific layer. Layers that haven't been requested recently are not produced,
+	 * so the first request for an idle layer returns nullptr and wakes it up.
+	 */
+	TSharedPtr<IPixelCaptureOutputFrame> RequestLayerFormat(int32 Format, int32 LayerIndex);
+
+	/**
+	 * The smallest layer that still covers TargetResolution, so scaling it to the target never upscales.
+	 * Returns 0, the full capture, when no simulcast layer is large enough or nothing has been captured yet.
+	 */
+	int32 FindLayerForResolution(FIntPoint TargetResolution) const;
+
+	// Resolution of a layer downscaled by ScaleDown from a capture of CaptureResolution
+	static FIntPoint GetLayerResolution(FIntPoint CaptureResolution, float ScaleDown);
+
+	// FindLayerForResolution over layers with the given (sorted) downscale factors
+	static int32 SelectLayerForResolution(FIntPoint CaptureResolution, const TArray<float>& LayerScaleDowns, FIntPoint TargetResolution);
+
+	struct FSimulcastLayerStats
+	{
+		FIntPoint Resolution = FIntPoint::ZeroValue;
+		uint64 NumProduced = 0;
+		uint64 NumSkipped = 0;
+	};
+
+	// Returns false if LayerIndex isn't a simulcast layer
+	bool GetSimulcastLayerStats(int32 LayerIndex, FSimulcastLayerStats& OutStats) const;
+
+	void DumpSimulcastStats(FOutputDevice& Ar) const;
+
 	/**
 	 * This is broadcast each time a frame exits the adapt process. Used to synchronize framerates with input rates.
 	 * This should be called once per frame taking into consideration all the target formats and layers within the frame.
@@ -58,6 +97,35 @@ private:
 
 	void CreateFrameCapturer();
 	void OnCaptureComplete();
+
+	struct FSimulcastLayer
+	{
+		float ScaleDown = 1.0f;
+		FIntPoint Resolution = FIntPoint::ZeroValue;
+
+		// Downscaled copies of the capture, cycled so the capturer can still be reading the previous one
+		TArray<FTextureRHIRef> TexturePool;
+		int32 NextTexture = 0;
+
+		// Intermediate sizes when this layer is more than half the size of the one it is downscaled from
+		TArray<FTextureRHIRef> ScratchTextures;
+
+		TSharedPtr<FPixelCaptureCapturerMultiFormat> Capturer;
+		FThreadSafeCounter64 LastRequestCycles;
+
+		// Cost accounting
+		uint64 NumProduced = 0;
+		uint64 NumSkipped = 0;
+		uint64 TotalCaptureCycles = 0;
+	};
+
+	// Downscales the captured frame through each consumed layer in turn, each layer reading from the one above it.
+	void CaptureSimulcastLayers(const IPixelCaptureInputFrame& InputFrame);
+	int32 GetDeepestConsumedLayer() const;
+
+	TArray<TSharedPtr<FSimulcastLayer>> SimulcastLayers;
+	mutable FCriticalSection SimulcastCriticalSection;
+	bool bLoggedUnsupportedSimulcastInput = false;
 };
 
 #endif
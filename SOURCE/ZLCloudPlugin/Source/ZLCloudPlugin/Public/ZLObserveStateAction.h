@@ -0,0 +1,42 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/CancellableAsyncAction.h"
+#include "ZLStateObservers.h"
+#include "ZLObserveStateAction.generated.h"
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FZLObservedStateChanged, const TArray<FString>&, ChangedKeys);
+
+UCLASS()
+class ZLCLOUDPLUGIN_API UZLObserveStateAction : public UCancellableAsyncAction
+{
+	GENERATED_BODY()
+
+public:
+	/**
+	 * Fires at most once a frame while state at, above or below KeyPath changes, until cancelled.
+	 * Use instead of handling every request on OnRecieveData and querying keys that usually haven't changed.
+	 * Tracked state blueprints are woken through OnTrackedStateUpdate the same way, by observers on their own keys.
+	 *
+	 * @param KeyPath				"." delimited key to observe, e.g. "Trim" also sees "Trim.Paint". Empty observes the whole state
+	 * @param bRequestedChanges	True for values state requests want applied (pull them with GetRequestedStateValue), false for values confirmed into the current state
+	 */
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject"), Category = "Zerolight Omnistream State")
+	static UZLObserveStateAction* ObserveStateChanges(UObject* WorldContextObject, FString KeyPath, bool bRequestedChanges = true);
+
+	// The changed keys, empty for the whole state when it was replaced
+	UPROPERTY(BlueprintAssignable)
+	FZLObservedStateChanged OnChanged;
+
+	virtual void Activate() override;
+	virtual void SetReadyToDestroy() override;
+	virtual bool IsActive() const override;
+
+private:
+	void HandleChanged(const TArray<FZLStateKeyPath>& Paths);
+
+	FString KeyPath;
+	bool bRequestedChanges = true;
+	FZLStateObservers::FObserverId ObserverId = FZLStateObservers::InvalidObserver;
+};
@@ -0,0 +1,178 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Dom/JsonObject.h"
+#include "Containers/Queue.h"
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "ZLStateKeyInfo.h"
+#include "ZLStateKeyPath.h"
+
+class FEvent;
+class FRunnableThread;
+class IFileHandle;
+
+/*
+* Compact binary form of JSON state values, used by the state snapshot and journal.
+* Values are a type tag followed by their payload: integral numbers as zigzag varints, other numbers as doubles,
+* strings as UTF-8 with a varint length. Object keys are only spelled out the first time a writer sees them, after
+* that they are a varint index into the keys seen so far, so repeated keys in a large tree cost a byte or two each.
+*/
+class ZLCLOUDPLUGIN_API FZLStateBinaryWriter
+{
+public:
+	explicit FZLStateBinaryWriter(TArray<uint8>& InBytes) : Bytes(InBytes) {}
+
+	void WriteObject(const FJsonObject& Object);
+	void WriteValue(const FJsonValue& Value);
+	void WriteKey(const FString& Key);
+	void WriteString(const FString& String);
+	void WriteCount(uint64 Count);
+	void WriteByte(uint8 Byte) { Bytes.Add(Byte); }
+
+	// Fixed size little endian fields, for file headers
+	void WriteUInt32(uint32 Value);
+	void WriteUInt64(uint64 Value);
+
+private:
+	struct FKeyFuncs : TDefaultMapKeyFuncs<FString, uint32, false>
+	{
+		static bool Matches(const FString& A, const FString& B) { return A.Equals(B, ESearchCase::CaseSensitive); }
+		static uint32 GetKeyHash(const FString& Key) { return FCrc::StrCrc32(*Key); }
+	};
+
+	TArray<uint8>& Bytes;
+	TMap<FString, uint32, FDefaultSetAllocator, FKeyFuncs> KeyIndices;
+};
+
+// Reads what FZLStateBinaryWriter wrote. Every read fails rather than overrunning on truncated or corrupt data.
+class ZLCLOUDPLUGIN_API FZLStateBinaryReader
+{
+public:
+	FZLStateBinaryReader(const uint8* InData, int64 InNum) : Data(InData), Num(InNum) {}
+
+	bool ReadObject(TSharedPtr<FJsonObject>& OutObject);
+	bool ReadValue(TSharedPtr<FJsonValue>& OutValue);
+	bool ReadKey(FString& OutKey);
+	bool ReadString(FString& OutString);
+	bool ReadCount(uint64& OutCount);
+	bool ReadByte(uint8& OutByte);
+	bool ReadUInt32(uint32& OutValue);
+	bool ReadUInt64(uint64& OutValue);
+
+	int64 GetOffset() const { return Offset; }
+	bool IsAtEnd() const { return Offset == Num; }
+
+private:
+	bool ReadObject(TSharedPtr<FJsonObject>& OutObject, int32 Depth);
+	bool ReadValue(TSharedPtr<FJsonValue>& OutValue, int32 Depth);
+
+	const uint8* Data;
+	int64 Num;
+	int64 Offset = 0;
+	TArray<FString> Keys;
+};
+
+// Current and requested state trees as saved in a snapshot, with the schema they were saved against.
+struct ZLCLOUDPLUGIN_API FZLStateSnapshot
+{
+	TSharedPtr<FJsonObject> CurrentState;
+	TSharedPtr<FJsonObject> RequestedState;
+	uint64 SchemaHash = 0;
+	// Ties the snapshot to the journal written after it, a journal from another generation is ignored
+	uint32 Generation = 0;
+
+	void Serialize(TArray<uint8>& OutBytes) const;
+	bool Deserialize(const TArray<uint8>& Bytes, FString* OutError = nullptr);
+
+	// Hash of the schema's keys and their types and limits, 0 for no schema. Snapshots only restore against the same hash.
+	static uint64 HashSchema(const UStateKeyInfoAsset* Schema);
+};
+
+/*
+* Persists the current state tree as a binary snapshot plus an append-only journal of changes, so a restarted instance
+* can restore the last session without the launcher resending the whole state.
+* The owner calls RecordChange alongside every FZLStateTree::MarkChanged and RecordReset when the root is replaced,
+* then Flush once per tick. Flush encodes the value at each recorded path as it is now (or its removal) into one
+* journal record, and the requested tree whenever it changed, on the calling thread since the JSON isn't thread safe.
+* The file writes happen on a writer thread. A fresh snapshot replaces the journal after a reset, a schema change, or
+* once the journal outgrows the last snapshot.
+*/
+class ZLCLOUDPLUGIN_API FZLStateJournal : public FRunnable
+{
+public:
+	virtual ~FZLStateJournal();
+
+	// Starts the writer on Directory. Nothing is written until the first Flush, which writes a full snapshot.
+	bool Open(const FString& InDirectory, uint64 InSchemaHash);
+	// Waits for everything handed to the writer to reach the files and stops it. Flush first to keep recent changes.
+	void Close();
+	bool IsOpen() const { return Thread != nullptr; }
+
+	void RecordChange(const FZLStateKeyPath& Path);
+	void RecordReset() { bSnapshotDue = true; }
+	// Later changes are saved against the new schema, starting with a fresh snapshot
+	void SetSchemaHash(uint64 InSchemaHash);
+
+	void Flush(const TSharedPtr<FJsonObject>& CurrentState, const TSharedPtr<FJsonObject>& RequestedState);
+
+	// Blocks until everything flushed so far has been written.
+	void WaitForWrites();
+
+	// Loads Directory's snapshot and replays its journal, stopping at the first torn or corrupt record.
+	// Fails if there is no snapshot or it was saved against a different schema.
+	static bool Restore(const FString& Directory, uint64 SchemaHash, FZLStateSnapshot& OutSnapshot, FString* OutError = nullptr, int32* OutNumRecords = nullptr);
+
+	static FString GetSnapshotPath(const FString& Directory);
+	static FString GetJournalPath(const FString& Directory);
+
+	int64 GetJournalSize() const { return JournalSize; }
+	int32 GetNumSnapshots() const { return NumSnapshots; }
+	int32 GetNumRecords() const { return NumRecords; }
+
+	//~ FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+	struct FWriteJob
+	{
+		// Replaces the snapshot file and restarts the journal when set
+		TArray<uint8> Snapshot;
+		// Appended to the journal
+		TArray<uint8> Journal;
+	};
+
+	void QueueSnapshot(const TSharedPtr<FJsonObject>& CurrentState, const TSharedPtr<FJsonObject>& RequestedState);
+	void WriteJob(FWriteJob& Job);
+
+	FString SnapshotPath;
+	FString JournalPath;
+	uint64 SchemaHash = 0;
+	uint32 Generation = 0;
+
+	// Paths changed since the last Flush, in the order they were first recorded
+	TArray<FZLStateKeyPath> PendingPaths;
+	TSet<FZLStateKeyPath> PendingSet;
+	bool bSnapshotDue = true;
+	uint64 RequestedHash = 0;
+
+	// Journal bytes since the last snapshot, and that snapshot's size
+	int64 JournalSize = 0;
+	int64 SnapshotSize = 0;
+	int32 NumSnapshots = 0;
+	int32 NumRecords = 0;
+
+	// Writer thread state
+	FRunnableThread* Thread = nullptr;
+	FEvent* WorkEvent = nullptr;
+	TQueue<FWriteJob, EQueueMode::Spsc> Jobs;
+	FThreadSafeCounter NumPendingJobs;
+	FThreadSafeBool bStopping = false;
+	// Raised by the writer when a snapshot couldn't be saved, appends are dropped until the next snapshot lands
+	FThreadSafeBool bWriteFailed = false;
+	IFileHandle* JournalHandle = nullptr;
+};
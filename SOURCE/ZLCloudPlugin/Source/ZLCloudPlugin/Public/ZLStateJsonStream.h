@@ -0,0 +1,30 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/StringView.h"
+#include "Dom/JsonObject.h"
+
+// Receives the dotted key path of each value a streaming merge changed in its target: replaced or new leaves, arrays that
+// gained items, and new subtrees (reported once at their root, MarkChanged on that path covers everything below it).
+typedef TFunctionRef<void(const FString& KeyPath)> FJsonKeyChangedCallback;
+
+// Parses the JSON object in Json and merges it straight into Target as it goes, following the same rules as
+// MergeJsonObjectsRecursive: objects merge key by key, arrays gain the items they don't already hold and anything else
+// replaces the target value. No DOM is built for the payload, only array items and subtrees Target doesn't have yet are
+// allocated, and values that already match aren't allocated at all.
+// Target's nested objects are updated in place, so it must not share object levels with a tree that should stay as it was.
+// Returns false on malformed JSON, with Target holding whatever was applied before the error.
+ZLCLOUDPLUGIN_API bool MergeJsonIntoObject(FUtf8StringView Json, const TSharedPtr<FJsonObject>& Target, FJsonKeyChangedCallback OnKeyChanged, FString* OutError = nullptr);
+ZLCLOUDPLUGIN_API bool MergeJsonIntoObject(FUtf8StringView Json, const TSharedPtr<FJsonObject>& Target, FString* OutError = nullptr);
+
+// Same for text that is already an FString, e.g. data channel messages.
+ZLCLOUDPLUGIN_API bool MergeJsonIntoObject(FStringView Json, const TSharedPtr<FJsonObject>& Target, FJsonKeyChangedCallback OnKeyChanged, FString* OutError = nullptr);
+ZLCLOUDPLUGIN_API bool MergeJsonIntoObject(FStringView Json, const TSharedPtr<FJsonObject>& Target, FString* OutError = nullptr);
+
+// Parses the JSON object in Json with the same reader, building the values FJsonSerializer::Deserialize would. For payloads
+// that aren't merged over anything, where merging into an empty object would drop repeated array items.
+// Returns false on malformed JSON or anything other than an object, leaving OutObject untouched.
+ZLCLOUDPLUGIN_API bool ParseJsonObject(FUtf8StringView Json, TSharedPtr<FJsonObject>& OutObject, FString* OutError = nullptr);
+ZLCLOUDPLUGIN_API bool ParseJsonObject(FStringView Json, TSharedPtr<FJsonObject>& OutObject, FString* OutError = nullptr);
@@ -3,6 +3,8 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Dom/JsonObject.h"
+#include "ZLStateKeyTrie.h"
 
 #include "ZLStateKeyInfo.generated.h"
 
@@ -89,7 +91,52 @@ public:
 	UPROPERTY(EditAnywhere, Category = "StateKeyData", BlueprintReadWrite)
 	TMap<FString, FStateKeyInfo> KeyInfos;
 
+	// Both forms are cached. A change to the keys relinks them, regenerating only the JSON of keys whose info changed.
+	// The objects below the returned root are shared with the cache and must not be modified
     TSharedRef<FJsonObject> SerializeStateKeyAssetToJson();
 
     TSharedRef<FJsonObject> SerializeStateKeyAsset_JsonSchemaCompliant();
-};
\ No newline at end of file
+
+	// Prefix trie of the KeyInfos keys for child, prefix and wildcard lookups, built on first use and rebuilt if the number of keys changes.
+	const FZLStateKeyTrie& GetKeyTrie() const;
+
+	// The trie and serialized schema are rebuilt if the number of keys changes. Call InvalidateKeyCaches after replacing keys in
+	// KeyInfos directly, or keep them in step with OnKeyAdded/OnKeyRemoved/OnKeyChanged
+	void InvalidateKeyCaches();
+	void OnKeyAdded(const FString& Key);
+	void OnKeyRemoved(const FString& Key);
+	void OnKeyChanged(const FString& Key);
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+private:
+	mutable FZLStateKeyTrie KeyTrie;
+	mutable bool bKeyTrieValid = false;
+	// KeyInfos.Num() when the trie was last brought up to date
+	mutable int32 KeyTrieNumKeyInfos = 0;
+
+	// Both serialized forms of one key, regenerated when its info no longer matches the one they were made from
+	struct FSchemaKeyFragment
+	{
+		FStateKeyInfo Info;
+		// Null for an invalid data type, which ZEROLIGHT_SCHEMA_DATA leaves out
+		TSharedPtr<FJsonObject> SchemaDataEntry;
+		TSharedPtr<FJsonObject> JsonSchemaNode;
+	};
+
+	// Relinks the ZEROLIGHT_SCHEMA_DATA tree and the JSON Schema properties from the key fragments if anything changed
+	void UpdateSerializedSchema();
+
+	TMap<FString, FSchemaKeyFragment> SchemaKeyFragments;
+	TSharedPtr<FJsonObject> SerializedSchemaData;
+	TSharedPtr<FJsonObject> SerializedSchemaProperties;
+	bool bSerializedSchemaValid = false;
+	int32 SerializedSchemaNumKeyInfos = 0;
+};
+
+// A key's entry under ZEROLIGHT_SCHEMA_DATA, null for an invalid data type
+ZLCLOUDPLUGIN_API TSharedPtr<FJsonObject> ConvertInfoToSchemaDataEntry(const FStateKeyInfo& Info);
+// A key's JSON Schema leaf node
+ZLCLOUDPLUGIN_API TSharedPtr<FJsonObject> ConvertInfoToSchemaNode(const FStateKeyInfo& Info);
\ No newline at end of file
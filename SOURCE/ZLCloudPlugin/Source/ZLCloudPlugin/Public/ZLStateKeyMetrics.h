@@ -0,0 +1,62 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Dom/JsonObject.h"
+
+// How long the app has taken to confirm one state key, and how often it held a request up.
+struct FZLStateKeyTiming
+{
+	// Bucket upper limits in seconds, the last bucket is open ended
+	static constexpr int32 NumBuckets = 12;
+	static const double BucketLimits[NumBuckets - 1];
+
+	int32 NumConfirms = 0;
+	double TotalSeconds = 0.0;
+	double MaxSeconds = 0.0;
+	uint32 Buckets[NumBuckets] = {};
+
+	// Requests that hit their warning time, or timed out, with this key still unconfirmed
+	int32 NumWarnings = 0;
+	int32 NumTimeouts = 0;
+
+	double GetMeanSeconds() const { return NumConfirms > 0 ? TotalSeconds / NumConfirms : 0.0; }
+	// Estimated from the buckets, the upper limit of the one the percentile falls in, no more than MaxSeconds
+	double GetPercentileSeconds(double Percentile) const;
+};
+
+/*
+* Per key time from a state request starting (being handed to the app) to the app confirming the key, as a histogram
+* with warning and timeout counts, to find the handlers that hold up the request queue. Confirms are counted under the
+* key the app confirmed, warnings and timeouts under each leaf still unconfirmed, so an app that confirms whole objects
+* shows its confirms on the object and any stragglers on its leaves. Time spent queued behind other requests doesn't
+* count against a key, that's the fault of whatever held up the earlier request.
+*/
+class ZLCLOUDPLUGIN_API FZLStateKeyMetrics
+{
+public:
+	void RecordConfirm(const FString& Key, double Seconds);
+	void RecordWarning(const FString& Key);
+	void RecordTimeout(const FString& Key);
+	void Reset();
+
+	const TMap<FString, FZLStateKeyTiming>& GetKeys() const { return Keys; }
+
+	// Keys ordered worst first: most timeouts, then most warnings, then most total time to confirm
+	TArray<TPair<FString, const FZLStateKeyTiming*>> GetSortedKeys() const;
+
+	// {"bucket_limits":[...],"keys":[{"key","confirms","mean","p50","p95","max","warnings","timeouts","histogram":[...]}]},
+	// worst first and limited to MaxKeys if positive. Times in seconds
+	TSharedRef<FJsonObject> ToJson(int32 MaxKeys = 0) const;
+	TArray<FString> ToLines(int32 MaxKeys = 0) const;
+
+	// New keys past this are counted together under OtherKey, so a client sending made up keys can't grow the map forever
+	int32 MaxTrackedKeys = 2048;
+	static const TCHAR* OtherKey;
+
+private:
+	FZLStateKeyTiming& FindOrAddKey(const FString& Key);
+
+	TMap<FString, FZLStateKeyTiming> Keys;
+};
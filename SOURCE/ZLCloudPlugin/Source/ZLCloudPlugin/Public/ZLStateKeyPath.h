@@ -0,0 +1,108 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Dom/JsonObject.h"
+#include "Dom/JsonValue.h"
+
+/*
+* Interned handle to a "." delimited state key such as "Trim.Paint.Colour".
+* The path is split and each segment hashed once when it is first interned, after that the handle is a pointer
+* copy and lookups into FJsonObject::Values reuse the stored hashes instead of re-splitting and re-hashing the string.
+* Interned paths live for the lifetime of the module.
+*/
+class ZLCLOUDPLUGIN_API FZLStateKeyPath
+{
+public:
+	struct FSegment
+	{
+		FString Name;
+		// Same hash FJsonObject::Values uses for this key, so lookups can go through FindByHash
+		uint32 Hash = 0;
+	};
+
+	FZLStateKeyPath() = default;
+
+	// Returns the handle for InPath, splitting and hashing it the first time the path is seen. Empty segments are skipped like ParseIntoArray.
+	static FZLStateKeyPath Intern(const FString& InPath);
+
+	// Number of distinct paths interned so far.
+	static int32 GetNumInterned();
+
+	bool IsValid() const { return Data != nullptr && Data->Segments.Num() > 0; }
+
+	// Unique per interned path, stable for the lifetime of the module.
+	int32 GetId() const { return Data ? Data->Id : INDEX_NONE; }
+
+	const FString& ToString() const;
+	const TArray<FSegment>& GetSegments() const;
+	int32 Num() const { return Data ? Data->Segments.Num() : 0; }
+	const FSegment& GetLeaf() const { return GetSegments().Last(); }
+	bool IsNested() const { return Num() > 1; }
+
+	bool operator==(const FZLStateKeyPath& Other) const { return Data == Other.Data; }
+	bool operator!=(const FZLStateKeyPath& Other) const { return Data != Other.Data; }
+
+	friend uint32 GetTypeHash(const FZLStateKeyPath& Path) { return ::GetTypeHash(Path.GetId()); }
+
+private:
+	struct FData
+	{
+		int32 Id = INDEX_NONE;
+		FString Path;
+		TArray<FSegment> Segments;
+	};
+
+	// Intern table, defined in the cpp
+	struct FTable;
+	static FTable& GetTable();
+
+	explicit FZLStateKeyPath(const FData* InData) : Data(InData) {}
+
+	const FData* Data = nullptr;
+};
+
+/*
+* Remembers which object holds the leaf of each key path in one state tree, so repeated lookups of the same key
+* (e.g. blueprints polling every tick) skip walking the intermediate levels. Absent paths are cached too.
+* The owner must call Invalidate whenever objects are added, removed or replaced in the tree, value changes to
+* existing leaves don't need it as the leaf itself is always looked up fresh. Replacing the root invalidates automatically.
+*/
+class ZLCLOUDPLUGIN_API FZLStateKeyPathCache
+{
+public:
+	// Returns the object that holds (or would hold) Path's leaf, or nullptr if an intermediate level is missing or isn't an object.
+	TSharedPtr<FJsonObject> ResolveParent(const TSharedPtr<FJsonObject>& Root, const FZLStateKeyPath& Path);
+
+	// Returns the leaf value for Path, or nullptr if it doesn't exist. The pointer is only valid until the tree is next modified.
+	const TSharedPtr<FJsonValue>* Find(const TSharedPtr<FJsonObject>& Root, const FZLStateKeyPath& Path);
+
+	void Invalidate();
+
+	uint64 GetNumHits() const { return NumHits; }
+	uint64 GetNumMisses() const { return NumMisses; }
+
+	// Walks Root to Path's parent object without touching any cache.
+	static TSharedPtr<FJsonObject> WalkToParent(const TSharedPtr<FJsonObject>& Root, const FZLStateKeyPath& Path);
+
+	// Looks up a single segment in Object using its precomputed hash.
+	static const TSharedPtr<FJsonValue>* FindSegment(const FJsonObject& Object, const FZLStateKeyPath::FSegment& Segment)
+	{
+		return Object.Values.FindByHash(Segment.Hash, Segment.Name);
+	}
+
+private:
+	struct FEntry
+	{
+		TWeakPtr<FJsonObject> Parent;
+		// False for paths that didn't resolve when they were cached
+		bool bResolved = false;
+	};
+
+	TWeakPtr<FJsonObject> CachedRoot;
+	TMap<int32, FEntry> Entries;
+
+	uint64 NumHits = 0;
+	uint64 NumMisses = 0;
+};
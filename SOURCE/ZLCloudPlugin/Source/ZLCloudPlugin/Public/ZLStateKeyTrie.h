@@ -0,0 +1,288 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+* Lookups over a trie of "." delimited state keys, one node per segment. Works on any node type that keeps its children
+* in a TMap<FString, TUniquePtr<NodeType>> keyed by segment name and has IsKey (the path to it is a key in its own right)
+* and HasKeysBelow, i.e. FZLStateKeyTrie::FNode and FZLStateTree::FNode.
+* Segments match case insensitively like FJsonObject keys. Results keep the case of the query for the segments it names
+* and the case the keys were added with below that.
+* Each lookup only walks the levels its query names, so the cost is the key depth plus the results rather than every key.
+*/
+struct FZLStateKeyQuery
+{
+	// Splits Key into its segments, empty segments are skipped like FZLStateKeyPath
+	static void Split(const FString& Key, TArray<FString>& OutSegments)
+	{
+		Key.ParseIntoArray(OutSegments, TEXT("."), true);
+	}
+
+	// Returns the node for Key (the root for an empty key), or nullptr if it isn't in the trie
+	template <typename NodeType>
+	static const NodeType* FindNode(const NodeType& Root, const FString& Key, FString* OutPath = nullptr)
+	{
+		TArray<FString> Segments;
+		Split(Key, Segments);
+
+		const NodeType* Node = &Root;
+		for (const FString& Segment : Segments)
+		{
+			const TUniquePtr<NodeType>* Child = FindChild(*Node, Segment, OutPath);
+			if (!Child)
+			{
+				return nullptr;
+			}
+			Node = Child->Get();
+		}
+		return Node;
+	}
+
+	// Full keys of the children of ParentKey, one level down. Children that are only parents of keys are included with bIncludeParents
+	template <typename NodeType>
+	static void GetChildren(const NodeType& Root, const FString& ParentKey, bool bIncludeParents, TArray<FString>& OutKeys)
+	{
+		FString Path;
+		const NodeType* Parent = FindNode(Root, ParentKey, &Path);
+		if (!Parent)
+		{
+			return;
+		}
+
+		OutKeys.Reserve(OutKeys.Num() + Parent->Children.Num());
+		for (const TPair<FString, TUniquePtr<NodeType>>& Child : Parent->Children)
+		{
+			if (Child.Value->IsKey() || (bIncludeParents && Child.Value->HasKeysBelow()))
+			{
+				OutKeys.Add(JoinPath(Path, Child.Key));
+			}
+		}
+	}
+
+	// Keys starting with Prefix, where its last segment may be partial: "Trim.Pa" finds "Trim.Paint" and "Trim.Panel.Colour"
+	template <typename NodeType>
+	static void FindByPrefix(const NodeType& Root, const FString& Prefix, TArray<FString>& OutKeys, int32 MaxResults = MAX_int32)
+	{
+		TArray<FString> Segments;
+		Split(Prefix, Segments);
+
+		// A trailing "." means the last segment is complete
+		FString Partial;
+		if (Segments.Num() > 0 && !Prefix.EndsWith(TEXT(".")))
+		{
+			Partial = Segments.Pop();
+		}
+
+		FString Path;
+		const NodeType* Node = &Root;
+		for (const FString& Segment : Segments)
+		{
+			const TUniquePtr<NodeType>* Child = FindChild(*Node, Segment, &Path);
+			if (!Child)
+			{
+				return;
+			}
+			Node = Child->Get();
+		}
+
+		if (Partial.IsEmpty())
+		{
+			CollectKeys(*Node, Path, OutKeys, MaxResults);
+			return;
+		}
+
+		for (const TPair<FString, TUniquePtr<NodeType>>& Child : Node->Children)
+		{
+			if (OutKeys.Num() >= MaxResults)
+			{
+				return;
+			}
+			if (Child.Key.StartsWith(Partial, ESearchCase::IgnoreCase))
+			{
+				CollectKeys(*Child.Value, JoinPath(Path, Child.Key), OutKeys, MaxResults);
+			}
+		}
+	}
+
+	// Keys matching Pattern segment by segment, where a segment can use * and ? within it and "**" spans any number of segments,
+	// e.g. "Trim.*.Colour" or "**.Colour"
+	template <typename NodeType>
+	static void FindMatching(const NodeType& Root, const FString& Pattern, TArray<FString>& OutKeys, int32 MaxResults = MAX_int32)
+	{
+		TArray<FString> Segments;
+		Split(Pattern, Segments);
+		if (Segments.Num() > 0)
+		{
+			// "**" can reach the same node at the same point in the pattern several ways, each is only followed once
+			TSet<TPair<const NodeType*, int32>> Visited;
+			MatchSegments(Root, FString(), Segments, 0, OutKeys, MaxResults, Visited);
+		}
+	}
+
+	// Every key at or below Node
+	template <typename NodeType>
+	static void CollectKeys(const NodeType& Node, const FString& Path, TArray<FString>& OutKeys, int32 MaxResults = MAX_int32)
+	{
+		if (OutKeys.Num() >= MaxResults)
+		{
+			return;
+		}
+		if (!Path.IsEmpty() && Node.IsKey())
+		{
+			OutKeys.Add(Path);
+		}
+		for (const TPair<FString, TUniquePtr<NodeType>>& Child : Node.Children)
+		{
+			CollectKeys(*Child.Value, JoinPath(Path, Child.Key), OutKeys, MaxResults);
+		}
+	}
+
+	// Every key with keys below it, e.g. "Trim" and "Trim.Paint" for "Trim.Paint.Colour"
+	template <typename NodeType>
+	static void CollectParents(const NodeType& Node, const FString& Path, TArray<FString>& OutKeys)
+	{
+		for (const TPair<FString, TUniquePtr<NodeType>>& Child : Node.Children)
+		{
+			if (Child.Value->HasKeysBelow())
+			{
+				const FString ChildPath = JoinPath(Path, Child.Key);
+				OutKeys.Add(ChildPath);
+				CollectParents(*Child.Value, ChildPath, OutKeys);
+			}
+		}
+	}
+
+	static FString JoinPath(const FString& Path, const FString& Segment)
+	{
+		return Path.IsEmpty() ? Segment : Path + TEXT(".") + Segment;
+	}
+
+private:
+	// Finds Segment under Node, appending it to OutPath if given
+	template <typename NodeType>
+	static const TUniquePtr<NodeType>* FindChild(const NodeType& Node, const FString& Segment, FString* OutPath)
+	{
+		const TUniquePtr<NodeType>* Child = Node.Children.Find(Segment);
+		if (Child && OutPath)
+		{
+			*OutPath = JoinPath(*OutPath, Segment);
+		}
+		return Child;
+	}
+
+	static bool HasWildcard(const FString& Segment)
+	{
+		int32 Index;
+		return Segment.FindChar(TCHAR('*'), Index) || Segment.FindChar(TCHAR('?'), Index);
+	}
+
+	template <typename NodeType>
+	static void MatchSegments(const NodeType& Node, const FString& Path, const TArray<FString>& Segments, int32 SegmentIndex,
+		TArray<FString>& OutKeys, int32 MaxResults, TSet<TPair<const NodeType*, int32>>& Visited)
+	{
+		if (OutKeys.Num() >= MaxResults)
+		{
+			return;
+		}
+
+		bool bAlreadyVisited = false;
+		Visited.Add(TPair<const NodeType*, int32>(&Node, SegmentIndex), &bAlreadyVisited);
+		if (bAlreadyVisited)
+		{
+			return;
+		}
+
+		if (SegmentIndex == Segments.Num())
+		{
+			if (!Path.IsEmpty() && Node.IsKey())
+			{
+				OutKeys.Add(Path);
+			}
+			return;
+		}
+
+		const FString& Segment = Segments[SegmentIndex];
+		if (Segment == TEXT("**"))
+		{
+			// Spans nothing, or one more segment and still spanning
+			MatchSegments(Node, Path, Segments, SegmentIndex + 1, OutKeys, MaxResults, Visited);
+			for (const TPair<FString, TUniquePtr<NodeType>>& Child : Node.Children)
+			{
+				MatchSegments(*Child.Value, JoinPath(Path, Child.Key), Segments, SegmentIndex, OutKeys, MaxResults, Visited);
+			}
+		}
+		else if (HasWildcard(Segment))
+		{
+			for (const TPair<FString, TUniquePtr<NodeType>>& Child : Node.Children)
+			{
+				if (Child.Key.MatchesWildcard(Segment, ESearchCase::IgnoreCase))
+				{
+					MatchSegments(*Child.Value, JoinPath(Path, Child.Key), Segments, SegmentIndex + 1, OutKeys, MaxResults, Visited);
+				}
+			}
+		}
+		else
+		{
+			FString ChildPath = Path;
+			if (const TUniquePtr<NodeType>* Child = FindChild(Node, Segment, &ChildPath))
+			{
+				MatchSegments(**Child, ChildPath, Segments, SegmentIndex + 1, OutKeys, MaxResults, Visited);
+			}
+		}
+	}
+};
+
+/*
+* Prefix trie of a set of state keys such as a schema's, kept up to date a key at a time with Add and Remove so
+* enumerating the children of a key, or searching by prefix or wildcard, doesn't have to string match every key.
+*/
+class ZLCLOUDPLUGIN_API FZLStateKeyTrie
+{
+public:
+	struct FNode
+	{
+		// True if the path to this node was added as a key, rather than only keys below it
+		bool bIsKey = false;
+		// Keys at or below this node, a node with none left is removed
+		int32 NumKeysInSubtree = 0;
+		TMap<FString, TUniquePtr<FNode>> Children;
+
+		bool IsKey() const { return bIsKey; }
+		bool HasKeysBelow() const { return NumKeysInSubtree > (bIsKey ? 1 : 0); }
+	};
+
+	// Returns false if Key was already in the trie or has no segments
+	bool Add(const FString& Key);
+	// Returns false if Key wasn't in the trie, parents left without keys below them go with it
+	bool Remove(const FString& Key);
+	void Reset();
+
+	bool Contains(const FString& Key) const;
+	int32 Num() const { return Root.NumKeysInSubtree; }
+	const FNode& GetRoot() const { return Root; }
+
+	void GetChildren(const FString& ParentKey, bool bIncludeParents, TArray<FString>& OutKeys) const
+	{
+		FZLStateKeyQuery::GetChildren(Root, ParentKey, bIncludeParents, OutKeys);
+	}
+
+	void FindByPrefix(const FString& Prefix, TArray<FString>& OutKeys, int32 MaxResults = MAX_int32) const
+	{
+		FZLStateKeyQuery::FindByPrefix(Root, Prefix, OutKeys, MaxResults);
+	}
+
+	void FindMatching(const FString& Pattern, TArray<FString>& OutKeys, int32 MaxResults = MAX_int32) const
+	{
+		FZLStateKeyQuery::FindMatching(Root, Pattern, OutKeys, MaxResults);
+	}
+
+	void GetParents(TArray<FString>& OutKeys) const
+	{
+		FZLStateKeyQuery::CollectParents(Root, FString(), OutKeys);
+	}
+
+private:
+	FNode Root;
+};
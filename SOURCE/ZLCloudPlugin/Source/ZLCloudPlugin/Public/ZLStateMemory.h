@@ -0,0 +1,91 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Dom/JsonObject.h"
+
+// Estimated heap bytes behind a JSON tree
+struct FZLJsonMemoryUsage
+{
+	// Bytes of the objects, values, keys and strings first reached through this tree
+	int64 Bytes = 0;
+	// Bytes of subtrees already counted through an earlier tree (or earlier in this one), held once but referenced again here
+	int64 SharedBytes = 0;
+	// Part of Bytes spent on object key strings
+	int64 KeyBytes = 0;
+	int32 NumObjects = 0;
+	int32 NumValues = 0;
+
+	FZLJsonMemoryUsage& operator+=(const FZLJsonMemoryUsage& Other)
+	{
+		Bytes += Other.Bytes;
+		SharedBytes += Other.SharedBytes;
+		KeyBytes += Other.KeyBytes;
+		NumObjects += Other.NumObjects;
+		NumValues += Other.NumValues;
+		return *this;
+	}
+};
+
+/*
+* Walks JSON trees adding up what their objects, values, keys and strings allocate. Counting several trees through the
+* same counter charges anything they share by pointer to the first tree that reaches it, later trees report it as shared,
+* so the sum of Bytes is what the trees hold between them. Sizes are estimates from the concrete FJsonValue types and
+* container allocations, allocator slack isn't included.
+*/
+class ZLCLOUDPLUGIN_API FZLJsonMemoryCounter
+{
+public:
+	FZLJsonMemoryUsage Count(const TSharedPtr<FJsonObject>& Root);
+
+	// Key bytes counted so far for a key some other counted object already spelled out, i.e. what sharing more of the trees could still save
+	int64 GetDuplicateKeyBytes() const { return DuplicateKeyBytes; }
+
+	void Reset();
+
+private:
+	// Each returns the full size of the subtree, the part not counted before goes to Usage.Bytes and the rest to Usage.SharedBytes
+	int64 CountObject(const TSharedPtr<FJsonObject>& Object, FZLJsonMemoryUsage& Usage);
+	int64 CountValue(const TSharedPtr<FJsonValue>& Value, FZLJsonMemoryUsage& Usage);
+
+	struct FKeyFuncs : DefaultKeyFuncs<FString>
+	{
+		static bool Matches(const FString& A, const FString& B) { return A.Equals(B, ESearchCase::CaseSensitive); }
+		static uint32 GetKeyHash(const FString& Key) { return FCrc::StrCrc32(*Key); }
+	};
+
+	// Size of every object and value counted so far, anything reached again is shared
+	TMap<const void*, int64> Counted;
+	TSet<FString, FKeyFuncs> SeenKeys;
+	int64 DuplicateKeyBytes = 0;
+};
+
+// The state manager's JSON trees, in the order they are counted
+enum class EZLStateMemoryTree : uint8
+{
+	Current,
+	WebCurrent,
+	WebSyncStates,
+	Processing,
+	InRequested,
+	OutRequested,
+	ServerNotify,
+	ServerNotifyUnmatched,
+	DefaultInitial,
+	Num
+};
+
+// Memory held by each of the state manager's JSON trees, for ZLCloudPlugin.State.Memory and stat ZLCloudPlugin
+struct ZLCLOUDPLUGIN_API FZLStateMemoryReport
+{
+	FZLJsonMemoryUsage Trees[(int32)EZLStateMemoryTree::Num];
+	int64 DuplicateKeyBytes = 0;
+
+	FZLJsonMemoryUsage GetTotal() const;
+	TArray<FString> ToLines() const;
+	// Sets the state memory stats, a no-op without STATS
+	void PublishStats() const;
+
+	static const TCHAR* GetTreeName(EZLStateMemoryTree Tree);
+};
@@ -0,0 +1,78 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ZLStateKeyPath.h"
+
+enum class EZLStateObserverSource : uint8
+{
+	// Values a state request wants changed, for the handlers that pull and apply them
+	Requested,
+	// Values confirmed into the current state
+	Current,
+
+	Num
+};
+
+// Every changed path that concerned the observer since the last dispatch, in the order they first changed.
+// Holds an invalid path for an observer of the whole tree when the whole tree was replaced.
+DECLARE_DELEGATE_OneParam(FZLOnStatePathsChanged, const TArray<FZLStateKeyPath>&);
+
+/*
+* Subscriptions to state key paths, so a change only wakes the handlers whose keys it touches.
+* Observers are filed in a trie by path segment. A changed path concerns the observers at the nodes along it (their
+* value is or contains the change) and every observer below its last node (their value was replaced along with it),
+* so observing "Trim" sees "Trim.Paint" change and observing "Trim.Paint" sees "Trim" replaced. An invalid or empty
+* path observes the whole tree. Changes are routed as they are marked and delivered together by Dispatch, once per
+* frame, with each observer called at most once. Marking costs nothing while a source has no observers.
+*/
+class ZLCLOUDPLUGIN_API FZLStateObservers
+{
+public:
+	typedef uint64 FObserverId;
+	static constexpr FObserverId InvalidObserver = 0;
+
+	FObserverId Subscribe(EZLStateObserverSource Source, const FZLStateKeyPath& Path, FZLOnStatePathsChanged Callback);
+	// Returns false if the observer was already removed. Safe to call from an observer's callback
+	bool Unsubscribe(FObserverId Id);
+	bool IsSubscribed(FObserverId Id) const { return Observers.Contains(Id); }
+
+	bool HasObservers(EZLStateObserverSource Source) const { return Roots[(int32)Source].NumInSubtree > 0; }
+	int32 Num() const { return Observers.Num(); }
+
+	void MarkChanged(EZLStateObserverSource Source, const FZLStateKeyPath& Path);
+	// The whole tree was replaced, every observer of Source is told about the path it observes
+	void MarkAllChanged(EZLStateObserverSource Source);
+
+	// Calls each observer concerned by the changes since the last Dispatch. Changes marked by the callbacks go out with
+	// the next Dispatch. Returns the number of observers called
+	int32 Dispatch();
+
+private:
+	struct FNode
+	{
+		TMap<FString, TUniquePtr<FNode>> Children;
+		TArray<FObserverId> Observers;
+		// Observers at this node and every node below it, empty branches are pruned
+		int32 NumInSubtree = 0;
+	};
+
+	struct FObserver
+	{
+		EZLStateObserverSource Source = EZLStateObserverSource::Current;
+		FZLStateKeyPath Path;
+		FZLOnStatePathsChanged Callback;
+	};
+
+	void AddToBatch(const FNode& Node, const FZLStateKeyPath& Path, bool bSubtree);
+
+	FNode Roots[(int32)EZLStateObserverSource::Num];
+	TMap<FObserverId, FObserver> Observers;
+	FObserverId NextId = 1;
+
+	// Paths already routed since the last Dispatch, a path changed several times in a frame is only routed once
+	TSet<FZLStateKeyPath> RoutedPaths[(int32)EZLStateObserverSource::Num];
+	// Changed paths per observer waiting for Dispatch
+	TMap<FObserverId, TArray<FZLStateKeyPath>> Batch;
+};
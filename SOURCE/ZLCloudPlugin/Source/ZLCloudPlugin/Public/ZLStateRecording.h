@@ -0,0 +1,208 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Dom/JsonObject.h"
+#include "Math/RandomStream.h"
+#include "ZLStateKeyPath.h"
+
+class FArchive;
+class UStateKeyInfoAsset;
+class UZLCloudPluginStateManager;
+struct FZLStateRequestTiming;
+
+/*
+* Writes a state session to a file, one JSON object per line, for FZLStateReplayer to play back as a load test:
+*   {"version":1,"schema_hash":"...","initial_state":{...}}
+*   {"t":1.25,"request":"...","compare":true}                        a request string as ProcessState received it
+*   {"t":1.50,"confirm":"Trim.Paint"}                                 the app confirming a requested key
+*   {"t":1.50,"changes":{"Trim.Paint":"Red"},"removed":["Wheels"]}    current state changes made during a tick
+*   {"t":1.50,"reset":{...}}                                          the whole current state replaced
+*   {"t":9.00,"final_state":{...}}
+* Times are seconds on the state manager's clock since recording started. Changes are written once per tick with
+* their values at the end of it, keyed by the path that changed (or the deepest part of it that still exists).
+*/
+class ZLCLOUDPLUGIN_API FZLStateRecorder
+{
+public:
+	~FZLStateRecorder();
+
+	bool Open(const FString& InFileName, const TSharedPtr<FJsonObject>& InitialState, uint64 SchemaHash, double Time);
+	// Writes the changes still pending and the final state, then closes the file
+	void Close(const TSharedPtr<FJsonObject>& FinalState, double Time);
+	bool IsOpen() const { return Writer != nullptr; }
+
+	void RecordRequest(const FString& Json, bool bCompareCurrentState, double Time);
+	void RecordConfirm(const FString& Key, double Time);
+	void RecordChange(const FZLStateKeyPath& Path);
+	void RecordReset() { bResetPending = true; }
+
+	// Writes the changes recorded since the last Flush with their current values, once per tick
+	void Flush(const TSharedPtr<FJsonObject>& CurrentState, double Time);
+
+	const FString& GetFileName() const { return FileName; }
+	int32 GetNumRequests() const { return NumRequests; }
+
+	// Relative names are under Saved/ZLStateRecordings, .json is added if there is no extension
+	static FString ResolveFileName(const FString& InFileName);
+
+private:
+	void WriteLine(const TSharedRef<FJsonObject>& Line);
+
+	FString FileName;
+	FArchive* Writer = nullptr;
+	double StartTime = 0.0;
+	int32 NumRequests = 0;
+
+	// Paths changed since the last Flush, in the order they were first recorded
+	TArray<FZLStateKeyPath> PendingPaths;
+	TSet<FZLStateKeyPath> PendingSet;
+	bool bResetPending = false;
+};
+
+enum class EZLStateRecordedEvent : uint8
+{
+	Request,
+	Confirm,
+	Changes,
+	Reset
+};
+
+struct FZLStateRecordedEvent
+{
+	EZLStateRecordedEvent Type = EZLStateRecordedEvent::Request;
+	double Time = 0.0;
+	// Request string as received, or the confirmed key
+	FString Text;
+	bool bCompareCurrentState = false;
+	// The changed values, or the state a reset set
+	TSharedPtr<FJsonObject> State;
+	TArray<FString> Removed;
+};
+
+// A recording loaded back from the file FZLStateRecorder wrote.
+struct ZLCLOUDPLUGIN_API FZLStateRecording
+{
+	TSharedPtr<FJsonObject> InitialState;
+	// Null if the recording was cut short
+	TSharedPtr<FJsonObject> FinalState;
+	uint64 SchemaHash = 0;
+	TArray<FZLStateRecordedEvent> Events;
+	double Duration = 0.0;
+	int32 NumRequests = 0;
+
+	// A torn last line is dropped, anything else malformed fails the load
+	bool Load(const FString& FileName, FString* OutError = nullptr);
+};
+
+struct FZLStateReplaySettings
+{
+	// Multiple of the recorded speed when ticked in real time, RunToCompletion ignores it and runs as fast as it can
+	double Speed = 1.0;
+	// Seconds before the stub app confirms each key it pulls, negative to confirm when the recorded app did (or never, if it didn't)
+	double ConfirmDelay = -1.0;
+	// Up to this many seconds added to ConfirmDelay at random
+	double ConfirmJitter = 0.0;
+	// Chance the stub app never confirms a key it pulled, leaving its request to time out. Ignored when confirming at the recorded times
+	double DropConfirmChance = 0.0;
+	// Replay time between state manager updates
+	double TickInterval = 1.0 / 60.0;
+	int32 Seed = 0;
+};
+
+struct ZLCLOUDPLUGIN_API FZLStateReplayReport
+{
+	int32 NumRequests = 0;
+	int32 NumComplete = 0;
+	int32 NumUnmatched = 0;
+	int32 NumTimedOut = 0;
+	int32 NumConfirms = 0;
+	int32 NumTicks = 0;
+	int32 NumWebMessages = 0;
+	int64 WebMessageChars = 0;
+
+	// Arrival to end of each request, merged requests included, sorted once the replay finishes
+	TArray<double> Latencies;
+
+	// Wall time spent in the state manager, and in the stub app pulling and confirming values
+	double ProcessStateSeconds = 0.0;
+	double UpdateSeconds = 0.0;
+	double AppSeconds = 0.0;
+	double WallSeconds = 0.0;
+	double ReplayedSeconds = 0.0;
+
+	// Process memory growth over the replay, the closest portable measure of what it allocated and kept
+	int64 MemoryGrowth = 0;
+	int64 PeakMemoryGrowth = 0;
+
+	// Only meaningful when confirming at the recorded times
+	bool bFinalStateMatches = false;
+
+	double GetLatencyPercentile(double Percentile) const;
+	TArray<FString> ToLines() const;
+};
+
+/*
+* Plays a recording back against a detached state manager and a stub app, reporting request latency and where the
+* time went. The manager runs on the replay clock, with its web messages and the requests it starts itself handed to the
+* replayer rather than the live stream and app. The stub app pulls each requested leaf as a request starts and
+* confirms it after the configured delay, as a blueprint handling OnRecieveData and OnStateRequestStarted would.
+*/
+class ZLCLOUDPLUGIN_API FZLStateReplayer
+{
+public:
+	FZLStateReplayer(const FZLStateRecording& InRecording, const FZLStateReplaySettings& InSettings, const UStateKeyInfoAsset* Schema);
+	~FZLStateReplayer();
+
+	// Advances replay time by DeltaSeconds scaled by Speed, in TickInterval steps. Returns false once the replay is finished
+	bool Tick(double DeltaSeconds);
+	void RunToCompletion();
+
+	bool IsFinished() const { return bFinished; }
+	const FZLStateReplayReport& GetReport() const { return Report; }
+	// The detached manager being replayed against, e.g. to record the replay itself
+	UZLCloudPluginStateManager* GetManager() const { return Manager; }
+
+private:
+	struct FPendingConfirm
+	{
+		double Time = 0.0;
+		FString Key;
+
+		bool operator<(const FPendingConfirm& Other) const { return Time < Other.Time; }
+	};
+
+	void Step();
+	void FeedEvent(const FZLStateRecordedEvent& Event);
+	void ProcessRequest(const FString& Json, bool bCompareCurrentState);
+	void PullRequestedLeaves(const FJsonObject& Object, const FString& Prefix, bool bFromUpdate);
+	// Negative if the key is never confirmed
+	double GetConfirmTime(const FString& Key, bool bFromUpdate);
+	void OnRequestEnded(const FZLStateRequestTiming& Timing);
+	void Finish();
+
+	FZLStateRecording Recording;
+	FZLStateReplaySettings Settings;
+	FZLStateReplayReport Report;
+
+	UZLCloudPluginStateManager* Manager = nullptr;
+	FDelegateHandle RequestEndedHandle;
+
+	double Time = 0.0;
+	double TickDebt = 0.0;
+	int32 NextEvent = 0;
+	bool bFinished = false;
+
+	// Min heap on Time
+	TArray<FPendingConfirm> PendingConfirms;
+	// Every confirm in the recording by key, in time order
+	TMap<FString, TArray<double>> RecordedConfirmTimes;
+	FRandomStream Random;
+
+	double StartWallTime = 0.0;
+	uint64 StartMemory = 0;
+	uint64 PeakMemory = 0;
+	// Time inside Update spent on the queued requests it hands back, counted as ProcessState and app time instead
+	double NestedSeconds = 0.0;
+};
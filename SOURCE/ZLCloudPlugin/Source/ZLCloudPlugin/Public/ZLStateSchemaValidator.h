@@ -0,0 +1,89 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Dom/JsonObject.h"
+#include "ZLStateKeyInfo.h"
+
+enum class EZLStateViolation : uint8
+{
+	// The value's JSON type doesn't match the key's DataType, or an array item doesn't match the item type
+	WrongType,
+	// A limited key's value, or one of its array items, isn't one of the accepted values
+	NotAccepted,
+	// The schema has keys below this one but the request holds something other than an object here
+	NotAnObject
+};
+
+struct ZLCLOUDPLUGIN_API FZLStateViolation
+{
+	// Dotted key of the offending value, array items are suffixed with [index]
+	FString Key;
+	EZLStateViolation Reason = EZLStateViolation::WrongType;
+
+	FString ToString() const;
+};
+
+/*
+* A UStateKeyInfoAsset compiled into per key validators for checking state requests.
+* Keys are arranged in a tree matching the request's nesting, so a request is validated in one walk over its own
+* values with a hash lookup per key, and keys the schema doesn't declare are skipped along with everything below them.
+* Each key's DataType becomes an enum tag, accepted strings a case sensitive hash set and accepted numbers a sorted
+* array searched by bisection, so the cost of a limited key doesn't grow with the number of values it accepts.
+* A limited key with no accepted values accepts anything of the right type, as in the JSON schema export.
+*/
+class ZLCLOUDPLUGIN_API FZLStateSchemaValidator
+{
+public:
+	// Replaces the compiled schema, a null schema accepts everything.
+	void Compile(const UStateKeyInfoAsset* Schema);
+
+	bool IsEmpty() const { return Validators.Num() == 0; }
+	int32 Num() const { return Validators.Num(); }
+
+	// Appends every violation in State to OutViolations and returns how many were found.
+	int32 Validate(const TSharedPtr<FJsonObject>& State, TArray<FZLStateViolation>& OutViolations) const;
+
+	// Same check stopping at the first violation.
+	bool IsValid(const TSharedPtr<FJsonObject>& State) const;
+
+private:
+	struct FCaseSensitiveStringKeyFuncs : BaseKeyFuncs<FString, FString>
+	{
+		static const FString& GetSetKey(const FString& Element) { return Element; }
+		static bool Matches(const FString& A, const FString& B) { return A.Equals(B, ESearchCase::CaseSensitive); }
+		static uint32 GetKeyHash(const FString& Key) { return FCrc::StrCrc32(*Key); }
+	};
+
+	struct FKeyValidator
+	{
+		EStateKeyDataType Type = EStateKeyDataType::Invalid;
+		// Only set for limited keys with accepted values
+		TSet<FString, FCaseSensitiveStringKeyFuncs> AcceptedStrings;
+		// Sorted, only set for limited keys with accepted values
+		TArray<double> AcceptedNumbers;
+		bool bLimitStrings = false;
+		bool bLimitNumbers = false;
+	};
+
+	struct FNode
+	{
+		TMap<FString, TUniquePtr<FNode>> Children;
+		int32 Validator = INDEX_NONE;
+	};
+
+	// Keys from the root down to the value being checked, only turned into a path when a violation is recorded
+	typedef TArray<const FString*, TInlineAllocator<8>> FKeyStack;
+
+	bool VisitObject(const FNode& Node, const FJsonObject& Object, FKeyStack& Keys, TArray<FZLStateViolation>* OutViolations) const;
+	bool CheckValue(const FKeyValidator& Validator, const FJsonValue& Value, FKeyStack& Keys, TArray<FZLStateViolation>* OutViolations) const;
+	bool CheckItem(const FKeyValidator& Validator, EJson ItemType, const FJsonValue& Item, int32 Index, FKeyStack& Keys, TArray<FZLStateViolation>* OutViolations) const;
+	bool IsAccepted(const FKeyValidator& Validator, const FJsonValue& Value) const;
+
+	// Records a violation, returns false when validation should stop (no list to fill)
+	static bool AddViolation(const FKeyStack& Keys, int32 ItemIndex, EZLStateViolation Reason, TArray<FZLStateViolation>* OutViolations);
+
+	FNode Root;
+	TArray<FKeyValidator> Validators;
+};
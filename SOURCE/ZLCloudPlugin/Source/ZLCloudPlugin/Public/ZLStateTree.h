@@ -0,0 +1,146 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Dom/JsonObject.h"
+#include "ZLStateKeyPath.h"
+
+// 64 bit structural hash, equal for any two values CompareJsonValuesCaseSensitive considers equal (object field order is ignored, strings are case sensitive).
+ZLCLOUDPLUGIN_API uint64 GetJsonValueHash64(const TSharedPtr<FJsonValue>& Value);
+
+/*
+* Version and leaf count bookkeeping kept alongside a JSON state tree.
+* Every node records the tree version at which it, or anything below it, last changed, so callers that remember the
+* version they last looked at can skip every subtree that hasn't changed since. The JSON object stays the storage,
+* writers update it as before and then call MarkChanged with the key they touched.
+*/
+class ZLCLOUDPLUGIN_API FZLStateTree
+{
+public:
+	struct FNode
+	{
+		// Tree version when this node or anything below it last changed
+		uint64 Version = 0;
+		// Non object values in this subtree, 1 for a leaf
+		int32 LeafCount = 0;
+		bool bIsObject = false;
+		// Hash of this node's key as it appears in its parent, set when the node is built
+		uint64 KeyHash = 0;
+		// Same value GetJsonValueHash64 would return for this subtree, computed on demand and invalidated by MarkChanged
+		mutable uint64 Hash = 0;
+		mutable bool bHashValid = false;
+		// Keyed the same way as FJsonObject::Values so segment hashes can be reused
+		TMap<FString, TUniquePtr<FNode>> Children;
+
+		const FNode* FindChild(const FZLStateKeyPath::FSegment& Segment) const
+		{
+			const TUniquePtr<FNode>* Child = Children.FindByHash(Segment.Hash, Segment.Name);
+			return Child ? Child->Get() : nullptr;
+		}
+
+		// For FZLStateKeyQuery, the keys are the leaves. Nulls aren't leaves, like in CountLeavesInJsonObject
+		bool IsKey() const { return !bIsObject && LeafCount > 0; }
+		bool HasKeysBelow() const { return bIsObject && LeafCount > 0; }
+	};
+
+	FZLStateTree();
+
+	// Rebuilds all bookkeeping for a new root, everything counts as changed.
+	void Reset(const TSharedPtr<FJsonObject>& InRoot);
+
+	const TSharedPtr<FJsonObject>& GetRoot() const { return Root; }
+
+	// Resyncs the bookkeeping for Path after its value was set, replaced or removed in the JSON, including any empty parents removed with it.
+	void MarkChanged(const FZLStateKeyPath& Path);
+
+	uint64 GetVersion() const { return RootNode.Version; }
+
+	// Version at which Path last changed, or the version of its deepest existing parent if it doesn't exist.
+	uint64 GetVersion(const FZLStateKeyPath& Path) const;
+
+	int32 GetLeafCount() const { return RootNode.LeafCount; }
+
+	const FNode& GetRootNode() const { return RootNode; }
+	const FNode* FindNode(const FZLStateKeyPath& Path) const;
+
+	// Structural hash of the whole tree. Only subtrees changed since the last call are rehashed, so equal trees compare in O(1).
+	uint64 GetHash() const;
+
+	// Structural hash of the value at Path, returns false if it doesn't exist. An invalid path hashes the whole tree.
+	bool GetHash(const FZLStateKeyPath& Path, uint64& OutHash) const;
+
+	// Keys left out of GetFingerprint, along with everything below them.
+	void SetFingerprintExclusions(const TArray<FZLStateKeyPath>& Paths);
+
+	// Canonical, key order independent hash of the tree without the excluded keys, the same as GetHash when nothing is excluded.
+	// Only the levels leading to excluded keys are recombined after a change, everything else reuses the cached subtree hashes.
+	uint64 GetFingerprint() const;
+
+	// Copy of the tree's JSON for keeping what was last sent or saved, which must never be modified. Object levels are copied and
+	// leaf values shared with the live tree (they are replaced rather than modified in place). Anything that hasn't changed since
+	// the previous snapshot is shared with it, so a snapshot costs the levels changed since the last one and snapshots held
+	// side by side keep one copy of what they agree on, keys included. Returns the previous snapshot itself if nothing changed.
+	TSharedPtr<FJsonObject> GetSnapshot() const;
+
+private:
+	struct FExclusion
+	{
+		bool bExcluded = false;
+		TMap<FString, TUniquePtr<FExclusion>> Children;
+	};
+
+	uint64 FingerprintObject(const FNode& Node, const FJsonObject& Object, const FExclusion& Exclusion) const;
+
+	void BuildNode(FNode& Node, const TSharedPtr<FJsonValue>& Value, uint64 Version);
+	uint64 HashNode(const FNode& Node, const TSharedPtr<FJsonValue>& Value) const;
+	TSharedPtr<FJsonObject> SnapshotObject(const FNode& Node, const FJsonObject& Object, const FJsonObject* Previous) const;
+
+	TSharedPtr<FJsonObject> Root;
+	FNode RootNode;
+	uint64 CurrentVersion = 0;
+
+	FExclusion FingerprintExclusions;
+	// Root version the cached fingerprint was computed at
+	mutable uint64 Fingerprint = 0;
+	mutable uint64 FingerprintVersion = 0;
+	mutable bool bFingerprintValid = false;
+
+	// Last snapshot and the root version it was taken at, dropped when the root is replaced
+	mutable TSharedPtr<FJsonObject> Snapshot;
+	mutable uint64 SnapshotVersion = 0;
+};
+
+/*
+* Tracks which leaves of a target state (a request, or the state the server is waiting on) don't match a versioned tree yet.
+* Each Update only revisits target keys whose subtree changed since the previous Update, so polling a large target
+* every tick costs nothing until the state actually changes.
+*/
+class ZLCLOUDPLUGIN_API FZLStateMatchTracker
+{
+public:
+	void SetTarget(const TSharedPtr<FJsonObject>& InTarget);
+	void Reset();
+
+	bool HasTarget() const { return Target.IsValid(); }
+
+	// Returns true when every leaf in the target matches the tree.
+	bool Update(const FZLStateTree& Tree);
+
+	bool IsMatched() const { return bChecked && Unmatched.Num() == 0; }
+	int32 GetNumUnmatched() const { return Unmatched.Num(); }
+
+	// Dotted paths of the target leaves that didn't match at the last Update.
+	TArray<FString> GetUnmatchedKeys() const { return Unmatched.Array(); }
+
+private:
+	void Visit(const FJsonObject& TargetObject, const FJsonObject* CurrentObject, const FZLStateTree::FNode* Node, const FString& Prefix, bool bForce);
+
+	TSharedPtr<FJsonObject> Target;
+	TSet<FString> Unmatched;
+
+	// Tree root and version at the last Update, a different root forces a full check
+	TWeakPtr<FJsonObject> CheckedRoot;
+	uint64 CheckedVersion = 0;
+	bool bChecked = false;
+};
@@ -0,0 +1,90 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Dom/JsonObject.h"
+#include "ZLStateTree.h"
+
+// RFC 7386 merge patch turning From into To: changed values are replaced whole (arrays included), removed keys are set to null.
+// Returns false if To can't be reached by a merge patch, i.e. it holds a null value that differs from From.
+ZLCLOUDPLUGIN_API bool CreateJsonMergePatch(const TSharedPtr<FJsonObject>& From, const TSharedPtr<FJsonObject>& To, TSharedPtr<FJsonObject>& OutPatch);
+
+// Applies an RFC 7386 merge patch to Target in place.
+ZLCLOUDPLUGIN_API void ApplyJsonMergePatch(const TSharedPtr<FJsonObject>& Target, const TSharedPtr<FJsonObject>& Patch);
+
+// Copies every object level of Source and shares the leaf values, which are never modified in place once set.
+ZLCLOUDPLUGIN_API TSharedPtr<FJsonObject> CopyJsonObjectStructure(const TSharedPtr<FJsonObject>& Source);
+
+struct FZLStateWebSyncStats
+{
+	uint64 NumFullSnapshots = 0;
+	uint64 NumPatches = 0;
+	uint64 NumAcks = 0;
+	// Characters of serialized state_processing_ended messages actually sent
+	uint64 SentChars = 0;
+	// What the same messages would have cost as full snapshots, estimated from the size of the last full snapshot
+	uint64 FullEquivalentChars = 0;
+
+	int64 GetSavedChars() const { return (int64)FullEquivalentChars - (int64)SentChars; }
+};
+
+/*
+* Decides how the current state goes out in each state_processing_ended push.
+* Pages that never opt in get the full "current_state" every push, exactly as before. A page that sends
+* ZEROLIGHT_ENABLE_STATE_DELTAS gets a "state_seq" on every push, and from then on most pushes carry a
+* "current_state_patch" instead: an RFC 7386 merge patch from the state it last acknowledged ("state_base_seq")
+* to the current one. The page applies the patch to its copy of that acknowledged state and acknowledges new
+* sequence numbers with {"ZEROLIGHT_STATE_ACK": <state_seq>}. A full snapshot ("current_state" plus
+* "state_full") is resent on opt in, every FullResyncInterval pushes, when too many pushes go unacknowledged,
+* or when the change can't be expressed as a merge patch.
+*/
+class ZLCLOUDPLUGIN_API FZLStateWebSync
+{
+public:
+	// Forgets everything the page acknowledged, deltas stay off until the page opts in again.
+	void Reset();
+
+	void SetDeltasEnabled(bool bEnabled);
+	bool AreDeltasEnabled() const { return bDeltasEnabled; }
+
+	// Adds the tree's state to a state_processing_ended payload, its hash skips the diff when nothing changed and its snapshots
+	// are what gets kept for later patches. Returns true if a full snapshot was written.
+	bool WriteState(const FZLStateTree& Tree, const TSharedPtr<FJsonObject>& OutPayload);
+
+	// The page has applied Sequence, later patches are based on it. Unknown or stale sequence numbers are ignored.
+	void Acknowledge(int32 Sequence);
+
+	// Records the serialized size of the message WriteState went into.
+	void RecordSent(bool bFullSnapshot, int32 NumChars);
+
+	int32 GetAcknowledgedSequence() const { return AcknowledgedSequence; }
+	int32 GetNumUnacknowledged() const { return Unacknowledged.Num(); }
+	const FZLStateWebSyncStats& GetStats() const { return Stats; }
+	// The acknowledged state and every state sent since, for memory accounting
+	void GetKeptStates(TArray<TSharedPtr<FJsonObject>>& OutStates) const;
+	void ResetStats() { Stats = FZLStateWebSyncStats(); }
+
+	int32 FullResyncInterval = 100;
+	int32 MaxUnacknowledged = 16;
+
+private:
+	struct FSnapshot
+	{
+		TSharedPtr<FJsonObject> State;
+		uint64 Hash = 0;
+	};
+
+	bool bDeltasEnabled = false;
+	int32 NextSequence = 1;
+
+	int32 AcknowledgedSequence = INDEX_NONE;
+	FSnapshot AcknowledgedState;
+
+	// States sent but not acknowledged yet, by sequence number
+	TMap<int32, FSnapshot> Unacknowledged;
+	int32 PushesSinceFullSnapshot = 0;
+	int32 LastFullSnapshotChars = 0;
+
+	FZLStateWebSyncStats Stats;
+};
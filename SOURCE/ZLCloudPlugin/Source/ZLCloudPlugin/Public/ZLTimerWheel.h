@@ -0,0 +1,70 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+* Hierarchical timer wheel for deadlines measured in seconds on a caller supplied clock.
+* Time is split into fixed ticks, each level holds 64 slots and covers 64 times the span of the one below, timers are
+* filed by deadline and only moved down a level when their slot comes round. Advancing to a time in the same tick
+* returns straight away, and crossing ticks only looks at one slot per tick (skipping spans where the lower levels are
+* empty), so the cost doesn't depend on how many timers are waiting until some of them actually expire. Timers never fire early and at most one tick late.
+*/
+class ZLCLOUDPLUGIN_API FZLTimerWheel
+{
+public:
+	typedef uint64 FTimerId;
+	static constexpr FTimerId InvalidTimer = 0;
+
+	explicit FZLTimerWheel(double InTickSeconds = 0.05);
+
+	// Drops every timer and restarts the wheel at StartTime.
+	void Reset(double StartTime);
+
+	// Calls Callback from the first Advance at or after Deadline. Deadlines already passed fire on the next Advance.
+	FTimerId Schedule(double Deadline, TFunction<void()> Callback);
+
+	// Returns false if the timer already fired or was cancelled.
+	bool Cancel(FTimerId Id);
+
+	bool IsScheduled(FTimerId Id) const { return Active.Contains(Id); }
+
+	// Fires every timer due by Now, in deadline tick order. Callbacks may schedule or cancel timers, anything they
+	// schedule that is already due fires on the next Advance. Returns the number of timers fired.
+	int32 Advance(double Now);
+
+	int32 Num() const { return Active.Num(); }
+	double GetTickSeconds() const { return TickSeconds; }
+
+private:
+	static constexpr int32 BitsPerLevel = 6;
+	static constexpr int32 SlotsPerLevel = 1 << BitsPerLevel;
+	static constexpr int32 NumLevels = 4;
+
+	struct FTimer
+	{
+		FTimerId Id = InvalidTimer;
+		uint64 Tick = 0;
+		TFunction<void()> Callback;
+	};
+
+	// Files a timer by how far its tick is from CurrentTick
+	void Insert(FTimer&& Timer);
+	// Moves a higher level slot's timers down now that its span has started
+	void Cascade(int32 Level);
+	uint64 ToTick(double Time) const;
+
+	double TickSeconds;
+	double Origin = 0.0;
+	uint64 CurrentTick = 0;
+	FTimerId NextId = 1;
+
+	TArray<FTimer> Slots[NumLevels][SlotsPerLevel];
+	// Timers filed in each level, cancelled ones included until their slot comes round
+	int32 LevelCounts[NumLevels] = {};
+	// Scheduled at or before CurrentTick, fired at the start of the next Advance
+	TArray<FTimer> Due;
+	// Cancelled timers stay in their slot and are skipped when it comes round
+	TSet<FTimerId> Active;
+};
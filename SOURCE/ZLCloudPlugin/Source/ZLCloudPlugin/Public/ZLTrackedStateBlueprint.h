@@ -30,6 +30,7 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Zerolight Omnistream Tracked State")
 	bool GetFromStateManager(const FString& bluePrintName, FString& OutJsonString);
 
+    // Fired once a frame when state requests change the key of a blueprint that has sent or pulled its state (every request until one has)
     DECLARE_DYNAMIC_MULTICAST_DELEGATE(FTrackedStateUpdated);
     UPROPERTY(BlueprintAssignable, Category = "Zerolight Omnistream Tracked State")
     FTrackedStateUpdated OnTrackedStateUpdate;
@@ -0,0 +1,105 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ZLStateKeyInfo.h"
+#include "ZLStateKeyPath.h"
+#include "ZLStateTree.h"
+
+/*
+* Typed, packed copy of the schema's keys in a JSON state tree.
+* Build compiles a UStateKeyInfoAsset into one slot per key in the array for its declared type (numbers, bools,
+* strings, value indices for limited string keys and the three array types), looked up by interned path id, so typed
+* reads skip FJsonValue boxing, DataType string checks and the walk down the tree. The JSON tree stays the storage
+* that is diffed and sent to the web, and the overflow for everything the schema doesn't declare: keys outside the
+* schema, and schema keys holding a value of another type, read as not held here and callers fall back to the JSON.
+* Slots are reloaded from the tree by Sync, which costs nothing while the tree version is unchanged.
+*/
+class ZLCLOUDPLUGIN_API FZLTypedStateStore
+{
+public:
+	// Compiles Schema's keys into slots, all of them unloaded until the next Sync. A null schema empties the store.
+	void Build(const UStateKeyInfoAsset* Schema);
+
+	bool IsEmpty() const { return Slots.Num() == 0; }
+	int32 Num() const { return Slots.Num(); }
+
+	bool HasSlot(const FZLStateKeyPath& Path) const { return FindSlot(Path) != nullptr; }
+	EStateKeyDataType GetSlotType(const FZLStateKeyPath& Path) const;
+
+	// Reloads every slot whose key changed in Tree since it was last loaded. Returns straight away if nothing changed.
+	void Sync(const FZLStateTree& Tree);
+
+	// Reads Path's value, false if it isn't a schema key of a matching type or the tree doesn't hold a value of that type.
+	// Numbers read as float or double, limited string keys as their string. Arrays are appended to OutValue like the JSON reads.
+	bool TryGet(const FZLStateKeyPath& Path, double& OutValue) const;
+	bool TryGet(const FZLStateKeyPath& Path, float& OutValue) const;
+	bool TryGet(const FZLStateKeyPath& Path, bool& OutValue) const;
+	bool TryGet(const FZLStateKeyPath& Path, FString& OutValue) const;
+	bool TryGet(const FZLStateKeyPath& Path, TArray<double>& OutValue) const;
+	bool TryGet(const FZLStateKeyPath& Path, TArray<float>& OutValue) const;
+	bool TryGet(const FZLStateKeyPath& Path, TArray<bool>& OutValue) const;
+	bool TryGet(const FZLStateKeyPath& Path, TArray<FString>& OutValue) const;
+
+	// Writes Value straight into Path's slot after the owner wrote the same value to the JSON and called MarkChanged.
+	// VersionBefore is the tree version before that write, so a store that was in sync stays in sync without a Sync.
+	// Returns false, leaving the slot to be reloaded by the next Sync, if Path isn't a schema key of a matching type.
+	bool Store(const FZLStateKeyPath& Path, double Value, const FZLStateTree& Tree, uint64 VersionBefore);
+	bool Store(const FZLStateKeyPath& Path, float Value, const FZLStateTree& Tree, uint64 VersionBefore);
+	bool Store(const FZLStateKeyPath& Path, bool Value, const FZLStateTree& Tree, uint64 VersionBefore);
+	bool Store(const FZLStateKeyPath& Path, const FString& Value, const FZLStateTree& Tree, uint64 VersionBefore);
+	bool Store(const FZLStateKeyPath& Path, const TArray<double>& Value, const FZLStateTree& Tree, uint64 VersionBefore);
+	bool Store(const FZLStateKeyPath& Path, const TArray<float>& Value, const FZLStateTree& Tree, uint64 VersionBefore);
+	bool Store(const FZLStateKeyPath& Path, const TArray<bool>& Value, const FZLStateTree& Tree, uint64 VersionBefore);
+	bool Store(const FZLStateKeyPath& Path, const TArray<FString>& Value, const FZLStateTree& Tree, uint64 VersionBefore);
+
+	uint64 GetNumReloads() const { return NumReloads; }
+
+private:
+	struct FSlot
+	{
+		FZLStateKeyPath Path;
+		EStateKeyDataType Type = EStateKeyDataType::Invalid;
+		// Index into the typed array for Type, or into EnumValues for limited string keys
+		int32 Index = INDEX_NONE;
+		// Index into EnumTables for string keys limited to AcceptedStringValues
+		int32 EnumTable = INDEX_NONE;
+		// Tree version of the key when the slot was loaded
+		uint64 Version = 0;
+		// False while the tree has no value of the slot's type at the key
+		bool bHeld = false;
+		// No other schema key sits above or below this one, so a write to it can't change any other slot
+		bool bIsolated = true;
+	};
+
+	const FSlot* FindSlot(const FZLStateKeyPath& Path) const;
+	FSlot* FindSlot(const FZLStateKeyPath& Path) { return const_cast<FSlot*>(static_cast<const FZLTypedStateStore*>(this)->FindSlot(Path)); }
+	const FSlot* FindHeldSlot(const FZLStateKeyPath& Path, EStateKeyDataType Type) const;
+
+	// Reads the slot's key out of the JSON
+	void Load(FSlot& Slot, const TSharedPtr<FJsonObject>& Root, uint64 Version);
+	// Marks the slot loaded by a direct write, keeping the store in sync if it was before the write
+	void FinishStore(FSlot& Slot, const FZLStateTree& Tree, uint64 VersionBefore);
+
+	TArray<FSlot> Slots;
+	// Slot index by FZLStateKeyPath id, INDEX_NONE for paths outside the schema
+	TArray<int32> SlotsByPathId;
+
+	TArray<double> Numbers;
+	TArray<bool> Bools;
+	TArray<FString> Strings;
+	TArray<int32> EnumValues;
+	TArray<TArray<double>> NumberArrays;
+	TArray<TArray<bool>> BoolArrays;
+	TArray<TArray<FString>> StringArrays;
+	// Accepted values of each limited string key
+	TArray<TArray<FString>> EnumTables;
+
+	// Tree root and version at the last Sync, a different root reloads everything
+	TWeakPtr<FJsonObject> SyncedRoot;
+	uint64 SyncedVersion = 0;
+	bool bSynced = false;
+
+	uint64 NumReloads = 0;
+};
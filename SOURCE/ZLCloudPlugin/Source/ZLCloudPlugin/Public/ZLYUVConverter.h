@@ -0,0 +1,76 @@
+// Copyright ZeroLight ltd. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+enum class EZLYUVMatrix : uint8
+{
+	BT601,
+	BT709
+};
+
+enum class EZLYUVRange : uint8
+{
+	// Studio swing, Y in [16, 235] and chroma in [16, 240]
+	Limited,
+	Full
+};
+
+// Byte order of the 32 bit source pixels, alpha is ignored.
+enum class EZLRGBLayout : uint8
+{
+	RGBA,
+	BGRA
+};
+
+struct ZLCLOUDPLUGIN_API FZLYUVColorSpace
+{
+	EZLYUVMatrix Matrix = EZLYUVMatrix::BT709;
+	EZLYUVRange Range = EZLYUVRange::Limited;
+
+	// Maps the CloudStream2DLL::YUVColorSpace requested by the encoder.
+	static FZLYUVColorSpace FromCloudStream(uint32 InCloudStreamColorSpace);
+};
+
+/*
+* CPU RGBA/BGRA -> I420/NV12 converter for when GPU conversion isn't available (NullRHI, software capture).
+* Uses 15 bit fixed point maths so the SSE2/NEON paths produce exactly the same output as the scalar path,
+* chroma is the rounded average of each 2x2 block. Rows are converted in tiles across the task graph.
+*/
+class ZLCLOUDPLUGIN_API FZLYUVConverter
+{
+public:
+	FZLYUVConverter(const FZLYUVColorSpace& InColorSpace = FZLYUVColorSpace(), EZLRGBLayout InLayout = EZLRGBLayout::RGBA);
+
+	void ConvertToI420(const uint8* Src, int32 SrcStride, int32 Width, int32 Height,
+		uint8* DstY, int32 StrideY, uint8* DstU, int32 StrideU, uint8* DstV, int32 StrideV) const;
+
+	void ConvertToNV12(const uint8* Src, int32 SrcStride, int32 Width, int32 Height,
+		uint8* DstY, int32 StrideY, uint8* DstUV, int32 StrideUV) const;
+
+	// Disables the SIMD path, used to check the vectorised output against the scalar reference.
+	void SetVectorised(bool bInVectorised) { bVectorised = bInVectorised; }
+
+	// Disables splitting the frame across worker threads.
+	void SetParallel(bool bInParallel) { bParallel = bInParallel; }
+
+private:
+	void Convert(const uint8* Src, int32 SrcStride, int32 Width, int32 Height,
+		uint8* DstY, int32 StrideY, uint8* DstU, uint8* DstV, int32 StrideChroma, bool bInterleavedChroma) const;
+
+	void ConvertLumaRow(const uint8* Src, uint8* DstY, int32 Width) const;
+	void ConvertChromaRow(const uint8* Row0, const uint8* Row1, int32 Width, uint8* DstU, uint8* DstV, bool bInterleavedChroma) const;
+
+	// Rows per parallel task, must be even so each task owns whole chroma rows.
+	static constexpr int32 RowsPerTile = 32;
+
+	// Coefficients are indexed by source byte rather than by colour, so BGRA only swaps them round.
+	int16 YCoef[3];
+	int16 UCoef[3];
+	int16 VCoef[3];
+	int32 YOffset;
+
+	bool bVectorised = true;
+	bool bParallel = true;
+};
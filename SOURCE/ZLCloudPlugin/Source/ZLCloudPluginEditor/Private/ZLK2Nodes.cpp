@@ -54,36 +54,14 @@ TArray<TSharedPtr<FString>> SGraphPin_KeySelector::GatherKeyOptions() const
 	if (SubKeysPin)
 		displaySubKeyedJSONObjects = true;
 
-	TSet<FString> UniqueKeys;
-
-	for (const auto& Pair : Asset->KeyInfos)
-	{
-		const FString& FullKey = Pair.Key;
-
-		if (displaySubKeyedJSONObjects)
-		{
-			if (FullKey.Contains(TEXT(".")))
-			{
-				TArray<FString> Parts;
-				FullKey.ParseIntoArray(Parts, TEXT("."), true);
-
-				FString Path;
-				for (int32 i = 0; i < Parts.Num() - 1; ++i)
-				{
-					if (!Path.IsEmpty())
-					{
-						Path += TEXT(".");
-					}
-					Path += Parts[i];
-
-					UniqueKeys.Add(Path);
-				}
-			}
-		}
-		else
-			UniqueKeys.Add(FullKey);
-	}
-
+	// Sub key nodes pick a parent of keys, each one listed once by the schema's key trie
+	TArray<FString> UniqueKeys;
+	if (displaySubKeyedJSONObjects)
+		Asset->GetKeyTrie().GetParents(UniqueKeys);
+	else
+		Asset->KeyInfos.GenerateKeyArray(UniqueKeys);
+
+	Keys.Reserve(UniqueKeys.Num());
 	for (const FString& Key : UniqueKeys)
 	{
 		Keys.Add(MakeShared<FString>(Key));